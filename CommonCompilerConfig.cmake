@@ -28,6 +28,10 @@
 # INPUTS:
 #
 # PLATFORM: lowercase ${CMAKE_SYSTEM_NAME}
+#
+# NUPIC_PGO: OFF, GENERATE or USE; see the root CMakeLists.txt
+#
+# NUPIC_PGO_DIR: directory of the profile of NUPIC_PGO
 
 # OUTPUTS:
 #
@@ -77,6 +81,9 @@
 # CMAKE_LINKER: updated, if needed; use ld.gold if available. See cmake
 #               documentation
 #
+# NUPIC_LLVM_PROFDATA: llvm-profdata, which merges the raw profiles of clang
+#                      NUPIC_PGO=GENERATE builds
+#
 # NOTE The XXX_OPTIMIZED flags are quite aggresive - if your code misbehaves for
 # strange reasons, try compiling without them.
 
@@ -87,6 +94,7 @@ if(NOT DEFINED PLATFORM)
 endif()
 
 include(CheckCXXCompilerFlag)
+include(CheckCXXSourceCompiles)
 
 
 # Init exported properties
@@ -220,8 +228,111 @@ if(NOT ${CMAKE_CXX_COMPILER_ID} STREQUAL "MSVC")
     set(optimization_flags_cc "${optimization_flags_cc} -fuse-ld=gold")
     # NOTE -flto must go together in both cc and ld flags; also, it's presently incompatible
     # with the -g option in at least some GNU compilers (saw in `man gcc` on Ubuntu)
-    set(optimization_flags_cc "${optimization_flags_cc} -fuse-linker-plugin -flto-report -flto") #TODO fix LTO for clang
-    set(optimization_flags_lt "${optimization_flags_lt} -flto") #TODO LTO for clang too
+    set(optimization_flags_cc "${optimization_flags_cc} -fuse-linker-plugin -flto-report -flto")
+    set(optimization_flags_lt "${optimization_flags_lt} -flto")
+  endif()
+
+  if(${CMAKE_CXX_COMPILER_ID} MATCHES "Clang" AND NOT MINGW AND
+     "${NUPIC_PGO}" STREQUAL "USE")
+    # NOTE clang's LTO objects are LLVM bitcode: linking them takes lld or gold
+    # with the LLVMgold plugin, and archiving them llvm-ar and llvm-ranlib
+    # except with Xcode's tools, which understand bitcode. Since that changes
+    # the toolchain, clang LTO is limited to the NUPIC_PGO=USE builds, and left
+    # off when the toolchain cannot do both.
+    get_filename_component(clang_dir ${CMAKE_CXX_COMPILER} DIRECTORY)
+    string(REGEX MATCH "^[0-9]+" clang_major "${CMAKE_CXX_COMPILER_VERSION}")
+    set(clang_lto_flags "-flto")
+    if(NOT APPLE)
+      find_program(NUPIC_LLVM_AR NAMES llvm-ar-${clang_major} llvm-ar
+                   HINTS ${clang_dir})
+      find_program(NUPIC_LLVM_RANLIB NAMES llvm-ranlib-${clang_major} llvm-ranlib
+                   HINTS ${clang_dir})
+      find_program(NUPIC_LLD NAMES ld.lld-${clang_major} ld.lld HINTS ${clang_dir})
+      if(NUPIC_LLD)
+        set(clang_lto_flags "${clang_lto_flags} -fuse-ld=lld")
+      else()
+        set(clang_lto_flags "${clang_lto_flags} -fuse-ld=gold")
+      endif()
+    endif()
+
+    set(CMAKE_REQUIRED_FLAGS "${clang_lto_flags}")
+    check_cxx_source_compiles("int main() { return 0; }" clang_links_lto)
+    unset(CMAKE_REQUIRED_FLAGS)
+
+    if(clang_links_lto AND (APPLE OR (NUPIC_LLVM_AR AND NUPIC_LLVM_RANLIB)))
+      set(clang_lto ON)
+      set(optimization_flags_cc "${optimization_flags_cc} ${clang_lto_flags}")
+      set(optimization_flags_lt "${optimization_flags_lt} ${clang_lto_flags}")
+    else()
+      message(WARNING "LTO disabled: clang needs lld or the LLVMgold plugin, "
+                      "and llvm-ar and llvm-ranlib")
+    endif()
+  endif()
+endif()
+
+
+#
+# Profile-guided optimization of the internal sources (see NUPIC_PGO). The
+# instrumented and the final builds must compile the same sources in the same
+# build directory: gcc finds the profile of an object by its path.
+#
+set(pgo_flags_cc "")
+set(pgo_flags_lt "")
+
+if(NOT "${NUPIC_PGO}" STREQUAL "OFF")
+  if(NOT "${NUPIC_PGO}" STREQUAL "GENERATE" AND NOT "${NUPIC_PGO}" STREQUAL "USE")
+    message(FATAL_ERROR "NUPIC_PGO must be OFF, GENERATE or USE, not ${NUPIC_PGO}")
+  endif()
+  if("${CMAKE_BUILD_TYPE}" STREQUAL "Debug")
+    message(FATAL_ERROR "NUPIC_PGO requires an optimized build")
+  endif()
+  if(NOT ${CMAKE_CXX_COMPILER_ID} STREQUAL "GNU" AND
+     NOT ${CMAKE_CXX_COMPILER_ID} MATCHES "Clang")
+    message(FATAL_ERROR "NUPIC_PGO is only supported with gcc and clang")
+  endif()
+
+  if("${NUPIC_PGO}" STREQUAL "GENERATE")
+    set(pgo_flags_cc "-fprofile-generate=${NUPIC_PGO_DIR}")
+    set(pgo_flags_lt "-fprofile-generate=${NUPIC_PGO_DIR}")
+
+    # Keeps the counts exact when the ThreadPool workers run the kernels
+    CHECK_CXX_COMPILER_FLAG(-fprofile-update=atomic compiler_supports_atomic_profile)
+    if(compiler_supports_atomic_profile)
+      set(pgo_flags_cc "${pgo_flags_cc} -fprofile-update=atomic")
+    endif()
+
+    if(${CMAKE_CXX_COMPILER_ID} MATCHES "Clang")
+      get_filename_component(clang_dir ${CMAKE_CXX_COMPILER} DIRECTORY)
+      string(REGEX MATCH "^[0-9]+" clang_major "${CMAKE_CXX_COMPILER_VERSION}")
+      find_program(NUPIC_LLVM_PROFDATA
+                   NAMES llvm-profdata-${clang_major} llvm-profdata
+                   HINTS ${clang_dir})
+      if(NOT NUPIC_LLVM_PROFDATA)
+        message(FATAL_ERROR "NUPIC_PGO=GENERATE with clang requires llvm-profdata")
+      endif()
+    endif()
+
+  elseif(${CMAKE_CXX_COMPILER_ID} STREQUAL "GNU")
+    if(NOT EXISTS "${NUPIC_PGO_DIR}")
+      message(FATAL_ERROR "No profile in ${NUPIC_PGO_DIR}: build the pgo_training "
+                          "target of a NUPIC_PGO=GENERATE build first")
+    endif()
+    # Sources that the workload does not run have no profile
+    set(pgo_flags_cc "-fprofile-use=${NUPIC_PGO_DIR} -fprofile-correction")
+    CHECK_CXX_COMPILER_FLAG(-Wmissing-profile compiler_warns_missing_profile)
+    if(compiler_warns_missing_profile)
+      set(pgo_flags_cc "${pgo_flags_cc} -Wno-missing-profile")
+    endif()
+    set(pgo_flags_lt "-fprofile-use=${NUPIC_PGO_DIR}")
+
+  else()
+    set(pgo_profile "${NUPIC_PGO_DIR}/nupic.profdata")
+    if(NOT EXISTS "${pgo_profile}")
+      message(FATAL_ERROR "No profile ${pgo_profile}: build the pgo_training "
+                          "target of a NUPIC_PGO=GENERATE build first")
+    endif()
+    set(pgo_flags_cc "-fprofile-use=${pgo_profile} -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date")
+    set(pgo_flags_lt "-fprofile-use=${pgo_profile}")
   endif()
 endif()
 
@@ -325,6 +436,16 @@ IF(UNIX AND CMAKE_COMPILER_IS_GNUCXX AND (NOT "${CMAKE_BUILD_TYPE}" STREQUAL "De
     list(APPEND EXTERNAL_STATICLIB_CONFIGURE_DEFINITIONS_OPTIMIZED
          AR=gcc-ar
          RANLIB=gcc-ranlib)
+ELSEIF(clang_lto AND NOT APPLE AND (NOT "${CMAKE_BUILD_TYPE}" STREQUAL "Debug"))
+    # Same for the bitcode objects of clang's LTO
+    set(CMAKE_AR "${NUPIC_LLVM_AR}")
+    set(CMAKE_RANLIB "${NUPIC_LLVM_RANLIB}")
+    list(APPEND EXTERNAL_STATICLIB_CMAKE_DEFINITIONS_OPTIMIZED
+         -DCMAKE_AR:PATH=${NUPIC_LLVM_AR}
+         -DCMAKE_RANLIB:PATH=${NUPIC_LLVM_RANLIB})
+    list(APPEND EXTERNAL_STATICLIB_CONFIGURE_DEFINITIONS_OPTIMIZED
+         AR=${NUPIC_LLVM_AR}
+         RANLIB=${NUPIC_LLVM_RANLIB})
 ENDIF()
 
 #
@@ -356,17 +477,24 @@ if("${CMAKE_BUILD_TYPE}" STREQUAL "Debug")
   set(optimization_flags_lt)
 endif()
 
+# The instrumented build only records the profile; the final build is the one
+# that gets LTO
+if("${NUPIC_PGO}" STREQUAL "GENERATE")
+  string(REGEX REPLACE "-flto(-report)?( |$)" "" optimization_flags_cc "${optimization_flags_cc}")
+  string(REGEX REPLACE "-flto(-report)?( |$)" "" optimization_flags_lt "${optimization_flags_lt}")
+endif()
+
 
 #
 # Assemble compiler and linker properties
 #
 
 # Settings for internal nupic.core code
-set(INTERNAL_CXX_FLAGS_OPTIMIZED "${build_type_specific_compile_flags} ${shared_compile_flags} ${cxx_flags_unoptimized} ${internal_compiler_warning_flags} ${optimization_flags_cc}")
+set(INTERNAL_CXX_FLAGS_OPTIMIZED "${build_type_specific_compile_flags} ${shared_compile_flags} ${cxx_flags_unoptimized} ${internal_compiler_warning_flags} ${optimization_flags_cc} ${pgo_flags_cc}")
 
 set(complete_linker_flags_unoptimized "${build_type_specific_linker_flags} ${shared_linker_flags_unoptimized}")
 set(complete_linker_flags_unoptimized "${complete_linker_flags_unoptimized} ${fail_link_on_undefined_symbols_flags}")
-set(INTERNAL_LINKER_FLAGS_OPTIMIZED "${complete_linker_flags_unoptimized} ${optimization_flags_lt}")
+set(INTERNAL_LINKER_FLAGS_OPTIMIZED "${complete_linker_flags_unoptimized} ${optimization_flags_lt} ${pgo_flags_lt}")
 
 # Settings for third-party code and code generated by 3rd-party tools (e.g., Swig bindings)
 # (NOTE we omit the explicit compiler warning-related flags here to avoid
@@ -375,14 +503,14 @@ set(EXTERNAL_C_FLAGS_UNOPTIMIZED "${build_type_specific_compile_flags} ${shared_
 set(EXTERNAL_C_FLAGS_OPTIMIZED "${EXTERNAL_C_FLAGS_UNOPTIMIZED} ${optimization_flags_cc}")
 
 set(PYEXT_LINKER_FLAGS_OPTIMIZED "${build_type_specific_linker_flags} ${shared_linker_flags_unoptimized}")
-set(PYEXT_LINKER_FLAGS_OPTIMIZED "${PYEXT_LINKER_FLAGS_OPTIMIZED} ${optimization_flags_lt}")
+set(PYEXT_LINKER_FLAGS_OPTIMIZED "${PYEXT_LINKER_FLAGS_OPTIMIZED} ${optimization_flags_lt} ${pgo_flags_lt}")
 set(PYEXT_LINKER_FLAGS_OPTIMIZED "${PYEXT_LINKER_FLAGS_OPTIMIZED} ${allow_link_with_undefined_symbols_flags}")
 
 set(EXTERNAL_CXX_FLAGS_UNOPTIMIZED "${build_type_specific_compile_flags} ${shared_compile_flags} ${external_compiler_warning_flags} ${cxx_flags_unoptimized}")
 set(EXTERNAL_CXX_FLAGS_OPTIMIZED "${EXTERNAL_CXX_FLAGS_UNOPTIMIZED} ${optimization_flags_cc}")
 
 set(EXTERNAL_LINKER_FLAGS_UNOPTIMIZED "${complete_linker_flags_unoptimized}")
-set(EXTERNAL_LINKER_FLAGS_OPTIMIZED "${INTERNAL_LINKER_FLAGS_OPTIMIZED}")
+set(EXTERNAL_LINKER_FLAGS_OPTIMIZED "${complete_linker_flags_unoptimized} ${optimization_flags_lt}")
 
 
 #
@@ -0,0 +1,38 @@
+# -----------------------------------------------------------------------------
+# Numenta Platform for Intelligent Computing (NuPIC)
+# Copyright (C) 2018, Numenta, Inc.  Unless you have purchased from
+# Numenta, Inc. a separate commercial license for this software code, the
+# following terms and conditions apply:
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU Affero Public License for more details.
+#
+# You should have received a copy of the GNU Affero Public License
+# along with this program.  If not, see http://www.gnu.org/licenses.
+#
+# http://numenta.org/licenses/
+# -----------------------------------------------------------------------------
+
+# Merges the raw profiles that the instrumented binaries of a clang
+# NUPIC_PGO=GENERATE build wrote in PGO_DIR into PGO_DIR/nupic.profdata, the
+# profile of NUPIC_PGO=USE builds.
+#
+# Usage: cmake -DLLVM_PROFDATA=<llvm-profdata> -DPGO_DIR=<dir> -P PgoMergeProfiles.cmake
+
+file(GLOB raw_profiles "${PGO_DIR}/*.profraw")
+if(NOT raw_profiles)
+  message(FATAL_ERROR "No raw profiles in ${PGO_DIR}")
+endif()
+
+execute_process(COMMAND ${LLVM_PROFDATA} merge
+                        -output=${PGO_DIR}/nupic.profdata ${raw_profiles}
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "llvm-profdata failed to merge the profiles in ${PGO_DIR}")
+endif()
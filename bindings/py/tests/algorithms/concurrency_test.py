@@ -0,0 +1,133 @@
+# ----------------------------------------------------------------------
+# Numenta Platform for Intelligent Computing (NuPIC)
+# Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+# with Numenta, Inc., for a separate license for this software code, the
+# following terms and conditions apply:
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU Affero Public License for more details.
+#
+# You should have received a copy of the GNU Affero Public License
+# along with this program.  If not, see http://www.gnu.org/licenses.
+#
+# http://numenta.org/licenses/
+# ----------------------------------------------------------------------
+
+"""Runs independent models from several Python threads.
+
+The compute() bindings release the GIL, so the models really run
+concurrently; each one must still give the results it gives alone. A
+TemporalMemory with a Python event handler keeps the GIL, since the
+handler is called from compute().
+"""
+
+import threading
+import unittest
+
+import numpy
+
+from nupic.bindings.algorithms import (ConnectionsEventHandler,
+                                       SpatialPooler, TemporalMemory)
+
+uintDType = "uint32"
+
+NUM_INPUTS = 200
+NUM_COLUMNS = 128
+NUM_STEPS = 50
+NUM_THREADS = 6
+
+
+
+class SegmentCounter(ConnectionsEventHandler):
+  """Counts the segments created in a Connections."""
+
+  def __init__(self):
+    ConnectionsEventHandler.__init__(self)
+    self.numSegments = 0
+
+
+  def onCreateSegment(self, segment):
+    self.numSegments += 1
+
+
+
+def runModel(seed, handler=None):
+  sp = SpatialPooler(inputDimensions=[NUM_INPUTS],
+                     columnDimensions=[NUM_COLUMNS])
+  tm = TemporalMemory(columnDimensions=[NUM_COLUMNS],
+                      cellsPerColumn=8,
+                      activationThreshold=8,
+                      minThreshold=6,
+                      maxNewSynapseCount=12)
+  if handler is not None:
+    tm.connections.subscribe(handler.__disown__())
+
+  rng = numpy.random.RandomState(seed)
+  sequence = (rng.rand(6, NUM_INPUTS) < 0.1).astype(uintDType)
+  activeArray = numpy.zeros(NUM_COLUMNS, dtype=uintDType)
+
+  trace = []
+  for step in xrange(NUM_STEPS):
+    sp.compute(sequence[step % len(sequence)], True, activeArray)
+    activeColumns = activeArray.nonzero()[0]
+    tm.compute(activeColumns, learn=True)
+    trace.append(tuple(activeColumns))
+    trace.append(tuple(tm.getActiveCells()))
+  return trace
+
+
+
+class ConcurrencyTest(unittest.TestCase):
+
+
+  def testIndependentModelsMatchSerialRuns(self):
+    expected = [runModel(seed) for seed in xrange(NUM_THREADS)]
+
+    actual = [None] * NUM_THREADS
+    def run(seed):
+      actual[seed] = runModel(seed)
+
+    threads = [threading.Thread(target=run, args=(seed,))
+               for seed in xrange(NUM_THREADS)]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+
+    for seed in xrange(NUM_THREADS):
+      self.assertEqual(expected[seed], actual[seed])
+
+
+  def testModelsWithPythonHandlers(self):
+    expected = []
+    for seed in xrange(2):
+      handler = SegmentCounter()
+      trace = runModel(seed, handler)
+      expected.append((trace, handler.numSegments))
+      self.assertGreater(handler.numSegments, 0)
+
+    handlers = [SegmentCounter() for _ in xrange(2)]
+    actual = [None] * 2
+    def run(seed):
+      actual[seed] = (runModel(seed, handlers[seed]),
+                      handlers[seed].numSegments)
+
+    threads = [threading.Thread(target=run, args=(seed,))
+               for seed in xrange(2)]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+
+    self.assertEqual(expected, actual)
+
+
+
+if __name__ == "__main__":
+  unittest.main()
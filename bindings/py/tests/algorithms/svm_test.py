@@ -125,6 +125,42 @@ class SVMTest(unittest.TestCase):
       self.assertEqual(len(s), classifier01.persistent_size())
 
 
+  def testPredictBatch(self):
+    nDims = 32
+    nClass = 4
+    size = 40
+    labels = _RGEN.random_integers(0, nClass - 1, size)
+    samples = _RGEN.normal(size=(size, nDims)).astype(_DTYPE)
+
+    for svm in (svm_dense, svm_01):
+      classifier = svm(0, nDims, seed=_SEED, probability=True)
+      for y, x in zip(labels, samples):
+        classifier.add_sample(float(y), x)
+      classifier.train(gamma=1.0/3.0, C=100, eps=1e-1)
+
+      batchLabels = np.zeros(size, dtype=_DTYPE)
+      decValues = np.zeros((size, nClass * (nClass - 1) / 2), dtype=_DTYPE)
+      proba = np.zeros((size, nClass), dtype=_DTYPE)
+      classifier.predict_batch(samples, batchLabels, decValues, proba)
+      for i in range(size):
+        p = np.zeros(nClass, dtype=_DTYPE)
+        self.assertEqual(classifier.predict_probability(samples[i], p),
+                         batchLabels[i])
+        self.assertTrue(np.array_equal(p, proba[i]))
+
+      # The buffers are checked before anything is written through them
+      with self.assertRaises(Exception):
+        classifier.predict_batch(samples.astype(np.float64), batchLabels)
+      with self.assertRaises(Exception):
+        classifier.predict_batch(samples[:, :nDims / 2].copy(), batchLabels)
+      with self.assertRaises(Exception):
+        classifier.predict_batch(samples, batchLabels[:size / 2])
+      with self.assertRaises(Exception):
+        classifier.predict_batch(samples, batchLabels, decValues, proba.T)
+      with self.assertRaises(Exception):
+        classifier.predict_batch(samples, batchLabels, proba, decValues)
+
+
   # TODO: Add appropriate assertions and re-enable this test.
   @unittest.skip("Legacy test that is out of date.")
   def testScalability(self):
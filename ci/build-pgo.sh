@@ -0,0 +1,84 @@
+#!/bin/bash
+# ----------------------------------------------------------------------
+# Numenta Platform for Intelligent Computing (NuPIC)
+# Copyright (C) 2018, Numenta, Inc.  Unless you have purchased from
+# Numenta, Inc. a separate commercial license for this software code, the
+# following terms and conditions apply:
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU Affero Public License for more details.
+#
+# You should have received a copy of the GNU Affero Public License
+# along with this program.  If not, see http://www.gnu.org/licenses.
+#
+# http://numenta.org/licenses/
+# ----------------------------------------------------------------------
+
+set -o errexit
+
+
+USAGE="Usage:
+
+[BUILD_DIR=dir] [INSTALL_PREFIX=dir] $( basename ${0} ) [cmake arguments]
+
+This script builds a Release nupic.core with profile-guided optimization and
+link time optimization, with gcc or clang (select the compiler with CC and
+CXX):
+
+  1. Configures BUILD_DIR with NUPIC_PGO=GENERATE, builds the instrumented
+     connections_performance_test and hello_sp_tp and runs them (the
+     pgo_training target) to record the profile of a training workload.
+  2. Reconfigures BUILD_DIR with NUPIC_PGO=USE and installs the nupic_core
+     library, the executables and the Python extensions, compiled with the
+     profile. The same build directory is used for both steps because gcc
+     finds the profile of an object by its path.
+
+The cmake arguments are passed to both configurations, for example
+-DPY_EXTENSIONS_DIR=<nupic.core>/bindings/py/src/nupic/bindings.
+
+
+INPUT ENVIRONMENT VARIABLES:
+
+  BUILD_DIR      : Build directory; defaults to build/pgo in the source tree.
+                   [OPTIONAL]
+  INSTALL_PREFIX : Install directory; defaults to build/release in the source
+                   tree. [OPTIONAL]
+"
+
+if [[ $1 == --help ]]; then
+  echo "${USAGE}"
+  exit 0
+fi
+
+
+set -o xtrace
+
+
+NUPIC_CORE_ROOT="$( cd "$( dirname "${BASH_SOURCE[0]}" )/.." && pwd )"
+
+# Apply defaults
+BUILD_DIR=${BUILD_DIR-"${NUPIC_CORE_ROOT}/build/pgo"}
+INSTALL_PREFIX=${INSTALL_PREFIX-"${NUPIC_CORE_ROOT}/build/release"}
+
+JOBS=$( getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1 )
+
+mkdir -p ${BUILD_DIR}
+cd ${BUILD_DIR}
+
+# Instrumented build and training run
+cmake ${NUPIC_CORE_ROOT} \
+    -DCMAKE_BUILD_TYPE=Release \
+    -DCMAKE_INSTALL_PREFIX=${INSTALL_PREFIX} \
+    -DNUPIC_PGO=GENERATE \
+    "$@"
+make -j${JOBS} pgo_training
+
+# Optimized build
+cmake ${NUPIC_CORE_ROOT} -DNUPIC_PGO=USE "$@"
+make -j${JOBS} install
@@ -45,8 +45,8 @@ int main(int argc, const char *argv[]) {
   const UInt DIM = 2048; // number of columns in SP, TP
   const UInt DIM_INPUT = 10000;
   const UInt TP_CELLS_PER_COL = 10; // cells per column in TP
-  const UInt EPOCHS =
-      pow(10, 4); // number of iterations (calls to SP/TP compute() )
+  // number of iterations (calls to SP/TP compute() ), the optional argument
+  const UInt EPOCHS = argc > 1 ? (UInt)atoi(argv[1]) : (UInt)pow(10, 4);
 
   vector<UInt> inputDim = {DIM_INPUT};
   vector<UInt> colDim = {DIM};
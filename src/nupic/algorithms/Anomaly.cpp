@@ -21,14 +21,16 @@
  */
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <numeric>
-#include <set>
 #include <vector>
 
 #include "nupic/algorithms/Anomaly.hpp"
+#include "nupic/math/ArrayAlgo.hpp"
 #include "nupic/utils/Log.hpp"
 #include "nupic/utils/MovingAverage.hpp"
+#include "nupic/utils/ThreadPool.hpp"
 
 using namespace std;
 
@@ -38,6 +40,12 @@ namespace algorithms {
 
 namespace anomaly {
 
+// Whether the indices are strictly increasing, i.e. sorted and unique
+static bool isSortedSet(const vector<UInt> &indices) {
+  return adjacent_find(indices.begin(), indices.end(),
+                       greater_equal<UInt>()) == indices.end();
+}
+
 Real32 computeRawAnomalyScore(const vector<UInt> &active,
                               const vector<UInt> &predicted) {
   // Return 0 if no active columns are present
@@ -45,15 +53,87 @@ Real32 computeRawAnomalyScore(const vector<UInt> &active,
     return 0.0f;
   }
 
-  set<UInt> active_{active.begin(), active.end()};
-  set<UInt> predicted_{predicted.begin(), predicted.end()};
-  vector<UInt> predictedActiveCols;
+  // Number of distinct predicted active columns
+  UInt overlap = 0;
+
+  if (isSortedSet(active) && isSortedSet(predicted)) {
+    // The usual case: merge the sorted indices
+    auto a = active.begin();
+    auto p = predicted.begin();
+    while (a != active.end() && p != predicted.end()) {
+      if (*a < *p) {
+        ++a;
+      } else if (*p < *a) {
+        ++p;
+      } else {
+        ++overlap;
+        ++a;
+        ++p;
+      }
+    }
+  } else {
+    // Mark the active columns in a bitset kept by each thread, so that it
+    // is only allocated when it grows. Predicted columns are unmarked once
+    // counted, so that duplicates count once, and the remaining marks are
+    // cleared for the next call.
+    static thread_local PackedSDR marks;
+    const UInt size = 1 + *max_element(active.begin(), active.end());
+    if (marks.size() < size)
+      marks.resize(size);
+    for (UInt i : active)
+      marks.set(i);
+    for (UInt i : predicted) {
+      if (i < size && marks.test(i)) {
+        ++overlap;
+        marks.reset(i);
+      }
+    }
+    for (UInt i : active)
+      marks.reset(i);
+  }
 
   // Calculate and return percent of active columns that were not predicted.
-  set_intersection(active_.begin(), active_.end(), predicted_.begin(),
-                   predicted_.end(), back_inserter(predictedActiveCols));
+  return (active.size() - overlap) / Real32(active.size());
+}
 
-  return (active.size() - predictedActiveCols.size()) / Real32(active.size());
+void computeRawAnomalyScores(const vector<vector<UInt>> &active,
+                             const vector<vector<UInt>> &predicted,
+                             Real32 *scores, UInt nThreads) {
+  NTA_CHECK(active.size() == predicted.size())
+      << "computeRawAnomalyScores: " << active.size() << " active SDRs but "
+      << predicted.size() << " predicted SDRs";
+  util::ThreadPool::shared().parallelFor(
+      0, (UInt)active.size(),
+      [&](UInt begin, UInt end) {
+        for (UInt i = begin; i != end; ++i)
+          scores[i] = computeRawAnomalyScore(active[i], predicted[i]);
+      },
+      256, nThreads);
+}
+
+Real32 computeRawAnomalyScore(const PackedSDR &active,
+                              const PackedSDR &predicted) {
+  const UInt nActive = active.count();
+  if (nActive == 0) {
+    return 0.0f;
+  }
+
+  return (nActive - active.overlap(predicted)) / Real32(nActive);
+}
+
+void computeRawAnomalyScores(const vector<PackedSDR> &active,
+                             const vector<PackedSDR> &predicted,
+                             Real32 *scores, UInt nThreads) {
+  NTA_CHECK(active.size() == predicted.size())
+      << "computeRawAnomalyScores: " << active.size() << " active SDRs but "
+      << predicted.size() << " predicted SDRs";
+  util::ThreadPool::shared().parallelFor(
+      0, (UInt)active.size(),
+      [&](UInt begin, UInt end) {
+        for (UInt i = begin; i != end; ++i)
+          scores[i] = computeRawAnomalyScore(active[i], predicted[i]);
+      },
+      256, nThreads);
 }
 
 Anomaly::Anomaly(UInt slidingWindowSize, AnomalyMode mode,
@@ -66,9 +146,9 @@ Anomaly::Anomaly(UInt slidingWindowSize, AnomalyMode mode,
     movingAverage_.reset(new nupic::util::MovingAverage(slidingWindowSize));
   }
 
-  // Not implemented. Fail.
-  NTA_ASSERT(mode_ == AnomalyMode::PURE)
-      << "C++ Anomaly implemented only for PURE mode!";
+  if (mode_ != AnomalyMode::PURE) {
+    likelihood_.reset(new AnomalyLikelihood());
+  }
 }
 
 Real32 Anomaly::compute(const vector<UInt> &active,
@@ -81,10 +161,12 @@ Real32 Anomaly::compute(const vector<UInt> &active,
     score = anomalyScore;
     break;
   case AnomalyMode::LIKELIHOOD:
+    // low likelihood -> hi anomaly, as in the Python Anomaly
+    score = Real32(1.0 - likelihood_->anomalyProbability(anomalyScore));
+    break;
   case AnomalyMode::WEIGHTED:
-    // Not implemented. Fail
-    NTA_ASSERT(mode_ == AnomalyMode::PURE)
-        << "C++ Anomaly implemented only for PURE mode!";
+    score = Real32(anomalyScore *
+                   (1.0 - likelihood_->anomalyProbability(anomalyScore)));
     break;
   }
 
@@ -99,6 +181,85 @@ Real32 Anomaly::compute(const vector<UInt> &active,
   return score;
 }
 
+void Anomaly::computeScores(vector<Anomaly> &anomalies,
+                            const vector<vector<UInt>> &active,
+                            const vector<vector<UInt>> &predicted,
+                            Real32 *scores, UInt nThreads) {
+  NTA_CHECK(active.size() == anomalies.size() &&
+            predicted.size() == anomalies.size())
+      << "Anomaly::computeScores: one active and one predicted SDR per "
+      << "Anomaly are required";
+  util::ThreadPool::shared().parallelFor(
+      0, (UInt)anomalies.size(),
+      [&](UInt begin, UInt end) {
+        for (UInt i = begin; i != end; ++i)
+          scores[i] = anomalies[i].compute(active[i], predicted[i]);
+      },
+      256, nThreads);
+}
+
+void Anomaly::write(AnomalyProto::Builder &proto) const {
+  switch (mode_) {
+  case AnomalyMode::PURE:
+    proto.setMode(AnomalyProto::Mode::PURE);
+    break;
+  case AnomalyMode::LIKELIHOOD:
+    proto.setMode(AnomalyProto::Mode::LIKELIHOOD);
+    break;
+  case AnomalyMode::WEIGHTED:
+    proto.setMode(AnomalyProto::Mode::WEIGHTED);
+    break;
+  }
+  proto.setBinaryThreshold(binaryThreshold_);
+
+  if (movingAverage_) {
+    const vector<Real32> window = movingAverage_->getSlidingWindow();
+    proto.setSlidingWindowSize(movingAverage_->getWindowSize());
+    auto slidingWindow = proto.initSlidingWindow(window.size());
+    for (UInt i = 0; i < window.size(); ++i)
+      slidingWindow.set(i, window[i]);
+  } else {
+    proto.setSlidingWindowSize(0);
+  }
+
+  if (likelihood_) {
+    auto likelihood = proto.initLikelihood();
+    likelihood_->write(likelihood);
+  }
+}
+
+void Anomaly::read(AnomalyProto::Reader &proto) {
+  switch (proto.getMode()) {
+  case AnomalyProto::Mode::PURE:
+    mode_ = AnomalyMode::PURE;
+    break;
+  case AnomalyProto::Mode::LIKELIHOOD:
+    mode_ = AnomalyMode::LIKELIHOOD;
+    break;
+  case AnomalyProto::Mode::WEIGHTED:
+    mode_ = AnomalyMode::WEIGHTED;
+    break;
+  }
+  binaryThreshold_ = proto.getBinaryThreshold();
+
+  movingAverage_.reset();
+  if (proto.getSlidingWindowSize() > 0) {
+    movingAverage_.reset(
+        new nupic::util::MovingAverage(proto.getSlidingWindowSize()));
+    for (auto value : proto.getSlidingWindow())
+      movingAverage_->compute(value);
+  }
+
+  likelihood_.reset();
+  if (mode_ != AnomalyMode::PURE) {
+    NTA_CHECK(proto.hasLikelihood())
+        << "AnomalyProto is missing the likelihood state";
+    likelihood_.reset(new AnomalyLikelihood());
+    auto likelihood = proto.getLikelihood();
+    likelihood_->read(likelihood);
+  }
+}
+
 } // namespace anomaly
 
 } // namespace algorithms
@@ -24,12 +24,17 @@
 #define NUPIC_ALGORITHMS_ANOMALY_HPP
 
 #include <memory> // Needed for smart pointer templates
+#include <nupic/algorithms/AnomalyLikelihood.hpp>
+#include <nupic/proto/AnomalyProto.capnp.h>
+#include <nupic/types/Serializable.hpp>
 #include <nupic/types/Types.hpp>
 #include <nupic/utils/MovingAverage.hpp> // Needed for for smart pointer templates
 #include <vector>
 
 namespace nupic {
 
+class PackedSDR; // Forward declaration
+
 namespace util {
 class MovingAverage; // Forward declaration
 }
@@ -42,6 +47,9 @@ namespace anomaly {
  * Computes the raw anomaly score.
  *
  * The raw anomaly score is the fraction of active columns not predicted.
+ * Sorted indices without duplicates, as output by the SpatialPooler and
+ * the TemporalMemory, are merged; other inputs are marked in a bitset
+ * reused by the calling thread. Neither allocates in steady state.
  *
  * @param activeColumns: array of active column indices
  * @param prevPredictedColumns: array of columns indices predicted in
@@ -51,9 +59,31 @@ namespace anomaly {
 Real32 computeRawAnomalyScore(const std::vector<UInt> &active,
                               const std::vector<UInt> &predicted);
 
+/**
+ * Same as above, for SDRs packed as bits (see PackedSDR in ArrayAlgo.hpp),
+ * which must have the same size.
+ */
+Real32 computeRawAnomalyScore(const PackedSDR &active,
+                              const PackedSDR &predicted);
+
+/**
+ * Computes the raw anomaly scores of many pairs of SDRs, scores[i] being
+ * the score of active[i] and predicted[i].
+ *
+ * @param nThreads upper bound on the threads used, 0 meaning the size of
+ *        the shared ThreadPool.
+ */
+void computeRawAnomalyScores(const std::vector<std::vector<UInt>> &active,
+                             const std::vector<std::vector<UInt>> &predicted,
+                             Real32 *scores, UInt nThreads = 0);
+
+void computeRawAnomalyScores(const std::vector<PackedSDR> &active,
+                             const std::vector<PackedSDR> &predicted,
+                             Real32 *scores, UInt nThreads = 0);
+
 enum class AnomalyMode { PURE, LIKELIHOOD, WEIGHTED };
 
-class Anomaly {
+class Anomaly : public Serializable<AnomalyProto> {
 public:
   /**
    * Utility class for generating anomaly scores in different ways.
@@ -61,10 +91,9 @@ public:
    * Supported modes:
    *    PURE - the raw anomaly score as computed by computeRawAnomalyScore
    *    LIKELIHOOD - uses the AnomalyLikelihood class on top of the raw
-   *        anomaly scores (not implemented in C++)
+   *        anomaly scores
    *    WEIGHTED - multiplies the likelihood result with the raw anomaly
-   *        score that was used to generate the likelihood (not
-   *        implemented in C++)
+   *        score that was used to generate the likelihood
    *
    *    @param slidingWindowSize (optional) - how many elements are
    *        summed up; enables moving average on final anomaly score;
@@ -75,9 +104,9 @@ public:
    *              Real32 0..1 where 1=totally unexpected
    *          - LIKELIHOOD - uses the anomaly_likelihood code;
    *              models probability of receiving this value and
-   *              anomalyScore
+   *              anomalyScore; 1 - likelihood, as in the Python Anomaly
    *          - WEIGHTED - "pure" anomaly weighted by "likelihood"
-   *              (anomaly * likelihood)
+   *              (anomaly * (1 - likelihood))
    *    @param binaryAnomalyThreshold (optional) - if set [0,1] anomaly
    *        score will be discretized to 1/0
    *        (1 iff >= binaryAnomalyThreshold). The transformation is
@@ -104,10 +133,43 @@ public:
                  const std::vector<UInt> &predicted, Real64 inputValue = 0,
                  UInt timestamp = 0);
 
+  /**
+   * Computes the next score of many Anomaly instances, e.g. one per model,
+   * scores[i] being the score of anomalies[i] for active[i] and
+   * predicted[i]. The instances are independent, so that the result does
+   * not depend on the number of threads.
+   *
+   * @param nThreads upper bound on the threads used, 0 meaning the size of
+   *        the shared ThreadPool.
+   */
+  static void computeScores(std::vector<Anomaly> &anomalies,
+                            const std::vector<std::vector<UInt>> &active,
+                            const std::vector<std::vector<UInt>> &predicted,
+                            Real32 *scores, UInt nThreads = 0);
+
+  AnomalyMode getMode() const { return mode_; }
+
+  /**
+   * The likelihood model of the LIKELIHOOD and WEIGHTED modes, null in
+   * PURE mode.
+   */
+  const AnomalyLikelihood *getLikelihood() const { return likelihood_.get(); }
+
+  using Serializable::write;
+  void write(AnomalyProto::Builder &proto) const override;
+
+  /**
+   * Restores the state. The total of the moving average is recomputed from
+   * its window.
+   */
+  using Serializable::read;
+  void read(AnomalyProto::Reader &proto) override;
+
 private:
   AnomalyMode mode_;
   Real32 binaryThreshold_;
   std::unique_ptr<nupic::util::MovingAverage> movingAverage_;
+  std::unique_ptr<AnomalyLikelihood> likelihood_;
 };
 } // namespace anomaly
 } // namespace algorithms
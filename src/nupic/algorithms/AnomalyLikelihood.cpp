@@ -0,0 +1,267 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "nupic/algorithms/AnomalyLikelihood.hpp"
+#include "nupic/utils/Log.hpp"
+#include "nupic/utils/ThreadPool.hpp"
+
+using namespace std;
+
+namespace nupic {
+
+namespace algorithms {
+
+namespace anomaly {
+
+// Lower bounds of the estimated distribution, as in the Python estimateNormal
+static const Real64 MIN_MEAN = 0.03;
+static const Real64 MIN_VARIANCE = 0.0003;
+
+// Tail probabilities of the red and yellow zones, as in the Python
+// _filterLikelihoods
+static const Real64 RED_ZONE = 1.0 - 0.99999;
+static const Real64 YELLOW_ZONE = 1.0 - 0.999;
+
+bool AnomalyLikelihood::Window::push(Real64 value, Real64 &evicted) {
+  if (values.size() < capacity) {
+    values.push_back(value);
+    return false;
+  }
+  evicted = values[next];
+  values[next] = value;
+  if (++next == capacity)
+    next = 0;
+  return true;
+}
+
+bool AnomalyLikelihood::Window::operator==(const Window &other) const {
+  return capacity == other.capacity && next == other.next &&
+         values == other.values;
+}
+
+AnomalyLikelihood::AnomalyLikelihood(UInt learningPeriod,
+                                     UInt estimationSamples,
+                                     UInt historicWindowSize,
+                                     UInt reestimationPeriod,
+                                     UInt averagingWindow)
+    : learningPeriod_(learningPeriod), estimationSamples_(estimationSamples),
+      reestimationPeriod_(reestimationPeriod), iteration_(0),
+      rawScoresTotal_(0), averagedScoresMean_(0), averagedScoresM2_(0),
+      estimated_(false), mean_(0), variance_(0), stdev_(0),
+      previousTail_(1.0) {
+  NTA_CHECK(historicWindowSize > 0) << "historicWindowSize must be > 0";
+  NTA_CHECK(reestimationPeriod > 0) << "reestimationPeriod must be > 0";
+  NTA_CHECK(averagingWindow > 0) << "averagingWindow must be > 0";
+  rawScores_.capacity = averagingWindow;
+  rawScores_.next = 0;
+  rawScores_.values.reserve(averagingWindow);
+  averagedScores_.capacity = historicWindowSize;
+  averagedScores_.next = 0;
+  averagedScores_.values.reserve(historicWindowSize);
+}
+
+Real64 AnomalyLikelihood::anomalyProbability(Real64 rawScore) {
+  const bool first = rawScores_.values.empty();
+  const Real64 previousAverage =
+      first ? 0 : rawScoresTotal_ / rawScores_.values.size();
+
+  // Rolling average of the raw scores, this one included. The total is
+  // recomputed once per pass over the window, so that rounding errors do
+  // not accumulate.
+  Real64 evicted;
+  if (!rawScores_.push(rawScore, evicted)) {
+    rawScoresTotal_ += rawScore;
+  } else if (rawScores_.next != 0) {
+    rawScoresTotal_ += rawScore - evicted;
+  } else {
+    rawScoresTotal_ = accumulate(rawScores_.values.begin(),
+                                 rawScores_.values.end(), 0.0);
+  }
+  const Real64 average = rawScoresTotal_ / rawScores_.values.size();
+
+  Real64 likelihood = 0.5;
+  if (iteration_ >= getProbationaryPeriod()) {
+    if (!estimated_ || iteration_ % reestimationPeriod_ == 0) {
+      estimate_();
+      // Python recomputes the tail probabilities of the history with the
+      // new distribution, and filters against those.
+      if (!first)
+        previousTail_ = tailProbability(previousAverage, mean_, stdev_);
+    }
+    const Real64 tail = tailProbability(average, mean_, stdev_);
+    const bool repeated = tail <= RED_ZONE && previousTail_ <= RED_ZONE;
+    likelihood = 1.0 - (repeated ? YELLOW_ZONE : tail);
+    previousTail_ = tail;
+  }
+
+  // The distribution leaves out the scores of the learning period. Its
+  // running mean and variance are updated as in Welford's algorithm, with
+  // the same periodic recomputation as the total above.
+  if (iteration_ >= learningPeriod_) {
+    if (!averagedScores_.push(average, evicted)) {
+      const Real64 delta = average - averagedScoresMean_;
+      averagedScoresMean_ += delta / averagedScores_.values.size();
+      averagedScoresM2_ += delta * (average - averagedScoresMean_);
+    } else if (averagedScores_.next != 0) {
+      const Real64 previousMean = averagedScoresMean_;
+      averagedScoresMean_ += (average - evicted) / averagedScores_.capacity;
+      averagedScoresM2_ += (average - evicted) *
+                           (average - averagedScoresMean_ + evicted -
+                            previousMean);
+    } else {
+      const auto &values = averagedScores_.values;
+      averagedScoresMean_ =
+          accumulate(values.begin(), values.end(), 0.0) / values.size();
+      averagedScoresM2_ = 0;
+      for (Real64 v : values)
+        averagedScoresM2_ +=
+            (v - averagedScoresMean_) * (v - averagedScoresMean_);
+    }
+  }
+
+  ++iteration_;
+  return likelihood;
+}
+
+void AnomalyLikelihood::estimate_() {
+  const size_t n = averagedScores_.values.size();
+  if (n == 0) {
+    // The "null distribution" of the Python implementation
+    mean_ = 0.5;
+    variance_ = 1e6;
+  } else {
+    mean_ = max(averagedScoresMean_, MIN_MEAN);
+    variance_ = max(averagedScoresM2_ / n, MIN_VARIANCE);
+  }
+  stdev_ = sqrt(variance_);
+  estimated_ = true;
+}
+
+Real64 AnomalyLikelihood::tailProbability(Real64 x, Real64 mean,
+                                          Real64 stdev) {
+  // Q(z) = erfc(z / sqrt(2)) / 2, symmetric around the mean
+  const Real64 z = fabs(x - mean) / stdev;
+  return 0.5 * erfc(z * 0.70710678118654752440);
+}
+
+void AnomalyLikelihood::anomalyProbabilities(
+    vector<AnomalyLikelihood> &streams, const Real64 *rawScores,
+    Real64 *likelihoods, UInt nThreads) {
+  util::ThreadPool::shared().parallelFor(
+      0, (UInt)streams.size(),
+      [&](UInt begin, UInt end) {
+        for (UInt i = begin; i != end; ++i)
+          likelihoods[i] = streams[i].anomalyProbability(rawScores[i]);
+      },
+      1024, nThreads);
+}
+
+void AnomalyLikelihood::write(AnomalyLikelihoodProto::Builder &proto) const {
+  proto.setLearningPeriod(learningPeriod_);
+  proto.setEstimationSamples(estimationSamples_);
+  proto.setHistoricWindowSize(averagedScores_.capacity);
+  proto.setReestimationPeriod(reestimationPeriod_);
+  proto.setAveragingWindow(rawScores_.capacity);
+  proto.setIteration(iteration_);
+
+  auto rawScores = proto.initRawScores(rawScores_.values.size());
+  for (UInt i = 0; i < rawScores_.values.size(); ++i)
+    rawScores.set(i, rawScores_.values[i]);
+  proto.setRawScoresNext(rawScores_.next);
+  proto.setRawScoresTotal(rawScoresTotal_);
+
+  auto averagedScores = proto.initAveragedScores(averagedScores_.values.size());
+  for (UInt i = 0; i < averagedScores_.values.size(); ++i)
+    averagedScores.set(i, averagedScores_.values[i]);
+  proto.setAveragedScoresNext(averagedScores_.next);
+  proto.setAveragedScoresMean(averagedScoresMean_);
+  proto.setAveragedScoresM2(averagedScoresM2_);
+
+  proto.setEstimated(estimated_);
+  auto distribution = proto.initDistribution();
+  distribution.setMean(mean_);
+  distribution.setVariance(variance_);
+  proto.setPreviousTail(previousTail_);
+}
+
+void AnomalyLikelihood::read(AnomalyLikelihoodProto::Reader &proto) {
+  learningPeriod_ = proto.getLearningPeriod();
+  estimationSamples_ = proto.getEstimationSamples();
+  reestimationPeriod_ = proto.getReestimationPeriod();
+  iteration_ = proto.getIteration();
+  NTA_CHECK(reestimationPeriod_ > 0) << "reestimationPeriod must be > 0";
+
+  rawScores_.capacity = proto.getAveragingWindow();
+  rawScores_.next = proto.getRawScoresNext();
+  rawScores_.values.clear();
+  rawScores_.values.reserve(rawScores_.capacity);
+  for (auto v : proto.getRawScores())
+    rawScores_.values.push_back(v);
+  rawScoresTotal_ = proto.getRawScoresTotal();
+  NTA_CHECK(rawScores_.capacity > 0 &&
+            rawScores_.values.size() <= rawScores_.capacity &&
+            rawScores_.next < rawScores_.capacity)
+      << "Invalid rolling average in AnomalyLikelihoodProto";
+
+  averagedScores_.capacity = proto.getHistoricWindowSize();
+  averagedScores_.next = proto.getAveragedScoresNext();
+  averagedScores_.values.clear();
+  averagedScores_.values.reserve(averagedScores_.capacity);
+  for (auto v : proto.getAveragedScores())
+    averagedScores_.values.push_back(v);
+  averagedScoresMean_ = proto.getAveragedScoresMean();
+  averagedScoresM2_ = proto.getAveragedScoresM2();
+  NTA_CHECK(averagedScores_.capacity > 0 &&
+            averagedScores_.values.size() <= averagedScores_.capacity &&
+            averagedScores_.next < averagedScores_.capacity)
+      << "Invalid historic window in AnomalyLikelihoodProto";
+
+  estimated_ = proto.getEstimated();
+  mean_ = proto.getDistribution().getMean();
+  variance_ = proto.getDistribution().getVariance();
+  stdev_ = sqrt(variance_);
+  previousTail_ = proto.getPreviousTail();
+}
+
+bool AnomalyLikelihood::operator==(const AnomalyLikelihood &other) const {
+  return learningPeriod_ == other.learningPeriod_ &&
+         estimationSamples_ == other.estimationSamples_ &&
+         reestimationPeriod_ == other.reestimationPeriod_ &&
+         iteration_ == other.iteration_ && rawScores_ == other.rawScores_ &&
+         rawScoresTotal_ == other.rawScoresTotal_ &&
+         averagedScores_ == other.averagedScores_ &&
+         averagedScoresMean_ == other.averagedScoresMean_ &&
+         averagedScoresM2_ == other.averagedScoresM2_ &&
+         estimated_ == other.estimated_ && mean_ == other.mean_ &&
+         variance_ == other.variance_ &&
+         previousTail_ == other.previousTail_;
+}
+
+} // namespace anomaly
+
+} // namespace algorithms
+
+} // namespace nupic
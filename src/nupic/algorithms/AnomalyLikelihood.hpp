@@ -0,0 +1,181 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+#ifndef NUPIC_ALGORITHMS_ANOMALY_LIKELIHOOD_HPP
+#define NUPIC_ALGORITHMS_ANOMALY_LIKELIHOOD_HPP
+
+#include <vector>
+
+#include <nupic/proto/AnomalyProto.capnp.h>
+#include <nupic/types/Serializable.hpp>
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+namespace algorithms {
+
+namespace anomaly {
+
+/**
+ * Streaming anomaly likelihood, as in nupic.algorithms.anomaly_likelihood.
+ *
+ * The raw anomaly scores of a stream are smoothed by a rolling average, and
+ * the averages of the last historicWindowSize records are modeled as a
+ * normal distribution. The likelihood of a record is the probability, under
+ * this distribution, of an average at least as unusual as its own: values
+ * close to 1 indicate an anomaly.
+ *
+ * Unlike the Python implementation, which re-estimates the distribution
+ * from the whole history every reestimationPeriod records, the mean and
+ * variance of the window are maintained incrementally, so that each record
+ * costs O(1). The averages of the first records of the window are the
+ * rolling averages of the stream, rather than averages restarted at the
+ * start of the window, which only matters while the window is filling up.
+ *
+ * During the first learningPeriod + estimationSamples records, the
+ * likelihood is 0.5.
+ *
+ * As in the Python _filterLikelihoods, a tail probability in the red zone
+ * (<= 1e-5) that follows another one in the red zone is raised to the
+ * yellow threshold (1e-3), so that an anomaly is reported once rather
+ * than on each of its records.
+ */
+class AnomalyLikelihood : public Serializable<AnomalyLikelihoodProto> {
+public:
+  /**
+   * @param learningPeriod number of records at the start of the stream
+   *        whose scores are left out of the distribution, while the model
+   *        learns.
+   * @param estimationSamples number of records after the learning period
+   *        used for the first estimate of the distribution.
+   * @param historicWindowSize number of records the distribution is
+   *        estimated from.
+   * @param reestimationPeriod number of records between the updates of the
+   *        distribution used for the likelihoods.
+   * @param averagingWindow size of the rolling average of the raw scores.
+   */
+  AnomalyLikelihood(UInt learningPeriod = 288, UInt estimationSamples = 100,
+                    UInt historicWindowSize = 8640,
+                    UInt reestimationPeriod = 100, UInt averagingWindow = 10);
+
+  /**
+   * Adds the raw anomaly score of the next record, and returns its
+   * likelihood.
+   *
+   * @param rawScore raw anomaly score of the record, in [0, 1].
+   * @return the likelihood, in [0, 1]
+   */
+  Real64 anomalyProbability(Real64 rawScore);
+
+  /**
+   * Scores the next record of many streams, rawScores[i] being the score of
+   * streams[i]. Streams are independent, so that the result does not
+   * depend on the number of threads.
+   *
+   * @param nThreads upper bound on the threads used, 0 meaning the size of
+   *        the shared ThreadPool.
+   */
+  static void anomalyProbabilities(std::vector<AnomalyLikelihood> &streams,
+                                   const Real64 *rawScores,
+                                   Real64 *likelihoods, UInt nThreads = 0);
+
+  /**
+   * Probability that a normal variable is further from the mean than x,
+   * on the same side: Q(|x - mean| / stdev), with Q the tail function of
+   * the standard normal distribution.
+   */
+  static Real64 tailProbability(Real64 x, Real64 mean, Real64 stdev);
+
+  /**
+   * Number of records seen.
+   */
+  UInt64 getIteration() const { return iteration_; }
+
+  /**
+   * Number of records during which the likelihood is 0.5.
+   */
+  UInt getProbationaryPeriod() const {
+    return learningPeriod_ + estimationSamples_;
+  }
+
+  /**
+   * The distribution of the last likelihood, or 0 before the end of the
+   * probationary period.
+   */
+  Real64 getMean() const { return mean_; }
+  Real64 getVariance() const { return variance_; }
+
+  using Serializable::write;
+  void write(AnomalyLikelihoodProto::Builder &proto) const override;
+
+  using Serializable::read;
+  void read(AnomalyLikelihoodProto::Reader &proto) override;
+
+  bool operator==(const AnomalyLikelihood &other) const;
+  inline bool operator!=(const AnomalyLikelihood &other) const {
+    return !operator==(other);
+  }
+
+private:
+  // Fixed-capacity ring buffer of the last values of a stream
+  struct Window {
+    std::vector<Real64> values;
+    UInt capacity;
+    // Index of the oldest value, once full
+    UInt next;
+
+    // Returns the value that was replaced, if the window was full
+    bool push(Real64 value, Real64 &evicted);
+
+    bool operator==(const Window &other) const;
+  };
+
+  // Estimates the distribution from the averaged scores of the window
+  void estimate_();
+
+  UInt learningPeriod_;
+  UInt estimationSamples_;
+  UInt reestimationPeriod_;
+  UInt64 iteration_;
+
+  Window rawScores_;
+  Real64 rawScoresTotal_;
+
+  Window averagedScores_;
+  Real64 averagedScoresMean_;
+  // Sum of the squared deviations from the mean (Welford)
+  Real64 averagedScoresM2_;
+
+  bool estimated_;
+  Real64 mean_;
+  Real64 variance_;
+  Real64 stdev_;
+
+  // Unfiltered tail probability of the previous record, for the filter
+  Real64 previousTail_;
+};
+
+} // namespace anomaly
+} // namespace algorithms
+} // namespace nupic
+
+#endif // NUPIC_ALGORITHMS_ANOMALY_LIKELIHOOD_HPP
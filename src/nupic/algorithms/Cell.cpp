@@ -20,6 +20,8 @@
  * ---------------------------------------------------------------------
  */
 
+#include <atomic>
+
 #include <nupic/algorithms/Cell.hpp>
 #include <nupic/proto/Cell.capnp.h>
 
@@ -40,7 +42,8 @@ Cell::Cell() : _segments(0), _freeSegments(0) {}
  * the max activity, different segments can get chosen.
  * The variable has no functional impact as far as accuracy is concerned.
  */
-static bool cellMatchPythonSegOrder = false;
+// Atomic, since it can be set while other threads run Cells4 instances.
+static std::atomic<bool> cellMatchPythonSegOrder(false);
 
 void Cell::setSegmentOrder(bool matchPythonOrder) {
   if (matchPythonOrder) {
@@ -152,14 +152,14 @@ bool Cells4::computeUpdate(UInt cellIdx, UInt segIdx,
     NTA_ASSERT(segIdx == (UInt)-1 || segIdx < _cells[cellIdx].size());
   }
 
-  static std::vector<UInt> newSynapses;
+  thread_local std::vector<UInt> newSynapses;
   newSynapses.clear(); // purge residual data
 
   if (segIdx != (UInt)-1) { // not a new segment
 
     Segment &segment = _cells[cellIdx][segIdx];
 
-    static UInt highWaterSize = 0;
+    thread_local UInt highWaterSize = 0;
     if (highWaterSize < segment.size()) {
       highWaterSize = segment.size();
       newSynapses.reserve(highWaterSize);
@@ -283,7 +283,7 @@ void Cells4::inferBacktrack(const std::vector<UInt> &activeColumns) {
   // up to the current time step and remove all the ones at the head of the
   // input history queue so that we don't waste time evaluating them again at
   // a later time step.
-  static std::vector<UInt> badPatterns;
+  thread_local std::vector<UInt> badPatterns;
   badPatterns.clear(); // purge residual data
 
   //---------------------------------------------------------------------------
@@ -535,7 +535,7 @@ UInt Cells4::learnBacktrack() {
   // up to the current time step and remove all the ones at the head of the
   // input history queue so that we don't waste time evaluating them again at
   // a later time step.
-  static std::vector<UInt> badPatterns;
+  thread_local std::vector<UInt> badPatterns;
   badPatterns.clear(); // purge residual data
 
   //---------------------------------------------------------------------------
@@ -631,7 +631,7 @@ UInt Cells4::getCellForNewSegment(UInt colIdx) {
   //  represent an 'A' in both context 1 and context 2. This is because the
   //  cell indices we choose in each column of a pattern will advance in
   //  lockstep (i.e. we pick cell indices of 1, then cell indices of 2, etc.).
-  static std::vector<UInt> candidateCellIdxs;
+  thread_local std::vector<UInt> candidateCellIdxs;
   candidateCellIdxs.clear(); // purge residual data
   UInt minIdx = getCellIdx(colIdx, 0), maxIdx = getCellIdx(colIdx, 0);
   if (_nCellsPerCol > 0) {
@@ -1197,7 +1197,7 @@ void Cells4::compute(Real *input, Real *output, bool doInference,
 #endif
 
   // Create array of active bottom up column indices for later use
-  static std::vector<UInt> activeColumns;
+  thread_local std::vector<UInt> activeColumns;
   activeColumns.clear(); // purge residual data
   for (UInt i = 0; i != _nColumns; ++i) {
     if (input[i])
@@ -1363,7 +1363,7 @@ void Cells4::compute(Real *input, Real *output, bool doInference,
   }
 #endif // NTA_ARCH_32/64
 #else  // some states indexed
-  static std::vector<UInt> cellsOn;
+  thread_local std::vector<UInt> cellsOn;
   std::vector<UInt>::iterator iterOn;
   cellsOn = _infPredictedStateT.cellsOn();
   for (iterOn = cellsOn.begin(); iterOn != cellsOn.end(); ++iterOn)
@@ -1403,7 +1403,7 @@ void Cells4::_updateAvgLearnedSeqLength(UInt prevSeqLength) {
  * Go through the list of accumulated segment updates and process them.
  */
 void Cells4::processSegmentUpdates(Real *input, const CState &predictedState) {
-  static std::vector<UInt> delUpdates;
+  thread_local std::vector<UInt> delUpdates;
   delUpdates.clear(); // purge residual data
 
   for (UInt i = 0; i != _segmentUpdates.size(); ++i) {
@@ -1461,7 +1461,7 @@ void Cells4::processSegmentUpdates(Real *input, const CState &predictedState) {
  * cellIdx, segIdx.
  */
 void Cells4::cleanUpdatesList(UInt cellIdx, UInt segIdx) {
-  static std::vector<UInt> delUpdates;
+  thread_local std::vector<UInt> delUpdates;
   delUpdates.clear(); // purge residual data
 
   for (UInt i = 0; i != _segmentUpdates.size(); ++i) {
@@ -1508,7 +1508,7 @@ void Cells4::applyGlobalDecay() {
 
         if (age > _maxAge) {
 
-          static std::vector<UInt> removedSynapses;
+          thread_local std::vector<UInt> removedSynapses;
           removedSynapses.clear(); // purge residual data
           nSegmentsDecayed++;
 
@@ -1637,15 +1637,15 @@ void Cells4::adaptSegment(const SegmentUpdate &update) {
 
     // Tracks source cell indexes corresponding to synapses in
     // the given segment that have been removed during execution of this method
-    static std::vector<UInt> removed;
+    thread_local std::vector<UInt> removed;
     // Source cell indexes corresponding to synapses in the given segment whose
     // permances are to be decremented/incremented; ordered by index of those
     // synapses within the segment
-    static std::vector<UInt> synToDec, synToInc;
+    thread_local std::vector<UInt> synToDec, synToInc;
     // Indexes of synapses within the current segment corresponding to synapses
     // that are inactive/active in ascending order; these variables correlate
     // with synToDec and synToInc.
-    static std::vector<UInt> inactiveSegmentIndices, activeSegmentIndices;
+    thread_local std::vector<UInt> inactiveSegmentIndices, activeSegmentIndices;
 
     // Purge residual data from static variable; the others will be purged by
     // _generateListsOfSynapsesToAdjustForAdaptSegment
@@ -1776,7 +1776,7 @@ void Cells4::trimOldSegments(UInt maxAge) {
       UInt age = _nLrnIterations - seg._lastActiveIteration;
 
       if ((age > maxAge) && (seg.nConnected() < _activationThreshold)) {
-        static std::vector<UInt> removedSynapses;
+        thread_local std::vector<UInt> removedSynapses;
         removedSynapses.clear(); // purge residual data
 
         for (UInt i = 0; i != seg.size(); ++i)
@@ -2250,7 +2250,7 @@ void Cells4::addNewSegment(
 
   UInt cellIdx = colIdx * _nCellsPerCol + cellIdxInCol;
 
-  static std::vector<UInt> synapses;
+  thread_local std::vector<UInt> synapses;
   synapses.resize(extSynapses.size()); // how many slots we need
   for (UInt i = 0; i != extSynapses.size(); ++i)
     synapses[i] = extSynapses[i].first * _nCellsPerCol + extSynapses[i].second;
@@ -2271,7 +2271,7 @@ void Cells4::updateSegment(
   UInt cellIdx = colIdx * _nCellsPerCol + cellIdxInCol;
   bool sequenceSegmentFlag = segment(cellIdx, segIdx).isSequenceSegment();
 
-  static std::vector<UInt> synapses;
+  thread_local std::vector<UInt> synapses;
   synapses.resize(extSynapses.size()); // how many slots we need
   for (UInt i = 0; i != extSynapses.size(); ++i)
     synapses[i] = extSynapses[i].first * _nCellsPerCol + extSynapses[i].second;
@@ -2573,16 +2573,16 @@ void Cells4::chooseCellsToLearnFrom(UInt cellIdx, UInt segIdx, UInt nSynToAdd,
 
   // start with a sorted vector of all the cells that are on in the current
   // state
-  static std::vector<UInt> vecCellBuffer;
+  thread_local std::vector<UInt> vecCellBuffer;
   vecCellBuffer = state.cellsOn(true);
 
   // remove any cells already in this segment
-  static std::vector<UInt> vecPruned;
+  thread_local std::vector<UInt> vecPruned;
   if (segIdx != (UInt)-1) {
 
     // collect the sorted list of source cell indices
     Segment segThis = _cells[cellIdx][segIdx];
-    static std::vector<UInt> vecAlreadyHave;
+    thread_local std::vector<UInt> vecAlreadyHave;
     if (vecAlreadyHave.capacity() < segThis.size())
       vecAlreadyHave.reserve(segThis.size());
     vecAlreadyHave.clear(); // purge residual data
@@ -2656,7 +2656,7 @@ std::pair<UInt, UInt> Cells4::trimSegments(Real minPermanence,
   for (UInt cellIdx = 0; cellIdx != _nCells; ++cellIdx) {
     for (UInt segIdx = 0; segIdx != _cells[cellIdx].size(); ++segIdx) {
 
-      static std::vector<UInt> removedSynapses;
+      thread_local std::vector<UInt> removedSynapses;
       removedSynapses.clear(); // purge residual data
 
       Segment &seg = segment(cellIdx, segIdx);
@@ -2869,7 +2869,7 @@ void Cells4::computeForwardPropagation(CStateIndexed &state) {
   // activity coming into a cell.
 
   // process all cells that are on in the current state
-  static std::vector<UInt> vecCellBuffer;
+  thread_local std::vector<UInt> vecCellBuffer;
   vecCellBuffer = state.cellsOn();
   std::vector<UInt>::iterator iterCellBuffer;
   for (iterCellBuffer = vecCellBuffer.begin();
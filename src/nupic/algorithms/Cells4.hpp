@@ -189,7 +189,7 @@ public:
     if (_size == 0) {
       std::cout << "Reset width=" << sizeof(It) << " all zeroes" << std::endl;
     } else {
-      static std::vector<It> vectStat;
+      thread_local std::vector<It> vectStat;
       vectStat.clear();
       UInt ndxStat;
       for (ndxStat = 0; ndxStat < _size; ndxStat++)
@@ -42,10 +42,25 @@ using namespace nupic::algorithms::connections;
 
 static const Permanence EPSILON = 0.00001;
 
-Connections::Connections(CellIdx numCells) { initialize(numCells); }
+Connections::Connections(CellIdx numCells, SegmentIdx maxSegmentsPerCell,
+                         SynapseIdx maxSynapsesPerSegment) {
+  initialize(numCells, maxSegmentsPerCell, maxSynapsesPerSegment);
+}
 
-void Connections::initialize(CellIdx numCells) {
+void Connections::initialize(CellIdx numCells, SegmentIdx maxSegmentsPerCell,
+                             SynapseIdx maxSynapsesPerSegment) {
   cells_ = vector<CellData>(numCells);
+  segments_.clear();
+  destroyedSegments_.clear();
+  synapses_.clear();
+  destroyedSynapses_.clear();
+  segmentOrdinals_.clear();
+  synapseOrdinals_.clear();
+
+  cellSegments_.initialize(maxSegmentsPerCell);
+  segmentSynapses_.initialize(maxSynapsesPerSegment);
+  synapsesForPresynapticCell_.clear();
+  presynapticSynapses_.initialize(std::numeric_limits<UInt32>::max());
 
   // Every time a segment or synapse is created, we assign it an ordinal and
   // increment the nextOrdinal. Ordinals are never recycled, so they can be used
@@ -67,7 +82,14 @@ void Connections::unsubscribe(UInt32 token) {
   eventHandlers_.erase(token);
 }
 
+bool Connections::hasSubscribers() const { return !eventHandlers_.empty(); }
+
 Segment Connections::createSegment(CellIdx cell) {
+  CellData &cellData = cells_[cell];
+  NTA_CHECK(cellData.segments.size < cellSegments_.maxSize())
+      << "Cell " << cell << " already has " << cellSegments_.maxSize()
+      << " segments";
+
   Segment segment;
   if (destroyedSegments_.size() > 0) {
     segment = destroyedSegments_.back();
@@ -81,9 +103,8 @@ Segment Connections::createSegment(CellIdx cell) {
   SegmentData &segmentData = segments_[segment];
   segmentData.cell = cell;
 
-  CellData &cellData = cells_[cell];
   segmentOrdinals_[segment] = nextSegmentOrdinal_++;
-  cellData.segments.push_back(segment);
+  cellSegments_.push_back(cellData.segments, segment);
 
   for (auto h : eventHandlers_) {
     h.second->onCreateSegment(segment);
@@ -95,6 +116,10 @@ Segment Connections::createSegment(CellIdx cell) {
 Synapse Connections::createSynapse(Segment segment, CellIdx presynapticCell,
                                    Permanence permanence) {
   NTA_CHECK(permanence > 0);
+  SegmentData &segmentData = segments_[segment];
+  NTA_CHECK(segmentData.synapses.size < segmentSynapses_.maxSize())
+      << "Segment " << segment << " already has "
+      << segmentSynapses_.maxSize() << " synapses";
 
   Synapse synapse;
   if (destroyedSynapses_.size() > 0) {
@@ -111,11 +136,14 @@ Synapse Connections::createSynapse(Segment segment, CellIdx presynapticCell,
   synapseData.presynapticCell = presynapticCell;
   synapseData.permanence = permanence;
 
-  SegmentData &segmentData = segments_[segment];
   synapseOrdinals_[synapse] = nextSynapseOrdinal_++;
-  segmentData.synapses.push_back(synapse);
+  segmentSynapses_.push_back(segmentData.synapses, synapse);
 
-  synapsesForPresynapticCell_[presynapticCell].push_back(synapse);
+  if (presynapticCell >= synapsesForPresynapticCell_.size()) {
+    synapsesForPresynapticCell_.resize(presynapticCell + 1);
+  }
+  presynapticSynapses_.push_back(synapsesForPresynapticCell_[presynapticCell],
+                                 synapse);
 
   for (auto h : eventHandlers_) {
     h.second->onCreateSynapse(synapse);
@@ -126,32 +154,38 @@ Synapse Connections::createSynapse(Segment segment, CellIdx presynapticCell,
 
 bool Connections::segmentExists_(Segment segment) const {
   const SegmentData &segmentData = segments_[segment];
-  const vector<Segment> &segmentsOnCell = cells_[segmentData.cell].segments;
+  const SegmentList segmentsOnCell = segmentsForCell(segmentData.cell);
   return (std::find(segmentsOnCell.begin(), segmentsOnCell.end(), segment) !=
           segmentsOnCell.end());
 }
 
 bool Connections::synapseExists_(Synapse synapse) const {
   const SynapseData &synapseData = synapses_[synapse];
-  const vector<Synapse> &synapsesOnSegment =
-      segments_[synapseData.segment].synapses;
+  const SynapseList synapsesOnSegment =
+      synapsesForSegment(synapseData.segment);
   return (std::find(synapsesOnSegment.begin(), synapsesOnSegment.end(),
                     synapse) != synapsesOnSegment.end());
 }
 
 void Connections::removeSynapseFromPresynapticMap_(Synapse synapse) {
   const SynapseData &synapseData = synapses_[synapse];
-  vector<Synapse> &presynapticSynapses =
+  ListPool<Synapse>::List &presynapticSynapses =
       synapsesForPresynapticCell_.at(synapseData.presynapticCell);
 
-  auto it = std::find(presynapticSynapses.begin(), presynapticSynapses.end(),
-                      synapse);
-  NTA_ASSERT(it != presynapticSynapses.end());
-  presynapticSynapses.erase(it);
+  const Synapse *first = presynapticSynapses_.data(presynapticSynapses);
+  const Synapse *last = first + presynapticSynapses.size;
+  const Synapse *it = std::find(first, last, synapse);
+  NTA_ASSERT(it != last);
+  presynapticSynapses_.erase(presynapticSynapses, (UInt32)(it - first));
+}
 
-  if (presynapticSynapses.size() == 0) {
-    synapsesForPresynapticCell_.erase(synapseData.presynapticCell);
-  }
+SynapseList
+Connections::synapsesOnPresynapticCell_(CellIdx presynapticCell) const {
+  static const ListPool<Synapse>::List empty;
+  return presynapticSynapses_.view(
+      presynapticCell < synapsesForPresynapticCell_.size()
+          ? synapsesForPresynapticCell_[presynapticCell]
+          : empty);
 }
 
 void Connections::destroySegment(Segment segment) {
@@ -161,25 +195,27 @@ void Connections::destroySegment(Segment segment) {
   }
 
   SegmentData &segmentData = segments_[segment];
-  for (Synapse synapse : segmentData.synapses) {
+  for (Synapse synapse : synapsesForSegment(segment)) {
     // Don't call destroySynapse, since it's unnecessary to do index-shifting.
     removeSynapseFromPresynapticMap_(synapse);
     destroyedSynapses_.push_back(synapse);
   }
-  segmentData.synapses.clear();
+  segmentSynapses_.clear(segmentData.synapses);
 
   CellData &cellData = cells_[segmentData.cell];
+  const SegmentList segments = segmentsForCell(segmentData.cell);
 
   const auto segmentOnCell =
-      std::lower_bound(cellData.segments.begin(), cellData.segments.end(),
-                       segment, [&](Segment a, Segment b) {
+      std::lower_bound(segments.begin(), segments.end(), segment,
+                       [&](Segment a, Segment b) {
                          return segmentOrdinals_[a] < segmentOrdinals_[b];
                        });
 
-  NTA_ASSERT(segmentOnCell != cellData.segments.end());
+  NTA_ASSERT(segmentOnCell != segments.end());
   NTA_ASSERT(*segmentOnCell == segment);
 
-  cellData.segments.erase(segmentOnCell);
+  cellSegments_.erase(cellData.segments,
+                      (UInt32)(segmentOnCell - segments.begin()));
 
   destroyedSegments_.push_back(segment);
 }
@@ -192,17 +228,19 @@ void Connections::destroySynapse(Synapse synapse) {
 
   removeSynapseFromPresynapticMap_(synapse);
 
-  SegmentData &segmentData = segments_[synapses_[synapse].segment];
+  const Segment segment = synapses_[synapse].segment;
+  const SynapseList synapses = synapsesForSegment(segment);
   const auto synapseOnSegment =
-      std::lower_bound(segmentData.synapses.begin(), segmentData.synapses.end(),
-                       synapse, [&](Synapse a, Synapse b) {
+      std::lower_bound(synapses.begin(), synapses.end(), synapse,
+                       [&](Synapse a, Synapse b) {
                          return synapseOrdinals_[a] < synapseOrdinals_[b];
                        });
 
-  NTA_ASSERT(synapseOnSegment != segmentData.synapses.end());
+  NTA_ASSERT(synapseOnSegment != synapses.end());
   NTA_ASSERT(*synapseOnSegment == synapse);
 
-  segmentData.synapses.erase(synapseOnSegment);
+  segmentSynapses_.erase(segments_[segment].synapses,
+                         (UInt32)(synapseOnSegment - synapses.begin()));
 
   destroyedSynapses_.push_back(synapse);
 }
@@ -216,16 +254,16 @@ void Connections::updateSynapsePermanence(Synapse synapse,
   synapses_[synapse].permanence = permanence;
 }
 
-const vector<Segment> &Connections::segmentsForCell(CellIdx cell) const {
-  return cells_[cell].segments;
+SegmentList Connections::segmentsForCell(CellIdx cell) const {
+  return cellSegments_.view(cells_[cell].segments);
 }
 
 Segment Connections::getSegment(CellIdx cell, SegmentIdx idx) const {
-  return cells_[cell].segments[idx];
+  return segmentsForCell(cell)[idx];
 }
 
-const vector<Synapse> &Connections::synapsesForSegment(Segment segment) const {
-  return segments_[segment].synapses;
+SynapseList Connections::synapsesForSegment(Segment segment) const {
+  return segmentSynapses_.view(segments_[segment].synapses);
 }
 
 CellIdx Connections::cellForSegment(Segment segment) const {
@@ -233,7 +271,7 @@ CellIdx Connections::cellForSegment(Segment segment) const {
 }
 
 SegmentIdx Connections::idxOnCellForSegment(Segment segment) const {
-  const vector<Segment> &segments = segmentsForCell(cellForSegment(segment));
+  const SegmentList segments = segmentsForCell(cellForSegment(segment));
   const auto it = std::find(segments.begin(), segments.end(), segment);
   NTA_ASSERT(it != segments.end());
   return std::distance(segments.begin(), it);
@@ -265,6 +303,37 @@ const SynapseData &Connections::dataForSynapse(Synapse synapse) const {
 
 UInt32 Connections::segmentFlatListLength() const { return segments_.size(); }
 
+UInt32 Connections::synapseFlatListLength() const { return synapses_.size(); }
+
+SegmentIdx Connections::maxSegmentsPerCell() const {
+  return (SegmentIdx)cellSegments_.maxSize();
+}
+
+SynapseIdx Connections::maxSynapsesPerSegment() const {
+  return (SynapseIdx)segmentSynapses_.maxSize();
+}
+
+void Connections::compact() {
+  vector<ListPool<Segment>::List *> segmentLists;
+  vector<ListPool<Synapse>::List *> synapseLists;
+  segmentLists.reserve(cells_.size());
+  synapseLists.reserve(numSegments());
+  for (CellData &cellData : cells_) {
+    segmentLists.push_back(&cellData.segments);
+    for (Segment segment : cellSegments_.view(cellData.segments)) {
+      synapseLists.push_back(&segments_[segment].synapses);
+    }
+  }
+  cellSegments_.compact(segmentLists);
+  segmentSynapses_.compact(synapseLists);
+
+  synapseLists.clear();
+  for (auto &presynapticSynapses : synapsesForPresynapticCell_) {
+    synapseLists.push_back(&presynapticSynapses);
+  }
+  presynapticSynapses_.compact(synapseLists);
+}
+
 bool Connections::compareSegments(Segment a, Segment b) const {
   const SegmentData &aData = segments_[a];
   const SegmentData &bData = segments_[b];
@@ -279,11 +348,7 @@ bool Connections::compareSegments(Segment a, Segment b) const {
 
 vector<Synapse>
 Connections::synapsesForPresynapticCell(CellIdx presynapticCell) const {
-  if (synapsesForPresynapticCell_.find(presynapticCell) ==
-      synapsesForPresynapticCell_.end())
-    return vector<Synapse>{};
-
-  return synapsesForPresynapticCell_.at(presynapticCell);
+  return synapsesOnPresynapticCell_(presynapticCell);
 }
 
 Synapse Connections::minPermanenceSynapse_(Segment segment) const {
@@ -294,7 +359,7 @@ Synapse Connections::minPermanenceSynapse_(Segment segment) const {
   Permanence minPermanence = std::numeric_limits<Permanence>::max();
   Synapse minSynapse;
 
-  for (Synapse synapse : segments_[segment].synapses) {
+  for (Synapse synapse : synapsesForSegment(segment)) {
     if (synapses_[synapse].permanence < minPermanence - EPSILON) {
       minSynapse = synapse;
       minPermanence = synapses_[synapse].permanence;
@@ -314,16 +379,13 @@ void Connections::computeActivity(
   NTA_ASSERT(numActiveConnectedSynapsesForSegment.size() == segments_.size());
   NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
 
-  if (synapsesForPresynapticCell_.count(activePresynapticCell)) {
-    for (Synapse synapse :
-         synapsesForPresynapticCell_.at(activePresynapticCell)) {
-      const SynapseData &synapseData = synapses_[synapse];
-      ++numActivePotentialSynapsesForSegment[synapseData.segment];
+  for (Synapse synapse : synapsesOnPresynapticCell_(activePresynapticCell)) {
+    const SynapseData &synapseData = synapses_[synapse];
+    ++numActivePotentialSynapsesForSegment[synapseData.segment];
 
-      NTA_ASSERT(synapseData.permanence > 0);
-      if (synapseData.permanence >= connectedPermanence - EPSILON) {
-        ++numActiveConnectedSynapsesForSegment[synapseData.segment];
-      }
+    NTA_ASSERT(synapseData.permanence > 0);
+    if (synapseData.permanence >= connectedPermanence - EPSILON) {
+      ++numActiveConnectedSynapsesForSegment[synapseData.segment];
     }
   }
 }
@@ -337,20 +399,52 @@ void Connections::computeActivity(
   NTA_ASSERT(numActivePotentialSynapsesForSegment.size() == segments_.size());
 
   for (CellIdx cell : activePresynapticCells) {
-    if (synapsesForPresynapticCell_.count(cell)) {
-      for (Synapse synapse : synapsesForPresynapticCell_.at(cell)) {
-        const SynapseData &synapseData = synapses_[synapse];
-        ++numActivePotentialSynapsesForSegment[synapseData.segment];
+    for (Synapse synapse : synapsesOnPresynapticCell_(cell)) {
+      const SynapseData &synapseData = synapses_[synapse];
+      ++numActivePotentialSynapsesForSegment[synapseData.segment];
 
-        NTA_ASSERT(synapseData.permanence > 0);
-        if (synapseData.permanence >= connectedPermanence - EPSILON) {
-          ++numActiveConnectedSynapsesForSegment[synapseData.segment];
-        }
+      NTA_ASSERT(synapseData.permanence > 0);
+      if (synapseData.permanence >= connectedPermanence - EPSILON) {
+        ++numActiveConnectedSynapsesForSegment[synapseData.segment];
       }
     }
   }
 }
 
+Segment Connections::loadSegment_(CellIdx cell) {
+  const Segment segment = segments_.size();
+  SegmentData segmentData;
+  segmentData.cell = cell;
+  segments_.push_back(segmentData);
+  segmentOrdinals_.push_back(nextSegmentOrdinal_++);
+  cellSegments_.push_back(cells_[cell].segments, segment);
+
+  for (auto h : eventHandlers_) {
+    h.second->onCreateSegment(segment);
+  }
+
+  return segment;
+}
+
+void Connections::loadSynapse_(Segment segment, CellIdx presynapticCell,
+                               Permanence permanence) {
+  const Synapse synapse = {(UInt32)synapses_.size()};
+  const SynapseData synapseData = {presynapticCell, permanence, segment};
+  synapses_.push_back(synapseData);
+  synapseOrdinals_.push_back(nextSynapseOrdinal_++);
+  segmentSynapses_.push_back(segments_[segment].synapses, synapse);
+
+  if (presynapticCell >= synapsesForPresynapticCell_.size()) {
+    synapsesForPresynapticCell_.resize(presynapticCell + 1);
+  }
+  presynapticSynapses_.push_back(synapsesForPresynapticCell_[presynapticCell],
+                                 synapse);
+
+  for (auto h : eventHandlers_) {
+    h.second->onCreateSynapse(synapse);
+  }
+}
+
 template <typename FloatType>
 static void saveFloat_(std::ostream &outStream, FloatType v) {
   outStream << std::setprecision(std::numeric_limits<FloatType>::max_digits10)
@@ -364,14 +458,12 @@ void Connections::save(std::ostream &outStream) const {
 
   outStream << cells_.size() << " " << endl;
 
-  for (CellData cellData : cells_) {
-    const vector<Segment> &segments = cellData.segments;
+  for (CellIdx cell = 0; cell < cells_.size(); ++cell) {
+    const SegmentList segments = segmentsForCell(cell);
     outStream << segments.size() << " ";
 
     for (Segment segment : segments) {
-      const SegmentData &segmentData = segments_[segment];
-
-      const vector<Synapse> &synapses = segmentData.synapses;
+      const SynapseList synapses = synapsesForSegment(segment);
       outStream << synapses.size() << " ";
 
       for (Synapse synapse : synapses) {
@@ -394,12 +486,11 @@ void Connections::write(ConnectionsProto::Builder &proto) const {
   auto protoCells = proto.initCells(cells_.size());
 
   for (CellIdx i = 0; i < cells_.size(); ++i) {
-    const vector<Segment> &segments = cells_[i].segments;
+    const SegmentList segments = segmentsForCell(i);
     auto protoSegments = protoCells[i].initSegments(segments.size());
 
     for (SegmentIdx j = 0; j < (SegmentIdx)segments.size(); ++j) {
-      const SegmentData &segmentData = segments_[segments[j]];
-      const vector<Synapse> &synapses = segmentData.synapses;
+      const SynapseList synapses = synapsesForSegment(segments[j]);
 
       auto protoSynapses = protoSegments[j].initSynapses(synapses.size());
 
@@ -428,14 +519,11 @@ void Connections::load(std::istream &inStream) {
   UInt numCells;
   inStream >> numCells;
 
-  initialize(numCells);
+  initialize(numCells, maxSegmentsPerCell(), maxSynapsesPerSegment());
 
   // This logic is complicated by the fact that old versions of the Connections
   // serialized "destroyed" segments and synapses, which we now ignore.
-  cells_.resize(numCells);
   for (UInt cell = 0; cell < numCells; cell++) {
-    CellData &cellData = cells_[cell];
-
     UInt numSegments;
     inStream >> numSegments;
 
@@ -446,16 +534,8 @@ void Connections::load(std::istream &inStream) {
       }
 
       Segment segment = {(UInt32)-1};
-      {
-        SegmentData segmentData = {};
-        segmentData.cell = cell;
-
-        if (!destroyedSegment) {
-          segment = segments_.size();
-          cellData.segments.push_back(segment);
-          segments_.push_back(segmentData);
-          segmentOrdinals_.push_back(nextSegmentOrdinal_++);
-        }
+      if (!destroyedSegment) {
+        segment = loadSegment_(cell);
       }
 
       UInt numSynapses;
@@ -472,21 +552,13 @@ void Connections::load(std::istream &inStream) {
         }
 
         if (!destroyedSegment && !destroyedSynapse) {
-          synapseData.segment = segment;
-
-          SegmentData &segmentData = segments_[segment];
-
-          Synapse synapse = {(UInt32)synapses_.size()};
-          segmentData.synapses.push_back(synapse);
-          synapses_.push_back(synapseData);
-          synapseOrdinals_.push_back(nextSynapseOrdinal_++);
-
-          synapsesForPresynapticCell_[synapseData.presynapticCell].push_back(
-              synapse);
+          loadSynapse_(segment, synapseData.presynapticCell,
+                       synapseData.permanence);
         }
       }
     }
   }
+  compact();
 
   inStream >> marker;
   NTA_CHECK(marker == "~Connections");
@@ -499,40 +571,23 @@ void Connections::read(ConnectionsProto::Reader &proto) {
 
   auto protoCells = proto.getCells();
 
-  initialize(protoCells.size());
+  initialize(protoCells.size(), maxSegmentsPerCell(), maxSynapsesPerSegment());
 
   for (CellIdx cell = 0; cell < protoCells.size(); ++cell) {
-    CellData &cellData = cells_[cell];
-
     auto protoSegments = protoCells[cell].getSegments();
 
     for (SegmentIdx j = 0; j < (SegmentIdx)protoSegments.size(); ++j) {
-      Segment segment;
-      {
-        const SegmentData segmentData = {vector<Synapse>(), cell};
-        segment = segments_.size();
-        cellData.segments.push_back(segment);
-        segments_.push_back(segmentData);
-        segmentOrdinals_.push_back(nextSegmentOrdinal_++);
-      }
-
-      SegmentData &segmentData = segments_[segment];
+      const Segment segment = loadSegment_(cell);
 
       auto protoSynapses = protoSegments[j].getSynapses();
 
       for (SynapseIdx k = 0; k < protoSynapses.size(); ++k) {
-        CellIdx presynapticCell = protoSynapses[k].getPresynapticCell();
-        SynapseData synapseData = {presynapticCell,
-                                   protoSynapses[k].getPermanence(), segment};
-        Synapse synapse = {(UInt32)synapses_.size()};
-        synapses_.push_back(synapseData);
-        synapseOrdinals_.push_back(nextSynapseOrdinal_++);
-        segmentData.synapses.push_back(synapse);
-
-        synapsesForPresynapticCell_[presynapticCell].push_back(synapse);
+        loadSynapse_(segment, protoSynapses[k].getPresynapticCell(),
+                     protoSynapses[k].getPermanence());
       }
     }
   }
+  compact();
 }
 
 CellIdx Connections::numCells() const { return cells_.size(); }
@@ -542,7 +597,7 @@ UInt Connections::numSegments() const {
 }
 
 UInt Connections::numSegments(CellIdx cell) const {
-  return cells_[cell].segments.size();
+  return cells_[cell].segments.size;
 }
 
 UInt Connections::numSynapses() const {
@@ -550,7 +605,7 @@ UInt Connections::numSynapses() const {
 }
 
 UInt Connections::numSynapses(Segment segment) const {
-  return segments_[segment].synapses.size();
+  return segments_[segment].synapses.size;
 }
 
 bool Connections::operator==(const Connections &other) const {
@@ -561,25 +616,30 @@ bool Connections::operator==(const Connections &other) const {
     const CellData &cellData = cells_[i];
     const CellData &otherCellData = other.cells_[i];
 
-    if (cellData.segments.size() != otherCellData.segments.size()) {
+    const SegmentList segments = segmentsForCell(i);
+    const SegmentList otherSegments = other.segmentsForCell(i);
+
+    if (segments.size() != otherSegments.size()) {
       return false;
     }
 
-    for (SegmentIdx j = 0; j < (SegmentIdx)cellData.segments.size(); ++j) {
-      Segment segment = cellData.segments[j];
+    for (SegmentIdx j = 0; j < (SegmentIdx)segments.size(); ++j) {
+      Segment segment = segments[j];
       const SegmentData &segmentData = segments_[segment];
-      Segment otherSegment = otherCellData.segments[j];
+      const SynapseList synapses = synapsesForSegment(segment);
+      Segment otherSegment = otherSegments[j];
       const SegmentData &otherSegmentData = other.segments_[otherSegment];
+      const SynapseList otherSynapses = other.synapsesForSegment(otherSegment);
 
-      if (segmentData.synapses.size() != otherSegmentData.synapses.size() ||
+      if (synapses.size() != otherSynapses.size() ||
           segmentData.cell != otherSegmentData.cell) {
         return false;
       }
 
-      for (SynapseIdx k = 0; k < (SynapseIdx)segmentData.synapses.size(); ++k) {
-        Synapse synapse = segmentData.synapses[k];
+      for (SynapseIdx k = 0; k < (SynapseIdx)synapses.size(); ++k) {
+        Synapse synapse = synapses[k];
         const SynapseData &synapseData = synapses_[synapse];
-        Synapse otherSynapse = otherSegmentData.synapses[k];
+        Synapse otherSynapse = otherSynapses[k];
         const SynapseData &otherSynapseData = other.synapses_[otherSynapse];
 
         if (synapseData.presynapticCell != otherSynapseData.presynapticCell ||
@@ -594,15 +654,13 @@ bool Connections::operator==(const Connections &other) const {
     }
   }
 
-  if (synapsesForPresynapticCell_.size() !=
-      other.synapsesForPresynapticCell_.size())
-    return false;
+  const size_t numPresynapticCells =
+      std::max(synapsesForPresynapticCell_.size(),
+               other.synapsesForPresynapticCell_.size());
 
-  for (auto i = synapsesForPresynapticCell_.begin();
-       i != synapsesForPresynapticCell_.end(); ++i) {
-    const vector<Synapse> &synapses = i->second;
-    const vector<Synapse> &otherSynapses =
-        other.synapsesForPresynapticCell_.at(i->first);
+  for (CellIdx cell = 0; cell < numPresynapticCells; ++cell) {
+    const SynapseList synapses = synapsesOnPresynapticCell_(cell);
+    const SynapseList otherSynapses = other.synapsesOnPresynapticCell_(cell);
 
     if (synapses.size() != otherSynapses.size())
       return false;
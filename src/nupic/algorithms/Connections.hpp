@@ -28,9 +28,11 @@
 #define NTA_CONNECTIONS_HPP
 
 #include <climits>
+#include <limits>
 #include <utility>
 #include <vector>
 
+#include <nupic/algorithms/ListPool.hpp>
 #include <nupic/math/Math.hpp>
 #include <nupic/proto/ConnectionsProto.capnp.h>
 #include <nupic/types/Serializable.hpp>
@@ -87,6 +89,13 @@ struct SynapseData {
   Segment segment;
 };
 
+/**
+ * The segments of a cell, or the synapses of a segment, in the order they
+ * were created. Read-only views into the pools of Connections.
+ */
+typedef ListPool<Segment>::View SegmentList;
+typedef ListPool<Synapse>::View SynapseList;
+
 /**
  * SegmentData class used in Connections.
  *
@@ -94,13 +103,13 @@ struct SynapseData {
  * The SegmentData contains the underlying data for a Segment.
  *
  * @param synapses
- * Synapses on this segment.
+ * Synapses on this segment, in a block of the synapse pool.
  *
  * @param cell
  * The cell that this segment is on.
  */
 struct SegmentData {
-  std::vector<Synapse> synapses;
+  ListPool<Synapse>::List synapses;
   CellIdx cell;
 };
 
@@ -111,11 +120,11 @@ struct SegmentData {
  * The CellData contains the underlying data for a Cell.
  *
  * @param segments
- * Segments on this cell.
+ * Segments on this cell, in a block of the segment pool.
  *
  */
 struct CellData {
-  std::vector<Segment> segments;
+  ListPool<Segment>::List segments;
 };
 
 /**
@@ -182,6 +191,12 @@ public:
  * Create a vector of length `connections.segmentFlatListLength()`,
  * iterate over segments and update the vector at index `segment`.
  *
+ * The segments of each cell, the synapses of each segment and the synapses
+ * of each presynaptic cell are lists in three ListPools, rather than one
+ * heap allocation per list. The blocks of the segment and synapse lists
+ * are capped at maxSegmentsPerCell and maxSynapsesPerSegment. compact()
+ * repacks the pools.
+ *
  */
 class Connections : public Serializable<ConnectionsProto> {
 public:
@@ -191,14 +206,20 @@ public:
    * Connections empty constructor.
    * (Does not call `initialize`.)
    */
-  Connections(){};
+  Connections() { initialize(0); };
 
   /**
    * Connections constructor.
    *
    * @param numCells              Number of cells.
+   * @param maxSegmentsPerCell    Maximum number of segments per cell.
+   * @param maxSynapsesPerSegment Maximum number of synapses per segment.
    */
-  Connections(CellIdx numCells);
+  Connections(CellIdx numCells,
+              SegmentIdx maxSegmentsPerCell =
+                  std::numeric_limits<SegmentIdx>::max(),
+              SynapseIdx maxSynapsesPerSegment =
+                  std::numeric_limits<SynapseIdx>::max());
 
   virtual ~Connections() {}
 
@@ -206,11 +227,18 @@ public:
    * Initialize connections.
    *
    * @param numCells              Number of cells.
+   * @param maxSegmentsPerCell    Maximum number of segments per cell.
+   * @param maxSynapsesPerSegment Maximum number of synapses per segment.
    */
-  void initialize(CellIdx numCells);
+  void initialize(CellIdx numCells,
+                  SegmentIdx maxSegmentsPerCell =
+                      std::numeric_limits<SegmentIdx>::max(),
+                  SynapseIdx maxSynapsesPerSegment =
+                      std::numeric_limits<SynapseIdx>::max());
 
   /**
-   * Creates a segment on the specified cell.
+   * Creates a segment on the specified cell. Throws if the cell has
+   * maxSegmentsPerCell segments.
    *
    * @param cell Cell to create segment on.
    *
@@ -219,7 +247,8 @@ public:
   Segment createSegment(CellIdx cell);
 
   /**
-   * Creates a synapse on the specified segment.
+   * Creates a synapse on the specified segment. Throws if the segment has
+   * maxSynapsesPerSegment synapses.
    *
    * @param segment         Segment to create synapse on.
    * @param presynapticCell Cell to synapse on.
@@ -255,20 +284,27 @@ public:
   /**
    * Gets the segments for a cell.
    *
+   * The list follows the segments created and destroyed on the cell. It's
+   * invalidated when segments are created on other cells.
+   *
    * @param cell Cell to get segments for.
    *
    * @retval Segments on cell.
    */
-  const std::vector<Segment> &segmentsForCell(CellIdx cell) const;
+  SegmentList segmentsForCell(CellIdx cell) const;
 
   /**
    * Gets the synapses for a segment.
    *
+   * The list follows the synapses created and destroyed on the segment.
+   * It's invalidated when segments are created, or synapses are created on
+   * other segments.
+   *
    * @param segment Segment to get synapses for.
    *
    * @retval Synapses on segment.
    */
-  const std::vector<Synapse> &synapsesForSegment(Segment segment) const;
+  SynapseList synapsesForSegment(Segment segment) const;
 
   /**
    * Gets the cell that this segment is on.
@@ -345,6 +381,27 @@ public:
    */
   UInt32 segmentFlatListLength() const;
 
+  /**
+   * Get the vector length needed to use synapses as indices.
+   *
+   * @retval A vector length
+   */
+  UInt32 synapseFlatListLength() const;
+
+  SegmentIdx maxSegmentsPerCell() const;
+
+  SynapseIdx maxSynapsesPerSegment() const;
+
+  /**
+   * Repacks the segment and synapse lists, in the order of the cells, into
+   * the smallest blocks that hold them, and frees the blocks of destroyed
+   * segments and synapses. Segments and synapses keep their flatIdx.
+   *
+   * Loading or reading calls it. Run it after learning that destroyed many
+   * segments or synapses.
+   */
+  void compact();
+
   /**
    * Compare two segments. Returns true if a < b.
    *
@@ -517,6 +574,11 @@ public:
    */
   void unsubscribe(UInt32 token);
 
+  /**
+   * Whether any event handler is subscribed.
+   */
+  bool hasSubscribers() const;
+
 protected:
   /**
    * Gets the synapse with the lowest permanence on the segment.
@@ -552,6 +614,19 @@ protected:
    */
   void removeSynapseFromPresynapticMap_(Synapse synapse);
 
+  /**
+   * The synapses on a presynaptic cell, or an empty list.
+   */
+  SynapseList synapsesOnPresynapticCell_(CellIdx presynapticCell) const;
+
+  /**
+   * Append a segment or a synapse while loading, and notify the event
+   * handlers as createSegment and createSynapse do.
+   */
+  Segment loadSegment_(CellIdx cell);
+  void loadSynapse_(Segment segment, CellIdx presynapticCell,
+                    Permanence permanence);
+
 private:
   std::vector<CellData> cells_;
   std::vector<SegmentData> segments_;
@@ -559,8 +634,13 @@ private:
   std::vector<SynapseData> synapses_;
   std::vector<Synapse> destroyedSynapses_;
 
-  // Extra bookkeeping for faster computing of segment activity.
-  std::map<CellIdx, std::vector<Synapse>> synapsesForPresynapticCell_;
+  ListPool<Segment> cellSegments_;
+  ListPool<Synapse> segmentSynapses_;
+
+  // Extra bookkeeping for faster computing of segment activity: the
+  // synapses on each presynaptic cell, indexed by cell.
+  std::vector<ListPool<Synapse>::List> synapsesForPresynapticCell_;
+  ListPool<Synapse> presynapticSynapses_;
 
   std::vector<UInt64> segmentOrdinals_;
   std::vector<UInt64> synapseOrdinals_;
@@ -43,7 +43,11 @@
 
 #include <math.h>
 #include <nupic/utils/Log.hpp>
+#include <nupic/math/Simd.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 // Enable debugging
 //#define DEBUG   1
@@ -530,59 +534,35 @@ void _computeNormalizers(int &nStatPosGrand, int &nStatNegGrand,
   }
 }
 
-// FUNCTION: _doConvolution_alpha()
-// 1. Convolve integerized input image (in bufferIn) against
-//    each filter in gabor filter bank, storing the result
-//    (in integer32) in the output buffers.
-// 2. While performing convolution, keeps track of the
-//    neccessary statistics for use in normalization
-//    during Pass II.
-// For case where valid alpha is provided instead of valid box.
-void _doConvolution_alpha(
-    const NUMPY_ARRAY *psBufferIn, const NUMPY_ARRAY *psBufferOut,
-    const NUMPY_ARRAY *psGaborBank, const NUMPY_ARRAY *psAlpha,
-    const BBOX *psInputBox, const BBOX *psOutputBox, PHASE_MODE ePhaseMode,
-    NORMALIZE_METHOD eNormalizeMethod, NORMALIZE_MODE eNormalizeMode,
-    unsigned int anStatPosGrand[], unsigned int anStatNegGrand[]) {
-  int i, j, jj;
-  int nFilterIndex;
-  int nResponse;
-  int nNumPixels = 0;
-  const int *pnInput = nullptr;
-  const int *pnInputRow = nullptr;
-  const int *pnInputPtr = nullptr;
-  const int *pnGaborPtr = nullptr;
-  const float *pfAlpha = nullptr;
-  const float *pfAlphaRow = nullptr;
-  const float *pfAlphaRowPtr = nullptr;
-  int *pnOutputRow = nullptr;
-
-  // Decide which statistics to keep.
-  // There are four cases:
-  //  1. Record max response in single-phase mode.
-  //     To do this, we need to keep track of the maximum
-  //     absolute value response.
-  //  2. Record max response in dual-phase mode.
-  //     For this, we need to keep track of the maximum
-  //     and minimum response.  At the end of the processing
-  //     cycle, we will do a sanity check to make sure that
-  //     something crazy didn't happen, like the minimum
-  //     response was positive, or vice versa.
-  //  3. Record mean response in single-phase mode.
-  //     For this, we need to accummulate the sume of
-  //     the absolute values of the responses.
-  //  4. Record mean response in dual-phase mode.
-  //     For this, we need to keep the sum of all
-  //     negative responses as well as (independently)
-  //     the sum of all positive responses.
-  // We will use "generalized" variables to keep track
-  // of the positive and negative (if dual phase) running
-  // statistics.
-  // Note also: for the summed values, we'll use a pair of
-  // row-wise accummulators, as well as a pair of grand
-  // accummulators (in order to avoid overflow issues.)
-  int nStatPosGrand, nStatNegGrand;
-  int nStatPosRow, nStatNegRow;
+// Tiling of the convolution: a task computes the responses of one
+// filter over a band of CONVOLUTION_ROW_BAND output rows, and each
+// row is processed in tiles of CONVOLUTION_COL_TILE output locations
+// so that the tile of accumulators stays in L1 cache while all the
+// filter taps are applied to it.
+#define CONVOLUTION_ROW_BAND 16
+#define CONVOLUTION_COL_TILE 512
+
+// FUNCTION: _statisticsFlags()
+// Decide which statistics to keep.
+// There are four cases:
+//  1. Record max response in single-phase mode.
+//     To do this, we need to keep track of the maximum
+//     absolute value response.
+//  2. Record max response in dual-phase mode.
+//     For this, we need to keep track of the maximum
+//     and minimum response.  At the end of the processing
+//     cycle, we will do a sanity check to make sure that
+//     something crazy didn't happen, like the minimum
+//     response was positive, or vice versa.
+//  3. Record mean response in single-phase mode.
+//     For this, we need to accummulate the sume of
+//     the absolute values of the responses.
+//  4. Record mean response in dual-phase mode.
+//     For this, we need to keep the sum of all
+//     negative responses as well as (independently)
+//     the sum of all positive responses.
+unsigned int _statisticsFlags(PHASE_MODE ePhaseMode,
+                              NORMALIZE_METHOD eNormalizeMethod) {
   unsigned int nStatFlags = STATS_NONE;
   switch (eNormalizeMethod) {
   // Max-based normalization
@@ -604,12 +584,6 @@ void _doConvolution_alpha(
       NTA_ASSERT(ePhaseMode == PHASE_MODE_DUAL);
       nStatFlags |= STATS_SUM_POS_NEG;
     }
-    // We'll need to know the total number of pixels
-    nNumPixels = 0;
-    // nNumPixels = (psOutputBox->nRight - psOutputBox->nLeft) *
-    // (psOutputBox->nBottom - psOutputBox->nTop); if (eNormalizeMode ==
-    // NORMALIZE_MODE_GLOBAL)
-    //  nNumPixels *= GABORSET_PLANES(psGaborBank);
     break;
   // No normalization needed
   case NORMALIZE_METHOD_FIXED:
@@ -618,691 +592,190 @@ void _doConvolution_alpha(
   default:
     NTA_ASSERT(false);
   }
+  return nStatFlags;
+}
 
-  // Ascertain size of gabor filter mask
-  NTA_ASSERT(IMAGESET_ROWS(psGaborBank) == IMAGESET_COLS(psGaborBank));
-  int nFilterDim = IMAGESET_ROWS(psGaborBank);
-
-  // We might be in constrained mode, in which case we need to
-  // map our alpha locations (organized in input space) into
-  // our response locations (organized in output space).
-  // The shrinkage values (in X and Y dimensions) allow us to
-  // convert from input space to output space:
-  //    outputX = inputX - nShrinkageX
-  //    outputY = inputY - nShrinkageY
-  // For sweep-off mode, the shrinkages will be zero.
-  int nShrinkageX = (psInputBox->nRight - psOutputBox->nRight) >> 1;
-  int nShrinkageY = (psInputBox->nBottom - psOutputBox->nBottom) >> 1;
-
-  // Locate start of correct Gabor filter
-  const int *pnFilterBase = (const int *)psGaborBank->pData;
-
-  // Locate start of correct output plane
-  int *pnOutputBase = (int *)psBufferOut->pData;
-  int nOutputRowStride =
-      IMAGESET_ROWSTRIDE(psBufferOut) / sizeof(*pnOutputBase);
-
-  // Guard against buffer over-runs
-#ifdef DEBUG
-  // Start/end of memory
-  const char *pDebugOutputSOMB = (const char *)(psBufferOut->pData);
-  const char *pDebugOutputEOMB =
-      pDebugOutputSOMB +
-      IMAGESET_PLANESTRIDE(psBufferOut) * IMAGESET_PLANES(psBufferOut);
-#endif // DEBUG
-
-  // Locate the start of input plane
-  const int *pnInputBase = (const int *)psBufferIn->pData;
-  int nInputRowStride = IMAGE_ROWSTRIDE(psBufferIn) / sizeof(*pnInputBase);
-  int nInputRowAdvance = nInputRowStride - nFilterDim;
-
-  // Locate the start of alpha plane
-  const float *pfAlphaBase = (const float *)psAlpha->pData;
-  int nAlphaRowStride = IMAGE_ROWSTRIDE(psAlpha) / sizeof(*pfAlphaBase);
-
-  // Take into account bounding box suppression
-  int nOutputRows = (psOutputBox->nBottom - psOutputBox->nTop);
-  int nOutputCols = (psOutputBox->nRight - psOutputBox->nLeft);
-
-  // Our output buffers should be 4-pixel aligned
-  NTA_ASSERT(IMAGESET_COLS(psBufferOut) % 4 == 0);
-
-  // Pre-compute some calculations
-  int nNumBlankTopRows = psOutputBox->nTop;
-
-  // Initialize stats
-  nStatPosGrand = 0;
-  nStatNegGrand = 0;
-
-  for (nFilterIndex = 0; nFilterIndex < GABORSET_PLANES(psGaborBank);
-       nFilterIndex++) {
+// FUNCTION: _accumulateTap()
+// PURPOSE: Adds nCoef * pnInput[i] to pnOutput[i] for nCols
+// contiguous output locations. This is the inner kernel of the
+// convolution: it works on contiguous rows, so it maps directly
+// onto SIMD integer lanes (see addScaled in nupic/math/Simd.hpp).
+// Integer arithmetic is exact, so every code path produces the
+// same responses.
+static inline void _accumulateTap(int *pnOutput, const int *pnInput,
+                                  int nCoef, int nCols) {
+  if (const auto f = nupic::simd::kernels().addScaled)
+    return f(pnOutput, pnInput, nCoef, nCols);
+  for (int i = 0; i < nCols; i++)
+    pnOutput[i] += nCoef * pnInput[i];
+}
 
-    // Initialize stats
-    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT) {
-      nStatPosGrand = 0;
-      nStatNegGrand = 0;
+// FUNCTION: _convolveRow()
+// PURPOSE: Computes the responses of a (square) filter for one
+// output row of nCols locations. Instead of computing one response
+// at a time, each filter tap is applied to a whole tile of the row.
+// If an alpha row is given, responses that fall outside of the
+// alpha mask are set to zero.
+static void _convolveRow(const int *pnFilter, int nFilterDim,
+                         const int *pnInputRow, int nInputRowStride,
+                         const float *pfAlphaRow, int *pnOutputRow,
+                         int nCols) {
+  for (int nTile = 0; nTile < nCols; nTile += CONVOLUTION_COL_TILE) {
+    int nTileCols = MIN(CONVOLUTION_COL_TILE, nCols - nTile);
+    int *pnOutput = pnOutputRow + nTile;
+    memset(pnOutput, 0, nTileCols * sizeof(*pnOutput));
+
+    const int *pnCoef = pnFilter;
+    for (int jj = 0; jj < nFilterDim; jj++) {
+      const int *pnInput = pnInputRow + jj * nInputRowStride + nTile;
+      for (int ii = 0; ii < nFilterDim; ii++)
+        _accumulateTap(pnOutput, pnInput + ii, *pnCoef++, nTileCols);
     }
+  }
 
-    // Advance to beginning of our useful input
-    pnInput =
-        pnInputBase + nInputRowStride * psInputBox->nTop + psInputBox->nLeft;
-
-    // Process each plane of output
-    const int *pnFilter = pnFilterBase;
-    int *pnOutput = pnOutputBase;
-
-    // Zero out any rows above the bounding box
-    pnOutput += nNumBlankTopRows * nOutputRowStride;
-
-    // Advance to beginning of our alpha channel
-    pfAlpha = pfAlphaBase + (nNumBlankTopRows + nShrinkageY) * nAlphaRowStride;
-
-    // Process each row within the bounding box (vertically)
-    for (j = nOutputRows; j; j--) {
-
-      // Initialize row-wise accummulator
-      nStatPosRow = 0;
-      nStatNegRow = 0;
-
-      // Process this ouput row, one output location at a time
-      pnInputRow = pnInput;
-
-      // Skip any pixels on this row that lie on left side of bounding box
-      pnOutputRow = pnOutput + psOutputBox->nLeft;
-
-      // Alpha
-      pfAlphaRow = pfAlpha + (psOutputBox->nLeft + nShrinkageX);
-
-      // We'll need to know the total number of pixels if we
-      // are using a mean-based normalization.  This can be
-      // determined on the first pass through the source
-      // image (i.e., when generating the response to the
-      // first gabor filter.)
-      if (nFilterIndex == 0 &&
-          (eNormalizeMethod == NORMALIZE_METHOD_MEAN ||
-           eNormalizeMethod == NORMALIZE_METHOD_MEANPOWER) &&
-          eNormalizeMode == NORMALIZE_MODE_GLOBAL) {
-        // Quickly run across the alpha channel to check how
-        // many positive pixels it has in this row.
-        pfAlphaRowPtr = pfAlphaRow;
-        for (i = nOutputCols; i; i--) {
-          if (*pfAlphaRowPtr++)
-            nNumPixels++;
-        }
-      }
-
-      // Unrolled loops; instead of doing this:
-      //
-      //  for (ii=nFilterDim; ii; ii--)
-      //    nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-      //
-      // We'll just hard-code the operations
-      switch (nFilterDim) {
-
-      // Filter: 5x5
-      case 5:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-
-          // Only generate a response if the output point
-          // lies within our valid alpha channel.
-          if (*pfAlphaRow++) {
-
-            for (jj = nFilterDim; jj; jj--) {
-
-              // First 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Second 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              pnInputPtr += nInputRowAdvance;
-            }
-
-            // Keep statistics for normalization
-            if (nStatFlags & STATS_MAX_ABS)
-              nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-            else if (nStatFlags & STATS_MAX_MIN) {
-              if (nResponse >= 0)
-                nStatPosGrand = MAX(nStatPosGrand, nResponse);
-              else
-                nStatNegGrand = MIN(nStatNegGrand, nResponse);
-            } else if (nStatFlags & STATS_SUM_ABS)
-              nStatPosRow += IABS32(nResponse);
-            else if (nStatFlags & STATS_SUM_POS_NEG) {
-              if (nResponse >= 0)
-                nStatPosRow += nResponse;
-              else
-                nStatNegRow -= nResponse;
-            }
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 7x7
-      case 7:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-
-          // Only generate a response if the output point
-          // lies within our valid alpha channel.
-          if (*pfAlphaRow++) {
-
-            for (jj = nFilterDim; jj; jj--) {
-
-              // First 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Second 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              pnInputPtr += nInputRowAdvance;
-            }
-
-            // Keep statistics for normalization
-            if (nStatFlags & STATS_MAX_ABS)
-              nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-            else if (nStatFlags & STATS_MAX_MIN) {
-              if (nResponse >= 0)
-                nStatPosGrand = MAX(nStatPosGrand, nResponse);
-              else
-                nStatNegGrand = MIN(nStatNegGrand, nResponse);
-            } else if (nStatFlags & STATS_SUM_ABS)
-              nStatPosRow += IABS32(nResponse);
-            else if (nStatFlags & STATS_SUM_POS_NEG) {
-              if (nResponse >= 0)
-                nStatPosRow += nResponse;
-              else
-                nStatNegRow -= nResponse;
-            }
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 9x9
-      case 9:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-
-          // Only generate a response if the output point
-          // lies within our valid alpha channel.
-          if (*pfAlphaRow++) {
-
-            for (jj = nFilterDim; jj; jj--) {
-
-              // First 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Second 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Third 128-bits (when we convert to SSE2 we'll
-              // do a 12th position - after making sure to pad
-              // things in advance to avoid a buffer overflow.)
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              pnInputPtr += nInputRowAdvance;
-            }
-
-            // Keep statistics for normalization
-            if (nStatFlags & STATS_MAX_ABS)
-              nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-            else if (nStatFlags & STATS_MAX_MIN) {
-              if (nResponse >= 0)
-                nStatPosGrand = MAX(nStatPosGrand, nResponse);
-              else
-                nStatNegGrand = MIN(nStatNegGrand, nResponse);
-            } else if (nStatFlags & STATS_SUM_ABS)
-              nStatPosRow += IABS32(nResponse);
-            else if (nStatFlags & STATS_SUM_POS_NEG) {
-              if (nResponse >= 0)
-                nStatPosRow += nResponse;
-              else
-                nStatNegRow -= nResponse;
-            }
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 11x11
-      case 11:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-
-          // Only generate a response if the output point
-          // lies within our valid alpha channel.
-          if (*pfAlphaRow++) {
-
-            for (jj = nFilterDim; jj; jj--) {
-
-              // First 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Second 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Third 128-bits (when we convert to SSE2 we'll
-              // do a 12th position - after making sure to pad
-              // things in advance to avoid a buffer overflow.)
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              pnInputPtr += nInputRowAdvance;
-            }
-
-            // Keep statistics for normalization
-            if (nStatFlags & STATS_MAX_ABS)
-              nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-            else if (nStatFlags & STATS_MAX_MIN) {
-              if (nResponse >= 0)
-                nStatPosGrand = MAX(nStatPosGrand, nResponse);
-              else
-                nStatNegGrand = MIN(nStatNegGrand, nResponse);
-            } else if (nStatFlags & STATS_SUM_ABS)
-              nStatPosRow += IABS32(nResponse);
-            else if (nStatFlags & STATS_SUM_POS_NEG) {
-              if (nResponse >= 0)
-                nStatPosRow += nResponse;
-              else
-                nStatNegRow -= nResponse;
-            }
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 13x13
-      case 13:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-
-          // Only generate a response if the output point
-          // lies within our valid alpha channel.
-          if (*pfAlphaRow++) {
-
-            for (jj = nFilterDim; jj; jj--) {
-
-              // First 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Second 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Third 128-bits
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              // Fourth 128-bits (when we convert to SSE2 we'll
-              // do a 12th position - after making sure to pad
-              // things in advance to avoid a buffer overflow.)
-              nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-              pnInputPtr += nInputRowAdvance;
-            }
-
-            // Keep statistics for normalization
-            if (nStatFlags & STATS_MAX_ABS)
-              nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-            else if (nStatFlags & STATS_MAX_MIN) {
-              if (nResponse >= 0)
-                nStatPosGrand = MAX(nStatPosGrand, nResponse);
-              else
-                nStatNegGrand = MIN(nStatNegGrand, nResponse);
-            } else if (nStatFlags & STATS_SUM_ABS)
-              nStatPosRow += IABS32(nResponse);
-            else if (nStatFlags & STATS_SUM_POS_NEG) {
-              if (nResponse >= 0)
-                nStatPosRow += nResponse;
-              else
-                nStatNegRow -= nResponse;
-            }
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-      }
-
-      // Accummulate our summing stats.
-      // We'll rightshift by 8 bits to keep things from overflowing.
-      // We'll also flip the sign of the negative accummulator
-      if (nStatFlags & STATS_MEAN) {
-        nStatPosGrand += (nStatPosRow >> 8);
-        nStatNegGrand += ((-nStatNegRow) >> 8);
-      }
+  // Only keep responses for points that lie within our valid
+  // alpha channel.
+  if (pfAlphaRow) {
+    for (int i = 0; i < nCols; i++)
+      if (!pfAlphaRow[i])
+        pnOutputRow[i] = 0;
+  }
+}
 
-      // Advance to next rows
-      pnInput += nInputRowStride;
-      pnOutput += nOutputRowStride;
-      pfAlpha += nAlphaRowStride;
+// FUNCTION: _rowStatistics()
+// PURPOSE: Computes the normalization statistics of one row of
+// responses. Max statistics start from zero, like the grand
+// statistics they will be merged into.
+// Note: for the summed values, we use row-wise accummulators
+// which are down-shifted before being added to the grand
+// accummulators (in order to avoid overflow issues.)
+static void _rowStatistics(const int *pnRow, int nCols,
+                           unsigned int nStatFlags, int &nStatPosRow,
+                           int &nStatNegRow) {
+  nStatPosRow = 0;
+  nStatNegRow = 0;
+
+  if (nStatFlags & STATS_MAX_ABS) {
+    for (int i = 0; i < nCols; i++)
+      nStatPosRow = MAX(nStatPosRow, IABS32(pnRow[i]));
+  } else if (nStatFlags & STATS_MAX_MIN) {
+    for (int i = 0; i < nCols; i++) {
+      nStatPosRow = MAX(nStatPosRow, pnRow[i]);
+      nStatNegRow = MIN(nStatNegRow, pnRow[i]);
     }
-
-    // Advance to correct plane for gabor filter and output buffer
-    pnFilterBase += IMAGESET_PLANESTRIDE(psGaborBank) / sizeof(*pnFilter);
-    pnOutputBase += IMAGESET_PLANESTRIDE(psBufferOut) / sizeof(*pnOutput);
-
-    // If we are storing statistics on a per-filter basis,
-    // then we need to dump our stats to the buffer
-    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT) {
-
-      // Compute final values of the normalizers to use
-      _computeNormalizers(nStatPosGrand, nStatNegGrand, nStatFlags,
-                          eNormalizeMethod, nNumPixels);
-
-      NTA_ASSERT(nStatPosGrand >= 0);
-      anStatPosGrand[nFilterIndex] = (unsigned int)(nStatPosGrand + 1);
-      // We also need to flip the sign of our negative
-      // max stat if we are in dual phase.
-      // if (nStatFlags & STATS_MAX_MIN)
-      //  nStatNegGrand = -nStatNegGrand;
-      // if (nStatFlags & STATS_DUAL) {
-      if (ePhaseMode == PHASE_MODE_DUAL) {
-        nStatNegGrand = -nStatNegGrand;
-        NTA_ASSERT(nStatNegGrand >= 0);
-        // We add one to the statistical quantity because we want to
-        // round up in the case of integer arithmetic round off
-        // errors.  That way (for example) our MAX statistic will
-        // be guaranteed to be >= the largest actual value.
-        anStatNegGrand[nFilterIndex] = (unsigned int)(nStatNegGrand + 1);
-      }
-
-      // Debugging
-#ifdef DEBUG
-      for (int kk = 0; kk <= nFilterIndex; kk++) {
-        fprintf(stdout, "[%d]: anStatPosGrand: %d\tanStatNegGrand: %d\n", kk,
-                anStatPosGrand[kk], anStatNegGrand[kk]);
-      }
-#endif // DEBUG
+  } else if (nStatFlags & STATS_SUM_ABS) {
+    for (int i = 0; i < nCols; i++)
+      nStatPosRow += IABS32(pnRow[i]);
+  } else if (nStatFlags & STATS_SUM_POS_NEG) {
+    for (int i = 0; i < nCols; i++) {
+      if (pnRow[i] >= 0)
+        nStatPosRow += pnRow[i];
+      else
+        nStatNegRow -= pnRow[i];
     }
+  }
+}
 
-    // We'll need to know the total number of pixels if we
-    // are using a mean-based normalization.  This can be
-    // determined on the first pass through the source
-    // image (i.e., when generating the response to the
-    // first gabor filter.)
-    if (nFilterIndex == 0 &&
-        (eNormalizeMethod == NORMALIZE_METHOD_MEAN ||
-         eNormalizeMethod == NORMALIZE_METHOD_MEANPOWER) &&
-        eNormalizeMode == NORMALIZE_MODE_GLOBAL)
-      // If using global normalization, then we're summing the
-      // responses over all planes, so there will a multiple
-      // of positive alpha pixels equal to the number of
-      // filter planes.
-      nNumPixels *= GABORSET_PLANES(psGaborBank);
-
-  } // for each filter (output plane)
-
-  // If we are storing statistics globally (i.e., not on a
-  // per-filter basis), then we can finally dump our stats
-  // to the buffer.
-  if (eNormalizeMode == NORMALIZE_MODE_GLOBAL) {
-
-    // Compute final values of the normalizers to use
-    _computeNormalizers(nStatPosGrand, nStatNegGrand, nStatFlags,
-                        eNormalizeMethod, nNumPixels);
-
-    NTA_ASSERT(nStatPosGrand >= 0);
-    anStatPosGrand[0] = (unsigned int)(nStatPosGrand + 1);
-    // We also need to flip the sign of our negative
-    // max stat if we are in dual phase.
-    // if (nStatFlags & STATS_MAX_MIN)
-    //  nStatNegGrand = -nStatNegGrand;
-    // if (nStatFlags & STATS_DUAL) {
-    if (ePhaseMode == PHASE_MODE_DUAL) {
-      nStatNegGrand = -nStatNegGrand;
-      NTA_ASSERT(nStatNegGrand >= 0);
-      anStatNegGrand[0] = (unsigned int)(nStatNegGrand + 1);
-    }
+// FUNCTION: _storeStatistics()
+// PURPOSE: Computes the final values of the normalizers and
+// stores them in the statistics buffers at index k.
+static void _storeStatistics(int nStatPosGrand, int nStatNegGrand,
+                             unsigned int nStatFlags, PHASE_MODE ePhaseMode,
+                             NORMALIZE_METHOD eNormalizeMethod,
+                             int nNumPixels, int k,
+                             unsigned int anStatPosGrand[],
+                             unsigned int anStatNegGrand[]) {
+  _computeNormalizers(nStatPosGrand, nStatNegGrand, nStatFlags,
+                      eNormalizeMethod, nNumPixels);
+
+  NTA_ASSERT(nStatPosGrand >= 0);
+  anStatPosGrand[k] = (unsigned int)(nStatPosGrand + 1);
+  // We also need to flip the sign of our negative
+  // max stat if we are in dual phase.
+  if (ePhaseMode == PHASE_MODE_DUAL) {
+    nStatNegGrand = -nStatNegGrand;
+    NTA_ASSERT(nStatNegGrand >= 0);
+    // We add one to the statistical quantity because we want to
+    // round up in the case of integer arithmetic round off
+    // errors.  That way (for example) our MAX statistic will
+    // be guaranteed to be >= the largest actual value.
+    anStatNegGrand[k] = (unsigned int)(nStatNegGrand + 1);
   }
 
-  // Debug
+  // Debugging
 #ifdef DEBUG
-  for (int kk = 0; kk < 1; kk++) {
-    fprintf(stdout, "anStatPosGrand[%d]: %d\n", kk, anStatPosGrand[kk]);
-    fprintf(stdout, "anStatNegGrand[%d]: %d\n", kk, anStatNegGrand[kk]);
-  }
+  fprintf(stdout, "[%d]: anStatPosGrand: %d\tanStatNegGrand: %d\n", k,
+          anStatPosGrand[k], anStatNegGrand[k]);
 #endif // DEBUG
 }
 
-// FUNCTION: _doConvolution_bbox()
+// FUNCTION: _doConvolution()
 // 1. Convolve integerized input image (in bufferIn) against
 //    each filter in gabor filter bank, storing the result
 //    (in integer32) in the output buffers.
 // 2. While performing convolution, keeps track of the
 //    neccessary statistics for use in normalization
 //    during Pass II.
-// For case where valid box is provided instead of valid
-// alpha channel.
-void _doConvolution_bbox(const NUMPY_ARRAY *psBufferIn,
-                         const NUMPY_ARRAY *psBufferOut,
-                         const NUMPY_ARRAY *psGaborBank, const BBOX *psInputBox,
-                         const BBOX *psOutputBox, PHASE_MODE ePhaseMode,
-                         NORMALIZE_METHOD eNormalizeMethod,
-                         NORMALIZE_MODE eNormalizeMode,
-                         unsigned int anStatPosGrand[],
-                         unsigned int anStatNegGrand[]) {
-  int i, j, jj;
-  int nFilterIndex;
-  int nResponse;
-  int nNumPixels = 0;
-  const int *pnInput = nullptr;
-  const int *pnInputRow = nullptr;
-  const int *pnInputPtr = nullptr;
-  const int *pnGaborPtr = nullptr;
-  int *pnOutputRow = nullptr;
-
-  // Decide which statistics to keep.
-  // There are four cases:
-  //  1. Record max response in single-phase mode.
-  //     To do this, we need to keep track of the maximum
-  //     absolute value response.
-  //  2. Record max response in dual-phase mode.
-  //     For this, we need to keep track of the maximum
-  //     and minimum response.  At the end of the processing
-  //     cycle, we will do a sanity check to make sure that
-  //     something crazy didn't happen, like the minimum
-  //     response was positive, or vice versa.
-  //  3. Record mean response in single-phase mode.
-  //     For this, we need to accummulate the sume of
-  //     the absolute values of the responses.
-  //  4. Record mean response in dual-phase mode.
-  //     For this, we need to keep the sum of all
-  //     negative responses as well as (independently)
-  //     the sum of all positive responses.
-  // We will use "generalized" variables to keep track
-  // of the positive and negative (if dual phase) running
-  // statistics.
-  // Note also: for the summed values, we'll use a pair of
-  // row-wise accummulators, as well as a pair of grand
-  // accummulators (in order to avoid overflow issues.)
-  int nStatPosGrand, nStatNegGrand;
-  int nStatPosRow, nStatNegRow;
-  unsigned int nStatFlags = STATS_NONE;
-  switch (eNormalizeMethod) {
-  // Max-based normalization
-  case NORMALIZE_METHOD_MAX:
-  case NORMALIZE_METHOD_MAXPOWER:
-    if (ePhaseMode == PHASE_MODE_SINGLE)
-      nStatFlags |= STATS_MAX_ABS;
-    else {
-      NTA_ASSERT(ePhaseMode == PHASE_MODE_DUAL);
-      nStatFlags |= STATS_MAX_MIN;
-    }
-    break;
-  // Mean-based normalization
-  case NORMALIZE_METHOD_MEAN:
-  case NORMALIZE_METHOD_MEANPOWER:
-    if (ePhaseMode == PHASE_MODE_SINGLE)
-      nStatFlags |= STATS_SUM_ABS;
-    else {
-      NTA_ASSERT(ePhaseMode == PHASE_MODE_DUAL);
-      nStatFlags |= STATS_SUM_POS_NEG;
-    }
-    // We'll need to know the total number of pixels
-    nNumPixels = (psOutputBox->nRight - psOutputBox->nLeft) *
-                 (psOutputBox->nBottom - psOutputBox->nTop);
-    if (eNormalizeMode == NORMALIZE_MODE_GLOBAL)
-      nNumPixels *= GABORSET_PLANES(psGaborBank);
-    break;
-  // No normalization needed
-  case NORMALIZE_METHOD_FIXED:
-    break;
-  // This case should never happen
-  default:
-    NTA_ASSERT(false);
-  }
+// If psAlpha is provided, responses are only generated for
+// output points that lie within the valid alpha channel;
+// otherwise the whole valid box (psOutputBox) is computed.
+//
+// The (filter, band of rows) pairs are independent, so they are
+// spread over the shared thread pool. Statistics are first kept
+// per row and then merged in row order, which gives the same
+// normalizers as a serial pass.
+void _doConvolution(const NUMPY_ARRAY *psBufferIn,
+                    const NUMPY_ARRAY *psBufferOut,
+                    const NUMPY_ARRAY *psGaborBank, const NUMPY_ARRAY *psAlpha,
+                    const BBOX *psInputBox, const BBOX *psOutputBox,
+                    PHASE_MODE ePhaseMode, NORMALIZE_METHOD eNormalizeMethod,
+                    NORMALIZE_MODE eNormalizeMode,
+                    unsigned int anStatPosGrand[],
+                    unsigned int anStatNegGrand[]) {
+
+  unsigned int nStatFlags = _statisticsFlags(ePhaseMode, eNormalizeMethod);
 
   // Ascertain size of gabor filter mask
   NTA_ASSERT(IMAGESET_ROWS(psGaborBank) == IMAGESET_COLS(psGaborBank));
   int nFilterDim = IMAGESET_ROWS(psGaborBank);
+  int nNumFilters = GABORSET_PLANES(psGaborBank);
+  NTA_ASSERT(nNumFilters <= MAXNUM_FILTERS);
 
-  // Locate start of correct Gabor filter
+  // Locate start of first Gabor filter
   const int *pnFilterBase = (const int *)psGaborBank->pData;
+  int nFilterPlaneStride =
+      IMAGESET_PLANESTRIDE(psGaborBank) / sizeof(*pnFilterBase);
 
-  // Locate start of correct output plane
+  // Locate start of first output plane
   int *pnOutputBase = (int *)psBufferOut->pData;
   int nOutputRowStride =
       IMAGESET_ROWSTRIDE(psBufferOut) / sizeof(*pnOutputBase);
+  int nOutputPlaneStride =
+      IMAGESET_PLANESTRIDE(psBufferOut) / sizeof(*pnOutputBase);
 
-  // Guard against buffer over-runs
-#ifdef DEBUG
-  // Start/end of memory
-  const char *pDebugOutputSOMB = (const char *)(psBufferOut->pData);
-  const char *pDebugOutputEOMB =
-      pDebugOutputSOMB +
-      IMAGESET_PLANESTRIDE(psBufferOut) * IMAGESET_PLANES(psBufferOut);
-#endif // DEBUG
-
-  // Locate the start of input plane
+  // Locate the start of our useful input
   const int *pnInputBase = (const int *)psBufferIn->pData;
   int nInputRowStride = IMAGE_ROWSTRIDE(psBufferIn) / sizeof(*pnInputBase);
-  int nInputRowAdvance = nInputRowStride - nFilterDim;
+  pnInputBase += nInputRowStride * psInputBox->nTop + psInputBox->nLeft;
+
+  // We might be in constrained mode, in which case we need to
+  // map our alpha locations (organized in input space) into
+  // our response locations (organized in output space).
+  // The shrinkage values (in X and Y dimensions) allow us to
+  // convert from input space to output space:
+  //    outputX = inputX - nShrinkageX
+  //    outputY = inputY - nShrinkageY
+  // For sweep-off mode, the shrinkages will be zero.
+  const float *pfAlphaBase = nullptr;
+  int nAlphaRowStride = 0;
+  if (psAlpha) {
+    int nShrinkageX = (psInputBox->nRight - psOutputBox->nRight) >> 1;
+    int nShrinkageY = (psInputBox->nBottom - psOutputBox->nBottom) >> 1;
+    pfAlphaBase = (const float *)psAlpha->pData;
+    nAlphaRowStride = IMAGE_ROWSTRIDE(psAlpha) / sizeof(*pfAlphaBase);
+    pfAlphaBase += (psOutputBox->nTop + nShrinkageY) * nAlphaRowStride +
+                   psOutputBox->nLeft + nShrinkageX;
+  }
 
   // Take into account bounding box suppression
   int nOutputRows = (psOutputBox->nBottom - psOutputBox->nTop);
@@ -1311,483 +784,106 @@ void _doConvolution_bbox(const NUMPY_ARRAY *psBufferIn,
   // Our output buffers should be 4-pixel aligned
   NTA_ASSERT(IMAGESET_COLS(psBufferOut) % 4 == 0);
 
-  // Pre-compute some calculations
-  int nNumBlankTopRows = psOutputBox->nTop;
-
-  // Initialize stats
-  nStatPosGrand = 0;
-  nStatNegGrand = 0;
-
-  for (nFilterIndex = 0; nFilterIndex < GABORSET_PLANES(psGaborBank);
-       nFilterIndex++) {
-
-    // Initialize stats
-    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT) {
-      nStatPosGrand = 0;
-      nStatNegGrand = 0;
+  // We'll need to know the total number of pixels if we
+  // are using a mean-based normalization.
+  int nNumPixels = 0;
+  if (nStatFlags & STATS_MEAN) {
+    if (!psAlpha) {
+      nNumPixels = nOutputRows * nOutputCols;
+      if (eNormalizeMode == NORMALIZE_MODE_GLOBAL)
+        nNumPixels *= nNumFilters;
     }
+    // With an alpha channel, the pixels are only counted when
+    // using global normalization: we run across the alpha channel
+    // to check how many positive pixels it has. We're summing the
+    // responses over all planes, so there will a multiple of
+    // positive alpha pixels equal to the number of filter planes.
+    else if (eNormalizeMode == NORMALIZE_MODE_GLOBAL) {
+      for (int j = 0; j < nOutputRows; j++) {
+        const float *pfAlphaRow = pfAlphaBase + j * nAlphaRowStride;
+        for (int i = 0; i < nOutputCols; i++)
+          if (pfAlphaRow[i])
+            nNumPixels++;
+      }
+      nNumPixels *= nNumFilters;
+    }
+  }
 
-    // Advance to beginning of our useful input
-    pnInput =
-        pnInputBase + nInputRowStride * psInputBox->nTop + psInputBox->nLeft;
-
-    // Process each plane of output
-    const int *pnFilter = pnFilterBase;
-    int *pnOutput = pnOutputBase;
-
-    // Zero out any rows above the bounding box
-    pnOutput += nNumBlankTopRows * nOutputRowStride;
-
-    // Process each row within the bounding box (vertically)
-    for (j = nOutputRows; j; j--) {
-      pnOutputRow = pnOutput;
-
-      // Initialize row-wise accummulator
-      nStatPosRow = 0;
-      nStatNegRow = 0;
-
-      // Skip any pixels on this row that lie on left side of bounding box
-      pnOutputRow += psOutputBox->nLeft;
-
-      // Process this ouput row, one output location at a time
-      pnInputRow = pnInput;
-
-      // Unrolled loops; instead of doing this:
-      //
-      //  for (ii=nFilterDim; ii; ii--)
-      //    nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-      //
-      // We'll just hard-code the operations
-      switch (nFilterDim) {
-
-      // Filter: 5x5
-      case 5:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-          for (jj = nFilterDim; jj; jj--) {
-
-            // First 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Second 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            pnInputPtr += nInputRowAdvance;
-          }
-
-          // Keep statistics for normalization
-          if (nStatFlags & STATS_MAX_ABS)
-            nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-          else if (nStatFlags & STATS_MAX_MIN) {
-            if (nResponse >= 0)
-              nStatPosGrand = MAX(nStatPosGrand, nResponse);
-            else
-              nStatNegGrand = MIN(nStatNegGrand, nResponse);
-          } else if (nStatFlags & STATS_SUM_ABS)
-            nStatPosRow += IABS32(nResponse);
-          else if (nStatFlags & STATS_SUM_POS_NEG) {
-            if (nResponse >= 0)
-              nStatPosRow += nResponse;
-            else
-              nStatNegRow -= nResponse;
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 7x7
-      case 7:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-          for (jj = nFilterDim; jj; jj--) {
-
-            // First 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Second 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            pnInputPtr += nInputRowAdvance;
-          }
-
-          // Keep statistics for normalization
-          if (nStatFlags & STATS_MAX_ABS)
-            nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-          else if (nStatFlags & STATS_MAX_MIN) {
-            if (nResponse >= 0)
-              nStatPosGrand = MAX(nStatPosGrand, nResponse);
-            else
-              nStatNegGrand = MIN(nStatNegGrand, nResponse);
-          } else if (nStatFlags & STATS_SUM_ABS)
-            nStatPosRow += IABS32(nResponse);
-          else if (nStatFlags & STATS_SUM_POS_NEG) {
-            if (nResponse >= 0)
-              nStatPosRow += nResponse;
-            else
-              nStatNegRow -= nResponse;
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 9x9
-      case 9:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-          for (jj = nFilterDim; jj; jj--) {
-
-            // First 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Second 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Third 128-bits (when we convert to SSE2 we'll
-            // do a 12th position - after making sure to pad
-            // things in advance to avoid a buffer overflow.)
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            pnInputPtr += nInputRowAdvance;
-          }
-
-          // Keep statistics for normalization
-          if (nStatFlags & STATS_MAX_ABS)
-            nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-          else if (nStatFlags & STATS_MAX_MIN) {
-            if (nResponse >= 0)
-              nStatPosGrand = MAX(nStatPosGrand, nResponse);
-            else
-              nStatNegGrand = MIN(nStatNegGrand, nResponse);
-          } else if (nStatFlags & STATS_SUM_ABS)
-            nStatPosRow += IABS32(nResponse);
-          else if (nStatFlags & STATS_SUM_POS_NEG) {
-            if (nResponse >= 0)
-              nStatPosRow += nResponse;
-            else
-              nStatNegRow -= nResponse;
-          }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
-
-      // Filter: 11x11
-      case 11:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-          for (jj = nFilterDim; jj; jj--) {
-
-            // First 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Second 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Third 128-bits (when we convert to SSE2 we'll
-            // do a 12th position - after making sure to pad
-            // things in advance to avoid a buffer overflow.)
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            pnInputPtr += nInputRowAdvance;
-          }
-
-          // Keep statistics for normalization
-          if (nStatFlags & STATS_MAX_ABS)
-            nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-          else if (nStatFlags & STATS_MAX_MIN) {
-            if (nResponse >= 0)
-              nStatPosGrand = MAX(nStatPosGrand, nResponse);
-            else
-              nStatNegGrand = MIN(nStatNegGrand, nResponse);
-          } else if (nStatFlags & STATS_SUM_ABS)
-            nStatPosRow += IABS32(nResponse);
-          else if (nStatFlags & STATS_SUM_POS_NEG) {
-            if (nResponse >= 0)
-              nStatPosRow += nResponse;
-            else
-              nStatNegRow -= nResponse;
+  // Row-wise statistics, for each filter
+  std::vector<int> anStatPosRow(nNumFilters * nOutputRows);
+  std::vector<int> anStatNegRow(nNumFilters * nOutputRows);
+
+  int nNumBands = (nOutputRows + CONVOLUTION_ROW_BAND - 1) /
+                  CONVOLUTION_ROW_BAND;
+
+  nupic::util::ThreadPool::shared().parallelFor(
+      0, nNumFilters * nNumBands, [&](nupic::UInt nBegin, nupic::UInt nEnd) {
+        for (nupic::UInt t = nBegin; t < nEnd; t++) {
+          int nFilterIndex = t / nNumBands;
+          int nRowBegin = (t % nNumBands) * CONVOLUTION_ROW_BAND;
+          int nRowEnd = MIN(nRowBegin + CONVOLUTION_ROW_BAND, nOutputRows);
+
+          const int *pnFilter = pnFilterBase + nFilterIndex * nFilterPlaneStride;
+          int *pnOutput = pnOutputBase + nFilterIndex * nOutputPlaneStride +
+                          psOutputBox->nTop * nOutputRowStride +
+                          psOutputBox->nLeft;
+
+          for (int j = nRowBegin; j < nRowEnd; j++) {
+            int *pnOutputRow = pnOutput + j * nOutputRowStride;
+            _convolveRow(pnFilter, nFilterDim,
+                         pnInputBase + j * nInputRowStride, nInputRowStride,
+                         pfAlphaBase ? pfAlphaBase + j * nAlphaRowStride
+                                     : nullptr,
+                         pnOutputRow, nOutputCols);
+
+            int k = nFilterIndex * nOutputRows + j;
+            _rowStatistics(pnOutputRow, nOutputCols, nStatFlags,
+                           anStatPosRow[k], anStatNegRow[k]);
           }
-
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
-
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
-
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
         }
-        break;
-
-      // Filter: 13x13
-      case 13:
-        for (i = nOutputCols; i; i--) {
-          // Process each row in the filter mask
-          pnGaborPtr = pnFilter;
-          pnInputPtr = pnInputRow;
-
-          // Compute gabor response for this location
-          nResponse = 0;
-          for (jj = nFilterDim; jj; jj--) {
-
-            // First 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Second 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Third 128-bits
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            // Fourth 128-bits (when we convert to SSE2 we'll
-            // do a 12th position - after making sure to pad
-            // things in advance to avoid a buffer overflow.)
-            nResponse += (*pnGaborPtr++) * (*pnInputPtr++);
-
-            pnInputPtr += nInputRowAdvance;
-          }
+      });
 
-          // Keep statistics for normalization
-          if (nStatFlags & STATS_MAX_ABS)
-            nStatPosGrand = MAX(nStatPosGrand, IABS32(nResponse));
-          else if (nStatFlags & STATS_MAX_MIN) {
-            if (nResponse >= 0)
-              nStatPosGrand = MAX(nStatPosGrand, nResponse);
-            else
-              nStatNegGrand = MIN(nStatNegGrand, nResponse);
-          } else if (nStatFlags & STATS_SUM_ABS)
-            nStatPosRow += IABS32(nResponse);
-          else if (nStatFlags & STATS_SUM_POS_NEG) {
-            if (nResponse >= 0)
-              nStatPosRow += nResponse;
-            else
-              nStatNegRow -= nResponse;
-          }
+  // Merge the row-wise statistics.
+  int nStatPosGrand = 0;
+  int nStatNegGrand = 0;
 
-          // Memory bounds checking
-#ifdef DEBUG
-          NTA_ASSERT((const char *)pnOutputRow >= pDebugOutputSOMB);
-          NTA_ASSERT((const char *)pnOutputRow < pDebugOutputEOMB);
-#endif // DEBUG
+  for (int nFilterIndex = 0; nFilterIndex < nNumFilters; nFilterIndex++) {
 
-          // Apply abs() and clipping, and then advance to next location
-          // Note: our gabor filter masks were pre-scaled by shifting
-          // 12 bits to the left, so we'll reverse that.
-          *pnOutputRow++ = nResponse;
+    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT) {
+      nStatPosGrand = 0;
+      nStatNegGrand = 0;
+    }
 
-          // Move the upper-left corner of our gabor receptive field
-          // to the next neighboring pixel in image space.
-          pnInputRow++;
-        }
-        break;
+    for (int j = 0; j < nOutputRows; j++) {
+      int k = nFilterIndex * nOutputRows + j;
+      if (nStatFlags & STATS_MAX) {
+        nStatPosGrand = MAX(nStatPosGrand, anStatPosRow[k]);
+        nStatNegGrand = MIN(nStatNegGrand, anStatNegRow[k]);
       }
-
       // Accummulate our summing stats.
       // We'll rightshift by 8 bits to keep things from overflowing.
       // We'll also flip the sign of the negative accummulator
-      if (nStatFlags & STATS_MEAN) {
-        nStatPosGrand += (nStatPosRow >> 8);
-        nStatNegGrand += ((-nStatNegRow) >> 8);
+      else if (nStatFlags & STATS_MEAN) {
+        nStatPosGrand += (anStatPosRow[k] >> 8);
+        nStatNegGrand += ((-anStatNegRow[k]) >> 8);
       }
-
-      // Advance to next rows
-      pnInput += nInputRowStride;
-      pnOutput += nOutputRowStride;
     }
 
-    // Advance to correct plane for gabor filter and output buffer
-    pnFilterBase += IMAGESET_PLANESTRIDE(psGaborBank) / sizeof(*pnFilter);
-    pnOutputBase += IMAGESET_PLANESTRIDE(psBufferOut) / sizeof(*pnOutput);
-
     // If we are storing statistics on a per-filter basis,
     // then we need to dump our stats to the buffer
-    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT) {
-
-      // Compute final values of the normalizers to use
-      _computeNormalizers(nStatPosGrand, nStatNegGrand, nStatFlags,
-                          eNormalizeMethod, nNumPixels);
-
-      NTA_ASSERT(nStatPosGrand >= 0);
-      anStatPosGrand[nFilterIndex] = (unsigned int)(nStatPosGrand + 1);
-      // We also need to flip the sign of our negative
-      // max stat if we are in dual phase.
-      // if (nStatFlags & STATS_MAX_MIN)
-      //  nStatNegGrand = -nStatNegGrand;
-      // if (nStatFlags & STATS_DUAL) {
-      if (ePhaseMode == PHASE_MODE_DUAL) {
-        nStatNegGrand = -nStatNegGrand;
-        NTA_ASSERT(nStatNegGrand >= 0);
-        // We add one to the statistical quantity because we want to
-        // round up in the case of integer arithmetic round off
-        // errors.  That way (for example) our MAX statistic will
-        // be guaranteed to be >= the largest actual value.
-        anStatNegGrand[nFilterIndex] = (unsigned int)(nStatNegGrand + 1);
-      }
-
-      // Debugging
-#ifdef DEBUG
-      for (int kk = 0; kk <= nFilterIndex; kk++) {
-        fprintf(stdout, "[%d]: anStatPosGrand: %d\tanStatNegGrand: %d\n", kk,
-                anStatPosGrand[kk], anStatNegGrand[kk]);
-      }
-#endif // DEBUG
-    }
-  } // for each filter (output plane)
+    if (eNormalizeMode == NORMALIZE_MODE_PERORIENT)
+      _storeStatistics(nStatPosGrand, nStatNegGrand, nStatFlags, ePhaseMode,
+                       eNormalizeMethod, nNumPixels, nFilterIndex,
+                       anStatPosGrand, anStatNegGrand);
+  }
 
   // If we are storing statistics globally (i.e., not on a
   // per-filter basis), then we can finally dump our stats
   // to the buffer.
-  if (eNormalizeMode == NORMALIZE_MODE_GLOBAL) {
-
-    // Compute final values of the normalizers to use
-    _computeNormalizers(nStatPosGrand, nStatNegGrand, nStatFlags,
-                        eNormalizeMethod, nNumPixels);
-
-    NTA_ASSERT(nStatPosGrand >= 0);
-    anStatPosGrand[0] = (unsigned int)(nStatPosGrand + 1);
-    // We also need to flip the sign of our negative
-    // max stat if we are in dual phase.
-    // if (nStatFlags & STATS_MAX_MIN)
-    //  nStatNegGrand = -nStatNegGrand;
-    // if (nStatFlags & STATS_DUAL) {
-    if (ePhaseMode == PHASE_MODE_DUAL) {
-      nStatNegGrand = -nStatNegGrand;
-      NTA_ASSERT(nStatNegGrand >= 0);
-      anStatNegGrand[0] = (unsigned int)(nStatNegGrand + 1);
-    }
-  }
-
-  // Debug
-#ifdef DEBUG
-  for (int kk = 0; kk < 1; kk++) {
-    fprintf(stdout, "anStatPosGrand[%d]: %d\n", kk, anStatPosGrand[kk]);
-    fprintf(stdout, "anStatNegGrand[%d]: %d\n", kk, anStatNegGrand[kk]);
-  }
-#endif // DEBUG
-}
-
-// FUNCTION: _doConvolution()
-// 1. Convolve integerized input image (in bufferIn) against
-//    each filter in gabor filter bank, storing the result
-//    (in integer32) in the output buffers.
-// 2. While performing convolution, keeps track of the
-//    neccessary statistics for use in normalization
-//    during Pass II.
-void _doConvolution(const NUMPY_ARRAY *psBufferIn,
-                    const NUMPY_ARRAY *psBufferOut,
-                    const NUMPY_ARRAY *psGaborBank, const NUMPY_ARRAY *psAlpha,
-                    const BBOX *psInputBox, const BBOX *psOutputBox,
-                    PHASE_MODE ePhaseMode, NORMALIZE_METHOD eNormalizeMethod,
-                    NORMALIZE_MODE eNormalizeMode,
-                    unsigned int anStatPosGrand[],
-                    unsigned int anStatNegGrand[]) {
-
-  if (psAlpha)
-    _doConvolution_alpha(psBufferIn, psBufferOut, psGaborBank, psAlpha,
-                         psInputBox, psOutputBox, ePhaseMode, eNormalizeMethod,
-                         eNormalizeMode, anStatPosGrand, anStatNegGrand);
-  else
-    _doConvolution_bbox(psBufferIn, psBufferOut, psGaborBank, psInputBox,
-                        psOutputBox, ePhaseMode, eNormalizeMethod,
-                        eNormalizeMode, anStatPosGrand, anStatNegGrand);
+  if (eNormalizeMode == NORMALIZE_MODE_GLOBAL)
+    _storeStatistics(nStatPosGrand, nStatNegGrand, nStatFlags, ePhaseMode,
+                     eNormalizeMethod, nNumPixels, 0, anStatPosGrand,
+                     anStatNegGrand);
 }
 
 // FUNCTION: _computeGains()
@@ -0,0 +1,256 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ----------------------------------------------------------------------
+ */
+
+/** @file
+ * Definitions for the ListPool class, the storage of the segment and
+ * synapse lists of Connections.
+ */
+
+#ifndef NTA_LIST_POOL_HPP
+#define NTA_LIST_POOL_HPP
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+#include <nupic/utils/Log.hpp>
+
+namespace nupic {
+
+namespace algorithms {
+
+namespace connections {
+
+/**
+ * Many small lists stored in blocks of one contiguous vector.
+ *
+ * @b Description
+ * A list owns a block of a fixed capacity. The capacities double from
+ * minCapacity up to the maximum size of a list, which is the last
+ * capacity. A full list moves to a block of the next capacity, and the
+ * blocks that lists leave are reused by lists of the same capacity. So
+ * growing, shrinking and destroying lists allocates memory only when the
+ * pool runs out of free blocks, and lists never hold more than twice their
+ * size.
+ *
+ * The List headers are owned by the user of the pool, which passes them to
+ * every call. Pointers into a list are invalidated when any list grows.
+ */
+template <typename T> class ListPool {
+public:
+  static const UInt32 minCapacity = 4;
+
+  struct List {
+    UInt32 offset;
+    UInt32 size;
+    UInt32 capacity;
+
+    List() : offset(0), size(0), capacity(0) {}
+  };
+
+  /**
+   * A read-only view of a list, used like a const std::vector. It reads the
+   * list header and the pool on every call, so it follows changes to the
+   * list, and it's valid as long as both are.
+   */
+  class View {
+  public:
+    typedef T value_type;
+    typedef const T *const_iterator;
+    typedef const T *iterator;
+
+    View() : pool_(nullptr), list_(nullptr) {}
+    View(const ListPool *pool, const List *list) : pool_(pool), list_(list) {}
+
+    const T *begin() const { return pool_->data(*list_); }
+    const T *end() const { return begin() + list_->size; }
+    size_t size() const { return list_->size; }
+    bool empty() const { return list_->size == 0; }
+
+    const T &operator[](size_t i) const {
+      NTA_ASSERT(i < size());
+      return begin()[i];
+    }
+    const T &front() const { return (*this)[0]; }
+    const T &back() const { return (*this)[size() - 1]; }
+
+    operator std::vector<T>() const { return std::vector<T>(begin(), end()); }
+
+  private:
+    const ListPool *pool_;
+    const List *list_;
+  };
+
+  explicit ListPool(UInt32 maxSize = std::numeric_limits<UInt32>::max()) {
+    initialize(maxSize);
+  }
+
+  /**
+   * Frees the storage of all lists, and sets the maximum size of a list.
+   * The List headers of the old lists must be reset by the caller.
+   */
+  void initialize(UInt32 maxSize) {
+    NTA_CHECK(maxSize > 0);
+    maxSize_ = maxSize;
+    data_.clear();
+    data_.shrink_to_fit();
+    freeBlocks_.clear();
+  }
+
+  UInt32 maxSize() const { return maxSize_; }
+
+  /**
+   * The number of elements the pool has room for, in lists and free blocks.
+   */
+  size_t storageSize() const { return data_.size(); }
+
+  View view(const List &list) const { return View(this, &list); }
+
+  const T *data(const List &list) const { return data_.data() + list.offset; }
+
+  T *data(const List &list) { return data_.data() + list.offset; }
+
+  void push_back(List &list, const T &value) {
+    if (list.size == list.capacity) {
+      moveToBlock_(list, nextCapacity_(list.capacity));
+    }
+    data_[list.offset + list.size++] = value;
+  }
+
+  /**
+   * Removes the element at index i, keeping the order of the others.
+   */
+  void erase(List &list, UInt32 i) {
+    NTA_ASSERT(i < list.size);
+    T *first = data(list);
+    std::copy(first + i + 1, first + list.size, first + i);
+    if (--list.size == 0) {
+      clear(list);
+    }
+  }
+
+  void clear(List &list) {
+    release_(list.offset, list.capacity);
+    list = List();
+  }
+
+  /**
+   * Moves the lists, in this order, to the smallest blocks that hold them,
+   * and frees the rest of the storage. Every list with elements must be
+   * passed.
+   */
+  void compact(const std::vector<List *> &lists) {
+    size_t size = 0;
+    for (const List *list : lists) {
+      size += fit_(list->size);
+    }
+
+    std::vector<T> data;
+    data.reserve(size);
+    for (List *list : lists) {
+      const UInt32 offset = (UInt32)data.size();
+      const UInt32 capacity = fit_(list->size);
+      data.insert(data.end(), data_.begin() + list->offset,
+                  data_.begin() + list->offset + list->size);
+      data.resize(offset + capacity);
+      list->offset = capacity ? offset : 0;
+      list->capacity = capacity;
+    }
+
+    data_.swap(data);
+    freeBlocks_.clear();
+  }
+
+private:
+  UInt32 nextCapacity_(UInt32 capacity) const {
+    NTA_CHECK(capacity < maxSize_)
+        << "A list can't hold more than " << maxSize_ << " elements";
+    const UInt64 next = capacity ? (UInt64)capacity * 2 : minCapacity;
+    return (UInt32)std::min(next, (UInt64)maxSize_);
+  }
+
+  // The smallest capacity that holds size elements
+  UInt32 fit_(UInt32 size) const {
+    UInt32 capacity = 0;
+    while (capacity < size) {
+      capacity = nextCapacity_(capacity);
+    }
+    return capacity;
+  }
+
+  // The index of a capacity in freeBlocks_
+  static size_t class_(UInt32 capacity) {
+    size_t i = 0;
+    while (((UInt64)minCapacity << i) < capacity) {
+      ++i;
+    }
+    return i;
+  }
+
+  void moveToBlock_(List &list, UInt32 capacity) {
+    UInt32 offset;
+    std::vector<UInt32> *freeBlocks =
+        class_(capacity) < freeBlocks_.size() ? &freeBlocks_[class_(capacity)]
+                                              : nullptr;
+    if (freeBlocks && !freeBlocks->empty()) {
+      offset = freeBlocks->back();
+      freeBlocks->pop_back();
+    } else {
+      NTA_CHECK(data_.size() + capacity <= std::numeric_limits<UInt32>::max())
+          << "The list pool is full";
+      offset = (UInt32)data_.size();
+      data_.resize(data_.size() + capacity);
+    }
+
+    std::copy(data_.begin() + list.offset,
+              data_.begin() + list.offset + list.size, data_.begin() + offset);
+    release_(list.offset, list.capacity);
+    list.offset = offset;
+    list.capacity = capacity;
+  }
+
+  void release_(UInt32 offset, UInt32 capacity) {
+    if (capacity == 0) {
+      return;
+    }
+    const size_t i = class_(capacity);
+    if (i >= freeBlocks_.size()) {
+      freeBlocks_.resize(i + 1);
+    }
+    freeBlocks_[i].push_back(offset);
+  }
+
+  UInt32 maxSize_;
+  std::vector<T> data_;
+
+  // The offsets of the free blocks of each capacity
+  std::vector<std::vector<UInt32>> freeBlocks_;
+};
+
+} // end namespace connections
+
+} // end namespace algorithms
+
+} // end namespace nupic
+
+#endif // NTA_LIST_POOL_HPP
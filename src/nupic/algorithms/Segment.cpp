@@ -220,7 +220,7 @@ void Segment::decaySynapses(Real decay, std::vector<UInt> &removed,
   if (_synapses.empty())
     return;
 
-  static std::vector<UInt> del;
+  thread_local std::vector<UInt> del;
   del.clear(); // purge residual data
 
   for (UInt i = 0; i != _synapses.size(); ++i) {
@@ -260,7 +260,7 @@ void Segment::decaySynapses2(Real decay, std::vector<UInt> &removed,
   if (_synapses.empty())
     return;
 
-  static std::vector<UInt> del;
+  thread_local std::vector<UInt> del;
   del.clear(); // purge residual data
 
   for (UInt i = 0; i != _synapses.size(); ++i) {
@@ -371,7 +371,7 @@ void Segment::freeNSynapses(UInt numToFree,
 
   //----------------------------------------------------------------------
   // Create the final list of synapses we will remove
-  static std::vector<UInt> del;
+  thread_local std::vector<UInt> del;
   del.clear(); // purge residual data
   for (UInt i = 0; i < numToFree; i++) {
     del.push_back(candidates[i].srcCellIdx());
@@ -407,8 +407,8 @@ public:
 
    */
   inline bool invariants() const {
-    static std::vector<UInt> indices;
-    static UInt highWaterSize = 0;
+    thread_local std::vector<UInt> indices;
+    thread_local UInt highWaterSize = 0;
     if (highWaterSize < _synapses.size()) {
       highWaterSize = _synapses.size();
       indices.reserve(highWaterSize);
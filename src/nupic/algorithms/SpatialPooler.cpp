@@ -24,6 +24,7 @@
  * Implementation of SpatialPooler
  */
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -56,6 +57,20 @@ static Real round5_(const Real f) {
   return p;
 }
 
+// y[i] = exp(x[i]) for i in [0, n), vectorized unless exact or Real is
+// double. y can be x.
+static void exp_(const Real *x, UInt n, Real *y, bool exact) {
+#if !defined(NTA_DOUBLE_PRECISION)
+  if (!exact) {
+    fast_exp(x, x + n, y);
+    return;
+  }
+#endif
+  for (UInt i = 0; i < n; i++) {
+    y[i] = exp(x[i]);
+  }
+}
+
 class CoordinateConverter2D {
 
 public:
@@ -105,6 +120,9 @@ private:
 SpatialPooler::SpatialPooler() {
   // The current version number.
   version_ = 2;
+  wrapAround_ = true;
+  exactExp_ = false;
+  selectLocalOps_();
 }
 
 SpatialPooler::SpatialPooler(
@@ -195,6 +213,10 @@ void SpatialPooler::setBoostStrength(Real boostStrength) {
   boostStrength_ = boostStrength;
 }
 
+bool SpatialPooler::getExactExp() const { return exactExp_; }
+
+void SpatialPooler::setExactExp(bool exactExp) { exactExp_ = exactExp; }
+
 UInt SpatialPooler::getIterationNum() const { return iterationNum_; }
 
 void SpatialPooler::setIterationNum(UInt iterationNum) {
@@ -215,7 +237,10 @@ void SpatialPooler::setSpVerbosity(UInt spVerbosity) {
 
 bool SpatialPooler::getWrapAround() const { return wrapAround_; }
 
-void SpatialPooler::setWrapAround(bool wrapAround) { wrapAround_ = wrapAround; }
+void SpatialPooler::setWrapAround(bool wrapAround) {
+  wrapAround_ = wrapAround;
+  selectLocalOps_();
+}
 
 UInt SpatialPooler::getUpdatePeriod() const { return updatePeriod_; }
 
@@ -393,6 +418,7 @@ void SpatialPooler::initialize(
   boostStrength_ = boostStrength;
   spVerbosity_ = spVerbosity;
   wrapAround_ = wrapAround;
+  selectLocalOps_();
   synPermMin_ = 0.0;
   synPermMax_ = 1.0;
   synPermTrimThreshold_ = synPermActiveInc / 2.0;
@@ -410,6 +436,7 @@ void SpatialPooler::initialize(
   potentialPools_.resize(numColumns_, numInputs_);
   permanences_.resize(numColumns_, numInputs_);
   connectedSynapses_.resize(numColumns_, numInputs_);
+  connectedColumns_.clear();
   connectedCounts_.resize(numColumns_);
 
   overlapDutyCycles_.assign(numColumns_, 0);
@@ -440,22 +467,16 @@ void SpatialPooler::initialize(
 void SpatialPooler::compute(UInt inputArray[], bool learn, UInt activeArray[]) {
   updateBookeepingVars_(learn);
   calculateOverlap_(inputArray, overlaps_);
-  calculateOverlapPct_(overlaps_, overlapsPct_);
-
-  if (learn) {
-    boostOverlaps_(overlaps_, boostedOverlaps_);
-  } else {
-    boostedOverlaps_.assign(overlaps_.begin(), overlaps_.end());
-  }
+  scoreOverlaps_(overlaps_, learn);
 
   inhibitColumns_(boostedOverlaps_, activeColumns_);
+  sort(activeColumns_.begin(), activeColumns_.end());
   toDense_(activeColumns_, activeArray, numColumns_);
 
   if (learn) {
     adaptSynapses_(inputArray, activeColumns_);
-    updateDutyCycles_(overlaps_, activeArray);
+    updateDutyCyclesAndBoostFactors_(overlaps_, activeColumns_);
     bumpUpWeakColumns_();
-    updateBoostFactors_();
     if (isUpdateRound_()) {
       updateInhibitionRadius_();
       updateMinDutyCycles_();
@@ -463,6 +484,36 @@ void SpatialPooler::compute(UInt inputArray[], bool learn, UInt activeArray[]) {
   }
 }
 
+void SpatialPooler::compute(const vector<UInt> &activeInputs, bool learn,
+                            vector<UInt> &activeColumns) {
+  for (UInt i = 0; i < activeInputs.size(); i++) {
+    NTA_CHECK(activeInputs[i] < numInputs_)
+        << "Invalid input index " << activeInputs[i] << ", the SP has "
+        << numInputs_ << " inputs";
+    NTA_CHECK(i == 0 || activeInputs[i - 1] < activeInputs[i])
+        << "The active inputs must be sorted, without duplicates";
+  }
+
+  updateBookeepingVars_(learn);
+  calculateOverlap_(activeInputs, overlaps_);
+  scoreOverlaps_(overlaps_, learn);
+
+  inhibitColumns_(boostedOverlaps_, activeColumns_);
+  sort(activeColumns_.begin(), activeColumns_.end());
+
+  if (learn) {
+    adaptSynapses_(activeInputs, activeColumns_);
+    updateDutyCyclesAndBoostFactors_(overlaps_, activeColumns_);
+    bumpUpWeakColumnsSparse_();
+    if (isUpdateRound_()) {
+      updateInhibitionRadius_();
+      updateMinDutyCycles_();
+    }
+  }
+
+  activeColumns.assign(activeColumns_.begin(), activeColumns_.end());
+}
+
 void SpatialPooler::stripUnlearnedColumns(UInt activeArray[]) const {
   for (UInt i = 0; i < numColumns_; i++) {
     if (activeDutyCycles_[i] == 0) {
@@ -471,6 +522,14 @@ void SpatialPooler::stripUnlearnedColumns(UInt activeArray[]) const {
   }
 }
 
+void SpatialPooler::stripUnlearnedColumns(vector<UInt> &activeColumns) const {
+  activeColumns.erase(remove_if(activeColumns.begin(), activeColumns.end(),
+                                [this](UInt column) {
+                                  return activeDutyCycles_[column] == 0;
+                                }),
+                      activeColumns.end());
+}
+
 void SpatialPooler::toDense_(vector<UInt> &sparse, UInt dense[], UInt n) {
   std::fill(dense, dense + n, 0);
   for (auto &elem : sparse) {
@@ -486,6 +545,33 @@ void SpatialPooler::boostOverlaps_(vector<UInt> &overlaps,
   }
 }
 
+void SpatialPooler::scoreOverlaps_(const vector<UInt> &overlaps, bool learn) {
+  overlapsPct_.resize(numColumns_);
+  boostedOverlaps_.resize(numColumns_);
+  const UInt *overlap = overlaps.data();
+  const UInt *connectedCount = connectedCounts_.data();
+  const Real *boostFactor = boostFactors_.data();
+  Real *overlapPct = overlapsPct_.data();
+  Real *boosted = boostedOverlaps_.data();
+
+  // The overlapPct of a column without connected synapse is 0, see
+  // calculateOverlapPct_
+  for (UInt i = 0; i < numColumns_; i++) {
+    overlapPct[i] = connectedCount[i] != 0
+                        ? ((Real)overlap[i]) / connectedCount[i]
+                        : (Real)0;
+  }
+  if (learn) {
+    for (UInt i = 0; i < numColumns_; i++) {
+      boosted[i] = overlap[i] * boostFactor[i];
+    }
+  } else {
+    for (UInt i = 0; i < numColumns_; i++) {
+      boosted[i] = (Real)overlap[i];
+    }
+  }
+}
+
 UInt SpatialPooler::mapColumn_(UInt column) {
   vector<UInt> columnCoords;
   CoordinateConverterND columnConv(columnDimensions_);
@@ -594,12 +680,105 @@ void SpatialPooler::updatePermanencesForColumn_(vector<Real> &perm, UInt column,
   }
 
   clip_(perm, true);
+  updateConnectedColumns_(column, connectedSparse);
   connectedSynapses_.replaceSparseRow(column, connectedSparse.begin(),
                                       connectedSparse.end());
   permanences_.setRowFromDense(column, perm);
   connectedCounts_[column] = numConnected;
 }
 
+void SpatialPooler::getPotentialPermanences_(UInt column,
+                                             vector<Real> &perm) const {
+  const auto potential = potentialPools_.getSparseRow(column);
+  perm.assign(potential.size(), 0);
+
+  // Both rows are sorted, and the non-zero permanences are potential
+  auto ind = permanences_.row_nz_index_begin(column);
+  const auto indEnd = permanences_.row_nz_index_end(column);
+  auto val = permanences_.row_nz_value_begin(column);
+  for (UInt k = 0; k < potential.size() && ind != indEnd; k++) {
+    while (ind != indEnd && *ind < potential[k]) {
+      ++ind;
+      ++val;
+    }
+    if (ind != indEnd && *ind == potential[k]) {
+      perm[k] = *val;
+    }
+  }
+}
+
+void SpatialPooler::updatePotentialPermanences_(vector<Real> &perm,
+                                                UInt column, bool raisePerm) {
+  const auto potential = potentialPools_.getSparseRow(column);
+  NTA_ASSERT(perm.size() == potential.size());
+
+  if (raisePerm) {
+    clip_(perm, false);
+    while (countConnected_(perm) < stimulusThreshold_) {
+      for (auto &elem : perm) {
+        elem += synPermBelowStimulusInc_;
+      }
+    }
+  }
+
+  vector<UInt> connectedSparse;
+  for (UInt k = 0; k < perm.size(); k++) {
+    if (perm[k] >= synPermConnected_ - PERMANENCE_EPSILON) {
+      connectedSparse.push_back(potential[k]);
+    }
+  }
+
+  clip_(perm, true);
+  vector<UInt> nonZeroIndices;
+  vector<Real> nonZeroPerms;
+  for (UInt k = 0; k < perm.size(); k++) {
+    if (!nearlyZero((Real64)perm[k])) {
+      nonZeroIndices.push_back(potential[k]);
+      nonZeroPerms.push_back(perm[k]);
+    }
+  }
+
+  updateConnectedColumns_(column, connectedSparse);
+  connectedSynapses_.replaceSparseRow(column, connectedSparse.begin(),
+                                      connectedSparse.end());
+  permanences_.setRowFromSparse(column, nonZeroIndices.begin(),
+                                nonZeroIndices.end(), nonZeroPerms.begin());
+  connectedCounts_[column] = (UInt)connectedSparse.size();
+}
+
+void SpatialPooler::updateConnectedColumns_(UInt column,
+                                            const vector<UInt> &connected) {
+  if (connectedColumns_.empty()) {
+    return;
+  }
+
+  auto disconnect = [&](UInt input) {
+    vector<UInt> &columns = connectedColumns_[input];
+    auto it = find(columns.begin(), columns.end(), column);
+    NTA_ASSERT(it != columns.end());
+    *it = columns.back();
+    columns.pop_back();
+  };
+
+  // Merge of the previous and the new connected inputs, both sorted
+  const auto previous = connectedSynapses_.getSparseRow(column);
+  auto it = previous.begin();
+  const auto end = previous.end();
+  for (UInt input : connected) {
+    while (it != end && *it < input) {
+      disconnect(*it++);
+    }
+    if (it != end && *it == input) {
+      ++it;
+    } else {
+      connectedColumns_[input].push_back(column);
+    }
+  }
+  while (it != end) {
+    disconnect(*it++);
+  }
+}
+
 UInt SpatialPooler::countConnected_(vector<Real> &perm) {
   UInt numConnected = 0;
   for (auto &elem : perm) {
@@ -667,22 +846,19 @@ void SpatialPooler::updateMinDutyCyclesGlobal_() {
 }
 
 void SpatialPooler::updateMinDutyCyclesLocal_() {
+  (this->*localOps_->updateMinDutyCycles)();
+}
+
+template <UInt Dims, bool Wrap>
+void SpatialPooler::updateMinDutyCyclesLocalImpl_() {
   for (UInt i = 0; i < numColumns_; i++) {
     Real maxActiveDuty = 0;
     Real maxOverlapDuty = 0;
-    if (wrapAround_) {
-      for (UInt column :
-           WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-        maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-      }
-    } else {
-      for (UInt column :
-           Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-        maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-      }
-    }
+    forEachNeighbor<Dims, Wrap>(
+        i, inhibitionRadius_, columnDimensions_, [&](UInt column) {
+          maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
+          maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
+        });
 
     minOverlapDutyCycles_[i] = maxOverlapDuty * minPctOverlapDutyCycles_;
   }
@@ -705,6 +881,30 @@ void SpatialPooler::updateDutyCycles_(vector<UInt> &overlaps,
   updateDutyCyclesHelper_(activeDutyCycles_, newActiveVal, period);
 }
 
+void SpatialPooler::updateDutyCycles_(const vector<UInt> &overlaps,
+                                      const vector<UInt> &activeColumns) {
+  const UInt period =
+      dutyCyclePeriod_ > iterationNum_ ? iterationNum_ : dutyCyclePeriod_;
+  NTA_ASSERT(period >= 1);
+
+  // In place, with the same expressions as in updateDutyCyclesHelper_
+  auto active = activeColumns.begin();
+  for (UInt i = 0; i < numColumns_; i++) {
+    const UInt newOverlap = overlaps[i] > 0 ? 1 : 0;
+    UInt newActive = 0;
+    if (active != activeColumns.end() && *active == i) {
+      newActive = 1;
+      ++active;
+    }
+    overlapDutyCycles_[i] =
+        (overlapDutyCycles_[i] * (period - 1) + newOverlap) / period;
+    activeDutyCycles_[i] =
+        (activeDutyCycles_[i] * (period - 1) + newActive) / period;
+  }
+  NTA_ASSERT(active == activeColumns.end())
+      << "The active columns must be sorted, without duplicates";
+}
+
 Real SpatialPooler::avgColumnsPerInput_() {
   UInt numDim = max(columnDimensions_.size(), inputDimensions_.size());
   Real columnsPerInput = 0;
@@ -810,6 +1010,27 @@ void SpatialPooler::adaptSynapses_(UInt inputVector[],
   }
 }
 
+void SpatialPooler::adaptSynapses_(const vector<UInt> &activeInputs,
+                                   vector<UInt> &activeColumns) {
+  vector<Real> perm;
+  for (UInt column : activeColumns) {
+    getPotentialPermanences_(column, perm);
+    const auto potential = potentialPools_.getSparseRow(column);
+    auto input = activeInputs.begin();
+    for (UInt k = 0; k < potential.size(); k++) {
+      while (input != activeInputs.end() && *input < potential[k]) {
+        ++input;
+      }
+      if (input != activeInputs.end() && *input == potential[k]) {
+        perm[k] += synPermActiveInc_;
+      } else {
+        perm[k] -= synPermInactiveDec_;
+      }
+    }
+    updatePotentialPermanences_(perm, column, true);
+  }
+}
+
 void SpatialPooler::bumpUpWeakColumns_() {
   for (UInt i = 0; i < numColumns_; i++) {
     if (overlapDutyCycles_[i] >= minOverlapDutyCycles_[i]) {
@@ -828,6 +1049,20 @@ void SpatialPooler::bumpUpWeakColumns_() {
   }
 }
 
+void SpatialPooler::bumpUpWeakColumnsSparse_() {
+  vector<Real> perm;
+  for (UInt i = 0; i < numColumns_; i++) {
+    if (overlapDutyCycles_[i] >= minOverlapDutyCycles_[i]) {
+      continue;
+    }
+    getPotentialPermanences_(i, perm);
+    for (auto &elem : perm) {
+      elem += synPermBelowStimulusInc_;
+    }
+    updatePotentialPermanences_(perm, i, false);
+  }
+}
+
 void SpatialPooler::updateDutyCyclesHelper_(vector<Real> &dutyCycles,
                                             vector<UInt> &newValues,
                                             UInt period) {
@@ -846,7 +1081,7 @@ void SpatialPooler::updateBoostFactors_() {
   }
 }
 
-void SpatialPooler::updateBoostFactorsGlobal_() {
+Real SpatialPooler::globalTargetDensity_() const {
   Real targetDensity;
   if (numActiveColumnsPerInhArea_ > 0) {
     UInt inhibitionArea =
@@ -857,35 +1092,101 @@ void SpatialPooler::updateBoostFactorsGlobal_() {
   } else {
     targetDensity = localAreaDensity_;
   }
+  return targetDensity;
+}
+
+void SpatialPooler::updateBoostFactorsGlobal_() {
+  const Real targetDensity = globalTargetDensity_();
 
+  // The exponents, then their exponentials in place
   for (UInt i = 0; i < numColumns_; ++i) {
-    boostFactors_[i] =
-        exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
+    boostFactors_[i] = (targetDensity - activeDutyCycles_[i]) * boostStrength_;
   }
+  exp_(boostFactors_.data(), numColumns_, boostFactors_.data(),
+       exactExp_);
 }
 
 void SpatialPooler::updateBoostFactorsLocal_() {
+  (this->*localOps_->updateBoostFactors)();
+}
+
+template <UInt Dims, bool Wrap>
+void SpatialPooler::updateBoostFactorsLocalImpl_() {
   for (UInt i = 0; i < numColumns_; ++i) {
     UInt numNeighbors = 0;
     Real localActivityDensity = 0;
 
-    if (wrapAround_) {
-      for (UInt neighbor :
-           WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
-    } else {
-      for (UInt neighbor :
-           Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
-    }
+    forEachNeighbor<Dims, Wrap>(
+        i, inhibitionRadius_, columnDimensions_, [&](UInt neighbor) {
+          localActivityDensity += activeDutyCycles_[neighbor];
+          numNeighbors += 1;
+        });
 
     Real targetDensity = localActivityDensity / numNeighbors;
-    boostFactors_[i] =
-        exp((targetDensity - activeDutyCycles_[i]) * boostStrength_);
+    boostFactors_[i] = (targetDensity - activeDutyCycles_[i]) * boostStrength_;
+  }
+  exp_(boostFactors_.data(), numColumns_, boostFactors_.data(),
+       exactExp_);
+}
+
+void SpatialPooler::updateDutyCyclesAndBoostFactors_(
+    const vector<UInt> &overlaps, const vector<UInt> &activeColumns) {
+  if (!globalInhibition_) {
+    updateDutyCycles_(overlaps, activeColumns);
+    updateBoostFactorsLocal_();
+    return;
+  }
+
+  const UInt period =
+      dutyCyclePeriod_ > iterationNum_ ? iterationNum_ : dutyCyclePeriod_;
+  NTA_ASSERT(period >= 1);
+
+  const Real targetDensity = globalTargetDensity_();
+  // The boost factor of the columns that were never active
+  const Real inactiveExponent = targetDensity * boostStrength_;
+  Real inactiveBoost;
+  exp_(&inactiveExponent, 1, &inactiveBoost, exactExp_);
+
+  // Blocks small enough for the duty cycles, the boost factors and the
+  // exponents to stay in L1 between the two loops
+  const UInt blockSize = 256;
+  UInt newOverlap[blockSize], newActive[blockSize];
+  Real exponents[blockSize];
+  auto active = activeColumns.begin();
+
+  for (UInt begin = 0; begin < numColumns_; begin += blockSize) {
+    const UInt n = min(blockSize, numColumns_ - begin);
+    const UInt *overlap = overlaps.data() + begin;
+    Real *overlapDutyCycle = overlapDutyCycles_.data() + begin;
+    Real *activeDutyCycle = activeDutyCycles_.data() + begin;
+    Real *boostFactor = boostFactors_.data() + begin;
+
+    std::fill(newActive, newActive + n, 0);
+    for (; active != activeColumns.end() && *active < begin + n; ++active) {
+      NTA_ASSERT(*active >= begin);
+      newActive[*active - begin] = 1;
+    }
+
+    // Same expressions as in updateDutyCyclesHelper_
+    bool anyActive = false;
+    for (UInt i = 0; i < n; i++) {
+      newOverlap[i] = overlap[i] > 0 ? 1 : 0;
+      overlapDutyCycle[i] =
+          (overlapDutyCycle[i] * (period - 1) + newOverlap[i]) / period;
+      activeDutyCycle[i] =
+          (activeDutyCycle[i] * (period - 1) + newActive[i]) / period;
+      anyActive |= activeDutyCycle[i] != 0;
+    }
+
+    if (boostStrength_ == 0 || !anyActive) {
+      std::fill(boostFactor, boostFactor + n,
+                boostStrength_ == 0 ? (Real)1 : inactiveBoost);
+      continue;
+    }
+    for (UInt i = 0; i < n; i++) {
+      exponents[i] = (targetDensity - activeDutyCycle[i]) * boostStrength_;
+    }
+    exp_(exponents, n, boostFactor, exactExp_);
   }
 }
 
@@ -903,6 +1204,25 @@ void SpatialPooler::calculateOverlap_(UInt inputVector[],
                                      overlaps.begin(), overlaps.end());
 }
 
+void SpatialPooler::calculateOverlap_(const vector<UInt> &activeInputs,
+                                      vector<UInt> &overlaps) {
+  if (connectedColumns_.empty()) {
+    connectedColumns_.resize(numInputs_);
+    for (UInt column = 0; column < numColumns_; column++) {
+      for (UInt input : connectedSynapses_.getSparseRow(column)) {
+        connectedColumns_[input].push_back(column);
+      }
+    }
+  }
+
+  overlaps.assign(numColumns_, 0);
+  for (UInt input : activeInputs) {
+    for (UInt column : connectedColumns_[input]) {
+      overlaps[column]++;
+    }
+  }
+}
+
 void SpatialPooler::calculateOverlapPct_(vector<UInt> &overlaps,
                                          vector<Real> &overlapPct) {
   overlapPct.assign(numColumns_, 0);
@@ -989,6 +1309,13 @@ void SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
 void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
                                          Real density,
                                          vector<UInt> &activeColumns) {
+  (this->*localOps_->inhibitColumns)(overlaps, density, activeColumns);
+}
+
+template <UInt Dims, bool Wrap>
+void SpatialPooler::inhibitColumnsLocalImpl_(const vector<Real> &overlaps,
+                                             Real density,
+                                             vector<UInt> &activeColumns) {
   activeColumns.clear();
 
   // Tie-breaking: when overlaps are equal, columns that have already been
@@ -1000,33 +1327,18 @@ void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
       UInt numNeighbors = 0;
       UInt numBigger = 0;
 
-      if (wrapAround_) {
-        for (UInt neighbor : WrappingNeighborhood(column, inhibitionRadius_,
-                                                  columnDimensions_)) {
-          if (neighbor != column) {
-            numNeighbors++;
+      forEachNeighbor<Dims, Wrap>(
+          column, inhibitionRadius_, columnDimensions_, [&](UInt neighbor) {
+            if (neighbor != column) {
+              numNeighbors++;
 
-            const Real difference = overlaps[neighbor] - overlaps[column];
-            if (difference > 0 ||
-                (difference == 0 && activeColumnsDense[neighbor])) {
-              numBigger++;
-            }
-          }
-        }
-      } else {
-        for (UInt neighbor :
-             Neighborhood(column, inhibitionRadius_, columnDimensions_)) {
-          if (neighbor != column) {
-            numNeighbors++;
-
-            const Real difference = overlaps[neighbor] - overlaps[column];
-            if (difference > 0 ||
-                (difference == 0 && activeColumnsDense[neighbor])) {
-              numBigger++;
+              const Real difference = overlaps[neighbor] - overlaps[column];
+              if (difference > 0 ||
+                  (difference == 0 && activeColumnsDense[neighbor])) {
+                numBigger++;
+              }
             }
-          }
-        }
-      }
+          });
 
       UInt numActive = (UInt)(0.5 + (density * (numNeighbors + 1)));
       if (numBigger < numActive) {
@@ -1037,6 +1349,28 @@ void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
   }
 }
 
+template <UInt Dims, bool Wrap>
+SpatialPooler::LocalOps_ SpatialPooler::makeLocalOps_() {
+  LocalOps_ ops;
+  ops.inhibitColumns = &SpatialPooler::inhibitColumnsLocalImpl_<Dims, Wrap>;
+  ops.updateMinDutyCycles =
+      &SpatialPooler::updateMinDutyCyclesLocalImpl_<Dims, Wrap>;
+  ops.updateBoostFactors =
+      &SpatialPooler::updateBoostFactorsLocalImpl_<Dims, Wrap>;
+  return ops;
+}
+
+void SpatialPooler::selectLocalOps_() {
+  // Indexed by [number of dimensions if 1 or 2, else 0][wrapAround_]
+  static const LocalOps_ ops[3][2] = {
+      {makeLocalOps_<0, false>(), makeLocalOps_<0, true>()},
+      {makeLocalOps_<1, false>(), makeLocalOps_<1, true>()},
+      {makeLocalOps_<2, false>(), makeLocalOps_<2, true>()}};
+
+  const size_t dims = columnDimensions_.size();
+  localOps_ = &ops[dims <= 2 ? dims : 0][wrapAround_ ? 1 : 0];
+}
+
 bool SpatialPooler::isUpdateRound_() {
   return (iterationNum_ % updatePeriod_) == 0;
 }
@@ -1210,6 +1544,7 @@ void SpatialPooler::load(istream &inStream) {
   for (UInt i = 0; i < numColumnDimensions; i++) {
     inStream >> columnDimensions_[i];
   }
+  selectLocalOps_();
 
   boostFactors_.resize(numColumns_);
   for (UInt i = 0; i < numColumns_; i++) {
@@ -1250,6 +1585,7 @@ void SpatialPooler::load(istream &inStream) {
 
   permanences_.resize(numColumns_, numInputs_);
   connectedSynapses_.resize(numColumns_, numInputs_);
+  connectedColumns_.clear();
   connectedCounts_.resize(numColumns_);
   for (UInt i = 0; i < numColumns_; i++) {
     UInt nNonZerosOnRow;
@@ -1324,7 +1660,7 @@ void SpatialPooler::write(SpatialPoolerProto::Builder &proto) const {
   potentialPools.setNumColumns(numInputs_);
   auto potentialPoolIndices = potentialPools.initIndices(numColumns_);
   for (UInt i = 0; i < numColumns_; ++i) {
-    auto &pot = potentialPools_.getSparseRow(i);
+    auto pot = potentialPools_.getSparseRow(i);
     auto indices = potentialPoolIndices.init(i, pot.size());
     for (UInt j = 0; j < pot.size(); ++j) {
       indices.set(j, pot[j]);
@@ -1395,6 +1731,7 @@ void SpatialPooler::read(SpatialPoolerProto::Reader &proto) {
   dutyCyclePeriod_ = proto.getDutyCyclePeriod();
   boostStrength_ = proto.getBoostStrength();
   wrapAround_ = proto.getWrapAround();
+  selectLocalOps_();
   spVerbosity_ = proto.getSpVerbosity();
 
   synPermMin_ = proto.getSynPermMin();
@@ -1410,6 +1747,7 @@ void SpatialPooler::read(SpatialPoolerProto::Reader &proto) {
   potentialPools_.read(potentialPoolsProto);
 
   connectedSynapses_.resize(numColumns_, numInputs_);
+  connectedColumns_.clear();
   connectedCounts_.resize(numColumns_);
 
   // since updatePermanencesForColumn_, used below for initialization, is
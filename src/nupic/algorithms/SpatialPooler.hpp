@@ -246,6 +246,27 @@ public:
    */
   virtual void compute(UInt inputVector[], bool learn, UInt activeVector[]);
 
+  /**
+  Same as compute(inputVector, learn, activeVector), with the input and the
+  output in sparse form. The overlaps are accumulated from the active inputs
+  only, through an index from each input to the columns connected to it,
+  and learning only visits the synapses of the active and weak columns:
+  no step scans all the inputs. For equal inputs, the active columns and the
+  state of the SP are the same as with the dense compute, and both can be
+  mixed.
+
+  @param activeInputs The indices of the active inputs, in increasing
+        order, each less than getNumInputs().
+
+  @param learn Whether learning should be performed, as in the dense
+        compute.
+
+  @param activeColumns Filled with the indices of the winning columns after
+        inhibition, in increasing order.
+   */
+  virtual void compute(const vector<UInt> &activeInputs, bool learn,
+                       vector<UInt> &activeColumns);
+
   /**
    Removes the set of columns who have never been active from the set
    of active columns selected in the inhibition round. Such columns
@@ -258,6 +279,15 @@ public:
   */
   void stripUnlearnedColumns(UInt activeArray[]) const;
 
+  /**
+   Same as stripUnlearnedColumns(activeArray), for the sparse output of
+   compute(activeInputs, learn, activeColumns).
+
+   @param activeColumns  The indices of the winning columns, from which the
+         columns that were never active are removed.
+  */
+  void stripUnlearnedColumns(vector<UInt> &activeColumns) const;
+
   /**
    * Get the version number of this spatial pooler.
 
@@ -453,6 +483,26 @@ public:
   */
   void setBoostStrength(Real boostStrength);
 
+  /**
+  Returns whether the boost factors are computed exactly.
+
+  @returns boolean value of exactExp.
+  */
+  bool getExactExp() const;
+
+  /**
+  Sets whether the boost factors are computed with the exp of the C
+  library, one column at a time. By default, single precision builds
+  compute them with the vectorized fast_exp (see Math.hpp), which can
+  differ by 1 ulp and so break ties between boosted overlaps differently.
+  Exact boost factors match those of earlier releases and of the Python
+  spatial pooler. Double precision builds are always exact. This setting
+  is not serialized.
+
+  @param exactExp boolean value
+  */
+  void setExactExp(bool exactExp);
+
   /**
   Returns the iteration number.
 
@@ -781,6 +831,13 @@ public:
 
   void boostOverlaps_(vector<UInt> &overlaps, vector<Real> &boostedOverlaps);
 
+  /**
+     Computes overlapsPct_ and boostedOverlaps_ from overlaps in a single
+     pass over the columns: calculateOverlapPct_ followed by boostOverlaps_
+     when learning, or by a copy of the overlaps otherwise.
+  */
+  void scoreOverlaps_(const vector<UInt> &overlaps, bool learn);
+
   /**
     Maps a column to its respective input index, keeping to the topology of
     the region. It takes the index of the column as an argument and determines
@@ -931,6 +988,14 @@ public:
      input bits which are turned on.
   */
   void calculateOverlap_(UInt inputVector[], vector<UInt> &overlap);
+
+  /**
+     Same as calculateOverlap_(inputVector, overlap), for the sorted indices
+     of the active inputs. Builds the index of the columns connected to each
+     input on first use.
+  */
+  void calculateOverlap_(const vector<UInt> &activeInputs,
+                         vector<UInt> &overlap);
   void calculateOverlapPct_(vector<UInt> &overlaps, vector<Real> &overlapPct);
 
   bool isWinner_(Real score, vector<pair<UInt, Real>> &winners,
@@ -1027,6 +1092,14 @@ public:
             */
   void adaptSynapses_(UInt inputVector[], vector<UInt> &activeColumns);
 
+  /**
+      Same as adaptSynapses_(inputVector, activeColumns), for the sorted
+      indices of the active inputs. Only the potential synapses of the
+      active columns are visited.
+  */
+  void adaptSynapses_(const vector<UInt> &activeInputs,
+                      vector<UInt> &activeColumns);
+
   /**
       This method increases the permanence values of synapses of columns whose
       activity level has been too low. Such columns are identified by having an
@@ -1035,6 +1108,33 @@ public:
   */
   void bumpUpWeakColumns_();
 
+  /**
+      Same as bumpUpWeakColumns_(), only visiting the potential synapses of
+      the weak columns.
+  */
+  void bumpUpWeakColumnsSparse_();
+
+  /**
+      The permanences of the potential synapses of a column, in the order of
+      its row of the potential pools.
+  */
+  void getPotentialPermanences_(UInt column, vector<Real> &perm) const;
+
+  /**
+      Same as updatePermanencesForColumn_(perm, column, raisePerm), for the
+      permanences of the potential synapses of the column only, as returned
+      by getPotentialPermanences_.
+  */
+  void updatePotentialPermanences_(vector<Real> &perm, UInt column,
+                                   bool raisePerm);
+
+  /**
+      Keeps the index of the columns connected to each input in sync when the
+      connected synapses of a column change to connected, a sorted vector of
+      input indices. Does nothing until the index is built.
+  */
+  void updateConnectedColumns_(UInt column, const vector<UInt> &connected);
+
   /**
       Update the inhibition radius. The inhibition radius is a meausre of the
       square (or hypersquare) of columns that each a column is "connected to"
@@ -1155,6 +1255,27 @@ public:
   */
   void updateDutyCycles_(vector<UInt> &overlaps, UInt activeArray[]);
 
+  /**
+  Same as updateDutyCycles_(overlaps, activeArray), for the indices of the
+  active columns, in increasing order. The duty cycles are updated in
+  place.
+  */
+  void updateDutyCycles_(const vector<UInt> &overlaps,
+                         const vector<UInt> &activeColumns);
+
+  /**
+  Same as updateDutyCycles_ followed by updateBoostFactors_, with the same
+  results. With global inhibition both are done in one pass over blocks of
+  columns, the exponentials of each block vectorized. The boost factor of
+  the columns that were never active, whose exponent does not change, is
+  computed once, and no exponential is computed when boosting is off.
+
+  @param activeColumns  The indices of the active columns, in increasing
+                  order.
+  */
+  void updateDutyCyclesAndBoostFactors_(const vector<UInt> &overlaps,
+                                        const vector<UInt> &activeColumns);
+
   /**
     Update the boost factors for all columns. The boost factors are used to
     increase the overlap of inactive columns to improve their chances of
@@ -1200,6 +1321,11 @@ public:
   */
   void updateBoostFactorsGlobal_();
 
+  /**
+  The target activation level of all the columns with global inhibition.
+  */
+  Real globalTargetDensity_() const;
+
   /**
   Updates counter instance variables each round.
 
@@ -1238,6 +1364,29 @@ public:
   void printState(vector<Real> &state);
 
 protected:
+  // The loops over column neighborhoods of local inhibition, compiled for
+  // each number of column dimensions (1, 2, or 0 for any) and for
+  // wrap-around or not. selectLocalOps_() picks the version matching
+  // columnDimensions_ and wrapAround_ whenever either changes.
+  struct LocalOps_ {
+    void (SpatialPooler::*inhibitColumns)(const vector<Real> &, Real,
+                                          vector<UInt> &);
+    void (SpatialPooler::*updateMinDutyCycles)();
+    void (SpatialPooler::*updateBoostFactors)();
+  };
+
+  template <UInt Dims, bool Wrap> static LocalOps_ makeLocalOps_();
+
+  void selectLocalOps_();
+
+  template <UInt Dims, bool Wrap>
+  void inhibitColumnsLocalImpl_(const vector<Real> &overlaps, Real density,
+                                vector<UInt> &activeColumns);
+
+  template <UInt Dims, bool Wrap> void updateMinDutyCyclesLocalImpl_();
+
+  template <UInt Dims, bool Wrap> void updateBoostFactorsLocalImpl_();
+
   UInt numInputs_;
   UInt numColumns_;
   vector<UInt> columnDimensions_;
@@ -1252,10 +1401,12 @@ protected:
   UInt inhibitionRadius_;
   UInt dutyCyclePeriod_;
   Real boostStrength_;
+  bool exactExp_;
   UInt iterationNum_;
   UInt iterationLearnNum_;
   UInt spVerbosity_;
   bool wrapAround_;
+  const LocalOps_ *localOps_;
   UInt updatePeriod_;
 
   Real synPermMin_;
@@ -1278,6 +1429,9 @@ protected:
   SparseBinaryMatrix<UInt, UInt> potentialPools_;
   SparseBinaryMatrix<UInt, UInt> connectedSynapses_;
   vector<UInt> connectedCounts_;
+  // For each input, the columns connected to it, in no particular order.
+  // Built by the first sparse compute, empty until then.
+  vector<vector<UInt>> connectedColumns_;
 
   vector<UInt> overlaps_;
   vector<Real> overlapsPct_;
@@ -78,6 +78,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <nupic/proto/SvmProto.capnp.h>
 #include <nupic/types/Serializable.hpp>
 #include <nupic/utils/Random.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace nupic {
 namespace algorithms {
@@ -885,6 +886,24 @@ public:
   template <typename InIter, typename OutIter>
   float predict_probability(const svm_model &, InIter, OutIter);
 
+  // Batch inference on n vectors stored row-major in x (n * n_dims floats).
+  // The kernel values between the inputs and the support vectors are
+  // computed block by block, so that a block of support vectors stays in
+  // cache while it is applied to a block of inputs, and the blocks of
+  // inputs are spread over the shared thread pool. Results are identical
+  // to calling predict/predict_probability on each vector.
+  //
+  // labels receives the n predicted labels.
+  // dec_values, if not null, receives n rows of n_class*(n_class-1)/2
+  // pairwise decision values.
+  // proba, if not null and the model was trained with probability
+  // estimates, receives n rows of n_class probabilities, and labels are
+  // then the most probable classes, like predict_probability.
+  // n_threads limits the number of threads used, 0 means all available.
+  void predict_batch(const svm_model &, int n, const float *x, float *labels,
+                     float *dec_values = nullptr, float *proba = nullptr,
+                     int n_threads = 0) const;
+
   float cross_validation(int);
 
   int persistent_size() const;
@@ -895,13 +914,17 @@ private:
   void group_classes(const problem_type &, std::vector<int> &,
                      std::vector<int> &, std::vector<int> &,
                      std::vector<int> &);
-  void multiclass_probability(Matrix &, Vector &);
+  void multiclass_probability(Matrix &, Vector &) const;
   void binary_probability(const problem_type &, float &, float &);
   void sigmoid_train(int, const Vector &, const Vector &, float &, float &);
-  float sigmoid_predict(float, float, float);
+  float sigmoid_predict(float, float, float) const;
   float rbf_function(float *, float *, float *) const;
   float linear_function(float *, float *, float *) const;
   void predict_values(const svm_model &, float *, float *);
+  void kernel_values(const svm_model &, int, float *, float *) const;
+  void decision_values(const svm_model &, const float *, float *) const;
+  int vote(const svm_model &, const float *) const;
+  int probability_estimates(const svm_model &, const float *, float *) const;
 
   float *x_tmp_, *dec_values_;
   bool with_sse;
@@ -941,7 +964,10 @@ public:
   }
 
   inline svm_problem &get_problem() { return *svm_.problem_; }
-  inline svm_model &get_model() { return *svm_.model_; }
+  inline svm_model &get_model() {
+    NTA_CHECK(svm_.model_ != nullptr) << "The svm has not been trained";
+    return *svm_.model_;
+  }
   inline svm_parameter &get_parameter() { return svm_.param_; }
   inline void discard_problem() { svm_.discard_problem(); }
 
@@ -954,6 +980,13 @@ public:
     return svm_.predict_probability(*svm_.model_, x, proba);
   }
 
+  inline void predict_batch(int n, const float *x, float *labels,
+                            float *dec_values = nullptr,
+                            float *proba = nullptr, int n_threads = 0) const {
+    svm_.predict_batch(*svm_.model_, n, x, labels, dec_values, proba,
+                       n_threads);
+  }
+
   inline float cross_validation(int n_fold, float gamma, float C, float eps) {
     svm_.param_.gamma = gamma;
     svm_.param_.C = C;
@@ -1004,7 +1037,10 @@ public:
   }
 
   inline svm_problem01 &get_problem() { return *svm_.problem_; }
-  inline svm_model &get_model() { return *svm_.model_; }
+  inline svm_model &get_model() {
+    NTA_CHECK(svm_.model_ != nullptr) << "The svm has not been trained";
+    return *svm_.model_;
+  }
   inline svm_parameter &get_parameter() { return svm_.param_; }
   inline void discard_problem() { svm_.discard_problem(); }
 
@@ -1017,6 +1053,13 @@ public:
     return svm_.predict_probability(*svm_.model_, x, proba);
   }
 
+  inline void predict_batch(int n, const float *x, float *labels,
+                            float *dec_values = nullptr,
+                            float *proba = nullptr, int n_threads = 0) const {
+    svm_.predict_batch(*svm_.model_, n, x, labels, dec_values, proba,
+                       n_threads);
+  }
+
   inline float cross_validation(int n_fold, float gamma, float C, float eps) {
     svm_.param_.gamma = gamma;
     svm_.param_.C = C;
@@ -630,7 +630,7 @@ void svm<traits>::sigmoid_train(int l, const Vector &dec_values,
 //--------------------------------------------------------------------------------
 template <typename traits>
 inline float svm<traits>::sigmoid_predict(float decision_value, float A,
-                                          float B) {
+                                          float B) const {
   float fApB = decision_value * A + B;
   if (fApB >= 0)
     return exp(-fApB) / (1.0f + exp(-fApB));
@@ -762,7 +762,7 @@ inline float svm<traits>::linear_function(float *x, float *x_end,
 //--------------------------------------------------------------------------------
 template <typename traits>
 inline void svm<traits>::multiclass_probability(Matrix &pairwise_proba,
-                                                Vector &prob_estimates) {
+                                                Vector &prob_estimates) const {
   int n_class = pairwise_proba.nrows(), max_iter = std::max(100, n_class);
 
   Matrix Q(n_class, n_class);
@@ -1148,23 +1148,38 @@ svm_model *svm<traits>::train(const problem_type &prob,
 }
 
 //--------------------------------------------------------------------------------
+// Computes the kernel values between n inputs (row-major in x) and all the
+// support vectors, into kvalues (n rows of model.size() values).
+// The loop is blocked on the support vectors, so that each block of
+// support vectors is reused for all the inputs while it is in cache.
 template <typename traits>
-void svm<traits>::predict_values(const svm_model &model, float *x,
-                                 float *dec_values) {
-  int n_class = model.n_class(), l = model.size();
-
-  Vector kvalue(l);
-
-  if (param_.kernel == 0) {
-
-    for (int i = 0; i < l; i++)
-      kvalue[i] = linear_function(x, x + model.n_dims(), model.sv[i]);
-
-  } else if (param_.kernel == 1) {
-
-    for (int i = 0; i < l; i++)
-      kvalue[i] = rbf_function(x, x + model.n_dims(), model.sv[i]);
+void svm<traits>::kernel_values(const svm_model &model, int n, float *x,
+                                float *kvalues) const {
+  const int sv_block = 64;
+  int l = model.size(), n_dims = model.n_dims();
+
+  for (int j0 = 0; j0 < l; j0 += sv_block) {
+    int j1 = std::min(l, j0 + sv_block);
+
+    for (int r = 0; r < n; ++r) {
+      float *xr = x + r * n_dims, *kr = kvalues + r * l;
+
+      if (param_.kernel == 0) {
+        for (int j = j0; j < j1; ++j)
+          kr[j] = linear_function(xr, xr + n_dims, model.sv[j]);
+      } else if (param_.kernel == 1) {
+        for (int j = j0; j < j1; ++j)
+          kr[j] = rbf_function(xr, xr + n_dims, model.sv[j]);
+      }
+    }
   }
+}
+
+//--------------------------------------------------------------------------------
+template <typename traits>
+void svm<traits>::decision_values(const svm_model &model, const float *kvalue,
+                                  float *dec_values) const {
+  int n_class = model.n_class();
 
   std::vector<int> start(n_class);
   start[0] = 0;
@@ -1193,6 +1208,72 @@ void svm<traits>::predict_values(const svm_model &model, float *x,
     }
 }
 
+//--------------------------------------------------------------------------------
+template <typename traits>
+void svm<traits>::predict_values(const svm_model &model, float *x,
+                                 float *dec_values) {
+  Vector kvalue(model.size());
+  kernel_values(model, 1, x, &kvalue[0]);
+  decision_values(model, &kvalue[0], dec_values);
+}
+
+//--------------------------------------------------------------------------------
+// Returns the index of the class that wins the most pairwise votes.
+template <typename traits>
+int svm<traits>::vote(const svm_model &model, const float *dec_values) const {
+  int n_class = model.n_class();
+  std::vector<int> vote(n_class, 0);
+
+  int pos = 0;
+  for (int i = 0; i < n_class; i++)
+    for (int j = i + 1; j < n_class; j++) {
+      if (dec_values[pos++] > 0)
+        ++vote[i];
+      else
+        ++vote[j];
+    }
+
+  int vote_max_idx = 0;
+  for (int i = 1; i < n_class; i++)
+    if (vote[i] > vote[vote_max_idx])
+      vote_max_idx = i;
+
+  return vote_max_idx;
+}
+
+//--------------------------------------------------------------------------------
+// Writes the n_class probabilities to proba, and returns the index of the
+// most probable class.
+template <typename traits>
+int svm<traits>::probability_estimates(const svm_model &model,
+                                       const float *dec_values,
+                                       float *proba) const {
+  int n_class = model.n_class();
+  float min_prob = float(1e-7);
+  Matrix pairwise_proba(n_class, n_class);
+
+  int k = 0;
+  for (int i = 0; i < n_class; ++i) {
+    pairwise_proba(i, i) = 0;
+    for (int j = i + 1; j < n_class; ++j, ++k) {
+      float v = sigmoid_predict(dec_values[k], model.probA[k], model.probB[k]);
+      pairwise_proba(i, j) = std::min(std::max(v, min_prob), 1 - min_prob);
+      pairwise_proba(j, i) = 1 - pairwise_proba(i, j);
+    }
+  }
+
+  Vector proba_estimates(n_class);
+  multiclass_probability(pairwise_proba, proba_estimates);
+  std::copy(proba_estimates.begin(), proba_estimates.end(), proba);
+
+  int prob_max_idx = 0;
+  for (int i = 0; i < n_class; ++i)
+    if (proba_estimates[i] > proba_estimates[prob_max_idx])
+      prob_max_idx = i;
+
+  return prob_max_idx;
+}
+
 //--------------------------------------------------------------------------------
 template <typename traits>
 template <typename InIter>
@@ -1214,23 +1295,7 @@ float svm<traits>::predict(const svm_model &model, InIter x) {
 
   predict_values(model, x_tmp_, dec_values_);
 
-  std::vector<int> vote(n_class, 0);
-
-  int pos = 0;
-  for (int i = 0; i < n_class; i++)
-    for (int j = i + 1; j < n_class; j++) {
-      if (dec_values_[pos++] > 0)
-        ++vote[i];
-      else
-        ++vote[j];
-    }
-
-  int vote_max_idx = 0;
-  for (int i = 1; i < n_class; i++)
-    if (vote[i] > vote[vote_max_idx])
-      vote_max_idx = i;
-
-  return (float)model.label[vote_max_idx];
+  return (float)model.label[vote(model, dec_values_)];
 }
 
 //--------------------------------------------------------------------------------
@@ -1258,29 +1323,11 @@ float svm<traits>::predict_probability(const svm_model &model, InIter x,
 
     predict_values(model, x_tmp_, dec_values_);
 
-    float min_prob = float(1e-7);
-    Matrix pairwise_proba(n_class, n_class);
-
-    int k = 0;
-    for (int i = 0; i < n_class; ++i) {
-      pairwise_proba(i, i) = 0;
-      for (int j = i + 1; j < n_class; ++j, ++k) {
-        float v =
-            sigmoid_predict(dec_values_[k], model.probA[k], model.probB[k]);
-        pairwise_proba(i, j) = std::min(std::max(v, min_prob), 1 - min_prob);
-        pairwise_proba(j, i) = 1 - pairwise_proba(i, j);
-      }
-    }
-
     Vector proba_estimates(n_class);
-    multiclass_probability(pairwise_proba, proba_estimates);
+    int prob_max_idx =
+        probability_estimates(model, dec_values_, &proba_estimates[0]);
     std::copy(proba_estimates.begin(), proba_estimates.end(), proba);
 
-    int prob_max_idx = 0;
-    for (int i = 0; i < n_class; ++i)
-      if (proba_estimates[i] > proba_estimates[prob_max_idx])
-        prob_max_idx = i;
-
     return (float)model.label[prob_max_idx];
 
   } else {
@@ -1288,6 +1335,50 @@ float svm<traits>::predict_probability(const svm_model &model, InIter x,
   }
 }
 
+//--------------------------------------------------------------------------------
+template <typename traits>
+void svm<traits>::predict_batch(const svm_model &model, int n, const float *x,
+                                float *labels, float *dec_values, float *proba,
+                                int n_threads) const {
+  NTA_ASSERT(0 <= n);
+  NTA_ASSERT(0 <= n_threads);
+
+  // Number of inputs whose kernel values are computed together.
+  const int row_block = 32;
+
+  int n_class = model.n_class(), n_dims = model.n_dims(), l = model.size();
+  int n_dec = n_class * (n_class - 1) / 2;
+  bool with_proba = proba != nullptr && param_.probability;
+
+  nupic::util::ThreadPool::shared().parallelFor(
+      0, (UInt)n,
+      [&](UInt begin, UInt end) {
+        // Inputs are copied so that they are aligned as in predict.
+        Vector x_block(row_block * std::max(n_dims, 1)),
+            k_block(row_block * std::max(l, 1)), dec(std::max(n_dec, 1));
+
+        for (UInt r0 = begin; r0 < end; r0 += row_block) {
+          int rows = (int)std::min<UInt>(row_block, end - r0);
+
+          std::copy(x + r0 * n_dims, x + (r0 + rows) * n_dims,
+                    x_block.begin());
+          kernel_values(model, rows, &x_block[0], &k_block[0]);
+
+          for (int r = 0; r < rows; ++r) {
+            UInt i = r0 + r;
+            float *dec_i = dec_values ? dec_values + i * n_dec : &dec[0];
+            decision_values(model, &k_block[r * l], dec_i);
+
+            int winner = with_proba ? probability_estimates(model, dec_i,
+                                                            proba + i * n_class)
+                                    : vote(model, dec_i);
+            labels[i] = (float)model.label[winner];
+          }
+        }
+      },
+      row_block, (UInt)n_threads);
+}
+
 //--------------------------------------------------------------------------------
 template <typename traits> float svm<traits>::cross_validation(int nr_fold) {
   int l = problem_->size();
@@ -33,12 +33,15 @@
  * 4. Model parameters (including "learn")
  */
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <capnp/message.h>
@@ -48,6 +51,7 @@
 #include <nupic/algorithms/Connections.hpp>
 #include <nupic/algorithms/TemporalMemory.hpp>
 #include <nupic/utils/GroupBy.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 using namespace std;
 using namespace nupic;
@@ -74,7 +78,14 @@ bool isSortedWithoutDuplicates(Iterator begin, Iterator end) {
   return true;
 }
 
-TemporalMemory::TemporalMemory() {}
+// The Connections limit for a TM parameter. Connections index segments and
+// synapses with 16 bits.
+template <typename Idx> static Idx connectionsLimit(UInt max) {
+  return (Idx)std::min<UInt>(max, std::numeric_limits<Idx>::max());
+}
+
+TemporalMemory::TemporalMemory()
+    : parallel_(false), nThreads_(0), pool_(nullptr), parallelRanges_(0) {}
 
 TemporalMemory::TemporalMemory(
     vector<UInt> columnDimensions, UInt cellsPerColumn,
@@ -82,7 +93,8 @@ TemporalMemory::TemporalMemory(
     Permanence connectedPermanence, UInt minThreshold, UInt maxNewSynapseCount,
     Permanence permanenceIncrement, Permanence permanenceDecrement,
     Permanence predictedSegmentDecrement, Int seed, UInt maxSegmentsPerCell,
-    UInt maxSynapsesPerSegment, bool checkInputs) {
+    UInt maxSynapsesPerSegment, bool checkInputs)
+    : parallel_(false), nThreads_(0), pool_(nullptr), parallelRanges_(0) {
   initialize(columnDimensions, cellsPerColumn, activationThreshold,
              initialPermanence, connectedPermanence, minThreshold,
              maxNewSynapseCount, permanenceIncrement, permanenceDecrement,
@@ -136,7 +148,10 @@ void TemporalMemory::initialize(
   predictedSegmentDecrement_ = predictedSegmentDecrement;
 
   // Initialize member variables
-  connections = Connections(numberOfColumns() * cellsPerColumn_);
+  connections =
+      Connections(numberOfColumns() * cellsPerColumn_,
+                  connectionsLimit<SegmentIdx>(maxSegmentsPerCell),
+                  connectionsLimit<SynapseIdx>(maxSynapsesPerSegment));
   seed_((UInt64)(seed < 0 ? rand() : seed));
 
   maxSegmentsPerCell_ = maxSegmentsPerCell;
@@ -149,8 +164,234 @@ void TemporalMemory::initialize(
   matchingSegments_.clear();
 }
 
+namespace {
+
+/**
+ * The connections as seen by a range of columns learning in parallel.
+ *
+ * Reads see the connections as they were before activateCells, with the
+ * changes made through this object applied. The changes are logged, and
+ * replay() makes them on the connections. Segments and synapses created
+ * here get placeholder indices past the end of the flat lists, which
+ * replay() maps to the real ones. A column only changes the segments of
+ * its own cells, so replaying the logs of the ranges in the order of the
+ * columns gives the same connections as processing them one by one.
+ */
+class StagedConnections {
+public:
+  StagedConnections(const Connections &connections,
+                    const vector<UInt64> &lastUsedIterationForSegment,
+                    UInt64 iteration)
+      : connections_(connections),
+        lastUsedIterationForSegment_(lastUsedIterationForSegment),
+        iteration_(iteration),
+        segmentBase_(connections.segmentFlatListLength()),
+        synapseBase_(connections.synapseFlatListLength()),
+        numCreatedSynapses_(0) {}
+
+  CellIdx numCells() const { return connections_.numCells(); }
+
+  CellIdx cellForSegment(Segment segment) const {
+    return segment < segmentBase_
+               ? connections_.cellForSegment(segment)
+               : createdSegmentCells_[segment - segmentBase_];
+  }
+
+  const vector<Segment> &segmentsForCell(CellIdx cell) const {
+    auto it = segmentsForCell_.find(cell);
+    if (it == segmentsForCell_.end()) {
+      it = segmentsForCell_
+               .emplace(cell, connections_.segmentsForCell(cell))
+               .first;
+    }
+    return it->second;
+  }
+
+  UInt numSegments(CellIdx cell) const {
+    const auto it = segmentsForCell_.find(cell);
+    return it != segmentsForCell_.end() ? it->second.size()
+                                        : connections_.numSegments(cell);
+  }
+
+  const vector<Synapse> &synapsesForSegment(Segment segment) const {
+    auto it = synapsesForSegment_.find(segment);
+    if (it == synapsesForSegment_.end()) {
+      it = synapsesForSegment_
+               .emplace(segment, connections_.synapsesForSegment(segment))
+               .first;
+    }
+    return it->second;
+  }
+
+  UInt numSynapses(Segment segment) const {
+    const auto it = synapsesForSegment_.find(segment);
+    return it != synapsesForSegment_.end()
+               ? it->second.size()
+               : connections_.numSynapses(segment);
+  }
+
+  const SynapseData &dataForSynapse(Synapse synapse) const {
+    const auto it = synapseData_.find(synapse.flatIdx);
+    return it != synapseData_.end() ? it->second
+                                    : connections_.dataForSynapse(synapse);
+  }
+
+  UInt64 lastUsedIterationForSegment(Segment segment) const {
+    return segment < segmentBase_ ? lastUsedIterationForSegment_[segment]
+                                  : iteration_;
+  }
+
+  Segment createSegment(CellIdx cell) {
+    vector<Segment> &segments = mutableSegmentsForCell_(cell);
+    NTA_CHECK(segments.size() < connections_.maxSegmentsPerCell())
+        << "Cell " << cell << " already has "
+        << connections_.maxSegmentsPerCell() << " segments";
+
+    const Segment segment = segmentBase_ + createdSegmentCells_.size();
+    createdSegmentCells_.push_back(cell);
+    segments.push_back(segment);
+    synapsesForSegment_[segment];
+    log_.push_back({CREATE_SEGMENT, cell, 0, 0});
+    return segment;
+  }
+
+  void destroySegment(Segment segment) {
+    vector<Segment> &segments =
+        mutableSegmentsForCell_(cellForSegment(segment));
+    segments.erase(std::find(segments.begin(), segments.end(), segment));
+    synapsesForSegment_[segment].clear();
+    log_.push_back({DESTROY_SEGMENT, segment, 0, 0});
+  }
+
+  Synapse createSynapse(Segment segment, CellIdx presynapticCell,
+                        Permanence permanence) {
+    NTA_CHECK(permanence > 0);
+    vector<Synapse> &synapses = mutableSynapsesForSegment_(segment);
+    NTA_CHECK(synapses.size() < connections_.maxSynapsesPerSegment())
+        << "Segment " << segment << " already has "
+        << connections_.maxSynapsesPerSegment() << " synapses";
+
+    const Synapse synapse = {synapseBase_ + numCreatedSynapses_++};
+    synapseData_[synapse.flatIdx] = {presynapticCell, permanence, segment};
+    synapses.push_back(synapse);
+    log_.push_back({CREATE_SYNAPSE, segment, presynapticCell, permanence});
+    return synapse;
+  }
+
+  void destroySynapse(Synapse synapse) {
+    vector<Synapse> &synapses =
+        mutableSynapsesForSegment_(dataForSynapse(synapse).segment);
+    synapses.erase(std::find(synapses.begin(), synapses.end(), synapse));
+    log_.push_back({DESTROY_SYNAPSE, synapse.flatIdx, 0, 0});
+  }
+
+  void updateSynapsePermanence(Synapse synapse, Permanence permanence) {
+    auto it = synapseData_.find(synapse.flatIdx);
+    if (it == synapseData_.end()) {
+      it = synapseData_
+               .emplace(synapse.flatIdx, connections_.dataForSynapse(synapse))
+               .first;
+    }
+    it->second.permanence = permanence;
+    log_.push_back({UPDATE_PERMANENCE, synapse.flatIdx, 0, permanence});
+  }
+
+  /**
+   * Makes the logged changes on the connections, which must be unchanged
+   * since this object was created but for the replay of the logs of the
+   * columns before.
+   */
+  void replay(Connections &connections,
+              vector<UInt64> &lastUsedIterationForSegment) const {
+    vector<Segment> createdSegments;
+    vector<Synapse> createdSynapses;
+    const auto segment = [&](UInt32 idx) {
+      return idx < segmentBase_ ? idx : createdSegments[idx - segmentBase_];
+    };
+    const auto synapse = [&](UInt32 idx) {
+      const Synapse staged = {idx};
+      return idx < synapseBase_ ? staged : createdSynapses[idx - synapseBase_];
+    };
+
+    for (const Change &change : log_) {
+      switch (change.type) {
+      case CREATE_SEGMENT: {
+        const Segment created = connections.createSegment(change.idx);
+        lastUsedIterationForSegment.resize(
+            connections.segmentFlatListLength());
+        lastUsedIterationForSegment[created] = iteration_;
+        createdSegments.push_back(created);
+        break;
+      }
+      case DESTROY_SEGMENT:
+        connections.destroySegment(segment(change.idx));
+        break;
+      case CREATE_SYNAPSE:
+        createdSynapses.push_back(connections.createSynapse(
+            segment(change.idx), change.presynapticCell, change.permanence));
+        break;
+      case DESTROY_SYNAPSE:
+        connections.destroySynapse(synapse(change.idx));
+        break;
+      case UPDATE_PERMANENCE:
+        connections.updateSynapsePermanence(synapse(change.idx),
+                                            change.permanence);
+        break;
+      }
+    }
+  }
+
+private:
+  enum ChangeType {
+    CREATE_SEGMENT,
+    DESTROY_SEGMENT,
+    CREATE_SYNAPSE,
+    DESTROY_SYNAPSE,
+    UPDATE_PERMANENCE
+  };
+
+  // A logged change. idx is the cell of a created segment, and the
+  // segment or synapse of the others.
+  struct Change {
+    ChangeType type;
+    UInt32 idx;
+    CellIdx presynapticCell;
+    Permanence permanence;
+  };
+
+  vector<Segment> &mutableSegmentsForCell_(CellIdx cell) {
+    segmentsForCell(cell);
+    return segmentsForCell_[cell];
+  }
+
+  vector<Synapse> &mutableSynapsesForSegment_(Segment segment) {
+    synapsesForSegment(segment);
+    return synapsesForSegment_[segment];
+  }
+
+  const Connections &connections_;
+  const vector<UInt64> &lastUsedIterationForSegment_;
+  const UInt64 iteration_;
+  const Segment segmentBase_;
+  const UInt32 synapseBase_;
+
+  // The cells of the created segments
+  vector<CellIdx> createdSegmentCells_;
+  UInt32 numCreatedSynapses_;
+
+  // Copies of the lists and synapses that were read or changed
+  mutable unordered_map<CellIdx, vector<Segment>> segmentsForCell_;
+  mutable unordered_map<Segment, vector<Synapse>> synapsesForSegment_;
+  unordered_map<UInt32, SynapseData> synapseData_;
+
+  vector<Change> log_;
+};
+
+} // namespace
+
+template <typename ConnectionsT>
 static CellIdx getLeastUsedCell(Random &rng, UInt column,
-                                const Connections &connections,
+                                const ConnectionsT &connections,
                                 UInt cellsPerColumn) {
   const CellIdx start = column * cellsPerColumn;
   const CellIdx end = start + cellsPerColumn;
@@ -183,11 +424,12 @@ static CellIdx getLeastUsedCell(Random &rng, UInt column,
   NTA_THROW << "getLeastUsedCell failed to find a cell";
 }
 
-static void adaptSegment(Connections &connections, Segment segment,
+template <typename ConnectionsT>
+static void adaptSegment(ConnectionsT &connections, Segment segment,
                          const vector<bool> &prevActiveCellsDense,
                          Permanence permanenceIncrement,
                          Permanence permanenceDecrement) {
-  const vector<Synapse> &synapses = connections.synapsesForSegment(segment);
+  const auto &synapses = connections.synapsesForSegment(segment);
 
   for (SynapseIdx i = 0; i < synapses.size();) {
     const SynapseData &synapseData = connections.dataForSynapse(synapses[i]);
@@ -218,8 +460,10 @@ static void adaptSegment(Connections &connections, Segment segment,
   }
 }
 
-static void destroyMinPermanenceSynapses(Connections &connections, Random &rng,
-                                         Segment segment, Int nDestroy,
+template <typename ConnectionsT>
+static void destroyMinPermanenceSynapses(ConnectionsT &connections,
+                                         Random &rng, Segment segment,
+                                         Int nDestroy,
                                          const vector<CellIdx> &excludeCells) {
   // Don't destroy any cells that are in excludeCells.
   vector<Synapse> destroyCandidates;
@@ -257,8 +501,9 @@ static void destroyMinPermanenceSynapses(Connections &connections, Random &rng,
   }
 }
 
-static void growSynapses(Connections &connections, Random &rng, Segment segment,
-                         UInt32 nDesiredNewSynapses,
+template <typename ConnectionsT>
+static void growSynapses(ConnectionsT &connections, Random &rng,
+                         Segment segment, UInt32 nDesiredNewSynapses,
                          const vector<CellIdx> &prevWinnerCells,
                          Permanence initialPermanence,
                          UInt maxSynapsesPerSegment) {
@@ -304,9 +549,10 @@ static void growSynapses(Connections &connections, Random &rng, Segment segment,
   }
 }
 
+template <typename ConnectionsT>
 static void activatePredictedColumn(
     vector<CellIdx> &activeCells, vector<CellIdx> &winnerCells,
-    Connections &connections, Random &rng,
+    ConnectionsT &connections, Random &rng,
     vector<Segment>::const_iterator columnActiveSegmentsBegin,
     vector<Segment>::const_iterator columnActiveSegmentsEnd,
     const vector<bool> &prevActiveCellsDense,
@@ -346,8 +592,7 @@ static Segment createSegment(Connections &connections,
                              CellIdx cell, UInt64 iteration,
                              UInt maxSegmentsPerCell) {
   while (connections.numSegments(cell) >= maxSegmentsPerCell) {
-    const vector<Segment> &destroyCandidates =
-        connections.segmentsForCell(cell);
+    const SegmentList destroyCandidates = connections.segmentsForCell(cell);
 
     auto leastRecentlyUsedSegment =
         std::min_element(destroyCandidates.begin(), destroyCandidates.end(),
@@ -366,9 +611,33 @@ static Segment createSegment(Connections &connections,
   return segment;
 }
 
+// The staged version, which reads the iterations of the segments from the
+// staged connections and leaves their update to the replay.
+static Segment
+createSegment(StagedConnections &connections,
+              const vector<UInt64> & /*lastUsedIterationForSegment*/,
+              CellIdx cell, UInt64 /*iteration*/, UInt maxSegmentsPerCell) {
+  while (connections.numSegments(cell) >= maxSegmentsPerCell) {
+    const vector<Segment> &destroyCandidates =
+        connections.segmentsForCell(cell);
+
+    auto leastRecentlyUsedSegment =
+        std::min_element(destroyCandidates.begin(), destroyCandidates.end(),
+                         [&](Segment a, Segment b) {
+                           return (connections.lastUsedIterationForSegment(a) <
+                                   connections.lastUsedIterationForSegment(b));
+                         });
+
+    connections.destroySegment(*leastRecentlyUsedSegment);
+  }
+
+  return connections.createSegment(cell);
+}
+
+template <typename ConnectionsT>
 static void
 burstColumn(vector<CellIdx> &activeCells, vector<CellIdx> &winnerCells,
-            Connections &connections, Random &rng,
+            ConnectionsT &connections, Random &rng,
             vector<UInt64> &lastUsedIterationForSegment, UInt column,
             vector<Segment>::const_iterator columnMatchingSegmentsBegin,
             vector<Segment>::const_iterator columnMatchingSegmentsEnd,
@@ -434,8 +703,9 @@ burstColumn(vector<CellIdx> &activeCells, vector<CellIdx> &winnerCells,
   }
 }
 
+template <typename ConnectionsT>
 static void punishPredictedColumn(
-    Connections &connections,
+    ConnectionsT &connections,
     vector<Segment>::const_iterator columnMatchingSegmentsBegin,
     vector<Segment>::const_iterator columnMatchingSegmentsEnd,
     const vector<bool> &prevActiveCellsDense,
@@ -449,6 +719,62 @@ static void punishPredictedColumn(
   }
 }
 
+template <typename ConnectionsT>
+static void activateColumn(
+    vector<CellIdx> &activeCells, vector<CellIdx> &winnerCells,
+    ConnectionsT &connections, Random &rng,
+    vector<UInt64> &lastUsedIterationForSegment, UInt column,
+    bool isActiveColumn,
+    vector<Segment>::const_iterator columnActiveSegmentsBegin,
+    vector<Segment>::const_iterator columnActiveSegmentsEnd,
+    vector<Segment>::const_iterator columnMatchingSegmentsBegin,
+    vector<Segment>::const_iterator columnMatchingSegmentsEnd,
+    const vector<bool> &prevActiveCellsDense,
+    const vector<CellIdx> &prevWinnerCells,
+    const vector<UInt32> &numActivePotentialSynapsesForSegment,
+    UInt64 iteration, UInt cellsPerColumn, UInt maxNewSynapseCount,
+    Permanence initialPermanence, Permanence permanenceIncrement,
+    Permanence permanenceDecrement, Permanence predictedSegmentDecrement,
+    UInt maxSegmentsPerCell, UInt maxSynapsesPerSegment, bool learn) {
+  if (isActiveColumn) {
+    if (columnActiveSegmentsBegin != columnActiveSegmentsEnd) {
+      activatePredictedColumn(
+          activeCells, winnerCells, connections, rng,
+          columnActiveSegmentsBegin, columnActiveSegmentsEnd,
+          prevActiveCellsDense, prevWinnerCells,
+          numActivePotentialSynapsesForSegment, maxNewSynapseCount,
+          initialPermanence, permanenceIncrement, permanenceDecrement,
+          maxSynapsesPerSegment, learn);
+    } else {
+      burstColumn(activeCells, winnerCells, connections, rng,
+                  lastUsedIterationForSegment, column,
+                  columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
+                  prevActiveCellsDense, prevWinnerCells,
+                  numActivePotentialSynapsesForSegment, iteration,
+                  cellsPerColumn, maxNewSynapseCount, initialPermanence,
+                  permanenceIncrement, permanenceDecrement,
+                  maxSegmentsPerCell, maxSynapsesPerSegment, learn);
+    }
+  } else {
+    if (learn) {
+      punishPredictedColumn(connections, columnMatchingSegmentsBegin,
+                            columnMatchingSegmentsEnd, prevActiveCellsDense,
+                            predictedSegmentDecrement);
+    }
+  }
+}
+
+// The seed of the random number generator of a column in parallel mode,
+// the SplitMix64 hash of the seed of the step and the column. It's never
+// 0, which would seed the generator from the clock.
+static UInt64 columnSeed(UInt64 seed, UInt column) {
+  UInt64 z = seed + ((UInt64)column + 1) * 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  return z ? z : 1;
+}
+
 void TemporalMemory::activateCells(size_t activeColumnsSize,
                                    const UInt activeColumns[], bool learn) {
   if (checkInputs_) {
@@ -470,6 +796,14 @@ void TemporalMemory::activateCells(size_t activeColumnsSize,
     return connections.cellForSegment(segment) / cellsPerColumn_;
   };
 
+  struct ColumnData {
+    UInt column;
+    bool isActiveColumn;
+    vector<Segment>::const_iterator activeSegmentsBegin, activeSegmentsEnd,
+        matchingSegmentsBegin, matchingSegmentsEnd;
+  };
+  vector<ColumnData> columns;
+
   for (auto &columnData : iterGroupBy(
            activeColumns, activeColumns + activeColumnsSize, identity<UInt>,
            activeSegments_.begin(), activeSegments_.end(), columnForSegment,
@@ -486,33 +820,77 @@ void TemporalMemory::activateCells(size_t activeColumnsSize,
         columnMatchingSegmentsEnd) = columnData;
 
     const bool isActiveColumn = activeColumnsBegin != activeColumnsEnd;
-    if (isActiveColumn) {
-      if (columnActiveSegmentsBegin != columnActiveSegmentsEnd) {
-        activatePredictedColumn(
-            activeCells_, winnerCells_, connections, rng_,
-            columnActiveSegmentsBegin, columnActiveSegmentsEnd,
-            prevActiveCellsDense, prevWinnerCells,
-            numActivePotentialSynapsesForSegment_, maxNewSynapseCount_,
-            initialPermanence_, permanenceIncrement_, permanenceDecrement_,
-            maxSynapsesPerSegment_, learn);
-      } else {
-        burstColumn(activeCells_, winnerCells_, connections, rng_,
-                    lastUsedIterationForSegment_, column,
-                    columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
-                    prevActiveCellsDense, prevWinnerCells,
-                    numActivePotentialSynapsesForSegment_, iteration_,
-                    cellsPerColumn_, maxNewSynapseCount_, initialPermanence_,
-                    permanenceIncrement_, permanenceDecrement_,
-                    maxSegmentsPerCell_, maxSynapsesPerSegment_, learn);
-      }
+    if (parallel_) {
+      columns.push_back({column, isActiveColumn, columnActiveSegmentsBegin,
+                         columnActiveSegmentsEnd, columnMatchingSegmentsBegin,
+                         columnMatchingSegmentsEnd});
     } else {
-      if (learn) {
-        punishPredictedColumn(connections, columnMatchingSegmentsBegin,
-                              columnMatchingSegmentsEnd, prevActiveCellsDense,
-                              predictedSegmentDecrement_);
-      }
+      activateColumn(
+          activeCells_, winnerCells_, connections, rng_,
+          lastUsedIterationForSegment_, column, isActiveColumn,
+          columnActiveSegmentsBegin, columnActiveSegmentsEnd,
+          columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
+          prevActiveCellsDense, prevWinnerCells,
+          numActivePotentialSynapsesForSegment_, iteration_, cellsPerColumn_,
+          maxNewSynapseCount_, initialPermanence_, permanenceIncrement_,
+          permanenceDecrement_, predictedSegmentDecrement_,
+          maxSegmentsPerCell_, maxSynapsesPerSegment_, learn);
     }
   }
+
+  if (columns.empty()) {
+    return;
+  }
+
+  // Split the columns into a range per thread. Each range stages its
+  // changes to the connections, and the ranges are then replayed in order.
+  util::ThreadPool &pool = pool_ ? *pool_ : util::ThreadPool::shared();
+  const UInt nRanges = std::min<UInt>(
+      nThreads_ ? std::min(nThreads_, pool.size()) : pool.size(),
+      (UInt)columns.size());
+  struct RangeData {
+    vector<CellIdx> activeCells;
+    vector<CellIdx> winnerCells;
+    unique_ptr<StagedConnections> connections;
+  };
+  vector<RangeData> ranges(nRanges);
+  parallelRanges_ = nRanges;
+  const UInt64 seed = rng_.getUInt64();
+
+  pool.parallelFor(
+      0, nRanges,
+      [&](UInt rangesBegin, UInt rangesEnd) {
+        for (UInt r = rangesBegin; r != rangesEnd; ++r) {
+          RangeData &range = ranges[r];
+          range.connections.reset(new StagedConnections(
+              connections, lastUsedIterationForSegment_, iteration_));
+          const size_t end = columns.size() * (r + 1) / nRanges;
+          for (size_t i = columns.size() * r / nRanges; i != end; ++i) {
+            const ColumnData &column = columns[i];
+            Random rng(columnSeed(seed, column.column));
+            activateColumn(
+                range.activeCells, range.winnerCells, *range.connections,
+                rng, lastUsedIterationForSegment_, column.column,
+                column.isActiveColumn, column.activeSegmentsBegin,
+                column.activeSegmentsEnd, column.matchingSegmentsBegin,
+                column.matchingSegmentsEnd, prevActiveCellsDense,
+                prevWinnerCells, numActivePotentialSynapsesForSegment_,
+                iteration_, cellsPerColumn_, maxNewSynapseCount_,
+                initialPermanence_, permanenceIncrement_,
+                permanenceDecrement_, predictedSegmentDecrement_,
+                maxSegmentsPerCell_, maxSynapsesPerSegment_, learn);
+          }
+        }
+      },
+      1, nRanges);
+
+  for (const RangeData &range : ranges) {
+    activeCells_.insert(activeCells_.end(), range.activeCells.begin(),
+                        range.activeCells.end());
+    winnerCells_.insert(winnerCells_.end(), range.winnerCells.begin(),
+                        range.winnerCells.end());
+    range.connections->replay(connections, lastUsedIterationForSegment_);
+  }
 }
 
 void TemporalMemory::activateDendrites(bool learn) {
@@ -686,6 +1064,17 @@ void TemporalMemory::setCheckInputs(bool checkInputs) {
   checkInputs_ = checkInputs;
 }
 
+bool TemporalMemory::getParallel() const { return parallel_; }
+
+void TemporalMemory::setParallel(bool parallel, UInt nThreads,
+                                 util::ThreadPool *pool) {
+  parallel_ = parallel;
+  nThreads_ = nThreads;
+  pool_ = pool;
+}
+
+UInt TemporalMemory::getParallelRanges() const { return parallelRanges_; }
+
 Permanence TemporalMemory::getPermanenceIncrement() const {
   return permanenceIncrement_;
 }
@@ -789,7 +1178,7 @@ void TemporalMemory::save(ostream &outStream) const {
   outStream << activeSegments_.size() << " ";
   for (Segment segment : activeSegments_) {
     const CellIdx cell = connections.cellForSegment(segment);
-    const vector<Segment> &segments = connections.segmentsForCell(cell);
+    const SegmentList segments = connections.segmentsForCell(cell);
 
     SegmentIdx idx = std::distance(
         segments.begin(), std::find(segments.begin(), segments.end(), segment));
@@ -803,7 +1192,7 @@ void TemporalMemory::save(ostream &outStream) const {
   outStream << matchingSegments_.size() << " ";
   for (Segment segment : matchingSegments_) {
     const CellIdx cell = connections.cellForSegment(segment);
-    const vector<Segment> &segments = connections.segmentsForCell(cell);
+    const SegmentList segments = connections.segmentsForCell(cell);
 
     SegmentIdx idx = std::distance(
         segments.begin(), std::find(segments.begin(), segments.end(), segment));
@@ -923,6 +1312,9 @@ void TemporalMemory::read(TemporalMemoryProto::Reader &proto) {
   maxSegmentsPerCell_ = proto.getMaxSegmentsPerCell();
   maxSynapsesPerSegment_ = proto.getMaxSynapsesPerSegment();
 
+  // Reading keeps the limits of the connections
+  connections.initialize(0, connectionsLimit<SegmentIdx>(maxSegmentsPerCell_),
+                         connectionsLimit<SynapseIdx>(maxSynapsesPerSegment_));
   auto _connections = proto.getConnections();
   connections.read(_connections);
 
@@ -996,6 +1388,9 @@ void TemporalMemory::load(istream &inStream) {
       permanenceDecrement_ >> predictedSegmentDecrement_ >>
       maxSegmentsPerCell_ >> maxSynapsesPerSegment_ >> iteration_;
 
+  // Loading keeps the limits of the connections
+  connections.initialize(0, connectionsLimit<SegmentIdx>(maxSegmentsPerCell_),
+                         connectionsLimit<SynapseIdx>(maxSynapsesPerSegment_));
   connections.load(inStream);
 
   numActiveConnectedSynapsesForSegment_.assign(
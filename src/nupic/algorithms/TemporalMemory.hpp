@@ -40,6 +40,11 @@ using namespace nupic;
 using namespace nupic::algorithms::connections;
 
 namespace nupic {
+
+namespace util {
+class ThreadPool;
+} // namespace util
+
 namespace algorithms {
 namespace temporal_memory {
 
@@ -347,6 +352,33 @@ public:
   bool getCheckInputs() const;
   void setCheckInputs(bool);
 
+  /**
+   * Get and set whether activateCells processes the columns in parallel on
+   * a ThreadPool.
+   *
+   * In parallel, each column learns with its own random number generator,
+   * seeded from the TM's generator and the column index, and the changes
+   * to the connections are staged per range of columns, then applied in
+   * the order of the columns. So the results don't depend on the number of
+   * threads, but they differ from those of serial processing, which is the
+   * default. This setting is not serialized.
+   *
+   * @param parallel Whether to process the columns in parallel.
+   * @param nThreads Upper bound on the threads used, 0 for all the threads
+   *        of the pool.
+   * @param pool Pool that runs the columns, nullptr for the shared pool.
+   *        It must outlive the TM.
+   */
+  bool getParallel() const;
+  void setParallel(bool parallel, UInt nThreads = 0,
+                   util::ThreadPool *pool = nullptr);
+
+  /**
+   * Returns the number of ranges the columns were split into by the last
+   * parallel activateCells, 0 if it hasn't run in parallel.
+   */
+  UInt getParallelRanges() const;
+
   /**
    * Returns the permanence increment.
    *
@@ -462,6 +494,10 @@ protected:
   UInt minThreshold_;
   UInt maxNewSynapseCount_;
   bool checkInputs_;
+  bool parallel_;
+  UInt nThreads_;
+  util::ThreadPool *pool_;
+  UInt parallelRanges_;
   Permanence initialPermanence_;
   Permanence connectedPermanence_;
   Permanence permanenceIncrement_;
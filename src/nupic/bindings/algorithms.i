@@ -77,9 +77,11 @@ _ALGORITHMS = _algorithms
 #include <vector>
 
 #include <nupic/math/Types.hpp>
+#include <nupic/math/Workspace.hpp>
 #include <nupic/math/Convolution.hpp>
 #include <nupic/math/Rotation.hpp>
 #include <nupic/math/Erosion.hpp>
+#include <nupic/algorithms/AnomalyLikelihood.hpp>
 #include <nupic/algorithms/GaborNode.hpp>
 #include <nupic/algorithms/ImageSensorLite.hpp>
 #include <nupic/algorithms/Scanning.hpp>
@@ -210,9 +212,84 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 }
 
 
+//--------------------------------------------------------------------------------
+// NUMPY BUFFERS
+//--------------------------------------------------------------------------------
+%{
+// Some wrappers work directly on the numpy buffers, without copies.
+// These check that the arrays actually have the layout the C++ code
+// assumes, rather than silently reading or writing past them.
+
+// Data of a C-contiguous float32 array with at least size elements.
+static float *float32Data(PyObject *obj, size_t size, const char *name)
+{
+  NTA_CHECK(PyArray_Check(obj)) << name << " must be a numpy array";
+  PyArrayObject *a = (PyArrayObject*)obj;
+  NTA_CHECK(PyArray_TYPE(a) == NPY_FLOAT32) << name << " must be float32";
+  NTA_CHECK(PyArray_ISCARRAY(a)) << name << " must be C-contiguous";
+  NTA_CHECK((size_t)PyArray_SIZE(a) >= size)
+    << name << " has " << PyArray_SIZE(a) << " elements, needs " << size;
+  return (float*)PyArray_DATA(a);
+}
+
+// Data of a C-contiguous float32 array of shape (nrows, ncols).
+static float *float32Matrix(PyObject *obj, size_t nrows, size_t ncols,
+                            const char *name)
+{
+  float *data = float32Data(obj, nrows * ncols, name);
+  PyArrayObject *a = (PyArrayObject*)obj;
+  NTA_CHECK(PyArray_NDIM(a) == 2 &&
+            (size_t)PyArray_DIM(a, 0) == nrows &&
+            (size_t)PyArray_DIM(a, 1) == ncols)
+    << name << " must have shape (" << nrows << ", " << ncols << ")";
+  return data;
+}
+%}
+
 //--------------------------------------------------------------------------------
 // SVM
 //--------------------------------------------------------------------------------
+%{
+// predict_batch of svm_dense and svm_01. The buffers are checked before the
+// GIL is released, since the batch writes through them.
+template <typename Svm>
+static void svmPredictBatch(Svm *svm, PyObject *x_matrix,
+                            PyObject *labels_vector,
+                            PyObject *dec_values_matrix,
+                            PyObject *proba_matrix, int n_threads)
+{
+  NTA_CHECK(PyArray_Check(x_matrix) &&
+            PyArray_NDIM((PyArrayObject*)x_matrix) == 2)
+    << "x must be a 2D numpy array";
+  const nupic::algorithms::svm::svm_model &model = svm->get_model();
+  const size_t n = (size_t)PyArray_DIM((PyArrayObject*)x_matrix, 0);
+  const size_t n_class = (size_t)model.n_class();
+
+  const float *x = float32Matrix(x_matrix, n, model.n_dims(), "x");
+  float *labels = float32Data(labels_vector, n, "labels");
+  float *dec_values = (dec_values_matrix && dec_values_matrix != Py_None)
+    ? float32Matrix(dec_values_matrix, n, n_class * (n_class - 1) / 2,
+                    "dec_values")
+    : NULL;
+  float *proba = (proba_matrix && proba_matrix != Py_None)
+    ? float32Matrix(proba_matrix, n, n_class, "proba") : NULL;
+  NTA_CHECK(n_threads >= 0) << "n_threads must not be negative";
+
+  nupic::py::ReleaseGIL nogil;
+  svm->predict_batch((int)n, x, labels, dec_values, proba, n_threads);
+}
+%}
+
+%feature("docstring") nupic::algorithms::svm::svm_dense
+"Dense SVM. train, cross_validate and predict_batch release the GIL, so an
+svm_dense must not be used from two threads at once.
+";
+
+%feature("docstring") nupic::algorithms::svm::svm_01
+"SVM on 0/1 input vectors. train, cross_validate and predict_batch release
+the GIL, so an svm_01 must not be used from two threads at once.
+";
+
 %include <nupic/algorithms/Svm.hpp>
 
 %ignore nupic::algorithms::svm::operator=;
@@ -382,6 +459,20 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
     return self->predict_probability((float*)PyArray_DATA(x), (float*)PyArray_DATA(proba));
   }
 
+  // x_matrix is a C-contiguous float32 array of shape (n, n_dims);
+  // labels_vector receives the n labels. dec_values_matrix
+  // (n, n_class*(n_class-1)/2) and proba_matrix (n, n_class) are optional
+  // float32 outputs, in the order of the C++ predict_batch. The GIL is
+  // released while the batch is scored.
+  inline void predict_batch(PyObject* x_matrix, PyObject* labels_vector,
+                            PyObject* dec_values_matrix = NULL,
+                            PyObject* proba_matrix = NULL,
+                            int n_threads = 0)
+  {
+    svmPredictBatch(self, x_matrix, labels_vector, dec_values_matrix,
+                    proba_matrix, n_threads);
+  }
+
   inline void save(const std::string& filename)
   {
     std::ofstream save_file(filename.c_str());
@@ -399,17 +490,17 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
   inline float cross_validate(int n_fold, float gamma, float C, float eps)
   {
     float accuracy;
-    Py_BEGIN_ALLOW_THREADS;
-    accuracy = self->cross_validation(n_fold, gamma, C, eps);
-    Py_END_ALLOW_THREADS;
+    {
+      nupic::py::ReleaseGIL nogil;
+      accuracy = self->cross_validation(n_fold, gamma, C, eps);
+    }
     return accuracy;
   }
 
   inline void trainReleaseGIL(float gamma, float C, float eps)
   {
-    Py_BEGIN_ALLOW_THREADS;
+    nupic::py::ReleaseGIL nogil;
     self->train(gamma, C, eps);
-    Py_END_ALLOW_THREADS;
   }
 };
 
@@ -496,20 +587,34 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
     return self->predict_probability((float*)PyArray_DATA(x), (float*)PyArray_DATA(proba));
   }
 
+  // x_matrix is a C-contiguous float32 array of shape (n, n_dims);
+  // labels_vector receives the n labels. dec_values_matrix
+  // (n, n_class*(n_class-1)/2) and proba_matrix (n, n_class) are optional
+  // float32 outputs, in the order of the C++ predict_batch. The GIL is
+  // released while the batch is scored.
+  inline void predict_batch(PyObject* x_matrix, PyObject* labels_vector,
+                            PyObject* dec_values_matrix = NULL,
+                            PyObject* proba_matrix = NULL,
+                            int n_threads = 0)
+  {
+    svmPredictBatch(self, x_matrix, labels_vector, dec_values_matrix,
+                    proba_matrix, n_threads);
+  }
+
   inline float cross_validate(int n_fold, float gamma, float C, float eps)
   {
     float accuracy;
-    Py_BEGIN_ALLOW_THREADS;
-    accuracy = self->cross_validation(n_fold, gamma, C, eps);
-    Py_END_ALLOW_THREADS;
+    {
+      nupic::py::ReleaseGIL nogil;
+      accuracy = self->cross_validation(n_fold, gamma, C, eps);
+    }
     return accuracy;
   }
 
   inline void trainReleaseGIL(float gamma, float C, float eps)
   {
-    Py_BEGIN_ALLOW_THREADS;
+    nupic::py::ReleaseGIL nogil;
     self->train(gamma, C, eps);
-    Py_END_ALLOW_THREADS;
   }
 
   inline void save(const std::string& filename)
@@ -527,39 +632,115 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
   }
 };
 
+//--------------------------------------------------------------------------------
+// IMAGE KERNELS
+//--------------------------------------------------------------------------------
+%{
+// The image kernels work directly on the numpy buffers, without copies,
+// and check them with float32Data (see NUMPY BUFFERS) and float32Rows.
+
+// Data of a 2D float32 array with at least nrows x ncols elements, whose
+// rows are contiguous but may be strided (e.g. a slice of a larger image).
+// The row stride, in elements, is returned in row_stride.
+static float *float32Rows(PyObject *obj, size_t nrows, size_t ncols,
+                          size_t &row_stride, const char *name)
+{
+  NTA_CHECK(PyArray_Check(obj)) << name << " must be a numpy array";
+  PyArrayObject *a = (PyArrayObject*)obj;
+  NTA_CHECK(PyArray_TYPE(a) == NPY_FLOAT32) << name << " must be float32";
+  NTA_CHECK(PyArray_NDIM(a) == 2) << name << " must be 2D";
+  NTA_CHECK(PyArray_ISWRITEABLE(a)) << name << " must be writeable";
+  NTA_CHECK((size_t)PyArray_DIM(a, 0) >= nrows &&
+            (size_t)PyArray_DIM(a, 1) >= ncols)
+    << name << " must be at least " << nrows << "x" << ncols;
+  NTA_CHECK(PyArray_STRIDE(a, 1) == sizeof(float) &&
+            PyArray_STRIDE(a, 0) > 0 &&
+            PyArray_STRIDE(a, 0) % sizeof(float) == 0)
+    << name << " must have contiguous rows";
+  row_stride = PyArray_STRIDE(a, 0) / sizeof(float);
+  return (float*)PyArray_DATA(a);
+}
+%}
+
+%feature("docstring") Workspace<float>
+"Scratch memory that Float32SeparableConvolution2D and Float32Erosion
+objects can share, see their init methods.
+
+A workspace is not thread-safe: the objects that share it must not compute
+from two threads at once, since compute releases the GIL.
+";
+
+%include <nupic/math/Workspace.hpp>
+
+%template(Float32Workspace) Workspace<float>;
+
 //--------------------------------------------------------------------------------
 // CONVOLUTION
 //--------------------------------------------------------------------------------
+%rename(_init) SeparableConvolution2D<float>::init;
+
 %include <nupic/math/Convolution.hpp>
 
+%feature("docstring") SeparableConvolution2D<float>
+"Separable 2D convolution of float images. compute and computeValid release
+the GIL: an object is not thread-safe and must not compute from two threads
+at once.
+";
+
 %template(Float32SeparableConvolution2D) SeparableConvolution2D<float>;
 
 %extend SeparableConvolution2D<float>
 {
   inline void init(nupic::UInt32 nrows, nupic::UInt32 ncols,
            nupic::UInt32 f1_size, nupic::UInt32 f2_size,
-           PyObject* pyF1, PyObject* pyF2)
+           PyObject* pyF1, PyObject* pyF2,
+           Workspace<float>* workspace =NULL)
   {
-    PyArrayObject *f1 = (PyArrayObject*) pyF1;
-    PyArrayObject *f2 = (PyArrayObject*) pyF2;
-
-    self->init(nrows, ncols, f1_size, f2_size, (float*)(PyArray_DATA(f1)), (float*)(PyArray_DATA(f2)));
+    // The filters and the workspace are kept by pointer: init, in Python,
+    // keeps them alive as long as this object.
+    self->init(nrows, ncols, f1_size, f2_size,
+               float32Data(pyF1, f1_size, "f1"),
+               float32Data(pyF2, f2_size, "f2"), workspace);
   }
 
+  %pythoncode %{
+    def init(self, nrows, ncols, f1_size, f2_size, f1, f2, workspace=None):
+      """
+      Sets the image size and the filters. The object keeps references to
+      the filters and the workspace (a Float32Workspace), which it uses by
+      pointer. Objects sharing a workspace must not compute from two threads
+      at once.
+      """
+      self._init(nrows, ncols, f1_size, f2_size, f1, f2, workspace)
+      self._f1, self._f2, self._workspace = f1, f2, workspace
+  %}
+
   inline void compute(PyObject* pyData, PyObject* pyConvolved, bool rotated45 =false)
   {
-    PyArrayObject* data = (PyArrayObject*)pyData;
-    PyArrayObject* convolved = (PyArrayObject*)pyConvolved;
+    const size_t size = self->nrows_ * self->ncols_;
+    float *data = float32Data(pyData, size, "data");
+    float *convolved = float32Data(pyConvolved, size, "convolved");
+    nupic::py::ReleaseGIL nogil;
+    self->compute(data, convolved, rotated45);
+  }
 
-    self->compute((float*)(PyArray_DATA(data)), (float*)(PyArray_DATA(convolved)), rotated45);
+  inline void computeValid(PyObject* pyData, PyObject* pyOut,
+                           nupic::UInt32 rowStep =1, nupic::UInt32 colStep =1)
+  {
+    NTA_CHECK(rowStep > 0 && colStep > 0);
+    size_t row_stride = 0;
+    float *out = float32Rows(pyOut, self->validRows(rowStep),
+                             self->validCols(colStep), row_stride, "out");
+    float *data = float32Data(pyData, self->nrows_ * self->ncols_, "data");
+    nupic::py::ReleaseGIL nogil;
+    self->computeValid(data, out, row_stride, rowStep, colStep);
   }
 
   inline void getBuffer(PyObject* pyBuffer) const
   {
-    PyArrayObject *buffer = (PyArrayObject*)pyBuffer;
-
     const size_t size = self->nrows_ * self->ncols_;
-    std::copy(self->buffer_, self->buffer_ + size, (float*)(PyArray_DATA(buffer)));
+    std::copy(self->buffer_, self->buffer_ + size,
+              float32Data(pyBuffer, size, "buffer"));
   }
 };
 
@@ -568,6 +749,11 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 //--------------------------------------------------------------------------------
 %include <nupic/math/Rotation.hpp>
 
+%feature("docstring") Rotation45<float>
+"Rotates float images by 45 degrees. rotate and unrotate release the GIL;
+an object must not be used from two threads at once.
+";
+
 %template(Float32Rotation45) Rotation45<float>;
 
 %extend Rotation45<float>
@@ -575,54 +761,70 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
   inline void rotate(PyObject* pyOriginal, PyObject* pyRotated,
              nupic::UInt32 nrows, nupic::UInt32 ncols, nupic::UInt32 z)
   {
-    PyArrayObject* original = (PyArrayObject*)pyOriginal;
-    PyArrayObject* rotated = (PyArrayObject*)pyRotated;
-
-    self->rotate((float*)(PyArray_DATA(original)), (float*)(PyArray_DATA(rotated)),
-      nrows, ncols, z);
+    float *original = float32Data(pyOriginal, nrows * ncols, "original");
+    float *rotated = float32Data(pyRotated, z * z, "rotated");
+    nupic::py::ReleaseGIL nogil;
+    self->rotate(original, rotated, nrows, ncols, z);
   }
 
   inline void unrotate(PyObject* pyUnrotated, PyObject* pyRotated,
                nupic::UInt32 nrows, nupic::UInt32 ncols, nupic::UInt32 z)
   {
-    PyArrayObject* unrotated = (PyArrayObject*)pyUnrotated;
-    PyArrayObject* rotated = (PyArrayObject*)pyRotated;
-
-    self->unrotate((float*)(PyArray_DATA(unrotated)), (float*)(PyArray_DATA(rotated)),
-      nrows, ncols, z);
+    float *unrotated = float32Data(pyUnrotated, nrows * ncols, "unrotated");
+    float *rotated = float32Data(pyRotated, z * z, "rotated");
+    nupic::py::ReleaseGIL nogil;
+    self->unrotate(unrotated, rotated, nrows, ncols, z);
   }
 };
 
 //--------------------------------------------------------------------------------
 // EROSION
 //--------------------------------------------------------------------------------
+%rename(_init) Erosion<float>::init;
+
 %include <nupic/math/Erosion.hpp>
 
+%feature("docstring") Erosion<float>
+"Erosion and dilation of float images. compute releases the GIL: an object
+is not thread-safe and must not compute from two threads at once.
+";
+
 %template(Float32Erosion) Erosion<float>;
 
 %extend Erosion<float>
 {
-  inline void init(nupic::UInt32 nrows, nupic::UInt32 ncols)
+  inline void init(nupic::UInt32 nrows, nupic::UInt32 ncols,
+                   Workspace<float>* workspace =NULL)
   {
-    self->init(nrows, ncols);
+    self->init(nrows, ncols, workspace);
   }
 
+  %pythoncode %{
+    def init(self, nrows, ncols, workspace=None):
+      """
+      Sets the image size. The object keeps a reference to the workspace (a
+      Float32Workspace), which it uses by pointer. Objects sharing a
+      workspace must not compute from two threads at once.
+      """
+      self._init(nrows, ncols, workspace)
+      self._workspace = workspace
+  %}
+
   inline void compute(PyObject* pyData, PyObject* pyEroded,
                       nupic::UInt32 iterations, bool dilate=false)
   {
-    PyArrayObject* data = (PyArrayObject*)pyData;
-    PyArrayObject* eroded = (PyArrayObject*)pyEroded;
-
-    self->compute((float*)(PyArray_DATA(data)), (float*)(PyArray_DATA(eroded)),
-                  iterations, dilate);
+    const size_t size = self->nrows_ * self->ncols_;
+    float *data = float32Data(pyData, size, "data");
+    float *eroded = float32Data(pyEroded, size, "eroded");
+    nupic::py::ReleaseGIL nogil;
+    self->compute(data, eroded, iterations, dilate);
   }
 
   inline void getBuffer(PyObject* pyBuffer) const
   {
-    PyArrayObject *buffer = (PyArrayObject*)pyBuffer;
-
     const size_t size = self->nrows_ * self->ncols_;
-    std::copy(self->buffer_, self->buffer_ + size, (float*)(PyArray_DATA(buffer)));
+    std::copy(self->buffer_, self->buffer_ + size,
+              float32Data(pyBuffer, size, "buffer"));
   }
 };
 
@@ -873,6 +1075,12 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 
 //--------------------------------------------------------------------------------
 // EVEN NEWER ALGORITHMS (Cells4)
+%feature("docstring") nupic::algorithms::Cells4::Cells4
+"Cells4 compute releases the GIL. Distinct instances may compute in
+parallel threads, but one instance is not thread-safe: calls on it must not
+overlap.
+";
+
 %include <nupic/algorithms/Cells4.hpp>
 
 
@@ -1045,7 +1253,10 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
   {
     PyArrayObject* x = (PyArrayObject*) py_x;
     nupic::NumpyVectorT<nupic::Real> y(self->nCells());
-    self->compute((nupic::Real*) PyArray_DATA(x), y.begin(), doInference, doLearning);
+    {
+      nupic::py::ReleaseGIL nogil;
+      self->compute((nupic::Real*) PyArray_DATA(x), y.begin(), doInference, doLearning);
+    }
     return y.forPython();
   }
 }
@@ -1056,6 +1267,20 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 %rename(getOverlapsTuple) nupic::algorithms::spatial_pooler::SpatialPooler::getOverlaps() const;
 %rename(getBoostedOverlapsTuple) nupic::algorithms::spatial_pooler::SpatialPooler::getBoostedOverlaps() const;
 
+// The sparse overloads would get in the way of the numpy arrays of the dense
+// methods; the sparse compute is exposed as computeSparse below.
+%ignore nupic::algorithms::spatial_pooler::SpatialPooler::compute(const vector<UInt> &, bool, vector<UInt> &);
+%ignore nupic::algorithms::spatial_pooler::SpatialPooler::stripUnlearnedColumns(vector<UInt> &) const;
+%ignore nupic::algorithms::spatial_pooler::SpatialPooler::calculateOverlap_(const vector<UInt> &, vector<UInt> &);
+%ignore nupic::algorithms::spatial_pooler::SpatialPooler::adaptSynapses_(const vector<UInt> &, vector<UInt> &);
+%ignore nupic::algorithms::spatial_pooler::SpatialPooler::updateDutyCycles_(const vector<UInt> &, const vector<UInt> &);
+
+%feature("docstring") nupic::algorithms::spatial_pooler::SpatialPooler
+"compute and computeSparse release the GIL. Distinct instances may compute
+in parallel threads, but one instance is not thread-safe: callers sharing it
+between threads must serialize its calls, e.g. with a threading.Lock.
+";
+
 %include <nupic/algorithms/SpatialPooler.hpp>
 
 %extend nupic::algorithms::spatial_pooler::SpatialPooler
@@ -1167,9 +1392,24 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
   {
     nupic::CheckedNumpyVectorWeakRefT<nupic::UInt> inputArray(py_inputArray);
     nupic::CheckedNumpyVectorWeakRefT<nupic::UInt> activeArray(py_activeArray);
+    nupic::py::ReleaseGIL nogil;
     self->compute(inputArray.begin(), learn, activeArray.begin());
   }
 
+  inline PyObject* computeSparse(PyObject *py_activeInputs, bool learn)
+  {
+    nupic::CheckedNumpyVectorWeakRefT<nupic::UInt> activeInputs(py_activeInputs);
+    const vector<nupic::UInt> input(activeInputs.begin(), activeInputs.end());
+    vector<nupic::UInt> activeColumns;
+    {
+      nupic::py::ReleaseGIL nogil;
+      self->compute(input, learn, activeColumns);
+    }
+    return nupic::NumpyVectorT<nupic::UInt32>(
+      activeColumns.size(), activeColumns.data()
+    ).forPython();
+  }
+
   inline void stripUnlearnedColumns(PyObject *py_x)
   {
     PyArrayObject* x = (PyArrayObject*) py_x;
@@ -1362,6 +1602,11 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 }
 
 
+%feature("docstring") nupic::algorithms::sdr_classifier::SDRClassifier
+"convertedCompute releases the GIL. Distinct instances may compute in
+parallel threads, but calls on one instance must not overlap.
+";
+
 %include <nupic/algorithms/SDRClassifier.hpp>
 
 %pythoncode %{
@@ -1509,8 +1754,11 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
                              bool learn, bool infer)
   {
     ClassifierResult result;
-    self->compute(recordNum, patternNZ, bucketIdxList, actValueList, category,
-                  learn, infer, &result);
+    {
+      nupic::py::ReleaseGIL nogil;
+      self->compute(recordNum, patternNZ, bucketIdxList, actValueList, category,
+                    learn, infer, &result);
+    }
     PyObject* d = PyDict_New();
     for (map<Int, vector<Real64>*>::const_iterator it = result.begin();
          it != result.end(); ++it)
@@ -1553,6 +1801,19 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 %rename(ConnectionsSynapse) nupic::algorithms::connections::Synapse;
 %template(ConnectionsSynapseVector) vector<nupic::algorithms::connections::Synapse>;
 %feature("director") nupic::algorithms::connections::ConnectionsEventHandler;
+
+// The segment and synapse lists are views into the pools of Connections:
+// return copies, as for the vectors they replace.
+%typemap(out) nupic::algorithms::connections::SegmentList
+{
+  const std::vector<nupic::algorithms::connections::Segment> segments = $1;
+  $result = swig::from(segments);
+}
+%typemap(out) nupic::algorithms::connections::SynapseList
+{
+  const std::vector<nupic::algorithms::connections::Synapse> synapses = $1;
+  $result = swig::from(synapses);
+}
 %include <nupic/algorithms/Connections.hpp>
 
 
@@ -1862,6 +2123,9 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
     UInt32* activeColumns =
       (UInt32*)PyArray_DATA(_activeColumns);
 
+    // Event handlers subscribed from Python are directors, which call
+    // back into the interpreter.
+    nupic::py::ReleaseGIL nogil(!self->connections.hasSubscribers());
     self->activateCells(activeColumnsSize,
                         activeColumns,
                         learn);
@@ -1877,6 +2141,7 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
     UInt32* activeColumns =
       (UInt32*)PyArray_DATA(_activeColumns);
 
+    nupic::py::ReleaseGIL nogil(!self->connections.hasSubscribers());
     self->compute(activeColumnsSize, activeColumns, learn);
   }
 
@@ -1916,4 +2181,71 @@ void forceRetentionOfImageSensorLiteLibrary(void) {
 %ignore nupic::algorithms::temporal_memory::TemporalMemory::cellsForColumn;
 
 
+%feature("docstring") nupic::algorithms::temporal_memory::TemporalMemory
+"convertedCompute and convertedActivateCells release the GIL, unless event
+handlers are subscribed to the connections. Distinct instances may compute
+in parallel threads, but one instance is not thread-safe: callers sharing it
+between threads must serialize its calls, e.g. with a threading.Lock.
+";
+
 %include <nupic/algorithms/TemporalMemory.hpp>
+
+
+//--------------------------------------------------------------------------------
+// Anomaly likelihood
+%ignore nupic::algorithms::anomaly::AnomalyLikelihood::anomalyProbabilities;
+%include <nupic/algorithms/AnomalyLikelihood.hpp>
+%template(AnomalyLikelihoodVector)
+    std::vector<nupic::algorithms::anomaly::AnomalyLikelihood>;
+
+%extend nupic::algorithms::anomaly::AnomalyLikelihood
+{
+  %pythoncode %{
+    @staticmethod
+    def anomalyProbabilities(streams, rawScores, nThreads=0):
+      """Scores the next record of many streams at once. The GIL is
+      released while scoring: the streams must not be used from another
+      thread meanwhile.
+
+      :param streams: AnomalyLikelihoodVector of the streams
+      :param rawScores: raw anomaly score of each stream
+      :returns: numpy array of the likelihood of each stream
+      """
+      rawScores = numpy.ascontiguousarray(rawScores, dtype=numpy.float64)
+      likelihoods = numpy.empty(len(streams), dtype=numpy.float64)
+      AnomalyLikelihood._anomalyProbabilities(streams, rawScores, likelihoods,
+                                              nThreads)
+      return likelihoods
+
+    def __getstate__(self):
+      return self._writeAsCapnpPyBytes()
+
+    def __setstate__(self, state):
+      self.this = _ALGORITHMS.new_AnomalyLikelihood()
+      self._initFromCapnpPyBytes(state)
+  %}
+
+  static void _anomalyProbabilities(
+      std::vector<nupic::algorithms::anomaly::AnomalyLikelihood> &streams,
+      PyObject *py_rawScores, PyObject *py_likelihoods, nupic::UInt nThreads)
+  {
+    PyArrayObject* rawScores = (PyArrayObject*) py_rawScores;
+    PyArrayObject* likelihoods = (PyArrayObject*) py_likelihoods;
+    NTA_CHECK((size_t)PyArray_DIMS(rawScores)[0] == streams.size())
+        << "One raw score per stream is required";
+    nupic::py::ReleaseGIL nogil;
+    nupic::algorithms::anomaly::AnomalyLikelihood::anomalyProbabilities(
+        streams, (nupic::Real64*)PyArray_DATA(rawScores),
+        (nupic::Real64*)PyArray_DATA(likelihoods), nThreads);
+  }
+
+  inline PyObject* _writeAsCapnpPyBytes() const
+  {
+    return nupic::PyCapnpHelper::writeAsPyBytes(*self);
+  }
+
+  inline void _initFromCapnpPyBytes(PyObject* pyBytes)
+  {
+    nupic::PyCapnpHelper::initFromPyBytes(*self, pyBytes);
+  }
+}
@@ -74,6 +74,7 @@ else:
 #include <nupic/utils/LoggingException.hpp>
 
 #include <nupic/py_support/PyArray.hpp>
+#include <nupic/py_support/PyRegionRefs.hpp>
 
 #include <nupic/engine/NuPIC.hpp>
 #include <nupic/engine/Network.hpp>
@@ -170,6 +171,10 @@ class IterablePair(object):
 }
 
 %include <nupic/engine/NuPIC.hpp>
+// The counters are returned to Python as JSON, see Network.getProfile()
+%ignore nupic::Network::getProfile;
+%ignore nupic::Region::getCounters;
+%ignore nupic::Link::getCounters;
 %include <nupic/engine/Network.hpp>
 %ignore nupic::Region::getInputData;
 %ignore nupic::Region::getOutputData;
@@ -227,6 +232,8 @@ class IterablePair(object):
 %template(Real32ArrayRef) nupic::PyArrayRef<nupic::Real32>;
 %template(BoolArrayRef) nupic::PyArrayRef<bool>;
 
+%include <nupic/py_support/PyRegionRefs.hpp>
+
 
 %extend nupic::Timer
 {
@@ -266,6 +273,28 @@ class IterablePair(object):
   {
     return nupic::PyArrayRef<nupic::Byte>(self->getOutputData(name)).asNumpyArray();
   }
+
+  // Handles resolved once, for repeated access, see PyRegionRefs.hpp
+  nupic::PyParameterRef getParameterRef(const std::string &name)
+  {
+    return nupic::PyParameterRef(self->getParameterRef(name));
+  }
+
+  nupic::PyInputRef getInputRef(const std::string &name)
+  {
+    nupic::Input *input = self->getInput(name);
+    NTA_CHECK(input) << "Unknown input " << name << " on region "
+                     << self->getName();
+    return nupic::PyInputRef(input);
+  }
+
+  nupic::PyOutputRef getOutputRef(const std::string &name)
+  {
+    nupic::Output *output = self->getOutput(name);
+    NTA_CHECK(output) << "Unknown output " << name << " on region "
+                      << self->getName();
+    return nupic::PyOutputRef(output);
+  }
 }
 
 
@@ -300,6 +329,16 @@ class IterablePair(object):
 
       """
       self._initFromCapnpPyBytes(proto.as_builder().to_bytes()) # copy * 2
+
+
+    def getProfile(self):
+      """Snapshot of the performance counters of the network, its regions
+      and its links, as a dict. Times are in ns.
+
+      Profiling must be enabled with enableProfiling().
+      """
+      import json
+      return json.loads(self.getProfileJSON())
   %}
 
   inline PyObject* _writeAsCapnpPyBytes() const
@@ -2274,6 +2274,12 @@ inline nupic::UInt32 nNonZeroCols_01(nupic::UInt32 nrows, nupic::UInt32 ncols, P
    }
    */
 
+  //--------------------------------------------------------------------------------
+  void SM_setExactLogExp(bool exact)
+  {
+    nupic::SparseMatrixAlgorithms::setExactLogExp(exact);
+  }
+
   //--------------------------------------------------------------------------------
   void SM_logSumNoAlloc(nupic::SparseMatrix<nupic::UInt32,nupic::Real32,nupic::Int32,nupic::Real64,nupic::DistanceToZero<nupic::Real32 > >& A,
       const nupic::SparseMatrix<nupic::UInt32,nupic::Real32,nupic::Int32,nupic::Real64,nupic::DistanceToZero<nupic::Real32 > >& B, double min_floor =0)
@@ -2730,6 +2736,40 @@ def __str__(self):
     return toReturn;
   }
 
+  PyObject *LpNearestBatch(nupic::Real ## N2 p, PyObject *rows,
+          nupic::UInt ## N1 k =1, bool take_root =true) const
+  {
+    nupic::NumpyMatrixT<nupic::Real ## N2> x(rows);
+    const nupic::UInt ## N1 nq = x.nRows();
+    k = std::min(k, self->nRows());
+    std::vector<std::pair<nupic::UInt ## N1, nupic::Real ## N2> > nn(nq * k);
+    self->LpNearestBatch(p, nq, x.addressOf(0, 0), nn.begin(), k, take_root);
+    PyObject* toReturn = PyTuple_New(nq);
+    for (nupic::UInt ## N1 q = 0; q != nq; ++q) {
+      PyObject* nnq = PyTuple_New(k);
+      for (nupic::UInt ## N1 i = 0; i != k; ++i)
+        PyTuple_SET_ITEM(nnq, i, nupic::createPair ## N2(nn[q * k + i].first,
+                                                         nn[q * k + i].second));
+      PyTuple_SET_ITEM(toReturn, q, nnq);
+    }
+    return toReturn;
+  }
+
+  PyObject *approxLpNearest(nupic::Real ## N2 p, PyObject *row,
+          nupic::UInt ## N1 k =1, bool take_root =true,
+          nupic::UInt ## N1 maxCandidates =0) const
+  {
+    nupic::NumpyVectorT<nupic::Real ## N2> x(row);
+    k = std::min(k, self->nRows());
+    std::vector<std::pair<nupic::UInt ## N1, nupic::Real ## N2> > nn(k);
+    self->approxLpNearest(p, x.begin(), nn.begin(), k, take_root,
+                          maxCandidates);
+    PyObject* toReturn = PyTuple_New(k);
+    for (nupic::UInt ## N1 i = 0; i != k; ++i)
+      PyTuple_SET_ITEM(toReturn, i, nupic::createPair ## N2(nn[i].first, nn[i].second));
+    return toReturn;
+  }
+
   PyObject *closestLp_w(nupic::Real ## N2 p, PyObject *row)
   {
     nupic::NumpyVectorT<nupic::Real ## N2> x(row);
@@ -3178,8 +3218,8 @@ def read(self, proto):
   inline PyObject* getRowSparse(nupic::UInt16 row) const
   {
     nupic::NumpyVectorT<nupic::UInt16> x(self->nNonZerosOnRow(row));
-    const nupic::SparseBinaryMatrix<nupic::UInt32, nupic::UInt16>::Row& _row =
-      self->getSparseRow(row);
+    const nupic::SparseBinaryMatrix<nupic::UInt32, nupic::UInt16>::RowView
+      _row = self->getSparseRow(row);
     for (nupic::UInt16 i = 0; i != _row.size(); ++i)
       x.set(i,_row[i]);
     return x.forPython();
@@ -3693,7 +3733,7 @@ def read(self, proto):
   inline PyObject* getRowSparse(nupic::UInt32 row) const
   {
     nupic::NumpyVectorT<nupic::UInt32> x(self->nNonZerosOnRow(row));
-    const nupic::SparseBinaryMatrix<nupic::UInt32>::Row& _row =
+    const nupic::SparseBinaryMatrix<nupic::UInt32>::RowView _row =
       self->getSparseRow(row);
     for (nupic::UInt32 i = 0; i != _row.size(); ++i)
       x.set(i, _row[i]);
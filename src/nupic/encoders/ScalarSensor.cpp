@@ -200,6 +200,13 @@ void ScalarSensor::setParameterFromBuffer(const std::string &name, Int64 index,
   }
 }
 
+void *ScalarSensor::getParameterAddress(const std::string &name) {
+  if (name == "sensedValue") {
+    return &sensedValue_;
+  }
+  return nullptr;
+}
+
 void ScalarSensor::initialize() {
   encodedOutput_ = getOutput("encoded");
   bucketOutput_ = getOutput("bucket");
@@ -63,6 +63,7 @@ public:
                                       IWriteBuffer &value) override;
   virtual void setParameterFromBuffer(const std::string &name, Int64 index,
                                       IReadBuffer &value) override;
+  virtual void *getParameterAddress(const std::string &name) override;
   virtual void initialize() override;
 
   virtual void serialize(BundleIO &bundle) override;
@@ -333,6 +333,13 @@ void Link::compute() {
 
   const Array &dest = dest_->getData();
 
+  Region &destRegion = dest_->getRegion();
+  const bool profiling = destRegion.isProfilingEnabled();
+  if (profiling && profileName_.empty())
+    profileName_ = getMoniker();
+  ProfileScope scope(profiling ? &counters_.compute : nullptr,
+                     destRegion.getProfiler(), profileName_, "link");
+
   size_t srcSize = src.getBufferSize();
   size_t typeSize = BasicType::getSize(src.getType());
   size_t destByteOffset = destOffset_ * typeSize;
@@ -351,6 +358,8 @@ void Link::compute() {
       // Remove 'const' to update the variable length array
       const_cast<Array &>(dest).setCount(src.getCount());
     }
+    if (profiling)
+      counters_.bytesCopied += srcSize;
   } else if (dest_->isSparse()) {
     // Destination is sparse, convert source from dense to sparse
 
@@ -373,6 +382,10 @@ void Link::compute() {
     }
     // Remove 'const' to update the variable length array
     const_cast<Array &>(dest).setCount(destIdx);
+    if (profiling) {
+      counters_.bytesCopied += destIdx * sizeof(NTA_UInt32);
+      ++counters_.denseToSparse;
+    }
   } else {
     // Destination is dense, convert source from sparse to dense
 
@@ -392,6 +405,10 @@ void Link::compute() {
                                    << "It should be at least " << destIdx + 1;
       destBuf[destIdx] = true;
     }
+    if (profiling) {
+      counters_.bytesCopied += destLen;
+      ++counters_.sparseToDense;
+    }
   }
 }
 
@@ -406,6 +423,14 @@ void Link::shiftBufferedData() {
   // source value after shifting out the head.
   NTA_CHECK(srcBuffer_.full());
 
+  Region &destRegion = dest_->getRegion();
+  const bool profiling = destRegion.isProfilingEnabled();
+  if (profiling && profileName_.empty())
+    profileName_ = getMoniker();
+  ProfileScope scope(profiling ? &counters_.shiftBufferedData : nullptr,
+                     destRegion.getProfiler(), profileName_,
+                     "shiftBufferedData");
+
   // Pop head of circular queue
 
   if (_LINK_DEBUG) {
@@ -439,6 +464,12 @@ void Link::shiftBufferedData() {
   lastElement.allocateBuffer(elementCount);
   ::memcpy(lastElement.getBuffer(), srcArray.getBuffer(),
            elementCount * BasicType::getSize(elementType));
+  if (profiling) {
+    const size_t bytes = elementCount * BasicType::getSize(elementType);
+    ++counters_.allocations;
+    counters_.allocatedBytes += bytes;
+    counters_.bytesCopied += bytes;
+  }
 
   if (_LINK_DEBUG) {
     NTA_DEBUG << "Link::shiftBufferedData: " << getMoniker()
@@ -33,6 +33,7 @@
 
 #include <nupic/engine/Input.hpp> // needed for splitter map
 #include <nupic/engine/LinkPolicy.hpp>
+#include <nupic/engine/Profiler.hpp>
 #include <nupic/ntypes/Array.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
 #include <nupic/proto/LinkProto.capnp.h>
@@ -377,6 +378,20 @@ public:
    */
   void shiftBufferedData();
 
+  /**
+   * Get the performance counters of the link. They are updated while the
+   * destination region has profiling enabled.
+   *
+   * @returns
+   *     The time, bytes copied, conversions and allocations of the link
+   */
+  const LinkCounters &getCounters() const { return counters_; }
+
+  /**
+   * Reset the performance counters of the link.
+   */
+  void resetCounters() { counters_.reset(); }
+
   /**
    * Convert the Link to a human-readable string.
    *
@@ -462,6 +477,10 @@ private:
 
   // link must be initialized before it can compute()
   bool initialized_;
+
+  LinkCounters counters_;
+  // The moniker, computed on the first profiled operation
+  std::string profileName_;
 };
 
 } // namespace nupic
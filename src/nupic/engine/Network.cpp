@@ -26,6 +26,7 @@ Implementation of the Network class
 
 #include <iostream>
 #include <limits>
+#include <random>
 #include <sstream>
 #include <stdexcept>
 
@@ -36,9 +37,11 @@ Implementation of the Network class
 #include <nupic/engine/Output.hpp>
 #include <nupic/engine/Region.hpp>
 #include <nupic/engine/Spec.hpp>
+#include <nupic/ntypes/BundleArchive.hpp>
 #include <nupic/ntypes/BundleIO.hpp>
 #include <nupic/os/Directory.hpp>
 #include <nupic/os/FStream.hpp>
+#include <nupic/os/OS.hpp>
 #include <nupic/os/Path.hpp>
 #include <nupic/proto/NetworkProto.capnp.h>
 #include <nupic/proto/RegionProto.capnp.h>
@@ -65,6 +68,7 @@ Network::Network(const std::string &path) {
 void Network::commonInit() {
   initialized_ = false;
   iteration_ = 0;
+  profilingEnabled_ = false;
   minEnabledPhase_ = 0;
   maxEnabledPhase_ = 0;
   // automatic initialization of NuPIC, so users don't
@@ -108,6 +112,7 @@ Region *Network::addRegion(const std::string &name, const std::string &nodeType,
     NTA_THROW << "Region with name '" << name << "' already exists in network";
 
   auto r = new Region(name, nodeType, nodeParams, this);
+  r->setProfiler(&profiler_);
   regions_.add(name, r);
   initialized_ = false;
 
@@ -127,16 +132,24 @@ Region *Network::addRegionFromBundle(const std::string &name,
                                      const Dimensions &dimensions,
                                      const std::string &bundlePath,
                                      const std::string &label) {
-  if (regions_.contains(name))
-    NTA_THROW << "Invalid saved network: two or more instance of region '"
-              << name << "'";
-
   if (!Path::exists(bundlePath))
     NTA_THROW << "addRegionFromBundle -- bundle '" << bundlePath
               << " does not exist";
 
   BundleIO bundle(bundlePath, label, name, /* isInput: */ true);
+  return addRegionFromBundle_(name, nodeType, dimensions, bundle);
+}
+
+Region *Network::addRegionFromBundle_(const std::string &name,
+                                      const std::string &nodeType,
+                                      const Dimensions &dimensions,
+                                      BundleIO &bundle) {
+  if (regions_.contains(name))
+    NTA_THROW << "Invalid saved network: two or more instance of region '"
+              << name << "'";
+
   auto r = new Region(name, nodeType, dimensions, bundle, this);
+  r->setProfiler(&profiler_);
   regions_.add(name, r);
   initialized_ = false;
 
@@ -156,6 +169,7 @@ Region *Network::addRegionFromProto(const std::string &name,
   }
 
   auto region = new Region(name, proto, this);
+  region->setProfiler(&profiler_);
   regions_.add(name, region);
   initialized_ = false;
 
@@ -398,9 +412,20 @@ void Network::run(int n) {
   NTA_CHECK(maxEnabledPhase_ < phaseInfo_.size())
       << "maxphase: " << maxEnabledPhase_ << " size: " << phaseInfo_.size();
 
+  static const std::string runName("Network::run");
+  static const std::string shiftName("Network::shiftBufferedData");
+
   for (int iter = 0; iter < n; iter++) {
     iteration_++;
 
+    const bool profiling = profilingEnabled_;
+    if (profiling) {
+      profiler_.setIteration(iteration_);
+      ++profile_.iterations;
+    }
+    ProfileScope runScope(profiling ? &profile_.run : nullptr, &profiler_,
+                          runName, "run");
+
     // compute on all enabled regions in phase order
     for (UInt32 phase = minEnabledPhase_; phase <= maxEnabledPhase_; phase++) {
       for (auto r : phaseInfo_[phase]) {
@@ -412,11 +437,22 @@ void Network::run(int n) {
     // invoke callbacks
     for (UInt32 i = 0; i < callbacks_.getCount(); i++) {
       std::pair<std::string, callbackItem> &callback = callbacks_.getByIndex(i);
+      if (!profiling) {
+        callback.second.first(this, iteration_, callback.second.second);
+        continue;
+      }
+      const UInt64 start = Profiler::now();
       callback.second.first(this, iteration_, callback.second.second);
+      const UInt64 end = Profiler::now();
+      Profiler::record(&profiler_, profile_.callbackCounters[callback.first],
+                       start, end, callback.first, "callback");
+      profile_.callbacks.add(end - start, profiler_.histogramsEnabled());
     }
 
     // Refresh all links in the network at the end of every timestamp so that
     // data in delayed links appears to change atomically between iterations
+    ProfileScope shiftScope(profiling ? &profile_.shiftBufferedData : nullptr,
+                            &profiler_, shiftName, "shiftBufferedData");
     for (size_t i = 0; i < regions_.getCount(); i++) {
       const Region *r = regions_.getByIndex(i).second;
 
@@ -608,12 +644,15 @@ UInt32 Network::getMaxEnabledPhase() const { return maxEnabledPhase_; }
 void Network::save(const std::string &name) {
 
   if (StringUtils::endsWith(name, ".tgz")) {
-    NTA_THROW << "Gzipped tar archives (" << name << ") not yet supported";
+    NTA_THROW << "Gzipped tar archives (" << name << ") not yet supported, "
+              << "use a compressed .ntz bundle";
   } else if (StringUtils::endsWith(name, ".nta")) {
     saveToBundle(name);
+  } else if (StringUtils::endsWith(name, ".ntz")) {
+    saveToArchive(name);
   } else {
     NTA_THROW << "Network::save -- unknown file extension for '" << name
-              << "'. Supported extensions are .tgz and .nta";
+              << "'. Supported extensions are .nta and .ntz";
   }
 }
 
@@ -625,6 +664,26 @@ static std::string getLabel(size_t index) {
   return std::string("R") + StringUtils::fromInt(index);
 }
 
+namespace {
+
+// Directory for the files that regions of a compressed bundle access by
+// path, removed with its content when done
+struct ScratchDir_ {
+  std::string path;
+
+  explicit ScratchDir_(const std::string &bundlePath) {
+    std::random_device rd;
+    path = bundlePath + ".scratch-" + StringUtils::fromInt(rd());
+  }
+
+  ~ScratchDir_() {
+    if (Path::exists(path))
+      Directory::removeTree(path, /* noThrow: */ true);
+  }
+};
+
+} // namespace
+
 // save does the real work with saveToBundle
 void Network::saveToBundle(const std::string &name) {
   if (!StringUtils::endsWith(name, ".nta"))
@@ -646,70 +705,9 @@ void Network::saveToBundle(const std::string &name) {
   Directory::create(fullPath);
 
   {
-    YAML::Emitter out;
-
-    out << YAML::BeginMap;
-    out << YAML::Key << "Version" << YAML::Value << 2;
-    out << YAML::Key << "Regions" << YAML::Value << YAML::BeginSeq;
-    for (size_t regionIndex = 0; regionIndex < regions_.getCount();
-         regionIndex++) {
-      std::pair<std::string, Region *> &info = regions_.getByIndex(regionIndex);
-      Region *r = info.second;
-      // Network serializes the region directly because it is actually easier
-      // to do here than inside the region, and we don't have the RegionImpl
-      // data yet.
-      out << YAML::BeginMap;
-      out << YAML::Key << "name" << YAML::Value << info.first;
-      out << YAML::Key << "nodeType" << YAML::Value << r->getType();
-      out << YAML::Key << "dimensions" << YAML::Value << r->getDimensions();
-
-      // yaml-cpp doesn't come with a default emitter for std::set, so
-      // implement as a sequence by hand.
-      out << YAML::Key << "phases" << YAML::Value << YAML::BeginSeq;
-      std::set<UInt32> phases = r->getPhases();
-      for (const auto &phases_phase : phases) {
-        out << phases_phase;
-      }
-      out << YAML::EndSeq;
-
-      // label is going to be used to name RegionImpl files within the bundle
-      out << YAML::Key << "label" << YAML::Value << getLabel(regionIndex);
-      out << YAML::EndMap;
-    }
-    out << YAML::EndSeq; // end of regions
-
-    out << YAML::Key << "Links" << YAML::Value << YAML::BeginSeq;
-
-    for (size_t regionIndex = 0; regionIndex < regions_.getCount();
-         regionIndex++) {
-      Region *r = regions_.getByIndex(regionIndex).second;
-      const std::map<const std::string, Input *> inputs = r->getInputs();
-      for (const auto &inputs_input : inputs) {
-        const std::vector<Link *> &links = inputs_input.second->getLinks();
-        for (const auto &links_link : links) {
-          Link &l = *(links_link);
-          out << YAML::BeginMap;
-          out << YAML::Key << "type" << YAML::Value << l.getLinkType();
-          out << YAML::Key << "params" << YAML::Value << l.getLinkParams();
-          out << YAML::Key << "srcRegion" << YAML::Value
-              << l.getSrcRegionName();
-          out << YAML::Key << "srcOutput" << YAML::Value
-              << l.getSrcOutputName();
-          out << YAML::Key << "destRegion" << YAML::Value
-              << l.getDestRegionName();
-          out << YAML::Key << "destInput" << YAML::Value
-              << l.getDestInputName();
-          out << YAML::EndMap;
-        }
-      }
-    }
-    out << YAML::EndSeq; // end of links
-
-    out << YAML::EndMap; // end of network
-
     OFStream f;
     f.open(networkStructureFilename.c_str());
-    f << out.c_str();
+    writeStructure_(f);
     f.close();
   }
 
@@ -724,14 +722,112 @@ void Network::saveToBundle(const std::string &name) {
   }
 }
 
+void Network::saveToArchive(const std::string &name) {
+  if (!StringUtils::endsWith(name, ".ntz"))
+    NTA_THROW << "saveToArchive: bundle extension must be \".ntz\"";
+
+  std::string fullPath = Path::normalize(Path::makeAbsolute(name));
+
+  // Only overwrite an existing path if it appears to be a network bundle
+  if (Path::exists(fullPath) && !BundleArchiveReader::isArchive(fullPath)) {
+    NTA_THROW << "Existing filesystem entry " << fullPath
+              << " is not a compressed network bundle -- refusing to delete";
+  }
+
+  BundleArchiveWriter archive(fullPath);
+  {
+    std::ostream out(&archive.beginEntry("network.yaml"));
+    writeStructure_(out);
+    archive.endEntry();
+  }
+
+  ScratchDir_ scratch(fullPath);
+  for (size_t regionIndex = 0; regionIndex < regions_.getCount();
+       regionIndex++) {
+    std::pair<std::string, Region *> &info = regions_.getByIndex(regionIndex);
+    BundleIO bundle(archive, getLabel(regionIndex), info.first,
+                    scratch.path);
+    info.second->serializeImpl(bundle);
+    bundle.close();
+  }
+  archive.close();
+}
+
+void Network::writeStructure_(std::ostream &f) {
+  YAML::Emitter out;
+
+  out << YAML::BeginMap;
+  out << YAML::Key << "Version" << YAML::Value << 2;
+  out << YAML::Key << "Regions" << YAML::Value << YAML::BeginSeq;
+  for (size_t regionIndex = 0; regionIndex < regions_.getCount();
+       regionIndex++) {
+    std::pair<std::string, Region *> &info = regions_.getByIndex(regionIndex);
+    Region *r = info.second;
+    // Network serializes the region directly because it is actually easier
+    // to do here than inside the region, and we don't have the RegionImpl
+    // data yet.
+    out << YAML::BeginMap;
+    out << YAML::Key << "name" << YAML::Value << info.first;
+    out << YAML::Key << "nodeType" << YAML::Value << r->getType();
+    out << YAML::Key << "dimensions" << YAML::Value << r->getDimensions();
+
+    // yaml-cpp doesn't come with a default emitter for std::set, so
+    // implement as a sequence by hand.
+    out << YAML::Key << "phases" << YAML::Value << YAML::BeginSeq;
+    std::set<UInt32> phases = r->getPhases();
+    for (const auto &phases_phase : phases) {
+      out << phases_phase;
+    }
+    out << YAML::EndSeq;
+
+    // label is going to be used to name RegionImpl files within the bundle
+    out << YAML::Key << "label" << YAML::Value << getLabel(regionIndex);
+    out << YAML::EndMap;
+  }
+  out << YAML::EndSeq; // end of regions
+
+  out << YAML::Key << "Links" << YAML::Value << YAML::BeginSeq;
+
+  for (size_t regionIndex = 0; regionIndex < regions_.getCount();
+       regionIndex++) {
+    Region *r = regions_.getByIndex(regionIndex).second;
+    const std::map<const std::string, Input *> inputs = r->getInputs();
+    for (const auto &inputs_input : inputs) {
+      const std::vector<Link *> &links = inputs_input.second->getLinks();
+      for (const auto &links_link : links) {
+        Link &l = *(links_link);
+        out << YAML::BeginMap;
+        out << YAML::Key << "type" << YAML::Value << l.getLinkType();
+        out << YAML::Key << "params" << YAML::Value << l.getLinkParams();
+        out << YAML::Key << "srcRegion" << YAML::Value
+            << l.getSrcRegionName();
+        out << YAML::Key << "srcOutput" << YAML::Value
+            << l.getSrcOutputName();
+        out << YAML::Key << "destRegion" << YAML::Value
+            << l.getDestRegionName();
+        out << YAML::Key << "destInput" << YAML::Value
+            << l.getDestInputName();
+        out << YAML::EndMap;
+      }
+    }
+  }
+  out << YAML::EndSeq; // end of links
+
+  out << YAML::EndMap; // end of network
+
+  f << out.c_str();
+}
+
 void Network::load(const std::string &path) {
   if (StringUtils::endsWith(path, ".tgz")) {
     NTA_THROW << "Gzipped tar archives (" << path << ") not yet supported";
   } else if (StringUtils::endsWith(path, ".nta")) {
     loadFromBundle(path);
+  } else if (StringUtils::endsWith(path, ".ntz")) {
+    loadFromArchive(path);
   } else {
-    NTA_THROW << "Network::save -- unknown file extension for '" << path
-              << "'. Supported extensions are  .tgz and .nta";
+    NTA_THROW << "Network::load -- unknown file extension for '" << path
+              << "'. Supported extensions are .nta and .ntz";
   }
 }
 
@@ -746,12 +842,45 @@ void Network::loadFromBundle(const std::string &name) {
 
   std::string networkStructureFilename = Path::join(fullPath, "network.yaml");
   std::ifstream f(networkStructureFilename.c_str());
+  loadStructure_(f, networkStructureFilename,
+                 [&](const std::string &regionName,
+                     const std::string &nodeType, const Dimensions &dimensions,
+                     const std::string &label) {
+                   return addRegionFromBundle(regionName, nodeType,
+                                              dimensions, fullPath, label);
+                 });
+}
+
+void Network::loadFromArchive(const std::string &name) {
+  if (!StringUtils::endsWith(name, ".ntz"))
+    NTA_THROW << "loadFromArchive: bundle extension must be \".ntz\"";
+
+  std::string fullPath = Path::normalize(Path::makeAbsolute(name));
+
+  if (!Path::exists(fullPath))
+    NTA_THROW << "Path " << fullPath << " does not exist";
+
+  BundleArchiveReader archive(fullPath);
+  std::istringstream f(archive.readEntry("network.yaml"));
+  ScratchDir_ scratch(fullPath);
+  loadStructure_(f, fullPath,
+                 [&](const std::string &regionName,
+                     const std::string &nodeType, const Dimensions &dimensions,
+                     const std::string &label) {
+                   BundleIO bundle(archive, label, regionName, scratch.path);
+                   return addRegionFromBundle_(regionName, nodeType,
+                                               dimensions, bundle);
+                 });
+}
+
+void Network::loadStructure_(std::istream &f, const std::string &source,
+                             const RegionLoader &loadRegion) {
   YAML::Parser parser(f);
   YAML::Node doc;
   bool success = parser.GetNextDocument(doc);
   if (!success)
     NTA_THROW << "Unable to find YAML document in network structure file "
-              << networkStructureFilename;
+              << source;
 
   if (doc.Type() != YAML::NodeType::Map)
     NTA_THROW << "Invalid network structure file -- does not contain a map";
@@ -845,8 +974,7 @@ void Network::loadFromBundle(const std::string &name) {
     std::string label;
     *node >> label;
 
-    Region *r =
-        addRegionFromBundle(name, nodeType, dimensions, fullPath, label);
+    Region *r = loadRegion(name, nodeType, dimensions, label);
     setPhases_(r, phases);
   }
 
@@ -1029,20 +1157,53 @@ void Network::read(NetworkProto::Reader &proto) {
 }
 
 void Network::enableProfiling() {
+  profilingEnabled_ = true;
   for (size_t i = 0; i < regions_.getCount(); i++)
     regions_.getByIndex(i).second->enableProfiling();
 }
 
 void Network::disableProfiling() {
+  profilingEnabled_ = false;
   for (size_t i = 0; i < regions_.getCount(); i++)
     regions_.getByIndex(i).second->disableProfiling();
 }
 
 void Network::resetProfiling() {
+  profile_ = NetworkProfile();
   for (size_t i = 0; i < regions_.getCount(); i++)
     regions_.getByIndex(i).second->resetProfiling();
 }
 
+NetworkProfile Network::getProfile() const {
+  NetworkProfile profile = profile_;
+  for (size_t i = 0; i < regions_.getCount(); i++) {
+    const auto &region = regions_.getByIndex(i);
+    profile.regions[region.first] = region.second->getCounters();
+    for (const auto &input : region.second->getInputs())
+      for (const auto link : input.second->getLinks())
+        profile.links[link->getMoniker()] = link->getCounters();
+  }
+  OS::getProcessMemoryUsage(profile.realMemory, profile.virtualMemory);
+  return profile;
+}
+
+std::string Network::getProfileJSON() const { return getProfile().toJSON(); }
+
+void Network::enableLatencyHistograms(bool enable) {
+  profiler_.enableHistograms(enable);
+}
+
+void Network::startTrace(size_t maxEvents) { profiler_.startTrace(maxEvents); }
+
+void Network::stopTrace() { profiler_.stopTrace(); }
+
+void Network::writeTrace(const std::string &path) const {
+  OFStream out(path.c_str());
+  NTA_CHECK(out.is_open()) << "Network::writeTrace -- unable to open " << path;
+  profiler_.writeTrace(out);
+  out.close();
+}
+
 void Network::registerPyRegion(const std::string module,
                                const std::string className) {
   Region::registerPyRegion(module, className);
@@ -27,12 +27,14 @@
 #ifndef NTA_NETWORK_HPP
 #define NTA_NETWORK_HPP
 
+#include <functional>
 #include <iostream>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include <nupic/engine/Profiler.hpp>
 #include <nupic/ntypes/Collection.hpp>
 
 #include <nupic/proto/NetworkProto.capnp.h>
@@ -43,6 +45,7 @@
 namespace nupic {
 
 class Region;
+class BundleIO;
 class Dimensions;
 class GenericRegisteredRegionImpl;
 class Link;
@@ -71,8 +74,8 @@ public:
    * Create a Network by loading previously saved bundle,
    * and register it to NuPIC.
    *
-   * @param path The path to the previously saved bundle file, currently only
-   * support files with `.nta` extension.
+   * @param path The path to the previously saved bundle, a `.nta` directory
+   * or a compressed `.ntz` file.
    *
    * @note Creating a Network will auto-initialize NuPIC.
    */
@@ -110,7 +113,12 @@ public:
    */
 
   /**
-   * Save the network to a network bundle (extension `.nta`).
+   * Save the network to a network bundle.
+   *
+   * A `.nta` bundle is a directory with one file per stream of each region.
+   * A `.ntz` bundle is a single compressed file, whose regions are
+   * compressed in parallel and can be read back individually, see
+   * BundleArchive.hpp.
    *
    * @param name
    *        Name of the bundle
@@ -363,7 +371,8 @@ public:
    */
 
   /**
-   * Start profiling for all regions of this network.
+   * Start profiling for all regions of this network, their input links,
+   * and the callbacks and link shifts of run().
    */
   void enableProfiling();
 
@@ -373,10 +382,41 @@ public:
   void disableProfiling();
 
   /**
-   * Reset profiling timers for all regions of this network.
+   * Reset profiling timers and counters for all regions of this network.
    */
   void resetProfiling();
 
+  /**
+   * Get a snapshot of the performance counters of the network, its regions
+   * and its links, with the memory usage of the process.
+   */
+  NetworkProfile getProfile() const;
+
+  /**
+   * getProfile() as a JSON object, with times in ns.
+   */
+  std::string getProfileJSON() const;
+
+  /**
+   * Also keep the latencies of the profiled operations in histograms, for
+   * their percentiles. Off by default.
+   */
+  void enableLatencyHistograms(bool enable);
+
+  /**
+   * Record every profiled operation in a trace, up to maxEvents, until
+   * stopTrace(). Profiling must be enabled for anything to be recorded.
+   */
+  void startTrace(size_t maxEvents = 1000000);
+
+  void stopTrace();
+
+  /**
+   * Write the recorded trace as a Chrome trace JSON file, which
+   * chrome://tracing and https://ui.perfetto.dev display.
+   */
+  void writeTrace(const std::string &path) const;
+
   // Capnp serialization methods
   using Serializable::write;
   virtual void write(NetworkProto::Builder &proto) const override;
@@ -423,9 +463,29 @@ private:
 
   void loadFromBundle(const std::string &path);
 
-  // save() always calls this internal method, which creates
-  // a .nta bundle
+  // save() calls one of these internal methods, which create a .nta or a
+  // .ntz bundle
   void saveToBundle(const std::string &bundleName);
+  void saveToArchive(const std::string &archiveName);
+
+  void loadFromArchive(const std::string &path);
+
+  // The network.yaml file of a bundle: the regions and the links
+  void writeStructure_(std::ostream &out);
+
+  typedef std::function<Region *(
+      const std::string &name, const std::string &nodeType,
+      const Dimensions &dimensions, const std::string &label)>
+      RegionLoader;
+
+  // Creates the regions with loadRegion, then the links
+  void loadStructure_(std::istream &in, const std::string &source,
+                      const RegionLoader &loadRegion);
+
+  Region *addRegionFromBundle_(const std::string &name,
+                               const std::string &nodeType,
+                               const Dimensions &dimensions,
+                               BundleIO &bundle);
 
   // internal method using region pointer instead of name
   void setPhases_(Region *r, std::set<UInt32> &phases);
@@ -453,6 +513,11 @@ private:
 
   // number of elapsed iterations
   UInt64 iteration_;
+
+  bool profilingEnabled_;
+  Profiler profiler_;
+  // The counters of run() itself; the regions and links keep theirs
+  NetworkProfile profile_;
 };
 
 } // namespace nupic
@@ -0,0 +1,300 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the engine performance counters
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#include <nupic/engine/Profiler.hpp>
+#include <nupic/utils/Log.hpp>
+
+namespace nupic {
+
+namespace {
+
+void writeString(std::ostream &out, const std::string &s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+      out << buf;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+// Microseconds with ns precision, as the trace format expects
+void writeMicroseconds(std::ostream &out, UInt64 ns) {
+  out << ns / 1000 << '.';
+  const UInt64 frac = ns % 1000;
+  out << (char)('0' + frac / 100) << (char)('0' + frac / 10 % 10)
+      << (char)('0' + frac % 10);
+}
+
+} // namespace
+
+//----------------------------------------------------------------------
+// LatencyHistogram
+//----------------------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+void LatencyHistogram::add(UInt64 ns) {
+  size_t bucket = 0;
+  while (ns != 0 && bucket != NUM_BUCKETS - 1) {
+    ns >>= 1;
+    ++bucket;
+  }
+  ++counts_[bucket];
+}
+
+void LatencyHistogram::reset() { std::fill(counts_, counts_ + NUM_BUCKETS, 0); }
+
+UInt64 LatencyHistogram::getCount(size_t bucket) const {
+  NTA_CHECK(bucket < NUM_BUCKETS) << "Invalid histogram bucket: " << bucket;
+  return counts_[bucket];
+}
+
+UInt64 LatencyHistogram::getTotalCount() const {
+  UInt64 total = 0;
+  for (size_t i = 0; i != NUM_BUCKETS; ++i)
+    total += counts_[i];
+  return total;
+}
+
+UInt64 LatencyHistogram::getUpperBound(size_t bucket) {
+  NTA_CHECK(bucket < NUM_BUCKETS) << "Invalid histogram bucket: " << bucket;
+  return (UInt64)1 << bucket;
+}
+
+UInt64 LatencyHistogram::getPercentile(Real64 q) const {
+  NTA_CHECK(q >= 0.0 && q <= 1.0) << "Invalid quantile: " << q;
+  const UInt64 total = getTotalCount();
+  if (total == 0)
+    return 0;
+  // Rank of the quantile, from 1 to total
+  const UInt64 rank = std::max<UInt64>(1, (UInt64)(q * total + 0.5));
+  UInt64 seen = 0;
+  for (size_t i = 0; i != NUM_BUCKETS; ++i) {
+    seen += counts_[i];
+    if (seen >= rank)
+      return getUpperBound(i);
+  }
+  return getUpperBound(NUM_BUCKETS - 1);
+}
+
+//----------------------------------------------------------------------
+// Counters
+//----------------------------------------------------------------------
+
+OpCounter::OpCounter() : calls(0), totalNs(0), maxNs(0) {}
+
+void OpCounter::add(UInt64 ns, bool withHistogram) {
+  ++calls;
+  totalNs += ns;
+  maxNs = std::max(maxNs, ns);
+  if (withHistogram)
+    histogram.add(ns);
+}
+
+void OpCounter::reset() {
+  calls = totalNs = maxNs = 0;
+  histogram.reset();
+}
+
+void OpCounter::writeJSON(std::ostream &out) const {
+  out << "{\"calls\": " << calls << ", \"total_ns\": " << totalNs
+      << ", \"max_ns\": " << maxNs;
+  if (histogram.getTotalCount() != 0) {
+    out << ", \"p50_ns\": " << histogram.getPercentile(0.5)
+        << ", \"p90_ns\": " << histogram.getPercentile(0.9)
+        << ", \"p99_ns\": " << histogram.getPercentile(0.99)
+        << ", \"histogram\": [";
+    // Trailing empty buckets are left out
+    size_t n = LatencyHistogram::NUM_BUCKETS;
+    while (histogram.getCount(n - 1) == 0)
+      --n;
+    for (size_t i = 0; i != n; ++i)
+      out << (i ? ", " : "") << histogram.getCount(i);
+    out << "]";
+  }
+  out << "}";
+}
+
+void RegionCounters::reset() {
+  prepareInputs.reset();
+  compute.reset();
+  execute.reset();
+}
+
+void RegionCounters::writeJSON(std::ostream &out) const {
+  out << "{\"prepareInputs\": ";
+  prepareInputs.writeJSON(out);
+  out << ", \"compute\": ";
+  compute.writeJSON(out);
+  out << ", \"execute\": ";
+  execute.writeJSON(out);
+  out << "}";
+}
+
+LinkCounters::LinkCounters()
+    : bytesCopied(0), denseToSparse(0), sparseToDense(0), allocations(0),
+      allocatedBytes(0) {}
+
+void LinkCounters::reset() {
+  compute.reset();
+  shiftBufferedData.reset();
+  bytesCopied = denseToSparse = sparseToDense = 0;
+  allocations = allocatedBytes = 0;
+}
+
+void LinkCounters::writeJSON(std::ostream &out) const {
+  out << "{\"compute\": ";
+  compute.writeJSON(out);
+  out << ", \"shiftBufferedData\": ";
+  shiftBufferedData.writeJSON(out);
+  out << ", \"bytes_copied\": " << bytesCopied
+      << ", \"dense_to_sparse\": " << denseToSparse
+      << ", \"sparse_to_dense\": " << sparseToDense
+      << ", \"allocations\": " << allocations
+      << ", \"allocated_bytes\": " << allocatedBytes << "}";
+}
+
+NetworkProfile::NetworkProfile()
+    : iterations(0), realMemory(0), virtualMemory(0) {}
+
+std::string NetworkProfile::toJSON() const {
+  std::stringstream out;
+  out << "{\"iterations\": " << iterations << ", \"memory\": {\"real\": "
+      << realMemory << ", \"virtual\": " << virtualMemory << "}";
+  out << ", \"run\": ";
+  run.writeJSON(out);
+  out << ", \"callbacks\": ";
+  callbacks.writeJSON(out);
+  out << ", \"shiftBufferedData\": ";
+  shiftBufferedData.writeJSON(out);
+
+  out << ", \"callbackCounters\": {";
+  for (auto it = callbackCounters.begin(); it != callbackCounters.end();
+       ++it) {
+    out << (it == callbackCounters.begin() ? "" : ", ");
+    writeString(out, it->first);
+    out << ": ";
+    it->second.writeJSON(out);
+  }
+  out << "}, \"regions\": {";
+  for (auto it = regions.begin(); it != regions.end(); ++it) {
+    out << (it == regions.begin() ? "" : ", ");
+    writeString(out, it->first);
+    out << ": ";
+    it->second.writeJSON(out);
+  }
+  out << "}, \"links\": {";
+  for (auto it = links.begin(); it != links.end(); ++it) {
+    out << (it == links.begin() ? "" : ", ");
+    writeString(out, it->first);
+    out << ": ";
+    it->second.writeJSON(out);
+  }
+  out << "}}";
+  return out.str();
+}
+
+//----------------------------------------------------------------------
+// Profiler
+//----------------------------------------------------------------------
+
+Profiler::Profiler()
+    : histograms_(false), tracing_(false), maxEvents_(0), droppedEvents_(0),
+      iteration_(0) {}
+
+UInt64 Profiler::now() {
+  return (UInt64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Profiler::startTrace(size_t maxEvents) {
+  events_.clear();
+  events_.reserve(std::min<size_t>(maxEvents, 65536));
+  maxEvents_ = maxEvents;
+  droppedEvents_ = 0;
+  tracing_ = true;
+}
+
+void Profiler::stopTrace() { tracing_ = false; }
+
+void Profiler::writeTrace(std::ostream &out) const {
+  // Times are relative to the first event, which keeps them readable
+  UInt64 origin = 0;
+  if (!events_.empty())
+    origin = events_.front().startNs;
+  for (const auto &event : events_)
+    origin = std::min(origin, event.startNs);
+
+  out << "{\"traceEvents\": [\n"
+      << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+      << "\"args\": {\"name\": \"nupic\"}}";
+  for (const auto &event : events_) {
+    out << ",\n{\"name\": ";
+    writeString(out, event.name);
+    out << ", \"cat\": \"" << event.category << "\", \"ph\": \"X\", \"ts\": ";
+    writeMicroseconds(out, event.startNs - origin);
+    out << ", \"dur\": ";
+    writeMicroseconds(out, event.durationNs);
+    out << ", \"pid\": 1, \"tid\": 1, \"args\": {\"iteration\": "
+        << event.iteration << "}}";
+  }
+  out << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": "
+      << "{\"dropped_events\": " << droppedEvents_ << "}}\n";
+}
+
+void Profiler::record(Profiler *profiler, OpCounter &counter, UInt64 start,
+                      UInt64 end, const std::string &name,
+                      const char *category) {
+  const UInt64 ns = end - start;
+  if (profiler == nullptr) {
+    counter.add(ns, false);
+    return;
+  }
+  counter.add(ns, profiler->histograms_);
+  if (!profiler->tracing_)
+    return;
+  if (profiler->events_.size() == profiler->maxEvents_) {
+    ++profiler->droppedEvents_;
+    return;
+  }
+  TraceEvent event = {name, category, start, ns, profiler->iteration_};
+  profiler->events_.push_back(event);
+}
+
+} // namespace nupic
@@ -0,0 +1,251 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Performance counters of the network engine.
+ *
+ * When profiling is enabled, Network::run counts the calls and the time of
+ * every region operation, link copy, callback and delayed-link shift, as
+ * well as the bytes moved by the links. Optionally, the latencies are also
+ * kept in histograms, and every operation can be recorded as an event of a
+ * Chrome trace (chrome://tracing, https://ui.perfetto.dev).
+ */
+
+#ifndef NTA_PROFILER_HPP
+#define NTA_PROFILER_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+/**
+ * Histogram of latencies, with buckets growing in powers of two.
+ *
+ * Bucket 0 counts the latencies of 0 ns, and bucket i > 0 those in
+ * [2^(i-1), 2^i) ns. The last bucket also counts everything above.
+ */
+class LatencyHistogram {
+public:
+  static const size_t NUM_BUCKETS = 48;
+
+  LatencyHistogram();
+
+  void add(UInt64 ns);
+  void reset();
+
+  UInt64 getCount(size_t bucket) const;
+  UInt64 getTotalCount() const;
+
+  /**
+   * Exclusive upper bound of a bucket, in ns.
+   */
+  static UInt64 getUpperBound(size_t bucket);
+
+  /**
+   * Upper bound of the bucket containing the quantile q, in [0, 1], of the
+   * latencies. Returns 0 when the histogram is empty.
+   */
+  UInt64 getPercentile(Real64 q) const;
+
+private:
+  UInt64 counts_[NUM_BUCKETS];
+};
+
+/**
+ * Number of calls and time spent in one operation.
+ */
+struct OpCounter {
+  UInt64 calls;
+  UInt64 totalNs;
+  UInt64 maxNs;
+  // Only filled when the latency histograms are enabled
+  LatencyHistogram histogram;
+
+  OpCounter();
+
+  void add(UInt64 ns, bool withHistogram);
+  void reset();
+
+  void writeJSON(std::ostream &out) const;
+};
+
+/**
+ * Counters of a Region.
+ */
+struct RegionCounters {
+  OpCounter prepareInputs;
+  OpCounter compute;
+  OpCounter execute;
+
+  void reset();
+  void writeJSON(std::ostream &out) const;
+};
+
+/**
+ * Counters of a Link. Sparse/dense conversions are the copies that convert
+ * the representation of the data between the source and the destination.
+ * Allocations are the buffers allocated while running, by delayed links.
+ */
+struct LinkCounters {
+  OpCounter compute;
+  OpCounter shiftBufferedData;
+  UInt64 bytesCopied;
+  UInt64 denseToSparse;
+  UInt64 sparseToDense;
+  UInt64 allocations;
+  UInt64 allocatedBytes;
+
+  LinkCounters();
+
+  void reset();
+  void writeJSON(std::ostream &out) const;
+};
+
+/**
+ * Snapshot of the counters of a Network, returned by Network::getProfile().
+ */
+struct NetworkProfile {
+  UInt64 iterations;
+  // Whole iterations of Network::run
+  OpCounter run;
+  // All the callbacks, and each of them by name
+  OpCounter callbacks;
+  std::map<std::string, OpCounter> callbackCounters;
+  // The shift of the delayed links at the end of the iterations
+  OpCounter shiftBufferedData;
+  std::map<std::string, RegionCounters> regions;
+  // Keyed by Link::getMoniker()
+  std::map<std::string, LinkCounters> links;
+  // Memory of the process, in bytes, when the snapshot was taken
+  size_t realMemory;
+  size_t virtualMemory;
+
+  NetworkProfile();
+
+  /**
+   * The snapshot as a JSON object, with times in ns.
+   */
+  std::string toJSON() const;
+};
+
+/**
+ * One operation of a trace, in the "complete event" form of the Chrome trace
+ * event format.
+ */
+struct TraceEvent {
+  std::string name;
+  const char *category;
+  UInt64 startNs;
+  UInt64 durationNs;
+  UInt64 iteration;
+};
+
+/**
+ * Collects the latency histograms and the trace events of a Network.
+ * Counters record into it through ProfileScope.
+ */
+class Profiler {
+public:
+  Profiler();
+
+  /**
+   * Monotonic time in ns.
+   */
+  static UInt64 now();
+
+  void enableHistograms(bool enable) { histograms_ = enable; }
+  bool histogramsEnabled() const { return histograms_; }
+
+  /**
+   * Starts recording trace events, discarding the previous ones. Past
+   * maxEvents, the events are dropped and counted.
+   */
+  void startTrace(size_t maxEvents = 1000000);
+  void stopTrace();
+  bool isTracing() const { return tracing_; }
+
+  const std::vector<TraceEvent> &getTraceEvents() const { return events_; }
+  UInt64 getDroppedEvents() const { return droppedEvents_; }
+
+  /**
+   * Writes the recorded events as Chrome trace JSON.
+   */
+  void writeTrace(std::ostream &out) const;
+
+  /**
+   * The iteration attached to the next trace events.
+   */
+  void setIteration(UInt64 iteration) { iteration_ = iteration; }
+
+  /**
+   * Adds an operation of [start, end) ns to the counter, and to the trace.
+   * The profiler may be null, for regions outside of a network.
+   */
+  static void record(Profiler *profiler, OpCounter &counter, UInt64 start,
+                     UInt64 end, const std::string &name,
+                     const char *category);
+
+private:
+  bool histograms_;
+  bool tracing_;
+  size_t maxEvents_;
+  UInt64 droppedEvents_;
+  UInt64 iteration_;
+  std::vector<TraceEvent> events_;
+};
+
+/**
+ * Records the time of a scope into a counter. A null counter disables it,
+ * at the cost of a test.
+ */
+class ProfileScope {
+public:
+  ProfileScope(OpCounter *counter, Profiler *profiler,
+               const std::string &name, const char *category)
+      : counter_(counter), profiler_(profiler), name_(name),
+        category_(category), start_(counter ? Profiler::now() : 0) {}
+
+  ~ProfileScope() {
+    if (counter_)
+      Profiler::record(profiler_, *counter_, start_, Profiler::now(), name_,
+                       category_);
+  }
+
+private:
+  ProfileScope(const ProfileScope &);
+  ProfileScope &operator=(const ProfileScope &);
+
+  OpCounter *counter_;
+  Profiler *profiler_;
+  const std::string &name_;
+  const char *category_;
+  UInt64 start_;
+};
+
+} // namespace nupic
+
+#endif // NTA_PROFILER_HPP
@@ -52,7 +52,8 @@ class GenericRegisteredRegionImpl;
 Region::Region(std::string name, const std::string &nodeType,
                const std::string &nodeParams, Network *network)
     : name_(std::move(name)), type_(nodeType), initialized_(false),
-      enabledNodes_(nullptr), network_(network), profilingEnabled_(false) {
+      enabledNodes_(nullptr), network_(network), profilingEnabled_(false),
+      profiler_(nullptr) {
   // Set region info before creating the RegionImpl so that the
   // Impl has access to the region info in its constructor.
   RegionImplFactory &factory = RegionImplFactory::getInstance();
@@ -73,7 +74,8 @@ Region::Region(std::string name, const std::string &nodeType,
 Region::Region(std::string name, const std::string &nodeType,
                const Dimensions &dimensions, BundleIO &bundle, Network *network)
     : name_(std::move(name)), type_(nodeType), initialized_(false),
-      enabledNodes_(nullptr), network_(network), profilingEnabled_(false) {
+      enabledNodes_(nullptr), network_(network), profilingEnabled_(false),
+      profiler_(nullptr) {
   // Set region info before creating the RegionImpl so that the
   // Impl has access to the region info in its constructor.
   RegionImplFactory &factory = RegionImplFactory::getInstance();
@@ -98,7 +100,7 @@ Region::Region(std::string name, const std::string &nodeType,
 Region::Region(std::string name, RegionProto::Reader &proto, Network *network)
     : name_(std::move(name)), type_(proto.getNodeType().cStr()),
       initialized_(false), enabledNodes_(nullptr), network_(network),
-      profilingEnabled_(false) {
+      profilingEnabled_(false), profiler_(nullptr) {
   read(proto);
   createInputsAndOutputs_();
 }
@@ -220,7 +222,11 @@ std::string Region::executeCommand(const std::vector<std::string> &args) {
   if (profilingEnabled_)
     executeTimer_.start();
 
-  retVal = impl_->executeCommand(args, (UInt64)(-1));
+  {
+    ProfileScope scope(profilingEnabled_ ? &counters_.execute : nullptr,
+                       profiler_, name_, "execute");
+    retVal = impl_->executeCommand(args, (UInt64)(-1));
+  }
 
   if (profilingEnabled_)
     executeTimer_.stop();
@@ -236,7 +242,11 @@ void Region::compute() {
   if (profilingEnabled_)
     computeTimer_.start();
 
-  impl_->compute();
+  {
+    ProfileScope scope(profilingEnabled_ ? &counters_.compute : nullptr,
+                       profiler_, name_, "compute");
+    impl_->compute();
+  }
 
   if (profilingEnabled_)
     computeTimer_.stop();
@@ -428,12 +438,20 @@ void Region::disableProfiling() { profilingEnabled_ = false; }
 void Region::resetProfiling() {
   computeTimer_.reset();
   executeTimer_.reset();
+  counters_.reset();
+  for (const auto &input : inputs_)
+    for (auto link : input.second->getLinks())
+      link->resetCounters();
 }
 
 const Timer &Region::getComputeTimer() const { return computeTimer_; }
 
 const Timer &Region::getExecuteTimer() const { return executeTimer_; }
 
+const RegionCounters &Region::getCounters() const { return counters_; }
+
+void Region::setProfiler(Profiler *profiler) { profiler_ = profiler; }
+
 bool Region::operator==(const Region &o) const {
 
   if (name_ != o.name_ || type_ != o.type_ || dims_ != o.dims_ ||
@@ -37,6 +37,7 @@
 
 // We need the full definitions because these
 // objects are returned by value.
+#include <nupic/engine/Profiler.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
 #include <nupic/os/Timer.hpp>
 #include <nupic/proto/RegionProto.capnp.h>
@@ -442,6 +443,72 @@ public:
    */
   bool isParameterShared(const std::string &name) const;
 
+#ifndef SWIG
+  /**
+   * Handle to a single scalar parameter, resolved once by getParameterRef().
+   *
+   * Looking a parameter up by name on every call costs a string comparison
+   * chain in the RegionImpl. A ParameterRef does the lookup and the type
+   * and access checks once; when the RegionImpl exposes the parameter's
+   * storage (see RegionImpl::getParameterAddress) get() and set() are
+   * plain loads and stores, otherwise they forward to the name-based
+   * getParameter* / setParameter* methods.
+   *
+   * A ParameterRef is valid for the lifetime of its region.
+   */
+  class ParameterRef {
+  public:
+    ParameterRef();
+
+    const std::string &getName() const { return name_; }
+
+    NTA_BasicType getType() const { return type_; }
+
+    /**
+     * Whether set() is allowed: the parameter has ReadWriteAccess.
+     */
+    bool isWritable() const { return writable_; }
+
+    /**
+     * Whether get/set bypass the RegionImpl's name-based methods.
+     */
+    bool isDirect() const { return address_ != nullptr; }
+
+    /**
+     * Get the value. T must match the parameter's data type exactly.
+     * Instantiated for Int32, UInt32, Int64, UInt64, Real32, Real64, bool.
+     */
+    template <typename T> T get() const;
+
+    /**
+     * Set the value. T must match the parameter's data type exactly and
+     * the parameter must not be read-only.
+     */
+    template <typename T> void set(const T &value);
+
+  private:
+    friend class Region;
+
+    RegionImpl *impl_;
+    std::string name_;
+    NTA_BasicType type_;
+    bool writable_;
+    void *address_;
+  };
+
+  /**
+   * Resolve a scalar parameter for repeated access.
+   *
+   * @param name
+   *        The name of the parameter, as listed in the region's Spec
+   *
+   * @returns A handle to the parameter
+   *
+   * Throws if the Spec has no such parameter or it is not a scalar.
+   */
+  ParameterRef getParameterRef(const std::string &name) const;
+#endif // SWIG
+
   /**
    * @}
    *
@@ -579,20 +646,30 @@ public:
    */
 
   /**
-   * Enable profiling of the compute and execute operations
+   * Enable profiling of the compute, execute and prepareInputs operations,
+   * and of the links into this region
    */
   void enableProfiling();
 
   /**
-   * Disable profiling of the compute and execute operations
+   * Disable profiling of the compute, execute and prepareInputs operations
    */
   void disableProfiling();
 
   /**
-   * Reset the compute and execute timers
+   * Reset the compute and execute timers, and the counters of the region
+   * and of its input links
    */
   void resetProfiling();
 
+  /**
+   * Get the performance counters of the region.
+   *
+   * @returns
+   *        The calls and the time of prepareInputs, compute and execute
+   */
+  const RegionCounters &getCounters() const;
+
   /**
    * Get the timer used to profile the compute operation.
    *
@@ -640,7 +717,9 @@ public:
 
   bool isInitialized() const;
 
-  // Used by RegionImpl to get inputs/outputs
+  // Used by RegionImpl to get inputs/outputs. The returned pointers stay
+  // valid for the lifetime of the region, so callers on a hot path may
+  // resolve them once and keep them.
   Output *getOutput(const std::string &name) const;
 
   Input *getInput(const std::string &name) const;
@@ -691,6 +770,15 @@ public:
   // Called by Network for serialization
   void serializeImpl(BundleIO &bundle);
 
+  // The profiler of the containing network, which keeps the histograms and
+  // the trace of the region and of its input links. May be null.
+  void setProfiler(Profiler *profiler);
+
+  Profiler *getProfiler() const { return profiler_; }
+
+  // Used by the input links, which profile along with their region
+  bool isProfilingEnabled() const { return profilingEnabled_; }
+
   using Serializable::write;
   void write(RegionProto::Builder &proto) const;
 
@@ -745,6 +833,8 @@ private:
   bool profilingEnabled_;
   Timer computeTimer_;
   Timer executeTimer_;
+  RegionCounters counters_;
+  Profiler *profiler_;
 };
 
 } // namespace nupic
@@ -236,6 +236,10 @@ bool RegionImpl::isParameterShared(const std::string &name) {
             << getType();
 }
 
+void *RegionImpl::getParameterAddress(const std::string &name) {
+  return nullptr;
+}
+
 void RegionImpl::getParameterFromBuffer(const std::string &name, Int64 index,
                                         IWriteBuffer &value) {
   NTA_THROW
@@ -196,6 +196,20 @@ public:
    */
   virtual bool isParameterShared(const std::string &name);
 
+  /**
+   * Address of the storage of a region-level scalar parameter, used by
+   * Region::ParameterRef to read and write it directly, without going
+   * through the name-based getParameter* / setParameter* methods.
+   *
+   * The storage must have the C++ type of the parameter's data type in the
+   * Spec, and stay valid for the lifetime of the RegionImpl. Only return
+   * an address for parameters whose get/set have no side effects.
+   *
+   * Default implementation returns nullptr: all parameters go through
+   * the name-based methods.
+   */
+  virtual void *getParameterAddress(const std::string &name);
+
 protected:
   Region *region_;
 
@@ -101,6 +101,8 @@ ArrayRef Region::getInputData(const std::string &inputName) const {
 }
 
 void Region::prepareInputs() {
+  ProfileScope scope(profilingEnabled_ ? &counters_.prepareInputs : nullptr,
+                     profiler_, name_, "prepareInputs");
   // Ask each input to prepare itself
   for (InputMap::const_iterator i = inputs_.begin(); i != inputs_.end(); i++) {
     i->second->prepare();
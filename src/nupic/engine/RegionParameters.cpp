@@ -28,6 +28,7 @@
 #include <nupic/engine/RegionImpl.hpp>
 #include <nupic/engine/Spec.hpp>
 #include <nupic/ntypes/Array.hpp>
+#include <nupic/types/BasicType.hpp>
 #include <nupic/types/Types.h>
 #include <nupic/utils/Log.hpp>
 
@@ -139,4 +140,89 @@ bool Region::isParameterShared(const std::string &name) const {
   return impl_->isParameterShared(name);
 }
 
+// ParameterRef
+
+Region::ParameterRef::ParameterRef()
+    : impl_(nullptr), type_(NTA_BasicType_Last), writable_(false),
+      address_(nullptr) {}
+
+Region::ParameterRef Region::getParameterRef(const std::string &name) const {
+  if (!spec_->parameters.contains(name))
+    NTA_THROW << "getParameterRef: region " << name_ << " has no parameter "
+              << name;
+  const ParameterSpec &p = spec_->parameters.getByName(name);
+  if (p.count != 1)
+    NTA_THROW << "getParameterRef: parameter " << name << " of region "
+              << name_ << " is not a scalar";
+
+  ParameterRef ref;
+  ref.impl_ = impl_;
+  ref.name_ = name;
+  ref.type_ = p.dataType;
+  ref.writable_ = p.accessMode == ParameterSpec::ReadWriteAccess;
+  ref.address_ = impl_->getParameterAddress(name);
+  return ref;
+}
+
+// Name-based fallbacks used by ParameterRef when the RegionImpl does not
+// expose the parameter's storage. Overloaded on the value type so that the
+// template methods below can dispatch without a switch.
+
+#define parameterRefAccessorsT(MethodT, Type)                                  \
+  static inline void getByName(RegionImpl *impl, const std::string &name,      \
+                               Type &value) {                                  \
+    value = impl->getParameter##MethodT(name, (Int64)-1);                      \
+  }                                                                            \
+  static inline void setByName(RegionImpl *impl, const std::string &name,      \
+                               const Type &value) {                            \
+    impl->setParameter##MethodT(name, (Int64)-1, value);                       \
+  }
+
+parameterRefAccessorsT(Int32, Int32);
+parameterRefAccessorsT(UInt32, UInt32);
+parameterRefAccessorsT(Int64, Int64);
+parameterRefAccessorsT(UInt64, UInt64);
+parameterRefAccessorsT(Real32, Real32);
+parameterRefAccessorsT(Real64, Real64);
+parameterRefAccessorsT(Bool, bool);
+
+template <typename T> T Region::ParameterRef::get() const {
+  NTA_CHECK(impl_ != nullptr) << "ParameterRef is not bound to a region";
+  if (BasicType::getType<T>() != type_)
+    NTA_THROW << "ParameterRef::get: parameter " << name_ << " is of type "
+              << BasicType::getName(type_) << " not "
+              << BasicType::getName<T>();
+  if (address_ != nullptr)
+    return *static_cast<const T *>(address_);
+  T value;
+  getByName(impl_, name_, value);
+  return value;
+}
+
+template <typename T> void Region::ParameterRef::set(const T &value) {
+  NTA_CHECK(impl_ != nullptr) << "ParameterRef is not bound to a region";
+  if (BasicType::getType<T>() != type_)
+    NTA_THROW << "ParameterRef::set: parameter " << name_ << " is of type "
+              << BasicType::getName(type_) << " not "
+              << BasicType::getName<T>();
+  if (!writable_)
+    NTA_THROW << "ParameterRef::set: parameter " << name_ << " is read-only";
+  if (address_ != nullptr)
+    *static_cast<T *>(address_) = value;
+  else
+    setByName(impl_, name_, value);
+}
+
+#define instantiateParameterRefT(Type)                                         \
+  template Type Region::ParameterRef::get<Type>() const;                       \
+  template void Region::ParameterRef::set<Type>(const Type &value);
+
+instantiateParameterRefT(Int32);
+instantiateParameterRefT(UInt32);
+instantiateParameterRefT(Int64);
+instantiateParameterRefT(UInt64);
+instantiateParameterRefT(Real32);
+instantiateParameterRefT(Real64);
+instantiateParameterRefT(bool);
+
 } // namespace nupic
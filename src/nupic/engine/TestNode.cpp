@@ -496,6 +496,25 @@ bool TestNode::isParameterShared(const std::string &name) {
   }
 }
 
+void *TestNode::getParameterAddress(const std::string &name) {
+  if (name == "int32Param") {
+    return &int32Param_;
+  } else if (name == "uint32Param") {
+    return &uint32Param_;
+  } else if (name == "int64Param") {
+    return &int64Param_;
+  } else if (name == "uint64Param") {
+    return &uint64Param_;
+  } else if (name == "real32Param") {
+    return &real32Param_;
+  } else if (name == "real64Param") {
+    return &real64Param_;
+  } else if (name == "boolParam") {
+    return &boolParam_;
+  }
+  return nullptr;
+}
+
 template <typename T>
 static void arrayOut(std::ostream &s, const std::vector<T> &array,
                      const std::string &name) {
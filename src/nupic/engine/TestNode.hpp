@@ -110,6 +110,8 @@ public:
 
   bool isParameterShared(const std::string &name) override;
 
+  void *getParameterAddress(const std::string &name) override;
+
 private:
   TestNode();
 
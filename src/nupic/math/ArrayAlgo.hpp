@@ -39,6 +39,7 @@
 #endif
 
 #include <nupic/math/Math.hpp>
+#include <nupic/math/Simd.hpp>
 #include <nupic/math/Types.hpp>
 #include <nupic/utils/Random.hpp> // For the official Numenta RNG
 
@@ -4883,6 +4884,277 @@ inline size_t sparseAnd(size_t n, const std::vector<U> &x1,
                    out.end());
 }
 
+//--------------------------------------------------------------------------------
+// PACKED BINARY VECTORS
+//--------------------------------------------------------------------------------
+/**
+ * Kernels on binary vectors (SDRs) packed 64 bits per word, bit i being
+ * bit i % 64 of word i / 64. They count the bits of a, a & b, a | b or
+ * a ^ b over n words. The kernels of nupic/math/Simd.hpp count them with
+ * the popcnt instruction on CPUs with SSE4.2, and with AVX2 or AVX-512,
+ * 4 or 8 words at a time with the nibble lookup table method (vpshufb),
+ * accumulated with vpsadbw.
+ */
+inline UInt popcount64(UInt64 w) {
+#if defined(__GNUC__)
+  return (UInt)__builtin_popcountll(w);
+#else
+  w = w - ((w >> 1) & 0x5555555555555555ULL);
+  w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (UInt)((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * Index of the lowest bit set in w, which must not be 0.
+ */
+inline UInt lowest_bit64(UInt64 w) {
+#if defined(__GNUC__)
+  return (UInt)__builtin_ctzll(w);
+#else
+  UInt i = 0;
+  for (; !(w & 1); w >>= 1)
+    ++i;
+  return i;
+#endif
+}
+
+/**
+ * Number of bits set in the n words at a.
+ */
+inline size_t packed_count(const UInt64 *a, size_t n) {
+  if (const auto f = simd::kernels().packedCount)
+    return f(a, n);
+  size_t count = 0;
+  for (size_t i = 0; i != n; ++i)
+    count += popcount64(a[i]);
+  return count;
+}
+
+/**
+ * Number of bits set in both a and b (size of the intersection).
+ */
+inline size_t packed_overlap(const UInt64 *a, const UInt64 *b, size_t n) {
+  if (const auto f = simd::kernels().packedOverlap)
+    return f(a, b, n);
+  size_t count = 0;
+  for (size_t i = 0; i != n; ++i)
+    count += popcount64(a[i] & b[i]);
+  return count;
+}
+
+/**
+ * Number of bits set in a or b (size of the union).
+ */
+inline size_t packed_union_count(const UInt64 *a, const UInt64 *b,
+                                 size_t n) {
+  if (const auto f = simd::kernels().packedUnionCount)
+    return f(a, b, n);
+  size_t count = 0;
+  for (size_t i = 0; i != n; ++i)
+    count += popcount64(a[i] | b[i]);
+  return count;
+}
+
+/**
+ * Number of bits that differ between a and b.
+ */
+inline size_t packed_hamming_distance(const UInt64 *a, const UInt64 *b,
+                                      size_t n) {
+  if (const auto f = simd::kernels().packedXorCount)
+    return f(a, b, n);
+  size_t count = 0;
+  for (size_t i = 0; i != n; ++i)
+    count += popcount64(a[i] ^ b[i]);
+  return count;
+}
+
+/**
+ * out = a & b, over n words. out can be a or b.
+ */
+inline void packed_and(const UInt64 *a, const UInt64 *b, UInt64 *out,
+                       size_t n) {
+  for (size_t i = 0; i != n; ++i)
+    out[i] = a[i] & b[i];
+}
+
+/**
+ * out = a | b, over n words. out can be a or b.
+ */
+inline void packed_or(const UInt64 *a, const UInt64 *b, UInt64 *out,
+                      size_t n) {
+  for (size_t i = 0; i != n; ++i)
+    out[i] = a[i] | b[i];
+}
+
+//--------------------------------------------------------------------------------
+/**
+ * A binary vector of size() bits, such as an SDR, stored as packed words
+ * for the packed_* kernels. The bits past size() in the last word are
+ * always 0. Converts to and from lists of indices of the bits set, which
+ * is how most of the algorithms represent SDRs.
+ *
+ * On 2048-bit SDRs, overlap() and unionCount() process 32 words, instead
+ * of merging two index lists.
+ */
+class PackedSDR {
+public:
+  typedef UInt64 word_type;
+
+  PackedSDR() : size_(0) {}
+
+  explicit PackedSDR(UInt size) : size_(size), words_(nWords_(size), 0) {}
+
+  /**
+   * The SDR of size bits with the bits at the indices in [begin, end) set.
+   */
+  template <typename InputIterator>
+  PackedSDR(UInt size, InputIterator begin, InputIterator end)
+      : size_(size), words_(nWords_(size), 0) {
+    setIndices(begin, end);
+  }
+
+  inline UInt size() const { return size_; }
+  inline UInt nWords() const { return (UInt)words_.size(); }
+  inline const word_type *words() const { return words_.data(); }
+
+  /**
+   * Changes the number of bits, keeping the bits below the new size.
+   */
+  inline void resize(UInt size) {
+    words_.resize(nWords_(size), 0);
+    size_ = size;
+    if (size_ % 64)
+      words_.back() &= ((word_type)1 << (size_ % 64)) - 1;
+  }
+
+  /**
+   * Resets all the bits.
+   */
+  inline void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+  inline bool test(UInt i) const {
+    NTA_ASSERT(i < size_) << "PackedSDR::test: Invalid bit: " << i;
+    return (words_[i / 64] >> (i % 64)) & 1;
+  }
+
+  inline void set(UInt i) {
+    NTA_ASSERT(i < size_) << "PackedSDR::set: Invalid bit: " << i;
+    words_[i / 64] |= (word_type)1 << (i % 64);
+  }
+
+  inline void reset(UInt i) {
+    NTA_ASSERT(i < size_) << "PackedSDR::reset: Invalid bit: " << i;
+    words_[i / 64] &= ~((word_type)1 << (i % 64));
+  }
+
+  /**
+   * Sets exactly the bits at the indices in [begin, end), in any order.
+   */
+  template <typename InputIterator>
+  inline void setIndices(InputIterator begin, InputIterator end) {
+    clear();
+    for (; begin != end; ++begin)
+      set((UInt)*begin);
+  }
+
+  /**
+   * Writes the indices of the bits set to out, in increasing order, and
+   * returns the end of the output.
+   */
+  template <typename OutputIterator>
+  inline OutputIterator getIndices(OutputIterator out) const {
+    for (UInt k = 0; k != nWords(); ++k)
+      for (word_type w = words_[k]; w; w &= w - 1, ++out)
+        *out = k * 64 + lowest_bit64(w);
+    return out;
+  }
+
+  inline std::vector<UInt> getIndices() const {
+    std::vector<UInt> indices(count());
+    getIndices(indices.begin());
+    return indices;
+  }
+
+  /**
+   * Sets exactly the k bits with the highest scores, among the size()
+   * scores at the random access iterator scores, ties going to the lower
+   * index.
+   */
+  template <typename InputIterator>
+  inline void setTopK(UInt k, InputIterator scores) {
+    NTA_ASSERT(k <= size_) << "PackedSDR::setTopK: Invalid k: " << k;
+    static thread_local std::vector<UInt> order;
+    order.resize(size_);
+    for (UInt i = 0; i != size_; ++i)
+      order[i] = i;
+    std::nth_element(order.begin(), order.begin() + k, order.end(),
+                     [&](UInt a, UInt b) {
+                       return scores[a] > scores[b] ||
+                              (!(scores[b] > scores[a]) && a < b);
+                     });
+    setIndices(order.begin(), order.begin() + k);
+  }
+
+  inline UInt count() const { return (UInt)packed_count(words(), nWords()); }
+
+  /**
+   * Number of bits set in both SDRs, which must have the same size.
+   */
+  inline UInt overlap(const PackedSDR &o) const {
+    assert_same_size_(o, "overlap");
+    return (UInt)packed_overlap(words(), o.words(), nWords());
+  }
+
+  /**
+   * Number of bits set in either SDR.
+   */
+  inline UInt unionCount(const PackedSDR &o) const {
+    assert_same_size_(o, "unionCount");
+    return (UInt)packed_union_count(words(), o.words(), nWords());
+  }
+
+  inline UInt hammingDistance(const PackedSDR &o) const {
+    assert_same_size_(o, "hammingDistance");
+    return (UInt)packed_hamming_distance(words(), o.words(), nWords());
+  }
+
+  inline PackedSDR &operator&=(const PackedSDR &o) {
+    assert_same_size_(o, "operator&=");
+    packed_and(words(), o.words(), words_.data(), nWords());
+    return *this;
+  }
+
+  inline PackedSDR &operator|=(const PackedSDR &o) {
+    assert_same_size_(o, "operator|=");
+    packed_or(words(), o.words(), words_.data(), nWords());
+    return *this;
+  }
+
+  inline bool operator==(const PackedSDR &o) const {
+    return size_ == o.size_ && words_ == o.words_;
+  }
+
+  inline bool operator!=(const PackedSDR &o) const { return !(*this == o); }
+
+private:
+  static inline UInt nWords_(UInt size) { return (size + 63) / 64; }
+
+  inline void assert_same_size_(const PackedSDR &o, const char *where) const {
+    NTA_ASSERT(size_ == o.size_)
+        << "PackedSDR::" << where << ": Mismatched sizes: " << size_
+        << " and " << o.size_;
+  }
+
+  UInt size_;
+  std::vector<word_type> words_;
+};
+
+inline PackedSDR operator&(PackedSDR a, const PackedSDR &b) { return a &= b; }
+
+inline PackedSDR operator|(PackedSDR a, const PackedSDR &b) { return a |= b; }
+
 //--------------------------------------------------------------------------------
 // SORTING
 //--------------------------------------------------------------------------------
@@ -5041,9 +5313,10 @@ inline void partial_argsort(I0 k, SparseVector<I, T> &x, int direction = -1) {
 
 //--------------------------------------------------------------------------------
 // Static buffer for partial_argsort, so that we don't have to allocate
-// memory each time (faster).
+// memory each time (faster). One per thread, so that partial_argsort can be
+// called concurrently.
 //--------------------------------------------------------------------------------
-static SparseVector<size_t, float> partial_argsort_buffer;
+static thread_local SparseVector<size_t, float> partial_argsort_buffer;
 
 //--------------------------------------------------------------------------------
 // A partial argsort that can use an already allocated buffer to avoid creating
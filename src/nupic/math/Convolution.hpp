@@ -27,9 +27,45 @@
 #ifndef NTA_CONVOLUTION_HPP
 #define NTA_CONVOLUTION_HPP
 
+#include <cstddef>
+#include <cstring>
+
+#include <nupic/math/Workspace.hpp>
+
+#ifndef SWIG
+#include <nupic/math/Simd.hpp>
+
+namespace convolution_detail {
+
+/**
+ * y[j] += a * x[j], for 0 <= j < n. Each element sees exactly one
+ * multiply and one add, so the vector and scalar paths round identically.
+ */
+template <typename T>
+inline void axpy(T a, const T *x, T *y, size_t n) {
+  for (size_t j = 0; j != n; ++j)
+    y[j] += a * x[j];
+}
+
+// Runs the kernel of the instruction set selected at runtime, see Simd.hpp
+inline void axpy(float a, const float *x, float *y, size_t n) {
+  if (const auto f = nupic::simd::kernels().axpy)
+    return f(a, x, y, n);
+  for (size_t j = 0; j != n; ++j)
+    y[j] += a * x[j];
+}
+
+} // namespace convolution_detail
+#endif // SWIG
+
 //--------------------------------------------------------------------------------
 /**
  * Computes convolutions in 2D, for separable kernels.
+ *
+ * Both passes are written as a sequence of "scaled row additions" (one per
+ * filter tap) so that the inner loops run over contiguous memory and
+ * vectorize. The intermediate result of the horizontal pass lives in a
+ * Workspace, which can be shared between the instances of a pipeline.
  */
 template <typename T> struct SeparableConvolution2D {
   typedef size_t size_type;
@@ -49,75 +85,132 @@ template <typename T> struct SeparableConvolution2D {
   T *f1_end_;
   T *f2_end_;
 
+  // Result of the last horizontal pass, in the current workspace.
   T *buffer_;
 
   /**
    * nrows is the number of rows in the original image, and ncols
    * is the number of columns.
+   *
+   * If workspace is not NULL, the scratch memory is taken from it instead
+   * of from a buffer owned by this instance. The workspace must outlive
+   * this instance.
    */
   inline void init(size_type nrows, size_type ncols, size_type f1_size,
-                   size_type f2_size, T *f1, T *f2)
-  /*
-    : nrows_(nrows), ncols_(ncols),
-      f1_size_(f1_size), f2_size_(f2_size),
-      f1_end_j_(ncols - f1_size + 1), f2_end_i_(nrows - f2_size + 1),
-      f1_middle_(f1_size/2), f2_middle_(f2_size/2),
-      f1_(f1), f2_(f2), f1_end_(f1 + f1_size), f2_end_(f2 + f2_size),
-      buffer_(new T[nrows*ncols])
-  */
-  {
+                   size_type f2_size, T *f1, T *f2,
+                   Workspace<T> *workspace = NULL) {
     nrows_ = nrows;
     ncols_ = ncols;
     f1_size_ = f1_size;
     f2_size_ = f2_size;
-    f1_end_j_ = ncols - f1_size + 1;
-    f2_end_i_ = nrows - f2_size + 1;
+    // A filter larger than the image has no valid position.
+    f1_end_j_ = f1_size <= ncols ? ncols - f1_size + 1 : 0;
+    f2_end_i_ = f2_size <= nrows ? nrows - f2_size + 1 : 0;
     f1_middle_ = f1_size / 2;
     f2_middle_ = f2_size / 2;
     f1_ = f1;
     f2_ = f2;
     f1_end_ = f1 + f1_size;
     f2_end_ = f2 + f2_size;
-    buffer_ = new T[nrows * ncols];
+    workspace_ = workspace;
+    buffer_ = scratch_(nrows * ncols);
   }
 
-  inline SeparableConvolution2D() : buffer_(NULL) {}
-
-  inline ~SeparableConvolution2D() {
-    delete[] buffer_;
-    buffer_ = NULL;
-  }
+  inline SeparableConvolution2D() : buffer_(NULL), workspace_(NULL) {}
 
   /**
    * Computes the convolution of an image in data with the two 1D
    * filters f1 and f2, and puts the result in convolved.
    *
-   * Down-sampling?
+   * Only the pixels for which both filters fit inside the image are
+   * written; the f2_middle_ first and last rows of convolved are left
+   * untouched, and the f1_middle_ first and last columns are set to 0.
    */
   inline void compute(T *data, T *convolved, bool rotated45 = false) {
+    buffer_ = scratch_(nrows_ * ncols_);
+
     for (size_type i = 0; i != nrows_; ++i) {
-      T *b = buffer_ + i * ncols_ + f1_middle_, *d_row = data + i * ncols_;
-      for (size_type j = 0; j != f1_end_j_; ++j) {
-        register T dot = 0, *f = f1_, *d = d_row + j;
-        while (f != f1_end_)
-          dot += *f++ * *d++;
-        *b++ = dot;
-      }
+      T *b = buffer_ + i * ncols_;
+      const T *d = data + i * ncols_;
+      memset(b, 0, ncols_ * sizeof(T));
+      for (size_type k = 0; k != f1_size_; ++k)
+        convolution_detail::axpy(f1_[k], d + k, b + f1_middle_, f1_end_j_);
     }
 
     for (size_type i = 0; i != f2_end_i_; ++i) {
-      T *c = convolved + (i + f2_middle_) * ncols_,
-        *b_row = buffer_ + i * ncols_;
-      for (size_type j = 0; j != ncols_; ++j) {
-        register T dot = 0, *f = f2_, *b = b_row + j;
-        while (f != f2_end_) {
-          dot += *f++ * *b;
-          b += ncols_;
-        }
-        *c++ = dot;
+      T *c = convolved + (i + f2_middle_) * ncols_;
+      memset(c, 0, ncols_ * sizeof(T));
+      for (size_type k = 0; k != f2_size_; ++k)
+        convolution_detail::axpy(f2_[k], buffer_ + (i + k) * ncols_, c,
+                                 ncols_);
+    }
+  }
+
+  /**
+   * Number of rows and columns produced by computeValid() for a given
+   * down-sampling step.
+   */
+  inline size_type validRows(size_type row_step = 1) const {
+    return (f2_end_i_ + row_step - 1) / row_step;
+  }
+
+  inline size_type validCols(size_type col_step = 1) const {
+    return (f1_end_j_ + col_step - 1) / col_step;
+  }
+
+  /**
+   * Convolves and down-samples in one pass, writing only the pixels for
+   * which both filters fit inside the image:
+   *
+   *   out[i * out_row_stride + j] =
+   *     convolved[f2_middle_ + i * row_step][f1_middle_ + j * col_step]
+   *
+   * for i < validRows(row_step) and j < validCols(col_step). Values are
+   * identical to those of compute(). out_row_stride (in elements) lets the
+   * result go straight into a sub-block of a larger image. Skipped rows and
+   * columns are never computed.
+   */
+  inline void computeValid(const T *data, T *out, size_type out_row_stride,
+                           size_type row_step = 1, size_type col_step = 1) {
+    const size_type nr = validRows(row_step), nc = validCols(col_step);
+    if (nr == 0 || nc == 0)
+      return;
+    const size_type last_row = (nr - 1) * row_step + f2_size_;
+    buffer_ = scratch_(nrows_ * ncols_);
+
+    for (size_type i = 0; i != last_row; ++i) {
+      // Rows that fall between two filter footprints are not needed.
+      if (row_step > f2_size_ && i % row_step >= f2_size_)
+        continue;
+      T *b = buffer_ + i * nc;
+      const T *d = data + i * ncols_;
+      memset(b, 0, nc * sizeof(T));
+      if (col_step == 1) {
+        for (size_type k = 0; k != f1_size_; ++k)
+          convolution_detail::axpy(f1_[k], d + k, b, nc);
+      } else {
+        for (size_type k = 0; k != f1_size_; ++k)
+          for (size_type j = 0; j != nc; ++j)
+            b[j] += f1_[k] * d[j * col_step + k];
       }
     }
+
+    for (size_type i = 0; i != nr; ++i) {
+      T *c = out + i * out_row_stride;
+      memset(c, 0, nc * sizeof(T));
+      for (size_type k = 0; k != f2_size_; ++k)
+        convolution_detail::axpy(f2_[k], buffer_ + (i * row_step + k) * nc,
+                                 c, nc);
+    }
+  }
+
+private:
+  inline T *scratch_(size_type n) {
+    return workspace_ ? workspace_->get(n) : own_workspace_.get(n);
   }
+
+  Workspace<T> *workspace_;
+  Workspace<T> own_workspace_;
 };
 
 //--------------------------------------------------------------------------------
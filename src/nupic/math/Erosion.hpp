@@ -31,11 +31,52 @@
  * Python bindings are used used in GaborNode
  */
 
+#include <algorithm>
+#include <cstddef>
+
+#include <nupic/math/Workspace.hpp>
+
+#ifndef SWIG
+#include <nupic/math/Simd.hpp>
+
+namespace erosion_detail {
+
+/**
+ * out[j] = min(a[j], b[j], c[j]) (or max if dilate), for 0 <= j < n.
+ * The vector kernels keep std::min/std::max semantics, operand order
+ * included.
+ */
+template <typename T>
+inline void extremum3(const T *a, const T *b, const T *c, T *out, size_t n,
+                      bool dilate) {
+  if (dilate)
+    for (size_t j = 0; j != n; ++j)
+      out[j] = std::max(std::max(a[j], b[j]), c[j]);
+  else
+    for (size_t j = 0; j != n; ++j)
+      out[j] = std::min(std::min(a[j], b[j]), c[j]);
+}
+
+// Runs the kernel of the instruction set selected at runtime, see Simd.hpp
+inline void extremum3(const float *a, const float *b, const float *c,
+                      float *out, size_t n, bool dilate) {
+  const nupic::simd::Kernels &k = nupic::simd::kernels();
+  if (const auto f = dilate ? k.max3 : k.min3)
+    return f(a, b, c, out, n);
+  extremum3<float>(a, b, c, out, n, dilate);
+}
+
+} // namespace erosion_detail
+#endif // SWIG
+
 using namespace std;
 
 //--------------------------------------------------------------------------------
 /**
  * Erode or dilate an image.
+ *
+ * The horizontal pass writes into a scratch buffer taken from a Workspace,
+ * which can be shared between the instances of a pipeline.
  */
 template <typename T> struct Erosion {
   typedef size_t size_type;
@@ -43,25 +84,24 @@ template <typename T> struct Erosion {
 
   size_type nrows_;
   size_type ncols_;
+
+  // Result of the last horizontal pass, in the current workspace.
   T *buffer_;
 
-  inline void init(size_type nrows, size_type ncols)
-  /*
-    : nrows_(nrows), ncols_(ncols)
-      buffer_(new T[nrows*ncols])
-  */
-  {
+  /**
+   * If workspace is not NULL, the scratch memory is taken from it instead
+   * of from a buffer owned by this instance. The workspace must outlive
+   * this instance.
+   */
+  inline void init(size_type nrows, size_type ncols,
+                   Workspace<T> *workspace = NULL) {
     nrows_ = nrows;
     ncols_ = ncols;
-    buffer_ = new T[nrows * ncols];
+    workspace_ = workspace;
+    buffer_ = scratch_(nrows * ncols);
   }
 
-  inline Erosion() : buffer_(NULL) {}
-
-  inline ~Erosion() {
-    delete[] buffer_;
-    buffer_ = NULL;
-  }
+  inline Erosion() : buffer_(NULL), workspace_(NULL) {}
 
   /**
    * Erodes (or dilates) the image by convolving with a 3x3 min (or max) filter.
@@ -70,73 +110,61 @@ template <typename T> struct Erosion {
    */
   inline void compute(T *data, T *eroded, size_type iterations,
                       bool dilate = false) {
+    buffer_ = scratch_(nrows_ * ncols_);
+
     for (size_type iter = 0; iter != iterations; ++iter) {
-      T *in;
-      if (!iter) {
-        in = data; // First pass - read from the input buffer
-      } else {
-        in = eroded; // Subsequent pass - read from the output buffer
-      }
+      // First pass reads from the input buffer, subsequent passes from the
+      // output buffer
+      const T *in = iter ? eroded : data;
+
       // Rows (ignoring the first and last column)
       for (size_type i = 0; i != nrows_; ++i) {
-        T *b = buffer_ + i * ncols_ + 1; // Write to b in the buffer
-        T *d = in + i * ncols_; // Start reading from one to the left of b
-        while (b != (buffer_ + (i + 1) * ncols_ - 1)) {
-          if (dilate) {
-            *b = max(max(*d, *(d + 1)), *(d + 2));
-          } else {
-            *b = min(min(*d, *(d + 1)), *(d + 2));
-          }
-          b++;
-          d++;
-        }
-      }
-      if (dilate) {
-        // Need to fill the first and last column, which were ignored
-        for (size_type row = 0; row < nrows_; row++) {
-          buffer_[row * ncols_] = max(in[row * ncols_], in[row * ncols_ + 1]);
-          buffer_[(row + 1) * ncols_ - 1] =
-              max(in[(row + 1) * ncols_ - 2], in[(row + 1) * ncols_ - 1]);
-        }
-      } else {
-        // Zero out the first and last column (they are always eroded away)
-        for (size_type row = 0; row < nrows_; row++) {
-          buffer_[row * ncols_] = 0;
-          buffer_[(row + 1) * ncols_ - 1] = 0;
+        const T *d = in + i * ncols_;
+        T *b = buffer_ + i * ncols_;
+        erosion_detail::extremum3(d, d + 1, d + 2, b + 1, ncols_ - 2, dilate);
+        if (dilate) {
+          // Need to fill the first and last column, which were ignored
+          b[0] = max(d[0], d[1]);
+          b[ncols_ - 1] = max(d[ncols_ - 2], d[ncols_ - 1]);
+        } else {
+          // Zero out the first and last column (they are always eroded away)
+          b[0] = 0;
+          b[ncols_ - 1] = 0;
         }
       }
 
-      // Columns (ignoring the first and last row)
-      for (size_type i = 0; i != ncols_; ++i) {
-        T *b = eroded + i + ncols_; // Write to b in the output
-        T *d = buffer_ + i;         // Start reading from one above b
-        while (b != (eroded + i + ncols_ * (nrows_ - 1))) {
-          if (dilate) {
-            *b = max(max(*d, *(d + ncols_)), *(d + ncols_ * 2));
-          } else {
-            *b = min(min(*d, *(d + ncols_)), *(d + ncols_ * 2));
-          }
-          b += ncols_;
-          d += ncols_;
-        }
+      // Columns (ignoring the first and last row), one output row at a time
+      for (size_type i = 1; i + 1 < nrows_; ++i) {
+        const T *b = buffer_ + (i - 1) * ncols_;
+        erosion_detail::extremum3(b, b + ncols_, b + 2 * ncols_,
+                                  eroded + i * ncols_, ncols_, dilate);
       }
+      T *first = eroded, *last = eroded + (nrows_ - 1) * ncols_;
       if (dilate) {
         // Need to fill the first and last row, which were ignored
+        const T *b_last = buffer_ + (nrows_ - 1) * ncols_;
+        const T *b_prev = b_last - ncols_;
         for (size_type col = 0; col < ncols_; col++) {
-          eroded[col] = max(buffer_[col], buffer_[col + ncols_]);
-          eroded[(nrows_ - 1) * ncols_ + col] =
-              max(buffer_[(nrows_ - 1) * ncols_ + col],
-                  buffer_[(nrows_ - 2) * ncols_ + col]);
+          first[col] = max(buffer_[col], buffer_[col + ncols_]);
+          last[col] = max(b_last[col], b_prev[col]);
         }
       } else {
         // Zero out the first and last row (they are always eroded away)
         for (size_type col = 0; col < ncols_; col++) {
-          eroded[col] = 0;
-          eroded[(nrows_ - 1) * ncols_ + col] = 0;
+          first[col] = 0;
+          last[col] = 0;
         }
       }
     }
   }
+
+private:
+  inline T *scratch_(size_type n) {
+    return workspace_ ? workspace_->get(n) : own_workspace_.get(n);
+  }
+
+  Workspace<T> *workspace_;
+  Workspace<T> own_workspace_;
 };
 
 //--------------------------------------------------------------------------------
@@ -0,0 +1,275 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+
+/** @file
+ * Sorted-array associative container used as the SparseTensor storage
+ */
+
+#ifndef NTA_FLAT_MAP_HPP
+#define NTA_FLAT_MAP_HPP
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+#include <nupic/utils/Log.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+
+namespace nupic {
+
+//--------------------------------------------------------------------------------
+/**
+ * A unique, sorted associative container stored as one contiguous array of
+ * (key, value) pairs, ordered by std::less<Key>.
+ *
+ * It offers the subset of the std::map interface that SparseTensor uses,
+ * with the same iteration order. Lookups are binary searches over
+ * contiguous memory and there is no per-element allocation. Inserting a
+ * key larger than all the keys present is O(1) amortized, inserting
+ * anywhere else is O(size()), and any insertion or erasure invalidates
+ * iterators.
+ *
+ * Code that produces many elements at once should not insert them one by
+ * one: it should collect them in a container_type, sort it with sort(),
+ * and hand it over with assign_sorted() or merge_sorted().
+ */
+template <typename Key, typename T> class FlatMap {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef std::vector<value_type> container_type;
+  typedef typename container_type::size_type size_type;
+  typedef typename container_type::iterator iterator;
+  typedef typename container_type::const_iterator const_iterator;
+
+  /**
+   * Orders pairs by key only, so that sorting is stable with respect to
+   * the values.
+   */
+  struct KeyLess {
+    inline bool operator()(const value_type &a, const value_type &b) const {
+      return std::less<Key>()(a.first, b.first);
+    }
+    inline bool operator()(const value_type &a, const Key &k) const {
+      return std::less<Key>()(a.first, k);
+    }
+    inline bool operator()(const Key &k, const value_type &a) const {
+      return std::less<Key>()(k, a.first);
+    }
+  };
+
+  inline iterator begin() { return v_.begin(); }
+  inline iterator end() { return v_.end(); }
+  inline const_iterator begin() const { return v_.begin(); }
+  inline const_iterator end() const { return v_.end(); }
+
+  inline size_type size() const { return v_.size(); }
+  inline bool empty() const { return v_.empty(); }
+  inline void clear() { v_.clear(); }
+  inline void reserve(size_type n) { v_.reserve(n); }
+  inline void swap(FlatMap &other) { v_.swap(other.v_); }
+
+  inline iterator lower_bound(const Key &k) {
+    return std::lower_bound(v_.begin(), v_.end(), k, KeyLess());
+  }
+
+  inline const_iterator lower_bound(const Key &k) const {
+    return std::lower_bound(v_.begin(), v_.end(), k, KeyLess());
+  }
+
+  inline iterator find(const Key &k) {
+    iterator it = lower_bound(k);
+    return it != v_.end() && !std::less<Key>()(k, it->first) ? it : v_.end();
+  }
+
+  inline const_iterator find(const Key &k) const {
+    const_iterator it = lower_bound(k);
+    return it != v_.end() && !std::less<Key>()(k, it->first) ? it : v_.end();
+  }
+
+  inline std::pair<iterator, iterator> equal_range(const Key &k) {
+    iterator it = find(k);
+    return std::make_pair(it, it == v_.end() ? it : it + 1);
+  }
+
+  inline std::pair<const_iterator, const_iterator>
+  equal_range(const Key &k) const {
+    const_iterator it = find(k);
+    return std::make_pair(it, it == v_.end() ? it : it + 1);
+  }
+
+  /**
+   * Inserts v if its key is not present yet. Returns the position of the
+   * element with that key, and whether the insertion took place.
+   */
+  inline std::pair<iterator, bool> insert(const value_type &v) {
+    if (v_.empty() || std::less<Key>()(v_.back().first, v.first)) {
+      v_.push_back(v);
+      return std::make_pair(v_.end() - 1, true);
+    }
+    iterator it = lower_bound(v.first);
+    if (it != v_.end() && !std::less<Key>()(v.first, it->first))
+      return std::make_pair(it, false);
+    return std::make_pair(v_.insert(it, v), true);
+  }
+
+  inline T &operator[](const Key &k) {
+    return insert(value_type(k, T())).first->second;
+  }
+
+  inline iterator erase(iterator it) { return v_.erase(it); }
+
+  inline iterator erase(iterator first, iterator last) {
+    return v_.erase(first, last);
+  }
+
+  inline size_type erase(const Key &k) {
+    iterator it = find(k);
+    if (it == v_.end())
+      return 0;
+    v_.erase(it);
+    return 1;
+  }
+
+  /**
+   * Erases all the elements for which pred(element) is true, in a single
+   * pass.
+   */
+  template <typename Predicate> inline void erase_if(Predicate pred) {
+    v_.erase(std::remove_if(v_.begin(), v_.end(), pred), v_.end());
+  }
+
+  /**
+   * Stable sort by key of an arbitrary sequence of pairs, so that
+   * duplicate keys stay in their original order. Large inputs are sorted
+   * in chunks on ThreadPool::shared(), then merged.
+   */
+  static void sort(container_type &v) {
+    const size_type grain = 1 << 15;
+    util::ThreadPool &pool = util::ThreadPool::shared();
+    UInt nChunks = std::min((UInt)(v.size() / grain), pool.size());
+    if (nChunks < 2) {
+      std::stable_sort(v.begin(), v.end(), KeyLess());
+      return;
+    }
+
+    std::vector<size_type> cut(nChunks + 1);
+    for (UInt c = 0; c <= nChunks; ++c)
+      cut[c] = v.size() * c / nChunks;
+
+    pool.parallelFor(0, nChunks, [&](UInt lo, UInt hi) {
+      for (UInt c = lo; c < hi; ++c)
+        std::stable_sort(v.begin() + cut[c], v.begin() + cut[c + 1],
+                         KeyLess());
+    });
+
+    for (UInt width = 1; width < nChunks; width *= 2) {
+      UInt nMerges = (nChunks + 2 * width - 1) / (2 * width);
+      pool.parallelFor(0, nMerges, [&](UInt lo, UInt hi) {
+        for (UInt m = lo; m < hi; ++m) {
+          UInt first = 2 * m * width;
+          UInt middle = std::min(first + width, nChunks);
+          UInt last = std::min(first + 2 * width, nChunks);
+          if (middle < last)
+            std::inplace_merge(v.begin() + cut[first], v.begin() + cut[middle],
+                               v.begin() + cut[last], KeyLess());
+        }
+      });
+    }
+  }
+
+  /**
+   * Replaces the contents of this map with v, whose keys need to be
+   * sorted and unique. v is left empty.
+   */
+  inline void assign_sorted(container_type &v) {
+    {
+      NTA_ASSERT(is_strictly_sorted_(v))
+          << "FlatMap::assign_sorted(): keys need to be sorted and unique";
+    }
+
+    v_.swap(v);
+    v.clear();
+  }
+
+  /**
+   * Merges v, whose keys need to be sorted and unique, into this map.
+   * Values from v replace the values already present for the same key.
+   * Elements of v for which drop(value) is true are not inserted, and
+   * erase the element with the same key in this map if there is one.
+   * v is left empty.
+   *
+   * Complexity: O(size() + v.size())
+   */
+  template <typename Drop>
+  inline void merge_sorted(container_type &v, Drop drop) {
+    {
+      NTA_ASSERT(is_strictly_sorted_(v))
+          << "FlatMap::merge_sorted(): keys need to be sorted and unique";
+    }
+
+    container_type out;
+    out.reserve(v_.size() + v.size());
+
+    std::less<Key> lt;
+    const_iterator it1 = v_.begin(), e1 = v_.end();
+    const_iterator it2 = v.begin(), e2 = v.end();
+
+    while (it1 != e1 && it2 != e2) {
+      if (lt(it1->first, it2->first)) {
+        out.push_back(*it1++);
+      } else {
+        if (!lt(it2->first, it1->first))
+          ++it1;
+        if (!drop(it2->second))
+          out.push_back(*it2);
+        ++it2;
+      }
+    }
+
+    out.insert(out.end(), it1, e1);
+    for (; it2 != e2; ++it2)
+      if (!drop(it2->second))
+        out.push_back(*it2);
+
+    v_.swap(out);
+    v.clear();
+  }
+
+private:
+  container_type v_;
+
+  static bool is_strictly_sorted_(const container_type &v) {
+    for (size_type i = 1; i < v.size(); ++i)
+      if (!std::less<Key>()(v[i - 1].first, v[i].first))
+        return false;
+    return true;
+  }
+};
+
+} // end namespace nupic
+
+#endif // NTA_FLAT_MAP_HPP
@@ -28,11 +28,112 @@
 #define NTA_NEAREST_NEIGHBOR_HPP
 
 #include <nupic/math/ArrayAlgo.hpp>
+#include <nupic/math/Simd.hpp>
 #include <nupic/math/SparseMatrix.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
 
 //----------------------------------------------------------------------
 namespace nupic {
 
+/**
+ * Distance kernels between one row of a NearestNeighbor (n non-zeros,
+ * indices ind, values nz) and a dense vector x.
+ *
+ * l1 and l2 return the sum over the non-zeros of |nz - x[j]| - px[j],
+ * resp. (nz - x[j])^2 - px[j], where px[j] is |x[j]|, resp. x[j]^2, so that
+ * adding the sum of px over all the columns gives the distance. The terms
+ * are accumulated in 8 lanes, term i going to lane i % 8, the lanes are
+ * combined as ((l0 + l4) + (l2 + l6)) + ((l1 + l5) + (l3 + l7)) and the
+ * remaining terms are added in order. lmax returns the largest |nz - x[j]|,
+ * or 0 for an empty row.
+ *
+ * The specialization for float values with 32-bit indices uses the kernels
+ * of nupic/math/Simd.hpp on CPUs with AVX2, which process 8 non-zeros at a
+ * time with a gather for x and px, in the same order, so all the versions
+ * return the same bits.
+ */
+template <typename UI, typename T> struct NearestNeighborScalarKernels_ {
+  static inline T lanes_(const T *l) {
+    T t0 = l[0] + l[4], t1 = l[1] + l[5], t2 = l[2] + l[6], t3 = l[3] + l[7];
+    T u0 = t0 + t2, u1 = t1 + t3;
+    return u0 + u1;
+  }
+
+  static inline T l1(const UI *ind, const T *nz, UI n, const T *x,
+                     const T *px) {
+    T l[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    UI i = 0;
+    for (; i + 8 <= n; i += 8)
+      for (UI k = 0; k != 8; ++k) {
+        const UI j = ind[i + k];
+        l[k] += (T)std::fabs(nz[i + k] - x[j]) - px[j];
+      }
+    T s = lanes_(l);
+    for (; i != n; ++i)
+      s += (T)std::fabs(nz[i] - x[ind[i]]) - px[ind[i]];
+    return s;
+  }
+
+  static inline T l2(const UI *ind, const T *nz, UI n, const T *x,
+                     const T *px) {
+    T l[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    UI i = 0;
+    for (; i + 8 <= n; i += 8)
+      for (UI k = 0; k != 8; ++k) {
+        const UI j = ind[i + k];
+        const T d = nz[i + k] - x[j];
+        l[k] += d * d - px[j];
+      }
+    T s = lanes_(l);
+    for (; i != n; ++i) {
+      const T d = nz[i] - x[ind[i]];
+      s += d * d - px[ind[i]];
+    }
+    return s;
+  }
+
+  static inline T lmax(const UI *ind, const T *nz, UI n, const T *x) {
+    T m = 0;
+    for (UI i = 0; i != n; ++i) {
+      const T d = (T)std::fabs(nz[i] - x[ind[i]]);
+      if (d > m)
+        m = d;
+    }
+    return m;
+  }
+};
+
+template <typename UI, typename T>
+struct NearestNeighborKernels : NearestNeighborScalarKernels_<UI, T> {};
+
+template <>
+struct NearestNeighborKernels<UInt32, Real32>
+    : NearestNeighborScalarKernels_<UInt32, Real32> {
+  typedef NearestNeighborScalarKernels_<UInt32, Real32> Scalar;
+
+  static inline Real32 l1(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                          const Real32 *x, const Real32 *px) {
+    const auto f = simd::kernels().l1Distance;
+    return f ? f(ind, nz, n, x, px) : Scalar::l1(ind, nz, n, x, px);
+  }
+
+  static inline Real32 l2(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                          const Real32 *x, const Real32 *px) {
+    const auto f = simd::kernels().l2Distance;
+    return f ? f(ind, nz, n, x, px) : Scalar::l2(ind, nz, n, x, px);
+  }
+
+  static inline Real32 lmax(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                            const Real32 *x) {
+    const auto f = simd::kernels().lmaxDistance;
+    return f ? f(ind, nz, n, x) : Scalar::lmax(ind, nz, n, x);
+  }
+};
+
 template <typename T> class NearestNeighbor : public T {
 public:
   typedef T parent_type;
@@ -111,37 +212,93 @@ public:
   }
 
   //--------------------------------------------------------------------------------
-  /**
-   * A method that computes the powers of x and their sum, according to f.
-   */
+  // DISTANCE ENGINE
+  //
+  // A query vector is prepared once (Query_), with the powers of x and their
+  // sum. The distance to a row is then computed on the non-zeros of the row
+  // only, by rowDist_. The methods that visit all the rows split them in
+  // ranges processed in parallel on the shared ThreadPool; each row is
+  // computed the same way whatever the number of threads, and the top-k
+  // selection breaks ties on the row index, so results are deterministic.
+  //--------------------------------------------------------------------------------
 private:
-  template <typename InputIterator, typename F>
-  inline void compute_powers_(value_type &Sp_x, value_type *p_x,
-                              InputIterator x, F f) {
+  typedef NearestNeighborKernels<size_type, value_type> Kernels_;
+  typedef std::pair<size_type, value_type> Neighbor_;
+
+  enum Norm_ { L0_, L1_, L2_, LMax_, Lp_ };
+
+  struct Query_ {
+    Norm_ norm;
+    value_type p;
+    // x, and the p-th power of |x| for each column (for L0, 1 where x
+    // is not zero)
+    std::vector<value_type> x, px;
+    // Sum of px
+    value_type sum;
+    // Lmax only: the columns where x is not zero, by decreasing |x|
+    std::vector<size_type> byMagnitude;
+  };
+
+  static inline Norm_ norm_(value_type p) {
+    if (p == (value_type)0.0)
+      return L0_;
+    if (p == (value_type)1.0)
+      return L1_;
+    if (p == (value_type)2.0)
+      return L2_;
+    return Lp_;
+  }
+
+  template <typename InputIterator>
+  inline void prepare_(Norm_ norm, value_type p, InputIterator x,
+                       Query_ &q) const {
     const size_type ncols = this->nCols();
-    InputIterator end1 = x + 4 * (ncols / 4), end2 = x + ncols;
-    Sp_x = (value_type)0;
-
-    for (; x != end1; x += 4, p_x += 4) {
-      *p_x = f(Sp_x, *x);
-      *(p_x + 1) = f(Sp_x, *(x + 1));
-      *(p_x + 2) = f(Sp_x, *(x + 2));
-      *(p_x + 3) = f(Sp_x, *(x + 3));
+    q.norm = norm;
+    q.p = p;
+    q.x.resize(ncols);
+    q.sum = 0;
+    q.byMagnitude.clear();
+
+    for (size_type j = 0; j != ncols; ++j, ++x)
+      q.x[j] = *x;
+
+    if (norm == LMax_) {
+      for (size_type j = 0; j != ncols; ++j)
+        if (q.x[j] != (value_type)0)
+          q.byMagnitude.push_back(j);
+      const std::vector<value_type> &v = q.x;
+      std::stable_sort(q.byMagnitude.begin(), q.byMagnitude.end(),
+                       [&v](size_type a, size_type b) {
+                         return std::fabs(v[a]) > std::fabs(v[b]);
+                       });
+      return;
     }
 
-    for (; x != end2; ++x)
-      *p_x++ = f(Sp_x, *x);
+    q.px.resize(ncols);
+    if (norm == L0_)
+      compute_powers_(q, Lp0<value_type>());
+    else if (norm == L1_)
+      compute_powers_(q, Lp1<value_type>());
+    else if (norm == L2_)
+      compute_powers_(q, Lp2<value_type>());
+    else
+      compute_powers_(q, Lp<value_type>(p));
+  }
+
+  template <typename F> static inline void compute_powers_(Query_ &q, F f) {
+    const size_type ncols = (size_type)q.x.size();
+    for (size_type j = 0; j != ncols; ++j)
+      q.px[j] = f(q.sum, q.x[j]);
   }
 
   //--------------------------------------------------------------------------------
   /**
    * A method that computes the sum of powers of the difference between x
-   * and a given row.
+   * and a given row, for the generic Lp norm.
    */
-private:
-  template <typename InputIterator, typename F>
-  inline value_type sum_of_p_diff_(size_type row, InputIterator x,
-                                   value_type Sp_x, value_type *p_x,
+  template <typename F>
+  inline value_type sum_of_p_diff_(size_type row, const value_type *x,
+                                   value_type Sp_x, const value_type *p_x,
                                    F f) const {
     size_type nnzr = this->nnzr_[row], j, *ind = this->ind_[row];
     value_type *nz = this->nz_[row];
@@ -184,96 +341,131 @@ private:
 
   //--------------------------------------------------------------------------------
   /**
-   * A method that computes the distance between x and the specified row,
-   * parameterized on the norm function. Can be instantiated for L0, L1 and
-   * Lmax. Here, we don't need to worry about taking a root, and there are no
-   * powers of x to cache, as opposed to one_row_dist_2. The complexity is:
-   * nnzr*f().
+   * The distance between the prepared query q and row, without the root.
+   * The complexity is O(nnzr), except for Lmax, where each column of x
+   * that is not zero, by decreasing magnitude, is looked up in the row
+   * until one is missing: the largest |x[j]| outside of the row.
    */
-private:
-  template <typename InputIterator, typename F>
-  inline value_type one_row_dist_1(size_type row, InputIterator x, F f) const {
-    const size_type ncols = this->nCols();
-    size_type *ind = this->ind_[row], *ind_end = ind + this->nnzr_[row], j = 0;
-    value_type *nz = this->nz_[row], d = (value_type)0.0;
-
-    while (ind != ind_end) {
-      size_type j_end = *ind++;
-      while (j != j_end)
-        f(d, x[j++]);
-      f(d, x[j++] - *nz++);
+  inline value_type rowDist_(const Query_ &q, size_type row) const {
+    const size_type n = this->nnzr_[row];
+    const size_type *ind = this->ind_[row];
+    const value_type *nz = this->nz_[row];
+    const value_type *x = q.x.data(), *px = q.px.data();
+    value_type d = q.sum;
+
+    switch (q.norm) {
+    case L0_: {
+      Lp0<value_type> f;
+      value_type c = 0;
+      for (size_type i = 0; i != n; ++i)
+        d += f(c, nz[i] - x[ind[i]]) - px[ind[i]];
+      return d;
+    }
+    case L1_:
+      d += Kernels_::l1(ind, nz, n, x, px);
+      break;
+    case L2_:
+      d += Kernels_::l2(ind, nz, n, x, px);
+      break;
+    case LMax_: {
+      d = Kernels_::lmax(ind, nz, n, x);
+      for (size_type col : q.byMagnitude)
+        if (!std::binary_search(ind, ind + n, col)) {
+          d = std::max(d, (value_type)std::fabs(x[col]));
+          break;
+        }
+      return d;
+    }
+    default:
+      return sum_of_p_diff_(row, x, q.sum, px, Lp<value_type>(q.p));
     }
 
-    if (j < ncols)
-      while (j != ncols)
-        f(d, x[j++]);
+    // Accuracy issues because of the subtractions,
+    // could return negative values
+    if (d <= (value_type)0)
+      d = (value_type)0;
 
     return d;
   }
 
-  //--------------------------------------------------------------------------------
-  /**
-   * A method that computes the distance between x and the specified row,
-   * parameterized on the norm function. Can be instantiated for L2 or Lp.
-   * Caches the powers of x in nzb_, so that we achieve complexity:
-   * nnzr*(2*diff+abs+f.power()) + ncols*f.power(), instead of:
-   * nnzr*(diff+abs+f.power()) + nrows*ncols*f.power().
-   */
-private:
-  template <typename InputIterator, typename F>
-  inline value_type one_row_dist_2(size_type row, InputIterator x, F f,
-                                   bool take_root = false) const {
-    value_type Sp_x = 0.0;
-
-    const_cast<self_type *>(this)->compute_powers_(Sp_x, this->nzb_, x, f);
-    value_type val = sum_of_p_diff_(row, x, Sp_x, this->nzb_, f);
-
-    if (take_root)
-      val = f.root(val);
-
-    return val;
+  inline value_type root_(const Query_ &q, value_type d) const {
+    if (q.norm == L2_)
+      return Lp2<value_type>().root(d);
+    if (q.norm == Lp_)
+      return Lp<value_type>(q.p).root(d);
+    return d;
   }
 
   //--------------------------------------------------------------------------------
   /**
-   * A method that computes the distances between x and all the rows in the
-   * matrix. The method is parameterized on the norm to use, F. Although it
-   * looks very similar to one_row_dist_1, the sums of powers are computed once
-   * for all the rows here, where they would be computed for each row if
-   * one_row_dist_1 was called. The complexity is:
-   * ncols*(pow) + nnz*(2*diff+f.power()) + nrows*f.root().
+   * Writes the distance between q and each row to y, which must be a random
+   * access iterator. Rows are processed in parallel.
    */
-private:
-  template <typename InputIterator, typename OutputIterator, typename F>
-  inline void all_rows_dist_(InputIterator x, OutputIterator y, F f,
+  template <typename OutputIterator>
+  inline void all_rows_dist_(const Query_ &q, OutputIterator y,
                              bool take_root = false) const {
     { // Pre-conditions
       NTA_ASSERT(this->nRows() > 0) << "NearestNeighbor::all_rows_dist_(): "
                                     << "No vector stored yet";
     } // End pre-conditions
 
-    const size_type nrows = this->nRows();
-    OutputIterator y_begin = y, y_end = y + nrows;
-    value_type Sp_x = 0.0;
-
-    const_cast<self_type *>(this)->compute_powers_(Sp_x, this->nzb_, x, f);
+    this->parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
+            value_type d = rowDist_(q, row);
+            *(y + row) = take_root ? root_(q, d) : d;
+          }
+        },
+        0);
+  }
 
-    for (size_type i = 0; i != nrows; ++i, ++y)
-      *y = sum_of_p_diff_(i, x, Sp_x, this->nzb_, f);
+  //--------------------------------------------------------------------------------
+  // Orders neighbors by increasing distance, ties going to the lower row.
+  struct Closer_ {
+    inline bool operator()(const Neighbor_ &a, const Neighbor_ &b) const {
+      return a.second < b.second ||
+             (a.second == b.second && a.first < b.first);
+    }
+  };
+
+  // Offers (row, d) to h, a max-heap of at most k neighbors that keeps the
+  // k closest.
+  static inline void keep_closest_(std::vector<Neighbor_> &h, size_type k,
+                                   size_type row, value_type d) {
+    const Neighbor_ c(row, d);
+    if (h.size() < k) {
+      h.push_back(c);
+      std::push_heap(h.begin(), h.end(), Closer_());
+    } else if (Closer_()(c, h.front())) {
+      std::pop_heap(h.begin(), h.end(), Closer_());
+      h.back() = c;
+      std::push_heap(h.begin(), h.end(), Closer_());
+    }
+  }
 
-    if (take_root)
-      for (y = y_begin; y != y_end; ++y)
-        *y = f.root(*y);
+  // Writes the min(k, candidates.size()) closest candidates to nn, closest
+  // first, applying root to the distances.
+  template <typename Root, typename OutputIterator>
+  static inline void closest_first_(std::vector<Neighbor_> &candidates,
+                                    size_type k, const Root &root,
+                                    OutputIterator nn) {
+    k = std::min(k, (size_type)candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k,
+                      candidates.end(), Closer_());
+    for (size_type i = 0; i != k; ++i, ++nn)
+      *nn = std::make_pair(candidates[i].first, root(candidates[i].second));
   }
 
   //--------------------------------------------------------------------------------
   /**
-   * A method that finds the k top nearest neighbor, as defined by F.
+   * A method that finds the k top nearest neighbors, where dist(row) is the
+   * distance to a row, and root(d) maps it to the returned distance. Each
+   * range of rows keeps a bounded heap of its k nearest rows; the heaps are
+   * merged at the end. Complexity: nrows*(dist + log k).
    */
-private:
-  template <typename InputIterator, typename OutputIterator, typename F>
-  inline void k_nearest_(InputIterator x, OutputIterator nn, F f,
-                         size_type k = 1, bool take_root = false) const {
+  template <typename RowDist, typename Root, typename OutputIterator>
+  inline void k_nearest_(const RowDist &dist, const Root &root,
+                         OutputIterator nn, size_type k) const {
     { // Pre-conditions
       NTA_ASSERT(k >= 1) << "NearestNeighbor::k_nearest_(): "
                          << "Invalid number of nearest rows: " << k
@@ -283,9 +475,82 @@ private:
                                     << "No vector stored yet";
     }
 
-    std::vector<value_type> b(this->nRows());
-    all_rows_dist_(x, b.begin(), f, take_root);
-    partial_sort_2nd(k, b, nn, std::less<value_type>());
+    std::vector<Neighbor_> best;
+    std::mutex mutex;
+
+    this->parallelRows_(
+        [&](UInt lo, UInt hi) {
+          std::vector<Neighbor_> h;
+          h.reserve(std::min(k, (size_type)(hi - lo)));
+          for (size_type row = lo; row != hi; ++row)
+            keep_closest_(h, k, row, dist(row));
+          std::lock_guard<std::mutex> lock(mutex);
+          best.insert(best.end(), h.begin(), h.end());
+        },
+        0);
+
+    closest_first_(best, k, root, nn);
+  }
+
+  template <typename OutputIterator>
+  inline void k_nearest_(const Query_ &q, OutputIterator nn, size_type k,
+                         bool take_root = false) const {
+    k_nearest_([&](size_type row) { return rowDist_(q, row); },
+               [&](value_type d) { return take_root ? root_(q, d) : d; }, nn,
+               k);
+  }
+
+  template <typename InputIterator, typename OutputIterator>
+  inline void k_nearest_(Norm_ norm, value_type p, InputIterator x,
+                         OutputIterator nn, size_type k,
+                         bool take_root = false) const {
+    Query_ q;
+    prepare_(norm, p, x, q);
+    k_nearest_(q, nn, k, take_root);
+  }
+
+  template <typename InputIterator>
+  inline value_type one_row_dist_(Norm_ norm, value_type p, size_type row,
+                                  InputIterator x,
+                                  bool take_root = false) const {
+    Query_ q;
+    prepare_(norm, p, x, q);
+    value_type d = rowDist_(q, row);
+    return take_root ? root_(q, d) : d;
+  }
+
+  template <typename InputIterator, typename OutputIterator>
+  inline void all_rows_dist_(Norm_ norm, value_type p, InputIterator x,
+                             OutputIterator y, bool take_root = false) const {
+    Query_ q;
+    prepare_(norm, p, x, q);
+    all_rows_dist_(q, y, take_root);
+  }
+
+  //--------------------------------------------------------------------------------
+  /**
+   * A method that computes the distance between x and the specified row,
+   * parameterized on the norm function. Can be instantiated for L0, L1 and
+   * Lmax. Visits all the columns. The complexity is: ncols*f().
+   */
+  template <typename InputIterator, typename F>
+  inline value_type one_row_dist_1(size_type row, InputIterator x, F f) const {
+    const size_type ncols = this->nCols();
+    size_type *ind = this->ind_[row], *ind_end = ind + this->nnzr_[row], j = 0;
+    value_type *nz = this->nz_[row], d = (value_type)0.0;
+
+    while (ind != ind_end) {
+      size_type j_end = *ind++;
+      while (j != j_end)
+        f(d, x[j++]);
+      f(d, x[j++] - *nz++);
+    }
+
+    if (j < ncols)
+      while (j != ncols)
+        f(d, x[j++]);
+
+    return d;
   }
 
 public:
@@ -390,7 +655,7 @@ public:
           << " - Should be >= 0 and < nrows = " << this->nRows();
     }
 
-    return one_row_dist_2(row, x, Lp2<value_type>(), take_root);
+    return one_row_dist_(L2_, 2, row, x, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -417,7 +682,7 @@ public:
       NTA_ASSERT(this->nRows() > 0) << "NearestNeighbor::rowLMaxDist(): "
                                     << "No vector stored yet";
 
-      assert_valid_row_(row, "rowLMaxDist");
+      this->assert_valid_row_(row, "rowLMaxDist");
     } // End pre-conditions
 
     return one_row_dist_1(row, x, LpMax<value_type>());
@@ -452,7 +717,7 @@ public:
       NTA_ASSERT(this->nRows() > 0) << "NearestNeighbor::rowLpDist(): "
                                     << "No vector stored yet";
 
-      assert_valid_row_(row, "rowLpDist");
+      this->assert_valid_row_(row, "rowLpDist");
 
       NTA_ASSERT(p >= (value_type)0.0)
           << "NearestNeighbor::rowLpDist():"
@@ -469,7 +734,7 @@ public:
     if (p == (value_type)2.0)
       return rowL2Dist(row, x, take_root);
 
-    return one_row_dist_2(row, x, Lp<value_type>(p), take_root);
+    return one_row_dist_(Lp_, p, row, x, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -485,6 +750,7 @@ public:
    *
    * @param x [InputIterator<value_type>] x vector
    * @param y [OutputIterator<value_type>] vector of distances of x to each row
+   *  (random access)
    *
    * @b Exceptions:
    *  @li None
@@ -496,11 +762,7 @@ public:
                                     << "No vector stored yet";
     }
 
-    const size_type nrows = this->nRows();
-    Lp0<value_type> f;
-
-    for (size_type i = 0; i != nrows; ++i, ++y)
-      *y = one_row_dist_1(i, x, f);
+    all_rows_dist_(L0_, 0, x, y);
   }
 
   //--------------------------------------------------------------------------------
@@ -516,6 +778,7 @@ public:
    *
    * @param x [InputIterator<value_type>] x vector
    * @param y [OutputIterator<value_type>] vector of distances of x to each row
+   *  (random access)
    *
    * @b Exceptions:
    *  @li None
@@ -527,26 +790,7 @@ public:
                                     << "No vector stored yet";
     }
 
-    const size_type nrows = this->nRows(), ncols = this->nCols();
-    value_type s = 0.0;
-    Lp1<value_type> f;
-
-    InputIterator x_ptr = x;
-    for (size_type j = 0; j != ncols; ++j, ++x_ptr)
-      this->nzb_[j] = f(s, *x_ptr);
-
-    for (size_type i = 0; i != nrows; ++i, ++y) {
-      size_type *ind = this->ind_[i], *ind_end = ind + this->nnzr_[i];
-      value_type *nz = this->nz_[i], d = s;
-      for (; ind != ind_end; ++ind, ++nz) {
-        size_type j = *ind;
-        f(d, x[j] - *nz);
-        d -= this->nzb_[j];
-      }
-      if (d <= (value_type)0)
-        d = (value_type)0;
-      *y = d;
-    }
+    all_rows_dist_(L1_, 1, x, y);
   }
 
   //--------------------------------------------------------------------------------
@@ -558,6 +802,7 @@ public:
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param y [OutputIterator<value_type>] vector of the distances to x
+   *  (random access)
    * @param take_root [bool (false)] whether to return the square root of the
    *  distances
    *  or their exact value (the square root of the sum of the squares). Default
@@ -574,7 +819,7 @@ public:
                                     << "No vector stored yet";
     }
 
-    all_rows_dist_(x, y, Lp2<value_type>(), take_root);
+    all_rows_dist_(L2_, 2, x, y, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -582,10 +827,11 @@ public:
    * Computes the Lmax distance between vector x and each row of this
    * NearestNeighbor.
    *
-   * Non-mutating, O(nrows*ncols)
+   * Non-mutating, O(nnz*log(ncols))
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param y [OutputIterator<value_type>] vector of the distances to x
+   *  (random access)
    *
    * @b Exceptions:
    *  @li None
@@ -597,11 +843,7 @@ public:
                                     << "No vector stored yet";
     }
 
-    const size_type nrows = this->nRows();
-    LpMax<value_type> f;
-
-    for (size_type i = 0; i != nrows; ++i, ++y)
-      *y = one_row_dist_1(i, x, f);
+    all_rows_dist_(LMax_, 0, x, y);
   }
 
   //--------------------------------------------------------------------------------
@@ -615,6 +857,7 @@ public:
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param y [OutputIterator<value_type>] vector of the squared distances to x
+   *  (random access)
    * @param take_root [bool (false)] whether to return the p-th power of the
    * distances or their exact value (the p-th root of the sum of the p-powers).
    * Default is to return the p-th power of the distances.
@@ -650,7 +893,7 @@ public:
       return;
     }
 
-    all_rows_dist_(x, y, Lp<value_type>(p), take_root);
+    all_rows_dist_(Lp_, p, x, y, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -659,7 +902,8 @@ public:
    * the smallest L0 (Hamming) distance to x. If k > 1, finds the k nearest rows
    * to x.
    *
-   * Non-mutating, O(nnz) + complexity of partial sort up to k if  k > 1.
+   * Non-mutating, O(nnz + nrows*log(k)). The min(k, nrows) nearest rows are
+   * returned by increasing distance, ties by increasing row index.
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param nn [OutputIterator] the indices and distances of the nearest rows
@@ -681,7 +925,7 @@ public:
                          << " - Should be >= 1, default is 1";
     }
 
-    k_nearest_(x, nn, Lp0<value_type>(), k);
+    k_nearest_(L0_, 0, x, nn, k);
   }
 
   //--------------------------------------------------------------------------------
@@ -690,7 +934,8 @@ public:
    * the smallest L1 (Manhattan) distance to x. If k > 1, finds the k nearest
    * rows to x.
    *
-   * Non-mutating, O(nnz) + complexity of partial sort up to k if  k > 1.
+   * Non-mutating, O(nnz + nrows*log(k)). The min(k, nrows) nearest rows are
+   * returned by increasing distance, ties by increasing row index.
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param nn [OutputIterator] the indices and distances of the nearest rows
@@ -712,7 +957,7 @@ public:
                          << " - Should be >= 1, default is 1";
     }
 
-    k_nearest_(x, nn, Lp1<value_type>(), k);
+    k_nearest_(L1_, 1, x, nn, k);
   }
 
   //--------------------------------------------------------------------------------
@@ -721,7 +966,8 @@ public:
    * the smallest L2 (Euclidean) distance to x. If k > 1, finds the k nearest
    * rows to x.
    *
-   * Non-mutating, O(nnz) + complexity of partial sort up to k if  k > 1.
+   * Non-mutating, O(nnz + nrows*log(k)). The min(k, nrows) nearest rows are
+   * returned by increasing distance, ties by increasing row index.
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param nn [OutputIterator] the indices and distances of the nearest rows
@@ -746,7 +992,7 @@ public:
                          << " - Should be >= 1, default is 1";
     }
 
-    k_nearest_(x, nn, Lp2<value_type>(), k, take_root);
+    k_nearest_(L2_, 2, x, nn, k, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -754,7 +1000,8 @@ public:
    * Finds the row nearest to x, where nearest is defined as the row which has
    * the smallest Lmax distance to x. If k > 1, finds the k nearest rows to x.
    *
-   * Non-mutating, O(nnz) + complexity of partial sort up to k if  k > 1.
+   * Non-mutating, O(nnz + nrows*log(k)). The min(k, nrows) nearest rows are
+   * returned by increasing distance, ties by increasing row index.
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param nn [OutputIterator] the indices and distances of the nearest rows
@@ -776,9 +1023,7 @@ public:
                          << " - Should be >= 1, default is 1";
     }
 
-    std::vector<value_type> b(this->nRows());
-    LMaxDist(x, b.begin());
-    partial_sort_2nd(k, b, nn, std::less<value_type>());
+    k_nearest_(LMax_, 0, x, nn, k);
   }
 
   //--------------------------------------------------------------------------------
@@ -786,7 +1031,8 @@ public:
    * Finds the row nearest to x, where nearest is defined as the row which has
    * the smallest Lp distance to x. If k > 1, finds the k nearest rows to x.
    *
-   * Non-mutating, O(nnz) + complexity of partial sort up to k if  k > 1.
+   * Non-mutating, O(nnz + nrows*log(k)). The min(k, nrows) nearest rows are
+   * returned by increasing distance, ties by increasing row index.
    *
    * @param x [InputIterator<value_type>] vector to compute the distance from
    * @param nn [OutputIterator1] the indices and distances of the nearest rows
@@ -832,7 +1078,7 @@ public:
       return;
     }
 
-    k_nearest_(x, nn, Lp<value_type>(p), k, take_root);
+    k_nearest_(Lp_, p, x, nn, k, take_root);
   }
 
   //--------------------------------------------------------------------------------
@@ -847,6 +1093,170 @@ public:
     LpNearest(p, x.begin(), nn, k, take_root);
   }
 
+  //--------------------------------------------------------------------------------
+  /**
+   * Batched version of LpNearest, for nq query vectors stored one after the
+   * other at x (nq*ncols values). Each range of rows is visited once for
+   * all the queries, which keeps the rows in cache. Finds the
+   * min(k, nrows) nearest rows to each query, and writes them to nn, query
+   * after query, exactly as LpNearest would.
+   *
+   * Non-mutating, O(nq*(ncols + nnz + nrows*log(k)))
+   *
+   * @param p [value_type >= 0] the norm
+   * @param nq [size_type] number of query vectors
+   * @param x [InputIterator<value_type>] the query vectors
+   * @param nn [OutputIterator] the indices and distances of the nearest rows
+   * (pairs), min(k, nrows) per query
+   * @param k [size_type > 0, (1)] the number of nearest rows to retrieve
+   * @param take_root [bool (false)] whether to return the p-th power of the
+   * distances or their exact value (the p-th root of the sum of the p-powers).
+   *
+   * @b Exceptions:
+   *  @li If p < 0.
+   *  @li If k < 1.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void LpNearestBatch(value_type p, size_type nq, InputIterator x,
+                             OutputIterator nn, size_type k = 1,
+                             bool take_root = false) const {
+    { // Pre-conditions
+      NTA_ASSERT(this->nRows() > 0) << "NearestNeighbor::LpNearestBatch(): "
+                                    << "No vector stored yet";
+
+      NTA_ASSERT(p >= (value_type)0.0)
+          << "NearestNeighbor::LpNearestBatch():"
+          << "Invalid value for parameter p: " << p
+          << " - Only positive values (p >= 0) are supported";
+
+      NTA_ASSERT(k >= 1) << "NearestNeighbor::LpNearestBatch():"
+                         << "Invalid number of nearest rows: " << k
+                         << " - Should be >= 1, default is 1";
+    } // End pre-conditions
+
+    const size_type ncols = this->nCols();
+    std::vector<Query_> queries(nq);
+    for (size_type q = 0; q != nq; ++q)
+      prepare_(norm_(p), p, x + q * ncols, queries[q]);
+
+    std::vector<std::vector<Neighbor_>> best(nq);
+    std::mutex mutex;
+
+    this->parallelRows_(
+        [&](UInt lo, UInt hi) {
+          std::vector<std::vector<Neighbor_>> h(nq);
+          for (size_type row = lo; row != hi; ++row)
+            for (size_type q = 0; q != nq; ++q)
+              keep_closest_(h[q], k, row, rowDist_(queries[q], row));
+          std::lock_guard<std::mutex> lock(mutex);
+          for (size_type q = 0; q != nq; ++q)
+            best[q].insert(best[q].end(), h[q].begin(), h[q].end());
+        },
+        0, (UInt64)this->nNonZeros() * nq);
+
+    const size_type kq = std::min(k, this->nRows());
+    for (size_type q = 0; q != nq; ++q)
+      closest_first_(
+          best[q], k,
+          [&](value_type d) { return take_root ? root_(queries[q], d) : d; },
+          nn + q * kq);
+  }
+
+  //--------------------------------------------------------------------------------
+  /**
+   * Approximate version of LpNearest, for sparse stored vectors such as
+   * SDRs. The candidates are the rows that have a non-zero in at least one
+   * of the columns where x is not zero, found through the column index,
+   * which must be enabled (see enableColumnIndex()). If maxCandidates is
+   * not 0, only the max(maxCandidates, k) rows that share the most such
+   * columns with x are kept (ties go to the lower row). The candidates are then
+   * ranked by their exact distance, so the cost depends on the number of
+   * rows that overlap x rather than on the number of rows. A row that does
+   * not overlap x at all is never returned, unless fewer than k rows
+   * overlap x, in which case this falls back to LpNearest.
+   *
+   * Non-mutating.
+   *
+   * @param maxCandidates [size_type (0)] the maximum number of rows whose
+   * distance is computed, 0 for all the rows that overlap x
+   *
+   * Other parameters as for LpNearest.
+   *
+   * @b Exceptions:
+   *  @li If the column index is not enabled.
+   *  @li If p < 0.
+   *  @li If k < 1.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void approxLpNearest(value_type p, InputIterator x,
+                              OutputIterator nn, size_type k = 1,
+                              bool take_root = false,
+                              size_type maxCandidates = 0) const {
+    { // Pre-conditions
+      NTA_CHECK(this->colIndexActive_())
+          << "NearestNeighbor::approxLpNearest(): "
+          << "Needs the column index, call enableColumnIndex() first";
+
+      NTA_ASSERT(this->nRows() > 0) << "NearestNeighbor::approxLpNearest(): "
+                                    << "No vector stored yet";
+
+      NTA_ASSERT(p >= (value_type)0.0)
+          << "NearestNeighbor::approxLpNearest():"
+          << "Invalid value for parameter p: " << p
+          << " - Only positive values (p >= 0) are supported";
+
+      NTA_ASSERT(k >= 1) << "NearestNeighbor::approxLpNearest():"
+                         << "Invalid number of nearest rows: " << k
+                         << " - Should be >= 1, default is 1";
+    } // End pre-conditions
+
+    Query_ q;
+    prepare_(norm_(p), p, x, q);
+
+    // Number of columns each row shares with x, in a per-thread buffer
+    // that is all zeros between calls
+    const size_type ncols = this->nCols();
+    size_type *overlap =
+        parent_type::template threadScratch_<size_type>(this->nRows());
+    std::vector<size_type> rows;
+
+    for (size_type col = 0; col != ncols; ++col)
+      if (q.x[col] != (value_type)0)
+        for (size_type row : this->colRows_[col])
+          if (overlap[row]++ == 0)
+            rows.push_back(row);
+
+    const size_type keep = std::max(maxCandidates, k);
+    const bool truncate = maxCandidates != 0 && rows.size() > keep;
+
+    if (truncate)
+      std::nth_element(rows.begin(), rows.begin() + keep, rows.end(),
+                       [overlap](size_type a, size_type b) {
+                         return overlap[a] > overlap[b] ||
+                                (overlap[a] == overlap[b] && a < b);
+                       });
+
+    for (size_type row : rows)
+      overlap[row] = 0;
+
+    if (rows.size() < k) {
+      k_nearest_(q, nn, k, take_root);
+      return;
+    }
+
+    if (truncate)
+      rows.resize(keep);
+
+    std::vector<Neighbor_> best;
+    best.reserve(k);
+    for (size_type row : rows)
+      keep_closest_(best, k, row, rowDist_(q, row));
+
+    closest_first_(best, k,
+                   [&](value_type d) { return take_root ? root_(q, d) : d; },
+                   nn);
+  }
+
   //--------------------------------------------------------------------------------
   /**
    * Computes the "nearest-dot" distance between vector x
@@ -998,25 +1408,36 @@ public:
   // Proj nearest
   //--------------------------------------------------------------------------------
 private:
+  template <typename InputIterator, typename F>
+  inline value_type proj_row_dist_(size_type row, InputIterator x,
+                                   const F &f) const {
+    size_type *ind = this->ind_[row];
+    size_type *ind_end = ind + this->nNonZerosOnRow(row);
+    value_type *nz = this->nz_[row], val = 0;
+    for (; ind != ind_end; ++ind, ++nz)
+      f(val, *nz - *(x + *ind));
+    return val;
+  }
+
   template <typename InputIterator, typename OutputIterator, typename F>
   inline void proj_all_rows_dist_(InputIterator x, OutputIterator y, F f,
                                   bool take_root = false) const {
-    const size_type nrows = this->nRows();
-    OutputIterator y_begin = y, y_end = y_begin + nrows;
-
-    for (size_type row = 0; row != nrows; ++row, ++y) {
-      size_type *ind = this->ind_[row];
-      size_type *ind_end = ind + this->nNonZerosOnRow(row);
-      value_type *nz = this->nz_[row], val = 0;
-      for (; ind != ind_end; ++ind, ++nz)
-        f(val, *nz - *(x + *ind));
-      *y = val;
-    }
+    this->parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
+            value_type d = proj_row_dist_(row, x, f);
+            *(y + row) = take_root ? f.root(d) : d;
+          }
+        },
+        0);
+  }
 
-    if (take_root) {
-      for (y = y_begin; y != y_end; ++y)
-        *y = f.root(*y);
-    }
+  template <typename InputIterator, typename OutputIterator, typename F>
+  inline void proj_k_nearest_(InputIterator x, OutputIterator nn, F f,
+                              size_type k, bool take_root) const {
+    k_nearest_([&](size_type row) { return proj_row_dist_(row, x, f); },
+               [&](value_type d) { return take_root ? f.root(d) : d; }, nn,
+               k);
   }
 
   //--------------------------------------------------------------------------------
@@ -1051,7 +1472,7 @@ public:
   //--------------------------------------------------------------------------------
   /**
    * Finds the k-nearest neighbors to x, ignoring the zeros of each vector
-   * stored in this matrix.
+   * stored in this matrix. Same ordering as LpNearest.
    */
   template <typename InputIterator, typename OutputIterator>
   inline void projLpNearest(value_type p, InputIterator x, OutputIterator nn,
@@ -1070,9 +1491,18 @@ public:
                          << " - Should be >= 1, default is 1";
     } // End pre-conditions
 
-    std::vector<value_type> b(this->nRows());
-    projLpDist(p, x, b.begin(), take_root);
-    partial_sort_2nd(k, b, nn, std::less<value_type>());
+    if (p == (value_type)0.0) {
+      proj_k_nearest_(x, nn, Lp0<value_type>(), k, take_root);
+
+    } else if (p == (value_type)1.0) {
+      proj_k_nearest_(x, nn, Lp1<value_type>(), k, take_root);
+
+    } else if (p == (value_type)2.0) {
+      proj_k_nearest_(x, nn, Lp2<value_type>(), k, take_root);
+
+    } else {
+      proj_k_nearest_(x, nn, Lp<value_type>(p), k, take_root);
+    }
   }
 
   //--------------------------------------------------------------------------------
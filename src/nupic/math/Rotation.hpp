@@ -50,16 +50,18 @@ template <typename T> struct Rotation45 {
                      size_t z) {
     offset_ = size_t(T(ncols) * cos45); // Vertical offset
     for (int j = -1 * offset_; j != int(z - offset_); j++) {
+      // Row terms of the rotation, hoisted out of the inner loop
+      const T rj = cos45 * T(j), cj = -1 * cos45 * T(j);
+      T *out = rotated + size_t(j + offset_) * z;
       for (int i = 0; i != int(z); i++) {
         // Compute the nearest source pixel for this destination pixel
         // Multiply the destination pixel by the rotation matrix
-        srow_ = int(round(cos45 * T(j) + cos45 * T(i)));
-        scol_ = int(round(-1 * cos45 * T(j) + cos45 * T(i)));
-        if (0 <= srow_ && srow_ < int(nrows) && 0 <= scol_ &&
-            scol_ < int(ncols)) {
+        const T ci = cos45 * T(i);
+        const int srow = int(round(rj + ci));
+        const int scol = int(round(cj + ci));
+        if (0 <= srow && srow < int(nrows) && 0 <= scol && scol < int(ncols)) {
           // Copy the source pixel to the destination pixel
-          rotated[size_t(j + offset_) * z + i] =
-              original[srow_ * ncols + scol_];
+          out[i] = original[srow * ncols + scol];
         }
       }
     }
@@ -74,15 +76,18 @@ template <typename T> struct Rotation45 {
                        size_t z) {
     offset_ = size_t(T(ncols) * cos45); // Vertical offset
     for (size_t j = 0; j != nrows; j++) {
+      // Row term of the rotation, hoisted out of the inner loop
+      const T rj = cos45 * T(j);
+      T *out = unrotated + j * ncols;
       for (size_t i = 0; i != ncols; i++) {
         // Compute the nearest source pixel for this destination pixel
         // Multiply the destination pixel by the rotation matrix
-        srow_ = int(round(cos45 * T(j) + -1 * cos45 * T(i)));
-        scol_ = int(round(cos45 * T(j) + cos45 * T(i)));
-        srow_ += int(offset_);
-        if (0 <= srow_ && srow_ < int(z) && 0 <= scol_ && scol_ < int(z)) {
+        const T ci = cos45 * T(i);
+        const int srow = int(round(rj + -1 * ci)) + int(offset_);
+        const int scol = int(round(rj + ci));
+        if (0 <= srow && srow < int(z) && 0 <= scol && scol < int(z)) {
           // Copy the source pixel to the destination pixel
-          unrotated[j * ncols + i] = rotated[srow_ * z + scol_];
+          out[i] = rotated[srow * z + scol];
         }
       }
     }
@@ -0,0 +1,218 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Detection of the instruction sets of the CPU, and selection of the
+ * kernels.
+ */
+
+#include <nupic/math/Simd.hpp>
+#include <nupic/os/Env.hpp>
+#include <nupic/utils/Log.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define NTA_SIMD_X86_64 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace nupic {
+
+namespace simd {
+
+// Defined by SimdSse42.cpp, SimdAvx2.cpp and SimdAvx512.cpp. They return
+// null when the compiler did not get the flags of the instruction set.
+const Kernels *sse42Kernels_();
+const Kernels *avx2Kernels_();
+const Kernels *avx512Kernels_();
+
+std::atomic<const Kernels *> activeKernels_(nullptr);
+
+namespace {
+
+const char *const isaNames_[] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+const int numIsas_ = 4;
+
+struct CpuFeatures_ {
+  bool sse42;
+  bool avx2;
+  bool avx512;
+};
+
+#if defined(NTA_SIMD_X86_64)
+// eax, ebx, ecx and edx of a CPUID leaf
+void cpuid_(unsigned int leaf, unsigned int subleaf, unsigned int r[4]) {
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuidex(regs, (int)leaf, (int)subleaf);
+  for (int i = 0; i != 4; ++i)
+    r[i] = (unsigned int)regs[i];
+#else
+  __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// The register states the OS saves on context switches (XCR0)
+UInt64 xgetbv_() {
+#if defined(_MSC_VER)
+  return (UInt64)_xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((UInt64)edx << 32) | eax;
+#endif
+}
+#endif
+
+CpuFeatures_ detectCpuFeatures_() {
+  CpuFeatures_ features = {false, false, false};
+#if defined(NTA_SIMD_X86_64)
+  unsigned int r[4];
+  cpuid_(0, 0, r);
+  const unsigned int maxLeaf = r[0];
+  if (maxLeaf < 1)
+    return features;
+
+  cpuid_(1, 0, r);
+  features.sse42 = (r[2] & (1u << 20)) && (r[2] & (1u << 23)); // + POPCNT
+  const bool osxsave = (r[2] & (1u << 27)) != 0;
+  const bool avx = (r[2] & (1u << 28)) != 0;
+  if (!osxsave || !avx || maxLeaf < 7)
+    return features;
+
+  // The OS must save the YMM registers, and the ZMM and mask registers for
+  // AVX-512
+  const UInt64 xcr0 = xgetbv_();
+  if ((xcr0 & 0x6) != 0x6)
+    return features;
+
+  cpuid_(7, 0, r);
+  features.avx2 = (r[1] & (1u << 5)) != 0;
+  features.avx512 = features.avx2 && (xcr0 & 0xe6) == 0xe6 &&
+                    (r[1] & (1u << 16)) && // AVX512F
+                    (r[1] & (1u << 17)) && // AVX512DQ
+                    (r[1] & (1u << 30)) && // AVX512BW
+                    (r[1] & (1u << 31));   // AVX512VL
+#endif
+  return features;
+}
+
+// The kernels of each instruction set, null when unsupported
+struct Registry_ {
+  Kernels scalar;
+  const Kernels *kernels[numIsas_];
+
+  Registry_() : scalar(Kernels()) {
+    scalar.isa = Isa::SCALAR;
+    const CpuFeatures_ cpu = detectCpuFeatures_();
+    kernels[(int)Isa::SCALAR] = &scalar;
+    kernels[(int)Isa::SSE42] = cpu.sse42 ? sse42Kernels_() : nullptr;
+    kernels[(int)Isa::AVX2] = cpu.avx2 ? avx2Kernels_() : nullptr;
+    kernels[(int)Isa::AVX512] = cpu.avx512 ? avx512Kernels_() : nullptr;
+  }
+};
+
+const Registry_ &registry_() {
+  static const Registry_ registry;
+  return registry;
+}
+
+bool lookupIsa_(const std::string &name, Isa &isa) {
+  for (int i = 0; i != numIsas_; ++i) {
+    if (name == isaNames_[i]) {
+      isa = (Isa)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+const char *getIsaName(Isa isa) {
+  NTA_CHECK((int)isa >= 0 && (int)isa < numIsas_)
+      << "Invalid instruction set: " << (int)isa;
+  return isaNames_[(int)isa];
+}
+
+Isa parseIsa(const std::string &name) {
+  Isa isa;
+  if (!lookupIsa_(name, isa))
+    NTA_THROW << "Unknown instruction set '" << name
+              << "', expected scalar, sse4.2, avx2 or avx512";
+  return isa;
+}
+
+bool isSupported(Isa isa) {
+  return (int)isa >= 0 && (int)isa < numIsas_ &&
+         registry_().kernels[(int)isa] != nullptr;
+}
+
+Isa getBestIsa() {
+  int i = numIsas_ - 1;
+  while (!registry_().kernels[i])
+    --i;
+  return (Isa)i;
+}
+
+Isa getIsa() { return kernels().isa; }
+
+void setIsa(Isa isa) {
+  NTA_CHECK(isSupported(isa))
+      << "The instruction set " << getIsaName(isa) << " is not supported";
+  activeKernels_.store(registry_().kernels[(int)isa],
+                       std::memory_order_relaxed);
+}
+
+const Kernels &getKernels(Isa isa) {
+  NTA_CHECK(isSupported(isa))
+      << "The instruction set " << getIsaName(isa) << " is not supported";
+  return *registry_().kernels[(int)isa];
+}
+
+const Kernels &initializeKernels_() {
+  Isa isa = getBestIsa();
+  std::string name;
+  if (Env::get("NTA_SIMD_ISA", name)) {
+    Isa forced;
+    if (!lookupIsa_(name, forced)) {
+      NTA_WARN << "Ignoring unknown NTA_SIMD_ISA '" << name << "'";
+    } else if (!isSupported(forced)) {
+      NTA_WARN << "Ignoring NTA_SIMD_ISA: " << name
+               << " is not supported, using " << getIsaName(isa);
+    } else {
+      isa = forced;
+    }
+  }
+  // Threads racing here select the same kernels
+  const Kernels *k = registry_().kernels[(int)isa];
+  activeKernels_.store(k, std::memory_order_relaxed);
+  return *k;
+}
+
+} // namespace simd
+
+} // namespace nupic
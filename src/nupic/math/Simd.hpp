@@ -0,0 +1,155 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Runtime selection of the vectorized kernels of the core library.
+ *
+ * The library is compiled for the baseline of its target, so that one
+ * binary runs everywhere. The kernels that benefit from wider vectors are
+ * compiled again, in separate translation units, for SSE4.2, AVX2 and
+ * AVX-512, and the best version the CPU supports is selected with CPUID on
+ * first use. Setting the NTA_SIMD_ISA environment variable to scalar,
+ * sse4.2, avx2 or avx512 selects a lower version, e.g. to test them.
+ *
+ * Every version returns the same bits as the scalar code it replaces, so
+ * results never depend on the machine.
+ */
+
+#ifndef NTA_SIMD_HPP
+#define NTA_SIMD_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+namespace simd {
+
+/**
+ * Instruction sets with compiled kernels, in increasing order.
+ */
+enum class Isa { SCALAR = 0, SSE42 = 1, AVX2 = 2, AVX512 = 3 };
+
+/**
+ * The kernels of one instruction set. A null kernel has no vectorized
+ * version: the caller runs its own scalar loop.
+ */
+struct Kernels {
+  Isa isa;
+
+  // One row of a SparseMatrix<UInt32, Real32> against a dense vector x, see
+  // SparseRowKernels. Rows have at least 8 non-zeros.
+  Real32 (*sparseDot)(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                      const Real32 *x);
+  Real32 (*sparseSumAt)(const UInt32 *ind, UInt32 n, const Real32 *x);
+  Real32 (*sparseMaxProd)(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                          const Real32 *x);
+
+  // Distances of NearestNeighbor, see NearestNeighborKernels
+  Real32 (*l1Distance)(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                       const Real32 *x, const Real32 *px);
+  Real32 (*l2Distance)(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                       const Real32 *x, const Real32 *px);
+  Real32 (*lmaxDistance)(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                         const Real32 *x);
+
+  // Bit counts over n words, see packed_count in ArrayAlgo.hpp
+  size_t (*packedCount)(const UInt64 *a, size_t n);
+  size_t (*packedOverlap)(const UInt64 *a, const UInt64 *b, size_t n);
+  size_t (*packedUnionCount)(const UInt64 *a, const UInt64 *b, size_t n);
+  size_t (*packedXorCount)(const UInt64 *a, const UInt64 *b, size_t n);
+
+  // Arrays of fast_exp and fast_log, see Math.hpp
+  void (*exp)(const float *x, const float *x_end, float *y);
+  void (*log)(const float *x, const float *x_end, float *y);
+
+  // y[i] += a * x[i] for i in [0, n), the convolution step of GaborNode
+  void (*addScaled)(int *y, const int *x, int a, int n);
+
+  // y[j] += a * x[j] for j in [0, n), the filter taps of
+  // SeparableConvolution2D<float>
+  void (*axpy)(float a, const float *x, float *y, size_t n);
+
+  // out[j] = min or max of a[j], b[j] and c[j] for j in [0, n), the 3x3
+  // filter of Erosion<float>
+  void (*min3)(const float *a, const float *b, const float *c, float *out,
+               size_t n);
+  void (*max3)(const float *a, const float *b, const float *c, float *out,
+               size_t n);
+};
+
+/**
+ * Name of an instruction set, as accepted by parseIsa and NTA_SIMD_ISA.
+ */
+const char *getIsaName(Isa isa);
+
+/**
+ * The instruction set named name. Throws on unknown names.
+ */
+Isa parseIsa(const std::string &name);
+
+/**
+ * Whether the library has kernels for the instruction set, and the CPU
+ * and the OS support it.
+ */
+bool isSupported(Isa isa);
+
+/**
+ * The best supported instruction set.
+ */
+Isa getBestIsa();
+
+/**
+ * The instruction set of the kernels in use.
+ */
+Isa getIsa();
+
+/**
+ * Uses the kernels of an instruction set from now on. Throws if it is not
+ * supported. Must not be called while other threads run kernels.
+ */
+void setIsa(Isa isa);
+
+/**
+ * The kernels of an instruction set, which must be supported.
+ */
+const Kernels &getKernels(Isa isa);
+
+extern std::atomic<const Kernels *> activeKernels_;
+const Kernels &initializeKernels_();
+
+/**
+ * The kernels in use.
+ */
+inline const Kernels &kernels() {
+  const Kernels *k = activeKernels_.load(std::memory_order_relaxed);
+  return k ? *k : initializeKernels_();
+}
+
+} // namespace simd
+
+} // namespace nupic
+
+#endif // NTA_SIMD_HPP
@@ -0,0 +1,46 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * The AVX2 kernels. This file is compiled with the AVX2 flags of the
+ * compiler (see src/CMakeLists.txt), and only called on CPUs that support
+ * them.
+ */
+
+#include <nupic/math/SimdKernels.hpp>
+
+namespace nupic {
+
+namespace simd {
+
+const Kernels *avx2Kernels_() {
+#if defined(NTA_SIMD_AVX2)
+  static const Kernels kernels = makeKernels_(Isa::AVX2);
+  return &kernels;
+#else
+  return nullptr;
+#endif
+}
+
+} // namespace simd
+
+} // namespace nupic
@@ -0,0 +1,785 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * The vectorized kernels of Simd.hpp, for the instruction set enabled by
+ * the compiler flags of the translation unit that includes this file:
+ * SimdSse42.cpp, SimdAvx2.cpp or SimdAvx512.cpp. A kernel is compiled with
+ * the widest vectors the instruction set has, or left null when it would
+ * not beat the scalar loop of its caller.
+ *
+ * Everything here has internal linkage, and must not call the inline
+ * functions of other headers: their out-of-line copies would be compiled
+ * for the instruction set too, and the linker may keep those for the whole
+ * library.
+ */
+
+#ifndef NTA_SIMD_KERNELS_HPP
+#define NTA_SIMD_KERNELS_HPP
+
+#include <nupic/math/Simd.hpp>
+
+#if defined(__SSE4_2__) && defined(__POPCNT__)
+#define NTA_SIMD_SSE42 1
+#endif
+
+#if defined(__AVX2__)
+#define NTA_SIMD_AVX2 1
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) &&                          \
+    defined(__AVX512DQ__) && defined(__AVX512VL__)
+#define NTA_SIMD_AVX512 1
+#endif
+
+#if defined(NTA_SIMD_SSE42) || defined(NTA_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace nupic {
+
+namespace simd {
+
+namespace {
+
+#if defined(NTA_SIMD_SSE42) || defined(NTA_SIMD_AVX2)
+
+//--------------------------------------------------------------------------------
+// Bit counts
+//--------------------------------------------------------------------------------
+inline size_t popcount_(UInt64 w) {
+#if defined(__POPCNT__) || defined(_MSC_VER)
+  return (size_t)_mm_popcnt_u64(w);
+#else
+  w = w - ((w >> 1) & 0x5555555555555555ULL);
+  w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+  w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (size_t)((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Word operations for packedPopcount_
+struct First_ {
+  UInt64 operator()(UInt64 a, UInt64) const { return a; }
+#if defined(NTA_SIMD_AVX2)
+  __m256i operator()(__m256i a, __m256i) const { return a; }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512i operator()(__m512i a, __m512i) const { return a; }
+#endif
+};
+
+struct And_ {
+  UInt64 operator()(UInt64 a, UInt64 b) const { return a & b; }
+#if defined(NTA_SIMD_AVX2)
+  __m256i operator()(__m256i a, __m256i b) const {
+    return _mm256_and_si256(a, b);
+  }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512i operator()(__m512i a, __m512i b) const {
+    return _mm512_and_si512(a, b);
+  }
+#endif
+};
+
+struct Or_ {
+  UInt64 operator()(UInt64 a, UInt64 b) const { return a | b; }
+#if defined(NTA_SIMD_AVX2)
+  __m256i operator()(__m256i a, __m256i b) const {
+    return _mm256_or_si256(a, b);
+  }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512i operator()(__m512i a, __m512i b) const {
+    return _mm512_or_si512(a, b);
+  }
+#endif
+};
+
+struct Xor_ {
+  UInt64 operator()(UInt64 a, UInt64 b) const { return a ^ b; }
+#if defined(NTA_SIMD_AVX2)
+  __m256i operator()(__m256i a, __m256i b) const {
+    return _mm256_xor_si256(a, b);
+  }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512i operator()(__m512i a, __m512i b) const {
+    return _mm512_xor_si512(a, b);
+  }
+#endif
+};
+
+// Vector versions count the bits of each byte with a nibble lookup table,
+// and sum the bytes of each 64-bit lane with a SAD.
+template <typename Op>
+size_t packedPopcount_(const UInt64 *a, const UInt64 *b, size_t n) {
+  const Op op = Op();
+  size_t count = 0, i = 0;
+#if defined(NTA_SIMD_AVX512)
+  if (n >= 16) {
+    const __m512i lut = _mm512_broadcast_i32x4(_mm_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low = _mm512_set1_epi8(0x0f);
+    __m512i acc = _mm512_setzero_si512();
+    for (; i + 8 <= n; i += 8) {
+      __m512i v = op(_mm512_loadu_si512((const void *)(a + i)),
+                     _mm512_loadu_si512((const void *)(b + i)));
+      __m512i c = _mm512_add_epi8(
+          _mm512_shuffle_epi8(lut, _mm512_and_si512(v, low)),
+          _mm512_shuffle_epi8(lut,
+                              _mm512_and_si512(_mm512_srli_epi16(v, 4), low)));
+      acc = _mm512_add_epi64(acc, _mm512_sad_epu8(c, _mm512_setzero_si512()));
+    }
+    alignas(64) UInt64 lanes[8];
+    _mm512_store_si512((void *)lanes, acc);
+    for (int k = 0; k != 8; ++k)
+      count += (size_t)lanes[k];
+  }
+#elif defined(NTA_SIMD_AVX2)
+  if (n >= 8) {
+    const __m256i lut =
+        _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1,
+                         1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+      __m256i v = op(_mm256_loadu_si256((const __m256i *)(a + i)),
+                     _mm256_loadu_si256((const __m256i *)(b + i)));
+      __m256i c = _mm256_add_epi8(
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+          _mm256_shuffle_epi8(lut,
+                              _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+    }
+    alignas(32) UInt64 lanes[4];
+    _mm256_store_si256((__m256i *)lanes, acc);
+    count = (size_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+  }
+#endif
+  // Independent counts, which the popcnt units run in parallel
+  for (; i + 4 <= n; i += 4)
+    count += (popcount_(op(a[i], b[i])) + popcount_(op(a[i + 1], b[i + 1]))) +
+             (popcount_(op(a[i + 2], b[i + 2])) +
+              popcount_(op(a[i + 3], b[i + 3])));
+  for (; i != n; ++i)
+    count += popcount_(op(a[i], b[i]));
+  return count;
+}
+
+size_t packedCount_(const UInt64 *a, size_t n) {
+  return packedPopcount_<First_>(a, a, n);
+}
+
+//--------------------------------------------------------------------------------
+// Vectors of floats for the exp and log polynomials, with the operations of
+// the scalar PolyExpLog_ in Math.hpp. Each lane computes exactly what the
+// scalar version computes.
+//--------------------------------------------------------------------------------
+#if defined(NTA_SIMD_AVX512)
+struct Floats_ {
+  typedef __m512 V;
+  typedef __m512i I;
+  static const int width = 16;
+
+  static V load(const float *p) { return _mm512_loadu_ps(p); }
+  static void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+  static V set1(float c) { return _mm512_set1_ps(c); }
+  static V add(V a, V b) { return _mm512_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+  static V min(V a, V b) { return _mm512_min_ps(a, b); }
+  static V max(V a, V b) { return _mm512_max_ps(a, b); }
+  static V floor(V a) {
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  }
+  // v where a < b, 0 elsewhere
+  static V whereLess(V a, V b, V v) {
+    return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), v);
+  }
+
+  static I set1i(Int32 c) { return _mm512_set1_epi32(c); }
+  static I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+  static I subi(I a, I b) { return _mm512_sub_epi32(a, b); }
+  static I andi(I a, I b) { return _mm512_and_si512(a, b); }
+  static I ori(I a, I b) { return _mm512_or_si512(a, b); }
+  static I shl23(I a) { return _mm512_slli_epi32(a, 23); }
+  static I sar23(I a) { return _mm512_srai_epi32(a, 23); }
+  static I truncate(V a) { return _mm512_cvttps_epi32(a); }
+  static V convert(I a) { return _mm512_cvtepi32_ps(a); }
+  static I bits(V a) { return _mm512_castps_si512(a); }
+  static V floats(I a) { return _mm512_castsi512_ps(a); }
+};
+#elif defined(NTA_SIMD_AVX2)
+struct Floats_ {
+  typedef __m256 V;
+  typedef __m256i I;
+  static const int width = 8;
+
+  static V load(const float *p) { return _mm256_loadu_ps(p); }
+  static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+  static V set1(float c) { return _mm256_set1_ps(c); }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V floor(V a) { return _mm256_floor_ps(a); }
+  static V whereLess(V a, V b, V v) {
+    return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ), v);
+  }
+
+  static I set1i(Int32 c) { return _mm256_set1_epi32(c); }
+  static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+  static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+  static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+  static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+  static I shl23(I a) { return _mm256_slli_epi32(a, 23); }
+  static I sar23(I a) { return _mm256_srai_epi32(a, 23); }
+  static I truncate(V a) { return _mm256_cvttps_epi32(a); }
+  static V convert(I a) { return _mm256_cvtepi32_ps(a); }
+  static I bits(V a) { return _mm256_castps_si256(a); }
+  static V floats(I a) { return _mm256_castsi256_ps(a); }
+};
+#else
+struct Floats_ {
+  typedef __m128 V;
+  typedef __m128i I;
+  static const int width = 4;
+
+  static V load(const float *p) { return _mm_loadu_ps(p); }
+  static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+  static V set1(float c) { return _mm_set1_ps(c); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V min(V a, V b) { return _mm_min_ps(a, b); }
+  static V max(V a, V b) { return _mm_max_ps(a, b); }
+  static V floor(V a) { return _mm_floor_ps(a); }
+  static V whereLess(V a, V b, V v) {
+    return _mm_and_ps(_mm_cmplt_ps(a, b), v);
+  }
+
+  static I set1i(Int32 c) { return _mm_set1_epi32(c); }
+  static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+  static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+  static I andi(I a, I b) { return _mm_and_si128(a, b); }
+  static I ori(I a, I b) { return _mm_or_si128(a, b); }
+  static I shl23(I a) { return _mm_slli_epi32(a, 23); }
+  static I sar23(I a) { return _mm_srai_epi32(a, 23); }
+  static I truncate(V a) { return _mm_cvttps_epi32(a); }
+  static V convert(I a) { return _mm_cvtepi32_ps(a); }
+  static I bits(V a) { return _mm_castps_si128(a); }
+  static V floats(I a) { return _mm_castsi128_ps(a); }
+};
+#endif
+
+typedef Floats_ F;
+typedef F::V V;
+
+// The constants of PolyExpLog_
+const float exp_lo = -87.33654f, exp_hi = 88.37626f;
+const float log2e = 1.44269504088896341f;
+const float ln2_hi = 0.693359375f, ln2_lo = -2.12194440e-4f;
+const float sqrt_half = 0.707106781186547524f;
+
+inline V horner_(V y, V x, float c) { return F::add(F::mul(y, x), F::set1(c)); }
+
+V exp_(V x) {
+  x = F::min(F::max(x, F::set1(exp_lo)), F::set1(exp_hi));
+  const V fx = F::floor(F::add(F::mul(x, F::set1(log2e)), F::set1(0.5f)));
+  x = F::sub(x, F::mul(fx, F::set1(ln2_hi)));
+  x = F::sub(x, F::mul(fx, F::set1(ln2_lo)));
+  const V z = F::mul(x, x);
+  V y = F::set1(1.9875691500E-4f);
+  y = horner_(y, x, 1.3981999507E-3f);
+  y = horner_(y, x, 8.3334519073E-3f);
+  y = horner_(y, x, 4.1665795894E-2f);
+  y = horner_(y, x, 1.6666665459E-1f);
+  y = horner_(y, x, 5.0000001201E-1f);
+  y = F::add(F::mul(y, z), x);
+  y = F::add(y, F::set1(1.0f));
+  const F::I bits = F::shl23(F::addi(F::truncate(fx), F::set1i(127)));
+  return F::mul(y, F::floats(bits));
+}
+
+V log_(V x) {
+  F::I bits = F::bits(x);
+  V e = F::convert(F::subi(F::sar23(bits), F::set1i(126)));
+  bits = F::ori(F::andi(bits, F::set1i(0x807fffff)), F::set1i(0x3f000000));
+  V m = F::floats(bits);
+  const V h = F::set1(sqrt_half);
+  e = F::sub(e, F::whereLess(m, h, F::set1(1.0f)));
+  m = F::add(F::sub(m, F::set1(1.0f)), F::whereLess(m, h, m));
+  const V z = F::mul(m, m);
+  V y = F::set1(7.0376836292E-2f);
+  y = horner_(y, m, -1.1514610310E-1f);
+  y = horner_(y, m, 1.1676998740E-1f);
+  y = horner_(y, m, -1.2420140846E-1f);
+  y = horner_(y, m, 1.4249322787E-1f);
+  y = horner_(y, m, -1.6668057665E-1f);
+  y = horner_(y, m, 2.0000714765E-1f);
+  y = horner_(y, m, -2.4999993993E-1f);
+  y = horner_(y, m, 3.3333331174E-1f);
+  y = F::mul(y, m);
+  y = F::mul(y, z);
+  y = F::add(y, F::mul(e, F::set1(ln2_lo)));
+  y = F::add(y, F::mul(z, F::set1(-0.5f)));
+  m = F::add(m, y);
+  return F::add(m, F::mul(e, F::set1(ln2_hi)));
+}
+
+// The last values go through a vector padded with ones, which both
+// functions accept.
+template <V (*Op)(V)>
+void apply_(const float *x, const float *x_end, float *y) {
+  for (; x_end - x >= F::width; x += F::width, y += F::width)
+    F::store(y, Op(F::load(x)));
+  if (x != x_end) {
+    const int n = (int)(x_end - x);
+    alignas(64) float buf[F::width];
+    for (int k = 0; k != F::width; ++k)
+      buf[k] = k < n ? x[k] : 1.0f;
+    F::store(buf, Op(F::load(buf)));
+    for (int k = 0; k != n; ++k)
+      y[k] = buf[k];
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Integer convolution step
+//--------------------------------------------------------------------------------
+void addScaled_(int *y, const int *x, int a, int n) {
+  int i = 0;
+#if defined(NTA_SIMD_AVX512)
+  const __m512i va = _mm512_set1_epi32(a);
+  for (; i + 16 <= n; i += 16) {
+    __m512i vy = _mm512_loadu_si512((const void *)(y + i));
+    vy = _mm512_add_epi32(
+        vy, _mm512_mullo_epi32(_mm512_loadu_si512((const void *)(x + i)), va));
+    _mm512_storeu_si512((void *)(y + i), vy);
+  }
+#elif defined(NTA_SIMD_AVX2)
+  const __m256i va = _mm256_set1_epi32(a);
+  for (; i + 8 <= n; i += 8) {
+    __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));
+    vy = _mm256_add_epi32(
+        vy, _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(x + i)),
+                               va));
+    _mm256_storeu_si256((__m256i *)(y + i), vy);
+  }
+#else
+  const __m128i va = _mm_set1_epi32(a);
+  for (; i + 4 <= n; i += 4) {
+    __m128i vy = _mm_loadu_si128((const __m128i *)(y + i));
+    vy = _mm_add_epi32(
+        vy, _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(x + i)), va));
+    _mm_storeu_si128((__m128i *)(y + i), vy);
+  }
+#endif
+  for (; i < n; i++)
+    y[i] += a * x[i];
+}
+
+//--------------------------------------------------------------------------------
+// Filters of SeparableConvolution2D and Erosion
+//--------------------------------------------------------------------------------
+void axpy_(float a, const float *x, float *y, size_t n) {
+  size_t j = 0;
+#if defined(NTA_SIMD_AVX512)
+  const __m512 va = _mm512_set1_ps(a);
+  for (; j + 16 <= n; j += 16)
+    _mm512_storeu_ps(y + j, _mm512_add_ps(_mm512_loadu_ps(y + j),
+                                          _mm512_mul_ps(va, _mm512_loadu_ps(
+                                                                x + j))));
+#elif defined(NTA_SIMD_AVX2)
+  const __m256 va = _mm256_set1_ps(a);
+  for (; j + 8 <= n; j += 8)
+    _mm256_storeu_ps(y + j, _mm256_add_ps(_mm256_loadu_ps(y + j),
+                                          _mm256_mul_ps(va, _mm256_loadu_ps(
+                                                                x + j))));
+#else
+  const __m128 va = _mm_set1_ps(a);
+  for (; j + 4 <= n; j += 4)
+    _mm_storeu_ps(y + j, _mm_add_ps(_mm_loadu_ps(y + j),
+                                    _mm_mul_ps(va, _mm_loadu_ps(x + j))));
+#endif
+  for (; j != n; ++j)
+    y[j] += a * x[j];
+}
+
+// std::min(x, y) is (y < x) ? y : x, which is _mm_min_ps(y, x), and
+// likewise for std::max.
+struct Min_ {
+  float operator()(float x, float y) const { return y < x ? y : x; }
+  __m128 operator()(__m128 x, __m128 y) const { return _mm_min_ps(y, x); }
+#if defined(NTA_SIMD_AVX2)
+  __m256 operator()(__m256 x, __m256 y) const {
+    return _mm256_min_ps(y, x);
+  }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512 operator()(__m512 x, __m512 y) const {
+    return _mm512_min_ps(y, x);
+  }
+#endif
+};
+
+struct Max_ {
+  float operator()(float x, float y) const { return x < y ? y : x; }
+  __m128 operator()(__m128 x, __m128 y) const { return _mm_max_ps(y, x); }
+#if defined(NTA_SIMD_AVX2)
+  __m256 operator()(__m256 x, __m256 y) const {
+    return _mm256_max_ps(y, x);
+  }
+#endif
+#if defined(NTA_SIMD_AVX512)
+  __m512 operator()(__m512 x, __m512 y) const {
+    return _mm512_max_ps(y, x);
+  }
+#endif
+};
+
+// out[j] = op(op(a[j], b[j]), c[j])
+template <typename Op>
+void extremum3_(const float *a, const float *b, const float *c, float *out,
+                size_t n) {
+  const Op op = Op();
+  size_t j = 0;
+#if defined(NTA_SIMD_AVX512)
+  for (; j + 16 <= n; j += 16)
+    _mm512_storeu_ps(out + j,
+                     op(op(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j)),
+                        _mm512_loadu_ps(c + j)));
+#elif defined(NTA_SIMD_AVX2)
+  for (; j + 8 <= n; j += 8)
+    _mm256_storeu_ps(out + j,
+                     op(op(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j)),
+                        _mm256_loadu_ps(c + j)));
+#else
+  for (; j + 4 <= n; j += 4)
+    _mm_storeu_ps(out + j, op(op(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j)),
+                              _mm_loadu_ps(c + j)));
+#endif
+  for (; j != n; ++j)
+    out[j] = op(op(a[j], b[j]), c[j]);
+}
+
+#endif // NTA_SIMD_SSE42 || NTA_SIMD_AVX2
+
+#if defined(NTA_SIMD_AVX2)
+
+//--------------------------------------------------------------------------------
+// Sparse rows: 8 non-zeros at a time, using a gather for x, or 16 with
+// AVX-512. The lanes are combined in the order of the scalar loops of
+// SparseMatrix, see SparseRowKernels.
+//--------------------------------------------------------------------------------
+inline __m256 gather8_(const UInt32 *ind, const Real32 *x) {
+  return _mm256_i32gather_ps(x, _mm256_loadu_si256((const __m256i *)ind), 4);
+}
+
+#if defined(NTA_SIMD_AVX512)
+inline __m512 gather16_(const UInt32 *ind, const Real32 *x) {
+  return _mm512_i32gather_ps(_mm512_loadu_si512((const void *)ind), x, 4);
+}
+#endif
+
+// SparseMatrix::rightVecProd(row, x): val += a + b over pairs of products
+Real32 sparseDot_(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                  const Real32 *x) {
+  Real32 val = 0;
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  for (; i + 16 <= n; i += 16) {
+    __m512 p = _mm512_mul_ps(_mm512_loadu_ps(nz + i), gather16_(ind + i, x));
+    // even lanes hold p0+p1, p2+p3, ...
+    alignas(64) Real32 s[16];
+    _mm512_store_ps(s, _mm512_add_ps(p, _mm512_permute_ps(p, 0xb1)));
+    for (int k = 0; k != 16; k += 2)
+      val += s[k];
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    __m256 p = _mm256_mul_ps(_mm256_loadu_ps(nz + i), gather8_(ind + i, x));
+    // pair sums: lanes 0, 1, 4, 5 hold p0+p1, p2+p3, p4+p5, p6+p7
+    alignas(32) Real32 s[8];
+    _mm256_store_ps(s, _mm256_hadd_ps(p, p));
+    val += s[0];
+    val += s[1];
+    val += s[4];
+    val += s[5];
+  }
+  if (i + 4 <= n) {
+    Real32 a = nz[i] * x[ind[i]], b = nz[i + 1] * x[ind[i + 1]];
+    val += a + b;
+    a = nz[i + 2] * x[ind[i + 2]];
+    b = nz[i + 3] * x[ind[i + 3]];
+    val += a + b;
+    i += 4;
+  }
+  for (; i != n; ++i)
+    val += nz[i] * x[ind[i]];
+  return val;
+}
+
+// SparseMatrix::rightVecSumAtNZ: val += x0 + x1 + x2 + x3 by groups of 4
+Real32 sparseSumAt_(const UInt32 *ind, UInt32 n, const Real32 *x) {
+  Real32 val = 0;
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  for (; i + 16 <= n; i += 16) {
+    __m512 g = gather16_(ind + i, x);
+    // lanes 0, 4, 8 and 12 accumulate ((x0 + x1) + x2) + x3 for their group
+    __m512 t = _mm512_add_ps(g, _mm512_permute_ps(g, 1));
+    t = _mm512_add_ps(t, _mm512_permute_ps(g, 2));
+    t = _mm512_add_ps(t, _mm512_permute_ps(g, 3));
+    alignas(64) Real32 s[16];
+    _mm512_store_ps(s, t);
+    val += s[0];
+    val += s[4];
+    val += s[8];
+    val += s[12];
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    __m256 g = gather8_(ind + i, x);
+    // lanes 0 and 4 accumulate ((x0 + x1) + x2) + x3 and the same for
+    // x4..x7
+    __m256 t = _mm256_add_ps(g, _mm256_permute_ps(g, 1));
+    t = _mm256_add_ps(t, _mm256_permute_ps(g, 2));
+    t = _mm256_add_ps(t, _mm256_permute_ps(g, 3));
+    val += _mm256_cvtss_f32(t);
+    val += _mm_cvtss_f32(_mm256_extractf128_ps(t, 1));
+  }
+  if (i + 4 <= n) {
+    val += x[ind[i]] + x[ind[i + 1]] + x[ind[i + 2]] + x[ind[i + 3]];
+    i += 4;
+  }
+  for (; i != n; ++i)
+    val += x[ind[i]];
+  return val;
+}
+
+// SparseMatrix::vecMaxProd: the first product that reaches the max.
+// Lanes keep their own running max, starting from the first product, and
+// only move on a strictly greater product, like the scalar loop. The
+// lanes can only disagree with it on the sign of a zero max, which is
+// recomputed in order.
+Real32 sparseMaxProd_(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                      const Real32 *x) {
+  const Real32 first = nz[0] * x[ind[0]];
+  Real32 max_v = first;
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  __m512 m16 = _mm512_set1_ps(first);
+  for (; i + 16 <= n; i += 16) {
+    __m512 p = _mm512_mul_ps(_mm512_loadu_ps(nz + i), gather16_(ind + i, x));
+    m16 = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(p, m16, _CMP_GT_OQ), m16,
+                               p);
+  }
+  alignas(64) Real32 lanes16[16];
+  _mm512_store_ps(lanes16, m16);
+  for (int k = 0; k != 16; ++k)
+    if (lanes16[k] > max_v)
+      max_v = lanes16[k];
+#endif
+  __m256 m = _mm256_set1_ps(first);
+  for (; i + 8 <= n; i += 8) {
+    __m256 p = _mm256_mul_ps(_mm256_loadu_ps(nz + i), gather8_(ind + i, x));
+    m = _mm256_blendv_ps(m, p, _mm256_cmp_ps(p, m, _CMP_GT_OQ));
+  }
+  alignas(32) Real32 lanes[8];
+  _mm256_store_ps(lanes, m);
+  for (int k = 0; k != 8; ++k)
+    if (lanes[k] > max_v)
+      max_v = lanes[k];
+  for (; i != n; ++i) {
+    Real32 p = nz[i] * x[ind[i]];
+    if (p > max_v)
+      max_v = p;
+  }
+  if (max_v == 0) {
+    max_v = first;
+    for (i = 0; i != n; ++i) {
+      Real32 p = nz[i] * x[ind[i]];
+      if (p > max_v)
+        max_v = p;
+    }
+  }
+  return max_v;
+}
+
+//--------------------------------------------------------------------------------
+// Distances of NearestNeighbor: term i goes to lane i % 8, see
+// NearestNeighborKernels. With AVX-512, the two halves of 16 terms are
+// added to the 8 lanes one after the other.
+//--------------------------------------------------------------------------------
+inline Real32 fabs_(Real32 x) { return x < 0 ? -x : (x == 0 ? 0.0f : x); }
+
+inline __m256 absDiff8_(const Real32 *nz, const Real32 *x, __m256i vi) {
+  __m256 d =
+      _mm256_sub_ps(_mm256_loadu_ps(nz), _mm256_i32gather_ps(x, vi, 4));
+  return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), d);
+}
+
+#if defined(NTA_SIMD_AVX512)
+inline __m512 absDiff16_(const Real32 *nz, const Real32 *x, __m512i vi) {
+  return _mm512_abs_ps(
+      _mm512_sub_ps(_mm512_loadu_ps(nz), _mm512_i32gather_ps(vi, x, 4)));
+}
+
+// l += lo(t), then l += hi(t)
+inline __m256 addHalves_(__m256 l, __m512 t) {
+  l = _mm256_add_ps(l, _mm512_castps512_ps256(t));
+  return _mm256_add_ps(l, _mm512_extractf32x8_ps(t, 1));
+}
+#endif
+
+inline Real32 lanes_(__m256 l) {
+  __m128 t =
+      _mm_add_ps(_mm256_castps256_ps128(l), _mm256_extractf128_ps(l, 1));
+  __m128 u = _mm_add_ps(t, _mm_movehl_ps(t, t));
+  return _mm_cvtss_f32(_mm_add_ss(u, _mm_shuffle_ps(u, u, 1)));
+}
+
+Real32 l1Distance_(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                   const Real32 *x, const Real32 *px) {
+  __m256 l = _mm256_setzero_ps();
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  for (; i + 16 <= n; i += 16) {
+    __m512i vi = _mm512_loadu_si512((const void *)(ind + i));
+    l = addHalves_(l, _mm512_sub_ps(absDiff16_(nz + i, x, vi),
+                                    _mm512_i32gather_ps(vi, px, 4)));
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    __m256i vi = _mm256_loadu_si256((const __m256i *)(ind + i));
+    __m256 t = _mm256_sub_ps(absDiff8_(nz + i, x, vi),
+                             _mm256_i32gather_ps(px, vi, 4));
+    l = _mm256_add_ps(l, t);
+  }
+  Real32 s = lanes_(l);
+  for (; i != n; ++i)
+    s += fabs_(nz[i] - x[ind[i]]) - px[ind[i]];
+  return s;
+}
+
+Real32 l2Distance_(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                   const Real32 *x, const Real32 *px) {
+  __m256 l = _mm256_setzero_ps();
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  for (; i + 16 <= n; i += 16) {
+    __m512i vi = _mm512_loadu_si512((const void *)(ind + i));
+    __m512 d = _mm512_sub_ps(_mm512_loadu_ps(nz + i),
+                             _mm512_i32gather_ps(vi, x, 4));
+    l = addHalves_(l, _mm512_sub_ps(_mm512_mul_ps(d, d),
+                                    _mm512_i32gather_ps(vi, px, 4)));
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    __m256i vi = _mm256_loadu_si256((const __m256i *)(ind + i));
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(nz + i),
+                             _mm256_i32gather_ps(x, vi, 4));
+    __m256 t = _mm256_sub_ps(_mm256_mul_ps(d, d),
+                             _mm256_i32gather_ps(px, vi, 4));
+    l = _mm256_add_ps(l, t);
+  }
+  Real32 s = lanes_(l);
+  for (; i != n; ++i) {
+    const Real32 d = nz[i] - x[ind[i]];
+    s += d * d - px[ind[i]];
+  }
+  return s;
+}
+
+Real32 lmaxDistance_(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                     const Real32 *x) {
+  __m256 m = _mm256_setzero_ps();
+  UInt32 i = 0;
+#if defined(NTA_SIMD_AVX512)
+  __m512 m16 = _mm512_setzero_ps();
+  for (; i + 16 <= n; i += 16)
+    m16 = _mm512_max_ps(
+        m16, absDiff16_(nz + i, x,
+                        _mm512_loadu_si512((const void *)(ind + i))));
+  m = _mm256_max_ps(_mm512_castps512_ps256(m16),
+                    _mm512_extractf32x8_ps(m16, 1));
+#endif
+  for (; i + 8 <= n; i += 8)
+    m = _mm256_max_ps(
+        m, absDiff8_(nz + i, x, _mm256_loadu_si256((const __m256i *)(ind + i))));
+  __m128 h =
+      _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+  h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+  h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+  Real32 r = _mm_cvtss_f32(h);
+  for (; i != n; ++i) {
+    const Real32 d = fabs_(nz[i] - x[ind[i]]);
+    if (d > r)
+      r = d;
+  }
+  return r;
+}
+
+#endif // NTA_SIMD_AVX2
+
+#if defined(NTA_SIMD_SSE42) || defined(NTA_SIMD_AVX2)
+/**
+ * The kernels compiled in this translation unit, the others being null.
+ */
+Kernels makeKernels_(Isa isa) {
+  Kernels k = Kernels();
+  k.isa = isa;
+#if defined(NTA_SIMD_SSE42) || defined(NTA_SIMD_AVX2)
+  k.packedCount = packedCount_;
+  k.packedOverlap = packedPopcount_<And_>;
+  k.packedUnionCount = packedPopcount_<Or_>;
+  k.packedXorCount = packedPopcount_<Xor_>;
+  k.exp = apply_<exp_>;
+  k.log = apply_<log_>;
+  k.addScaled = addScaled_;
+  k.axpy = axpy_;
+  k.min3 = extremum3_<Min_>;
+  k.max3 = extremum3_<Max_>;
+#endif
+#if defined(NTA_SIMD_AVX2)
+  k.sparseDot = sparseDot_;
+  k.sparseSumAt = sparseSumAt_;
+  k.sparseMaxProd = sparseMaxProd_;
+  k.l1Distance = l1Distance_;
+  k.l2Distance = l2Distance_;
+  k.lmaxDistance = lmaxDistance_;
+#endif
+  return k;
+}
+#endif
+
+} // namespace
+
+} // namespace simd
+
+} // namespace nupic
+
+#endif // NTA_SIMD_KERNELS_HPP
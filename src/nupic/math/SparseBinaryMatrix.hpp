@@ -28,6 +28,7 @@
 #define NTA_SPARSE_BINARY_MATRIX_HPP
 
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include <nupic/math/ArrayAlgo.hpp>
@@ -35,12 +36,20 @@
 #include <nupic/math/StlIo.hpp>
 #include <nupic/proto/SparseBinaryMatrixProto.capnp.h>
 #include <nupic/types/Serializable.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace nupic {
 
 /**
  * A matrix of 0 and 1, where only the indices of the 1s are stored.
  *
+ * The indices of all the rows live in a single contiguous array (CSR
+ * layout), rather than in one heap block per row. Each row owns a slice
+ * of that array, which can be larger than the row: a row that is replaced
+ * or grown is rewritten in place when it fits in its slice, and moved to
+ * the end of the array otherwise. The slices left behind are reclaimed
+ * once they make up half of the array, or by compact().
+ *
  * WATCH OUT! That the U type doesn't become too small to store parameters
  * of the matrix, such as total number of non-zeros.
  *
@@ -52,36 +61,76 @@ public:
   typedef UI2 nz_index_type;
   typedef std::vector<nz_index_type> Row;
 
+  /**
+   * Read-only view of the indices of the non-zeros of a row. It is
+   * invalidated by any operation that modifies the matrix. Converts
+   * implicitly to a Row, for callers that need a copy.
+   */
+  class RowView {
+  public:
+    typedef nz_index_type value_type;
+    typedef const nz_index_type *const_iterator;
+    typedef const_iterator iterator;
+
+    inline RowView() : begin_(nullptr), end_(nullptr) {}
+    inline RowView(const_iterator begin, const_iterator end)
+        : begin_(begin), end_(end) {}
+
+    inline const_iterator begin() const { return begin_; }
+    inline const_iterator end() const { return end_; }
+    inline size_t size() const { return (size_t)(end_ - begin_); }
+    inline bool empty() const { return begin_ == end_; }
+    inline nz_index_type operator[](size_t i) const { return begin_[i]; }
+
+    inline operator Row() const { return Row(begin_, end_); }
+
+  private:
+    const_iterator begin_, end_;
+  };
+
 private:
+  // Slice of nz_ owned by a row: the row is stored in
+  // nz_[begin, begin + size), and can grow up to begin + capacity.
+  struct RowExtent_ {
+    size_t begin;
+    size_type size;
+    size_type capacity;
+  };
+
   nz_index_type ncols_;
-  std::vector<Row> ind_; // indices of the non-zeros
+  std::vector<RowExtent_> rows_;
+  std::vector<nz_index_type> nz_; // indices of the non-zeros
+  size_t holes_;                  // slots of nz_ that no row owns
   Row buffer_;
 
 public:
-  inline SparseBinaryMatrix() : ncols_(0), ind_(), buffer_() {}
+  inline SparseBinaryMatrix()
+      : ncols_(0), rows_(), nz_(), holes_(0), buffer_() {}
 
   inline SparseBinaryMatrix(std::istream &inStream)
-      : ncols_(0), ind_(), buffer_() {
+      : ncols_(0), rows_(), nz_(), holes_(0), buffer_() {
     fromCSR(inStream);
   }
 
   template <typename InputIterator>
   inline SparseBinaryMatrix(size_type nrows, size_type ncols,
                             InputIterator begin, InputIterator end)
-      : ncols_(0), ind_(), buffer_() {
+      : ncols_(0), rows_(), nz_(), holes_(0), buffer_() {
     fromDense(nrows, ncols, begin, end);
   }
 
-  inline SparseBinaryMatrix(size_type ncols) : ncols_(0), ind_(), buffer_() {
+  inline SparseBinaryMatrix(size_type ncols)
+      : ncols_(0), rows_(), nz_(), holes_(0), buffer_() {
     nCols(ncols);
     buffer_.resize(nCols());
   }
 
   inline SparseBinaryMatrix(size_type nrows, size_type ncols)
-      : ncols_(ncols), ind_(nrows), buffer_(ncols) {}
+      : ncols_(ncols), rows_(nrows, RowExtent_()), nz_(), holes_(0),
+        buffer_(ncols) {}
 
   inline SparseBinaryMatrix(const SparseBinaryMatrix &o)
-      : ncols_(0), ind_(), buffer_() {
+      : ncols_(0), rows_(), nz_(), holes_(0), buffer_() {
     copy(o);
   }
 
@@ -93,19 +142,14 @@ public:
   }
 
   inline void copy(const SparseBinaryMatrix &o) {
-    ind_.clear();
-    ind_.resize(o.nRows());
-    for (size_type r = 0; r != o.nRows(); ++r)
-      ind_[r].insert(ind_[r].end(), o.ind_[r].begin(), o.ind_[r].end());
+    rows_ = o.rows_;
+    nz_ = o.nz_;
+    holes_ = o.holes_;
     nCols(o.nCols());
     buffer_.resize(nCols());
   }
 
-  inline ~SparseBinaryMatrix() {
-    ind_.clear();
-    ncols_ = 0;
-    buffer_.clear();
-  }
+  inline ~SparseBinaryMatrix() {}
 
   /**
    * Fills this matrix with random rows that all have the same number of
@@ -123,9 +167,8 @@ public:
       buffer_[i] = i;
 
     for (size_type i = 0; i != nRows(); ++i) {
-      ind_[i].resize(nnz);
       std::random_shuffle(buffer_.begin(), buffer_.end(), rng);
-      std::copy(buffer_.begin(), buffer_.begin() + nnz, ind_[i].begin());
+      replaceSparseRow_(i, buffer_.begin(), buffer_.begin() + nnz);
     }
 
     NTA_ASSERT(nRows());
@@ -145,22 +188,20 @@ public:
       return std::string("sm_01_1.0");
   }
 
-  inline size_type nRows() const { return ind_.size(); }
+  inline size_type nRows() const { return (size_type)rows_.size(); }
 
   inline nz_index_type nCols() const { return ncols_; }
 
-  inline size_type capacity() const {
-    size_type n = 0;
-    for (size_type i = 0; i != nRows(); ++i)
-      n += ind_[i].capacity();
-    return n;
-  }
+  /**
+   * Number of indices that the storage of this matrix can hold without
+   * reallocating.
+   */
+  inline size_type capacity() const { return (size_type)nz_.capacity(); }
 
   inline size_type nBytes() const {
     size_type n = sizeof(SparseBinaryMatrix);
-    n += ind_.capacity() * sizeof(Row);
-    for (size_type i = 0; i != nRows(); ++i)
-      n += ind_[i].capacity() * sizeof(nz_index_type);
+    n += rows_.capacity() * sizeof(RowExtent_);
+    n += nz_.capacity() * sizeof(nz_index_type);
     n += buffer_.capacity() * sizeof(nz_index_type);
     return n;
   }
@@ -173,14 +214,7 @@ public:
     if (capacity() == nNonZeros() && buffer_.size() == buffer_.capacity())
       return;
 
-    for (size_type i = 0; i != nRows(); ++i) {
-      if (ind_[i].capacity() != ind_[i].size()) {
-        Row buffer;
-        buffer.reserve(ind_[i].size());
-        buffer.insert(buffer.end(), ind_[i].begin(), ind_[i].end());
-        ind_[i].swap(buffer);
-      }
-    }
+    repack_(nRows(), 0);
 
     Row sized_row(nCols());
     buffer_.swap(sized_row);
@@ -188,13 +222,25 @@ public:
     NTA_ASSERT(capacity() == nNonZeros());
   }
 
+  /**
+   * Preallocates storage for nrows rows and nnz non-zeros, so that a matrix
+   * built row by row with appendSparseRow does not reallocate.
+   */
+  inline void reserve(size_type nrows, size_type nnz) {
+    rows_.reserve(nrows);
+    nz_.reserve(nnz);
+  }
+
   /**
    * Deallocates memory used by this instance. Doesn't change the number of rows
    * or columns.
    */
   inline void clear() {
-    std::vector<Row> empty;
-    ind_.swap(empty);
+    std::vector<RowExtent_> empty;
+    rows_.swap(empty);
+    std::vector<nz_index_type> empty1;
+    nz_.swap(empty1);
+    holes_ = 0;
     Row empty2;
     buffer_.swap(empty2);
     ncols_ = 0;
@@ -214,10 +260,9 @@ public:
     }
 
     if (new_ncols < nCols()) {
-      typename Row::iterator c;
       for (size_type i = 0; i != nRows(); ++i) {
-        c = std::lower_bound(ind_[i].begin(), ind_[i].end(), new_ncols);
-        ind_[i].erase(c, ind_[i].end());
+        const nz_index_type *b = row_begin_(i), *e = row_end_(i);
+        rows_[i].size = (size_type)(std::lower_bound(b, e, new_ncols) - b);
       }
     }
 
@@ -226,11 +271,13 @@ public:
 
     if (new_nrows < nRows()) {
 
-      ind_.erase(ind_.begin() + new_nrows, ind_.end());
+      for (size_type i = new_nrows; i != nRows(); ++i)
+        holes_ += rows_[i].capacity;
+      rows_.erase(rows_.begin() + new_nrows, rows_.end());
 
     } else if (new_nrows > nRows()) {
 
-      ind_.resize(new_nrows);
+      rows_.resize(new_nrows, RowExtent_());
     }
   }
 
@@ -246,7 +293,7 @@ public:
 
     size_type counter = 0;
     for (size_type r = 0; r != nRows(); ++r, ++it)
-      if (ind_[r].size() == 0) {
+      if (row_(r).size() == 0) {
         *it = true;
         ++counter;
       } else {
@@ -267,7 +314,7 @@ public:
 
     size_type counter = 0;
     for (size_type r = 0; r != nRows(); ++r, ++it)
-      if (!ind_[r].empty()) {
+      if (!row_(r).empty()) {
         *it = true;
         ++counter;
       } else {
@@ -284,7 +331,7 @@ public:
           << " - Should be 0 <= and < n rows = " << nRows();
     } // End pre-conditions
 
-    return ind_[row].size();
+    return rows_[row].size;
   }
 
   inline size_type nNonZeros() const {
@@ -314,12 +361,11 @@ public:
           << "Not enough memory";
     } // End pre-conditions
 
-    typename std::vector<Row>::const_iterator row;
-    typename Row::const_iterator j;
+    const nz_index_type *j, *j_end = nz_.data();
 
     std::fill(begin, end, (size_type)0);
-    for (row = ind_.begin(); row != ind_.end(); ++row)
-      for (j = row->begin(); j != row->end(); ++j)
+    for (size_type row = 0; row != nRows(); ++row)
+      for (j = row_begin_(row), j_end = row_end_(row); j != j_end; ++j)
         *(begin + *j) += 1;
   }
 
@@ -334,12 +380,12 @@ public:
       NTA_ASSERT(col_begin <= col_end);
     } // End pre-conditions
 
-    typename Row::const_iterator c1, c2;
-    c1 = std::lower_bound(ind_[row].begin(), ind_[row].end(), col_begin);
+    typename RowView::const_iterator c1, c2;
+    c1 = std::lower_bound(row_(row).begin(), row_(row).end(), col_begin);
     if (col_end == nCols())
-      c2 = ind_[row].end();
+      c2 = row_(row).end();
     else
-      c2 = std::lower_bound(c1, ind_[row].end(), col_end);
+      c2 = std::lower_bound(c1, row_(row).end(), col_end);
 
     return (size_type)(c2 - c1);
   }
@@ -438,10 +484,10 @@ public:
           << " - Should be < number of columns: " << nCols();
     } // End pre-conditions
 
-    typename Row::const_iterator it =
-        std::lower_bound(ind_[row].begin(), ind_[row].end(), col);
+    typename RowView::const_iterator it =
+        std::lower_bound(row_(row).begin(), row_(row).end(), col);
 
-    if (it == ind_[row].end() || *it != col)
+    if (it == row_(row).end() || *it != col)
       return (size_type)0;
     else
       return (size_type)1;
@@ -469,7 +515,7 @@ public:
   template <typename OutputIterator1>
   inline void getAllNonZeros(OutputIterator1 nz_i, OutputIterator1 nz_j) const {
     for (size_type i = 0; i != nRows(); ++i) {
-      const Row &row = ind_[i];
+      const RowView row = row_(i);
       for (size_type k = 0; k != row.size(); ++k) {
         *nz_i++ = i;
         *nz_j++ = row[k];
@@ -542,7 +588,6 @@ public:
 
     clear();
     ncols_ = ncols;
-    ind_.resize(nrows);
     buffer_.resize(ncols);
 
     std::vector<size_type> nnzr(nrows, 0);
@@ -552,11 +597,8 @@ public:
       for (InputIterator1 it = nz_i; it != nz_i_end; ++it)
         ++nnzr[*it];
 
-      for (size_type i = 0; i != nrows; ++i) {
-        ind_[i].resize(nnzr[i]);
-        for (size_type k = 0; k != nnzr[i]; ++k)
-          ind_[i][k] = *nz_j++;
-      }
+      layout_(nrows, nnzr.begin());
+      nz_.assign(nz_j, nz_j_end);
 
     } else {
 
@@ -574,11 +616,10 @@ public:
         }
       }
 
-      it = s.begin();
-
-      for (size_type i = 0; i != nrows; ++i)
-        for (size_type k = 0; k != nnzr[i]; ++k, ++it)
-          ind_[i].push_back(it->second);
+      layout_(nrows, nnzr.begin());
+      nz_index_type *nz = nz_.data();
+      for (it = s.begin(); it != s.end(); ++it)
+        *nz++ = (nz_index_type)it->second;
     }
   }
 
@@ -594,20 +635,24 @@ public:
           << " - Should be < number of columns: " << nCols();
     } // End pre-conditions
 
-    typename Row::iterator it;
-    it = std::lower_bound(ind_[row].begin(), ind_[row].end(), col);
+    RowExtent_ &r = rows_[row];
+    nz_index_type *b = nz_.data() + r.begin, *e = b + r.size;
+    nz_index_type *it = std::lower_bound(b, e, (nz_index_type)col);
 
     if (nupic::nearlyZero(val)) {
 
-      if (it != ind_[row].end() && *it == col)
-        ind_[row].erase(it);
+      if (it != e && *it == col) {
+        std::copy(it + 1, e, it);
+        --r.size;
+      }
 
-    } else {
+    } else if (it == e || *it != col) {
 
-      if (it == ind_[row].end())
-        ind_[row].push_back(col);
-      else if (*it != col)
-        ind_[row].insert(it, col);
+      size_type k = (size_type)(it - b);
+      b = grow_row_(row, r.size + 1);
+      std::copy_backward(b + k, b + r.size, b + r.size + 1);
+      b[k] = (nz_index_type)col;
+      ++r.size;
     }
   }
 
@@ -635,33 +680,78 @@ public:
       set(row, ind, ind_end, val);
   }
 
-  inline typename Row::const_iterator ind_begin_(const size_type row) const {
-    return ind_[row].begin();
+  inline const nz_index_type *ind_begin_(const size_type row) const {
+    return row_begin_(row);
   }
 
-  inline typename Row::const_iterator ind_end_(const size_type row) const {
-    return ind_[row].end();
+  inline const nz_index_type *ind_end_(const size_type row) const {
+    return row_end_(row);
   }
 
-  inline const Row &getSparseRow(size_type row) const {
+  /**
+   * Returns a view of the indices of the non-zeros of row. The view is
+   * invalidated by any modification of this matrix: assign it to a Row to
+   * keep a copy.
+   */
+  inline RowView getSparseRow(size_type row) const {
     { // Pre-conditions
       NTA_ASSERT(/*0 <= row &&*/ row < nRows())
           << "SparseBinaryMatrix::getSparseRow: Invalid row index: " << row
           << " - Should be < number of rows: " << nRows();
     } // End pre-conditions
 
-    return ind_[row];
+    return row_(row);
   }
 
+  /**
+   * Appends a row, given by the indices of its non-zeros. The row is stored
+   * right after the last row, so that a matrix built by appending rows, after
+   * a call to reserve(), is laid out contiguously without reallocations.
+   */
   template <typename InputIterator>
   inline void appendSparseRow(InputIterator begin, InputIterator end) {
     { // Pre-conditions
       sparse_row_invariants_(begin, end, "appendSparseRow");
     } // End pre-conditions
 
-    ind_.resize(nRows() + 1);
-    Row &row = ind_[ind_.size() - 1];
-    row.insert(row.end(), begin, end);
+    rows_.push_back(RowExtent_());
+    replaceSparseRow_(nRows() - 1, begin, end);
+  }
+
+  /**
+   * Replaces the contents of this matrix by nrows rows in compressed sparse
+   * row format: the indices of the non-zeros of row i are
+   * indices[offsets[i], offsets[i+1]). offsets has nrows + 1 elements, and
+   * the indices of each row need to be in strictly increasing order.
+   * The indices are copied in one pass, without per-row allocations.
+   */
+  template <typename OffsetIterator, typename IndexIterator>
+  inline void fromCSR(size_type nrows, size_type ncols, OffsetIterator offsets,
+                      IndexIterator indices) {
+    clear();
+    nCols(ncols);
+    buffer_.resize(nCols());
+
+    { // Pre-conditions
+      NTA_ASSERT(*offsets == 0)
+          << "SparseBinaryMatrix::fromCSR: "
+          << "Offsets need to start at 0";
+      for (size_type i = 0; i != nrows; ++i) {
+        NTA_ASSERT(offsets[i] <= offsets[i + 1])
+            << "SparseBinaryMatrix::fromCSR: "
+            << "Offsets need to be non-decreasing";
+        sparse_row_invariants_(indices + offsets[i], indices + offsets[i + 1],
+                               "fromCSR");
+      }
+    } // End pre-conditions
+
+    rows_.resize(nrows);
+    for (size_type i = 0; i != nrows; ++i) {
+      rows_[i].begin = (size_t)offsets[i];
+      rows_[i].size = rows_[i].capacity =
+          (size_type)(offsets[i + 1] - offsets[i]);
+    }
+    nz_.assign(indices, indices + (size_t)offsets[nrows]);
   }
 
   template <typename InputIterator>
@@ -673,11 +763,13 @@ public:
           << " - Should be equal to number of columns: " << nCols();
     } // End pre-conditions
 
-    ind_.resize(nRows() + 1);
-    Row &row = ind_[ind_.size() - 1];
+    size_type k = 0;
     for (nz_index_type j = 0; j != nCols(); ++j, ++begin)
       if (!nupic::nearlyZero(*begin))
-        row.push_back(j);
+        buffer_[k++] = j;
+
+    rows_.push_back(RowExtent_());
+    replaceSparseRow_(nRows() - 1, buffer_.begin(), buffer_.begin() + k);
   }
 
   inline void appendEmptyCols(size_type n) {
@@ -694,12 +786,21 @@ public:
           << " - Should be less than number of rows: " << nRows();
     } // End pre-conditions
 
-    for (; ind != ind_end; ++ind)
-      ind_[*ind].push_back(ncols_);
+    for (; ind != ind_end; ++ind) {
+      size_type row = *ind;
+      nz_index_type *b = grow_row_(row, rows_[row].size + 1);
+      b[rows_[row].size++] = ncols_;
+    }
 
     ++ncols_;
+    buffer_.resize(ncols_);
   }
 
+  /**
+   * Replaces the non-zeros of row. The new indices overwrite the old ones in
+   * place if there are not more of them than the row had room for.
+   * [begin, end) must not point into this matrix.
+   */
   template <typename InputIterator>
   inline void replaceSparseRow(size_type row, InputIterator begin,
                                InputIterator end) {
@@ -711,11 +812,7 @@ public:
       sparse_row_invariants_(begin, end, "replaceSparseRow");
     } // End pre-conditions
 
-    size_type n = (size_type)(end - begin);
-    ind_[row].resize(n);
-
-    for (nz_index_type i = 0; i != n; ++i)
-      ind_[row][i] = *begin++;
+    replaceSparseRow_(row, begin, end);
   }
 
   template <typename InputIterator>
@@ -729,7 +826,7 @@ public:
     for (size_type row = 0; row != nRows(); ++row) {
       if (nNonZerosOnRow(row) != nnzr)
         continue;
-      if (std::equal(begin, end, ind_[row].begin()))
+      if (std::equal(begin, end, row_(row).begin()))
         return row;
     }
 
@@ -770,8 +867,8 @@ public:
 
       size_type d = 0;
       InputIterator it = begin;
-      typename Row::const_iterator begin1 = ind_[row].begin();
-      typename Row::const_iterator end1 = ind_[row].end();
+      typename RowView::const_iterator begin1 = row_(row).begin();
+      typename RowView::const_iterator end1 = row_(row).end();
 
       while (begin1 != end1 && it != end && d < min_d) {
         if (*begin1 < *it) {
@@ -801,6 +898,39 @@ public:
     return std::make_pair(min_row, min_d);
   }
 
+  /**
+   * Same as above, for a packed binary vector x of nCols() bits: the
+   * distance to a row is its number of non-zeros plus the number of bits
+   * set in x, minus twice their overlap.
+   */
+  inline std::pair<size_type, size_type>
+  minHammingDistance(const PackedSDR &x) const {
+    {
+      NTA_ASSERT(x.size() == nCols())
+          << "SparseBinaryMatrix::minHammingDistance: "
+          << "Invalid vector size: " << x.size();
+    }
+
+    const PackedSDR::word_type *w = x.words();
+    const size_type x_count = x.count();
+    size_type min_row = 0;
+    size_type min_d = std::numeric_limits<size_type>::max();
+
+    for (size_type i = 0; i != nRows(); ++i) {
+      const RowView row = row_(i);
+      size_type ov = 0;
+      for (size_type k = 0; k != row.size(); ++k)
+        ov += (size_type)((w[row[k] / 64] >> (row[k] % 64)) & 1);
+      size_type d = (size_type)row.size() + x_count - 2 * ov;
+      if (d < min_d) {
+        min_row = i;
+        min_d = d;
+      }
+    }
+
+    return std::make_pair(min_row, min_d);
+  }
+
   /**
    * Returns index of first row whose Hamming distance to vector is less
    * than value.
@@ -816,8 +946,8 @@ public:
 
       size_type d = 0;
       InputIterator it = begin;
-      typename Row::const_iterator begin1 = ind_[row].begin();
-      typename Row::const_iterator end1 = ind_[row].end();
+      typename RowView::const_iterator begin1 = row_(row).begin();
+      typename RowView::const_iterator end1 = row_(row).end();
 
       while (begin1 != end1 && it != end && d < distance) {
         if (*begin1 < *it) {
@@ -869,11 +999,12 @@ public:
           << "Invalid range: " << begin << ":" << end;
     } // End pre-conditions
 
-    Row &the_row = ind_[row];
-    typename Row::iterator it1, it2;
-    it1 = std::lower_bound(the_row.begin(), the_row.end(), begin);
-    it2 = std::lower_bound(it1, the_row.end(), end);
-    the_row.erase(it1, it2);
+    nz_index_type *b = nz_.data() + rows_[row].begin, *e = b + rows_[row].size;
+    nz_index_type *it1, *it2;
+    it1 = std::lower_bound(b, e, (nz_index_type)begin);
+    it2 = std::lower_bound(it1, e, (nz_index_type)end);
+    rows_[row].size -= (size_type)(it2 - it1);
+    std::copy(it2, e, it1);
   }
 
   inline void setRangeToOne(size_type row, size_type begin, size_type end) {
@@ -893,35 +1024,52 @@ public:
   }
 
   inline void transpose() {
-    std::vector<Row> tind(nCols());
+    const size_type nrows = nRows();
+    std::vector<size_type> nnzc(nCols());
+    nNonZerosPerCol(nnzc.begin(), nnzc.end());
 
-    for (size_type row = 0; row != nRows(); ++row)
-      for (nz_index_type k = 0; k != ind_[row].size(); ++k)
-        tind[ind_[row][k]].push_back(row);
+    std::vector<nz_index_type> nz;
+    nz.swap(nz_);
+    std::vector<RowExtent_> rows;
+    rows.swap(rows_);
+
+    layout_(nCols(), nnzc.begin());
+    for (size_type i = 0; i != nRows(); ++i)
+      rows_[i].size = 0;
+
+    // Rows are visited in increasing order, so the new rows come out sorted
+    for (size_type row = 0; row != nrows; ++row) {
+      const nz_index_type *j = nz.data() + rows[row].begin;
+      const nz_index_type *j_end = j + rows[row].size;
+      for (; j != j_end; ++j) {
+        RowExtent_ &t = rows_[*j];
+        nz_[t.begin + t.size++] = (nz_index_type)row;
+      }
+    }
 
-    ncols_ = nRows();
-    ind_.swap(tind);
+    ncols_ = nrows;
+    buffer_.resize(ncols_);
   }
 
   inline void logicalNot() {
     for (size_type row = 0; row != nRows(); ++row) {
 
-      size_type nnzr = ind_[row].size();
-      Row new_row;
-      new_row.reserve(nCols() - nnzr);
+      RowView the_row = row_(row);
+      size_type nnzr = (size_type)the_row.size();
+      size_type n = 0;
 
       nz_index_type k1 = 0;
 
       for (nz_index_type k = 0; k < nnzr; ++k1)
-        if (k1 != ind_[row][k])
-          new_row.push_back(k1);
+        if (k1 != the_row[k])
+          buffer_[n++] = k1;
         else
           ++k;
 
       for (; k1 != nCols(); ++k1)
-        new_row.push_back(k1);
+        buffer_[n++] = k1;
 
-      ind_[row].swap(new_row);
+      replaceSparseRow_(row, buffer_.begin(), buffer_.begin() + n);
     }
   }
 
@@ -938,8 +1086,10 @@ public:
 
     for (size_type row = 0; row != nRows(); ++row) {
 
-      size_type k = sparseOr(nCols(), ind_[row], o.ind_[row], buffer_);
-      replaceSparseRow(row, buffer_.begin(), buffer_.begin() + k);
+      typename Row::iterator end =
+          std::set_union(row_begin_(row), row_end_(row), o.row_begin_(row),
+                         o.row_end_(row), buffer_.begin());
+      replaceSparseRow_(row, buffer_.begin(), end);
     }
   }
 
@@ -956,9 +1106,11 @@ public:
 
     for (size_type row = 0; row != nRows(); ++row) {
 
-      size_type k = sparseAnd(nCols(), ind_[row], o.ind_[row], ind_[row]);
-      ind_[row].resize(k);
-      // replaceSparseRow(row, buffer_.begin(), buffer_.begin() + k);
+      // The intersection is never longer than the row: write it in place
+      nz_index_type *b = nz_.data() + rows_[row].begin;
+      nz_index_type *end = std::set_intersection(
+          b, b + rows_[row].size, o.row_begin_(row), o.row_end_(row), b);
+      rows_[row].size = (size_type)(end - b);
     }
   }
 
@@ -1048,17 +1200,40 @@ public:
       NTA_ASSERT((size_type)(y_end - y) == nRows());
     }
 
-    typename Row::const_iterator it, end;
+    typename RowView::const_iterator it, end;
 
     for (size_type i = 0; i != nRows(); ++i, ++y) {
       size_type count = 0;
-      end = ind_[i].end();
-      for (it = ind_[i].begin(); it != end; ++it)
+      end = row_(i).end();
+      for (it = row_(i).begin(); it != end; ++it)
         count += x[*it];
       *y = count;
     }
   }
 
+  /**
+   * Same as above, for a packed binary vector x of nCols() bits. x takes
+   * 64 times less memory than a vector of UInt32, which keeps it in cache.
+   */
+  template <typename OutputIterator>
+  inline void overlap(const PackedSDR &x, OutputIterator y) const {
+    {
+      NTA_ASSERT(x.size() == nCols())
+          << "SparseBinaryMatrix::overlap: "
+          << "Invalid vector size: " << x.size();
+    }
+
+    const PackedSDR::word_type *w = x.words();
+
+    for (size_type i = 0; i != nRows(); ++i, ++y) {
+      size_type count = 0;
+      const RowView row = row_(i);
+      for (size_type k = 0; k != row.size(); ++k)
+        count += (size_type)((w[row[k] / 64] >> (row[k] % 64)) & 1);
+      *y = count;
+    }
+  }
+
   /**
    * For a given x vector (binary 0/1) and maxDistance, computes the overlap
    * between x and each row of this matrix, and decides whether this overlap
@@ -1082,7 +1257,7 @@ public:
     for (InputIterator x_it = x; x_it != x_end; ++x_it)
       c_sum += *x_it;
 
-    typename Row::const_iterator it, end;
+    typename RowView::const_iterator it, end;
 
     for (size_type i = 0; i != nRows(); ++i) {
 
@@ -1094,8 +1269,8 @@ public:
       // but exit early, as soon as we determine that
       // the overlap is more than the max allowed overlap
       size_type ov = 0;
-      end = ind_[i].end();
-      for (it = ind_[i].begin(); it != end; ++it) {
+      end = row_(i).end();
+      for (it = row_(i).begin(); it != end; ++it) {
         ov += x[*it];
         if (ov > max_ov)
           return false;
@@ -1116,7 +1291,7 @@ public:
       size_type nnzr = nNonZerosOnRow(row);
       n += sprintf(buffer, "%ld ", (long)nnzr);
       for (nz_index_type j = 0; j != nnzr; ++j)
-        n += sprintf(buffer, "%ld ", (long)ind_[row][j]);
+        n += sprintf(buffer, "%ld ", (long)row_(row)[j]);
     }
     return n;
   }
@@ -1136,27 +1311,30 @@ public:
       size_type nrows = 0;
       inStream >> nrows;
 
-      ind_.clear();
-      ind_.resize(nrows);
+      clear();
 
       size_type ncols = 0;
       inStream >> ncols;
       nCols(ncols);
 
       buffer_.resize(nCols());
+      rows_.reserve(nrows);
 
+      Row ind;
       for (size_type row = 0; row != nrows; ++row) {
-        inStream >> ind_[row];
-        for (nz_index_type k = 0; k < ind_[row].size(); ++k) {
-          NTA_CHECK(/*0 <= ind_[row][k] &&*/ ind_[row][k] < nCols())
-              << where << "Invalid value: " << ind_[row][k]
+        inStream >> ind;
+        for (nz_index_type k = 0; k < ind.size(); ++k) {
+          NTA_CHECK(/*0 <= ind[k] &&*/ ind[k] < nCols())
+              << where << "Invalid value: " << ind[k]
               << " for prototype # " << row;
           if (k > 0) {
-            NTA_CHECK(ind_[row][k - 1] < ind_[row][k])
+            NTA_CHECK(ind[k - 1] < ind[k])
                 << where << "Index values need to be "
                 << "in strictly increasing order (no duplicates)";
           }
         }
+        rows_.push_back(RowExtent_());
+        replaceSparseRow_(row, ind.begin(), ind.end());
       }
 
     } else if (tag == "sm_csr_1.5") {
@@ -1167,39 +1345,43 @@ public:
       size_type nrows = 0;
       inStream >> nrows;
 
-      ind_.clear();
-      ind_.resize(nrows);
+      clear();
 
       size_type ncols = 0;
       inStream >> ncols;
       nCols(ncols);
 
       buffer_.resize(nCols());
+      rows_.reserve(nrows);
 
       size_type nnz = 0;
       inStream >> nnz;
+      nz_.reserve(nnz);
 
+      Row ind;
       for (size_type row = 0; row != nrows; ++row) {
         size_type nnzr = 0;
         inStream >> nnzr;
-        ind_[row].resize(nnzr);
+        ind.resize(nnzr);
         for (size_type k = 0; k != nnzr; ++k) {
           size_type col = 0;
           double value;
           inStream >> col >> value;
-          ind_[row][k] = col;
+          ind[k] = col;
         }
 
-        for (nz_index_type k = 0; k < ind_[row].size(); ++k) {
-          NTA_CHECK(/*0 <= ind_[row][k] &&*/ ind_[row][k] < nCols())
-              << where << "Invalid value: " << ind_[row][k]
+        for (nz_index_type k = 0; k < ind.size(); ++k) {
+          NTA_CHECK(/*0 <= ind[k] &&*/ ind[k] < nCols())
+              << where << "Invalid value: " << ind[k]
               << " for prototype # " << row;
           if (k > 0) {
-            NTA_CHECK(ind_[row][k - 1] < ind_[row][k])
+            NTA_CHECK(ind[k - 1] < ind[k])
                 << where << "Index values need to be "
                 << "in strictly increasing order (no duplicates)";
           }
         }
+        rows_.push_back(RowExtent_());
+        replaceSparseRow_(row, ind.begin(), ind.end());
       }
     } else {
       std::cout << "Unknown format for sparse binary matrix: " << tag
@@ -1215,8 +1397,11 @@ public:
 
     outStream << getVersion() << " " << nRows() << " " << nCols() << " ";
 
-    for (size_type row = 0; row != nRows(); ++row)
-      outStream << ind_[row];
+    Row ind;
+    for (size_type row = 0; row != nRows(); ++row) {
+      ind.assign(row_begin_(row), row_end_(row));
+      outStream << ind;
+    }
   }
 
   /* KEEP - KEEP - KEEP - KEEP - KEEP - KEEP - KEEP - KEEP - KEEP - KEEP - KEEP
@@ -1262,23 +1447,24 @@ public:
     // NTA_CHECK(0 <= nrows)
     //<< where << "Invalid number of rows: " << nrows;
 
-    ind_.clear();
-    ind_.resize(nrows);
+    clear();
 
     size_type ncols = 0;
     inStream >> ncols;
     nCols(ncols);
 
     buffer_.resize(nCols());
+    rows_.resize(nrows);
 
     for (size_type row = 0; row != nRows(); ++row) {
       size_type n = 0;
       inStream >> n;
       // NTA_CHECK(0 <= n)
       // << where << "Invalid row size: " << n;
-      ind_[row].resize(n);
+      nz_index_type *b = grow_row_(row, n);
+      rows_[row].size = n;
       inStream.ignore(1);
-      nupic::binary_load(inStream, ind_[row].begin(), ind_[row].end());
+      nupic::binary_load(inStream, b, b + n);
     }
   }
 
@@ -1290,11 +1476,104 @@ public:
     outStream << getVersion(true) << " " << nRows() << " " << nCols() << " ";
 
     for (size_type row = 0; row != nRows(); ++row) {
-      outStream << ind_[row].size() << " ";
-      nupic::binary_save(outStream, ind_[row].begin(), ind_[row].end());
+      outStream << (size_t)rows_[row].size << " ";
+      nupic::binary_save(outStream, row_begin_(row), row_end_(row));
     }
   }
 
+  /**
+   * Size in bytes of the flat binary form written by toFlat().
+   */
+  inline size_t flatSize() const {
+    const size_t nnz = nNonZeros();
+    size_t n = sizeof(FlatHeader_) + (nRows() + 1) * sizeof(UInt64);
+    n += nnz * sizeof(nz_index_type);
+    return (n + 7) & ~(size_t)7;
+  }
+
+  /**
+   * Writes this matrix in a flat binary form: a fixed-size header, the
+   * nRows() + 1 row offsets as UInt64, then the indices of all the
+   * non-zeros, row after row, padded to a multiple of 8 bytes. Integers
+   * are written in the byte order of the host.
+   *
+   * Unlike toBinary(), there is no per-row framing: fromFlat() can load a
+   * buffer in this form, e.g. a memory-mapped file, with two block copies,
+   * and the offsets and indices arrays are suitably aligned to be used
+   * directly from such a buffer.
+   */
+  inline void toFlat(std::ostream &outStream) const {
+    { // Pre-conditions
+      NTA_CHECK(outStream.good()) << "SparseBinaryMatrix::toFlat: Bad stream";
+    } // End pre-conditions
+
+    FlatHeader_ h = flatHeader_();
+    outStream.write((const char *)&h, sizeof(h));
+
+    UInt64 offset = 0;
+    outStream.write((const char *)&offset, sizeof(offset));
+    for (size_type row = 0; row != nRows(); ++row) {
+      offset += rows_[row].size;
+      outStream.write((const char *)&offset, sizeof(offset));
+    }
+
+    for (size_type row = 0; row != nRows(); ++row)
+      outStream.write((const char *)row_begin_(row),
+                      rows_[row].size * sizeof(nz_index_type));
+
+    const char padding[8] = {0};
+    size_t n = (size_t)h.nnz * sizeof(nz_index_type);
+    outStream.write(padding, (8 - n % 8) % 8);
+  }
+
+  /**
+   * Reads a matrix written by toFlat() from a stream.
+   */
+  inline void fromFlat(std::istream &inStream) {
+    { // Pre-conditions
+      NTA_CHECK(inStream.good()) << "SparseBinaryMatrix::fromFlat: Bad stream";
+    } // End pre-conditions
+
+    FlatHeader_ h;
+    inStream.read((char *)&h, sizeof(h));
+    check_flat_header_(h);
+
+    std::vector<UInt64> offsets((size_t)h.nrows + 1);
+    inStream.read((char *)offsets.data(), offsets.size() * sizeof(UInt64));
+    std::vector<nz_index_type> nz((size_t)h.nnz);
+    inStream.read((char *)nz.data(), nz.size() * sizeof(nz_index_type));
+    inStream.ignore((8 - nz.size() * sizeof(nz_index_type) % 8) % 8);
+
+    NTA_CHECK(inStream.good() && offsets[h.nrows] == h.nnz)
+        << "SparseBinaryMatrix::fromFlat: Truncated stream";
+
+    fromCSR((size_type)h.nrows, (size_type)h.ncols, offsets.begin(),
+            nz.begin());
+  }
+
+  /**
+   * Reads a matrix written by toFlat() from a buffer of size bytes, for
+   * example a memory-mapped file. data needs to be 8-byte aligned.
+   */
+  inline void fromFlat(const char *data, size_t size) {
+    const char *where = "SparseBinaryMatrix::fromFlat: ";
+
+    NTA_CHECK(sizeof(FlatHeader_) <= size) << where << "Buffer too small";
+
+    FlatHeader_ h;
+    std::memcpy(&h, data, sizeof(h));
+    check_flat_header_(h);
+
+    const UInt64 *offsets = (const UInt64 *)(data + sizeof(h));
+    const nz_index_type *nz = (const nz_index_type *)(offsets + h.nrows + 1);
+
+    NTA_CHECK((const char *)(nz + h.nnz) <= data + size)
+        << where << "Buffer too small";
+    NTA_CHECK(offsets[h.nrows] == h.nnz) << where << "Invalid offsets";
+
+    fromCSR((size_type)h.nrows, (size_type)h.ncols, offsets, nz);
+  }
+
   using Serializable::write;
 
   inline void write(SparseBinaryMatrixProto::Builder &proto) const {
@@ -1302,7 +1581,7 @@ public:
     proto.setNumColumns(nCols());
     auto indices = proto.initIndices(nRows());
     for (UInt i = 0; i < nRows(); ++i) {
-      auto &sparseRow = getSparseRow(i);
+      RowView sparseRow = row_(i);
       auto rowProto = indices.init(i, sparseRow.size());
       for (UInt j = 0; j < sparseRow.size(); ++j) {
         rowProto.set(j, sparseRow[j]);
@@ -1354,17 +1633,19 @@ public:
             << "Indices need to be in strictly increasing order";
     } // End pre-conditions
 
+    clear();
     nCols(ncols);
-    ind_.clear();
-    ind_.resize(nrows);
     buffer_.resize(nCols());
 
-    for (; begin != end; ++begin) {
-      size_type idx = *begin - offset;
-      size_type row = idx / ncols;
-      size_type col = idx % ncols;
-      ind_[row].push_back(col);
-    }
+    // The indices are sorted, so the rows are filled one after the other
+    std::vector<size_type> nnzr(nrows, 0);
+    for (InputIterator it = begin; it != end; ++it)
+      ++nnzr[(*it - offset) / ncols];
+
+    layout_(nrows, nnzr.begin());
+    nz_index_type *nz = nz_.data();
+    for (; begin != end; ++begin)
+      *nz++ = (nz_index_type)((*begin - offset) % ncols);
   }
 
   template <typename OutputIterator>
@@ -1380,7 +1661,7 @@ public:
 
     for (size_type row = 0; row != nRows(); ++row)
       for (nz_index_type k = 0; k != nNonZerosOnRow(row); ++k)
-        *begin++ = row * nCols() + ind_[row][k] + offset;
+        *begin++ = row * nCols() + row_(row)[k] + offset;
 
     return (size_type)(begin - begin1);
   }
@@ -1398,10 +1679,12 @@ public:
           << nCols();
     } // End pre-conditions
 
-    ind_[row].clear();
+    size_type n = 0;
     for (InputIterator it = begin; it != end; ++it)
       if (!nearlyZero(*it))
-        ind_[row].push_back((size_type)(it - begin));
+        buffer_[n++] = (nz_index_type)(it - begin);
+
+    replaceSparseRow_(row, buffer_.begin(), buffer_.begin() + n);
   }
 
   template <typename OutputIterator>
@@ -1421,8 +1704,8 @@ public:
         typename std::iterator_traits<OutputIterator>::value_type value_type;
 
     std::fill(begin, end, (value_type)0);
-    typename Row::const_iterator it;
-    for (it = ind_[row].begin(); it != ind_[row].end(); ++it)
+    typename RowView::const_iterator it;
+    for (it = row_(row).begin(); it != row_(row).end(); ++it)
       *(begin + *it) = (value_type)1;
   }
 
@@ -1441,9 +1724,9 @@ public:
     }
 
     for (size_type i = 0; i != nRows(); ++i, ++dense) {
-      typename Row::const_iterator where;
-      where = std::lower_bound(ind_[i].begin(), ind_[i].end(), col);
-      *dense = (where != ind_[i].end() && *where == col);
+      typename RowView::const_iterator where;
+      where = std::lower_bound(row_(i).begin(), row_(i).end(), col);
+      *dense = (where != row_(i).end() && *where == col);
     }
   }
 
@@ -1495,13 +1778,17 @@ public:
     clear();
 
     nCols(ncols);
-    ind_.resize(nrows);
     buffer_.resize(nCols());
+    rows_.reserve(nrows);
 
-    for (size_type row = 0; row != nrows; ++row)
+    for (size_type row = 0; row != nrows; ++row) {
+      size_type n = 0;
       for (nz_index_type col = 0; col != nCols(); ++col)
         if (*begin++ != 0)
-          ind_[row].push_back(col);
+          buffer_[n++] = col;
+      rows_.push_back(RowExtent_());
+      replaceSparseRow_(row, buffer_.begin(), buffer_.begin() + n);
+    }
   }
 
   template <typename OutputIterator>
@@ -1516,8 +1803,8 @@ public:
     std::fill(begin, end, (size_type)0);
     for (size_type row = 0; row != nRows(); ++row) {
       OutputIterator p = begin + row * nCols();
-      for (nz_index_type k = 0; k != ind_[row].size(); ++k)
-        *(p + ind_[row][k]) = (size_type)1;
+      for (nz_index_type k = 0; k != row_(row).size(); ++k)
+        *(p + row_(row)[k]) = (size_type)1;
     }
   }
 
@@ -1530,8 +1817,8 @@ public:
 
     for (size_type row = 0; row != nRows(); ++row) {
       std::fill(buffer.begin(), buffer.end(), (size_type)0);
-      for (nz_index_type k = 0; k != ind_[row].size(); ++k)
-        buffer[ind_[row][k]] = (size_type)1;
+      for (nz_index_type k = 0; k != row_(row).size(); ++k)
+        buffer[row_(row)[k]] = (size_type)1;
       for (nz_index_type col = 0; col != nCols(); ++col)
         outStream << buffer[col] << " ";
       outStream << std::endl;
@@ -1544,7 +1831,7 @@ public:
     for (size_type row = 0; row != nRows(); ++row) {
       if (o.nNonZerosOnRow(row) != nNonZerosOnRow(row))
         return false;
-      if (!std::equal(ind_[row].begin(), ind_[row].end(), o.ind_[row].begin()))
+      if (!std::equal(row_(row).begin(), row_(row).end(), o.row_(row).begin()))
         return false;
     }
     return true;
@@ -1569,17 +1856,51 @@ public:
           << " - Should >= number of rows: " << nRows();
     } // End pre-conditions
 
-    typedef
-        typename std::iterator_traits<OutputIterator>::value_type value_type;
-    typename std::vector<Row>::const_iterator row;
-    typename Row::const_iterator j;
+    rightVecSumAtNZRows_(0, nRows(), x, y);
+  }
 
-    for (row = ind_.begin(); row != ind_.end(); ++row, ++y) {
-      value_type val = 0;
-      for (j = row->begin(); j != row->end(); ++j)
-        val += value_type(x[*j]);
-      *y = val;
-    }
+  /**
+   * Same as rightVecSumAtNZ(x, x_end, y, y_end), with the rows split among
+   * the threads of the shared ThreadPool. Produces the same result.
+   *
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZ_parallel(InputIterator x, InputIterator x_end,
+                                       OutputIterator y, OutputIterator y_end,
+                                       UInt nThreads = 0) const {
+    { // Pre-conditions
+      NTA_ASSERT((size_type)(x_end - x) >= nCols())
+          << "SparseBinaryMatrix::rightVecSumAtNZ_parallel: "
+          << " Invalid input vector size: " << (size_type)(x_end - x)
+          << " - Should >= number of colums: " << nCols();
+
+      NTA_ASSERT((size_type)(y_end - y) >= nRows())
+          << "SparseBinaryMatrix::rightVecSumAtNZ_parallel: "
+          << "Invalid output vector size: " << (size_type)(y_end - y)
+          << " - Should >= number of rows: " << nRows();
+    } // End pre-conditions
+
+    const UInt64 minNonZerosPerChunk = 16384;
+    const size_type nrows = nRows();
+    if (nrows == 0)
+      return;
+    UInt64 grain = minNonZerosPerChunk * nrows / ((UInt64)nNonZeros() + 1);
+    grain = std::min<UInt64>(std::max<UInt64>(grain, 1), nrows);
+
+    nupic::util::ThreadPool::shared().parallelFor(
+        0, (UInt)nrows,
+        [&](UInt lo, UInt hi) { rightVecSumAtNZRows_(lo, hi, x, y + lo); },
+        (UInt)grain, nThreads);
+  }
+
+  /**
+   * Same as above, for a binary x packed in nCols() bits: y[row] is the
+   * number of non-zeros of the row that are set in x.
+   */
+  template <typename OutputIterator>
+  inline void rightVecSumAtNZ(const PackedSDR &x, OutputIterator y) const {
+    overlap(x, y);
   }
 
   /**
@@ -1600,7 +1921,7 @@ public:
     size_type k = 0;
 
     for (size_type i = 0; i != nRows(); ++i) {
-      const Row &row = ind_[i];
+      const RowView row = row_(i);
       const size_type nnzr = row.size();
       value_type s = 0;
       for (size_type j = 0; j != nnzr; ++j)
@@ -1623,7 +1944,19 @@ public:
     size_type k = 0;
 
     for (size_type i = 0; i != nRows(); ++i) {
-      value_type s = (value_type)dot(ind_[i], x);
+      const nz_index_type *j = row_begin_(i), *j_end = row_end_(i);
+      size_t k2 = 0, n2 = x.nnz;
+      value_type s = 0;
+      while (j != j_end && k2 != n2)
+        if (*j < x[k2]) {
+          ++j;
+        } else if (x[k2] < *j) {
+          ++k2;
+        } else {
+          ++s;
+          ++j;
+          ++k2;
+        }
       if (s != 0)
         y[k++] = std::make_pair(i, s);
     }
@@ -1654,18 +1987,70 @@ public:
 
     typedef
         typename std::iterator_traits<OutputIterator>::value_type value_type;
-    typename std::vector<Row>::const_iterator row;
-    typename Row::const_iterator j;
 
     std::fill(y, y_end, (value_type)0.0);
 
-    for (row = ind_.begin(); row != ind_.end(); ++row, ++x) {
+    for (size_type row = 0; row != nRows(); ++row, ++x) {
       value_type val(*x);
-      for (j = row->begin(); j != row->end(); ++j)
+      const nz_index_type *j = row_begin_(row), *j_end = row_end_(row);
+      for (; j != j_end; ++j)
         y[*j] += val;
     }
   }
 
+  /**
+   * Same as leftVecSumAtNZ(x, x_end, y, y_end), with the columns split among
+   * the threads of the shared ThreadPool. Each thread scans all the rows,
+   * but only the non-zeros in its own range of columns, so that every y[col]
+   * is still accumulated in row order: the result is identical.
+   *
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void leftVecSumAtNZ_parallel(InputIterator x, InputIterator x_end,
+                                      OutputIterator y, OutputIterator y_end,
+                                      UInt nThreads = 0) const {
+    { // Pre-conditions
+      NTA_ASSERT((size_type)(x_end - x) >= nRows())
+          << "SparseBinaryMatrix::leftVecSumAtNZ_parallel: "
+          << " Invalid input vector size: " << (size_type)(x_end - x)
+          << " - Should be  >= number of rows: " << nRows();
+
+      NTA_ASSERT((size_type)(y_end - y) >= nCols())
+          << "SparseBinaryMatrix::leftVecSumAtNZ_parallel: "
+          << "Invalid output vector size: " << (size_type)(y_end - y)
+          << " - Should be >= number of columns: " << nCols();
+    } // End pre-conditions
+
+    typedef
+        typename std::iterator_traits<OutputIterator>::value_type value_type;
+
+    std::fill(y + nCols(), y_end, (value_type)0.0);
+
+    const UInt64 minNonZerosPerChunk = 16384;
+    const size_type ncols = nCols();
+    if (ncols == 0)
+      return;
+    UInt64 grain = minNonZerosPerChunk * ncols / ((UInt64)nNonZeros() + 1);
+    grain = std::min<UInt64>(std::max<UInt64>(grain, 1), ncols);
+
+    nupic::util::ThreadPool::shared().parallelFor(
+        0, (UInt)ncols,
+        [&](UInt lo, UInt hi) {
+          std::fill(y + lo, y + hi, (value_type)0.0);
+
+          for (size_type row = 0; row != nRows(); ++row) {
+            value_type val(x[row]);
+            const nz_index_type *j = row_begin_(row), *j_end = row_end_(row);
+            if (lo != 0)
+              j = std::lower_bound(j, j_end, (nz_index_type)lo);
+            for (; j != j_end && *j < hi; ++j)
+              y[*j] += val;
+          }
+        },
+        (UInt)grain, nThreads);
+  }
+
   /**
    * Finds the max of the values of x corresponding to non-zeros, for each row.
    * The operation is:
@@ -1687,7 +2072,7 @@ public:
 
     for (size_type row = 0; row != nRows(); ++row) {
       value_type max_val = -std::numeric_limits<value_type>::max();
-      const Row &the_row = ind_[row];
+      const RowView the_row = row_(row);
       for (size_type k = 0; k != the_row.size(); ++k) {
         if (x[the_row[k]] > max_val)
           max_val = x[the_row[k]];
@@ -1738,7 +2123,7 @@ public:
     for (size_type row = 0; row != nRows(); ++row) {
       value_type max_val = -std::numeric_limits<value_type>::max();
       size_type max_ind = 0;
-      const Row &the_row = ind_[row];
+      const RowView the_row = row_(row);
       for (size_type k = 0; k != the_row.size(); ++k) {
         value_type val = x[the_row[k]];
         if (val > max_val) {
@@ -1774,7 +2159,7 @@ public:
               (value_type)-std::numeric_limits<value_type>::max());
 
     for (size_type row = 0; row != nRows(); ++row) {
-      const Row &the_row = ind_[row];
+      const RowView the_row = row_(row);
       for (size_type k = 0; k != the_row.size(); ++k) {
         if (x[row] > y[the_row[k]])
           y[the_row[k]] = x[row];
@@ -1787,6 +2172,154 @@ public:
   }
 
 private:
+  inline const nz_index_type *row_begin_(size_type row) const {
+    return nz_.data() + rows_[row].begin;
+  }
+
+  inline const nz_index_type *row_end_(size_type row) const {
+    return nz_.data() + rows_[row].begin + rows_[row].size;
+  }
+
+  inline RowView row_(size_type row) const {
+    return RowView(row_begin_(row), row_end_(row));
+  }
+
+  /**
+   * Makes sure that row has room for n indices, and returns a pointer to its
+   * first index. The indices currently on the row are preserved, but the
+   * size of the row is not changed. If the row does not fit in its slice,
+   * it is extended in place when it is the last one in nz_, and moved to the
+   * end of nz_ otherwise. Rows that are moved get twice the room they had,
+   * so that rows growing one index at a time are not moved every time.
+   * Invalidates all the pointers into nz_.
+   */
+  inline nz_index_type *grow_row_(size_type row, size_type n) {
+    RowExtent_ &r = rows_[row];
+
+    if (n <= r.capacity)
+      return nz_.data() + r.begin;
+
+    if (r.begin + r.capacity == nz_.size()) {
+      r.capacity = n;
+      nz_.resize(r.begin + n);
+      return nz_.data() + r.begin;
+    }
+
+    size_type capacity = std::max(n, 2 * r.capacity);
+    holes_ += r.capacity;
+
+    if (2 * holes_ > nz_.size()) {
+      repack_(row, capacity);
+    } else {
+      size_t begin = nz_.size();
+      nz_.resize(begin + capacity);
+      std::copy(nz_.begin() + r.begin, nz_.begin() + r.begin + r.size,
+                nz_.begin() + begin);
+      r.begin = begin;
+      r.capacity = capacity;
+    }
+
+    return nz_.data() + r.begin;
+  }
+
+  /**
+   * Rewrites nz_ without holes or unused capacity, except for row
+   * grow_row, which gets capacity slots (pass nRows() for no such row).
+   */
+  inline void repack_(size_type grow_row, size_type capacity) {
+    size_t total = 0;
+    for (size_type i = 0; i != nRows(); ++i)
+      total += i == grow_row ? capacity : rows_[i].size;
+
+    std::vector<nz_index_type> nz(total);
+    size_t begin = 0;
+    for (size_type i = 0; i != nRows(); ++i) {
+      RowExtent_ &r = rows_[i];
+      std::copy(nz_.begin() + r.begin, nz_.begin() + r.begin + r.size,
+                nz.begin() + begin);
+      r.begin = begin;
+      r.capacity = i == grow_row ? capacity : r.size;
+      begin += r.capacity;
+    }
+
+    nz_.swap(nz);
+    holes_ = 0;
+  }
+
+  /**
+   * Sets up nrows rows of nnzr[i] indices each, contiguously and without
+   * holes. The indices themselves are left for the caller to fill in.
+   */
+  template <typename SizeIterator>
+  inline void layout_(size_type nrows, SizeIterator nnzr) {
+    rows_.resize(nrows);
+    size_t begin = 0;
+    for (size_type i = 0; i != nrows; ++i, ++nnzr) {
+      rows_[i].begin = begin;
+      rows_[i].size = rows_[i].capacity = (size_type)*nnzr;
+      begin += *nnzr;
+    }
+    nz_.resize(begin);
+    holes_ = 0;
+  }
+
+  template <typename InputIterator>
+  inline void replaceSparseRow_(size_type row, InputIterator begin,
+                                InputIterator end) {
+    size_type n = (size_type)(end - begin);
+    if (rows_[row].capacity < n)
+      rows_[row].size = 0; // no need to move the old indices
+    nz_index_type *out = grow_row_(row, n);
+    for (; begin != end; ++begin) // not std::copy: capnp iterators
+      *out++ = (nz_index_type)*begin;
+    rows_[row].size = n;
+  }
+
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZRows_(size_type lo, size_type hi, InputIterator x,
+                                   OutputIterator y) const {
+    typedef
+        typename std::iterator_traits<OutputIterator>::value_type value_type;
+
+    for (size_type row = lo; row != hi; ++row, ++y) {
+      value_type val = 0;
+      const nz_index_type *j = row_begin_(row), *j_end = row_end_(row);
+      for (; j != j_end; ++j)
+        val += value_type(x[*j]);
+      *y = val;
+    }
+  }
+
+  // Header of the flat binary form, see toFlat()
+  struct FlatHeader_ {
+    char magic[8];
+    UInt64 nrows;
+    UInt64 ncols;
+    UInt64 nnz;
+    UInt64 index_size;
+  };
+
+  inline FlatHeader_ flatHeader_() const {
+    FlatHeader_ h;
+    std::memcpy(h.magic, "sm01flt", 8);
+    h.nrows = nRows();
+    h.ncols = nCols();
+    h.nnz = nNonZeros();
+    h.index_size = sizeof(nz_index_type);
+    return h;
+  }
+
+  inline void check_flat_header_(const FlatHeader_ &h) const {
+    const char *where = "SparseBinaryMatrix::fromFlat: ";
+    NTA_CHECK(std::memcmp(h.magic, "sm01flt", 8) == 0)
+        << where << "Unknown format";
+    NTA_CHECK(h.index_size == sizeof(nz_index_type))
+        << where << "Index size mismatch: " << h.index_size << " vs. "
+        << sizeof(nz_index_type);
+    NTA_CHECK(h.nrows <= std::numeric_limits<size_type>::max())
+        << where << "Too many rows: " << h.nrows;
+  }
+
   template <typename InputIterator>
   inline void sparse_row_invariants_(InputIterator begin, InputIterator end,
                                      const char *where) const {
@@ -1848,13 +2381,13 @@ private:
     } // End pre-conditions
 
     if (reverse) {
-      int i = (int)ind_[row].size() - 1;
+      int i = (int)row_(row).size() - 1;
       while (i - 1 >= 0) {
-        if (ind_[row][i] - 1 == ind_[row][i - 1])
+        if (row_(row)[i] - 1 == row_(row)[i - 1])
           --i;
         else {
-          int begin = (int)(ind_[row][i] - 1);
-          int end = (int)(ind_[row][i - 1]);
+          int begin = (int)(row_(row)[i] - 1);
+          int end = (int)(row_(row)[i - 1]);
           for (int k = begin; k != end; --k)
             out[k] += 1;
           i -= 2;
@@ -1862,12 +2395,12 @@ private:
       }
     } else {
       size_type i = 0;
-      while ((size_type)(i + 1) < ind_[row].size()) {
-        if (ind_[row][i] + 1 == ind_[row][i + 1])
+      while ((size_type)(i + 1) < row_(row).size()) {
+        if (row_(row)[i] + 1 == row_(row)[i + 1])
           ++i;
         else {
-          size_type begin = ind_[row][i] + 1;
-          size_type end = ind_[row][i + 1];
+          size_type begin = row_(row)[i] + 1;
+          size_type end = row_(row)[i + 1];
           for (size_type k = begin; k != end; ++k)
             out[k] += 1;
           i += 2;
@@ -37,17 +37,56 @@
 
 #include <nupic/math/ArrayAlgo.hpp>
 #include <nupic/math/Math.hpp>
+#include <nupic/math/Simd.hpp>
 #include <nupic/math/StlIo.hpp>
 #include <nupic/math/Utils.hpp>
 #include <nupic/ntypes/MemParser.hpp>
 #include <nupic/ntypes/MemStream.hpp>
 #include <nupic/proto/SparseMatrixProto.capnp.h>
 #include <nupic/types/Serializable.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 
 namespace nupic {
 
 struct SparseMatrixAlgorithms;
 
+/**
+ * Vectorized kernels on one row of a SparseMatrix (n non-zeros, indices ind,
+ * values nz) against a dense vector x. Only specialized for float values
+ * with 32-bit indices, with the kernels of nupic/math/Simd.hpp, which are
+ * available on CPUs with AVX2: 8 non-zeros at a time, using a gather for x.
+ * Each kernel combines the lanes in the same order as the scalar loop it
+ * replaces in SparseMatrix, so results are bit-identical. Rows must have at
+ * least 8 non-zeros.
+ */
+template <typename UI, typename T> struct SparseRowKernels {
+  static bool enabled() { return false; }
+  static T dot(const UI *, const T *, UI, const T *) { return 0; }
+  static T sumAt(const UI *, UI, const T *) { return 0; }
+  static T maxProd(const UI *, const T *, UI, const T *) { return 0; }
+};
+
+template <> struct SparseRowKernels<UInt32, Real32> {
+  static bool enabled() { return simd::kernels().sparseDot != nullptr; }
+
+  // SparseMatrix::rightVecProd(row, x)
+  static Real32 dot(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                    const Real32 *x) {
+    return simd::kernels().sparseDot(ind, nz, n, x);
+  }
+
+  // SparseMatrix::rightVecSumAtNZ
+  static Real32 sumAt(const UInt32 *ind, UInt32 n, const Real32 *x) {
+    return simd::kernels().sparseSumAt(ind, n, x);
+  }
+
+  // SparseMatrix::vecMaxProd
+  static Real32 maxProd(const UInt32 *ind, const Real32 *nz, UInt32 n,
+                        const Real32 *x) {
+    return simd::kernels().sparseMaxProd(ind, nz, n, x);
+  }
+};
+
 /**
  * @b Responsibility:
  *  A sparse matrix class dedicated to supporting Numenta's algorithms.
@@ -91,6 +130,9 @@ struct SparseMatrixAlgorithms;
  * on a row: if memory was allocated for 4 non-zeros, and a lerp operation
  * introduces a new non-zero, we need to allocated more space, and that
  * wouldn't work in compact mode.
+ * - in always-compact mode (setAlwaysCompact()), the matrix stays compact:
+ * each row gets some slack in the single block of memory, and rows that
+ * outgrow it are moved to free space at the end of the block.
  * 1. nnzr_ is used as a indicator of whether memory has been allocated for a
  * row
  * or not. If nnzr_[i] == 0, NEVER access ind_[i] or nz_[i], they might not
@@ -149,6 +191,26 @@ protected:
   value_type *nzb_;          // buffer for values of non-zeros
   IsNearlyZero<DTZ> isZero_; // test for zero/non-zero
 
+  // Optional column index (CSC mirror of the structure): for each column,
+  // the rows that have a non-zero in that column, in increasing order.
+  // See enableColumnIndex().
+  std::vector<std::vector<size_type>> colRows_;
+  bool colIndex_ = false;       // whether the index is enabled
+  int colIndexSuspended_ = 0;   // > 0 while a bulk mutator runs
+
+  // Always-compact storage, see setAlwaysCompact(). While the layout made
+  // by compactWithSlack_() is current (arena_ == ind_mem_), row r owns
+  // rowCap_[r] slots starting at rowAt_[r], and slots [memUsed_, memCap_)
+  // at the end of the arena are free for rows that outgrow their slack.
+  // A row whose pointer no longer matches rowAt_ (permuteRows, shiftRows...)
+  // falls back to nnzr_[r] as its capacity.
+  bool alwaysCompact_ = false;
+  size_type *arena_ = nullptr;
+  std::vector<size_type> rowCap_;
+  std::vector<size_type *> rowAt_;
+  size_type memUsed_ = 0;
+  size_type memCap_ = 0;
+
   friend struct SparseMatrixAlgorithms;
 
 // Macros
@@ -455,6 +517,13 @@ protected:
 
     indb_ = new size_type[ncols];
     nzb_ = new value_type[ncols];
+
+    // The matrix is empty again: rows added with set_row_ or addRow
+    // rebuild the column index as they go
+    if (colIndexActive_()) {
+      colRows_.clear();
+      colRows_.resize(ncols);
+    }
   }
 
   /**
@@ -482,6 +551,7 @@ protected:
 
       ind_mem_ = nullptr;
       nz_mem_ = nullptr;
+      arena_ = nullptr;
 
     } else {
 
@@ -611,24 +681,17 @@ protected:
 
     size_type nnzr = size_type(indb_it - indb_);
 
-    if (nnzr > nnzr_[row]) {
+    colIndexEraseRow_(row);
 
-      // There are more non-zeros than we have allocated
-      // memory for, so we need to de-compact the storage
-      // (changes ind_[r] and nz_[r] but not nnzr_[r])
-      if (isCompact())
-        decompact();
-
-      delete[] ind_[row];
-      delete[] nz_[row];
-
-      ind_[row] = new size_type[nnzr];
-      nz_[row] = new value_type[nnzr];
-    }
+    // If there are more non-zeros than we have allocated memory for, this
+    // changes ind_[r] and nz_[r] but not nnzr_[r]
+    reserveRow_(row, nnzr);
 
     nnzr_[row] = nnzr;
     std::copy(indb_, indb_ + nnzr, ind_[row]);
     std::copy(nzb_, nzb_ + nnzr, nz_[row]);
+
+    colIndexInsertRow_(row);
   }
 
   /**
@@ -656,6 +719,587 @@ protected:
       *(nzb_ + *ind) = *nz;
   }
 
+  /**
+   * Per-thread scratch buffer of at least n elements, for the const methods.
+   * Those must not write to indb_ or nzb_, so that several threads can read
+   * the same matrix concurrently. The buffer is all zeros between calls:
+   * users reset whatever they write before returning.
+   *
+   * @b Exceptions:
+   *  @li Not enough memory (error)
+   */
+  template <typename T> static inline T *threadScratch_(size_type n) {
+    static thread_local std::vector<T> buffer;
+    if (buffer.size() < n)
+      buffer.resize(n, (T)0);
+    return buffer.data();
+  }
+
+  typedef SparseRowKernels<size_type, value_type> RowKernels_;
+
+  // x as a pointer to value_type, if it points to contiguous memory, for
+  // RowKernels_. Must not be called on an empty vector.
+  template <typename InputIterator>
+  static inline const value_type *contiguous_(InputIterator) {
+    return nullptr;
+  }
+  static inline const value_type *contiguous_(const value_type *x) {
+    return x;
+  }
+  static inline const value_type *contiguous_(value_type *x) { return x; }
+  static inline const value_type *
+  contiguous_(typename std::vector<value_type>::const_iterator x) {
+    return &*x;
+  }
+  static inline const value_type *
+  contiguous_(typename std::vector<value_type>::iterator x) {
+    return &*x;
+  }
+
+  // Column index maintenance. Mutators that change a few non-zeros update
+  // the index in place with the colIndex*_ helpers. Mutators that
+  // restructure the whole matrix call suspendColumnIndex_() first and
+  // resumeColumnIndex_() when done, which rebuilds the index. If one of them
+  // throws, the index stays suspended and is not used until
+  // enableColumnIndex() is called again.
+
+  inline bool colIndexActive_() const {
+    return colIndex_ && colIndexSuspended_ == 0;
+  }
+
+  inline void colIndexInsert_(size_type row, size_type col) {
+    if (!colIndexActive_())
+      return;
+    std::vector<size_type> &rows = colRows_[col];
+    auto it = std::lower_bound(rows.begin(), rows.end(), row);
+    if (it == rows.end() || *it != row)
+      rows.insert(it, row);
+  }
+
+  inline void colIndexErase_(size_type row, size_type col) {
+    if (!colIndexActive_())
+      return;
+    std::vector<size_type> &rows = colRows_[col];
+    auto it = std::lower_bound(rows.begin(), rows.end(), row);
+    if (it != rows.end() && *it == row)
+      rows.erase(it);
+  }
+
+  inline void colIndexInsertRow_(size_type row) {
+    if (!colIndexActive_())
+      return;
+    for (size_type *ind = ind_[row], *end = ind + nnzr_[row]; ind != end;
+         ++ind)
+      colIndexInsert_(row, *ind);
+  }
+
+  inline void colIndexEraseRow_(size_type row) {
+    if (!colIndexActive_())
+      return;
+    for (size_type *ind = ind_[row], *end = ind + nnzr_[row]; ind != end;
+         ++ind)
+      colIndexErase_(row, *ind);
+  }
+
+  inline void suspendColumnIndex_() {
+    if (colIndex_)
+      ++colIndexSuspended_;
+  }
+
+  inline void resumeColumnIndex_() {
+    if (colIndex_ && --colIndexSuspended_ == 0)
+      rebuildColumnIndex_();
+  }
+
+  inline void rebuildColumnIndex_() {
+    const size_type nrows = nRows(), ncols = nCols();
+    std::vector<size_type> counts(ncols, 0);
+    for (size_type row = 0; row != nrows; ++row)
+      for (size_type *ind = ind_[row], *end = ind + nnzr_[row]; ind != end;
+           ++ind)
+        ++counts[*ind];
+
+    colRows_.resize(ncols);
+    for (size_type col = 0; col != ncols; ++col) {
+      colRows_[col].clear();
+      colRows_[col].reserve(counts[col]);
+    }
+
+    for (size_type row = 0; row != nrows; ++row)
+      for (size_type *ind = ind_[row], *end = ind + nnzr_[row]; ind != end;
+           ++ind)
+        colRows_[*ind].push_back(row);
+  }
+
+  /**
+   * Packs all the non-zeros into one block of memory, in row order and
+   * without gaps. The matrix must not be compact.
+   */
+  inline void packRows_() {
+    size_type nnz = nNonZeros();
+
+    ind_mem_ = new size_type[nnz];
+    size_type *indp = ind_mem_;
+
+    nz_mem_ = new value_type[nnz];
+    value_type *nzp = nz_mem_;
+
+    ITERATE_ON_ALL_ROWS {
+
+      nnz = nnzr_[row];
+      std::copy(ind_[row], ind_[row] + nnz, indp);
+      std::copy(nz_[row], nz_[row] + nnz, nzp);
+
+      delete[] ind_[row];
+      delete[] nz_[row];
+
+      ind_[row] = indp;
+      nz_[row] = nzp;
+      indp += nnz;
+      nzp += nnz;
+    }
+  }
+
+  // Always-compact storage helpers, see setAlwaysCompact().
+
+  inline bool slackLayout_() const {
+    return arena_ != nullptr && arena_ == ind_mem_;
+  }
+
+  // Number of non-zeros row can hold without being re-allocated.
+  inline size_type rowCapacity_(size_type row) const {
+    if (slackLayout_() && row < rowCap_.size() && rowAt_[row] == ind_[row])
+      return rowCap_[row];
+    return nnzr_[row];
+  }
+
+  static inline size_type slackFor_(size_type n) { return n + n / 4 + 4; }
+
+  /**
+   * Lays out all the rows in one block of memory, with slack after each
+   * row and free space at the end of the block. If grow_row is a valid row,
+   * it gets room for at least grow_n non-zeros. Works whether the matrix is
+   * compact or not, and keeps the non-zeros.
+   */
+  inline void compactWithSlack_(size_type grow_row = (size_type)-1,
+                                size_type grow_n = 0) {
+    const size_type nrows = nRows();
+    std::vector<size_type> cap(nrows);
+    size_type total = 0;
+    for (size_type row = 0; row != nrows; ++row) {
+      size_type n = nnzr_[row];
+      if (row == grow_row && grow_n > n)
+        n = grow_n;
+      cap[row] = slackFor_(n);
+      total += cap[row];
+    }
+
+    const size_type mem_cap = total + total / 4 + 16;
+    auto new_ind = new size_type[mem_cap];
+    auto new_nz = new value_type[mem_cap];
+    std::vector<size_type *> at(nrows);
+    const bool compact = isCompact();
+
+    size_type offset = 0;
+    for (size_type row = 0; row != nrows; ++row) {
+      const size_type nnzr = nnzr_[row];
+      if (nnzr > 0) {
+        std::copy(ind_[row], ind_[row] + nnzr, new_ind + offset);
+        std::copy(nz_[row], nz_[row] + nnzr, new_nz + offset);
+      }
+      if (!compact) {
+        delete[] ind_[row];
+        delete[] nz_[row];
+      }
+      at[row] = ind_[row] = new_ind + offset;
+      nz_[row] = new_nz + offset;
+      offset += cap[row];
+    }
+
+    if (compact) {
+      delete[] ind_mem_;
+      delete[] nz_mem_;
+    }
+    ind_mem_ = arena_ = new_ind;
+    nz_mem_ = new_nz;
+    rowCap_.swap(cap);
+    rowAt_.swap(at);
+    memUsed_ = total;
+    memCap_ = mem_cap;
+  }
+
+  /**
+   * Makes room for n non-zeros on row. The non-zeros of the row are kept if
+   * keep is true, otherwise the caller overwrites them. Does not change
+   * nnzr_[row]. Default mode: decompacts the matrix if it needs to grow the
+   * row. Always-compact mode: moves the row to the free space at the end of
+   * the block, or re-lays out the block when there is none left.
+   */
+  inline void reserveRow_(size_type row, size_type n, bool keep = false) {
+    if (n <= rowCapacity_(row))
+      return;
+
+    if (!alwaysCompact_) {
+      if (isCompact())
+        decompact();
+      auto new_ind = new size_type[n];
+      auto new_nz = new value_type[n];
+      if (keep) {
+        std::copy(ind_[row], ind_[row] + nnzr_[row], new_ind);
+        std::copy(nz_[row], nz_[row] + nnzr_[row], new_nz);
+      }
+      delete[] ind_[row];
+      delete[] nz_[row];
+      ind_[row] = new_ind;
+      nz_[row] = new_nz;
+      return;
+    }
+
+    const size_type cap = slackFor_(n);
+    if (!slackLayout_() || memCap_ - memUsed_ < cap) {
+      compactWithSlack_(row, n);
+      return;
+    }
+
+    size_type *new_ind = ind_mem_ + memUsed_;
+    value_type *new_nz = nz_mem_ + memUsed_;
+    if (keep && nnzr_[row] > 0) {
+      std::copy(ind_[row], ind_[row] + nnzr_[row], new_ind);
+      std::copy(nz_[row], nz_[row] + nnzr_[row], new_nz);
+    }
+    if (row >= rowCap_.size()) {
+      rowCap_.resize(row + 1, 0);
+      rowAt_.resize(row + 1, nullptr);
+    }
+    rowAt_[row] = ind_[row] = new_ind;
+    nz_[row] = new_nz;
+    rowCap_[row] = cap;
+    memUsed_ += cap;
+  }
+
+  /**
+   * Called at the end of the mutators that decompact the whole matrix.
+   */
+  inline void recompact_() {
+    if (alwaysCompact_)
+      compact();
+  }
+
+  /**
+   * Makes sure the non-zeros are in one block of memory, in row order and
+   * without gaps, for the methods that read or write ind_mem_/nz_mem_
+   * directly. Rows can leave gaps in the block when they lose non-zeros, or
+   * in always-compact mode.
+   */
+  inline void pack_() {
+    if (isCompact()) {
+      size_type offset = 0;
+      bool packed = true;
+      ITERATE_ON_ALL_ROWS {
+        if (nnzr_[row] == 0)
+          continue;
+        if (ind_[row] != ind_mem_ + offset || nz_[row] != nz_mem_ + offset) {
+          packed = false;
+          break;
+        }
+        offset += nnzr_[row];
+      }
+      if (packed) {
+        arena_ = nullptr; // callers may move the rows
+        return;
+      }
+      decompact();
+    }
+    packRows_();
+  }
+
+  /**
+   * Stores the non-zeros of the dense row [dense, dense + ncols) in row,
+   * provided they fit in the storage the row already has. Unlike set_row_,
+   * never allocates nor uses indb_/nzb_, so it can run concurrently on
+   * distinct rows.
+   *
+   * @returns false, leaving the row unchanged, if the row would need to
+   *  grow
+   */
+  inline bool set_row_in_place_(size_type row, const value_type *dense) {
+    const size_type ncols = nCols();
+
+    size_type nnzr = 0;
+    for (size_type col = 0; col != ncols; ++col)
+      if (!isZero_(dense[col]))
+        ++nnzr;
+
+    if (nnzr > rowCapacity_(row))
+      return false;
+
+    size_type *ind = ind_[row];
+    value_type *nz = nz_[row];
+    for (size_type col = 0; col != ncols; ++col)
+      if (!isZero_(dense[col])) {
+        *ind++ = col;
+        *nz++ = dense[col];
+      }
+
+    nnzr_[row] = nnzr;
+    return true;
+  }
+
+  /**
+   * Calls body(lo, hi) on disjoint row ranges covering [0, nrows), on the
+   * shared ThreadPool. Each range holds enough non-zeros to be worth a
+   * task, so small matrices are processed in the calling thread.
+   *
+   * @param nThreads maximum number of threads, 0 for the pool size
+   */
+  template <typename Body>
+  inline void parallelRows_(const Body &body, UInt nThreads) const {
+    parallelRows_(body, nThreads, nNonZeros());
+  }
+
+  /**
+   * Same, for a body that visits about work non-zeros over all the rows.
+   */
+  template <typename Body>
+  inline void parallelRows_(const Body &body, UInt nThreads,
+                            UInt64 work) const {
+    const UInt64 minNonZerosPerChunk = 16384;
+    const size_type nrows = nRows();
+    if (nrows == 0)
+      return;
+    UInt64 grain = minNonZerosPerChunk * nrows / (work + 1);
+    grain = std::min<UInt64>(std::max<UInt64>(grain, 1), nrows);
+    nupic::util::ThreadPool::shared().parallelFor(0, (UInt)nrows, body,
+                                                  (UInt)grain, nThreads);
+  }
+
+  // Row-range kernels shared by the serial and the row-parallel versions of
+  // the rightVec* methods. They process rows [lo, hi) and write one value
+  // per row, starting at y.
+
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecProdRows_(size_type lo, size_type hi, InputIterator x,
+                                OutputIterator y) const {
+    for (size_type row = lo; row != hi; ++row, ++y)
+      *y = rightVecProd(row, x);
+  }
+
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZRows_(size_type lo, size_type hi,
+                                   InputIterator x, OutputIterator y) const {
+    for (size_type row = lo; row != hi; ++row) {
+
+      size_type nnzr = nnzr_[row];
+      size_type *ind = ind_[row];
+
+      if (nnzr >= 8 && RowKernels_::enabled())
+        if (const value_type *xp = contiguous_(x)) {
+          *y++ = RowKernels_::sumAt(ind, nnzr, xp);
+          continue;
+        }
+
+      size_type *end1 = ind + 4 * (nnzr / 4), *end2 = ind + nnzr;
+      value_type val = 0.0;
+
+      for (; ind != end1; ind += 4)
+        val += x[*ind] + x[*(ind + 1)] + x[*(ind + 2)] + x[*(ind + 3)];
+
+      while (ind != end2)
+        val += x[*ind++];
+
+      *y++ = val;
+    }
+  }
+
+  // Compare is std::greater (Gt) or std::greater_equal (Gte)
+  template <typename InputIterator, typename OutputIterator, typename Compare>
+  inline void rightVecSumAtNZThresholdRows_(size_type lo, size_type hi,
+                                            InputIterator x, OutputIterator y,
+                                            value_type threshold,
+                                            Compare cmp) const {
+    for (size_type row = lo; row != hi; ++row) {
+
+      size_type nnzr = nnzr_[row];
+      size_type *ind = ind_[row];
+      value_type *nz = nz_[row];
+      value_type val = 0.0;
+
+      for (size_type i = 0; i != nnzr; ++i)
+        if (cmp(nz[i], threshold))
+          val += x[ind[i]];
+
+      *y++ = val;
+    }
+  }
+
+  // mask has a non-zero byte at each column of the sparse input
+  template <typename OutputIterator>
+  inline void rightVecSumAtNZSparseRows_(size_type lo, size_type hi,
+                                         const unsigned char *mask,
+                                         OutputIterator out) const {
+    for (size_type row = lo; row != hi; ++row) {
+
+      size_type *ind_begin = ind_[row];
+      size_type *ind_end = ind_begin + nnzr_[row];
+      difference_type sum = 0;
+
+      for (size_type *ind = ind_begin; ind != ind_end; ++ind) {
+        if (mask[*ind]) {
+          ++sum;
+        }
+      }
+
+      *out++ = sum;
+    }
+  }
+
+  template <typename OutputIterator, typename Compare>
+  inline void rightVecSumAtNZThresholdSparseRows_(size_type lo, size_type hi,
+                                                  const unsigned char *mask,
+                                                  OutputIterator out,
+                                                  value_type threshold,
+                                                  Compare cmp) const {
+    for (size_type row = lo; row != hi; ++row) {
+
+      size_type *ind_begin = ind_[row];
+      size_type *ind_end = ind_begin + nnzr_[row];
+      value_type *nz = nz_[row];
+      difference_type sum = 0;
+
+      for (size_type *ind = ind_begin; ind != ind_end; ++ind) {
+        if (mask[*ind] && cmp(nz[ind - ind_begin], threshold)) {
+          ++sum;
+        }
+      }
+
+      *out++ = sum;
+    }
+  }
+
+  // Column index versions of the two kernels above: only the non-zeros in
+  // the columns cols are visited, through colRows_. accept(row, col) tells
+  // whether the non-zero at (row, col) counts.
+
+  struct AnyNonZero_ {
+    inline bool operator()(size_type, size_type) const { return true; }
+  };
+
+  template <typename Compare> struct NonZeroThreshold_ {
+    const SparseMatrix &m;
+    value_type threshold;
+    Compare cmp;
+
+    inline bool operator()(size_type row, size_type col) const {
+      const size_type *ind_begin = m.ind_[row];
+      const size_type *ind =
+          std::lower_bound(ind_begin, ind_begin + m.nnzr_[row], col);
+      return cmp(m.nz_[row][ind - ind_begin], threshold);
+    }
+  };
+
+  template <typename OutputIterator, typename Accept>
+  inline void rightVecSumAtNZColumnsRows_(size_type lo, size_type hi,
+                                          const std::vector<size_type> &cols,
+                                          OutputIterator out,
+                                          const Accept &accept) const {
+    std::fill(out + lo, out + hi, 0);
+    const bool allRows = lo == 0 && hi == nRows();
+
+    for (size_type col : cols) {
+      const std::vector<size_type> &rows = colRows_[col];
+      auto it = rows.begin(), end = rows.end();
+      if (!allRows) {
+        it = std::lower_bound(it, end, lo);
+        end = std::lower_bound(it, end, hi);
+      }
+      for (; it != end; ++it)
+        if (accept(*it, col))
+          ++out[*it];
+    }
+  }
+
+  /**
+   * Returns the distinct columns in [x_ones_begin, x_ones_end), in a
+   * per-thread buffer.
+   */
+  template <typename InputIterator>
+  inline const std::vector<size_type> &
+  distinctCols_(InputIterator x_ones_begin, InputIterator x_ones_end) const {
+    static thread_local std::vector<size_type> cols;
+    cols.clear();
+    unsigned char *mask = threadScratch_<unsigned char>(nCols());
+    for (InputIterator x_one = x_ones_begin; x_one != x_ones_end; ++x_one)
+      if (!mask[*x_one]) {
+        mask[*x_one] = 1;
+        cols.push_back(*x_one);
+      }
+    for (size_type col : cols)
+      mask[col] = 0;
+    return cols;
+  }
+
+  /**
+   * Computes rightVecSumAtNZSparse (with accept = AnyNonZero_) or one of
+   * its threshold variants through the column index, in parallel if
+   * nThreads != 1.
+   */
+  template <typename InputIterator, typename OutputIterator, typename Accept>
+  inline void rightVecSumAtNZColumns_(InputIterator x_ones_begin,
+                                      InputIterator x_ones_end,
+                                      OutputIterator out_begin,
+                                      const Accept &accept,
+                                      UInt nThreads) const {
+    const std::vector<size_type> &cols =
+        distinctCols_(x_ones_begin, x_ones_end);
+
+    if (nThreads == 1) {
+      rightVecSumAtNZColumnsRows_(0, nRows(), cols, out_begin, accept);
+      return;
+    }
+
+    UInt64 hits = 0;
+    for (size_type col : cols)
+      hits += colRows_[col].size();
+
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZColumnsRows_(lo, hi, cols, out_begin, accept);
+        },
+        nThreads, hits);
+  }
+
+  /**
+   * Sets the mask bytes of the columns in [x_ones_begin, x_ones_end), in the
+   * per-thread scratch buffer, and resets them when it goes out of scope,
+   * including when the kernel that reads the mask throws.
+   */
+  template <typename InputIterator> class SparseMask_ {
+  public:
+    inline SparseMask_(const SparseMatrix &m, InputIterator x_ones_begin,
+                       InputIterator x_ones_end)
+        : mask_(threadScratch_<unsigned char>(m.nCols())),
+          x_ones_begin_(x_ones_begin), x_ones_end_(x_ones_end) {
+      for (InputIterator x_one = x_ones_begin; x_one != x_ones_end; ++x_one)
+        mask_[*x_one] = 1;
+    }
+
+    inline ~SparseMask_() {
+      for (InputIterator x_one = x_ones_begin_; x_one != x_ones_end_;
+           ++x_one)
+        mask_[*x_one] = 0;
+    }
+
+    inline const unsigned char *get() const { return mask_; }
+
+  private:
+    SparseMask_(const SparseMask_ &);
+    SparseMask_ &operator=(const SparseMask_ &);
+
+    unsigned char *mask_;
+    InputIterator x_ones_begin_;
+    InputIterator x_ones_end_;
+  };
+
   /**
    * Erases the non-zero at ind_it on the given row.
    * Copies the row on [ind_it + 1..end) to [ind_it..end-1), erasing
@@ -684,6 +1328,8 @@ protected:
 
     value_type *nz_it = nz_begin_(row) + (ind_it - ind_begin_(row));
 
+    colIndexErase_(row, *ind_it);
+
     std::copy(ind_it + 1, ind_end_(row), ind_it);
     std::copy(nz_it + 1, nz_end_(row), nz_it);
 
@@ -902,17 +1548,13 @@ protected:
       ++nzb;
     }
 
-    if (isCompact())
-      decompact();
-
-    delete[] ind_[i];
-    delete[] nz_[i];
+    reserveRow_(i, nnzr_[i] + 1);
 
     nnzr_[i] += 1;
-    ind_[i] = new size_type[nnzr_[i]];
-    nz_[i] = new value_type[nnzr_[i]];
     std::copy(indb_, indb_ + nnzr_[i], ind_[i]);
     std::copy(nzb_, nzb_ + nnzr_[i], nz_[i]);
+
+    colIndexInsert_(i, j);
   }
 
   /**
@@ -1070,14 +1712,24 @@ protected:
       }
     }
 
-    if (isCompact()) {
-      decompact();
+    if (alwaysCompact_) {
+      reserveRow_(row, nnzr);
+      std::copy(row_ind, row_ind + nnzr, ind_[row]);
+      std::copy(row_nz, row_nz + nnzr, nz_[row]);
+      delete[] row_ind;
+      delete[] row_nz;
+    } else {
+      if (isCompact())
+        decompact();
+      delete[] ind_[row];
+      delete[] nz_[row];
+      ind_[row] = row_ind;
+      nz_[row] = row_nz;
     }
-    delete[] ind_[row];
-    delete[] nz_[row];
-    ind_[row] = row_ind;
-    nz_[row] = row_nz;
     nnzr_[row] = nnzr;
+
+    // The old non-zeros are all still there
+    colIndexInsertRow_(row);
   }
 
 public:
@@ -1242,6 +1894,7 @@ public:
           << "Wrong size for vector of indices";
     } // End pre-conditions
 
+    suspendColumnIndex_();
     deallocate_();
     allocate_(other.nRows(), other.nCols());
     nrows_ = other.nRows();
@@ -1256,6 +1909,8 @@ public:
         std::copy(other.nz_begin_(row), other.nz_end_(row), nz_[row]);
       }
     }
+    recompact_();
+    resumeColumnIndex_();
   }
 
   /**
@@ -1274,6 +1929,7 @@ public:
           << "Wrong size for vector of indices";
     } // End pre-conditions
 
+    suspendColumnIndex_();
     deallocate_();
     allocate_(other.nRows(), other.nCols());
     nrows_ = other.nRows();
@@ -1297,6 +1953,8 @@ public:
       std::copy(other.indb_, other.indb_ + nnzr_[row], ind_[row]);
       std::copy(other.nzb_, other.nzb_ + nnzr_[row], nz_[row]);
     }
+    recompact_();
+    resumeColumnIndex_();
   }
 
   /**
@@ -1312,6 +1970,7 @@ public:
 
     size_type nrows = nRows(), ncols = nCols();
 
+    suspendColumnIndex_();
     deallocate_();
     allocate_(nrows, ncols);
     nrows_ = nrows;
@@ -1332,6 +1991,8 @@ public:
       nz_[r] = new value_type[nnzr];
       std::fill(nz_[r], nz_[r] + nnzr, (value_type)v);
     }
+    recompact_();
+    resumeColumnIndex_();
   }
 
   /**
@@ -1358,7 +2019,8 @@ public:
    * Copies the given sparse matrix into this one.
    * The current state is discarded and other is copied. The dimensions and
    * number
-   * of non-zeros might change.
+   * of non-zeros might change. This matrix has a column index afterwards if
+   * it had one before, or if other has one.
    *
    * @param other [SparseMatrix] the SparseMatrix to copy
    *
@@ -1393,6 +2055,11 @@ public:
       indp += nnz;
       nzp += nnz;
     }
+
+    if (!colIndex_ && other.hasColumnIndex())
+      enableColumnIndex();
+    else if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -1458,6 +2125,47 @@ public:
    */
   inline bool isCompact() const { return ind_mem_ != nullptr; }
 
+  /**
+   * Builds a column index: a mirror of the structure of the matrix that
+   * lists, for each column, the rows with a non-zero in that column. The
+   * products with a sparse binary input (rightVecSumAtNZSparse and its
+   * threshold variants) then only visit the non-zeros of the active columns,
+   * instead of every non-zero of the matrix. Useful when the inputs are
+   * much sparser than the matrix, e.g. segments x presynaptic cells.
+   *
+   * The index costs one size_type per non-zero. Mutators that add or remove
+   * a few non-zeros (set, setZerosOnOuter, setRandomZerosOnOuter,
+   * setRowToZero, filterRow, threshold, clip...) keep it up to date in
+   * place. Mutators that rebuild the whole matrix (copy, resize to fewer
+   * rows or columns, transpose, permuteRows...) rebuild it, in
+   * O(nnz + ncols). Calling this method again rebuilds the index.
+   *
+   * @b Complexity:
+   *  @li O(nnz + ncols)
+   *
+   * @b Exceptions:
+   *  @li Not enough memory (error)
+   */
+  inline void enableColumnIndex() {
+    colIndex_ = true;
+    colIndexSuspended_ = 0;
+    rebuildColumnIndex_();
+  }
+
+  /**
+   * Drops the column index, see enableColumnIndex().
+   */
+  inline void disableColumnIndex() {
+    colIndex_ = false;
+    colIndexSuspended_ = 0;
+    std::vector<std::vector<size_type>>().swap(colRows_);
+  }
+
+  /**
+   * Whether the column index is enabled, see enableColumnIndex().
+   */
+  inline bool hasColumnIndex() const { return colIndex_; }
+
   /**
    * Returns the number of rows in this SparseMatrix.
    *
@@ -2581,30 +3289,47 @@ public:
     if (isCompact())
       return;
 
-    size_type nnz = nNonZeros();
-
-    ind_mem_ = new size_type[nnz];
-    size_type *indp = ind_mem_;
-
-    nz_mem_ = new value_type[nnz];
-    value_type *nzp = nz_mem_;
-
-    ITERATE_ON_ALL_ROWS {
-
-      nnz = nnzr_[row];
-      std::copy(ind_[row], ind_[row] + nnz, indp);
-      std::copy(nz_[row], nz_[row] + nnz, nzp);
-
-      delete[] ind_[row];
-      delete[] nz_[row];
+    if (alwaysCompact_)
+      compactWithSlack_();
+    else
+      packRows_();
+  }
 
-      ind_[row] = indp;
-      nz_[row] = nzp;
-      indp += nnz;
-      nzp += nnz;
+  /**
+   * Keeps this SparseMatrix compact across mutations. Rows are laid out in a
+   * single block of memory with some slack after each row, so that a row can
+   * gain a few non-zeros in place. A row that outgrows its slack is moved to
+   * free space at the end of the block, and the whole block is re-laid out
+   * when that space runs out, which keeps the cost of growth amortized
+   * O(1) per non-zero. Mutators that restructure the matrix (deleteRows,
+   * resize...) re-compact it before returning. In the default mode, those
+   * mutators decompact the matrix instead, and it stays decompacted until
+   * compact() is called.
+   *
+   * The slack costs up to about 25% more memory than compact().
+   *
+   * @param on [bool] whether to keep the matrix compact
+   *
+   * @b Complexity:
+   *  @li O(nnz) when switching on a matrix that is not compact
+   *
+   * @b Exceptions:
+   *  @li Not enough memory (error)
+   */
+  inline void setAlwaysCompact(bool on = true) {
+    alwaysCompact_ = on;
+    if (on && !slackLayout_()) {
+      decompact();
+      compactWithSlack_();
     }
   }
 
+  /**
+   * Whether this matrix is kept compact across mutations, see
+   * setAlwaysCompact().
+   */
+  inline bool isAlwaysCompact() const { return alwaysCompact_; }
+
   /**
    * "De-compacts" this SparseMatrix, that is, each row
    * is allocated separately. All the non-zeros inside a given row
@@ -2643,6 +3368,7 @@ public:
     delete[] nz_mem_;
     ind_mem_ = nullptr;
     nz_mem_ = nullptr;
+    arena_ = nullptr;
   }
 
   // IMPORT/EXPORT
@@ -3119,6 +3845,9 @@ public:
       curr_ind_ptr += nnzr_[row];
       curr_nz_ptr += nnzr_[row];
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -3139,8 +3868,7 @@ public:
       NTA_CHECK(outStream.good()) << "SparseMatrix::toBinary: Bad stream";
     } // End pre-conditions
 
-    if (!isCompact())
-      compact();
+    pack_();
 
     const size_type nnz = nNonZeros();
 
@@ -3183,6 +3911,12 @@ public:
 
     const size_type nrows = nRows();
 
+    // Growing only appends empty rows or columns, which the column index
+    // can follow cheaply. Anything else rebuilds the index.
+    const bool shrinks = new_nrows < nrows || new_ncols < nCols() || setToZero;
+    if (shrinks)
+      suspendColumnIndex_();
+
     if (new_nrows > nrows_max_ - 1)
       reserve_(new_nrows);
 
@@ -3219,6 +3953,13 @@ public:
 
     if (setToZero)
       this->setToZero();
+
+    recompact_();
+
+    if (shrinks)
+      resumeColumnIndex_();
+    else if (colIndexActive_())
+      colRows_.resize(new_ncols);
   }
 
   /**
@@ -3246,8 +3987,9 @@ public:
           << "old number of elements";
     } // End pre-conditions
 
-    if (!isCompact())
-      compact();
+    suspendColumnIndex_();
+
+    pack_();
 
     const size_type old_nrows = nRows();
     const size_type old_ncols = nCols();
@@ -3315,6 +4057,8 @@ public:
 
     nrows_ = new_nrows;
     ncols_ = new_ncols;
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -3326,6 +4070,8 @@ public:
       assert_valid_row_(del_row, "deleteRow");
     } // End pre-conditions
 
+    suspendColumnIndex_();
+
     if (isCompact())
       decompact();
 
@@ -3348,6 +4094,9 @@ public:
     nz_[nrows - 1] = 0;
 
     --nrows_;
+
+    recompact_();
+    resumeColumnIndex_();
   }
 
   /**
@@ -3430,6 +4179,8 @@ public:
       */
     } // End pre-conditions
 
+    suspendColumnIndex_();
+
     if (isCompact())
       decompact();
 
@@ -3457,6 +4208,9 @@ public:
       ind_[i_new] = 0;
       nz_[i_new] = 0;
     }
+
+    recompact_();
+    resumeColumnIndex_();
   }
 
   /**
@@ -3475,6 +4229,8 @@ public:
       assert_valid_col_(del_col, "deleteCol");
     } // End pre-conditions
 
+    suspendColumnIndex_();
+
     ITERATE_ON_ALL_ROWS {
 
       if (isRowZero(row))
@@ -3512,6 +4268,8 @@ public:
     // is caught by the pre-conditions when compiling
     // with assertions on.
     --ncols_;
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -3592,6 +4350,8 @@ public:
       */
     } // End pre-conditions
 
+    suspendColumnIndex_();
+
     ITERATE_ON_ALL_ROWS {
 
       size_type j = 0;
@@ -3627,6 +4387,8 @@ public:
     // is caught by the pre-conditions when compiling
     // with assertions on.
     ncols_ -= size_type(n_del);
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -3677,18 +4439,17 @@ public:
     const size_type row_num = nRows();
     const size_type nnzr = (size_type)(ind_end - ind_it);
 
-    if (isCompact())
-      decompact();
-
     if (row_num > nrows_max_ - 1)
       reserve_(row_num);
 
-    nnzr_[row_num] = nnzr;
+    nnzr_[row_num] = 0;
+    ind_[row_num] = nullptr;
+    nz_[row_num] = nullptr;
+    ++nrows_;
 
     if (nnzr > 0) {
 
-      ind_[row_num] = new size_type[nnzr];
-      nz_[row_num] = new value_type[nnzr];
+      reserveRow_(row_num, nnzr);
 
       size_type *ind_ptr = ind_[row_num];
       value_type *nz_ptr = nz_[row_num];
@@ -3701,14 +4462,10 @@ public:
         ++ind_it;
         ++nz_it;
       }
-
-    } else {
-
-      ind_[row_num] = nullptr;
-      nz_[row_num] = nullptr;
     }
 
-    ++nrows_;
+    nnzr_[row_num] = nnzr;
+    colIndexInsertRow_(row_num);
     return row_num;
   }
 
@@ -3775,21 +4532,12 @@ public:
       assert_valid_ivp_range_(nRows(), ind_it, ind_end, nz_it, "addCol");
     } // End pre-conditions
 
-    if (isCompact())
-      decompact();
+    suspendColumnIndex_();
 
     while (ind_it != ind_end) {
       size_type row = *ind_it;
       size_type old_nnzr = nnzr_[row];
-      size_type new_nnzr = old_nnzr + 1;
-      auto new_ind = new size_type[new_nnzr];
-      auto new_nz = new value_type[new_nnzr];
-      std::copy(ind_[row], ind_[row] + old_nnzr, new_ind);
-      std::copy(nz_[row], nz_[row] + old_nnzr, new_nz);
-      delete[] ind_[row];
-      ind_[row] = new_ind;
-      delete[] nz_[row];
-      nz_[row] = new_nz;
+      reserveRow_(row, old_nnzr + 1, true);
       ind_[row][old_nnzr] = nCols();
       nz_[row][old_nnzr] = *nz_it;
       ++nnzr_[row];
@@ -3799,6 +4547,8 @@ public:
 
     ++ncols_;
     reAllocateBuffers_(ncols_);
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -3819,8 +4569,7 @@ public:
       ASSERT_INPUT_ITERATOR(InputIterator);
     } // End pre-conditions
 
-    if (isCompact())
-      decompact();
+    suspendColumnIndex_();
 
     bool new_non_zeros = false;
 
@@ -3829,15 +4578,7 @@ public:
       if (!isZero_(val)) {
         new_non_zeros = true;
         size_type old_nnzr = nnzr_[row];
-        size_type new_nnzr = old_nnzr + 1;
-        auto new_ind = new size_type[new_nnzr];
-        auto new_nz = new value_type[new_nnzr];
-        std::copy(ind_[row], ind_[row] + old_nnzr, new_ind);
-        std::copy(nz_[row], nz_[row] + old_nnzr, new_nz);
-        delete[] ind_[row];
-        ind_[row] = new_ind;
-        delete[] nz_[row];
-        nz_[row] = new_nz;
+        reserveRow_(row, old_nnzr + 1, true);
         ind_[row][old_nnzr] = nCols();
         nz_[row][old_nnzr] = val;
         ++nnzr_[row];
@@ -3849,6 +4590,8 @@ public:
       ++ncols_;
       reAllocateBuffers_(ncols_);
     }
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -4042,6 +4785,8 @@ public:
       difference_type offset = pos_(row, col_begin, col_end, ind, ind_end);
       if (ind != ind_end_(row)) {
         value_type *nz = nz_begin_(row) + offset;
+        for (size_type *it = ind; it != ind_end; ++it)
+          colIndexErase_(row, *it);
         std::copy(ind_end, ind_end_(row), ind);
         std::copy(nz + (ind_end - ind), nz_end_(row), nz);
         nnzr_[row] -= ind_end - ind;
@@ -4078,8 +4823,6 @@ public:
 
       } else {
 
-        decompact();
-
         std::copy(ind_begin_(row), ind_begin, indb_);
         std::copy(nz_begin_(row), nz_begin, nzb_);
         size_type *indb = indb_ + offset;
@@ -4094,13 +4837,11 @@ public:
         size_type new_nnzr =
             (size_type)(indb - indb_ + ind_end_(row) - ind_end);
 
-        delete[] ind_[row];
-        delete[] nz_[row];
-        ind_[row] = new size_type[new_nnzr];
-        nz_[row] = new value_type[new_nnzr];
+        reserveRow_(row, new_nnzr);
         std::copy(indb_, indb_ + new_nnzr, ind_[row]);
         std::copy(nzb_, nzb_ + new_nnzr, nz_[row]);
         nnzr_[row] = new_nnzr;
+        colIndexInsertRow_(row);
       }
     }
   }
@@ -4492,6 +5233,7 @@ public:
           // Insert a nonzero.
           *indb_it = *selected_col;
           *nzb_it = value;
+          colIndexInsert_(*row, *selected_col);
 
           ++selected_col;
           nextSelectedCol = selected_col != col_end
@@ -4505,14 +5247,7 @@ public:
       if (nnzr > nnzr_[*row]) {
         // It changed. Commit the changes.
 
-        if (isCompact()) {
-          decompact();
-        }
-        delete[] ind_[*row];
-        delete[] nz_[*row];
-
-        ind_[*row] = new size_type[nnzr];
-        nz_[*row] = new value_type[nnzr];
+        reserveRow_(*row, nnzr);
 
         nnzr_[*row] = nnzr;
         std::copy(indb_, indb_ + nnzr, ind_[*row]);
@@ -4988,6 +5723,9 @@ public:
         }
       }
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -5314,8 +6052,6 @@ public:
     size_type o_ncols = src_col_end - src_first_col;
 
     other.resize(o_nrows, o_ncols);
-    other.ind_mem_ = NULL;
-    other.nz_mem_ = NULL;
     other.nrows_ = o_nrows;
     other.ncols_ = o_ncols;
 
@@ -5328,14 +6064,7 @@ public:
             pos_(row, src_first_col, src_col_end, ind, ind_end);
         value_type *nz = nz_begin_(row) + offset;
         size_type nnzr = ind_end - ind;
-        if (nnzr > other.nnzr_[orow]) {
-          if (other.isCompact())
-            other.decompact();
-          delete[] other.ind_[orow];
-          delete[] other.nz_[orow];
-          other.ind_[orow] = new size_type[nnzr];
-          other.nz_[orow] = new value_type[nnzr];
-        }
+        other.reserveRow_(orow, nnzr);
         other.nnzr_[orow] = nnzr;
         size_type *o_ind = other.ind_begin_(orow);
         value_type *o_nz = other.nz_begin_(orow);
@@ -5345,6 +6074,9 @@ public:
         }
       }
     }
+
+    if (other.colIndexActive_())
+      other.rebuildColumnIndex_();
   }
 
   /**
@@ -5363,6 +6095,7 @@ public:
       assert_valid_row_(row, "setRowToZero");
     } // End pre-conditions
 
+    colIndexEraseRow_(row);
     nnzr_[row] = 0;
   }
 
@@ -5419,6 +6152,12 @@ public:
       nz_[row] = nullptr;
       nnzr_[row] = 0;
     }
+
+    if (colIndexActive_())
+      for (auto &rows : colRows_)
+        rows.clear();
+
+    recompact_();
   }
 
   /**
@@ -5426,8 +6165,10 @@ public:
    */
   template <typename InputIterator>
   inline void setRowsToZero(InputIterator it, InputIterator end) {
-    for (; it != end; ++it)
+    for (; it != end; ++it) {
+      colIndexEraseRow_(*it);
       nnzr_[*it] = 0;
+    }
   }
 
   /**
@@ -5456,6 +6197,10 @@ public:
       }
       nnzr_[row] = k;
     }
+
+    if (colIndexActive_())
+      for (size_type col : skip)
+        colRows_[col].clear();
   }
 
   /**
@@ -5524,6 +6269,14 @@ public:
       if (nnzr_[row] > 0)
         ++k;
     }
+
+    if (keepMemory)
+      arena_ = nullptr; // the rows have moved inside the block
+    else
+      recompact_();
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -5584,6 +6337,11 @@ public:
       }
       nnzr_[row] = (size_type)(ind_a - ind_begin_(row));
     }
+
+    recompact_();
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -5658,18 +6416,15 @@ public:
 
     size_type new_nnzr = (size_type)(ind_end - ind_it);
 
-    if (new_nnzr > nnzr_[row]) {
-      if (isCompact())
-        decompact();
-      delete[] ind_[row];
-      delete[] nz_[row];
-      ind_[row] = new size_type[new_nnzr];
-      nz_[row] = new value_type[new_nnzr];
-    }
+    colIndexEraseRow_(row);
+
+    reserveRow_(row, new_nnzr);
 
     std::copy(ind_it, ind_end, ind_[row]);
     std::copy(nz_it, nz_it + new_nnzr, nz_[row]);
     nnzr_[row] = new_nnzr;
+
+    colIndexInsertRow_(row);
   }
 
   /**
@@ -5690,18 +6445,15 @@ public:
 
     size_type new_nnzr = (size_type)(ind_end - ind_it);
 
-    if (new_nnzr > nnzr_[row]) {
-      if (isCompact())
-        decompact();
-      delete[] ind_[row];
-      delete[] nz_[row];
-      ind_[row] = new size_type[new_nnzr];
-      nz_[row] = new value_type[new_nnzr];
-    }
+    colIndexEraseRow_(row);
+
+    reserveRow_(row, new_nnzr);
 
     std::copy(ind_it, ind_end, ind_[row]);
     std::fill(nz_[row], nz_[row] + new_nnzr, init_val);
     nnzr_[row] = new_nnzr;
+
+    colIndexInsertRow_(row);
   }
 
   /**
@@ -5841,19 +6593,16 @@ public:
 
     size_type new_nnzr = other.nNonZerosOnRow(src_row);
 
-    if (new_nnzr > nNonZerosOnRow(dst_row)) {
-      if (isCompact())
-        decompact();
-      delete[] ind_[dst_row];
-      delete[] nz_[dst_row];
-      ind_[dst_row] = new size_type[new_nnzr];
-      nz_[dst_row] = new value_type[new_nnzr];
-    }
+    colIndexEraseRow_(dst_row);
+
+    reserveRow_(dst_row, new_nnzr);
 
     std::copy(other.ind_[src_row], other.ind_[src_row] + new_nnzr,
               ind_[dst_row]);
     std::copy(other.nz_[src_row], other.nz_[src_row] + new_nnzr, nz_[dst_row]);
     nnzr_[dst_row] = new_nnzr;
+
+    colIndexInsertRow_(dst_row);
   }
 
   /**
@@ -6033,6 +6782,8 @@ public:
         ind[nnzr2] = ind[k];
         nz[nnzr2] = nz[k];
         ++nnzr2;
+      } else {
+        colIndexErase_(row, ind[k]);
       }
 
     nnzr_[row] = nnzr2;
@@ -6058,6 +6809,7 @@ public:
         nz[nnzr2] = nz[k];
         ++nnzr2;
       } else {
+        colIndexErase_(row, ind[k]);
         *cut_ind++ = ind[k];
         *cut_nz++ = nz[k];
         ++count;
@@ -6164,6 +6916,9 @@ public:
       ind_[row] = ind_old[*p];
       nz_[row] = nz_old[*p];
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -6205,6 +6960,9 @@ public:
         }
       }
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -6285,6 +7043,9 @@ public:
     std::fill(ind_ + beginZero, ind_ + endZero, (size_type *)0);
     std::fill(nz_ + beginZero, nz_ + endZero, (value_type *)0);
     std::fill(nnzr_ + beginZero, nnzr_ + endZero, (size_type)0);
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   //---------------------------------------------------------------------
@@ -6347,6 +7108,9 @@ public:
           *ind_write -= ln;
       }
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   // APPLY
@@ -6388,6 +7152,7 @@ public:
     for (; ind != ind_end; ++ind, ++nz) {
       value_type val = f1(*nz);
       if (isZero_(val)) {
+        colIndexErase_(row, *ind);
         ++offset;
       } else {
         *(nz - offset) = val;
@@ -6488,6 +7253,71 @@ public:
     set_row_(row, nzb_, nzb_ + nCols());
   }
 
+  /**
+   * Applies given functor to all the elements of the given rows, in parallel
+   * on the shared ThreadPool:
+   *
+   *  this[row,col] = f1(this[row,col])
+   *
+   * where:
+   *  row,col in {rows} X [0,ncols)
+   *
+   * Rows whose number of non-zeros does not grow are updated in place by the
+   * worker threads. The few that grow need new storage and are recomputed
+   * serially afterwards by elementRowApply, so f1 must have no side effects.
+   *
+   * @param row_begin [RandomAccessIterator<size_type>] beginning of the
+   *  range of rows to process, which must be distinct
+   * @param row_end [RandomAccessIterator<size_type>] end of the range
+   * @param f1 [F] a unary functor to apply to each element of the rows
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   *
+   * @b Exceptions:
+   *  @li If a row index in the range is not a valid row index.
+   */
+  template <typename InputIterator, typename UnaryFunction>
+  inline void elementRowApply_parallel(InputIterator row_begin,
+                                       InputIterator row_end,
+                                       const UnaryFunction &f1,
+                                       UInt nThreads = 0) {
+    { // Pre-conditions
+      ASSERT_UNARY_FUNCTION(UnaryFunction, value_type, value_type);
+      assert_valid_row_it_range_(row_begin, row_end,
+                                 "elementRowApply_parallel");
+    } // End pre-conditions
+
+    const size_type n = (size_type)(row_end - row_begin);
+    const size_type ncols = nCols();
+    std::vector<unsigned char> grown(n, 0);
+
+    suspendColumnIndex_();
+
+    // Each row costs O(ncols), whatever its number of non-zeros
+    const UInt grain = (UInt)std::max<UInt64>(1, 16384 / ((UInt64)ncols + 1));
+
+    nupic::util::ThreadPool::shared().parallelFor(
+        0, (UInt)n,
+        [&](UInt lo, UInt hi) {
+          value_type *dense = threadScratch_<value_type>(ncols);
+          for (UInt i = lo; i != hi; ++i) {
+            const size_type row = row_begin[i];
+            getRowToDense(row, dense);
+            for (size_type col = 0; col != ncols; ++col)
+              dense[col] = f1(dense[col]);
+            if (!set_row_in_place_(row, dense))
+              grown[i] = 1;
+          }
+          std::fill(dense, dense + ncols, (value_type)0);
+        },
+        grain, nThreads);
+
+    for (size_type i = 0; i != n; ++i)
+      if (grown[i])
+        elementRowApply(row_begin[i], f1);
+
+    resumeColumnIndex_();
+  }
+
   /**
    * Applies given unary function to all the elements on the given column, the
    * zeros
@@ -6538,8 +7368,10 @@ public:
       ASSERT_UNARY_FUNCTION(UnaryFunction, value_type, value_type);
     } // End pre-conditions
 
+    suspendColumnIndex_();
     ITERATE_ON_ALL_ROWS
     elementRowApply(row, f1);
+    resumeColumnIndex_();
   }
 
   /**
@@ -6576,6 +7408,7 @@ public:
     for (; ind != ind_end; ++ind, ++nz) {
       value_type val = f2(*nz, *(x_begin + *ind));
       if (isZero_(val)) {
+        colIndexErase_(row, *ind);
         ++offset;
       } else {
         *(nz - offset) = val;
@@ -6821,6 +7654,8 @@ public:
           ind_[row][nnzr2] = *ind;
           nz_[row][nnzr2] = val;
           ++nnzr2;
+        } else {
+          colIndexErase_(row, *ind);
         }
       }
       nnzr_[row] = nnzr2;
@@ -6854,10 +7689,18 @@ public:
 
     } // End pre-conditions
 
+    // Densify the rows of other in a buffer of our own rather than in
+    // other's nzb_: other may be read by other threads
+    value_type *dense = threadScratch_<value_type>(nCols());
+
+    suspendColumnIndex_();
     ITERATE_ON_ALL_ROWS {
-      const_cast<SparseMatrix &>(other).to_nzb_(row);
-      elementRowApply(row, f2, other.nzb_);
+      other.getRowToDense(row, dense);
+      elementRowApply(row, f2, dense);
     }
+    resumeColumnIndex_();
+
+    std::fill(dense, dense + nCols(), (value_type)0);
   }
 
   /**
@@ -7337,6 +8180,9 @@ public:
         *nzp++ = rnz[k];
       }
     }
+
+    if (tr.colIndexActive_())
+      tr.rebuildColumnIndex_();
   }
 
   /**
@@ -7382,6 +8228,9 @@ public:
         *nzp++ = rnz[k];
       }
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -7488,6 +8337,30 @@ public:
                      threshold));
   }
 
+  /**
+   * Same as threshold(threshold), with the rows split among the threads of
+   * the shared ThreadPool. Rows are filtered in place, without allocation.
+   *
+   * @param thresold [value_type] the threshold to apply
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   *
+   * @b Exceptions:
+   *  @li None.
+   */
+  inline void threshold_parallel(const value_type &threshold = nupic::Epsilon,
+                                 UInt nThreads = 0) {
+    auto keep = std::bind(std::greater_equal<value_type>(),
+                          std::placeholders::_1, threshold);
+    suspendColumnIndex_();
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row)
+            filterRow(row, keep);
+        },
+        nThreads);
+    resumeColumnIndex_();
+  }
+
   template <typename OutputIterator1, typename OutputIterator2>
   inline size_type threshold(const value_type &threshold, OutputIterator1 cut_i,
                              OutputIterator1 cut_j, OutputIterator2 cut_nz) {
@@ -8857,6 +9730,7 @@ public:
     ITERATE_ON_ALL_ROWS {
       value_type val = *s_begin;
       if (isZero_(val)) {
+        colIndexEraseRow_(row);
         nnzr_[row] = 0;
       } else {
         ITERATE_ON_ROW
@@ -9306,6 +10180,8 @@ public:
     const size_type nrows = nRows();
     const size_type ncols = nCols();
 
+    suspendColumnIndex_();
+
     for (size_type i = 0; i != nrows; ++i) {
 
       std::fill(nzb_, nzb_ + ncols, (value_type)0);
@@ -9327,6 +10203,8 @@ public:
 
       set_row_(i, nzb_, nzb_ + nCols());
     }
+
+    resumeColumnIndex_();
   }
 
   /**
@@ -9414,17 +10292,15 @@ public:
       ++k;
     }
 
-    if (isCompact())
-      decompact();
+    colIndexEraseRow_(dst_row);
 
-    delete[] ind_[dst_row];
-    delete[] nz_[dst_row];
+    reserveRow_(dst_row, k);
 
     nnzr_[dst_row] = k;
-    ind_[dst_row] = new size_type[nnzr_[dst_row]];
-    nz_[dst_row] = new value_type[nnzr_[dst_row]];
     std::copy(indb_, indb_ + nnzr_[dst_row], ind_[dst_row]);
     std::copy(nzb_, nzb_ + nnzr_[dst_row], nz_[dst_row]);
+
+    colIndexInsertRow_(dst_row);
   }
 
   /**
@@ -9527,18 +10403,15 @@ public:
 
       size_type nnzr = (size_type)(indb - indb_);
 
-      if (nnzr > nnzr_[row]) {
-        decompact();
-        delete[] ind_[row];
-        delete[] nz_[row];
-        ind_[row] = new size_type[nnzr];
-        nz_[row] = new value_type[nnzr];
-      }
+      reserveRow_(row, nnzr);
 
       std::copy(indb_, indb_ + nnzr, ind_[row]);
       std::copy(nzb_, nzb_ + nnzr, nz_[row]);
       nnzr_[row] = nnzr;
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   // MULTIPLY
@@ -9568,6 +10441,7 @@ public:
     } // End pre-conditions
 
     C.resize(nRows(), B.nCols());
+    C.suspendColumnIndex_();
 
     size_type nrowsB = B.nRows();
     size_type nrowsC = C.nRows();
@@ -9609,6 +10483,8 @@ public:
 
       C.set_row_(iC, C.nzb_, C.nzb_ + C.nCols());
     }
+
+    C.resumeColumnIndex_();
   }
 
   /**
@@ -9656,6 +10532,9 @@ public:
         nnzr_[row] = (size_type)(ind_a_2 - ind_begin_(row));
       }
     }
+
+    if (colIndexActive_())
+      rebuildColumnIndex_();
   }
 
   /**
@@ -9691,6 +10570,7 @@ public:
         size_type col = *ind;
         value_type val = *nz * *(dense + row * nCols() + col);
         if (isZero_(val)) {
+          colIndexErase_(row, col);
           ++offset;
         } else {
           *(nz - offset) = val;
@@ -9801,6 +10681,10 @@ public:
     if (nnzr == 0)
       return 0;
 
+    if (nnzr >= 8 && RowKernels_::enabled())
+      if (const value_type *xp = contiguous_(x))
+        return RowKernels_::dot(ind_[row], nz_[row], nnzr, xp);
+
     value_type a, b, val = 0;
     size_type *ind = ind_begin_(row);
     size_type *end1 = ind + 4 * (nnzr / 4), *end2 = ind_end_(row);
@@ -9840,10 +10724,27 @@ public:
    */
   template <typename InputIterator, typename OutputIterator>
   inline void rightVecProd(InputIterator x, OutputIterator y) const {
-    ITERATE_ON_ALL_ROWS {
-      *y = rightVecProd(row, x);
-      ++y;
-    }
+    rightVecProdRows_(0, nRows(), x, y);
+  }
+
+  /**
+   * Same as rightVecProd(x, y), with the rows split among the threads of
+   * the shared ThreadPool. Produces the same result as rightVecProd.
+   *
+   * @param x [InputIterator<value_type>] input vector (size = number of
+   * columns)
+   * @param y [RandomAccessIterator<value_type>] result (size = number of rows)
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   *
+   * @b Exceptions:
+   *  @li None
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecProd_parallel(InputIterator x, OutputIterator y,
+                                    UInt nThreads = 0) const {
+    parallelRows_(
+        [&](UInt lo, UInt hi) { rightVecProdRows_(lo, hi, x, y + lo); },
+        nThreads);
   }
 
   /**
@@ -10038,6 +10939,54 @@ public:
     }
   }
 
+  /**
+   * Same as leftVecProd(x, y), with the columns split among the threads of
+   * the shared ThreadPool. Each thread scans all the rows, but only the
+   * non-zeros in its own range of columns, so that every y[col] is still
+   * accumulated in row order: the result is identical to leftVecProd's.
+   *
+   * @param x [InputIterator<value_type>] input vector (size = number of rows)
+   * @param y [RandomAccessIterator<value_type>] result (size = number of
+   * columns)
+   * @param nThreads [UInt] maximum number of threads, 0 for the pool size
+   *
+   * @b Exceptions:
+   *  @li None
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void leftVecProd_parallel(InputIterator x, OutputIterator y,
+                                   UInt nThreads = 0) const {
+    const UInt64 minNonZerosPerChunk = 16384;
+    const size_type ncols = nCols();
+    if (ncols == 0)
+      return;
+    UInt64 grain = minNonZerosPerChunk * ncols / ((UInt64)nNonZeros() + 1);
+    grain = std::min<UInt64>(std::max<UInt64>(grain, 1), ncols);
+
+    nupic::util::ThreadPool::shared().parallelFor(
+        0, (UInt)ncols,
+        [&](UInt lo, UInt hi) {
+          std::fill(y + lo, y + hi, (value_type)0);
+
+          ITERATE_ON_ALL_ROWS {
+
+            value_type val = x[row];
+
+            if (isZero_(val))
+              continue;
+
+            size_type *ind_begin = ind_begin_(row), *ind_end = ind_end_(row);
+            size_type *ind =
+                lo == 0 ? ind_begin : std::lower_bound(ind_begin, ind_end, lo);
+            value_type *nz = nz_begin_(row) + (ind - ind_begin);
+
+            for (; ind != ind_end && *ind < hi; ++ind, ++nz)
+              y[*ind] += *nz * val;
+          }
+        },
+        (UInt)grain, nThreads);
+  }
+
   /**
    * Computes the standard product of vector x by this SparseMatrix on the left
    * side and puts the result in vector, for some columns only:
@@ -10066,9 +11015,10 @@ public:
       assert_valid_col_it_range_(begin, end, "leftVecProd");
     } // End pre-conditions
 
+    size_type *pos = threadScratch_<size_type>(nCols());
     size_type c = 0;
     for (InputIterator2 i = begin; i != end; ++i, ++c)
-      indb_[*i] = c;
+      pos[*i] = c;
     std::fill(y, y + c, (value_type)0);
 
     ITERATE_ON_ALL_ROWS {
@@ -10081,7 +11031,7 @@ public:
       while (j != end && ind != ind_end) {
         size_type col = *j;
         if (col == *ind) {
-          y[indb_[col]] += *nz * val;
+          y[pos[col]] += *nz * val;
           ++ind;
           ++nz;
           ++j;
@@ -10093,6 +11043,9 @@ public:
         }
       }
     }
+
+    for (InputIterator2 i = begin; i != end; ++i)
+      pos[*i] = 0;
   }
 
   /**
@@ -10124,9 +11077,10 @@ public:
                                        "leftVecProd_binary");
     } // End pre-conditions
 
+    size_type *pos = threadScratch_<size_type>(nCols());
     size_type c = 0;
     for (InputIterator2 i = begin; i != end; ++i, ++c)
-      indb_[*i] = c;
+      pos[*i] = c;
     std::fill(y, y + c, (value_type)0);
 
     ITERATE_ON_ALL_ROWS {
@@ -10140,9 +11094,12 @@ public:
         size_type col = *j;
         p = std::lower_bound(p, ind_end, col);
         if (p != ind_end && *p == col)
-          y[indb_[col]] += *(nz_begin + (p - ind_begin)) * val;
+          y[pos[col]] += *(nz_begin + (p - ind_begin)) * val;
       }
     }
+
+    for (InputIterator2 i = begin; i != end; ++i)
+      pos[*i] = 0;
   }
 
   /**
@@ -10244,22 +11201,19 @@ public:
    */
   template <typename InputIterator, typename OutputIterator>
   inline void rightVecSumAtNZ(InputIterator x, OutputIterator y) const {
+    rightVecSumAtNZRows_(0, nRows(), x, y);
+  }
 
-    ITERATE_ON_ALL_ROWS {
-
-      size_type nnzr = nnzr_[row];
-      size_type *ind = ind_[row];
-      size_type *end1 = ind + 4 * (nnzr / 4), *end2 = ind + nnzr;
-      value_type val = 0.0;
-
-      for (; ind != end1; ind += 4)
-        val += x[*ind] + x[*(ind + 1)] + x[*(ind + 2)] + x[*(ind + 3)];
-
-      while (ind != end2)
-        val += x[*ind++];
-
-      *y++ = val;
-    }
+  /**
+   * Row-parallel rightVecSumAtNZ, on the shared ThreadPool. y must be a
+   * random access iterator. Produces the same result as rightVecSumAtNZ.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZ_parallel(InputIterator x, OutputIterator y,
+                                       UInt nThreads = 0) const {
+    parallelRows_(
+        [&](UInt lo, UInt hi) { rightVecSumAtNZRows_(lo, hi, x, y + lo); },
+        nThreads);
   }
 
   /**
@@ -10286,31 +11240,48 @@ public:
                                  "rightVecSumAtNZSparse");
     } // End pre-conditions
 
+    if (colIndexActive_()) {
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              AnyNonZero_(), 1);
+      return;
+    }
+
     // One approach would be to walk a sorted list of ones for every row in the
     // matrix. But x is queried for every nonzero in the matrix, so in practice
     // it's much faster to create an x dense array and then perform simple
     // lookups on the dense array.
-    std::fill(indb_, indb_ + nCols(), (size_type)0);
-    for (InputIterator x_one = x_ones_begin; x_one != x_ones_end; ++x_one) {
-      indb_[*x_one] = 1;
-    }
-
-    OutputIterator out = out_begin;
-
-    ITERATE_ON_ALL_ROWS {
-
-      size_type *ind_begin = ind_[row];
-      size_type *ind_end = ind_begin + nnzr_[row];
-      difference_type sum = 0;
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    rightVecSumAtNZSparseRows_(0, nRows(), mask, out_begin);
+  }
 
-      for (size_type *ind = ind_begin; ind != ind_end; ++ind) {
-        if (indb_[*ind]) {
-          ++sum;
-        }
-      }
+  /**
+   * Row-parallel rightVecSumAtNZSparse, on the shared ThreadPool. out must
+   * be a random access iterator.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZSparse_parallel(InputIterator x_ones_begin,
+                                             InputIterator x_ones_end,
+                                             OutputIterator out_begin,
+                                             UInt nThreads = 0) const {
+    { // Pre-conditions
+      assert_valid_col_it_range_(x_ones_begin, x_ones_end,
+                                 "rightVecSumAtNZSparse_parallel");
+    } // End pre-conditions
 
-      *out++ = sum;
+    if (colIndexActive_()) {
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              AnyNonZero_(), nThreads);
+      return;
     }
+
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZSparseRows_(lo, hi, mask, out_begin + lo);
+        },
+        nThreads);
   }
 
   /**
@@ -10320,20 +11291,24 @@ public:
   template <typename InputIterator, typename OutputIterator>
   inline void rightVecSumAtNZGtThreshold(InputIterator x, OutputIterator y,
                                          value_type threshold) const {
+    rightVecSumAtNZThresholdRows_(0, nRows(), x, y, threshold,
+                                  std::greater<value_type>());
+  }
 
-    ITERATE_ON_ALL_ROWS {
-
-      size_type nnzr = nnzr_[row];
-      size_type *ind = ind_[row];
-      value_type *nz = nz_[row];
-      value_type val = 0.0;
-
-      for (size_type i = 0; i != nnzr; ++i)
-        if (nz[i] > threshold)
-          val += x[ind[i]];
-
-      *y++ = val;
-    }
+  /**
+   * Row-parallel rightVecSumAtNZGtThreshold, on the shared ThreadPool.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZGtThreshold_parallel(InputIterator x,
+                                                  OutputIterator y,
+                                                  value_type threshold,
+                                                  UInt nThreads = 0) const {
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZThresholdRows_(lo, hi, x, y + lo, threshold,
+                                        std::greater<value_type>());
+        },
+        nThreads);
   }
 
   /**
@@ -10353,28 +11328,55 @@ public:
                                  "rightVecSumAtNZGtThresholdSparse");
     } // End pre-conditions
 
-    std::fill(indb_, indb_ + nCols(), (size_type)0);
-    for (InputIterator x_one = x_ones_begin; x_one != x_ones_end; ++x_one) {
-      indb_[*x_one] = 1;
+    if (colIndexActive_()) {
+      typedef std::greater<value_type> Compare;
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              NonZeroThreshold_<Compare>{*this, threshold,
+                                                         Compare()},
+                              1);
+      return;
     }
 
-    OutputIterator out = out_begin;
-
-    ITERATE_ON_ALL_ROWS {
-
-      size_type *ind_begin = ind_[row];
-      size_type *ind_end = ind_begin + nnzr_[row];
-      value_type *nz = nz_[row];
-      difference_type sum = 0;
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    rightVecSumAtNZThresholdSparseRows_(0, nRows(), mask, out_begin, threshold,
+                                        std::greater<value_type>());
+  }
 
-      for (size_type *ind = ind_begin; ind != ind_end; ++ind) {
-        if (indb_[*ind] && nz[ind - ind_begin] > threshold) {
-          ++sum;
-        }
-      }
+  /**
+   * Row-parallel rightVecSumAtNZGtThresholdSparse, on the shared ThreadPool.
+   * out must be a random access iterator.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void
+  rightVecSumAtNZGtThresholdSparse_parallel(InputIterator x_ones_begin,
+                                            InputIterator x_ones_end,
+                                            OutputIterator out_begin,
+                                            value_type threshold,
+                                            UInt nThreads = 0) const {
+    { // Pre-conditions
+      assert_valid_col_it_range_(x_ones_begin, x_ones_end,
+                                 "rightVecSumAtNZGtThresholdSparse_parallel");
+    } // End pre-conditions
 
-      *out++ = sum;
+    if (colIndexActive_()) {
+      typedef std::greater<value_type> Compare;
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              NonZeroThreshold_<Compare>{*this, threshold,
+                                                         Compare()},
+                              nThreads);
+      return;
     }
+
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZThresholdSparseRows_(lo, hi, mask, out_begin + lo,
+                                              threshold,
+                                              std::greater<value_type>());
+        },
+        nThreads);
   }
 
   /**
@@ -10384,19 +11386,24 @@ public:
   template <typename InputIterator, typename OutputIterator>
   inline void rightVecSumAtNZGteThreshold(InputIterator x, OutputIterator y,
                                           value_type threshold) const {
-    ITERATE_ON_ALL_ROWS {
-
-      size_type nnzr = nnzr_[row];
-      size_type *ind = ind_[row];
-      value_type *nz = nz_[row];
-      value_type val = 0.0;
-
-      for (size_type i = 0; i != nnzr; ++i)
-        if (nz[i] >= threshold)
-          val += x[ind[i]];
+    rightVecSumAtNZThresholdRows_(0, nRows(), x, y, threshold,
+                                  std::greater_equal<value_type>());
+  }
 
-      *y++ = val;
-    }
+  /**
+   * Row-parallel rightVecSumAtNZGteThreshold, on the shared ThreadPool.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void rightVecSumAtNZGteThreshold_parallel(InputIterator x,
+                                                   OutputIterator y,
+                                                   value_type threshold,
+                                                   UInt nThreads = 0) const {
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZThresholdRows_(lo, hi, x, y + lo, threshold,
+                                        std::greater_equal<value_type>());
+        },
+        nThreads);
   }
 
   /**
@@ -10416,28 +11423,55 @@ public:
                                  "rightVecSumAtNZGteThresholdSparse");
     } // End pre-conditions
 
-    std::fill(indb_, indb_ + nCols(), (size_type)0);
-    for (InputIterator x_one = x_ones_begin; x_one != x_ones_end; ++x_one) {
-      indb_[*x_one] = 1;
+    if (colIndexActive_()) {
+      typedef std::greater_equal<value_type> Compare;
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              NonZeroThreshold_<Compare>{*this, threshold,
+                                                         Compare()},
+                              1);
+      return;
     }
 
-    OutputIterator out = out_begin;
-
-    ITERATE_ON_ALL_ROWS {
-
-      size_type *ind_begin = ind_[row];
-      size_type *ind_end = ind_begin + nnzr_[row];
-      value_type *nz = nz_[row];
-      difference_type sum = 0;
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    rightVecSumAtNZThresholdSparseRows_(0, nRows(), mask, out_begin, threshold,
+                                        std::greater_equal<value_type>());
+  }
 
-      for (size_type *ind = ind_begin; ind != ind_end; ++ind) {
-        if (indb_[*ind] && nz[ind - ind_begin] >= threshold) {
-          ++sum;
-        }
-      }
+  /**
+   * Row-parallel rightVecSumAtNZGteThresholdSparse, on the shared ThreadPool.
+   * out must be a random access iterator.
+   */
+  template <typename InputIterator, typename OutputIterator>
+  inline void
+  rightVecSumAtNZGteThresholdSparse_parallel(InputIterator x_ones_begin,
+                                             InputIterator x_ones_end,
+                                             OutputIterator out_begin,
+                                             value_type threshold,
+                                             UInt nThreads = 0) const {
+    { // Pre-conditions
+      assert_valid_col_it_range_(x_ones_begin, x_ones_end,
+                                 "rightVecSumAtNZGteThresholdSparse_parallel");
+    } // End pre-conditions
 
-      *out++ = sum;
+    if (colIndexActive_()) {
+      typedef std::greater_equal<value_type> Compare;
+      rightVecSumAtNZColumns_(x_ones_begin, x_ones_end, out_begin,
+                              NonZeroThreshold_<Compare>{*this, threshold,
+                                                         Compare()},
+                              nThreads);
+      return;
     }
+
+    const SparseMask_<InputIterator> guard(*this, x_ones_begin, x_ones_end);
+    const unsigned char *mask = guard.get();
+    parallelRows_(
+        [&](UInt lo, UInt hi) {
+          rightVecSumAtNZThresholdSparseRows_(lo, hi, mask, out_begin + lo,
+                                              threshold,
+                                              std::greater_equal<value_type>());
+        },
+        nThreads);
   }
 
   /**
@@ -10719,6 +11753,12 @@ public:
   inline void vecMaxProd(InputIterator x, OutputIterator y) const {
     ITERATE_ON_ALL_ROWS {
 
+      if (nnzr_[row] >= 8 && RowKernels_::enabled())
+        if (const value_type *xp = contiguous_(x)) {
+          *y++ = RowKernels_::maxProd(ind_[row], nz_[row], nnzr_[row], xp);
+          continue;
+        }
+
       value_type max_v = nnzr_[row] == 0 ? 0 : nz_[row][0] * x[ind_[row][0]];
 
       ITERATE_ON_ROW {
@@ -10783,7 +11823,8 @@ public:
       NTA_ASSERT(C.nCols() == B.nRows());
     }
 
-    nzb_[0] = (value_type)1;
+    const value_type one = (value_type)1;
+    size_type match = 0;
     bool matched = false;
 
     for (size_type i = 0; i != this->nRows(); ++i) {
@@ -10796,14 +11837,14 @@ public:
                  (nearlyEqual(nz_[i][j], B.nz_[i2][j])))
             ++j;
           if (j == nnzr) {
-            indb_[0] = i2;
+            match = i2;
             matched = true;
             break;
           }
         }
       }
       if (matched)
-        C.addRow(indb_, indb_ + 1, nzb_);
+        C.addRow(&match, &match + 1, &one);
     }
   }
 
@@ -10942,6 +11983,8 @@ public:
     std::copy(tmp_nnzr.begin(), tmp_nnzr.end(), nnzr_);
     std::copy(tmp_ind.begin(), tmp_ind.end(), ind_);
     std::copy(tmp_nz.begin(), tmp_nz.end(), nz_);
+
+    recompact_();
   }
 
 private:
@@ -38,4 +38,8 @@ namespace nupic {
 std::vector<LogSumApprox::value_type> LogSumApprox::table;
 std::vector<LogDiffApprox::value_type> LogDiffApprox::table;
 
+// Whether the log-domain methods of SparseMatrixAlgorithms bypass the
+// batched log and exp kernels.
+bool SparseMatrixAlgorithms::exactLogExp_ = false;
+
 } // end namespace nupic
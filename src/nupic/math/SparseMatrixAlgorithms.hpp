@@ -27,7 +27,9 @@
 #ifndef NTA_SM_ALGORITHMS_HPP
 #define NTA_SM_ALGORITHMS_HPP
 
+#include <nupic/math/Math.hpp>
 #include <nupic/utils/Random.hpp>
+#include <type_traits>
 #include <vector>
 
 //--------------------------------------------------------------------------------
@@ -43,6 +45,20 @@ namespace nupic {
  * parameter "SM" stands for a SparseMatrix type.
  */
 struct SparseMatrixAlgorithms {
+  //--------------------------------------------------------------------------------
+  /**
+   * Selects how the log-domain methods (matrix_entropy, logSumNoAlloc,
+   * logAddValNoAlloc, logDiffNoAlloc) evaluate log and exp on single
+   * precision matrices. By default, they process a row at a time with
+   * fast_log and fast_exp (see Math.hpp). When exact is true, they call the
+   * C library on each non-zero, and their results are bit-exactly those of
+   * the scalar implementation. Double precision matrices always use the C
+   * library.
+   */
+  static void setExactLogExp(bool exact) { exactLogExp_ = exact; }
+
+  static bool getExactLogExp() { return exactLogExp_; }
+
   //--------------------------------------------------------------------------------
   /**
    * Computes the entropy rate of a sparse matrix, along the rows or the
@@ -144,6 +160,11 @@ struct SparseMatrixAlgorithms {
 
     Log2<value_type> log2_f;
 
+    if (fastLogExp_<value_type>()) {
+      matrix_entropy_fast_(sm, row_sums, row_out, col_out, s);
+      return;
+    }
+
     for (size_type c = 0; c != n; ++c) {
       value_type v = s / sm.nzb_[c];
       *(col_out + c) = -((value_type)(m - sm.indb_[c]) * v * log2_f(v));
@@ -164,6 +185,54 @@ struct SparseMatrixAlgorithms {
     }
   }
 
+  // matrix_entropy with the logs of each row computed by a single call to
+  // fast_log. The sums are accumulated in the same order as above.
+  template <typename SM, typename OutputIter>
+  static void
+  matrix_entropy_fast_(const SM &sm,
+                       const std::vector<typename SM::value_type> &row_sums,
+                       OutputIter row_out, OutputIter col_out,
+                       typename SM::value_type s) {
+    typedef typename SM::size_type size_type;
+    typedef typename SM::value_type value_type;
+
+    const value_type log2e = (value_type)1.44269504088896341;
+    size_type m = sm.nRows(), n = sm.nCols();
+
+    value_type *v = logScratch_<value_type>(2 * n);
+    for (size_type c = 0; c != n; ++c)
+      v[c] = s / sm.nzb_[c];
+    batchLog_(v, v + n, v + n);
+    for (size_type c = 0; c != n; ++c)
+      *(col_out + c) =
+          -((value_type)(m - sm.indb_[c]) * v[c] * (v[n + c] * log2e));
+
+    for (size_type row = 0; row != m; ++row, ++row_out) {
+      const size_type nnzr = sm.nnzr_[row];
+      size_type *ind = sm.ind_[row];
+      value_type *nz = sm.nz_[row];
+
+      // v[k] is the value of non-zero k in its row, v[nnzr + k] in its
+      // column, and v[2 * nnzr] is the value of the zeros of the row
+      v = logScratch_<value_type>(2 * (2 * nnzr + 1));
+      value_type *lv = v + 2 * nnzr + 1;
+      for (size_type k = 0; k != nnzr; ++k) {
+        value_type x = nz[k] + s;
+        v[k] = x / row_sums[row];
+        v[nnzr + k] = x / sm.nzb_[ind[k]];
+      }
+      v[2 * nnzr] = s / row_sums[row];
+      batchLog_(v, v + 2 * nnzr + 1, lv);
+
+      *row_out = -((value_type)(n - nnzr) * v[2 * nnzr] *
+                   (lv[2 * nnzr] * log2e));
+      for (size_type k = 0; k != nnzr; ++k) {
+        *row_out -= v[k] * (lv[k] * log2e);
+        *(col_out + ind[k]) -= v[nnzr + k] * (lv[nnzr + k] * log2e);
+      }
+    }
+  }
+
   //--------------------------------------------------------------------------------
   /**
    * Multiplies the 'X' matrix by the constant 'a',
@@ -373,11 +442,14 @@ struct SparseMatrixAlgorithms {
    * for row in [0,nrows):
    *  y[row] = max((this[row,col] + k) * x[col], for col in [0,ncols))
    *
+   * The rows are split among at most nThreads threads of the shared
+   * ThreadPool (0 for the pool size), which does not change the result.
    */
   template <typename SM, typename InputIterator, typename OutputIterator>
   static void smoothVecMaxProd(const SM &sm, typename SM::value_type k,
                                InputIterator x, InputIterator x_end,
-                               OutputIterator y, OutputIterator y_end) {
+                               OutputIterator y, OutputIterator y_end,
+                               UInt nThreads = 1) {
     typedef typename SM::size_type size_type;
     typedef typename SM::value_type value_type;
 
@@ -390,23 +462,28 @@ struct SparseMatrixAlgorithms {
     for (size_type j = 0; j != sm.nCols(); ++j)
       sm.nzb_[j] = k * x[j];
 
-    for (size_type row = 0; row != sm.nRows(); ++row) {
+    // Every row visits all the columns
+    sm.parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
 
-      value_type max_v = -std::numeric_limits<value_type>::max();
-      size_type *ind = sm.ind_[row], *ind_end = ind + sm.nnzr_[row];
-      value_type *nz = sm.nz_[row];
+            value_type max_v = -std::numeric_limits<value_type>::max();
+            size_type *ind = sm.ind_[row], *ind_end = ind + sm.nnzr_[row];
+            value_type *nz = sm.nz_[row];
 
-      for (size_type col = 0; col != sm.nCols(); ++col) {
+            for (size_type col = 0; col != sm.nCols(); ++col) {
 
-        value_type p = sm.nzb_[col];
-        if (ind != ind_end && col == *ind)
-          p += *nz++ * x[*ind++];
-        if (p > max_v)
-          max_v = p;
-      }
+              value_type p = sm.nzb_[col];
+              if (ind != ind_end && col == *ind)
+                p += *nz++ * x[*ind++];
+              if (p > max_v)
+                max_v = p;
+            }
 
-      *y++ = max_v;
-    }
+            *(y + row) = max_v;
+          }
+        },
+        nThreads, (UInt64)sm.nRows() * sm.nCols());
   }
 
   //--------------------------------------------------------------------------------
@@ -816,8 +893,8 @@ struct SparseMatrixAlgorithms {
     for (size_type row = 0; row != M; ++row) {
 
       size_type *ind_a = A.ind_begin_(row);
-      typename SM01::Row::const_iterator ind_b = B.ind_begin_(row);
-      typename SM01::Row::const_iterator ind_b_end = B.ind_end_(row);
+      const typename SM01::nz_index_type *ind_b = B.ind_begin_(row);
+      const typename SM01::nz_index_type *ind_b_end = B.ind_end_(row);
       value_type *nz_a = A.nz_begin_(row);
       value_type *nz_a_end = A.nz_end_(row);
 
@@ -860,8 +937,8 @@ struct SparseMatrixAlgorithms {
       size_type *ind_end = A.ind_end_(row);
       value_type *nz = A.nz_begin_(row);
 
-      typename SM01::Row::const_iterator ind_b = B.ind_begin_(row);
-      typename SM01::Row::const_iterator ind_b_end = B.ind_end_(row);
+      const typename SM01::nz_index_type *ind_b = B.ind_begin_(row);
+      const typename SM01::nz_index_type *ind_b_end = B.ind_end_(row);
 
       std::vector<size_type> indb_;
       std::vector<value_type> nzb_;
@@ -912,10 +989,13 @@ struct SparseMatrixAlgorithms {
    * Note: we follow the non-zeros of B, which can be less than the non-zeros
    * of A.
    * If minFloor > 0, any value that drops below minFloor becomes minFloor.
+   * The rows are split among at most nThreads threads of the shared
+   * ThreadPool (0 for the pool size), which does not change the result.
    */
   template <typename SM>
   static void logSumNoAlloc(SM &A, const SM &B,
-                            typename SM::value_type minFloor = 0) {
+                            typename SM::value_type minFloor = 0,
+                            UInt nThreads = 1) {
     {
       NTA_ASSERT(A.nRows() == B.nRows());
       NTA_ASSERT(A.nCols() == B.nCols());
@@ -931,53 +1011,86 @@ struct SparseMatrixAlgorithms {
     nupic::Log1p<value_type> log1p_f;
     nupic::Abs<value_type> abs_f;
 
-    size_type M = A.nRows();
     value_type minExp = log_f(std::numeric_limits<value_type>::epsilon());
+    const bool fast = fastLogExp_<value_type>();
+
+    B.parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
+
+            size_type *ind_a = A.ind_begin_(row);
+            size_type *ind_b = B.ind_begin_(row);
+            size_type *ind_b_end = B.ind_end_(row);
+            value_type *nz_a = A.nz_begin_(row);
+            value_type *nz_b = B.nz_begin_(row);
+
+            // In fast mode, the first pass only stores the differences in
+            // d, then log1p(exp(d)) is computed for the whole row into t,
+            // and the second pass applies it
+            value_type *d = nullptr, *t = nullptr;
+            if (fast) {
+              const size_type n = (size_type)(ind_b_end - ind_b);
+              d = logScratch_<value_type>(2 * n);
+              t = d + n;
+              for (size_type k = 0; ind_b != ind_b_end;) {
+                if (*ind_a == *ind_b) {
+                  d[k] = -abs_f(*nz_a - *nz_b);
+                  t[k] = d[k];
+                  ++k;
+                  ++ind_b;
+                  ++nz_b;
+                }
+                ++ind_a;
+                ++nz_a;
+              }
+              batchLog1pExp_(t, t + n);
+              ind_a = A.ind_begin_(row);
+              ind_b = B.ind_begin_(row);
+              nz_a = A.nz_begin_(row);
+              nz_b = B.nz_begin_(row);
+            }
 
-    for (size_type row = 0; row != M; ++row) {
-
-      size_type *ind_a = A.ind_begin_(row);
-      size_type *ind_b = B.ind_begin_(row);
-      size_type *ind_b_end = B.ind_end_(row);
-      value_type *nz_a = A.nz_begin_(row);
-      value_type *nz_b = B.nz_begin_(row);
-
-      while (ind_b != ind_b_end) {
-        if (*ind_a == *ind_b) {
-          value_type a = *nz_a;
-          value_type b = *nz_b;
-          if (a < b)
-            std::swap(a, b);
-          value_type d = b - a;
-          if (d >= minExp) {
-            a += log1p_f(exp_f(d));
-            if (minFloor > 0 && abs_f(a) < minFloor)
-              a = minFloor;
-            *nz_a = a;
-          } else {
-            *nz_a = a;
+            for (size_type k = 0; ind_b != ind_b_end;) {
+              if (*ind_a == *ind_b) {
+                value_type a = *nz_a;
+                value_type b = *nz_b;
+                if (a < b)
+                  std::swap(a, b);
+                value_type dk = fast ? d[k] : b - a;
+                if (dk >= minExp) {
+                  a += fast ? t[k] : log1p_f(exp_f(dk));
+                  if (minFloor > 0 && abs_f(a) < minFloor)
+                    a = minFloor;
+                  *nz_a = a;
+                } else {
+                  *nz_a = a;
+                }
+                NTA_ASSERT(!A.isZero_(*nz_a));
+                ++k;
+                ++ind_a;
+                ++nz_a;
+                ++ind_b;
+                ++nz_b;
+              } else if (*ind_a < *ind_b) {
+                ++ind_a;
+                ++nz_a;
+              }
+            }
           }
-          NTA_ASSERT(!A.isZero_(*nz_a));
-          ++ind_a;
-          ++nz_a;
-          ++ind_b;
-          ++nz_b;
-        } else if (*ind_a < *ind_b) {
-          ++ind_a;
-          ++nz_a;
-        }
-      }
-    }
+        },
+        nThreads);
   }
 
   //--------------------------------------------------------------------------------
   /**
    * Adds a constant to the non-zeros of A in log space.
    * Assumes that no new zeros are introduced.
+   * The rows are split among at most nThreads threads, as in logSumNoAlloc.
    */
   template <typename SM>
   static void logAddValNoAlloc(SM &A, typename SM::value_type val,
-                               typename SM::value_type minFloor = 0) {
+                               typename SM::value_type minFloor = 0,
+                               UInt nThreads = 1) {
     { NTA_ASSERT(minFloor == 0 || nupic::Epsilon < minFloor); }
 
     typedef typename SM::size_type size_type;
@@ -988,39 +1101,50 @@ struct SparseMatrixAlgorithms {
     nupic::Log1p<value_type> log1p_f;
     nupic::Abs<value_type> abs_f;
 
-    size_type M = A.nRows();
     value_type minExp = log_f(std::numeric_limits<value_type>::epsilon());
-    value_type b;
-
-    for (size_type row = 0; row != M; ++row) {
-
-      size_type *ind_a = A.ind_begin_(row);
-      size_type *ind_a_end = A.ind_end_(row);
-      value_type *nz_a = A.nz_begin_(row);
-
-      while (ind_a != ind_a_end) {
-        value_type a = *nz_a;
+    const bool fast = fastLogExp_<value_type>();
+
+    A.parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
+
+            const size_type n = A.nnzr_[row];
+            value_type *nz_a = A.nz_begin_(row);
+            value_type *nz_a_end = nz_a + n;
+
+            value_type *t = nullptr;
+            if (fast) {
+              t = logScratch_<value_type>(n);
+              for (size_type k = 0; k != n; ++k)
+                t[k] = -abs_f(nz_a[k] - val);
+              batchLog1pExp_(t, t + n);
+            }
 
-        // Put smaller value in b, larger in a
-        if (a < val) {
-          b = a;
-          a = val;
-        } else {
-          b = val;
-        }
-        value_type d = b - a;
-        if (d >= minExp) {
-          a += log1p_f(exp_f(d));
-          if (minFloor > 0 && abs_f(a) < minFloor)
-            a = minFloor;
-          *nz_a = a;
-        } else
-          *nz_a = a;
-        NTA_ASSERT(!A.isZero_(*nz_a));
-        ++ind_a;
-        ++nz_a;
-      }
-    }
+            for (size_type k = 0; nz_a != nz_a_end; ++k) {
+              value_type a = *nz_a;
+              value_type b;
+
+              // Put smaller value in b, larger in a
+              if (a < val) {
+                b = a;
+                a = val;
+              } else {
+                b = val;
+              }
+              value_type d = b - a;
+              if (d >= minExp) {
+                a += fast ? t[k] : log1p_f(exp_f(d));
+                if (minFloor > 0 && abs_f(a) < minFloor)
+                  a = minFloor;
+                *nz_a = a;
+              } else
+                *nz_a = a;
+              NTA_ASSERT(!A.isZero_(*nz_a));
+              ++nz_a;
+            }
+          }
+        },
+        nThreads);
   }
 
   //--------------------------------------------------------------------------------
@@ -1034,10 +1158,15 @@ struct SparseMatrixAlgorithms {
    * Note: we follow the non-zeros of B, which can be less than the non-zeros
    * of A.
    * If minFloor > 0, any value that drops below minFloor becomes minFloor.
+   * In fast mode, log(1 - exp(b-a)) is computed with the float kernels only
+   * when b - a < -ln(2), where it is well conditioned; closer values still go
+   * through the double code. The rows are split among at most nThreads
+   * threads, as in logSumNoAlloc.
    */
   template <typename SM>
   static void logDiffNoAlloc(SM &A, const SM &B,
-                             typename SM::value_type minFloor = 0) {
+                             typename SM::value_type minFloor = 0,
+                             UInt nThreads = 1) {
     {
       NTA_ASSERT(A.nRows() == B.nRows());
       NTA_ASSERT(A.nCols() == B.nCols());
@@ -1055,7 +1184,6 @@ struct SparseMatrixAlgorithms {
     nupic::Log1p<double> log1p_f;
     nupic::Abs<double> abs_f;
 
-    size_type M = A.nRows();
     value_type minExp = log_f(std::numeric_limits<value_type>::epsilon());
 
     // Two log values that are this close to each other should generate a
@@ -1063,44 +1191,75 @@ struct SparseMatrixAlgorithms {
     //  of 0, which is -inf in log space, which we want to avoid
     double minDiff = -std::numeric_limits<double>::epsilon();
     value_type logOfZero = -1.0 / std::numeric_limits<value_type>::epsilon();
+    const bool fast = fastLogExp_<value_type>();
+    const double maxFastDiff = -0.6931471805599453; // -ln(2)
+
+    B.parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
+
+            size_type *ind_a = A.ind_begin_(row);
+            size_type *ind_b = B.ind_begin_(row);
+            size_type *ind_b_end = B.ind_end_(row);
+            value_type *nz_a = A.nz_begin_(row);
+            value_type *nz_b = B.nz_begin_(row);
+
+            value_type *t = nullptr;
+            if (fast) {
+              const size_type n = (size_type)(ind_b_end - ind_b);
+              t = logScratch_<value_type>(n);
+              for (size_type k = 0; ind_b != ind_b_end;) {
+                if (*ind_a == *ind_b) {
+                  t[k] = std::min<value_type>(*nz_b - *nz_a, maxFastDiff);
+                  ++k;
+                  ++ind_b;
+                  ++nz_b;
+                }
+                ++ind_a;
+                ++nz_a;
+              }
+              batchLog1mExp_(t, t + n);
+              ind_a = A.ind_begin_(row);
+              ind_b = B.ind_begin_(row);
+              nz_a = A.nz_begin_(row);
+              nz_b = B.nz_begin_(row);
+            }
 
-    for (size_type row = 0; row != M; ++row) {
-
-      size_type *ind_a = A.ind_begin_(row);
-      size_type *ind_b = B.ind_begin_(row);
-      size_type *ind_b_end = B.ind_end_(row);
-      value_type *nz_a = A.nz_begin_(row);
-      value_type *nz_b = B.nz_begin_(row);
-
-      while (ind_b != ind_b_end) {
-        if (*ind_a == *ind_b) {
-          double a = *nz_a;
-          double b = *nz_b;
-          NTA_ASSERT(a >= b);
-          double d = b - a;
-          // If the values are too close to each other, generate log of 0
-          // manually We know d <= 0 at this point.
-          if (d >= minDiff)
-            *nz_a = logOfZero;
-          else if (d >= minExp) {
-            a += log1p_f(-exp_f(d));
-            if (minFloor > 0 && abs_f(a) < minFloor)
-              a = minFloor;
-            *nz_a = (value_type)a;
-          } else {
-            *nz_a = (value_type)a;
+            for (size_type k = 0; ind_b != ind_b_end;) {
+              if (*ind_a == *ind_b) {
+                double a = *nz_a;
+                double b = *nz_b;
+                NTA_ASSERT(a >= b);
+                double d = b - a;
+                // If the values are too close to each other, generate log
+                // of 0 manually We know d <= 0 at this point.
+                if (d >= minDiff)
+                  *nz_a = logOfZero;
+                else if (d >= minExp) {
+                  if (fast && d < maxFastDiff)
+                    a += t[k];
+                  else
+                    a += log1p_f(-exp_f(d));
+                  if (minFloor > 0 && abs_f(a) < minFloor)
+                    a = minFloor;
+                  *nz_a = (value_type)a;
+                } else {
+                  *nz_a = (value_type)a;
+                }
+                NTA_ASSERT(!A.isZero_(*nz_a));
+                ++k;
+                ++ind_a;
+                ++nz_a;
+                ++ind_b;
+                ++nz_b;
+              } else if (*ind_a < *ind_b) {
+                ++ind_a;
+                ++nz_a;
+              }
+            }
           }
-          NTA_ASSERT(!A.isZero_(*nz_a));
-          ++ind_a;
-          ++nz_a;
-          ++ind_b;
-          ++nz_b;
-        } else if (*ind_a < *ind_b) {
-          ++ind_a;
-          ++nz_a;
-        }
-      }
-    }
+        },
+        nThreads);
   }
 
   //--------------------------------------------------------------------------------
@@ -1116,9 +1275,13 @@ struct SparseMatrixAlgorithms {
    *  location, insuring that no new zeros are introduced. Any result that
    *  would have computed to 0 (within max_floor) will be replaced with
    * max_floor
+   *
+   * The column sums are computed serially; the second pass is split among
+   * at most nThreads threads of the shared ThreadPool.
    */
   template <typename SM>
-  static void LBP_piPrime(SM &mat, typename SM::value_type max_floor) {
+  static void LBP_piPrime(SM &mat, typename SM::value_type max_floor,
+                          UInt nThreads = 1) {
     { NTA_ASSERT(max_floor < 0); }
 
     typedef typename SM::size_type size_type;
@@ -1146,27 +1309,31 @@ struct SparseMatrixAlgorithms {
     }
 
     // Replace each element with colSum - element
-    for (size_type row = 0; row != M; ++row) {
+    mat.parallelRows_(
+        [&](UInt lo, UInt hi) {
+          for (size_type row = lo; row != hi; ++row) {
 
-      if (mat.nnzr_[row] == 0)
-        continue;
+            if (mat.nnzr_[row] == 0)
+              continue;
 
-      size_type *ind = mat.ind_begin_(row);
-      size_type *ind_end = mat.ind_end_(row);
-      value_type *nz = mat.nz_begin_(row);
+            size_type *ind = mat.ind_begin_(row);
+            size_type *ind_end = mat.ind_end_(row);
+            value_type *nz = mat.nz_begin_(row);
 
-      value_type absFloor = abs_f(max_floor);
+            value_type absFloor = abs_f(max_floor);
 
-      for (; ind != ind_end; ++ind, ++nz) {
+            for (; ind != ind_end; ++ind, ++nz) {
 
-        value_type v = mat.nzb_[*ind] - *nz;
+              value_type v = mat.nzb_[*ind] - *nz;
 
-        if (abs_f(v) < absFloor)
-          v = max_floor;
+              if (abs_f(v) < absFloor)
+                v = max_floor;
 
-        *nz = v;
-      }
-    }
+              *nz = v;
+            }
+          }
+        },
+        nThreads);
   }
 
   //--------------------------------------------------------------------------------
@@ -1638,6 +1805,59 @@ struct SparseMatrixAlgorithms {
   // END LBP
   //--------------------------------------------------------------------------------
 
+private:
+  static bool exactLogExp_;
+
+  // Whether the log-domain methods use the batched kernels for value type T
+  template <typename T> static bool fastLogExp_() {
+    return !exactLogExp_ && std::is_same<T, float>::value;
+  }
+
+  // Per-thread scratch space for the batched kernels, so that the rows
+  // processed by different threads of the pool do not share it
+  template <typename T> static T *logScratch_(size_t n) {
+    static thread_local std::vector<T> scratch;
+    if (scratch.size() < n)
+      scratch.resize(std::max(n, 2 * scratch.size()));
+    return scratch.data();
+  }
+
+  // y = log(x)
+  static void batchLog_(const float *x, const float *x_end, float *y) {
+    fast_log(x, x_end, y);
+  }
+
+  static void batchLog_(const double *x, const double *x_end, double *y) {
+    for (; x != x_end; ++x, ++y)
+      *y = std::log(*x);
+  }
+
+  // x = log(1 + exp(x)), for x <= 0
+  static void batchLog1pExp_(float *x, float *x_end) {
+    fast_exp(x, x_end, x);
+    for (float *p = x; p != x_end; ++p)
+      *p += 1.0f;
+    fast_log(x, x_end, x);
+  }
+
+  static void batchLog1pExp_(double *x, double *x_end) {
+    for (; x != x_end; ++x)
+      *x = std::log1p(std::exp(*x));
+  }
+
+  // x = log(1 - exp(x)), for x <= -ln(2)
+  static void batchLog1mExp_(float *x, float *x_end) {
+    fast_exp(x, x_end, x);
+    for (float *p = x; p != x_end; ++p)
+      *p = 1.0f - *p;
+    fast_log(x, x_end, x);
+  }
+
+  static void batchLog1mExp_(double *x, double *x_end) {
+    for (; x != x_end; ++x)
+      *x = std::log1p(-std::exp(*x));
+  }
+
   //--------------------------------------------------------------------------------
 }; // End class SparseMatrixAlgorithms
 
@@ -31,21 +31,24 @@ using namespace nupic;
 SparseMatrixConnections::SparseMatrixConnections(UInt32 numCells,
                                                  UInt32 numInputs)
     : SegmentMatrixAdapter<SparseMatrix<UInt32, Real32, Int32, Real64>>(
-          numCells, numInputs) {}
+          numCells, numInputs) {
+  matrix.enableColumnIndex();
+}
 
 void SparseMatrixConnections::computeActivity(const UInt32 *activeInputs_begin,
                                               const UInt32 *activeInputs_end,
                                               Int32 *overlaps_begin) const {
-  matrix.rightVecSumAtNZSparse(activeInputs_begin, activeInputs_end,
-                               overlaps_begin);
+  matrix.rightVecSumAtNZSparse_parallel(activeInputs_begin, activeInputs_end,
+                                        overlaps_begin);
 }
 
 void SparseMatrixConnections::computeActivity(const UInt32 *activeInputs_begin,
                                               const UInt32 *activeInputs_end,
                                               Real32 permanenceThreshold,
                                               Int32 *overlaps_begin) const {
-  matrix.rightVecSumAtNZGteThresholdSparse(activeInputs_begin, activeInputs_end,
-                                           overlaps_begin, permanenceThreshold);
+  matrix.rightVecSumAtNZGteThresholdSparse_parallel(
+      activeInputs_begin, activeInputs_end, overlaps_begin,
+      permanenceThreshold);
 }
 
 void SparseMatrixConnections::adjustSynapses(const UInt32 *segments_begin,
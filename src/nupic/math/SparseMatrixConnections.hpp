@@ -57,7 +57,10 @@ public:
   SparseMatrixConnections(UInt32 numCells, UInt32 numInputs);
 
   /**
-   * Compute the number of active synapses on each segment.
+   * Compute the number of active synapses on each segment. Segments are
+   * split among the threads of the shared ThreadPool. The matrix keeps a
+   * column index (see SparseMatrix::enableColumnIndex), so only the synapses
+   * on the active inputs are visited.
    *
    * @param activeInputs
    * The active input bits
@@ -29,6 +29,7 @@
 
 #include <nupic/math/ArrayAlgo.hpp>
 #include <nupic/math/Domain.hpp>
+#include <nupic/math/FlatMap.hpp>
 #include <nupic/math/Math.hpp>
 #include <nupic/math/StlIo.hpp>
 #include <nupic/math/Utils.hpp>
@@ -61,7 +62,8 @@ namespace nupic {
  * where only certain elements are not zero. "Not zero" is defined as
  * being outside the closed ball [-nupic::Epsilon..nupic::Epsilon].
  * Zero elements are not stored. Non-zero elements are stored in
- * a data structure that provides logarithmic insertion and retrieval.
+ * a sorted array of (index, value) pairs (coordinate format), that
+ * provides logarithmic retrieval.
  * A number of operations on tensors are implemented as efficiently as
  * possible, oftentimes having complexity not worse than the number
  * of non-zeros in the tensor. There is no limit to the number of
@@ -75,7 +77,11 @@ namespace nupic {
  * to look at the modulus).
  *
  * The implementation relies on a Unique, Sorted Associative NZ,
- * that is map (rather than hash_map, we need the Indices to be sorted).
+ * that is FlatMap (rather than hash_map, we need the Indices to be sorted).
+ * Inserting a single non-zero in the middle of the storage is linear
+ * in the number of non-zeros, so the operations that produce many
+ * non-zeros at once (products, contractions, marginalizations, fromIdxVal,
+ * ...) collect them first, then sort and merge them in bulk.
  *
  * Examples:
  * 1) SparseTensor<Index<UInt, 2>, float>:
@@ -117,7 +123,7 @@ template <typename Index, typename Float> class SparseTensor {
 public:
   typedef Index TensorIndex;
   typedef typename Index::value_type UInt;
-  typedef std::map<Index, Float> NZ;
+  typedef FlatMap<Index, Float> NZ;
   // typedef __gnu_cxx::hash_map<Index, Float, HashIndex<Index> > NZ;
   // typedef hash_map<Index, Float, HashIndex<Index> > NZ;
   typedef typename NZ::iterator iterator;
@@ -378,11 +384,16 @@ public:
     IndexB compDims = B.getNewIndex(), idxB = B.getNewIndex();
     complement(dims, compDims);
 
+    typename SparseTensor<IndexB, Float>::NZList l;
+    l.reserve(nz_.size());
+
     const_iterator it, e;
     for (it = begin(), e = end(); it != e; ++it) {
       project(compDims, it->first, idxB);
-      B.update(idxB, (Float)1, std::plus<Float>());
+      l.push_back(std::make_pair(idxB, (Float)1));
     }
+
+    B.accumulateUnsorted_(l, std::plus<Float>(), 0);
   }
 
   /**
@@ -397,13 +408,19 @@ public:
     IndexB compDims = B.getNewIndex(), idxB = B.getNewIndex();
     complement(dims, compDims);
 
-    B.setAll((Float)getSizeElts(dims));
+    const Float n = (Float)getSizeElts(dims);
+    B.setAll(n);
+
+    typename SparseTensor<IndexB, Float>::NZList l;
+    l.reserve(nz_.size());
 
     const_iterator it, e;
     for (it = begin(), e = end(); it != e; ++it) {
       project(compDims, it->first, idxB);
-      B.update(idxB, (Float)1, std::minus<Float>());
+      l.push_back(std::make_pair(idxB, (Float)1));
     }
+
+    B.accumulateUnsorted_(l, std::minus<Float>(), n);
   }
 
   /**
@@ -801,16 +818,9 @@ public:
           << " - Should be included in: " << getDomain();
     }
 
-    iterator it = begin(), d, e = end();
-    while (it != e) {
-      if (dom.includes(it->first)) {
-        d = it;
-        ++it; // increment before erase
-        nz_.erase(d);
-      } else {
-        ++it;
-      }
-    }
+    nz_.erase_if([&](const typename NZ::value_type &v) {
+      return dom.includes(v.first);
+    });
   }
 
   /**
@@ -854,10 +864,14 @@ public:
     dom.getLB(lb);
     dom.getUB(ub);
 
+    // increment() enumerates the domain in sorted order
+    NZList l;
     idx = lb;
     do {
-      setNonZero(idx, val);
+      l.push_back(std::make_pair(idx, val));
     } while (increment(lb, ub, idx));
+
+    setSorted_(l);
   }
 
   /**
@@ -918,10 +932,14 @@ public:
       return;
     }
 
+    NZList l;
+    l.reserve(getSizeElts());
     Index idx = getNewZeroIndex();
     do {
-      nz_[idx] = val;
+      l.push_back(std::make_pair(idx, val));
     } while (increment(bounds_, idx));
+
+    nz_.assign_sorted(l);
   }
 
   /**
@@ -1095,17 +1113,18 @@ public:
         ind_v[*i] = j;
     }
 
-    NZ keep;
+    // The renumbering is increasing, so keep stays sorted
+    NZList keep;
 
     iterator i, e;
     for (i = begin(), e = end(); i != e; ++i)
       if (ind.find(i->first[dim]) != ind.end()) {
         Index idx = i->first;
         idx[dim] = ind_v[idx[dim]];
-        keep[idx] = i->second;
+        keep.push_back(std::make_pair(idx, i->second));
       }
 
-    nz_ = keep;
+    nz_.assign_sorted(keep);
 
     Index bounds = getNewIndex();
     bounds[dim] = (UInt)ind.size();
@@ -1202,12 +1221,17 @@ public:
     it = B.begin();
     e = B.end();
 
+    NZList l;
+    l.reserve(B.getNNonZeros());
+
     for (; it != e; ++it) {
       embed(openDims, it->first, idx);
       for (UInt k = 0; k < B.getRank(); ++k)
         idx[k] += range[openDims[k]].getLB();
-      set(idx, it->second);
+      l.push_back(std::make_pair(idx, it->second));
     }
+
+    setUnsorted_(l);
   }
 
   template <typename OutputIterator1, typename OutputIterator2>
@@ -1279,12 +1303,20 @@ public:
     if (clearYesNo)
       clear();
 
+    // Ordinals are enumerated in sorted order. Zeros are needed only
+    // to erase existing non-zeros.
+    NZList l;
     Index idx = getNewIndex();
     const UInt M = product(getBounds());
-    for (UInt i = 0; i < M; ++i) {
+    for (UInt i = 0; i < M; ++i, ++array) {
+      const Float val = (Float)*array;
+      if (nz_.empty() && nearlyZero_(val))
+        continue;
       setFromOrdinal(bounds_, i, idx);
-      set(idx, *array++);
+      l.push_back(std::make_pair(idx, val));
     }
+
+    setSorted_(l);
   }
 
   /**
@@ -1301,14 +1333,28 @@ public:
   /**
    * Copies the values from the input iterator into this sparse tensor.
    * Clear this tensor first, optionally.
+   * The values can come in any order. If an index appears more than
+   * once, the last value wins, as if set() had been called on each.
+   *
+   * Complexity: O(nz * log(nz) + number of non-zeros), the sort being
+   * spread over the shared thread pool for large nz.
    */
   template <typename InIter>
   inline void fromIdxVal(const UInt &nz, InIter iv, bool clearYesNo = true) {
     if (clearYesNo)
       clear();
 
-    for (UInt i = 0; i < nz; ++i, ++iv)
-      set(iv->first, iv->second);
+    NZList l;
+    l.reserve(nz);
+    for (UInt i = 0; i < nz; ++i, ++iv) {
+      NTA_ASSERT(positiveInBounds(iv->first, getBounds()))
+          << "SparseTensor::fromIdxVal(): "
+          << "Invalid index: " << iv->first
+          << " - Should be >= 0 and strictly less than: " << bounds_;
+      l.push_back(std::make_pair(Index(iv->first), Float(iv->second)));
+    }
+
+    setUnsorted_(l);
   }
 
   /**
@@ -1318,11 +1364,7 @@ public:
    */
   template <typename InIter>
   inline void fromIdxVal_nz(const UInt &nz, InIter iv, bool clearYesNo = true) {
-    if (clearYesNo)
-      clear();
-
-    for (UInt i = 0; i < nz; ++i, ++iv)
-      setNonZero(iv->first, iv->second);
+    fromIdxVal(nz, iv, clearYesNo);
   }
 
   /**
@@ -1383,14 +1425,19 @@ public:
     inStream >> nnz;
     NTA_ASSERT(nnz >= 0);
 
+    NZList l;
+    l.reserve(nnz);
+
     for (UInt i = 0; i < nnz; ++i) {
       for (UInt j = 0; j < rank; ++j) {
         inStream >> idx[j];
         NTA_ASSERT(idx[j] >= 0 && idx[j] < bounds_[j]);
       }
       inStream >> val;
-      set(idx, val);
+      l.push_back(std::make_pair(idx, val));
     }
+
+    setUnsorted_(l);
   }
 
   /**
@@ -1437,15 +1484,17 @@ public:
     Index idx = getNewIndex(), newBounds = getNewIndex();
     nupic::permute(ind, bounds_, newBounds);
 
-    NZ newMap;
+    NZList newList;
+    newList.reserve(nz_.size());
 
     const_iterator it, e;
     for (it = begin(), e = end(); it != e; ++it) {
       nupic::permute(ind, it->first, idx);
-      newMap[idx] = it->second;
+      newList.push_back(std::make_pair(idx, it->second));
     }
 
-    nz_ = newMap;
+    NZ::sort(newList);
+    nz_.assign_sorted(newList);
     bounds_ = newBounds;
   }
 
@@ -1461,15 +1510,10 @@ public:
     if (newBounds[i] < bounds_[i])
       shrink = true;
 
-    if (shrink) {
-      const_iterator it, e;
-      for (it = begin(), e = end(); it != e; ++it)
-        if (!positiveInBounds(it->first, newBounds)) {
-          const_iterator d = it;
-          ++it;
-          nz_.erase(d->first);
-        }
-    }
+    if (shrink)
+      nz_.erase_if([&](const typename NZ::value_type &v) {
+        return !positiveInBounds(v.first, newBounds);
+      });
 
     bounds_ = newBounds;
   }
@@ -1654,7 +1698,9 @@ public:
    *
    * Complexity: O(product of bounds)
    *
-   * Note: wish I could find a faster way to compute that union
+   * Note: wish I could find a faster way to compute that union.
+   * The non-zeros of this tensor are at least walked in step with
+   * the dense enumeration, rather than looked up.
    */
   template <typename IndexB>
   inline void nz_union(const IndexB &dims, const SparseTensor<IndexB, Float> &B,
@@ -1670,10 +1716,17 @@ public:
 
     Index idxa = getNewZeroIndex();
     IndexB idxb = B.getNewIndex();
+    const_iterator it = begin(), e = end();
+    std::less<Index> lt;
 
+    // increment() enumerates idxa in sorted order
     do {
       project(dims, idxa, idxb);
-      Float a = get(idxa), b = B.get(idxb);
+      Float a = 0, b = B.get(idxb);
+      if (it != e && !lt(idxa, it->first)) {
+        a = it->second;
+        ++it;
+      }
       if (!nearlyZero_(a) || !nearlyZero_(b))
         u.push_back(Elt<Index, IndexB>(idxa, a, idxb, b));
     } while (increment(bounds_, idxa));
@@ -1721,20 +1774,17 @@ public:
     // Can introduce new zeros! if we know nothing about
     // the functor
 
-    iterator it, d, e;
-    it = begin();
-    e = end();
-    while (it != e) {
+    iterator it, out, e;
+    for (it = out = begin(), e = end(); it != e; ++it) {
       Float val = f(it->second);
-      if (nearlyZero_(val)) { // check zero _after_ applying functor
-        d = it;
-        ++it; // increment before erasing!
-        nz_.erase(d);
-      } else {
-        it->second = val;
-        ++it;
+      if (!nearlyZero_(val)) { // check zero _after_ applying functor
+        if (out != it)
+          out->first = it->first;
+        out->second = val;
+        ++out;
       }
     }
+    nz_.erase(out, e);
   }
 
   /**
@@ -1789,8 +1839,7 @@ public:
           << "Binary functor should do: f(x, 0) == f(0, x) == 0 for all x";
     }
 
-    if (clearYesNo)
-      C.clear();
+    NZList l;
 
     const_iterator it1, end1, it2, end2;
     it1 = begin();
@@ -1800,7 +1849,7 @@ public:
 
     while (it1 != end1 && it2 != end2)
       if (it1->first == it2->first) {
-        C.set(it1->first, f(it1->second, it2->second));
+        l.push_back(std::make_pair(it1->first, f(it1->second, it2->second)));
         ++it1;
         ++it2;
       } else if (it2->first < it1->first) {
@@ -1808,6 +1857,11 @@ public:
       } else {
         ++it1;
       }
+
+    // C can be this tensor or B
+    if (clearYesNo)
+      C.clear();
+    C.setSorted_(l);
   }
 
   /**
@@ -1840,30 +1894,35 @@ public:
                                << "Binary functor should do: f(0, 0) == 0";
     }
 
-    if (clearYesNo)
-      C.clear();
+    NZList l;
+    l.reserve(nz_.size() + B.nz_.size());
 
     const_iterator it1 = begin(), it2 = B.begin(), end1 = end(), end2 = B.end();
 
-    // Any of the set() can introduce new zeros!
+    // Any of the values can be a new zero, setSorted_ drops them
     while (it1 != end1 && it2 != end2)
       if (it1->first == it2->first) {
-        C.set(it1->first, f(it1->second, it2->second));
+        l.push_back(std::make_pair(it1->first, f(it1->second, it2->second)));
         ++it1;
         ++it2;
       } else if (it2->first < it1->first) {
-        C.set(it2->first, f(0, it2->second));
+        l.push_back(std::make_pair(it2->first, f(0, it2->second)));
         ++it2;
       } else {
-        C.set(it1->first, f(it1->second, 0));
+        l.push_back(std::make_pair(it1->first, f(it1->second, 0)));
         ++it1;
       }
 
     for (; it1 != end1; ++it1)
-      C.set(it1->first, f(it1->second, 0));
+      l.push_back(std::make_pair(it1->first, f(it1->second, 0)));
 
     for (; it2 != end2; ++it2)
-      C.set(it2->first, f(0, it2->second));
+      l.push_back(std::make_pair(it2->first, f(0, it2->second)));
+
+    // C can be this tensor or B (see add())
+    if (clearYesNo)
+      C.clear();
+    C.setSorted_(l);
   }
 
   /**
@@ -1977,10 +2036,14 @@ public:
     NonZeros<Index, IndexB> u;
     nz_union(dims, B, u);
 
-    // Calling set because f(a, b) can fall below nupic::Epsilon
+    // setSorted_ because f(a, b) can fall below nupic::Epsilon
+    NZList l;
+    l.reserve(u.size());
     typename NonZeros<Index, IndexB>::const_iterator it, e;
     for (it = u.begin(), e = u.end(); it != e; ++it)
-      set(it->getIndexA(), f(it->getValA(), it->getValB()));
+      l.push_back(
+          std::make_pair(it->getIndexA(), f(it->getValA(), it->getValB())));
+    setSorted_(l);
   }
 
   /**
@@ -2019,16 +2082,20 @@ public:
           << "Binary functor should do: f(0, x) == f(x, 0) == 0 for all x";
     }
 
-    if (clearYesNo)
-      C.clear();
-
     NonZeros<Index, IndexB> inter;
     nz_intersection(dims, B, inter);
 
-    // Calling set because f(a, b) can fall below nupic::Epsilon
+    // setSorted_ because f(a, b) can fall below nupic::Epsilon
+    NZList l;
+    l.reserve(inter.size());
     typename NonZeros<Index, IndexB>::const_iterator it, e;
     for (it = inter.begin(), e = inter.end(); it != e; ++it)
-      C.set(it->getIndexA(), f(it->getValA(), it->getValB()));
+      l.push_back(
+          std::make_pair(it->getIndexA(), f(it->getValA(), it->getValB())));
+
+    if (clearYesNo)
+      C.clear();
+    C.setSorted_(l);
   }
 
   /**
@@ -2074,10 +2141,14 @@ public:
     NonZeros<Index, IndexB> u;
     nz_union(dims, B, u);
 
-    // Calling set because f(a, b) can fall below nupic::Epsilon
+    // setSorted_ because f(a, b) can fall below nupic::Epsilon
+    NZList l;
+    l.reserve(u.size());
     typename NonZeros<Index, IndexB>::const_iterator it, e;
     for (it = u.begin(), e = u.end(); it != e; ++it)
-      C.set(it->getIndexA(), f(it->getValA(), it->getValB()));
+      l.push_back(
+          std::make_pair(it->getIndexA(), f(it->getValA(), it->getValB())));
+    C.setSorted_(l);
   }
 
   /**
@@ -2125,7 +2196,10 @@ public:
    * Works only on the non-zeros, assumes f(0, 0) = 0 ??
    * Use this version AND init = 1 for multiplication.
    *
-   * Complexity: O(number of non-zeros)
+   * The projected non-zeros are sorted and reduced in one pass, rather
+   * than updated in B one at a time.
+   *
+   * Complexity: O(number of non-zeros * log(number of non-zeros))
    *
    * Examples:
    * If s2 is a 2D sparse tensor with dimensions (4, 5),
@@ -2152,11 +2226,16 @@ public:
     IndexB compDims = B.getNewIndex(), idxB = B.getNewIndex();
     complement(dims, compDims);
 
+    typename SparseTensor<IndexB, Float>::NZList l;
+    l.reserve(nz_.size());
+
     const_iterator it, e;
     for (it = begin(), e = end(); it != e; ++it) {
       project(compDims, it->first, idxB);
-      B.update(idxB, it->second, f);
+      l.push_back(std::make_pair(idxB, it->second));
     }
+
+    B.accumulateUnsorted_(l, f, init);
   }
 
   /**
@@ -2245,7 +2324,11 @@ public:
                                << "Binary functor should do: f(0, 0) = 0";
     }
 
-    C.clear();
+    const UInt rA = getRank(), rB = B.getRank();
+    IndexC idxC = C.getNewIndex();
+
+    typename SparseTensor<IndexC, Float>::NZList l;
+    l.reserve(nz_.size() * B.nz_.size());
 
     const_iterator it1, end1;
     typename SparseTensor<IndexB, Float>::const_iterator it2, end2;
@@ -2253,9 +2336,20 @@ public:
     end1 = end();
     end2 = B.end();
 
-    for (it1 = begin(); it1 != end1; ++it1)
-      for (it2 = B.begin(); it2 != end2; ++it2)
-        C.set(concatenate(it1->first, it2->first), f(it1->second, it2->second));
+    // Both loops run in sorted order, so the concatenated indices
+    // come out sorted
+    for (it1 = begin(); it1 != end1; ++it1) {
+      for (UInt k = 0; k < rA; ++k)
+        idxC[k] = it1->first[k];
+      for (it2 = B.begin(); it2 != end2; ++it2) {
+        for (UInt k = 0; k < rB; ++k)
+          idxC[rA + k] = it2->first[k];
+        l.push_back(std::make_pair(idxC, f(it1->second, it2->second)));
+      }
+    }
+
+    C.clear();
+    C.setSorted_(l);
   }
 
   /**
@@ -2297,7 +2391,7 @@ public:
    *
    * Works only on the non-zeros, assumes f(0, 0) = 0 ??
    *
-   * Complexity: O(number of non-zeros)
+   * Complexity: O(number of non-zeros * log(number of non-zeros))
    */
   template <typename IndexB, typename binary_functor>
   inline void contract_nz(const UInt dim1, const UInt dim2,
@@ -2340,21 +2434,19 @@ public:
 
     B.clear();
 
-    // Can't use setAll, because of if
+    // Can't use setAll, because of if: only the elements of B that
+    // receive a diagonal non-zero start at init
+    typename SparseTensor<IndexB, Float>::NZList l;
+
     const_iterator it, e;
     for (it = begin(), e = end(); it != e; ++it) {
       if (it->first[dim1] == it->first[dim2]) {
         project(compDims, it->first, idxB);
-        B.set(idxB, init);
+        l.push_back(std::make_pair(idxB, it->second));
       }
     }
 
-    for (it = begin(), e = end(); it != e; ++it) {
-      if (it->first[dim1] == it->first[dim2]) {
-        project(compDims, it->first, idxB);
-        B.update(idxB, it->second, f);
-      }
-    }
+    B.accumulateUnsorted_(l, f, init);
   }
 
   /**
@@ -2417,9 +2509,13 @@ public:
    *
    * C[k] = accumulate using g(product using f of B[i], C[j])
    *
-   * Works only on the non-zeros.
+   * Works only on the non-zeros. The non-zeros of B are bucketed by
+   * their coordinate along dim2, so that each non-zero of this tensor
+   * is only paired with the non-zeros of B it contracts with (hash join),
+   * and each element of C that receives a product starts at init.
    *
-   * Complexity: O(square of number of non-zeros in one dim)
+   * Complexity: O(number of non-zeros in A and B + number of products
+   *  * log(number of products))
    */
   template <typename IndexB, typename IndexC, typename binary_functor1,
             typename binary_functor2>
@@ -2455,6 +2551,8 @@ public:
              "same size";
     }
 
+    typedef typename SparseTensor<IndexB, Float>::const_iterator B_iterator;
+
     std::vector<UInt> pit1(getRank() - 1, 0), pit2(B.getRank() - 1, 0),
         d1(1, dim1), d2(1, dim2), compDims1(getRank() - 1),
         compDims2(B.getRank() - 1);
@@ -2462,26 +2560,45 @@ public:
     complement(d1, compDims1);
     complement(d2, compDims2);
 
-    C.clear();
+    // Bucket the non-zeros of B by coordinate along dim2, keeping
+    // the order of B inside each bucket
+    const UInt n = bounds_[dim1];
+    std::vector<UInt> first(n + 1, 0);
+    std::vector<B_iterator> byCoord(B.getNNonZeros());
+
+    B_iterator it2, e2;
+    for (it2 = B.begin(), e2 = B.end(); it2 != e2; ++it2)
+      ++first[it2->first[dim2] + 1];
+    for (UInt j = 0; j < n; ++j)
+      first[j + 1] += first[j];
+    {
+      std::vector<UInt> next(first.begin(), first.end() - 1);
+      for (it2 = B.begin(), e2 = B.end(); it2 != e2; ++it2)
+        byCoord[next[it2->first[dim2]]++] = it2;
+    }
 
-    const_iterator it1, e1;
-    typename SparseTensor<IndexB, Float>::const_iterator it2, e2;
+    const UInt r1 = (UInt)pit1.size(), r2 = (UInt)pit2.size();
+    IndexC idxC = C.getNewIndex();
+    typename SparseTensor<IndexC, Float>::NZList l;
 
-    for (it1 = begin(), e1 = end(); it1 != e1; ++it1)
-      for (it2 = B.begin(), e2 = B.end(); it2 != e2; ++it2) {
-        if (it1->first[dim1] == it2->first[dim2]) {
-          C.set(concatenate(pit1, pit2), init);
-        }
+    const_iterator it1, e1;
+    for (it1 = begin(), e1 = end(); it1 != e1; ++it1) {
+      const UInt j = it1->first[dim1];
+      if (first[j] == first[j + 1])
+        continue;
+      project(compDims1, it1->first, pit1);
+      for (UInt k = 0; k < r1; ++k)
+        idxC[k] = pit1[k];
+      for (UInt m = first[j]; m != first[j + 1]; ++m) {
+        project(compDims2, byCoord[m]->first, pit2);
+        for (UInt k = 0; k < r2; ++k)
+          idxC[r1 + k] = pit2[k];
+        l.push_back(std::make_pair(idxC, f(it1->second, byCoord[m]->second)));
       }
+    }
 
-    for (it1 = begin(), e1 = end(); it1 != e1; ++it1)
-      for (it2 = B.begin(), e2 = B.end(); it2 != e2; ++it2) {
-        if (it1->first[dim1] == it2->first[dim2]) {
-          project(compDims1, it1->first, pit1);
-          project(compDims2, it2->first, pit2);
-          C.update(concatenate(pit1, pit2), f(it1->second, it2->second), g);
-        }
-      }
+    C.clear();
+    C.accumulateUnsorted_(l, g, init);
   }
 
   /**
@@ -2858,11 +2975,80 @@ public:
 
   //--------------------------------------------------------------------------------
 private:
+  template <typename I, typename F> friend class SparseTensor;
+
+  typedef typename NZ::container_type NZList;
+
   Index bounds_;
   NZ nz_;
 
   inline bool nearlyZero_(const Float &val) const { return nearlyZero(val); }
 
+  /**
+   * Same as calling set() on each element of l, in order, when the
+   * indices in l are sorted and unique. l is left empty.
+   *
+   * Complexity: O(number of non-zeros + size of l)
+   */
+  inline void setSorted_(NZList &l) {
+    nz_.merge_sorted(l, [](const Float &val) { return nearlyZero(val); });
+  }
+
+  /**
+   * Same as calling set() on each element of l, in order, for arbitrary
+   * indices: when an index shows up several times, the last value wins.
+   * l is left empty.
+   *
+   * Complexity: O(size of l * log(size of l) + number of non-zeros)
+   */
+  inline void setUnsorted_(NZList &l) {
+    NZ::sort(l);
+
+    std::less<Index> lt;
+    size_t n = 0;
+    for (size_t i = 0; i != l.size(); ++i)
+      if (n > 0 && !lt(l[n - 1].first, l[i].first))
+        l[n - 1].second = l[i].second;
+      else if (n++ != i)
+        l[n - 1] = l[i];
+    l.erase(l.begin() + n, l.end());
+
+    setSorted_(l);
+  }
+
+  /**
+   * Same as calling update(idx, val, f) on each (idx, val) of l, in order,
+   * on a tensor where each element is init: the values for the same index
+   * are folded with f, starting from init, then merged into this tensor.
+   * Intermediate results that fall below nupic::Epsilon restart from 0, as
+   * they would in update(). l is left empty.
+   *
+   * Complexity: O(size of l * log(size of l) + number of non-zeros)
+   */
+  template <typename binary_functor>
+  inline void accumulateUnsorted_(NZList &l, binary_functor f,
+                                  const Float &init) {
+    NZ::sort(l);
+
+    const Float start = nearlyZero_(init) ? Float(0) : init;
+    std::less<Index> lt;
+    size_t n = 0;
+    for (size_t i = 0, j = 0; i != l.size(); i = j) {
+      Float acc = start;
+      for (j = i; j != l.size() && !lt(l[i].first, l[j].first); ++j) {
+        acc = f(acc, l[j].second);
+        if (nearlyZero_(acc))
+          acc = 0;
+      }
+      if (n != i)
+        l[n].first = l[i].first;
+      l[n++].second = acc;
+    }
+    l.erase(l.begin() + n, l.end());
+
+    setSorted_(l);
+  }
+
   // I need at least the bounds at construction time
   SparseTensor();
 
@@ -27,9 +27,12 @@
 #ifndef NTA_TOPOLOGY_HPP
 #define NTA_TOPOLOGY_HPP
 
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include <nupic/types/Types.hpp>
+#include <nupic/utils/Log.hpp>
 
 namespace nupic {
 namespace math {
@@ -203,6 +206,92 @@ private:
   const UInt radius_;
 };
 
+// The loops of forEachNeighbor: plain nested loops for 1 and 2 dimensions,
+// the Neighborhood iterators for any number of dimensions (Dims = 0)
+template <UInt Dims, bool Wrap> struct NeighborhoodLoop_;
+
+template <bool Wrap> struct NeighborhoodLoop_<0, Wrap> {
+  template <typename F>
+  static void forEach(UInt centerIndex, UInt radius,
+                      const std::vector<UInt> &dimensions, F &f) {
+    typedef typename std::conditional<Wrap, WrappingNeighborhood,
+                                      Neighborhood>::type Neighbors;
+    for (UInt neighbor : Neighbors(centerIndex, radius, dimensions)) {
+      f(neighbor);
+    }
+  }
+};
+
+// The coordinates of a neighborhood along one dimension: count coordinates
+// from first, wrapping around at the end when Wrap
+template <bool Wrap> struct NeighborhoodSpan_ {
+  UInt first;
+  UInt count;
+
+  NeighborhoodSpan_(UInt center, UInt radius, UInt dimension) {
+    if (Wrap) {
+      // WrappingNeighborhood stops before it visits a point again
+      first = (center + dimension - radius % dimension) % dimension;
+      count = std::min(2 * radius + 1, dimension);
+    } else {
+      first = center > radius ? center - radius : 0;
+      count = std::min(dimension - 1, center + radius) - first + 1;
+    }
+  }
+
+  UInt next(UInt coordinate, UInt dimension) const {
+    ++coordinate;
+    return Wrap && coordinate == dimension ? 0 : coordinate;
+  }
+};
+
+template <bool Wrap> struct NeighborhoodLoop_<1, Wrap> {
+  template <typename F>
+  static void forEach(UInt centerIndex, UInt radius,
+                      const std::vector<UInt> &dimensions, F &f) {
+    const UInt dimension = dimensions[0];
+    const NeighborhoodSpan_<Wrap> span(centerIndex, radius, dimension);
+    UInt x = span.first;
+    for (UInt i = 0; i < span.count; i++, x = span.next(x, dimension)) {
+      f(x);
+    }
+  }
+};
+
+template <bool Wrap> struct NeighborhoodLoop_<2, Wrap> {
+  template <typename F>
+  static void forEach(UInt centerIndex, UInt radius,
+                      const std::vector<UInt> &dimensions, F &f) {
+    const UInt rows = dimensions[0], cols = dimensions[1];
+    const NeighborhoodSpan_<Wrap> rowSpan(centerIndex / cols, radius, rows);
+    const NeighborhoodSpan_<Wrap> colSpan(centerIndex % cols, radius, cols);
+    UInt row = rowSpan.first;
+    for (UInt i = 0; i < rowSpan.count; i++, row = rowSpan.next(row, rows)) {
+      UInt col = colSpan.first;
+      for (UInt j = 0; j < colSpan.count; j++, col = colSpan.next(col, cols)) {
+        f(row * cols + col);
+      }
+    }
+  }
+};
+
+/**
+ * Calls f(neighbor) for each point of Neighborhood(centerIndex, radius,
+ * dimensions), or of WrappingNeighborhood(centerIndex, radius, dimensions)
+ * when Wrap, in the same order.
+ *
+ * With Dims = 1 or 2, dimensions must have Dims dimensions and the
+ * iteration compiles to plain loops, without the coordinate arithmetic of
+ * the iterators at every step. Dims = 0 works with any number of
+ * dimensions.
+ */
+template <UInt Dims, bool Wrap, typename F>
+inline void forEachNeighbor(UInt centerIndex, UInt radius,
+                            const std::vector<UInt> &dimensions, F f) {
+  NTA_ASSERT(Dims == 0 || dimensions.size() == Dims);
+  NeighborhoodLoop_<Dims, Wrap>::forEach(centerIndex, radius, dimensions, f);
+}
+
 } // end namespace topology
 } // namespace math
 } // end namespace nupic
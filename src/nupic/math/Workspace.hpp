@@ -0,0 +1,73 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Scratch memory shared by the image kernels
+ */
+
+#ifndef NTA_WORKSPACE_HPP
+#define NTA_WORKSPACE_HPP
+
+#include <cstddef>
+#include <vector>
+
+//--------------------------------------------------------------------------------
+/**
+ * Growable scratch buffer for the image kernels (SeparableConvolution2D,
+ * Erosion).
+ *
+ * Each kernel instance owns a Workspace by default. A pipeline that runs
+ * many kernels one after the other can instead hand the same Workspace to
+ * all of them, so that they share a single scratch allocation sized for
+ * the largest image. The buffer only grows, and never reallocates once it
+ * is large enough, so steady-state compute() calls do not allocate.
+ *
+ * Kernels sharing a Workspace must not run concurrently.
+ */
+template <typename T> class Workspace {
+public:
+  typedef size_t size_type;
+
+  /**
+   * Returns a buffer of at least n elements. The contents are whatever
+   * the previous user left there. Pointers returned earlier are
+   * invalidated if the buffer needs to grow.
+   */
+  inline T *get(size_type n) {
+    if (buffer_.size() < n)
+      buffer_.resize(n);
+    return buffer_.empty() ? NULL : &buffer_[0];
+  }
+
+  inline size_type capacity() const { return buffer_.size(); }
+
+  /**
+   * Releases the memory.
+   */
+  inline void clear() { std::vector<T>().swap(buffer_); }
+
+private:
+  std::vector<T> buffer_;
+};
+
+//--------------------------------------------------------------------------------
+#endif // NTA_WORKSPACE_HPP
@@ -0,0 +1,475 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+#include <nupic/ntypes/BundleArchive.hpp>
+#include <nupic/os/Path.hpp>
+#include <nupic/utils/Log.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+
+namespace nupic {
+
+namespace {
+
+const char magic_[4] = {'N', 'T', 'Z', '1'};
+const UInt32 version_ = 1;
+const size_t headerSize_ = 12;
+const size_t trailerSize_ = 12;
+
+void putUInt32_(std::string &s, UInt32 v) {
+  for (int i = 0; i != 4; ++i)
+    s.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+void putUInt64_(std::string &s, UInt64 v) {
+  for (int i = 0; i != 8; ++i)
+    s.push_back((char)((v >> (8 * i)) & 0xff));
+}
+
+UInt64 getUInt_(const char *p, int nBytes) {
+  UInt64 v = 0;
+  for (int i = 0; i != nBytes; ++i)
+    v |= (UInt64)(unsigned char)p[i] << (8 * i);
+  return v;
+}
+
+// Reads the fields of the index, checking its bounds
+struct IndexParser_ {
+  const std::string &data;
+  const std::string &path;
+  size_t pos;
+
+  const char *take(size_t n) {
+    if (data.size() - pos < n)
+      NTA_THROW << "Network bundle " << path << " has a truncated index";
+    const char *p = data.data() + pos;
+    pos += n;
+    return p;
+  }
+
+  UInt32 getUInt32() { return (UInt32)getUInt_(take(4), 4); }
+  UInt64 getUInt64() { return getUInt_(take(8), 8); }
+};
+
+// Number of chunks processed at once: two per thread, so that the threads
+// stay busy when chunks compress at different speeds
+size_t batchSize_(UInt nThreads) {
+  UInt n = util::ThreadPool::shared().size();
+  if (nThreads != 0)
+    n = std::min(n, nThreads);
+  return 2 * (size_t)n;
+}
+
+size_t numChunks_(UInt64 size, UInt32 chunkSize) {
+  return (size_t)((size + chunkSize - 1) / chunkSize);
+}
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////
+// BundleArchiveWriter
+/////////////////////////////////////////////////////////////////////////////
+
+// Collects the data of an entry until a batch of chunks is complete
+class BundleArchiveWriter::EntryBuffer : public std::streambuf {
+public:
+  EntryBuffer(BundleArchiveWriter &writer, size_t capacity)
+      : writer_(writer), data_(capacity) {
+    reset();
+  }
+
+  void reset() { setp(data_.data(), data_.data() + data_.size()); }
+
+  // Compresses the data in the buffer. Only the last chunk of an entry may
+  // be partial: the buffer holds a whole number of chunks.
+  void flush() {
+    writer_.writeChunks_(pbase(), (size_t)(pptr() - pbase()));
+    reset();
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    flush();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+private:
+  BundleArchiveWriter &writer_;
+  std::vector<char> data_;
+};
+
+BundleArchiveWriter::BundleArchiveWriter(const std::string &path, int level,
+                                         UInt nThreads, UInt32 chunkSize)
+    : path_(path), tmpPath_(path + ".tmp"), level_(level),
+      nThreads_(nThreads), chunkSize_(chunkSize), offset_(0),
+      inEntry_(false), closed_(false) {
+  NTA_CHECK(chunkSize > 0 && chunkSize <= maxChunkSize)
+      << "BundleArchiveWriter: the chunk size must be in [1, "
+      << maxChunkSize << "]";
+  NTA_CHECK(level >= -1 && level <= 9)
+      << "BundleArchiveWriter: invalid compression level " << level;
+
+  file_.open(tmpPath_.c_str(), std::ios::out | std::ios::binary);
+  if (!file_.is_open())
+    NTA_THROW << "Unable to create network bundle " << tmpPath_;
+
+  std::string header(magic_, sizeof(magic_));
+  putUInt32_(header, version_);
+  putUInt32_(header, chunkSize_);
+  write_(header.data(), header.size());
+
+  buffer_.reset(new EntryBuffer(*this, batchSize_(nThreads_) * chunkSize_));
+}
+
+BundleArchiveWriter::~BundleArchiveWriter() {
+  if (!closed_) {
+    file_.close();
+    std::remove(tmpPath_.c_str());
+  }
+}
+
+std::streambuf &BundleArchiveWriter::beginEntry(const std::string &name) {
+  NTA_CHECK(!closed_) << "Network bundle " << path_ << " is closed";
+  NTA_CHECK(!inEntry_) << "Network bundle " << path_
+                       << ": entry '" << entries_.back().name
+                       << "' has not been ended";
+  for (const auto &entry : entries_) {
+    if (entry.name == name)
+      NTA_THROW << "Network bundle " << path_ << " already has an entry '"
+                << name << "'";
+  }
+
+  BundleArchiveEntry entry;
+  entry.name = name;
+  entry.size = 0;
+  entries_.push_back(entry);
+  inEntry_ = true;
+  buffer_->reset();
+  return *buffer_;
+}
+
+void BundleArchiveWriter::endEntry() {
+  NTA_CHECK(inEntry_) << "Network bundle " << path_ << ": no entry to end";
+  buffer_->flush();
+  inEntry_ = false;
+}
+
+void BundleArchiveWriter::addFile(const std::string &name,
+                                  const std::string &filePath) {
+  IFStream in(filePath.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open())
+    NTA_THROW << "Unable to open " << filePath << " for network bundle "
+              << path_;
+
+  std::streambuf &out = beginEntry(name);
+  std::vector<char> block(chunkSize_);
+  while (in) {
+    in.read(block.data(), block.size());
+    out.sputn(block.data(), in.gcount());
+  }
+  if (in.bad())
+    NTA_THROW << "Error reading " << filePath << " for network bundle "
+              << path_;
+  endEntry();
+}
+
+void BundleArchiveWriter::close() {
+  NTA_CHECK(!closed_) << "Network bundle " << path_ << " is closed";
+  if (inEntry_)
+    endEntry();
+
+  const UInt64 indexOffset = offset_;
+  std::string index;
+  putUInt32_(index, (UInt32)entries_.size());
+  for (const auto &entry : entries_) {
+    putUInt32_(index, (UInt32)entry.name.size());
+    index += entry.name;
+    putUInt64_(index, entry.size);
+    putUInt32_(index, (UInt32)entry.chunks.size());
+    for (const auto &chunk : entry.chunks) {
+      putUInt64_(index, chunk.offset);
+      putUInt32_(index, chunk.compressedSize);
+    }
+  }
+  putUInt64_(index, indexOffset);
+  index.append(magic_, sizeof(magic_));
+  write_(index.data(), index.size());
+
+  file_.close();
+  if (file_.fail())
+    NTA_THROW << "Error writing network bundle " << tmpPath_;
+  if (Path::exists(path_))
+    Path::remove(path_);
+  Path::rename(tmpPath_, path_);
+  closed_ = true;
+}
+
+void BundleArchiveWriter::writeChunks_(const char *data, size_t size) {
+  NTA_ASSERT(inEntry_);
+  const size_t n = numChunks_(size, chunkSize_);
+  std::vector<std::vector<Bytef>> compressed(n);
+
+  util::ThreadPool::shared().parallelFor(
+      0, (UInt)n,
+      [&](UInt begin, UInt end) {
+        for (UInt i = begin; i != end; ++i) {
+          const size_t start = (size_t)i * chunkSize_;
+          const uLong len = (uLong)std::min<size_t>(chunkSize_, size - start);
+          uLongf compressedLen = compressBound(len);
+          compressed[i].resize(compressedLen);
+          const int rc =
+              compress2(compressed[i].data(), &compressedLen,
+                        (const Bytef *)data + start, len, level_);
+          NTA_CHECK(rc == Z_OK) << "Compression failed with zlib error " << rc;
+          compressed[i].resize(compressedLen);
+        }
+      },
+      1, nThreads_);
+
+  BundleArchiveEntry &entry = entries_.back();
+  for (const auto &chunk : compressed) {
+    write_(chunk.data(), chunk.size());
+    entry.chunks.push_back({offset_ - chunk.size(), (UInt32)chunk.size()});
+  }
+  entry.size += size;
+}
+
+void BundleArchiveWriter::write_(const void *data, size_t size) {
+  file_.write((const char *)data, size);
+  if (!file_)
+    NTA_THROW << "Error writing network bundle " << tmpPath_;
+  offset_ += size;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// BundleArchiveReader
+/////////////////////////////////////////////////////////////////////////////
+
+// Inflates a batch of chunks of an entry whenever the previous one has been
+// read
+class BundleArchiveReader::EntryBuffer : public std::streambuf {
+public:
+  EntryBuffer(const BundleArchiveReader &archive, const Entry &entry)
+      : archive_(archive), entry_(entry), next_(0),
+        batch_(batchSize_(archive.nThreads_)) {
+    file_.open(archive.path_.c_str(), std::ios::in | std::ios::binary);
+    if (!file_.is_open())
+      NTA_THROW << "Unable to open network bundle " << archive.path_;
+    const size_t n = std::min(batch_, entry.chunks.size());
+    data_.resize((size_t)std::min<UInt64>((UInt64)n * archive.chunkSize_,
+                                          entry.size));
+    compressed_.resize(n);
+    setg(data_.data(), data_.data(), data_.data());
+  }
+
+protected:
+  int_type underflow() override {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+    if (next_ == entry_.chunks.size())
+      return traits_type::eof();
+
+    const UInt32 chunkSize = archive_.chunkSize_;
+    const size_t n = std::min(batch_, entry_.chunks.size() - next_);
+    for (size_t i = 0; i != n; ++i) {
+      const BundleArchiveChunk &chunk = entry_.chunks[next_ + i];
+      compressed_[i].resize(chunk.compressedSize);
+      file_.seekg((std::streamoff)chunk.offset);
+      file_.read((char *)compressed_[i].data(), chunk.compressedSize);
+      if (!file_)
+        NTA_THROW << "Error reading entry '" << entry_.name
+                  << "' of network bundle " << archive_.path_;
+    }
+
+    const size_t first = next_;
+    const UInt64 size = entry_.size;
+    const std::string &path = archive_.path_;
+    util::ThreadPool::shared().parallelFor(
+        0, (UInt)n,
+        [&](UInt begin, UInt end) {
+          for (UInt i = begin; i != end; ++i) {
+            const UInt64 start = (UInt64)(first + i) * chunkSize;
+            const uLong expected =
+                (uLong)std::min<UInt64>(chunkSize, size - start);
+            uLongf len = expected;
+            const int rc = uncompress(
+                (Bytef *)data_.data() + (size_t)i * chunkSize, &len,
+                compressed_[i].data(), (uLong)compressed_[i].size());
+            if (rc != Z_OK || len != expected)
+              NTA_THROW << "Corrupted chunk " << first + i << " of entry '"
+                        << entry_.name << "' in network bundle " << path;
+          }
+        },
+        1, archive_.nThreads_);
+
+    next_ += n;
+    const UInt64 end = std::min<UInt64>((UInt64)next_ * chunkSize, size);
+    const size_t available = (size_t)(end - (UInt64)first * chunkSize);
+    setg(data_.data(), data_.data(), data_.data() + available);
+    return traits_type::to_int_type(*gptr());
+  }
+
+private:
+  const BundleArchiveReader &archive_;
+  const Entry &entry_;
+  size_t next_;
+  const size_t batch_;
+  IFStream file_;
+  std::vector<char> data_;
+  std::vector<std::vector<Bytef>> compressed_;
+};
+
+BundleArchiveReader::BundleArchiveReader(const std::string &path,
+                                         UInt nThreads)
+    : path_(path), nThreads_(nThreads), chunkSize_(0) {
+  IFStream f(path.c_str(), std::ios::in | std::ios::binary);
+  if (!f.is_open())
+    NTA_THROW << "Unable to open network bundle " << path;
+
+  char header[headerSize_];
+  f.read(header, headerSize_);
+  if (!f || std::memcmp(header, magic_, sizeof(magic_)) != 0)
+    NTA_THROW << path << " is not a compressed network bundle";
+  const UInt32 version = (UInt32)getUInt_(header + 4, 4);
+  if (version != version_)
+    NTA_THROW << "Network bundle " << path << " has version " << version
+              << ", only version " << version_ << " is supported";
+  chunkSize_ = (UInt32)getUInt_(header + 8, 4);
+  if (chunkSize_ == 0 || chunkSize_ > BundleArchiveWriter::maxChunkSize)
+    NTA_THROW << "Network bundle " << path << " has an invalid chunk size "
+              << chunkSize_;
+
+  f.seekg(0, std::ios::end);
+  const UInt64 fileSize = (UInt64)f.tellg();
+  if (fileSize < headerSize_ + trailerSize_)
+    NTA_THROW << "Network bundle " << path << " is truncated";
+
+  char trailer[trailerSize_];
+  f.seekg((std::streamoff)(fileSize - trailerSize_));
+  f.read(trailer, trailerSize_);
+  const UInt64 indexOffset = getUInt_(trailer, 8);
+  if (!f || std::memcmp(trailer + 8, magic_, sizeof(magic_)) != 0 ||
+      indexOffset < headerSize_ || indexOffset > fileSize - trailerSize_)
+    NTA_THROW << "Network bundle " << path << " is truncated";
+
+  std::string data((size_t)(fileSize - trailerSize_ - indexOffset), '\0');
+  f.seekg((std::streamoff)indexOffset);
+  f.read(&data[0], data.size());
+  if (!f)
+    NTA_THROW << "Error reading the index of network bundle " << path;
+
+  IndexParser_ parser = {data, path_, 0};
+  const UInt32 nEntries = parser.getUInt32();
+  for (UInt32 e = 0; e != nEntries; ++e) {
+    Entry entry;
+    const UInt32 nameSize = parser.getUInt32();
+    entry.name.assign(parser.take(nameSize), nameSize);
+    entry.size = parser.getUInt64();
+    const UInt32 nChunks = parser.getUInt32();
+    if (nChunks != numChunks_(entry.size, chunkSize_))
+      NTA_THROW << "Network bundle " << path << ": entry '" << entry.name
+                << "' has " << nChunks << " chunks for " << entry.size
+                << " bytes";
+    for (UInt32 c = 0; c != nChunks; ++c) {
+      BundleArchiveChunk chunk;
+      chunk.offset = parser.getUInt64();
+      chunk.compressedSize = parser.getUInt32();
+      if (chunk.offset < headerSize_ ||
+          chunk.offset + chunk.compressedSize > indexOffset)
+        NTA_THROW << "Network bundle " << path << ": chunk " << c
+                  << " of entry '" << entry.name << "' is out of bounds";
+      entry.chunks.push_back(chunk);
+    }
+    if (!index_.insert(std::make_pair(entry.name, entries_.size())).second)
+      NTA_THROW << "Network bundle " << path << " has two entries '"
+                << entry.name << "'";
+    entries_.push_back(entry);
+  }
+  if (parser.pos != data.size())
+    NTA_THROW << "Network bundle " << path << " has a corrupted index";
+}
+
+bool BundleArchiveReader::isArchive(const std::string &path) {
+  if (!Path::isFile(path))
+    return false;
+  IFStream f(path.c_str(), std::ios::in | std::ios::binary);
+  char header[sizeof(magic_)];
+  f.read(header, sizeof(magic_));
+  return f && std::memcmp(header, magic_, sizeof(magic_)) == 0;
+}
+
+bool BundleArchiveReader::contains(const std::string &name) const {
+  return index_.find(name) != index_.end();
+}
+
+const BundleArchiveReader::Entry &
+BundleArchiveReader::getEntry_(const std::string &name) const {
+  auto it = index_.find(name);
+  if (it == index_.end())
+    NTA_THROW << "No entry '" << name << "' in network bundle " << path_;
+  return entries_[it->second];
+}
+
+std::unique_ptr<std::streambuf>
+BundleArchiveReader::openEntry(const std::string &name) const {
+  return std::unique_ptr<std::streambuf>(
+      new EntryBuffer(*this, getEntry_(name)));
+}
+
+std::string BundleArchiveReader::readEntry(const std::string &name) const {
+  const Entry &entry = getEntry_(name);
+  EntryBuffer in(*this, entry);
+  std::string data((size_t)entry.size, '\0');
+  if (in.sgetn(&data[0], (std::streamsize)data.size()) !=
+      (std::streamsize)data.size())
+    NTA_THROW << "Error reading entry '" << name << "' of network bundle "
+              << path_;
+  return data;
+}
+
+void BundleArchiveReader::extractEntry(const std::string &name,
+                                       const std::string &filePath) const {
+  EntryBuffer in(*this, getEntry_(name));
+  OFStream out(filePath.c_str(), std::ios::out | std::ios::binary);
+  if (!out.is_open())
+    NTA_THROW << "Unable to create " << filePath << " to extract entry '"
+              << name << "' of network bundle " << path_;
+
+  std::vector<char> block(chunkSize_);
+  std::streamsize n;
+  while ((n = in.sgetn(block.data(), (std::streamsize)block.size())) > 0)
+    out.write(block.data(), n);
+  out.close();
+  if (out.fail())
+    NTA_THROW << "Error writing " << filePath;
+}
+
+} // namespace nupic
@@ -0,0 +1,205 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Single-file compressed network bundles (extension `.ntz`).
+ *
+ * An archive holds named entries, one per file of a directory bundle (see
+ * BundleIO). The data of an entry is split into chunks of a fixed
+ * uncompressed size that are deflated independently: writers compress and
+ * readers inflate several chunks at once on the shared ThreadPool, and
+ * neither ever holds more than a batch of chunks in memory. An index at the
+ * end of the file lists the chunks of every entry, so that the state of one
+ * region is read without inflating the others.
+ *
+ * Layout, with little-endian integers:
+ *
+ *   header   "NTZ1", UInt32 version, UInt32 chunk size
+ *   chunks   one zlib stream per chunk
+ *   index    UInt32 number of entries, then for each entry: UInt32 name
+ *            length, name, UInt64 size, UInt32 number of chunks, then for
+ *            each chunk: UInt64 offset, UInt32 compressed size
+ *   trailer  UInt64 offset of the index, "NTZ1"
+ */
+
+#ifndef NTA_BUNDLE_ARCHIVE_HPP
+#define NTA_BUNDLE_ARCHIVE_HPP
+
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <nupic/os/FStream.hpp>
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+// A chunk of an entry, at offset in the archive
+struct BundleArchiveChunk {
+  UInt64 offset;
+  UInt32 compressedSize;
+};
+
+// A file of the bundle. All its chunks but the last have the chunk size of
+// the archive.
+struct BundleArchiveEntry {
+  std::string name;
+  UInt64 size;
+  std::vector<BundleArchiveChunk> chunks;
+};
+
+class BundleArchiveWriter {
+public:
+  static const UInt32 defaultChunkSize = 1 << 20;
+  // Readers reject larger chunk sizes, which would make them allocate a
+  // batch of chunks of that size at once.
+  static const UInt32 maxChunkSize = 64 << 20;
+
+  /**
+   * Creates an archive. The file appears at path when close() succeeds, an
+   * existing file is replaced.
+   *
+   * @param level zlib compression level, -1 for the zlib default.
+   * @param nThreads upper bound on the threads compressing chunks, 0 for
+   *        all the threads of the shared pool.
+   * @param chunkSize size of the chunks, at most maxChunkSize.
+   */
+  BundleArchiveWriter(const std::string &path, int level = -1,
+                      UInt nThreads = 0, UInt32 chunkSize = defaultChunkSize);
+
+  /**
+   * Discards the archive unless it was closed.
+   */
+  ~BundleArchiveWriter();
+
+  /**
+   * Starts a new entry and returns the buffer its data is written to. The
+   * buffer is valid until endEntry().
+   */
+  std::streambuf &beginEntry(const std::string &name);
+
+  /**
+   * Compresses the rest of the current entry.
+   */
+  void endEntry();
+
+  bool inEntry() const { return inEntry_; }
+
+  /**
+   * Adds an entry with the content of a file.
+   */
+  void addFile(const std::string &name, const std::string &filePath);
+
+  /**
+   * Writes the index and moves the archive to its path.
+   */
+  void close();
+
+  const std::string &getPath() const { return path_; }
+
+private:
+  class EntryBuffer;
+
+  // Compresses the chunks of data and appends them to the current entry
+  void writeChunks_(const char *data, size_t size);
+
+  void write_(const void *data, size_t size);
+
+  std::string path_;
+  std::string tmpPath_;
+  int level_;
+  UInt nThreads_;
+  UInt32 chunkSize_;
+  OFStream file_;
+  UInt64 offset_;
+  std::vector<BundleArchiveEntry> entries_;
+  std::unique_ptr<EntryBuffer> buffer_;
+  bool inEntry_;
+  bool closed_;
+
+  BundleArchiveWriter(const BundleArchiveWriter &);
+  BundleArchiveWriter &operator=(const BundleArchiveWriter &);
+};
+
+class BundleArchiveReader {
+public:
+  typedef BundleArchiveEntry Entry;
+
+  /**
+   * Opens an archive and reads its index.
+   *
+   * @param nThreads upper bound on the threads inflating chunks, 0 for all
+   *        the threads of the shared pool.
+   */
+  explicit BundleArchiveReader(const std::string &path, UInt nThreads = 0);
+
+  /**
+   * Whether path is a file that starts like an archive.
+   */
+  static bool isArchive(const std::string &path);
+
+  const std::string &getPath() const { return path_; }
+
+  UInt32 getChunkSize() const { return chunkSize_; }
+
+  /**
+   * The entries, in the order they were written.
+   */
+  const std::vector<Entry> &getEntries() const { return entries_; }
+
+  bool contains(const std::string &name) const;
+
+  /**
+   * A buffer that inflates the entry as it is read. Throws if there is no
+   * such entry. Each buffer has its own handle on the file, so entries can
+   * be read concurrently.
+   */
+  std::unique_ptr<std::streambuf> openEntry(const std::string &name) const;
+
+  /**
+   * The whole content of an entry.
+   */
+  std::string readEntry(const std::string &name) const;
+
+  /**
+   * Inflates an entry to a file.
+   */
+  void extractEntry(const std::string &name,
+                    const std::string &filePath) const;
+
+private:
+  class EntryBuffer;
+
+  const Entry &getEntry_(const std::string &name) const;
+
+  std::string path_;
+  UInt nThreads_;
+  UInt32 chunkSize_;
+  std::vector<Entry> entries_;
+  std::map<std::string, size_t> index_;
+};
+
+} // namespace nupic
+
+#endif // NTA_BUNDLE_ARCHIVE_HPP
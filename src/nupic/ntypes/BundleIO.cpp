@@ -20,7 +20,10 @@
  * ---------------------------------------------------------------------
  */
 
+#include <algorithm>
+#include <nupic/ntypes/BundleArchive.hpp>
 #include <nupic/ntypes/BundleIO.hpp>
+#include <nupic/os/Directory.hpp>
 #include <nupic/os/Path.hpp>
 #include <nupic/utils/Log.hpp>
 #include <utility>
@@ -29,13 +32,32 @@ namespace nupic {
 BundleIO::BundleIO(const std::string &bundlePath, const std::string &label,
                    std::string regionName, bool isInput)
     : isInput_(isInput), bundlePath_(bundlePath),
-      regionName_(std::move(regionName)), ostream_(nullptr), istream_(nullptr) {
+      regionName_(std::move(regionName)), writer_(nullptr), reader_(nullptr),
+      ostream_(nullptr), istream_(nullptr) {
   if (!Path::exists(bundlePath_))
     NTA_THROW << "Network bundle " << bundlePath << " does not exist";
 
   filePrefix_ = Path::join(bundlePath, label + "-");
 }
 
+BundleIO::BundleIO(BundleArchiveWriter &archive, const std::string &label,
+                   std::string regionName, std::string scratchDir)
+    : isInput_(false), bundlePath_(archive.getPath()),
+      regionName_(std::move(regionName)), writer_(&archive), reader_(nullptr),
+      entryPrefix_(label + "-"), scratchDir_(std::move(scratchDir)),
+      ostream_(nullptr), istream_(nullptr) {
+  filePrefix_ = Path::join(scratchDir_, entryPrefix_);
+}
+
+BundleIO::BundleIO(const BundleArchiveReader &archive, const std::string &label,
+                   std::string regionName, std::string scratchDir)
+    : isInput_(true), bundlePath_(archive.getPath()),
+      regionName_(std::move(regionName)), writer_(nullptr), reader_(&archive),
+      entryPrefix_(label + "-"), scratchDir_(std::move(scratchDir)),
+      ostream_(nullptr), istream_(nullptr) {
+  filePrefix_ = Path::join(scratchDir_, entryPrefix_);
+}
+
 BundleIO::~BundleIO() {
   if (istream_) {
     if (istream_->is_open())
@@ -56,6 +78,20 @@ std::ofstream &BundleIO::getOutputStream(const std::string &name) const {
 
   checkStreams_();
 
+  if (writer_) {
+    // The stream writes to the archive instead of a file
+    if (writer_->inEntry())
+      writer_->endEntry();
+    delete ostream_;
+    ostream_ = new OFStream();
+    static_cast<std::ios &>(*ostream_).rdbuf(
+        &writer_->beginEntry(entryPrefix_ + name));
+    // Errors of the archive, such as a failed write, are exceptions rather
+    // than a silently failed stream
+    ostream_->exceptions(std::ios::badbit);
+    return *ostream_;
+  }
+
   ostream_ =
       new OFStream(getPath(name).c_str(), std::ios::out | std::ios::binary);
   if (!ostream_->is_open()) {
@@ -72,6 +108,18 @@ std::ifstream &BundleIO::getInputStream(const std::string &name) const {
 
   checkStreams_();
 
+  if (reader_) {
+    // The stream inflates the entry as it is read. Errors of the archive
+    // are exceptions rather than a silently truncated stream.
+    delete istream_;
+    istream_ = nullptr;
+    entryBuffer_ = reader_->openEntry(entryPrefix_ + name);
+    istream_ = new IFStream();
+    static_cast<std::ios &>(*istream_).rdbuf(entryBuffer_.get());
+    istream_->exceptions(std::ios::badbit);
+    return *istream_;
+  }
+
   istream_ =
       new IFStream(getPath(name).c_str(), std::ios::in | std::ios::binary);
   if (!istream_->is_open()) {
@@ -84,7 +132,36 @@ std::ifstream &BundleIO::getInputStream(const std::string &name) const {
 }
 
 std::string BundleIO::getPath(const std::string &name) const {
-  return filePrefix_ + name;
+  const std::string path = filePrefix_ + name;
+  if (writer_ == nullptr && reader_ == nullptr)
+    return path;
+
+  if (!Path::exists(scratchDir_))
+    Directory::create(scratchDir_, false, true);
+  if (writer_) {
+    if (std::find(scratchNames_.begin(), scratchNames_.end(), name) ==
+        scratchNames_.end())
+      scratchNames_.push_back(name);
+  } else if (reader_->contains(entryPrefix_ + name) && !Path::exists(path)) {
+    reader_->extractEntry(entryPrefix_ + name, path);
+  }
+  return path;
+}
+
+void BundleIO::close() {
+  if (writer_ == nullptr)
+    return;
+
+  if (writer_->inEntry())
+    writer_->endEntry();
+  for (const auto &name : scratchNames_) {
+    const std::string path = filePrefix_ + name;
+    if (Path::exists(path)) {
+      writer_->addFile(entryPrefix_ + name, path);
+      Path::remove(path);
+    }
+  }
+  scratchNames_.clear();
 }
 
 // Before a request for a new stream,
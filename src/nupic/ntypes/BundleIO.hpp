@@ -23,17 +23,36 @@
 #ifndef NTA_BUNDLEIO_HPP
 #define NTA_BUNDLEIO_HPP
 
+#include <memory>
+#include <streambuf>
+#include <vector>
+
 #include <nupic/os/FStream.hpp>
 #include <nupic/os/Path.hpp>
 
 namespace nupic {
+class BundleArchiveReader;
+class BundleArchiveWriter;
+
 class BundleIO {
 public:
   BundleIO(const std::string &bundlePath, const std::string &label,
            std::string regionName, bool isInput);
 
+  // Region in a compressed bundle (see BundleArchive.hpp). The streams
+  // read and write entries of the archive directly. Files accessed through
+  // getPath() go through scratchDir, which is created when needed.
+  BundleIO(BundleArchiveWriter &archive, const std::string &label,
+           std::string regionName, std::string scratchDir);
+  BundleIO(const BundleArchiveReader &archive, const std::string &label,
+           std::string regionName, std::string scratchDir);
+
   ~BundleIO();
 
+  // Stores the last stream and the files written through getPath() in the
+  // archive. Nothing to do for directory bundles.
+  void close();
+
   // These are {o,i}fstream instead of {o,i}stream so that
   // the node can explicitly close() them.
   std::ofstream &getOutputStream(const std::string &name) const;
@@ -61,6 +80,18 @@ private:
   // Store the region name for debugging
   std::string regionName_;
 
+  // The archive of a compressed bundle, null for directory bundles
+  BundleArchiveWriter *writer_;
+  const BundleArchiveReader *reader_;
+  std::string entryPrefix_;
+  std::string scratchDir_;
+
+  // Names passed to getPath() when writing an archive
+  mutable std::vector<std::string> scratchNames_;
+
+  // The entry istream_ reads
+  mutable std::unique_ptr<std::streambuf> entryBuffer_;
+
   // We own the streams -- helps with finding errors
   // and with enforcing one-stream-at-a-time
   // These are mutable because the bundle doesn't conceptually
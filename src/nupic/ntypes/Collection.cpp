@@ -61,33 +61,31 @@ std::pair<std::string, T> &Collection<T>::getByIndex(size_t index) {
 
 template <typename T>
 bool Collection<T>::contains(const std::string &name) const {
-  typename CollectionStorage::const_iterator i;
-  for (i = vec_.begin(); i != vec_.end(); i++) {
-    if (i->first == name)
-      return true;
-  }
-  return false;
+  return index_.find(name) != index_.end();
 }
 
 template <typename T>
 T Collection<T>::getByName(const std::string &name) const {
-  typename CollectionStorage::const_iterator i;
-  for (i = vec_.begin(); i != vec_.end(); i++) {
-    if (i->first == name)
-      return i->second;
-  }
-  NTA_THROW << "No item named: " << name;
+  auto i = index_.find(name);
+  if (i == index_.end())
+    NTA_THROW << "No item named: " << name;
+  return vec_[i->second].second;
+}
+
+template <typename T>
+size_t Collection<T>::getIndex(const std::string &name) const {
+  auto i = index_.find(name);
+  if (i == index_.end())
+    NTA_THROW << "No item named: " << name;
+  return i->second;
 }
 
 template <typename T>
 void Collection<T>::add(const std::string &name, const T &item) {
   // make sure we don't already have something with this name
-  typename CollectionStorage::const_iterator i;
-  for (i = vec_.begin(); i != vec_.end(); i++) {
-    if (i->first == name) {
-      NTA_THROW << "Unable to add item '" << name << "' to collection "
-                << "because it already exists";
-    }
+  if (!index_.insert(std::make_pair(name, vec_.size())).second) {
+    NTA_THROW << "Unable to add item '" << name << "' to collection "
+              << "because it already exists";
   }
 
   // Add the new item to the vector
@@ -95,15 +93,17 @@ void Collection<T>::add(const std::string &name, const T &item) {
 }
 
 template <typename T> void Collection<T>::remove(const std::string &name) {
-  typename CollectionStorage::iterator i;
-  for (i = vec_.begin(); i != vec_.end(); i++) {
-    if (i->first == name)
-      break;
-  }
-  if (i == vec_.end())
+  auto i = index_.find(name);
+  if (i == index_.end())
     NTA_THROW << "No item named '" << name << "' in collection";
 
-  vec_.erase(i);
+  size_t position = i->second;
+  index_.erase(i);
+  vec_.erase(vec_.begin() + position);
+
+  // Items after the removed one moved down by one
+  for (size_t k = position; k < vec_.size(); ++k)
+    index_[vec_[k].first] = k;
 }
 
 } // namespace nupic
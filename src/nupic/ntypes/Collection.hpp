@@ -24,12 +24,14 @@
 #define NTA_COLLECTION_HPP
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace nupic {
 // A collection is a templated class that contains items of type t.
-// It supports lookup by name and by index. The items are stored in a map
-// and copies are also stored in a vector (it's Ok to use pointers).
+// It supports lookup by name and by index. The items are stored in a vector
+// in insertion order, and a hash table maps each name to its position in the
+// vector, so lookups by name take constant time.
 // You can add items using the add() method.
 //
 template <typename T> class Collection {
@@ -49,6 +51,10 @@ public:
 
   T getByName(const std::string &name) const;
 
+  // Position of the named item, for repeated access with getByIndex().
+  // Throws if there is no such item.
+  size_t getIndex(const std::string &name) const;
+
   // TODO: move add/remove to a ModifiableCollection subclass
   // This method should be internal but is currently tested
   // in net_test.py in test_node_spec
@@ -57,12 +63,14 @@ public:
   void remove(const std::string &name);
 
 #ifdef NTA_INTERNAL
+  // The name (first) must not be modified through the returned reference.
   std::pair<std::string, T> &getByIndex(size_t index);
 #endif
 
 private:
   typedef std::vector<std::pair<std::string, T>> CollectionStorage;
   CollectionStorage vec_;
+  std::unordered_map<std::string, size_t> index_;
 };
 } // namespace nupic
 
@@ -86,6 +86,10 @@
 //   Types for working with the Python object system. Module is for importing
 //   modules. Class is for invoking class methods and Instance is for
 //   instantiating objects and invoking their methods.
+//
+// ReleaseGIL:
+//   Releases the Python global interpreter lock for the lifetime of the
+//   object, so that other Python threads can run during a long C++ call.
 // ===
 
 // Nested namespace nupic::py
@@ -147,6 +151,36 @@ protected:
   bool allowNULL_;
 };
 
+// A RAII class that releases the GIL in its constructor and re-acquires
+// it in its destructor. Unlike a bare Py_BEGIN_ALLOW_THREADS /
+// Py_END_ALLOW_THREADS pair, the GIL is re-acquired when a C++ exception
+// leaves the scope, before the exception is translated into a Python
+// error.
+//
+// No Python C API call and no access to Python objects may be made while
+// the GIL is released. Raw numpy buffers may be used, as long as the
+// caller keeps a reference to the arrays. When release is false the GIL
+// is kept, for calls that may end up running Python code.
+//
+// The GIL no longer serializes the calls on the wrapped object either: the
+// class docstring of a binding that releases it must say that the object
+// is not thread-safe.
+class ReleaseGIL {
+public:
+  explicit ReleaseGIL(bool release = true)
+      : state_(release ? PyEval_SaveThread() : NULL) {}
+  ~ReleaseGIL() {
+    if (state_)
+      PyEval_RestoreThread(state_);
+  }
+
+private:
+  ReleaseGIL(const ReleaseGIL &);
+  ReleaseGIL &operator=(const ReleaseGIL &);
+
+  PyThreadState *state_;
+};
+
 // String
 class String : public Ptr {
 public:
@@ -0,0 +1,151 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the Python handles to region parameters, inputs and
+ * outputs
+ */
+
+// The Python.h #include MUST always be #included first in every
+// compilation unit (.c or .cpp file).
+#include <Python.h>
+
+#include <limits>
+
+#include <nupic/engine/Input.hpp>
+#include <nupic/engine/Output.hpp>
+#include <nupic/py_support/PyArray.hpp>
+#include <nupic/py_support/PyRegionRefs.hpp>
+#include <nupic/types/BasicType.hpp>
+
+namespace nupic {
+
+PyParameterRef::PyParameterRef(const Region::ParameterRef &ref) : ref_(ref) {}
+
+std::string PyParameterRef::getName() const { return ref_.getName(); }
+
+NTA_BasicType PyParameterRef::getType() const { return ref_.getType(); }
+
+bool PyParameterRef::isWritable() const { return ref_.isWritable(); }
+
+bool PyParameterRef::isDirect() const { return ref_.isDirect(); }
+
+PyObject *PyParameterRef::get() const {
+  switch (ref_.getType()) {
+  case NTA_BasicType_Int32:
+    return PyInt_FromLong(ref_.get<Int32>());
+  case NTA_BasicType_UInt32:
+    return PyLong_FromUnsignedLong(ref_.get<UInt32>());
+  case NTA_BasicType_Int64:
+    return PyLong_FromLongLong(ref_.get<Int64>());
+  case NTA_BasicType_UInt64:
+    return PyLong_FromUnsignedLongLong(ref_.get<UInt64>());
+  case NTA_BasicType_Real32:
+    return PyFloat_FromDouble(ref_.get<Real32>());
+  case NTA_BasicType_Real64:
+    return PyFloat_FromDouble(ref_.get<Real64>());
+  case NTA_BasicType_Bool:
+    return PyBool_FromLong(ref_.get<bool>());
+  default:
+    NTA_THROW << "PyParameterRef::get: parameter " << ref_.getName()
+              << " has unsupported type " << BasicType::getName(getType());
+  }
+}
+
+// The value of an integer object, checked against the range of T
+template <typename T>
+static T integer_(PyObject *value, const std::string &name) {
+  py::Ptr n(PyNumber_Long(value), /* allowNULL */ true);
+  py::checkPyError(__LINE__);
+  T result;
+  bool inRange;
+  if (std::numeric_limits<T>::is_signed) {
+    const long long v = PyLong_AsLongLong(n);
+    py::checkPyError(__LINE__);
+    inRange = v >= (long long)std::numeric_limits<T>::min() &&
+              v <= (long long)std::numeric_limits<T>::max();
+    result = (T)v;
+  } else {
+    const unsigned long long v = PyLong_AsUnsignedLongLong(n);
+    py::checkPyError(__LINE__);
+    inRange = v <= (unsigned long long)std::numeric_limits<T>::max();
+    result = (T)v;
+  }
+  NTA_CHECK(inRange) << "PyParameterRef::set: value out of the range of "
+                     << name;
+  return result;
+}
+
+void PyParameterRef::set(PyObject *value) {
+  const std::string &name = ref_.getName();
+  switch (ref_.getType()) {
+  case NTA_BasicType_Int32:
+    ref_.set<Int32>(integer_<Int32>(value, name));
+    break;
+  case NTA_BasicType_UInt32:
+    ref_.set<UInt32>(integer_<UInt32>(value, name));
+    break;
+  case NTA_BasicType_Int64:
+    ref_.set<Int64>(integer_<Int64>(value, name));
+    break;
+  case NTA_BasicType_UInt64:
+    ref_.set<UInt64>(integer_<UInt64>(value, name));
+    break;
+  case NTA_BasicType_Real32:
+  case NTA_BasicType_Real64: {
+    const double v = PyFloat_AsDouble(value);
+    py::checkPyError(__LINE__);
+    if (ref_.getType() == NTA_BasicType_Real32)
+      ref_.set<Real32>((Real32)v);
+    else
+      ref_.set<Real64>(v);
+    break;
+  }
+  case NTA_BasicType_Bool: {
+    const int v = PyObject_IsTrue(value);
+    py::checkPyError(__LINE__);
+    ref_.set<bool>(v != 0);
+    break;
+  }
+  default:
+    NTA_THROW << "PyParameterRef::set: parameter " << name
+              << " has unsupported type " << BasicType::getName(getType());
+  }
+}
+
+PyInputRef::PyInputRef(Input *input) : input_(input) {}
+
+std::string PyInputRef::getName() const { return input_->getName(); }
+
+PyObject *PyInputRef::getArray() const {
+  return array2numpy(input_->getData());
+}
+
+PyOutputRef::PyOutputRef(Output *output) : output_(output) {}
+
+std::string PyOutputRef::getName() const { return output_->getName(); }
+
+PyObject *PyOutputRef::getArray() const {
+  return array2numpy(output_->getData());
+}
+
+} // namespace nupic
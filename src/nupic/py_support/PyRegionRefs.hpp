@@ -0,0 +1,129 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Python handles to the parameters, inputs and outputs of a region,
+ * returned by Region.getParameterRef, Region.getInputRef and
+ * Region.getOutputRef in the Python bindings.
+ *
+ * A handle resolves its name once, so that reading and writing it on every
+ * step skips the lookups of the name-based methods. Handles are valid for
+ * the lifetime of their region.
+ */
+
+#ifndef NTA_PY_REGION_REFS_HPP
+#define NTA_PY_REGION_REFS_HPP
+
+#include <nupic/py_support/PyHelpers.hpp>
+
+#include <string>
+
+#include <nupic/engine/Region.hpp>
+#include <nupic/types/Types.h>
+
+namespace nupic {
+
+class Input;
+class Output;
+
+/**
+ * Scalar parameter of a region, see Region::ParameterRef. Values are
+ * converted from and to Python numbers and booleans.
+ */
+class PyParameterRef {
+public:
+#ifndef SWIG
+  explicit PyParameterRef(const Region::ParameterRef &ref);
+#endif
+
+  std::string getName() const;
+
+  NTA_BasicType getType() const;
+
+  bool isWritable() const;
+
+  bool isDirect() const;
+
+  /**
+   * The value, as a new reference.
+   */
+  PyObject *get() const;
+
+  /**
+   * Sets the value. Throws if value doesn't convert to the type of the
+   * parameter, or the parameter is read-only.
+   */
+  void set(PyObject *value);
+
+#ifndef SWIG
+private:
+  Region::ParameterRef ref_;
+#endif
+};
+
+/**
+ * Input of a region.
+ */
+class PyInputRef {
+public:
+#ifndef SWIG
+  explicit PyInputRef(Input *input);
+#endif
+
+  std::string getName() const;
+
+  /**
+   * A numpy array over the current data of the input, as a new reference.
+   */
+  PyObject *getArray() const;
+
+#ifndef SWIG
+private:
+  Input *input_;
+#endif
+};
+
+/**
+ * Output of a region.
+ */
+class PyOutputRef {
+public:
+#ifndef SWIG
+  explicit PyOutputRef(Output *output);
+#endif
+
+  std::string getName() const;
+
+  /**
+   * A numpy array over the current data of the output, as a new reference.
+   */
+  PyObject *getArray() const;
+
+#ifndef SWIG
+private:
+  Output *output_;
+#endif
+};
+
+} // namespace nupic
+
+#endif // NTA_PY_REGION_REFS_HPP
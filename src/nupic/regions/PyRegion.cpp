@@ -276,7 +276,8 @@ static void prepareCreationParams(const ValueMap &vm, py::Dict &d) {
 
 PyRegion::PyRegion(const char *module, const ValueMap &nodeParams,
                    Region *region, const char *className)
-    : RegionImpl(region), module_(module), className_(className) {
+    : RegionImpl(region), module_(module), className_(className),
+      bound_(false) {
 
   NTA_CHECK(region != NULL);
 
@@ -297,7 +298,8 @@ PyRegion::PyRegion(const char *module, const ValueMap &nodeParams,
 
 PyRegion::PyRegion(const char *module, BundleIO &bundle, Region *region,
                    const char *className)
-    : RegionImpl(region), module_(module), className_(className)
+    : RegionImpl(region), module_(module), className_(className),
+      bound_(false)
 
 {
   deserialize(bundle);
@@ -306,7 +308,8 @@ PyRegion::PyRegion(const char *module, BundleIO &bundle, Region *region,
 
 PyRegion::PyRegion(const char *module, capnp::AnyPointer::Reader &proto,
                    Region *region, const char *className)
-    : RegionImpl(region), module_(module), className_(className) {
+    : RegionImpl(region), module_(module), className_(className),
+      bound_(false) {
   NTA_CHECK(region != NULL);
 
   read(proto);
@@ -860,20 +863,50 @@ std::string PyRegion::executeCommand(const std::vector<std::string> &args,
   return ss;
 }
 
-void PyRegion::compute() {
+void PyRegion::bindInputsAndOutputs_() {
   const Spec &ns = getSpec();
-  // Prepare the inputs dict
-  py::Dict inputs;
+
+  inputBindings_.clear();
   for (size_t i = 0; i < ns.inputs.getCount(); ++i) {
-    // Get the current InputSpec object
     const std::pair<std::string, InputSpec> &p = ns.inputs.getByIndex(i);
 
-    // Get the corresponding input buffer
-    Input *inp = region_->getInput(p.first);
-    NTA_CHECK(inp);
+    InputBinding b;
+    b.name = p.first;
+    b.input = region_->getInput(p.first);
+    NTA_CHECK(b.input);
+    b.requireSplitterMap = p.second.requireSplitterMap;
+    b.itemSize = BasicType::getSize(p.second.dataType);
+    inputBindings_.push_back(b);
+  }
+
+  outputBindings_.clear();
+  for (size_t i = 0; i < ns.outputs.getCount(); ++i) {
+    const std::pair<std::string, OutputSpec> &p = ns.outputs.getByIndex(i);
+
+    Output *out = region_->getOutput(p.first);
+    // Skip optional outputs
+    if (!out)
+      continue;
+
+    OutputBinding b;
+    b.name = p.first;
+    b.lenName = "__" + p.first + "_len__";
+    b.output = out;
+    outputBindings_.push_back(b);
+  }
+
+  bound_ = true;
+}
+
+void PyRegion::compute() {
+  if (!bound_)
+    bindInputsAndOutputs_();
 
+  // Prepare the inputs dict
+  py::Dict inputs;
+  for (const InputBinding &b : inputBindings_) {
     // Set pa to point to the original input array
-    const Array *pa = &(inp->getData());
+    const Array *pa = &(b.input->getData());
 
     // Skip unlinked inputs of size 0
     if (pa->getCount() == 0)
@@ -883,10 +916,11 @@ void PyRegion::compute() {
     // Copy the original input array to the stored input array, which is larger
     // by one element and put 0 in the extra element. This is needed for
     // splitter map access.
-    if (p.second.requireSplitterMap) {
+    if (b.requireSplitterMap) {
       // Verify that this input has a stored input array
-      NTA_ASSERT(inputArrays_.find(p.first) != inputArrays_.end());
-      Array &a = *(inputArrays_[p.first]);
+      auto stored = inputArrays_.find(b.name);
+      NTA_ASSERT(stored != inputArrays_.end() && stored->second != nullptr);
+      Array &a = *stored->second;
 
       // Verify that the stored input array is larger by 1  then the original
       // input
@@ -895,17 +929,16 @@ void PyRegion::compute() {
       // Work at the char * level because there is no good way
       // to work with the actual data type of the input (since the buffer is
       // void *)
-      size_t itemSize = BasicType::getSize(p.second.dataType);
       char *begin1 = (char *)pa->getBuffer();
-      char *end1 = begin1 + pa->getCount() * itemSize;
+      char *end1 = begin1 + pa->getCount() * b.itemSize;
       char *begin2 = (char *)a.getBuffer();
-      char *end2 = begin2 + a.getCount() * itemSize;
+      char *end2 = begin2 + a.getCount() * b.itemSize;
 
       // Copy the original input array to the stored array
       std::copy(begin1, end1, begin2);
 
       // Put 0 in the last item (the sentinel value)
-      std::fill(end2 - itemSize, end2, 0);
+      std::fill(end2 - b.itemSize, end2, 0);
 
       // Change pa to point to the stored input array (with the sentinel)
       pa = &a;
@@ -915,40 +948,29 @@ void PyRegion::compute() {
     // the original input array or a stored input array
     // (if a splitter map is needed)
     py::Ptr numpyArray(array2numpy(*pa));
-    inputs.setItem(p.first, numpyArray);
+    inputs.setItem(b.name, numpyArray);
   }
 
   // Prepare the outputs dict
   py::Dict outputs;
-  for (size_t i = 0; i < ns.outputs.getCount(); ++i) {
-    // Get the current OutputSpec object
-    const std::pair<std::string, OutputSpec> &p = ns.outputs.getByIndex(i);
-
-    // Get the corresponding output buffer
-    Output *out = region_->getOutput(p.first);
-    // Skip optional outputs
-    if (!out)
-      continue;
-
-    const Array &data = out->getData();
+  for (const OutputBinding &b : outputBindings_) {
+    const Array &data = b.output->getData();
 
     py::Ptr numpyArray(array2numpy(data));
 
     // Insert the buffer to the outputs py::Dict
-    outputs.setItem(p.first, numpyArray);
+    outputs.setItem(b.name, numpyArray);
 
     // Add sparse output len placeholder field
-    if (out->isSparse()) {
+    if (b.output->isSparse()) {
       // The region output memory is owned by the c++ and cannot be changed from
       // python. We use a special attribule named "__{name}_len__" to pass
       // the sparse array length back to c++
-      std::stringstream name;
-      name << "__" << p.first << "_len__";
 
       // The outputs dict is immutable. Use a list to enable update from python
       py::List len;
       len.append(py::Int(data.getCount()));
-      outputs.setItem(name.str(), len);
+      outputs.setItem(b.lenName, len);
     }
   }
 
@@ -961,21 +983,12 @@ void PyRegion::compute() {
   py::Ptr none(node_.invoke("guardedCompute", args));
 
   // Resize sparse outputs
-  for (size_t i = 0; i < ns.outputs.getCount(); ++i) {
-    const std::pair<std::string, OutputSpec> &p = ns.outputs.getByIndex(i);
-    // Get the corresponding output buffer
-    Output *out = region_->getOutput(p.first);
-    // Skip optional outputs
-    if (!out)
-      continue;
-
-    if (out->isSparse()) {
-      std::stringstream name;
-      name << "__" << p.first << "_len__";
-      py::List len(outputs.getItem(name.str()));
+  for (const OutputBinding &b : outputBindings_) {
+    if (b.output->isSparse()) {
+      py::List len(outputs.getItem(b.lenName));
 
       // Remove 'const' to update the variable length array
-      Array &data = const_cast<Array &>(out->getData());
+      Array &data = const_cast<Array &>(b.output->getData());
       data.setCount(py::Int(len.getItem(0)));
     }
   }
@@ -1262,6 +1275,9 @@ void PyRegion::createSpec(const char *nodeType, Spec &ns,
 }
 
 void PyRegion::initialize() {
+  // Resolve the inputs and outputs again on the next compute()
+  bound_ = false;
+
   // Call the Python initialize() method
   // Need to put the None result in py::Ptr, so decrement the ref count
   py::Ptr none(node_.invoke("initialize", py::Tuple()));
@@ -181,6 +181,30 @@ private:
   // pointers rather than objects because Array doesnt
   // have a default constructor
   std::map<std::string, Array *> inputArrays_;
+
+  // Inputs and outputs of the region in spec order, resolved on the first
+  // compute() after initialize() so that each step avoids name lookups and
+  // string formatting. The stored input arrays are looked up on each use,
+  // since they may be replaced.
+  struct InputBinding {
+    std::string name;
+    Input *input;
+    bool requireSplitterMap;
+    size_t itemSize;
+  };
+
+  struct OutputBinding {
+    std::string name;
+    // "__{name}_len__", for sparse outputs
+    std::string lenName;
+    Output *output;
+  };
+
+  void bindInputsAndOutputs_();
+
+  bool bound_;
+  std::vector<InputBinding> inputBindings_;
+  std::vector<OutputBinding> outputBindings_;
 };
 } // namespace nupic
 
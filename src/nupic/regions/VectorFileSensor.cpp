@@ -420,6 +420,15 @@ void VectorFileSensor::getParameterFromBuffer(const std::string &name,
   NTA_CHECK(res >= 0) << where << "couldn't retrieve '" << name << "'";
 }
 
+//----------------------------------------------------------------------
+void *VectorFileSensor::getParameterAddress(const std::string &name) {
+  // The other scalars are computed, or checked when set
+  if (name == "activeOutputCount") {
+    return &activeOutputCount_;
+  }
+  return nullptr;
+}
+
 //----------------------------------------------------------------------
 void VectorFileSensor::seek(int n) {
   NTA_CHECK((n >= 0) && ((unsigned int)n < vectorFile_.vectorCount()));
@@ -282,6 +282,8 @@ public:
 
   size_t getParameterArrayCount(const std::string &name, Int64 index) override;
 
+  void *getParameterAddress(const std::string &name) override;
+
   virtual void getParameterArray(const std::string &name, Int64 index,
                                  Array &array) override;
   virtual void setParameterArray(const std::string &name, Int64 index,
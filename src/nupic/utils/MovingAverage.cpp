@@ -32,29 +32,43 @@ using namespace ::nupic;
 using namespace nupic::util;
 
 MovingAverage::MovingAverage(UInt wSize, const vector<Real32> &historicalValues)
-    : windowSize_(wSize) {
-  if (historicalValues.size() != 0) {
-    copy(historicalValues.begin() + historicalValues.size() - wSize,
-         historicalValues.end(), back_inserter(slidingWindow_));
-  }
-  total_ = Real32(accumulate(slidingWindow_.begin(), slidingWindow_.end(), 0));
+    : windowSize_(wSize), head_(0) {
+  NTA_CHECK(wSize > 0) << "MovingAverage: the window size must be > 0";
+  slidingWindow_.reserve(wSize);
+  // Keep the last wSize values
+  const size_t n = min<size_t>(wSize, historicalValues.size());
+  copy(historicalValues.end() - n, historicalValues.end(),
+       back_inserter(slidingWindow_));
+  total_ = accumulate(slidingWindow_.begin(), slidingWindow_.end(), 0.0f);
 }
 
-MovingAverage::MovingAverage(UInt wSize) : windowSize_(wSize), total_(0) {}
+MovingAverage::MovingAverage(UInt wSize)
+    : windowSize_(wSize), head_(0), total_(0) {
+  NTA_CHECK(wSize > 0) << "MovingAverage: the window size must be > 0";
+  slidingWindow_.reserve(wSize);
+}
 
 Real32 MovingAverage::compute(Real32 newVal) {
-  if (windowSize_ == slidingWindow_.size()) {
-    total_ -= slidingWindow_.front();
-    slidingWindow_.erase(slidingWindow_.begin()); // pop front element
+  if (slidingWindow_.size() < windowSize_) {
+    slidingWindow_.push_back(newVal);
+  } else {
+    // Replace the oldest value
+    total_ -= slidingWindow_[head_];
+    slidingWindow_[head_] = newVal;
+    if (++head_ == windowSize_)
+      head_ = 0;
   }
 
-  slidingWindow_.push_back(newVal);
   total_ += newVal;
   return getCurrentAvg();
 }
 
 std::vector<Real32> MovingAverage::getSlidingWindow() const {
-  return slidingWindow_;
+  // Oldest first
+  vector<Real32> window(slidingWindow_.begin() + head_, slidingWindow_.end());
+  window.insert(window.end(), slidingWindow_.begin(),
+                slidingWindow_.begin() + head_);
+  return window;
 }
 
 Real32 MovingAverage::getCurrentAvg() const {
@@ -62,8 +76,8 @@ Real32 MovingAverage::getCurrentAvg() const {
 }
 
 bool MovingAverage::operator==(const MovingAverage &r2) const {
-  return (windowSize_ == r2.windowSize_ &&
-          slidingWindow_ == r2.slidingWindow_ && total_ == r2.total_);
+  return (windowSize_ == r2.windowSize_ && total_ == r2.total_ &&
+          getSlidingWindow() == r2.getSlidingWindow());
 }
 
 bool MovingAverage::operator!=(const MovingAverage &r2) const {
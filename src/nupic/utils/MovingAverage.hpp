@@ -31,6 +31,12 @@ namespace nupic {
 
 namespace util {
 
+/**
+ * Average of the last values of a stream, in a window of fixed size.
+ *
+ * The window is a ring buffer allocated on construction, so that compute()
+ * is O(1) and does not allocate.
+ */
 class MovingAverage {
 public:
   MovingAverage(UInt wSize, const std::vector<Real32> &historicalValues);
@@ -39,12 +45,16 @@ public:
   Real32 getCurrentAvg() const;
   Real32 compute(Real32 newValue);
   Real32 getTotal() const;
+  UInt getWindowSize() const { return windowSize_; }
   bool operator==(const MovingAverage &r2) const;
   bool operator!=(const MovingAverage &r2) const;
 
 private:
   UInt32 windowSize_;
+  // The last values, oldest first until the window is full. Then the
+  // oldest is at head_.
   std::vector<Real32> slidingWindow_;
+  UInt32 head_;
   Real32 total_;
 };
 } // namespace util
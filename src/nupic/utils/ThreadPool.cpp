@@ -0,0 +1,160 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of ThreadPool
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include <nupic/os/Env.hpp>
+#include <nupic/utils/ThreadPool.hpp>
+
+using namespace nupic;
+using namespace nupic::util;
+
+struct ThreadPool::Batch {
+  Batch() : pending(0) {}
+
+  UInt pending;
+  std::exception_ptr error;
+  std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(UInt nWorkers) : stopping_(false) {
+  workers_.reserve(nWorkers);
+  for (UInt i = 0; i < nWorkers; ++i)
+    workers_.push_back(std::thread(&ThreadPool::workerLoop_, this));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool([]() -> UInt {
+    std::string value;
+    if (Env::get("NTA_NUM_THREADS", value)) {
+      int n = std::atoi(value.c_str());
+      return n > 1 ? (UInt)(n - 1) : 0;
+    }
+    UInt n = std::thread::hardware_concurrency();
+    return n > 1 ? n - 1 : 0;
+  }());
+  return pool;
+}
+
+void ThreadPool::workerLoop_() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty())
+      return;
+    runOne_(lock);
+  }
+}
+
+bool ThreadPool::runOne_(std::unique_lock<std::mutex> &lock) {
+  if (tasks_.empty())
+    return false;
+  std::function<void()> task = std::move(tasks_.front());
+  tasks_.pop_front();
+  lock.unlock();
+  task();
+  lock.lock();
+  return true;
+}
+
+void ThreadPool::parallelFor(UInt begin, UInt end, const RangeFunction &body,
+                             UInt grain, UInt maxThreads) {
+  if (end <= begin)
+    return;
+
+  grain = std::max<UInt>(grain, 1);
+  UInt n = end - begin;
+  UInt nChunks = std::min<UInt>(maxThreads == 0 ? size() : maxThreads, size());
+  nChunks = std::max<UInt>(std::min<UInt>(nChunks, n / grain), 1);
+
+  if (nChunks == 1) {
+    body(begin, end);
+    return;
+  }
+
+  auto batch = std::make_shared<Batch>();
+  UInt chunk = n / nChunks, extra = n % nChunks;
+
+  // The first chunk is kept for the calling thread.
+  UInt firstEnd = begin + chunk + (extra > 0 ? 1 : 0);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    UInt lo = firstEnd;
+    for (UInt c = 1; c < nChunks; ++c) {
+      UInt hi = lo + chunk + (c < extra ? 1 : 0);
+      ++batch->pending;
+      tasks_.push_back([this, batch, &body, lo, hi]() {
+        std::exception_ptr error;
+        try {
+          body(lo, hi);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !batch->error)
+          batch->error = error;
+        if (--batch->pending == 0)
+          batch->done.notify_all();
+      });
+      lo = hi;
+    }
+  }
+  cv_.notify_all();
+
+  std::exception_ptr error;
+  try {
+    body(begin, firstEnd);
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  // Help draining the queue while waiting for the other chunks.
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (batch->pending > 0) {
+    if (!runOne_(lock))
+      batch->done.wait(lock);
+  }
+  if (!error)
+    error = batch->error;
+  lock.unlock();
+
+  if (error)
+    std::rethrow_exception(error);
+}
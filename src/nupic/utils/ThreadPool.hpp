@@ -0,0 +1,113 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Definition of a small fork-join thread pool shared by the
+ * row-parallel kernels of the core library.
+ */
+
+#ifndef NTA_THREAD_POOL_HPP
+#define NTA_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+
+namespace util {
+
+/**
+ * Fixed-size pool of worker threads that executes data-parallel loops.
+ *
+ * parallelFor() splits a range [begin, end) into contiguous chunks and
+ * calls body(chunkBegin, chunkEnd) for each of them. The calling thread
+ * always takes part in the work, so a pool with zero workers simply runs
+ * the loop serially, and nested parallelFor() calls made from inside a
+ * body cannot deadlock. Chunks are disjoint and cover the whole range;
+ * bodies that only write to their own chunk of the output are therefore
+ * deterministic regardless of the number of threads.
+ *
+ * The first exception thrown by a body is rethrown in the calling thread
+ * once all the chunks have completed.
+ */
+class ThreadPool {
+public:
+  typedef std::function<void(UInt, UInt)> RangeFunction;
+
+  /**
+   * Creates a pool with nWorkers background threads. The caller of
+   * parallelFor() is an additional thread of execution.
+   */
+  explicit ThreadPool(UInt nWorkers);
+
+  ~ThreadPool();
+
+  /**
+   * Number of threads that can execute a parallelFor() concurrently,
+   * including the caller.
+   */
+  UInt size() const { return (UInt)workers_.size() + 1; }
+
+  /**
+   * Calls body on disjoint chunks covering [begin, end).
+   *
+   * @param grain minimum number of elements in a chunk. Ranges smaller than
+   *        twice the grain are run in the calling thread.
+   * @param maxThreads upper bound on the number of chunks, 0 means size().
+   *        Passing 1 forces serial execution in the calling thread.
+   */
+  void parallelFor(UInt begin, UInt end, const RangeFunction &body,
+                   UInt grain = 1, UInt maxThreads = 0);
+
+  /**
+   * Process-wide pool used by the library kernels. It has
+   * hardware_concurrency() - 1 workers, unless the environment variable
+   * NTA_NUM_THREADS is set, in which case it has NTA_NUM_THREADS - 1.
+   */
+  static ThreadPool &shared();
+
+private:
+  struct Batch;
+
+  void workerLoop_();
+  bool runOne_(std::unique_lock<std::mutex> &lock);
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_;
+
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+};
+
+} // namespace util
+} // namespace nupic
+
+#endif // NTA_THREAD_POOL_HPP
@@ -0,0 +1,207 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Benchmarks of the compute methods of the algorithms.
+ *
+ * Sparsities are given in active bits per thousand ("density_pm").
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <nupic/algorithms/ClassifierResult.hpp>
+#include <nupic/algorithms/Connections.hpp>
+#include <nupic/algorithms/SDRClassifier.hpp>
+#include <nupic/algorithms/SpatialPooler.hpp>
+#include <nupic/algorithms/TemporalMemory.hpp>
+#include <nupic/utils/Random.hpp>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::cla_classifier;
+using namespace nupic::algorithms::connections;
+using namespace nupic::algorithms::sdr_classifier;
+using namespace nupic::algorithms::spatial_pooler;
+using namespace nupic::algorithms::temporal_memory;
+
+#define SEED 42
+
+namespace {
+
+// The sorted indices of w bits among n, for w much smaller than n
+vector<UInt> randomSDR(Random &rng, UInt n, UInt w) {
+  vector<UInt> sdr;
+  while (sdr.size() < w) {
+    for (size_t i = sdr.size(); i != w; ++i)
+      sdr.push_back(rng.getUInt32(n));
+    sort(sdr.begin(), sdr.end());
+    sdr.erase(unique(sdr.begin(), sdr.end()), sdr.end());
+  }
+  return sdr;
+}
+
+UInt activeBits(UInt n, Int64 densityPerMille) {
+  return max<UInt>(1, (UInt)(n * densityPerMille / 1000));
+}
+
+//--------------------------------------------------------------------------------
+void SpatialPooler_compute(benchmark::State &state) {
+  const UInt numInputs = (UInt)state.range(0);
+  const UInt numColumns = (UInt)state.range(1);
+  const UInt w = activeBits(numInputs, state.range(2));
+  const bool learn = state.range(3) != 0;
+
+  SpatialPooler sp({numInputs}, {numColumns}, numInputs, 0.5, true, -1.0,
+                   max<UInt>(1, numColumns / 50));
+
+  Random rng(SEED);
+  const UInt numPatterns = 64;
+  vector<vector<UInt>> inputs(numPatterns, vector<UInt>(numInputs, 0));
+  for (auto &input : inputs)
+    for (UInt i : randomSDR(rng, numInputs, w))
+      input[i] = 1;
+  vector<UInt> active(numColumns);
+
+  UInt64 t = 0;
+  while (state.keepRunning())
+    sp.compute(inputs[t++ % numPatterns].data(), learn, active.data());
+  state.setItemsProcessed(state.iterations());
+}
+NTA_BENCHMARK(SpatialPooler_compute)
+    ->argNames({"inputs", "columns", "density_pm", "learn"})
+    ->args({1024, 2048, 20, 1})
+    ->args({1024, 2048, 20, 0})
+    ->args({1024, 2048, 100, 1})
+    ->args({2048, 4096, 20, 1});
+
+//--------------------------------------------------------------------------------
+void TemporalMemory_compute(benchmark::State &state) {
+  const UInt numColumns = (UInt)state.range(0);
+  const UInt cellsPerColumn = (UInt)state.range(1);
+  const UInt w = activeBits(numColumns, state.range(2));
+  const bool learn = state.range(3) != 0;
+
+  TemporalMemory tm({numColumns}, cellsPerColumn);
+
+  Random rng(SEED);
+  vector<vector<UInt>> sequence;
+  for (UInt i = 0; i != 100; ++i)
+    sequence.push_back(randomSDR(rng, numColumns, w));
+
+  // Learn the sequence first, so that there are segments to compute on
+  for (UInt pass = 0; pass != 3; ++pass)
+    for (const auto &sdr : sequence)
+      tm.compute(sdr.size(), sdr.data(), true);
+
+  UInt64 t = 0;
+  while (state.keepRunning()) {
+    const auto &sdr = sequence[t++ % sequence.size()];
+    tm.compute(sdr.size(), sdr.data(), learn);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+NTA_BENCHMARK(TemporalMemory_compute)
+    ->argNames({"columns", "cells", "density_pm", "learn"})
+    ->args({2048, 32, 20, 1})
+    ->args({2048, 32, 20, 0})
+    ->args({16384, 32, 20, 1});
+
+//--------------------------------------------------------------------------------
+void Connections_computeActivity(benchmark::State &state) {
+  const UInt numCells = (UInt)state.range(0);
+  const UInt segmentsPerCell = (UInt)state.range(1);
+  const UInt synapsesPerSegment = (UInt)state.range(2);
+  const UInt w = activeBits(numCells, state.range(3));
+
+  Random rng(SEED);
+  Connections connections(numCells);
+  for (CellIdx cell = 0; cell != numCells; ++cell)
+    for (UInt s = 0; s != segmentsPerCell; ++s) {
+      const Segment segment = connections.createSegment(cell);
+      for (UInt presynapticCell : randomSDR(rng, numCells, synapsesPerSegment))
+        connections.createSynapse(segment, presynapticCell,
+                                  (Permanence)rng.getReal64());
+    }
+
+  vector<vector<CellIdx>> inputs;
+  for (UInt i = 0; i != 64; ++i)
+    inputs.push_back(randomSDR(rng, numCells, w));
+
+  const size_t numSegments = connections.segmentFlatListLength();
+  vector<UInt32> numActiveConnected(numSegments);
+  vector<UInt32> numActivePotential(numSegments);
+
+  UInt64 t = 0;
+  while (state.keepRunning()) {
+    fill(numActiveConnected.begin(), numActiveConnected.end(), 0);
+    fill(numActivePotential.begin(), numActivePotential.end(), 0);
+    connections.computeActivity(numActiveConnected, numActivePotential,
+                                inputs[t++ % inputs.size()], 0.5);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+NTA_BENCHMARK(Connections_computeActivity)
+    ->argNames({"cells", "segments", "synapses", "density_pm"})
+    ->args({65536, 1, 32, 20})
+    ->args({65536, 4, 32, 20})
+    ->args({2048, 1, 1024, 20});
+
+//--------------------------------------------------------------------------------
+void SDRClassifier_compute(benchmark::State &state) {
+  const UInt numInputs = (UInt)state.range(0);
+  const UInt w = activeBits(numInputs, state.range(1));
+  const UInt numBuckets = (UInt)state.range(2);
+  const bool learn = state.range(3) != 0;
+
+  SDRClassifier classifier({1}, 0.1, 0.1, 0);
+
+  Random rng(SEED);
+  vector<vector<UInt>> patterns;
+  for (UInt i = 0; i != numBuckets; ++i)
+    patterns.push_back(randomSDR(rng, numInputs, w));
+
+  // Show every bucket, so that the weight matrix has its final size
+  UInt record = 0;
+  for (UInt bucket = 0; bucket != numBuckets; ++bucket, ++record) {
+    ClassifierResult result;
+    classifier.compute(record, patterns[bucket], {bucket}, {(Real64)bucket},
+                       false, true, true, &result);
+  }
+
+  while (state.keepRunning()) {
+    const UInt bucket = record % numBuckets;
+    ClassifierResult result;
+    classifier.compute(record++, patterns[bucket], {bucket},
+                       {(Real64)bucket}, false, learn, true, &result);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+NTA_BENCHMARK(SDRClassifier_compute)
+    ->argNames({"inputs", "density_pm", "buckets", "learn"})
+    ->args({2048, 20, 100, 1})
+    ->args({2048, 20, 100, 0})
+    ->args({16384, 20, 100, 1});
+
+} // end namespace
@@ -0,0 +1,424 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the microbenchmark harness, and main() of the
+ * nupic_benchmarks executable.
+ *
+ * Flags:
+ *   --benchmark_filter=<regex>    runs the benchmarks whose name matches
+ *   --benchmark_min_time=<s>      minimum time of each run (default 0.5)
+ *   --benchmark_repetitions=<n>   runs of each benchmark (default 1); with
+ *                                 more than one, the mean, median and
+ *                                 stddev are reported as well
+ *   --benchmark_format=<console|json>
+ *   --benchmark_out=<file>        also writes the results to file, as JSON
+ *   --benchmark_list_tests        lists the benchmarks and exits
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include <nupic/os/Regex.hpp>
+#include <nupic/utils/Log.hpp>
+
+#include "Benchmark.hpp"
+
+namespace nupic {
+namespace benchmark {
+
+//--------------------------------------------------------------------------------
+State::State(UInt64 maxIterations, const std::vector<Int64> &args)
+    : iterations_(0), maxIterations_(maxIterations), args_(args),
+      running_(false), cpuStart_(0), realTime_(0), cpuTime_(0), items_(0),
+      bytes_(0) {}
+
+bool State::keepRunningSlow_() {
+  if (iterations_ == 0 && maxIterations_ != 0) {
+    resumeTiming();
+    iterations_ = 1;
+    return true;
+  }
+  if (running_)
+    pauseTiming();
+  return false;
+}
+
+Int64 State::range(size_t i) const {
+  NTA_CHECK(i < args_.size())
+      << "Benchmark argument " << i << " out of " << args_.size();
+  return args_[i];
+}
+
+void State::pauseTiming() {
+  NTA_ASSERT(running_);
+  realTime_ +=
+      std::chrono::duration<double>(Clock::now() - realStart_).count();
+  cpuTime_ += (double)(std::clock() - cpuStart_) / CLOCKS_PER_SEC;
+  running_ = false;
+}
+
+void State::resumeTiming() {
+  NTA_ASSERT(!running_);
+  running_ = true;
+  cpuStart_ = std::clock();
+  realStart_ = Clock::now();
+}
+
+//--------------------------------------------------------------------------------
+Benchmark::Benchmark(const std::string &name, Function function)
+    : name_(name), function_(function) {}
+
+Benchmark *Benchmark::args(const std::vector<Int64> &args) {
+  NTA_CHECK(argNames_.empty() || argNames_.size() == args.size())
+      << name_ << ": expected " << argNames_.size() << " arguments";
+  args_.push_back(args);
+  return this;
+}
+
+Benchmark *Benchmark::argNames(const std::vector<std::string> &names) {
+  argNames_ = names;
+  return this;
+}
+
+std::string Benchmark::nameFor(size_t i) const {
+  std::stringstream name;
+  name << name_;
+  if (i < args_.size())
+    for (size_t j = 0; j != args_[i].size(); ++j) {
+      name << "/";
+      if (j < argNames_.size())
+        name << argNames_[j] << ":";
+      name << args_[i][j];
+    }
+  return name.str();
+}
+
+static std::vector<std::unique_ptr<Benchmark>> &registry() {
+  static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+  return benchmarks;
+}
+
+Benchmark *registerBenchmark(const std::string &name, Function function) {
+  registry().emplace_back(new Benchmark(name, function));
+  return registry().back().get();
+}
+
+//--------------------------------------------------------------------------------
+namespace {
+
+struct Options {
+  std::string filter = ".";
+  double minTime = 0.5;
+  UInt repetitions = 1;
+  std::string format = "console";
+  std::string out;
+  bool list = false;
+};
+
+// One line of the results: a run, or an aggregate over the repetitions
+struct Result {
+  std::string name, runName, runType, aggregate, label;
+  UInt64 iterations;
+  double realTime, cpuTime; // nanoseconds per iteration
+  double itemsPerSecond, bytesPerSecond;
+};
+
+bool parseFlag(const char *arg, const char *flag, std::string &value) {
+  const size_t n = std::strlen(flag);
+  if (std::strncmp(arg, "--", 2) != 0 || std::strncmp(arg + 2, flag, n) != 0)
+    return false;
+  if (arg[2 + n] == '=')
+    value = arg + 3 + n;
+  else if (arg[2 + n] == '\0')
+    value = "true";
+  else
+    return false;
+  return true;
+}
+
+Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (parseFlag(argv[i], "benchmark_filter", value))
+      options.filter = value;
+    else if (parseFlag(argv[i], "benchmark_min_time", value))
+      options.minTime = std::atof(value.c_str());
+    else if (parseFlag(argv[i], "benchmark_repetitions", value))
+      options.repetitions = (UInt)std::max(1, std::atoi(value.c_str()));
+    else if (parseFlag(argv[i], "benchmark_format", value))
+      options.format = value;
+    else if (parseFlag(argv[i], "benchmark_out", value))
+      options.out = value;
+    else if (parseFlag(argv[i], "benchmark_list_tests", value))
+      options.list = value != "false";
+    else
+      NTA_THROW << "Unknown flag: " << argv[i];
+  }
+  NTA_CHECK(options.format == "console" || options.format == "json")
+      << "Unknown benchmark_format: " << options.format;
+  return options;
+}
+
+State runOnce(const Benchmark &benchmark, size_t i, UInt64 iterations) {
+  static const std::vector<Int64> noArgs;
+  const auto &argsList = benchmark.argsList();
+  State state(iterations, i < argsList.size() ? argsList[i] : noArgs);
+  benchmark.function()(state);
+  NTA_CHECK(state.iterations() == iterations)
+      << benchmark.name() << " did not run the keepRunning() loop to the end";
+  return state;
+}
+
+Result makeResult(const std::string &name, const State &state) {
+  Result r;
+  r.name = r.runName = name;
+  r.runType = "iteration";
+  r.label = state.label();
+  r.iterations = state.iterations();
+  r.realTime = state.realTime() * 1e9 / state.iterations();
+  r.cpuTime = state.cpuTime() * 1e9 / state.iterations();
+  r.itemsPerSecond =
+      state.realTime() > 0 ? state.itemsProcessed() / state.realTime() : 0;
+  r.bytesPerSecond =
+      state.realTime() > 0 ? state.bytesProcessed() / state.realTime() : 0;
+  return r;
+}
+
+// Mean, median or stddev of a field over runs
+double statistic(const std::vector<Result> &runs, double Result::*field,
+                 const std::string &name) {
+  std::vector<double> v;
+  for (const Result &r : runs)
+    v.push_back(r.*field);
+  const size_t n = v.size();
+
+  double mean = 0;
+  for (double x : v)
+    mean += x / n;
+  if (name == "mean")
+    return mean;
+
+  if (name == "median") {
+    std::sort(v.begin(), v.end());
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+  }
+
+  double var = 0;
+  for (double x : v)
+    var += (x - mean) * (x - mean);
+  return std::sqrt(var / std::max<size_t>(1, n - 1));
+}
+
+// Appends the mean, median and stddev of runs to results
+void aggregate(const std::vector<Result> &runs, std::vector<Result> &results) {
+  for (const char *name : {"mean", "median", "stddev"}) {
+    Result a = runs.front();
+    a.name = a.runName + "_" + name;
+    a.runType = "aggregate";
+    a.aggregate = name;
+    for (double Result::*field : {&Result::realTime, &Result::cpuTime,
+                                  &Result::itemsPerSecond,
+                                  &Result::bytesPerSecond})
+      a.*field = statistic(runs, field, name);
+    results.push_back(a);
+  }
+}
+
+std::string jsonString(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((unsigned char)c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+void writeJson(std::ostream &out, const std::vector<Result> &results) {
+  char date[64];
+  std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S",
+                std::localtime(&now));
+
+  out << std::setprecision(10);
+  out << "{\n  \"context\": {\n"
+      << "    \"date\": " << jsonString(date) << ",\n"
+      << "    \"executable\": \"nupic_benchmarks\",\n"
+      << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NTA_ASSERTIONS_ON
+      << "    \"library_build_type\": \"debug\"\n"
+#else
+      << "    \"library_build_type\": \"release\"\n"
+#endif
+      << "  },\n  \"benchmarks\": [";
+  for (size_t i = 0; i != results.size(); ++i) {
+    const Result &r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\n"
+        << "      \"name\": " << jsonString(r.name) << ",\n"
+        << "      \"run_name\": " << jsonString(r.runName) << ",\n"
+        << "      \"run_type\": " << jsonString(r.runType) << ",\n";
+    if (!r.aggregate.empty())
+      out << "      \"aggregate_name\": " << jsonString(r.aggregate) << ",\n";
+    out << "      \"iterations\": " << r.iterations << ",\n"
+        << "      \"real_time\": " << r.realTime << ",\n"
+        << "      \"cpu_time\": " << r.cpuTime << ",\n"
+        << "      \"time_unit\": \"ns\"";
+    if (r.itemsPerSecond > 0)
+      out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+    if (r.bytesPerSecond > 0)
+      out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+    if (!r.label.empty())
+      out << ",\n      \"label\": " << jsonString(r.label);
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+// x with a k, M or G prefix, in powers of base
+std::string humanRate(double x, double base) {
+  const char *prefixes[] = {"", "k", "M", "G"};
+  size_t p = 0;
+  for (; p != 3 && x >= base; ++p)
+    x /= base;
+  std::stringstream s;
+  s << std::fixed << std::setprecision(x < 10 ? 2 : 1) << x << prefixes[p];
+  return s.str();
+}
+
+void writeConsoleHeader(std::ostream &out, size_t width) {
+  out << std::left << std::setw(width) << "Benchmark" << std::right
+      << std::setw(15) << "Time" << std::setw(15) << "CPU"
+      << std::setw(12) << "Iterations" << "\n"
+      << std::string(width + 42, '-') << "\n";
+}
+
+void writeConsole(std::ostream &out, const Result &r, size_t width) {
+  out << std::left << std::setw(width) << r.name << std::right << std::fixed
+      << std::setprecision(0) << std::setw(12) << r.realTime << " ns"
+      << std::setw(12) << r.cpuTime << " ns" << std::setw(12)
+      << r.iterations;
+  if (r.itemsPerSecond > 0)
+    out << "  " << humanRate(r.itemsPerSecond, 1000) << " items/s";
+  if (r.bytesPerSecond > 0)
+    out << "  " << humanRate(r.bytesPerSecond, 1024) << "B/s";
+  if (!r.label.empty())
+    out << "  " << r.label;
+  out << std::endl;
+}
+
+} // end namespace
+
+//--------------------------------------------------------------------------------
+int runBenchmarks(int argc, char *argv[]) {
+  const Options options = parseOptions(argc, argv);
+
+  // The selected (benchmark, arguments) pairs
+  std::vector<std::pair<const Benchmark *, size_t>> selected;
+  size_t width = 10;
+  for (const auto &benchmark : registry()) {
+    const size_t n = std::max<size_t>(1, benchmark->argsList().size());
+    for (size_t i = 0; i != n; ++i) {
+      const std::string name = benchmark->nameFor(i);
+      if (regex::match(".*(" + options.filter + ").*", name)) {
+        selected.push_back(std::make_pair(benchmark.get(), i));
+        width = std::max(width, name.size() + 8);
+      }
+    }
+  }
+
+  if (options.list) {
+    for (const auto &s : selected)
+      std::cout << s.first->nameFor(s.second) << std::endl;
+    return 0;
+  }
+
+  const bool console = options.format == "console";
+  if (console)
+    writeConsoleHeader(std::cout, width);
+
+  std::vector<Result> results;
+  for (const auto &s : selected) {
+    const std::string name = s.first->nameFor(s.second);
+
+    // Grow the number of iterations until a run lasts minTime
+    UInt64 iterations = 1;
+    State state = runOnce(*s.first, s.second, iterations);
+    while (state.realTime() < options.minTime && iterations < 1000000000) {
+      double multiplier = 10;
+      if (state.realTime() > options.minTime / 10)
+        multiplier = 1.4 * options.minTime / state.realTime();
+      iterations = std::max(iterations + 1, (UInt64)(iterations * multiplier));
+      state = runOnce(*s.first, s.second, iterations);
+    }
+
+    std::vector<Result> runs(1, makeResult(name, state));
+    for (UInt r = 1; r < options.repetitions; ++r)
+      runs.push_back(makeResult(name, runOnce(*s.first, s.second, iterations)));
+
+    const size_t first = results.size();
+    results.insert(results.end(), runs.begin(), runs.end());
+    if (runs.size() > 1)
+      aggregate(runs, results);
+    if (console)
+      for (size_t i = first; i != results.size(); ++i)
+        writeConsole(std::cout, results[i], width);
+  }
+
+  if (!console)
+    writeJson(std::cout, results);
+  if (!options.out.empty()) {
+    std::ofstream out(options.out.c_str());
+    NTA_CHECK(out.good()) << "Unable to open " << options.out;
+    writeJson(out, results);
+  }
+  return 0;
+}
+
+} // end namespace benchmark
+} // end namespace nupic
+
+int main(int argc, char *argv[]) {
+  try {
+    return nupic::benchmark::runBenchmarks(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+}
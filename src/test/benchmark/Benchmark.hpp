@@ -0,0 +1,196 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * A small microbenchmark harness, modeled on Google Benchmark.
+ *
+ * A benchmark is a function that does its setup, then runs the code to
+ * measure in a `while (state.keepRunning())` loop. It is registered with
+ * NTA_BENCHMARK, and each call to args() adds a set of parameters, which
+ * the function reads with state.range(i):
+ *
+ *   static void SparseMatrix_rightVecProd(benchmark::State &state) {
+ *     ... build a matrix of state.range(0) rows ...
+ *     while (state.keepRunning())
+ *       m.rightVecProd(x.begin(), y.begin());
+ *   }
+ *   NTA_BENCHMARK(SparseMatrix_rightVecProd)
+ *       ->argNames({"rows", "cols"})
+ *       ->args({2048, 2048});
+ *
+ * The benchmark_* command line flags and the JSON output of the
+ * nupic_benchmarks executable follow Google Benchmark, so that the results
+ * can be read by its tools as well as by compare_benchmarks.py.
+ */
+
+#ifndef NTA_BENCHMARK_HPP
+#define NTA_BENCHMARK_HPP
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <nupic/types/Types.hpp>
+
+namespace nupic {
+namespace benchmark {
+
+/**
+ * Controls the timed loop of one run of a benchmark.
+ */
+class State {
+public:
+  State(UInt64 maxIterations, const std::vector<Int64> &args);
+
+  /**
+   * Returns true until the requested number of iterations has run. The
+   * timer starts on the first call and stops on the last one.
+   */
+  inline bool keepRunning() {
+    if (iterations_ != 0 && iterations_ < maxIterations_) {
+      ++iterations_;
+      return true;
+    }
+    return keepRunningSlow_();
+  }
+
+  /**
+   * Returns the i-th argument of the benchmark.
+   */
+  Int64 range(size_t i = 0) const;
+
+  /**
+   * Excludes the code between pauseTiming() and resumeTiming() from the
+   * measured time, e.g. to reset state between iterations.
+   */
+  void pauseTiming();
+  void resumeTiming();
+
+  /**
+   * Number of items (or bytes) processed by all the iterations, reported as
+   * a rate.
+   */
+  void setItemsProcessed(UInt64 items) { items_ = items; }
+  void setBytesProcessed(UInt64 bytes) { bytes_ = bytes; }
+
+  /**
+   * Free-form text reported with the results.
+   */
+  void setLabel(const std::string &label) { label_ = label; }
+
+  UInt64 iterations() const { return iterations_; }
+  UInt64 maxIterations() const { return maxIterations_; }
+
+  double realTime() const { return realTime_; }
+  double cpuTime() const { return cpuTime_; }
+  UInt64 itemsProcessed() const { return items_; }
+  UInt64 bytesProcessed() const { return bytes_; }
+  const std::string &label() const { return label_; }
+
+private:
+  bool keepRunningSlow_();
+
+  typedef std::chrono::steady_clock Clock;
+
+  UInt64 iterations_, maxIterations_;
+  std::vector<Int64> args_;
+  bool running_;
+  Clock::time_point realStart_;
+  std::clock_t cpuStart_;
+  double realTime_, cpuTime_; // seconds
+  UInt64 items_, bytes_;
+  std::string label_;
+};
+
+typedef void (*Function)(State &);
+
+/**
+ * A registered benchmark function and its sets of arguments.
+ */
+class Benchmark {
+public:
+  Benchmark(const std::string &name, Function function);
+
+  /**
+   * Adds a run of the benchmark with these arguments.
+   */
+  Benchmark *args(const std::vector<Int64> &args);
+
+  /**
+   * Names the arguments in the reported benchmark names, as in
+   * "SpatialPooler_compute/inputs:1024/columns:2048".
+   */
+  Benchmark *argNames(const std::vector<std::string> &names);
+
+  /**
+   * The reported name for the i-th set of arguments.
+   */
+  std::string nameFor(size_t i) const;
+
+  const std::string &name() const { return name_; }
+  Function function() const { return function_; }
+  const std::vector<std::vector<Int64>> &argsList() const { return args_; }
+
+private:
+  std::string name_;
+  Function function_;
+  std::vector<std::vector<Int64>> args_;
+  std::vector<std::string> argNames_;
+};
+
+/**
+ * Registers a benchmark. The registry owns it.
+ */
+Benchmark *registerBenchmark(const std::string &name, Function function);
+
+/**
+ * Parses the benchmark_* flags, runs the selected benchmarks and reports
+ * the results. Returns the exit code of the program.
+ */
+int runBenchmarks(int argc, char *argv[]);
+
+/**
+ * Keeps the compiler from optimizing away a value that is not used
+ * otherwise.
+ */
+template <typename T> inline void doNotOptimize(const T &value) {
+#if defined(_MSC_VER)
+  static volatile const void *sink;
+  sink = &value;
+#else
+  asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+} // end namespace benchmark
+} // end namespace nupic
+
+#define NTA_BENCHMARK_CONCAT2_(a, b) a##b
+#define NTA_BENCHMARK_CONCAT_(a, b) NTA_BENCHMARK_CONCAT2_(a, b)
+
+#define NTA_BENCHMARK(function)                                                \
+  static ::nupic::benchmark::Benchmark *NTA_BENCHMARK_CONCAT_(                 \
+      ntaBenchmark_, __LINE__) =                                               \
+      ::nupic::benchmark::registerBenchmark(#function, function)
+
+#endif // NTA_BENCHMARK_HPP
@@ -0,0 +1,102 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Benchmarks of the network engine, on networks of TestNode regions.
+ */
+
+#include <string>
+#include <vector>
+
+#include <nupic/engine/Input.hpp>
+#include <nupic/engine/Link.hpp>
+#include <nupic/engine/Network.hpp>
+#include <nupic/engine/Region.hpp>
+#include <nupic/ntypes/Dimensions.hpp>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace nupic;
+
+namespace {
+
+// Adds a chain of numLevels TestNode regions, "level1" being width x width
+// nodes, each level linked to the next with TestFanIn2
+void addLevels(Network &net, UInt width, UInt numLevels) {
+  for (UInt level = 1; level <= numLevels; ++level) {
+    const string name = "level" + to_string(level);
+    Region *region = net.addRegion(name, "TestNode", "");
+    if (level == 1) {
+      Dimensions d;
+      d.push_back(width);
+      d.push_back(width);
+      region->setDimensions(d);
+    } else {
+      net.link("level" + to_string(level - 1), name, "TestFanIn2", "");
+    }
+  }
+  net.initialize();
+}
+
+//--------------------------------------------------------------------------------
+void Link_compute(benchmark::State &state) {
+  const UInt width = (UInt)state.range(0);
+
+  Network net;
+  addLevels(net, width, 2);
+  net.run(1);
+  Link *link = net.getRegions().getByName("level2")->getInput("bottomUpIn")
+                   ->getLinks()
+                   .front();
+
+  while (state.keepRunning())
+    link->compute();
+
+  // TestNode outputs two Real64 per node
+  state.setBytesProcessed(state.iterations() * width * width * 2 *
+                          sizeof(Real64));
+}
+NTA_BENCHMARK(Link_compute)
+    ->argNames({"width"})
+    ->args({32})
+    ->args({256});
+
+//--------------------------------------------------------------------------------
+void Network_run(benchmark::State &state) {
+  const UInt width = (UInt)state.range(0);
+  const UInt numLevels = (UInt)state.range(1);
+
+  Network net;
+  addLevels(net, width, numLevels);
+
+  while (state.keepRunning())
+    net.run(1);
+  state.setItemsProcessed(state.iterations());
+}
+NTA_BENCHMARK(Network_run)
+    ->argNames({"width", "levels"})
+    ->args({16, 3})
+    ->args({128, 3})
+    ->args({128, 6});
+
+} // end namespace
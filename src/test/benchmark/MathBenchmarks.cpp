@@ -0,0 +1,184 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Benchmarks of the SparseMatrix and SparseBinaryMatrix products.
+ *
+ * Densities are given in non-zeros per thousand ("density_pm"). The
+ * "threads" argument is the nThreads argument of the _parallel methods,
+ * where 1 selects the serial method.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <nupic/math/SparseBinaryMatrix.hpp>
+#include <nupic/math/SparseMatrix.hpp>
+#include <nupic/utils/Random.hpp>
+
+#include "Benchmark.hpp"
+
+using namespace std;
+using namespace nupic;
+
+#define SEED 42
+
+namespace {
+
+typedef SparseMatrix<UInt32, Real32> SM;
+typedef SparseBinaryMatrix<UInt32, UInt32> SBM;
+
+// The sorted column indices of the non-zeros of each row
+vector<vector<UInt32>> randomRows(Random &rng, UInt32 nrows, UInt32 ncols,
+                                  Int64 densityPerMille) {
+  const UInt32 nnzr = max<UInt32>(1, (UInt32)(ncols * densityPerMille / 1000));
+  vector<UInt32> population(ncols);
+  iota(population.begin(), population.end(), 0);
+  vector<vector<UInt32>> rows(nrows, vector<UInt32>(nnzr));
+  for (auto &row : rows)
+    rng.sample(population.data(), ncols, row.data(), nnzr);
+  return rows;
+}
+
+SM randomMatrix(Random &rng, UInt32 nrows, UInt32 ncols,
+                Int64 densityPerMille) {
+  SM m(0, ncols);
+  for (const auto &row : randomRows(rng, nrows, ncols, densityPerMille)) {
+    vector<Real32> nz(row.size());
+    for (auto &v : nz)
+      v = (Real32)rng.getReal64() + 0.01f;
+    m.addRow(row.begin(), row.end(), nz.begin());
+  }
+  return m;
+}
+
+// The work of one iteration, for items per second
+void setProcessed(benchmark::State &state, UInt64 nnz) {
+  state.setItemsProcessed(state.iterations() * nnz);
+}
+
+//--------------------------------------------------------------------------------
+void SparseMatrix_rightVecProd(benchmark::State &state) {
+  Random rng(SEED);
+  const UInt32 nrows = (UInt32)state.range(0), ncols = (UInt32)state.range(1);
+  const SM m = randomMatrix(rng, nrows, ncols, state.range(2));
+  const UInt nThreads = (UInt)state.range(3);
+  vector<Real32> x(ncols), y(nrows);
+  for (auto &v : x)
+    v = (Real32)rng.getReal64();
+
+  while (state.keepRunning()) {
+    if (nThreads == 1)
+      m.rightVecProd(x.begin(), y.begin());
+    else
+      m.rightVecProd_parallel(x.begin(), y.begin(), nThreads);
+    benchmark::doNotOptimize(y[0]);
+  }
+  setProcessed(state, m.nNonZeros());
+}
+NTA_BENCHMARK(SparseMatrix_rightVecProd)
+    ->argNames({"rows", "cols", "density_pm", "threads"})
+    ->args({2048, 1024, 20, 1})
+    ->args({2048, 1024, 500, 1})
+    ->args({16384, 2048, 20, 1})
+    ->args({16384, 2048, 20, 0});
+
+//--------------------------------------------------------------------------------
+void SparseMatrix_leftVecProd(benchmark::State &state) {
+  Random rng(SEED);
+  const UInt32 nrows = (UInt32)state.range(0), ncols = (UInt32)state.range(1);
+  const SM m = randomMatrix(rng, nrows, ncols, state.range(2));
+  const UInt nThreads = (UInt)state.range(3);
+  vector<Real32> x(nrows), y(ncols);
+  for (auto &v : x)
+    v = (Real32)rng.getReal64();
+
+  while (state.keepRunning()) {
+    if (nThreads == 1)
+      m.leftVecProd(x.begin(), y.begin());
+    else
+      m.leftVecProd_parallel(x.begin(), y.begin(), nThreads);
+    benchmark::doNotOptimize(y[0]);
+  }
+  setProcessed(state, m.nNonZeros());
+}
+NTA_BENCHMARK(SparseMatrix_leftVecProd)
+    ->argNames({"rows", "cols", "density_pm", "threads"})
+    ->args({2048, 1024, 20, 1})
+    ->args({16384, 2048, 20, 1})
+    ->args({16384, 2048, 20, 0});
+
+//--------------------------------------------------------------------------------
+void SparseMatrix_rightVecSumAtNZ(benchmark::State &state) {
+  Random rng(SEED);
+  const UInt32 nrows = (UInt32)state.range(0), ncols = (UInt32)state.range(1);
+  const SM m = randomMatrix(rng, nrows, ncols, state.range(2));
+  const UInt nThreads = (UInt)state.range(3);
+  vector<Real32> x(ncols), y(nrows);
+  const vector<UInt32> ones = randomRows(rng, 1, ncols, 20).front();
+  for (UInt32 j : ones)
+    x[j] = 1;
+
+  while (state.keepRunning()) {
+    if (nThreads == 1)
+      m.rightVecSumAtNZ(x.begin(), y.begin());
+    else
+      m.rightVecSumAtNZ_parallel(x.begin(), y.begin(), nThreads);
+    benchmark::doNotOptimize(y[0]);
+  }
+  setProcessed(state, m.nNonZeros());
+}
+NTA_BENCHMARK(SparseMatrix_rightVecSumAtNZ)
+    ->argNames({"rows", "cols", "density_pm", "threads"})
+    ->args({2048, 1024, 500, 1})
+    ->args({2048, 1024, 500, 0});
+
+//--------------------------------------------------------------------------------
+void SparseBinaryMatrix_rightVecSumAtNZ(benchmark::State &state) {
+  Random rng(SEED);
+  const UInt32 nrows = (UInt32)state.range(0), ncols = (UInt32)state.range(1);
+  SBM m(ncols);
+  for (const auto &row : randomRows(rng, nrows, ncols, state.range(2)))
+    m.appendSparseRow(row.begin(), row.end());
+  const UInt nThreads = (UInt)state.range(3);
+  vector<Real32> x(ncols), y(nrows);
+  const vector<UInt32> ones = randomRows(rng, 1, ncols, 20).front();
+  for (UInt32 j : ones)
+    x[j] = 1;
+
+  while (state.keepRunning()) {
+    if (nThreads == 1)
+      m.rightVecSumAtNZ(x.begin(), x.end(), y.begin(), y.end());
+    else
+      m.rightVecSumAtNZ_parallel(x.begin(), x.end(), y.begin(), y.end(),
+                                 nThreads);
+    benchmark::doNotOptimize(y[0]);
+  }
+  setProcessed(state, m.nNonZeros());
+}
+NTA_BENCHMARK(SparseBinaryMatrix_rightVecSumAtNZ)
+    ->argNames({"rows", "cols", "density_pm", "threads"})
+    ->args({2048, 1024, 500, 1})
+    ->args({2048, 1024, 500, 0});
+
+} // end namespace
@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+# ----------------------------------------------------------------------
+# Numenta Platform for Intelligent Computing (NuPIC)
+# Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+# with Numenta, Inc., for a separate license for this software code, the
+# following terms and conditions apply:
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU Affero Public License for more details.
+#
+# You should have received a copy of the GNU Affero Public License
+# along with this program.  If not, see http://www.gnu.org/licenses.
+#
+# http://numenta.org/licenses/
+# ----------------------------------------------------------------------
+
+"""Compares two JSON results of nupic_benchmarks and flags regressions.
+
+Usage:
+
+  nupic_benchmarks --benchmark_repetitions=5 --benchmark_out=baseline.json
+  ... change the code, rebuild ...
+  nupic_benchmarks --benchmark_repetitions=5 --benchmark_out=current.json
+  compare_benchmarks.py baseline.json current.json
+
+When the results contain repetitions, their medians are compared. The exit
+status is 1 when a benchmark got slower than the threshold allows.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import sys
+
+
+
+def loadTimes(path, metric):
+  """Returns {benchmark name: time in ns} for the results in path."""
+  with open(path) as f:
+    results = json.load(f)
+
+  scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+  runs = {}
+  medians = {}
+  for b in results["benchmarks"]:
+    name = b.get("run_name", b["name"])
+    time = b[metric] * scale[b.get("time_unit", "ns")]
+    if b.get("run_type") == "aggregate":
+      if b.get("aggregate_name") == "median":
+        medians[name] = time
+    else:
+      runs.setdefault(name, []).append(time)
+
+  times = {}
+  for name, values in runs.items():
+    values.sort()
+    n = len(values)
+    times[name] = (values[n // 2] if n % 2
+                   else (values[n // 2 - 1] + values[n // 2]) / 2)
+  times.update(medians)
+  return times
+
+
+
+def formatTime(ns):
+  for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+    if ns >= scale:
+      return "%.3f %s" % (ns / scale, unit)
+  return "%.1f ns" % ns
+
+
+
+def main(argv):
+  parser = argparse.ArgumentParser(
+      description="Compare nupic_benchmarks JSON results to a baseline.")
+  parser.add_argument("baseline", help="JSON results of the baseline")
+  parser.add_argument("current", help="JSON results to check")
+  parser.add_argument("--threshold", type=float, default=0.05,
+                      help="relative slowdown flagged as a regression "
+                           "(default 0.05)")
+  parser.add_argument("--metric", choices=("real_time", "cpu_time"),
+                      default="real_time",
+                      help="time compared (default real_time)")
+  parser.add_argument("--filter", default="",
+                      help="only compare the benchmarks whose name contains "
+                           "this string")
+  args = parser.parse_args(argv)
+
+  baseline = loadTimes(args.baseline, args.metric)
+  current = loadTimes(args.current, args.metric)
+
+  names = sorted(n for n in set(baseline) | set(current) if args.filter in n)
+  width = max([len(n) for n in names] + [9])
+  print("%-*s %14s %14s %9s" % (width, "Benchmark", "Baseline", "Current",
+                                "Change"))
+  print("-" * (width + 40))
+
+  regressions = []
+  for name in names:
+    if name not in current:
+      print("%-*s %14s %14s %9s" % (width, name,
+                                    formatTime(baseline[name]), "-",
+                                    "removed"))
+      continue
+    if name not in baseline:
+      print("%-*s %14s %14s %9s" % (width, name, "-",
+                                    formatTime(current[name]), "new"))
+      continue
+
+    change = current[name] / baseline[name] - 1.0
+    flag = ""
+    if change > args.threshold:
+      flag = "  REGRESSION"
+      regressions.append(name)
+    elif change < -args.threshold:
+      flag = "  improved"
+    print("%-*s %14s %14s %+8.1f%%%s" % (width, name,
+                                         formatTime(baseline[name]),
+                                         formatTime(current[name]),
+                                         100.0 * change, flag))
+
+  if regressions:
+    print("\n%d regression(s) above %.1f%%:" % (len(regressions),
+                                                100.0 * args.threshold))
+    for name in regressions:
+      print("  " + name)
+    return 1
+  return 0
+
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv[1:]))
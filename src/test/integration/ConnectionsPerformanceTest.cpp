@@ -176,7 +176,7 @@ void ConnectionsPerformanceTest::runSpatialPoolerTest(UInt numCells,
     for (CellIdx winnerCell : winnerCells) {
       segment = connections.getSegment(winnerCell, 0);
 
-      const vector<Synapse> &synapses = connections.synapsesForSegment(segment);
+      const SynapseList synapses = connections.synapsesForSegment(segment);
 
       for (SynapseIdx i = 0; i < (SynapseIdx)synapses.size();) {
         const Synapse synapse = synapses[i];
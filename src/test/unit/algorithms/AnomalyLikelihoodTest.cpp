@@ -0,0 +1,230 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nupic/algorithms/AnomalyLikelihood.hpp"
+#include "nupic/types/Types.hpp"
+#include "nupic/utils/Random.hpp"
+
+using namespace nupic;
+using namespace nupic::algorithms::anomaly;
+
+namespace {
+
+// Raw scores around 0.1, as produced by a model that learned its input
+std::vector<Real64> noisyScores(Random &rng, size_t n) {
+  std::vector<Real64> scores(n);
+  for (auto &s : scores)
+    s = 0.2 * rng.getReal64();
+  return scores;
+}
+
+// Straightforward implementation of the likelihood, which re-estimates the
+// distribution from the whole window, and filters consecutive red zone
+// tail probabilities against the previous record, scored with the same
+// distribution
+std::vector<Real64> referenceLikelihoods(const std::vector<Real64> &raw,
+                                         UInt learningPeriod,
+                                         UInt estimationSamples,
+                                         UInt historicWindowSize,
+                                         UInt reestimationPeriod,
+                                         UInt averagingWindow) {
+  std::vector<Real64> averages, likelihoods;
+  Real64 mean = 0, stdev = 0, previousTail = 1.0;
+  bool estimated = false;
+  auto tail = [&](Real64 average) {
+    return 0.5 * std::erfc(std::fabs(average - mean) / stdev / std::sqrt(2.0));
+  };
+  for (size_t i = 0; i < raw.size(); ++i) {
+    const size_t first = i + 1 > averagingWindow ? i + 1 - averagingWindow : 0;
+    Real64 sum = 0;
+    for (size_t j = first; j <= i; ++j)
+      sum += raw[j];
+    averages.push_back(sum / (i + 1 - first));
+
+    if (i < learningPeriod + estimationSamples) {
+      likelihoods.push_back(0.5);
+      continue;
+    }
+    if (!estimated || i % reestimationPeriod == 0) {
+      const size_t begin =
+          std::max<size_t>(learningPeriod, i > historicWindowSize
+                                               ? i - historicWindowSize
+                                               : 0);
+      Real64 m = 0, v = 0;
+      for (size_t j = begin; j < i; ++j)
+        m += averages[j];
+      m /= i - begin;
+      for (size_t j = begin; j < i; ++j)
+        v += (averages[j] - m) * (averages[j] - m);
+      v /= i - begin;
+      mean = std::max(m, 0.03);
+      stdev = std::sqrt(std::max(v, 0.0003));
+      estimated = true;
+      previousTail = tail(averages[i - 1]);
+    }
+    const Real64 t = tail(averages[i]);
+    const bool repeated = t <= 1e-5 && previousTail <= 1e-5;
+    likelihoods.push_back(1.0 - (repeated ? 1e-3 : t));
+    previousTail = t;
+  }
+  return likelihoods;
+}
+
+} // namespace
+
+TEST(AnomalyLikelihood, TailProbability) {
+  ASSERT_DOUBLE_EQ(0.5, AnomalyLikelihood::tailProbability(0.3, 0.3, 0.1));
+  // One and two standard deviations, on both sides
+  ASSERT_NEAR(0.158655254, AnomalyLikelihood::tailProbability(0.4, 0.3, 0.1),
+              1e-9);
+  ASSERT_NEAR(0.158655254, AnomalyLikelihood::tailProbability(0.2, 0.3, 0.1),
+              1e-9);
+  ASSERT_NEAR(0.022750132, AnomalyLikelihood::tailProbability(0.7, 0.3, 0.2),
+              1e-9);
+}
+
+TEST(AnomalyLikelihood, ProbationaryPeriod) {
+  AnomalyLikelihood likelihood(10, 20);
+  ASSERT_EQ(30u, likelihood.getProbationaryPeriod());
+  for (UInt i = 0; i < 30; ++i)
+    ASSERT_DOUBLE_EQ(0.5, likelihood.anomalyProbability(i % 2 ? 0.0 : 1.0));
+  ASSERT_EQ(30u, likelihood.getIteration());
+  ASSERT_NE(0.5, likelihood.anomalyProbability(0.0));
+}
+
+TEST(AnomalyLikelihood, MatchesReference) {
+  Random rng(42);
+  std::vector<Real64> raw = noisyScores(rng, 2000);
+  // A burst of anomalies, which leaves the window later on
+  for (size_t i = 700; i < 720; ++i)
+    raw[i] = 1.0;
+
+  const UInt learningPeriod = 50, estimationSamples = 30, window = 300,
+             reestimationPeriod = 7, averagingWindow = 5;
+  const std::vector<Real64> expected =
+      referenceLikelihoods(raw, learningPeriod, estimationSamples, window,
+                           reestimationPeriod, averagingWindow);
+
+  AnomalyLikelihood likelihood(learningPeriod, estimationSamples, window,
+                               reestimationPeriod, averagingWindow);
+  for (size_t i = 0; i < raw.size(); ++i)
+    ASSERT_NEAR(expected[i], likelihood.anomalyProbability(raw[i]), 1e-9)
+        << "record " << i;
+}
+
+TEST(AnomalyLikelihood, FiltersConsecutiveAnomalies) {
+  std::vector<Real64> raw(80);
+  for (size_t i = 0; i < raw.size(); ++i)
+    raw[i] = 0.005 * ((i * 7) % 11);
+  for (size_t i = 40; i < 46; ++i)
+    raw[i] = 1.0;
+  for (size_t i = 70; i < 73; ++i)
+    raw[i] = 1.0;
+
+  // Likelihoods of records 36 to 79 given by the Python AnomalyLikelihood,
+  // whose tail probability divides by 1.4142 rather than sqrt(2). Record 45
+  // starts a new estimate, under which the previous record is no longer in
+  // the red zone.
+  const Real64 expected[] = {
+      0.624585213, 0.580070771, 0.656948446, 0.613586063,
+      0.999999976, 0.999000000, 0.999000000, 0.999000000,
+      0.999000000, 0.999998870, 0.999000000, 0.999000000,
+      0.999000000, 0.999000000, 0.964648786, 0.910439143,
+      0.807857469, 0.660286620, 0.521155317, 0.733114459,
+      0.729996933, 0.735440610, 0.732336785, 0.729214714,
+      0.720580445, 0.717281571, 0.713964097, 0.719757482,
+      0.716453938, 0.700983645, 0.707096052, 0.703610341,
+      0.709697783, 0.706226410, 0.501231120, 0.691880101,
+      0.843684954, 0.846171362, 0.841802872, 0.834490988,
+      0.837110328, 0.832508703, 0.835148363, 0.830511187,
+  };
+
+  AnomalyLikelihood likelihood(10, 20, 1000, 5, 10);
+  for (size_t i = 0; i < raw.size(); ++i) {
+    const Real64 actual = likelihood.anomalyProbability(raw[i]);
+    if (i >= 36) {
+      ASSERT_NEAR(expected[i - 36], actual, 1e-5) << "record " << i;
+    }
+  }
+}
+
+TEST(AnomalyLikelihood, DetectsAnomaly) {
+  Random rng(1);
+  AnomalyLikelihood likelihood;
+  UInt nHigh = 0;
+  for (Real64 score : noisyScores(rng, 1000))
+    if (likelihood.anomalyProbability(score) > 0.99)
+      ++nHigh;
+  ASSERT_LT(nHigh, 20u);
+  EXPECT_NEAR(0.1, likelihood.getMean(), 0.01);
+
+  Real64 maxLikelihood = 0;
+  for (UInt i = 0; i < 5; ++i)
+    maxLikelihood = std::max(maxLikelihood, likelihood.anomalyProbability(1.0));
+  ASSERT_GT(maxLikelihood, 0.9999);
+}
+
+TEST(AnomalyLikelihood, Batch) {
+  const UInt nStreams = 3000, nRecords = 150;
+  std::vector<AnomalyLikelihood> serial, batch;
+  for (UInt s = 0; s < nStreams; ++s) {
+    serial.emplace_back(20, 30, 100, 10, 5);
+    batch.emplace_back(20, 30, 100, 10, 5);
+  }
+
+  Random rng(7);
+  std::vector<Real64> raw(nStreams), likelihoods(nStreams);
+  for (UInt r = 0; r < nRecords; ++r) {
+    for (auto &score : raw)
+      score = rng.getReal64();
+    AnomalyLikelihood::anomalyProbabilities(batch, raw.data(),
+                                            likelihoods.data());
+    for (UInt s = 0; s < nStreams; ++s)
+      ASSERT_EQ(serial[s].anomalyProbability(raw[s]), likelihoods[s]);
+  }
+  ASSERT_TRUE(serial == batch);
+}
+
+TEST(AnomalyLikelihood, Serialization) {
+  Random rng(3);
+  const std::vector<Real64> raw = noisyScores(rng, 600);
+  AnomalyLikelihood likelihood(50, 50, 200, 10, 4);
+  for (size_t i = 0; i < 400; ++i)
+    likelihood.anomalyProbability(raw[i]);
+
+  std::stringstream ss;
+  likelihood.write(ss);
+  AnomalyLikelihood restored;
+  restored.read(ss);
+  ASSERT_TRUE(likelihood == restored);
+
+  for (size_t i = 400; i < raw.size(); ++i)
+    ASSERT_EQ(likelihood.anomalyProbability(raw[i]),
+              restored.anomalyProbability(raw[i]));
+}
@@ -21,12 +21,15 @@
  */
 
 #include <algorithm>
+#include <sstream>
 #include <vector>
 
 #include "gtest/gtest.h"
 
 #include "nupic/algorithms/Anomaly.hpp"
+#include "nupic/math/ArrayAlgo.hpp"
 #include "nupic/types/Types.hpp"
+#include "nupic/utils/Random.hpp"
 
 using namespace nupic::algorithms::anomaly;
 using namespace nupic;
@@ -61,6 +64,71 @@ TEST(ComputeRawAnomalyScore, PartialMatch) {
   ASSERT_FLOAT_EQ(computeRawAnomalyScore(active, predicted), 2.0 / 3.0);
 };
 
+TEST(ComputeRawAnomalyScore, Packed) {
+  std::vector<UInt> active = {2, 3, 6, 600};
+  std::vector<UInt> predicted = {3, 5, 7, 600};
+  PackedSDR a(1024, active.begin(), active.end());
+  PackedSDR p(1024, predicted.begin(), predicted.end());
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(active, predicted), 0.5);
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(a, p), 0.5);
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(PackedSDR(1024), p), 0.0);
+};
+
+TEST(ComputeRawAnomalyScore, Unsorted) {
+  // Scored through the bitset, duplicates counting once
+  std::vector<UInt> active = {600, 3, 6, 2};
+  std::vector<UInt> predicted = {7, 3, 3, 5, 600, 900};
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(active, predicted), 0.5);
+  // The bitset is left clear for the next call
+  std::vector<UInt> none = {1, 4};
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(none, predicted), 1.0);
+  std::sort(active.begin(), active.end());
+  std::sort(predicted.begin(), predicted.end());
+  ASSERT_FLOAT_EQ(computeRawAnomalyScore(active, predicted), 0.5);
+};
+
+TEST(ComputeRawAnomalyScore, Batch) {
+  Random rng(5);
+  const UInt n = 1000;
+  std::vector<std::vector<UInt>> active(n), predicted(n);
+  std::vector<PackedSDR> packedActive, packedPredicted;
+  for (UInt i = 0; i < n; ++i) {
+    for (UInt j = 0; j < 40; ++j) {
+      active[i].push_back(rng.getUInt32(2048));
+      predicted[i].push_back(rng.getUInt32(2048));
+    }
+    packedActive.emplace_back(2048, active[i].begin(), active[i].end());
+    packedPredicted.emplace_back(2048, predicted[i].begin(),
+                                 predicted[i].end());
+    // Half of the pairs take the sorted path
+    if (i % 2) {
+      std::sort(active[i].begin(), active[i].end());
+      active[i].erase(std::unique(active[i].begin(), active[i].end()),
+                      active[i].end());
+      std::sort(predicted[i].begin(), predicted[i].end());
+      predicted[i].erase(
+          std::unique(predicted[i].begin(), predicted[i].end()),
+          predicted[i].end());
+    }
+  }
+
+  std::vector<Real32> scores(n), packedScores(n);
+  computeRawAnomalyScores(active, predicted, scores.data());
+  computeRawAnomalyScores(packedActive, packedPredicted, packedScores.data());
+  for (UInt i = 0; i < n; ++i) {
+    std::vector<UInt> a = active[i];
+    std::sort(a.begin(), a.end());
+    a.erase(std::unique(a.begin(), a.end()), a.end());
+    // The packed SDRs have no duplicates
+    ASSERT_FLOAT_EQ(computeRawAnomalyScore(packedActive[i], packedPredicted[i]),
+                    packedScores[i]);
+    ASSERT_EQ(computeRawAnomalyScore(active[i], predicted[i]), scores[i]);
+    if (a.size() == active[i].size()) {
+      ASSERT_FLOAT_EQ(packedScores[i], scores[i]);
+    }
+  }
+};
+
 TEST(Anomaly, ComputeScoreNoActiveOrPredicted) {
   std::vector<UInt> active;
   std::vector<UInt> predicted;
@@ -114,9 +182,71 @@ TEST(Anomaly, Cumulative) {
   }
 }
 
+TEST(Anomaly, Batch) {
+  const UInt n = 300;
+  std::vector<Anomaly> serial, batch;
+  for (UInt i = 0; i < n; ++i) {
+    serial.emplace_back(3, AnomalyMode::PURE, 0.0f);
+    batch.emplace_back(3, AnomalyMode::PURE, 0.0f);
+  }
+
+  Random rng(11);
+  std::vector<std::vector<UInt>> active(n), predicted(n);
+  std::vector<Real32> scores(n);
+  for (UInt r = 0; r < 10; ++r) {
+    for (UInt i = 0; i < n; ++i) {
+      active[i] = {rng.getUInt32(8), 8 + rng.getUInt32(8)};
+      predicted[i] = {rng.getUInt32(8), 8 + rng.getUInt32(8)};
+    }
+    Anomaly::computeScores(batch, active, predicted, scores.data());
+    for (UInt i = 0; i < n; ++i)
+      ASSERT_EQ(serial[i].compute(active[i], predicted[i]), scores[i]);
+  }
+}
+
 TEST(Anomaly, SelectModePure) {
   Anomaly a{0, AnomalyMode::PURE, 0};
   std::vector<UInt> active = {2, 3, 6};
   std::vector<UInt> predicted = {3, 5, 7};
   ASSERT_FLOAT_EQ(a.compute(active, predicted), 2.0 / 3.0);
 };
+
+TEST(Anomaly, SelectModeLikelihood) {
+  std::vector<UInt> active = {2, 3, 6};
+  std::vector<UInt> predicted = {3, 5, 7};
+  Anomaly likelihood{0, AnomalyMode::LIKELIHOOD, 0};
+  Anomaly weighted{0, AnomalyMode::WEIGHTED, 0};
+  ASSERT_NE(nullptr, likelihood.getLikelihood());
+
+  // The likelihood is 0.5 during the probationary period
+  ASSERT_FLOAT_EQ(likelihood.compute(active, predicted), 0.5);
+  ASSERT_FLOAT_EQ(weighted.compute(active, predicted), 2.0 / 3.0 * 0.5);
+}
+
+TEST(Anomaly, Serialization) {
+  Anomaly anomaly{3, AnomalyMode::WEIGHTED, 0};
+  Random rng(5);
+  std::vector<std::vector<UInt>> actives;
+  for (UInt i = 0; i < 500; ++i) {
+    std::vector<UInt> active;
+    for (UInt j = 0; j < 10; ++j)
+      active.push_back(rng.getUInt32(40));
+    std::sort(active.begin(), active.end());
+    active.erase(std::unique(active.begin(), active.end()), active.end());
+    actives.push_back(active);
+  }
+  const std::vector<UInt> predicted = {1, 3, 5, 7, 9, 11, 13, 15, 17, 19};
+  for (UInt i = 0; i < 450; ++i)
+    anomaly.compute(actives[i], predicted);
+
+  std::stringstream ss;
+  anomaly.write(ss);
+  Anomaly restored;
+  restored.read(ss);
+  ASSERT_EQ(AnomalyMode::WEIGHTED, restored.getMode());
+  ASSERT_TRUE(*anomaly.getLikelihood() == *restored.getLikelihood());
+
+  for (UInt i = 450; i < actives.size(); ++i)
+    ASSERT_NEAR(anomaly.compute(actives[i], predicted),
+                restored.compute(actives[i], predicted), 1e-6);
+}
@@ -0,0 +1,130 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+
+/** @file
+ * Stress test running independent algorithm instances in concurrent threads.
+ *
+ * The Python bindings release the GIL around the compute() calls, so several
+ * models can run at the same time in one process. Each instance must then
+ * only depend on its own state: a model computed in a thread, next to other
+ * models, must give exactly the results it gives when computed alone.
+ */
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/algorithms/Cells4.hpp>
+#include <nupic/algorithms/ClassifierResult.hpp>
+#include <nupic/algorithms/SDRClassifier.hpp>
+#include <nupic/algorithms/SpatialPooler.hpp>
+#include <nupic/algorithms/TemporalMemory.hpp>
+#include <nupic/types/Types.hpp>
+#include <nupic/utils/Random.hpp>
+
+using namespace std;
+using namespace nupic;
+using namespace nupic::algorithms::Cells4;
+using namespace nupic::algorithms::cla_classifier;
+using namespace nupic::algorithms::sdr_classifier;
+using namespace nupic::algorithms::spatial_pooler;
+using namespace nupic::algorithms::temporal_memory;
+
+namespace {
+
+const UInt nInputs = 200;
+const UInt nColumns = 128;
+const UInt nSteps = 60;
+
+/**
+ * Runs a SpatialPooler -> TemporalMemory -> SDRClassifier pipeline, and a
+ * Cells4 fed by the SpatialPooler, on a repeating input sequence derived
+ * from seed. Returns everything the instances computed, flattened.
+ */
+vector<Real64> runModel(UInt seed) {
+  SpatialPooler sp({nInputs}, {nColumns});
+  TemporalMemory tm({nColumns}, 8, 8, 0.21, 0.5, 6, 12);
+  Cells4 cells4(nColumns, 4, 3, 2, 5, 1, 0.5, 0.8, 1, 0.1, 0.1, 0, false, 42,
+                true, false);
+  SDRClassifier classifier({1}, 0.1, 0.3, 0);
+
+  Random rng(seed);
+  vector<vector<UInt>> sequence(6, vector<UInt>(nInputs, 0));
+  for (auto &input : sequence)
+    for (UInt i = 0; i < nInputs; ++i)
+      input[i] = rng.getReal64() < 0.1 ? 1 : 0;
+
+  vector<Real64> trace;
+  vector<UInt> active(nColumns);
+  vector<Real> cells4Input(nColumns), cells4Output(nColumns * 4);
+
+  for (UInt step = 0; step < nSteps; ++step) {
+    const UInt pattern = step % sequence.size();
+    sp.compute(&sequence[pattern][0], true, &active[0]);
+
+    vector<UInt> activeColumns;
+    for (UInt c = 0; c < nColumns; ++c) {
+      if (active[c])
+        activeColumns.push_back(c);
+      cells4Input[c] = (Real)active[c];
+    }
+    tm.compute(activeColumns.size(), activeColumns.data(), true);
+    cells4.compute(&cells4Input[0], &cells4Output[0], true, true);
+
+    const vector<UInt> activeCells = tm.getActiveCells();
+    ClassifierResult result;
+    classifier.compute(step, activeCells, {pattern}, {(Real64)pattern}, false,
+                       true, true, &result);
+
+    trace.insert(trace.end(), activeColumns.begin(), activeColumns.end());
+    trace.insert(trace.end(), activeCells.begin(), activeCells.end());
+    trace.insert(trace.end(), cells4Output.begin(), cells4Output.end());
+    for (auto it = result.begin(); it != result.end(); ++it)
+      trace.insert(trace.end(), it->second->begin(), it->second->end());
+  }
+  return trace;
+}
+
+TEST(ConcurrencyTest, IndependentModelsMatchSerialRuns) {
+  const UInt nThreads = 8;
+
+  vector<vector<Real64>> expected(nThreads);
+  for (UInt t = 0; t < nThreads; ++t)
+    expected[t] = runModel(t + 1);
+
+  for (UInt round = 0; round < 4; ++round) {
+    vector<vector<Real64>> actual(nThreads);
+    vector<thread> threads;
+    for (UInt t = 0; t < nThreads; ++t)
+      threads.push_back(
+          thread([&actual, t]() { actual[t] = runModel(t + 1); }));
+    for (auto &th : threads)
+      th.join();
+
+    for (UInt t = 0; t < nThreads; ++t)
+      ASSERT_EQ(expected[t], actual[t]) << "model " << t << ", round " << round;
+  }
+}
+
+} // namespace
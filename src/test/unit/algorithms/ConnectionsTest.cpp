@@ -28,6 +28,7 @@
 #include <fstream>
 #include <iostream>
 #include <nupic/algorithms/Connections.hpp>
+#include <nupic/types/Exception.hpp>
 
 using namespace std;
 using namespace nupic;
@@ -434,11 +435,55 @@ TEST(ConnectionsTest, subscribe) {
 TEST(ConnectionsTest, unsubscribe) {
   Connections connections(1024);
   TestConnectionsEventHandler *handler = new TestConnectionsEventHandler();
+  EXPECT_FALSE(connections.hasSubscribers());
   auto token = connections.subscribe(handler);
+  EXPECT_TRUE(connections.hasSubscribers());
 
   TEST_EVENT_HANDLER_DESTRUCTED = false;
   connections.unsubscribe(token);
   EXPECT_TRUE(TEST_EVENT_HANDLER_DESTRUCTED);
+  EXPECT_FALSE(connections.hasSubscribers());
+}
+
+class CountingEventHandler : public ConnectionsEventHandler {
+public:
+  CountingEventHandler(UInt &segments, UInt &synapses)
+      : segments(segments), synapses(synapses) {}
+
+  virtual void onCreateSegment(Segment segment) { ++segments; }
+
+  virtual void onCreateSynapse(Synapse synapse) { ++synapses; }
+
+  UInt &segments;
+  UInt &synapses;
+};
+
+/**
+ * Make sure that loading notifies the event handlers of every segment and
+ * synapse it creates, with both serialization formats.
+ */
+TEST(ConnectionsTest, LoadNotifiesSubscribers) {
+  Connections c1(1024);
+  setupSampleConnections(c1);
+
+  for (bool capnp : {false, true}) {
+    Connections c2;
+    UInt segments = 0, synapses = 0;
+    auto token = c2.subscribe(new CountingEventHandler(segments, synapses));
+
+    stringstream ss;
+    if (capnp) {
+      c1.write(ss);
+      c2.read(ss);
+    } else {
+      c1.save(ss);
+      c2.load(ss);
+    }
+
+    EXPECT_EQ(c1.numSegments(), segments) << capnp;
+    EXPECT_EQ(c1.numSynapses(), synapses) << capnp;
+    c2.unsubscribe(token);
+  }
 }
 
 /**
@@ -513,4 +558,154 @@ TEST(ConnectionsTest, testSaveLoad) {
   ASSERT_EQ(c1, c2);
 }
 
+/**
+ * Fills a cell and a segment up to the limits, and makes sure that creating
+ * more throws.
+ */
+TEST(ConnectionsTest, Limits) {
+  Connections connections(16, 3, 5);
+  EXPECT_EQ(3, connections.maxSegmentsPerCell());
+  EXPECT_EQ(5, connections.maxSynapsesPerSegment());
+
+  for (int i = 0; i < 3; i++) {
+    connections.createSegment(7);
+  }
+  EXPECT_THROW(connections.createSegment(7), nupic::Exception);
+  connections.destroySegment(connections.getSegment(7, 1));
+  const Segment segment = connections.createSegment(7);
+
+  for (CellIdx cell = 0; cell < 5; cell++) {
+    connections.createSynapse(segment, cell, 0.5);
+  }
+  EXPECT_THROW(connections.createSynapse(segment, 5, 0.5), nupic::Exception);
+  EXPECT_EQ(5, connections.numSynapses(segment));
+}
+
+/**
+ * The list of synapses of a segment follows the synapses destroyed while
+ * iterating over it.
+ */
+TEST(ConnectionsTest, ListsFollowDestroys) {
+  Connections connections(1024);
+  const Segment segment = connections.createSegment(10);
+  for (CellIdx cell = 0; cell < 20; cell++) {
+    connections.createSynapse(segment, cell, 0.1f + 0.01f * cell);
+  }
+
+  const SynapseList synapses = connections.synapsesForSegment(segment);
+  for (SynapseIdx i = 0; i < synapses.size();) {
+    const Synapse synapse = synapses[i];
+    if (connections.dataForSynapse(synapse).presynapticCell % 3 == 0) {
+      connections.destroySynapse(synapse);
+    } else {
+      i++;
+    }
+  }
+
+  ASSERT_EQ(13, synapses.size());
+  for (Synapse synapse : synapses) {
+    EXPECT_NE(0, connections.dataForSynapse(synapse).presynapticCell % 3);
+  }
+}
+
+/**
+ * Compacts connections after destroying segments and synapses, and makes
+ * sure that nothing else changed.
+ */
+TEST(ConnectionsTest, Compact) {
+  Connections connections(1024);
+  setupSampleConnections(connections);
+  for (CellIdx cell = 100; cell < 140; cell++) {
+    const Segment segment = connections.createSegment(cell);
+    for (CellIdx presynapticCell = 0; presynapticCell < cell % 30;
+         presynapticCell++) {
+      connections.createSynapse(segment, presynapticCell, 0.5);
+    }
+    if (cell % 4 == 0) {
+      connections.destroySegment(segment);
+    }
+  }
+
+  const Segment segment = connections.getSegment(101, 0);
+  const Synapse synapse = connections.synapsesForSegment(segment)[3];
+  vector<Segment> segments = connections.segmentsForCell(20);
+  vector<Synapse> synapses = connections.synapsesForPresynapticCell(2);
+
+  stringstream ss;
+  connections.save(ss);
+  Connections copy;
+  copy.load(ss);
+
+  connections.compact();
+
+  EXPECT_EQ(copy, connections);
+  EXPECT_EQ(segment, connections.getSegment(101, 0));
+  EXPECT_EQ(synapse, connections.synapsesForSegment(segment)[3]);
+  EXPECT_EQ(segments, vector<Segment>(connections.segmentsForCell(20)));
+  EXPECT_EQ(synapses, connections.synapsesForPresynapticCell(2));
+
+  // Compacted connections keep learning
+  connections.destroySegment(segment);
+  connections.createSynapse(connections.createSegment(101), 5, 0.5);
+  copy.destroySegment(copy.getSegment(101, 0));
+  copy.createSynapse(copy.createSegment(101), 5, 0.5);
+  EXPECT_EQ(copy, connections);
+}
+
+/**
+ * Grows, shrinks and compacts lists of a ListPool.
+ */
+TEST(ConnectionsTest, ListPool) {
+  ListPool<UInt32> pool(100);
+  vector<ListPool<UInt32>::List> lists(10);
+  for (UInt32 i = 0; i < 10; i++) {
+    for (UInt32 j = 0; j < 10 * i; j++) {
+      pool.push_back(lists[i], 1000 * i + j);
+    }
+  }
+  EXPECT_EQ(64, lists[5].capacity);
+  EXPECT_EQ(100, lists[9].capacity);
+
+  ListPool<UInt32>::List full;
+  for (UInt32 j = 0; j < 100; j++) {
+    pool.push_back(full, j);
+  }
+  EXPECT_THROW(pool.push_back(full, 100), nupic::Exception);
+  pool.clear(full);
+
+  // Blocks freed by the growing lists are reused
+  const size_t storageSize = pool.storageSize();
+  ListPool<UInt32>::List list;
+  for (UInt32 j = 0; j < 8; j++) {
+    pool.push_back(list, j);
+  }
+  EXPECT_EQ(storageSize, pool.storageSize());
+
+  for (UInt32 j = 0; j < 20; j++) {
+    pool.erase(lists[4], 10);
+  }
+  pool.clear(lists[6]);
+  pool.clear(list);
+
+  vector<ListPool<UInt32>::List *> listPointers;
+  for (auto &list : lists) {
+    listPointers.push_back(&list);
+  }
+  pool.compact(listPointers);
+  EXPECT_EQ(0 + 16 + 32 + 32 + 32 + 64 + 0 + 100 + 100 + 100,
+            pool.storageSize());
+
+  for (UInt32 i = 0; i < 10; i++) {
+    vector<UInt32> expected;
+    if (i != 6) {
+      for (UInt32 j = 0; j < 10 * i; j++) {
+        if (i != 4 || j < 10 || j >= 30) {
+          expected.push_back(1000 * i + j);
+        }
+      }
+    }
+    EXPECT_EQ(expected, vector<UInt32>(pool.view(lists[i])));
+  }
+}
+
 } // namespace
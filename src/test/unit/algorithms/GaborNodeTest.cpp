@@ -0,0 +1,250 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Tests of gaborCompute against the outputs of the scalar implementation
+ * it replaced, which had separate convolution loops for the plain,
+ * bounding box and alpha mask cases. The golden values are hashes of the
+ * bits of the outputs that implementation returned, so any difference in
+ * the responses or in the normalization statistics shows up.
+ */
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/algorithms/GaborNode.hpp>
+#include <nupic/math/Simd.hpp>
+
+using namespace nupic;
+using namespace nupic::simd;
+
+namespace {
+
+// A numpy array as GaborNode sees it: dimensions and byte strides are
+// npy_intp, whatever the declared type of NUMPY_ARRAY.
+template <typename T> struct Array {
+  std::vector<long> dims;
+  std::vector<long> strides;
+  std::vector<T> data;
+  NUMPY_ARRAY numpy;
+
+  explicit Array(std::vector<long> shape) : dims(shape), strides(shape) {
+    long size = sizeof(T);
+    for (size_t k = dims.size(); k-- > 0;) {
+      strides[k] = size;
+      size *= dims[k];
+    }
+    data.assign(size / sizeof(T), T());
+    numpy.nNumDims = (int)dims.size();
+    numpy.pnDimensions = (const int *)dims.data();
+    numpy.pnStrides = (const int *)strides.data();
+    numpy.pData = (const char *)data.data();
+  }
+};
+
+long align4(long n) { return (n + 3) & ~3L; }
+
+struct Config {
+  int filterDim;
+  EDGE_MODE edgeMode;
+  PHASE_MODE phaseMode;
+  bool alpha;
+  bool bbox;
+  POSTPROC_METHOD postProcMethod;
+  NORMALIZE_METHOD normalizeMethod;
+  NORMALIZE_MODE normalizeMode;
+  PHASENORM_MODE phaseNormMode;
+};
+
+// Every combination of the convolution paths, with the normalization
+// settings spread over them.
+std::vector<Config> configs() {
+  const NORMALIZE_METHOD methods[] = {NORMALIZE_METHOD_FIXED,
+                                      NORMALIZE_METHOD_MAX,
+                                      NORMALIZE_METHOD_MEAN};
+  std::vector<Config> configs;
+  for (int filterDim : {5, 7, 13})
+    for (EDGE_MODE edgeMode : {EDGE_MODE_CONSTRAINED, EDGE_MODE_SWEEPOFF})
+      for (PHASE_MODE phaseMode : {PHASE_MODE_SINGLE, PHASE_MODE_DUAL})
+        for (bool alpha : {false, true})
+          for (bool bbox : {false, true})
+            for (POSTPROC_METHOD postProcMethod :
+                 {POSTPROC_METHOD_RAW, POSTPROC_METHOD_SIGMOID,
+                  POSTPROC_METHOD_THRESHOLD}) {
+              const int n = (int)configs.size() / 3;
+              const int k = (n * 5 + postProcMethod) % 12;
+              configs.push_back({filterDim, edgeMode, phaseMode, alpha, bbox,
+                                 postProcMethod, methods[k % 3],
+                                 (NORMALIZE_MODE)(k / 3 % 2),
+                                 (PHASENORM_MODE)(k / 6)});
+            }
+  return configs;
+}
+
+// FNV-1a
+void hashBytes(UInt64 &hash, const void *data, size_t size) {
+  for (size_t i = 0; i != size; ++i) {
+    hash ^= ((const unsigned char *)data)[i];
+    hash *= 0x100000001b3ull;
+  }
+}
+
+// The hash of the return value and outputs of gaborCompute on a 23x29
+// image, which has rows of no multiple of four pixels.
+UInt64 compute(const Config &config) {
+  const long rows = 23, cols = 29, numFilters = 4, numLutBins = 4096;
+  const long dim = config.filterDim;
+  std::mt19937 rng(config.filterDim);
+
+  Array<int> bank({numFilters, dim, dim});
+  for (int &v : bank.data)
+    v = (int)(rng() % 2049) - 1024;
+
+  Array<float> input({rows, cols});
+  for (float &v : input.data)
+    v = (float)(rng() % 256);
+
+  Array<float> alpha({rows, cols});
+  for (long j = 0; j != rows; ++j)
+    for (long i = 0; i != cols; ++i)
+      alpha.data[j * cols + i] = (i / 3 + j / 4 + rng() % 4) % 5 ? 1.f : 0.f;
+
+  Array<int> bbox({4}), imageBox({4});
+  if (config.bbox) {
+    imageBox.data = {0, 0, (int)cols - 2, (int)rows - 1};
+    bbox.data = {5, 2, (int)cols - 5, (int)rows - 3};
+  } else {
+    imageBox.data = {0, 0, (int)cols, (int)rows};
+    bbox.data = imageBox.data;
+  }
+
+  const bool constrained = config.edgeMode == EDGE_MODE_CONSTRAINED;
+  const long outRows = constrained ? rows - dim + 1 : rows;
+  const long outCols = constrained ? cols - dim + 1 : cols;
+  const long numPlanes =
+      config.phaseMode == PHASE_MODE_DUAL ? 2 * numFilters : numFilters;
+  Array<float> output({numPlanes, outRows, outCols});
+  Array<int> bufferIn(constrained
+                          ? std::vector<long>{rows, align4(cols)}
+                          : std::vector<long>{rows + dim - 1,
+                                              align4(cols + dim - 1)});
+  Array<int> bufferOut({numFilters, outRows, align4(outCols)});
+
+  // The normalized responses are at most about 1.5, so with a scalar of 64
+  // they spread over the first hundred bins.
+  Array<float> lut({numLutBins});
+  for (long k = 0; k != numLutBins; ++k)
+    lut.data[k] = config.postProcMethod == POSTPROC_METHOD_SIGMOID
+                      ? (float)k / (float)(k + 16)
+                      : (k >= 8 ? 1.0f : 0.0f);
+
+  const int result = gaborCompute(
+      &bank.numpy, &input.numpy, config.alpha ? &alpha.numpy : nullptr,
+      &bbox.numpy, &imageBox.numpy, &output.numpy, 1.0f, config.edgeMode,
+      3.0f, config.phaseMode, config.normalizeMethod, config.normalizeMode,
+      config.phaseNormMode, config.postProcMethod, 0.5f, 0.5f, 0.0f, 1.0f,
+      &bufferIn.numpy, &bufferOut.numpy, &lut.numpy, 64.0f);
+
+  UInt64 hash = 0xcbf29ce484222325ull;
+  hashBytes(hash, &result, sizeof(result));
+  hashBytes(hash, output.data.data(), output.data.size() * sizeof(float));
+  return hash;
+}
+
+const UInt64 expected[] = {
+    0xdd743574a105c59dull, 0x202d83fc3dcfb299ull, 0x24d8f4325c8d1795ull,
+    0xbe0124b8941e2396ull, 0x9d223e9858279cc2ull, 0x337d587907413b75ull,
+    0x1ed86961c8935e0bull, 0xa192c47aca1dd1b5ull, 0xc06ea4e2066a05b5ull,
+    0x1fb219ec2c883162ull, 0x206afd4b137a0cc3ull, 0xa192c47aca1dd1b5ull,
+    0x282425ad19aca0d9ull, 0x9b8200fb47dcd0aeull, 0x9651736c9d5945d8ull,
+    0x740a68177d2f4366ull, 0x9047be5e31c8c9f5ull, 0xda385bc8be2e21a5ull,
+    0x5ad564e84755e36dull, 0x5a19e6d91d61865eull, 0x3548ef4006ecf118ull,
+    0x51d140a2956e5246ull, 0x8b821a7337130a27ull, 0x2809c3533edd54a5ull,
+    0xc1453d001a3ac7a7ull, 0x9b87006769dc1f1dull, 0xe500b4073ef15fd5ull,
+    0xb6840f677ceb0dc4ull, 0x82b5102b8b6a4103ull, 0x346550555132eeb8ull,
+    0xb88d4d7db2f87d72ull, 0x6aca3adfee47b545ull, 0xd04a5bb555124ea8ull,
+    0xd39c2e44604ac81bull, 0x505ff0084e20dddfull, 0xcb1ec607db075845ull,
+    0x60624d99e194d7bfull, 0x06ba2f5951d7b1bbull, 0x6ef24f0c61508b08ull,
+    0xaed6305e6b7e446dull, 0xc4ad0473397f1376ull, 0x85fd7562d0673195ull,
+    0xbc32d97d1892da95ull, 0xd4945ad7b8283f75ull, 0xebd90d229cf91f78ull,
+    0x8ffdb20a150533caull, 0xbf2dcca28bc748e3ull, 0xd4945ad7b8283f75ull,
+    0xf175c48effe57c77ull, 0x17ce492b487938a4ull, 0x2baf8cfff31186c5ull,
+    0x290ebe591815e27eull, 0xdf1e3aee7ce13e73ull, 0xe8129c708e4caa68ull,
+    0x8e6c4e09baf84590ull, 0xebb6395b45f2fb31ull, 0xc48dacfd162d19e5ull,
+    0x29be2998c97a5a0aull, 0x478b1b8d9211ca91ull, 0x2d27b1c8fc85a768ull,
+    0x3032f14fca07c2e7ull, 0xda6a867955198c96ull, 0x7a8bf38e0e445758ull,
+    0xc56c7a4deae50592ull, 0x250a1338c099069eull, 0xf98d0499d4bbbda5ull,
+    0x607aa174fda2ab20ull, 0x1e644e51aa7a47d7ull, 0x3786f8d5523221a5ull,
+    0x74ec8a22621034f8ull, 0xa7a6e181ac8ea7feull, 0x49c103e2f92c1a68ull,
+    0x44c6cb3f49b9dcb3ull, 0x025a1509f8d233a8ull, 0x89cea37ee0db1788ull,
+    0x54bafe6511de4412ull, 0xe63ae61540ffd460ull, 0x64b61774b92eeef8ull,
+    0x5db16ab81a8b1491ull, 0xef89124395abc1b5ull, 0x1c5c5368d3268248ull,
+    0x2d9f0e67af30c425ull, 0xc79d09c7e2eb8f3bull, 0xef89124395abc1b5ull,
+    0x798e636fa19d9fe4ull, 0xdddd8b187d0c2be9ull, 0x2387a5862426ecd8ull,
+    0x794ef142458d4674ull, 0xc4f7d1b6f01a7ed8ull, 0xf10d2610f8c92515ull,
+    0x0e20acc0a5742dc4ull, 0x13b0ca9323f8ce7aull, 0xb051c3466661d405ull,
+    0x97600035a51bc44cull, 0xc5426de461274baeull, 0x29fa968db5513b28ull,
+    0x00ece90c8f44d3feull, 0x1daa4edc763e02a7ull, 0x24e3c4a6281b4515ull,
+    0xbe0d8c3b544c79beull, 0xdf18b5f5cbe4a259ull, 0x4d72eaf804700dc8ull,
+    0x8fc7dcd25f562609ull, 0x3e7a2480ec664491ull, 0x0ace5a8072310ad8ull,
+    0x764c2ff4425567a7ull, 0xad048a7f369d690cull, 0x5d59c4c38fc67cb8ull,
+    0x71799722ee5589c9ull, 0x0a78c12a2295d061ull, 0x5467ff5ab5bf85e5ull,
+    0xeee61a762b5dc564ull, 0xe3f4a3d9001e9218ull, 0x9a4cf365ab1b3ff8ull,
+    0xea9e54eaab709ecbull, 0xddd2f092e17e8f75ull, 0xf093b3d78f749335ull,
+    0x3ca9fdf3ea3bd8a9ull, 0x5a244d1189e25326ull, 0xddd2f092e17e8f75ull,
+    0xe86badf1fd6e78a9ull, 0x9d4c9545ba044e4aull, 0x21148e40003ffbf5ull,
+    0x941009f67dd10eedull, 0x963a1d8fd3b8f873ull, 0xec6e0b0700e0d7c5ull,
+    0xfee8a5744ab701a3ull, 0xe025a39cdc802266ull, 0xcf89f852babafff5ull,
+    0x17832f322688810full, 0xfd647b5ea2a4c4b1ull, 0x6f9d212b16510f85ull,
+    0x48b224e009c416deull, 0x6a064406d1f2dd80ull, 0x14cbf79fcc742ca8ull,
+    0xcd78cd7d737f6a22ull, 0x0ddc6b77cfc0cb97ull, 0x5a2c0ded238f0e88ull,
+    0xa8537239fe122d06ull, 0x1c5b4cebbe4ed6c0ull, 0x637f5930e51d0b75ull,
+    0xefb782ee2eb8cdbeull, 0x95218adb14350f1cull, 0x3b56d8e085497928ull,
+};
+
+} // namespace
+
+TEST(GaborNodeTest, MatchesScalarImplementation) {
+  const std::vector<Config> all = configs();
+  ASSERT_EQ(sizeof(expected) / sizeof(expected[0]), all.size());
+
+  const Isa saved = getIsa();
+  for (Isa isa : {Isa::SCALAR, Isa::SSE42, Isa::AVX2, Isa::AVX512}) {
+    if (!isSupported(isa))
+      continue;
+    setIsa(isa);
+    for (size_t i = 0; i != all.size(); ++i) {
+      const Config &c = all[i];
+      EXPECT_EQ(expected[i], compute(c))
+          << getIsaName(isa) << " config " << i << ": filterDim "
+          << c.filterDim << ", edgeMode " << c.edgeMode << ", phaseMode "
+          << c.phaseMode << ", alpha " << c.alpha << ", bbox " << c.bbox
+          << ", postProcMethod " << c.postProcMethod << ", normalizeMethod "
+          << c.normalizeMethod << ", normalizeMode " << c.normalizeMode
+          << ", phaseNormMode " << c.phaseNormMode;
+    }
+  }
+  setIsa(saved);
+}
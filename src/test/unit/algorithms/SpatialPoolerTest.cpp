@@ -31,8 +31,10 @@
 #include "gtest/gtest.h"
 #include <nupic/algorithms/SpatialPooler.hpp>
 #include <nupic/math/StlIo.hpp>
+#include <nupic/types/Exception.hpp>
 #include <nupic/types/Types.hpp>
 #include <nupic/utils/Log.hpp>
+#include <nupic/utils/Random.hpp>
 
 using namespace std;
 using namespace nupic;
@@ -1019,6 +1021,58 @@ TEST(SpatialPoolerTest, testUpdateBoostFactors) {
   ASSERT_TRUE(check_vector_eq(trueBoostFactors3, resultBoostFactors3));
 }
 
+TEST(SpatialPoolerTest, testUpdateDutyCyclesAndBoostFactors) {
+  // The fused update gives the bits of the separate updates, over several
+  // blocks of columns, one of which was never active
+  const UInt numColumns = 1000;
+  for (bool globalInhibition : {true, false}) {
+    for (Real boostStrength : {0.0f, 3.0f}) {
+      SpatialPooler sp1, sp2;
+      setup(sp1, 10, numColumns);
+      setup(sp2, 10, numColumns);
+
+      Random rng(7);
+      vector<Real> overlapDutyCycles(numColumns), activeDutyCycles(numColumns);
+      vector<UInt> overlaps(numColumns), activeArray(numColumns, 0);
+      vector<UInt> activeColumns;
+      for (UInt i = 0; i < numColumns; i++) {
+        if (i >= 300) {
+          overlapDutyCycles[i] = (Real)rng.getReal64();
+          activeDutyCycles[i] = (Real)rng.getReal64() / 10;
+        }
+        overlaps[i] = i >= 300 ? rng.getUInt32(3) : 0;
+        if (i >= 200 && rng.getUInt32(20) == 0) {
+          activeArray[i] = 1;
+          activeColumns.push_back(i);
+        }
+      }
+
+      for (SpatialPooler *sp : {&sp1, &sp2}) {
+        sp->setGlobalInhibition(globalInhibition);
+        sp->setBoostStrength(boostStrength);
+        sp->setIterationNum(20);
+        sp->setOverlapDutyCycles(overlapDutyCycles.data());
+        sp->setActiveDutyCycles(activeDutyCycles.data());
+      }
+
+      sp1.updateDutyCycles_(overlaps, activeArray.data());
+      sp1.updateBoostFactors_();
+      sp2.updateDutyCyclesAndBoostFactors_(overlaps, activeColumns);
+
+      vector<Real> values1(numColumns), values2(numColumns);
+      sp1.getOverlapDutyCycles(values1.data());
+      sp2.getOverlapDutyCycles(values2.data());
+      ASSERT_EQ(values1, values2);
+      sp1.getActiveDutyCycles(values1.data());
+      sp2.getActiveDutyCycles(values2.data());
+      ASSERT_EQ(values1, values2);
+      sp1.getBoostFactors(values1.data());
+      sp2.getBoostFactors(values2.data());
+      ASSERT_EQ(values1, values2);
+    }
+  }
+}
+
 TEST(SpatialPoolerTest, testUpdateBookeepingVars) {
   SpatialPooler sp;
   sp.setIterationNum(5);
@@ -2159,4 +2213,148 @@ TEST(SpatialPoolerTest, testConstructorVsInitialize) {
   check_spatial_eq(sp1, sp2);
 }
 
+TEST(SpatialPoolerTest, testComputeSparse) {
+  // The sparse compute follows the dense compute exactly, also when both are
+  // mixed. The duty cycles are high enough for weak columns to be bumped up.
+  for (bool globalInhibition : {true, false}) {
+    SpatialPooler sp1, sp2;
+    for (SpatialPooler *sp : {&sp1, &sp2}) {
+      sp->initialize(
+          /*inputDimensions*/ {20, 25},
+          /*columnDimensions*/ {16, 16},
+          /*potentialRadius*/ 5,
+          /*potentialPct*/ 0.5,
+          /*globalInhibition*/ globalInhibition,
+          /*localAreaDensity*/ -1.0,
+          /*numActiveColumnsPerInhArea*/ 10,
+          /*stimulusThreshold*/ 1,
+          /*synPermInactiveDec*/ 0.008,
+          /*synPermActiveInc*/ 0.05,
+          /*synPermConnected*/ 0.1,
+          /*minPctOverlapDutyCycles*/ 0.1,
+          /*dutyCyclePeriod*/ 50,
+          /*boostStrength*/ 2.0,
+          /*seed*/ 7);
+    }
+    const UInt numInputs = sp1.getNumInputs();
+    const UInt numColumns = sp1.getNumColumns();
+
+    Random rng(42);
+    vector<UInt> input(numInputs), output(numColumns);
+    vector<UInt> activeInputs, activeColumns, expected;
+    for (UInt iteration = 0; iteration < 120; iteration++) {
+      activeInputs.clear();
+      for (UInt i = 0; i < numInputs; i++) {
+        input[i] = rng.getUInt32(25) == 0 ? 1 : 0;
+        if (input[i]) {
+          activeInputs.push_back(i);
+        }
+      }
+      const bool learn = iteration % 10 != 9;
+
+      sp1.compute(input.data(), learn, output.data());
+      expected.clear();
+      for (UInt i = 0; i < numColumns; i++) {
+        if (output[i]) {
+          expected.push_back(i);
+        }
+      }
+
+      if (iteration % 4 == 3) {
+        sp2.compute(input.data(), learn, output.data());
+        activeColumns.clear();
+        for (UInt i = 0; i < numColumns; i++) {
+          if (output[i]) {
+            activeColumns.push_back(i);
+          }
+        }
+      } else {
+        sp2.compute(activeInputs, learn, activeColumns);
+      }
+      ASSERT_EQ(expected, activeColumns) << "iteration " << iteration;
+      ASSERT_EQ(sp1.getOverlaps(), sp2.getOverlaps());
+    }
+    ASSERT_NO_FATAL_FAILURE(check_spatial_eq(sp1, sp2));
+
+    for (UInt i = 0; i < numColumns; i++) {
+      output[i] = 1;
+    }
+    sp1.stripUnlearnedColumns(output.data());
+    activeColumns.resize(numColumns);
+    for (UInt i = 0; i < numColumns; i++) {
+      activeColumns[i] = i;
+    }
+    sp2.stripUnlearnedColumns(activeColumns);
+    ASSERT_EQ(countNonzero(output), activeColumns.size());
+    for (UInt column : activeColumns) {
+      ASSERT_EQ(1u, output[column]);
+    }
+  }
+
+  SpatialPooler sp;
+  setup(sp, 10, 20);
+  vector<UInt> activeColumns;
+  ASSERT_THROW(sp.compute(vector<UInt>{3, 2}, true, activeColumns),
+               nupic::Exception);
+  ASSERT_THROW(sp.compute(vector<UInt>{3, 3}, true, activeColumns),
+               nupic::Exception);
+  ASSERT_THROW(sp.compute(vector<UInt>{10}, true, activeColumns),
+               nupic::Exception);
+}
+
+// Folds the active columns and the bits of the boost factors of every step
+// into a hash, with the boost factors computed exactly.
+UInt64 hashExactBoosting(bool globalInhibition) {
+  SpatialPooler sp({64}, {128},
+                   /*potentialRadius*/ 16,
+                   /*potentialPct*/ 0.5,
+                   /*globalInhibition*/ globalInhibition,
+                   /*localAreaDensity*/ -1.0,
+                   /*numActiveColumnsPerInhArea*/ 8,
+                   /*stimulusThreshold*/ 1,
+                   /*synPermInactiveDec*/ 0.008,
+                   /*synPermActiveInc*/ 0.05,
+                   /*synPermConnected*/ 0.1,
+                   /*minPctOverlapDutyCycles*/ 0.001,
+                   /*dutyCyclePeriod*/ 20,
+                   /*boostStrength*/ 10.0,
+                   /*seed*/ 3);
+  sp.setExactExp(true);
+  const UInt numInputs = sp.getNumInputs();
+  const UInt numColumns = sp.getNumColumns();
+
+  Random rng(11);
+  vector<UInt> input(numInputs), output(numColumns);
+  vector<Real> boostFactors(numColumns);
+  UInt64 hash = 14695981039346656037ULL;
+  auto fold = [&hash](UInt64 v) { hash = (hash ^ v) * 1099511628211ULL; };
+  for (UInt iteration = 0; iteration < 300; iteration++) {
+    for (UInt i = 0; i < numInputs; i++) {
+      input[i] = rng.getUInt32(8) == 0 ? 1 : 0;
+    }
+    sp.compute(input.data(), true, output.data());
+    sp.getBoostFactors(boostFactors.data());
+    for (UInt i = 0; i < numColumns; i++) {
+      if (output[i]) {
+        fold(i);
+      }
+      UInt64 bits = 0;
+      memcpy(&bits, &boostFactors[i], sizeof(Real));
+      fold(bits);
+    }
+  }
+  return hash;
+}
+
+TEST(SpatialPoolerTest, ExactExpMatchesEarlierReleases) {
+  ASSERT_FALSE(SpatialPooler().getExactExp());
+
+  // Recorded with the libm exp of the releases before fast_exp, in single
+  // precision
+#if !defined(NTA_DOUBLE_PRECISION)
+  EXPECT_EQ(5428054070011834276ULL, hashExactBoosting(true));
+  EXPECT_EQ(4551414815854149548ULL, hashExactBoosting(false));
+#endif
+}
+
 } // end anonymous namespace
@@ -315,4 +315,58 @@ TEST(SvmTest, svm_01_testWriteRead) {
   svm2.train(7.1, 7.2, 7.3);
   ASSERT_NO_FATAL_FAILURE(check_eq(svm1, svm2));
 }
+
+// predict_batch ---------------------------------------------------------------
+template <typename SVM> void setup_predict_batch(SVM &svm, int n_dims) {
+  nupic::Random rng(42);
+  std::vector<float> x(n_dims);
+  for (int i = 0; i < 60; ++i) {
+    int label = i % 3;
+    for (int j = 0; j < n_dims; ++j)
+      x[j] = (j % 3 == label ? 1.0f : 0.0f) +
+             (rng.getReal64() < .2 ? 1.0f : 0.0f);
+    svm.add_sample((float)label, x.begin());
+  }
+  svm.train(.5, 10, .001);
+}
+
+template <typename SVM> void check_predict_batch(SVM &svm, int n_dims) {
+  const int n = 77, n_class = 3, n_dec = n_class * (n_class - 1) / 2;
+  nupic::Random rng(7);
+  std::vector<float> x(n * n_dims);
+  for (auto &v : x)
+    v = rng.getReal64() < .4 ? 1.0f : 0.0f;
+
+  for (int n_threads : {1, 0}) {
+    std::vector<float> labels(n), dec(n * n_dec), proba(n * n_class);
+    svm.predict_batch(n, &x[0], &labels[0], &dec[0], &proba[0], n_threads);
+
+    std::vector<float> labels2(n);
+    svm.predict_batch(n, &x[0], &labels2[0], nullptr, nullptr, n_threads);
+
+    for (int i = 0; i < n; ++i) {
+      std::vector<float> p(n_class);
+      ASSERT_EQ(svm.predict_probability(&x[i * n_dims], p.begin()), labels[i]);
+      ASSERT_EQ(svm.predict(&x[i * n_dims]), labels2[i]);
+      for (int k = 0; k < n_class; ++k)
+        ASSERT_EQ(p[k], proba[i * n_class + k]);
+    }
+  }
+}
+
+TEST(SvmTest, svm_dense_predict_batch) {
+  const int n_dims = 12;
+  for (int kernel : {0, 1}) {
+    svm_dense svm(kernel, n_dims, .9, 100, 1, true, 42);
+    setup_predict_batch(svm, n_dims);
+    ASSERT_NO_FATAL_FAILURE(check_predict_batch(svm, n_dims));
+  }
+}
+
+TEST(SvmTest, svm_01_predict_batch) {
+  const int n_dims = 12;
+  svm_01 svm(1, n_dims, .9, 100, 1, true, 42);
+  setup_predict_batch(svm, n_dims);
+  ASSERT_NO_FATAL_FAILURE(check_predict_batch(svm, n_dims));
+}
 } // end anonymous namespace
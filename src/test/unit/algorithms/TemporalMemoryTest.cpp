@@ -29,12 +29,14 @@
 #include <nupic/math/StlIo.hpp>
 #include <nupic/types/Types.hpp>
 #include <nupic/utils/Log.hpp>
+#include <nupic/utils/ThreadPool.hpp>
 #include <stdio.h>
 
 #include "gtest/gtest.h"
 #include <nupic/algorithms/TemporalMemory.hpp>
 
 using namespace nupic::algorithms::temporal_memory;
+using nupic::util::ThreadPool;
 using namespace std;
 
 #define EPSILON 0.0000001
@@ -1543,6 +1545,86 @@ TEST(TemporalMemoryTest, testWrite) {
   serializationTestVerify(tm2);
 }
 
+// Sets up a TM in parallel mode, with limits low enough to destroy segments
+// and synapses.
+void setupParallel(TemporalMemory &tm, UInt nThreads, ThreadPool &pool) {
+  tm.initialize(
+      /*columnDimensions*/ {64},
+      /*cellsPerColumn*/ 2,
+      /*activationThreshold*/ 3,
+      /*initialPermanence*/ 0.21,
+      /*connectedPermanence*/ 0.50,
+      /*minThreshold*/ 2,
+      /*maxNewSynapseCount*/ 4,
+      /*permanenceIncrement*/ 0.10,
+      /*permanenceDecrement*/ 0.15,
+      /*predictedSegmentDecrement*/ 0.05,
+      /*seed*/ 42,
+      /*maxSegmentsPerCell*/ 2,
+      /*maxSynapsesPerSegment*/ 5);
+  tm.setParallel(true, nThreads, &pool);
+}
+
+TEST(TemporalMemoryTest, ParallelIsIndependentOfThreads) {
+  // The default mode isn't a reference: parallel mode learns with one
+  // random number generator per column, so it differs from it by design.
+  TemporalMemory defaultMode;
+  ASSERT_FALSE(defaultMode.getParallel());
+  ASSERT_EQ(0u, defaultMode.getParallelRanges());
+
+  // The reference runs parallel mode on a pool without workers, all in the
+  // calling thread. A second pool of a known size runs the others, so the
+  // ranges don't depend on the host.
+  ThreadPool serialPool(0);
+  ThreadPool pool(3);
+  TemporalMemory serial;
+  setupParallel(serial, 0, serialPool);
+
+  const vector<UInt> threads = {1u, 2u, 3u, 64u, 0u};
+  vector<TemporalMemory> tms(threads.size());
+  for (size_t i = 0; i < threads.size(); i++) {
+    setupParallel(tms[i], threads[i], pool);
+  }
+
+  // Patterns in a random order, in lockstep
+  Random rng(7);
+  for (UInt step = 0; step < 200; step++) {
+    const UInt pattern = rng.getUInt32(6);
+    vector<UInt> activeColumns;
+    for (UInt column = 0; column < 64; column++) {
+      if ((column * 7 + pattern * 13) % 8 == 0) {
+        activeColumns.push_back(column);
+      }
+    }
+    serial.compute(activeColumns.size(), activeColumns.data(), true);
+    for (size_t i = 0; i < threads.size(); i++) {
+      TemporalMemory &tm = tms[i];
+      tm.compute(activeColumns.size(), activeColumns.data(), true);
+      ASSERT_EQ(serial.getActiveCells(), tm.getActiveCells())
+          << threads[i] << " threads, step " << step;
+      ASSERT_EQ(serial.getWinnerCells(), tm.getWinnerCells())
+          << threads[i] << " threads, step " << step;
+      ASSERT_EQ(serial.connections.numSegments(),
+                tm.connections.numSegments())
+          << threads[i] << " threads, step " << step;
+      ASSERT_EQ(serial.connections.numSynapses(),
+                tm.connections.numSynapses())
+          << threads[i] << " threads, step " << step;
+    }
+  }
+
+  ASSERT_EQ(1u, serial.getParallelRanges());
+  ASSERT_GT(serial.connections.numSegments(), 0u);
+  for (size_t i = 0; i < threads.size(); i++) {
+    const UInt nThreads = threads[i];
+    const TemporalMemory &tm = tms[i];
+    ASSERT_EQ(nThreads ? std::min(nThreads, pool.size()) : pool.size(),
+              tm.getParallelRanges())
+        << nThreads;
+    ASSERT_TRUE(serial == tm) << nThreads;
+  }
+}
+
 // Uncomment these tests individually to save/load from a file.
 // This is useful for ad-hoc testing of backwards-compatibility.
 
@@ -26,10 +26,13 @@
 
 #include "gtest/gtest.h"
 
+#include <nupic/engine/Input.hpp>
 #include <nupic/engine/Network.hpp>
 #include <nupic/engine/NuPIC.hpp>
 #include <nupic/engine/Region.hpp>
 #include <nupic/ntypes/Dimensions.hpp>
+#include <nupic/os/Directory.hpp>
+#include <nupic/os/Path.hpp>
 #include <nupic/utils/Log.hpp>
 
 using namespace nupic;
@@ -101,6 +104,63 @@ TEST(NetworkTest, RegionAccess) {
   EXPECT_THROW(net.addRegion("level1", "TestNode", ""), std::exception);
 }
 
+TEST(NetworkTest, ParameterRef) {
+  Network net;
+  Region *l1 = net.addRegion("level1", "TestNode", "");
+
+  // TestNode exposes the storage of its scalar parameters
+  Region::ParameterRef int32Ref = l1->getParameterRef("int32Param");
+  ASSERT_TRUE(int32Ref.isDirect());
+  ASSERT_EQ(NTA_BasicType_Int32, int32Ref.getType());
+  ASSERT_EQ(32, int32Ref.get<Int32>());
+  int32Ref.set<Int32>(-7);
+  ASSERT_EQ(-7, l1->getParameterInt32("int32Param"));
+  l1->setParameterInt32("int32Param", 11);
+  ASSERT_EQ(11, int32Ref.get<Int32>());
+
+  Region::ParameterRef real64Ref = l1->getParameterRef("real64Param");
+  ASSERT_TRUE(real64Ref.isDirect());
+  real64Ref.set<Real64>(0.25);
+  ASSERT_EQ(0.25, l1->getParameterReal64("real64Param"));
+
+  // Type mismatches are errors, not conversions
+  EXPECT_THROW(int32Ref.get<UInt32>(), std::exception);
+  EXPECT_THROW(real64Ref.set<Real32>(1.0f), std::exception);
+
+  // Parameters with side effects fall back to the name-based accessors
+  Region::ParameterRef cloneRef = l1->getParameterRef("shouldCloneParam");
+  ASSERT_FALSE(cloneRef.isDirect());
+  ASSERT_EQ(1u, cloneRef.get<UInt32>());
+  cloneRef.set<UInt32>(0);
+  ASSERT_EQ(0u, l1->getParameterUInt32("shouldCloneParam"));
+
+  EXPECT_THROW(l1->getParameterRef("nosuchParam"), std::exception);
+  // Only scalars can be referenced
+  EXPECT_THROW(l1->getParameterRef("stringParam"), std::exception);
+
+  Region *sensor = net.addRegion("sensor", "VectorFileSensor",
+                                 "{activeOutputCount: 1}");
+  Region::ParameterRef countRef = sensor->getParameterRef("vectorCount");
+  ASSERT_FALSE(countRef.isWritable());
+  EXPECT_THROW(countRef.set<UInt32>(3), std::exception);
+
+  // The built-in regions expose their stored parameters. Those that can
+  // only be set on creation are read-only.
+  Region::ParameterRef activeRef =
+      sensor->getParameterRef("activeOutputCount");
+  ASSERT_TRUE(activeRef.isDirect());
+  ASSERT_FALSE(activeRef.isWritable());
+  ASSERT_EQ(1u, activeRef.get<UInt32>());
+
+  Region *scalar = net.addRegion(
+      "scalar", "ScalarSensor", "{n: 100, w: 21, minValue: 0, maxValue: 100}");
+  Region::ParameterRef valueRef = scalar->getParameterRef("sensedValue");
+  ASSERT_TRUE(valueRef.isDirect());
+  valueRef.set<Real64>(42.5);
+  ASSERT_EQ(42.5, scalar->getParameterReal64("sensedValue"));
+  ASSERT_FALSE(scalar->getParameterRef("n").isDirect());
+}
+
 TEST(NetworkTest, InitializationBasic) {
   Network net;
   net.initialize();
@@ -578,3 +638,49 @@ TEST(NetworkTest, testEqualsOperator) {
   n2.run(1);
   ASSERT_TRUE(n1 == n2);
 }
+
+TEST(NetworkTest, SaveLoadCompressed) {
+  Network net;
+  Region *l1 = net.addRegion("level1", "TestNode", "");
+  net.addRegion("level2", "TestNode", "");
+  Dimensions d;
+  d.push_back(4);
+  d.push_back(4);
+  l1->setDimensions(d);
+  net.link("level1", "level2", "TestFanIn2", "");
+  l1->setParameterInt32("int32Param", -7);
+  net.run(1);
+
+  // Saving again replaces the bundle
+  net.save("NetworkTest.ntz");
+  net.save("NetworkTest.ntz");
+  net.save("NetworkTest.nta");
+
+  {
+    Network fromArchive("NetworkTest.ntz");
+    Network fromDirectory("NetworkTest.nta");
+    ASSERT_TRUE(fromArchive == fromDirectory);
+
+    ASSERT_EQ(2u, fromArchive.getRegions().getCount());
+    Region *r1 = fromArchive.getRegions().getByName("level1");
+    Region *r2 = fromArchive.getRegions().getByName("level2");
+    ASSERT_EQ(-7, r1->getParameterInt32("int32Param"));
+    ASSERT_EQ(d, r1->getDimensions());
+    ASSERT_EQ(1u, r2->getInput("bottomUpIn")->getLinks().size());
+  }
+
+  // The files regions access by path do not outlive save and load
+  Directory::Iterator it(Directory::getCWD());
+  Directory::Entry entry;
+  while (it.next(entry))
+    ASSERT_EQ(std::string::npos, entry.path.find("NetworkTest.ntz."))
+        << entry.path;
+
+  // Only bundles are overwritten
+  Directory::create("NetworkTestDirectory.ntz");
+  ASSERT_THROW(net.save("NetworkTestDirectory.ntz"), std::exception);
+  Directory::removeTree("NetworkTestDirectory.ntz");
+  Path::remove("NetworkTest.ntz");
+  Directory::removeTree("NetworkTest.nta");
+  ASSERT_THROW(Network("NetworkTest.ntz"), std::exception);
+}
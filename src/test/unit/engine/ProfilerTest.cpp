@@ -0,0 +1,257 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of the engine performance counters test
+ */
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include <nupic/engine/Input.hpp>
+#include <nupic/engine/Link.hpp>
+#include <nupic/engine/Network.hpp>
+#include <nupic/engine/Profiler.hpp>
+#include <nupic/engine/Region.hpp>
+#include <nupic/ntypes/ArrayRef.hpp>
+#include <nupic/ntypes/Dimensions.hpp>
+#include <nupic/os/FStream.hpp>
+#include <nupic/os/Path.hpp>
+
+using namespace nupic;
+
+namespace {
+
+void countCallback(Network *, UInt64, void *data) { ++*(UInt64 *)data; }
+
+// level1 (4x4 TestNodes) -> level2, with the given link delay
+void addLevels(Network &net, size_t propagationDelay) {
+  Region *level1 = net.addRegion("level1", "TestNode", "");
+  net.addRegion("level2", "TestNode", "");
+  Dimensions d;
+  d.push_back(4);
+  d.push_back(4);
+  level1->setDimensions(d);
+  net.link("level1", "level2", "TestFanIn2", "", "", "", propagationDelay);
+  net.initialize();
+}
+
+Link *getLink(Network &net) {
+  return net.getRegions().getByName("level2")->getInput("bottomUpIn")
+      ->getLinks()
+      .front();
+}
+
+} // namespace
+
+TEST(ProfilerTest, LatencyHistogram) {
+  LatencyHistogram h;
+  EXPECT_EQ(0u, h.getTotalCount());
+  EXPECT_EQ(0u, h.getPercentile(0.5));
+
+  h.add(0);
+  h.add(1);
+  h.add(3);
+  h.add(1000);
+  EXPECT_EQ(4u, h.getTotalCount());
+  EXPECT_EQ(1u, h.getCount(0));
+  EXPECT_EQ(1u, h.getCount(1));
+  EXPECT_EQ(1u, h.getCount(2));
+  // 512 <= 1000 < 1024
+  EXPECT_EQ(1u, h.getCount(10));
+  EXPECT_EQ(1024u, LatencyHistogram::getUpperBound(10));
+
+  EXPECT_EQ(1u, h.getPercentile(0.0));
+  EXPECT_EQ(4u, h.getPercentile(0.75));
+  EXPECT_EQ(1024u, h.getPercentile(1.0));
+
+  // Huge latencies land in the last bucket
+  h.add((UInt64)-1);
+  EXPECT_EQ(1u, h.getCount(LatencyHistogram::NUM_BUCKETS - 1));
+
+  h.reset();
+  EXPECT_EQ(0u, h.getTotalCount());
+}
+
+TEST(ProfilerTest, NetworkCounters) {
+  Network net;
+  addLevels(net, 0);
+  UInt64 calls = 0;
+  net.getCallbacks().add("count",
+                         Network::callbackItem(countCallback, &calls));
+
+  // Nothing is counted until profiling is enabled
+  net.run(2);
+  EXPECT_EQ(0u, net.getProfile().iterations);
+
+  net.enableProfiling();
+  net.run(3);
+
+  const NetworkProfile profile = net.getProfile();
+  EXPECT_EQ(3u, profile.iterations);
+  EXPECT_EQ(3u, profile.run.calls);
+  EXPECT_EQ(3u, profile.callbacks.calls);
+  EXPECT_EQ(3u, profile.callbackCounters.at("count").calls);
+  EXPECT_EQ(3u, profile.shiftBufferedData.calls);
+  EXPECT_GE(profile.run.totalNs, profile.run.maxNs);
+  EXPECT_GT(profile.realMemory, 0u);
+
+  ASSERT_EQ(2u, profile.regions.size());
+  for (const auto &region : profile.regions) {
+    EXPECT_EQ(3u, region.second.compute.calls);
+    EXPECT_EQ(3u, region.second.prepareInputs.calls);
+    EXPECT_EQ(0u, region.second.execute.calls);
+  }
+
+  Link *link = getLink(net);
+  ASSERT_EQ(1u, profile.links.size());
+  const LinkCounters &counters = profile.links.at(link->getMoniker());
+  const ArrayRef src =
+      net.getRegions().getByName("level1")->getOutputData("bottomUpOut");
+  EXPECT_EQ(3u, counters.compute.calls);
+  EXPECT_EQ(3 * src.getBufferSize(), counters.bytesCopied);
+  EXPECT_EQ(0u, counters.denseToSparse);
+  EXPECT_EQ(0u, counters.sparseToDense);
+  // Links without delay do not allocate, nor shift
+  EXPECT_EQ(0u, counters.allocations);
+  EXPECT_EQ(0u, counters.shiftBufferedData.calls);
+  // Without histograms, no percentiles
+  EXPECT_EQ(0u, counters.compute.histogram.getTotalCount());
+
+  // The Region timers are still kept
+  EXPECT_EQ(3, net.getRegions()
+                   .getByName("level2")
+                   ->getComputeTimer()
+                   .getStartCount());
+
+  net.disableProfiling();
+  net.run(1);
+  EXPECT_EQ(3u, net.getProfile().iterations);
+  EXPECT_EQ(3u, link->getCounters().compute.calls);
+
+  net.resetProfiling();
+  const NetworkProfile reset = net.getProfile();
+  EXPECT_EQ(0u, reset.iterations);
+  EXPECT_EQ(0u, reset.run.calls);
+  EXPECT_TRUE(reset.callbackCounters.empty());
+  EXPECT_EQ(0u, reset.regions.at("level2").compute.calls);
+  EXPECT_EQ(0u, reset.links.at(link->getMoniker()).bytesCopied);
+}
+
+TEST(ProfilerTest, DelayedLinkAllocations) {
+  Network net;
+  addLevels(net, 2);
+  net.enableProfiling();
+  net.run(4);
+
+  const LinkCounters &counters = getLink(net)->getCounters();
+  const ArrayRef src =
+      net.getRegions().getByName("level1")->getOutputData("bottomUpOut");
+  EXPECT_EQ(4u, counters.compute.calls);
+  EXPECT_EQ(4u, counters.shiftBufferedData.calls);
+  EXPECT_EQ(4u, counters.allocations);
+  EXPECT_EQ(4 * src.getBufferSize(), counters.allocatedBytes);
+  // The copies to the input, and into the delay buffer
+  EXPECT_EQ(8 * src.getBufferSize(), counters.bytesCopied);
+}
+
+TEST(ProfilerTest, Histograms) {
+  Network net;
+  addLevels(net, 0);
+  net.enableProfiling();
+  net.enableLatencyHistograms(true);
+  net.run(5);
+
+  const NetworkProfile profile = net.getProfile();
+  const OpCounter &compute = profile.regions.at("level1").compute;
+  EXPECT_EQ(5u, compute.histogram.getTotalCount());
+  EXPECT_LE(compute.histogram.getPercentile(0.5),
+            compute.histogram.getPercentile(0.99));
+  // The maximum is in the bucket of the 100th percentile
+  EXPECT_LT(compute.maxNs, compute.histogram.getPercentile(1.0));
+
+  const std::string json = net.getProfileJSON();
+  EXPECT_NE(std::string::npos, json.find("\"iterations\": 5"));
+  EXPECT_NE(std::string::npos, json.find("\"p99_ns\""));
+  EXPECT_NE(std::string::npos, json.find("\"level1\""));
+  EXPECT_NE(std::string::npos, json.find("\"bytes_copied\""));
+}
+
+TEST(ProfilerTest, Trace) {
+  Network net;
+  addLevels(net, 0);
+  net.enableProfiling();
+
+  // Not traced before startTrace
+  net.run(1);
+  net.startTrace();
+  net.run(2);
+  net.stopTrace();
+  net.run(1);
+
+  const std::string path = Path::makeAbsolute("ProfilerTest.trace.json");
+  net.writeTrace(path);
+
+  IFStream in(path.c_str());
+  std::stringstream contents;
+  contents << in.rdbuf();
+  in.close();
+  Path::remove(path);
+  const std::string trace = contents.str();
+
+  size_t events = 0;
+  for (size_t pos = trace.find("\"ph\": \"X\""); pos != std::string::npos;
+       pos = trace.find("\"ph\": \"X\"", pos + 1))
+    ++events;
+  // Per iteration: run, shift, prepareInputs and compute of both regions,
+  // and the link into level2
+  EXPECT_EQ(2u * 7, events);
+  EXPECT_EQ(0u, trace.find("{\"traceEvents\": ["));
+  EXPECT_NE(std::string::npos, trace.find("\"cat\": \"compute\""));
+  EXPECT_NE(std::string::npos, trace.find("\"cat\": \"link\""));
+  EXPECT_NE(std::string::npos, trace.find("\"iteration\": 3"));
+  EXPECT_EQ(std::string::npos, trace.find("\"iteration\": 4"));
+}
+
+TEST(ProfilerTest, TraceLimit) {
+  Profiler profiler;
+  profiler.startTrace(2);
+  OpCounter counter;
+  const std::string name("op \"quoted\"");
+  for (UInt64 i = 0; i != 5; ++i)
+    Profiler::record(&profiler, counter, 1000 * i, 1000 * i + 1500, name,
+                     "test");
+  EXPECT_EQ(5u, counter.calls);
+  EXPECT_EQ(7500u, counter.totalNs);
+  EXPECT_EQ(1500u, counter.maxNs);
+  ASSERT_EQ(2u, profiler.getTraceEvents().size());
+  EXPECT_EQ(3u, profiler.getDroppedEvents());
+
+  std::stringstream out;
+  profiler.writeTrace(out);
+  const std::string trace = out.str();
+  EXPECT_NE(std::string::npos, trace.find("\"op \\\"quoted\\\"\""));
+  EXPECT_NE(std::string::npos, trace.find("\"ts\": 1.000, \"dur\": 1.500"));
+  EXPECT_NE(std::string::npos, trace.find("\"dropped_events\": 3"));
+}
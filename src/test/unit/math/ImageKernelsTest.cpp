@@ -0,0 +1,227 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+
+/** @file
+ * Unit tests for Convolution.hpp and Erosion.hpp
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include <nupic/math/Convolution.hpp>
+#include <nupic/math/Erosion.hpp>
+
+using std::vector;
+
+namespace {
+vector<float> randomImage(size_t n, unsigned int seed) {
+  srand(seed);
+  vector<float> image(n);
+  for (size_t i = 0; i != n; ++i)
+    image[i] = float(rand() % 1000) / 100.0f - 5.0f;
+  return image;
+}
+
+// Straightforward separable convolution, valid pixels only, with the same
+// summation order as the kernels.
+float naiveConvolved(const vector<float> &data, size_t ncols,
+                     const vector<float> &f1, const vector<float> &f2,
+                     size_t r, size_t c) {
+  float sum = 0;
+  for (size_t k = 0; k != f2.size(); ++k) {
+    float dot = 0;
+    for (size_t l = 0; l != f1.size(); ++l)
+      dot += f1[l] * data[(r + k) * ncols + c + l];
+    sum += f2[k] * dot;
+  }
+  return sum;
+}
+
+// One 3x3 min/max pass with the border handling of Erosion.
+vector<float> naiveErode(const vector<float> &in, size_t nrows, size_t ncols,
+                         bool dilate) {
+  vector<float> out(in.size(), 0);
+  for (size_t r = 0; r != nrows; ++r) {
+    for (size_t c = 0; c != ncols; ++c) {
+      bool border = r == 0 || c == 0 || r == nrows - 1 || c == ncols - 1;
+      if (border && !dilate)
+        continue;
+      float v = in[r * ncols + c];
+      for (int dr = -1; dr <= 1; ++dr) {
+        for (int dc = -1; dc <= 1; ++dc) {
+          int rr = int(r) + dr, cc = int(c) + dc;
+          if (rr < 0 || cc < 0 || rr >= int(nrows) || cc >= int(ncols))
+            continue;
+          float x = in[rr * ncols + cc];
+          v = dilate ? std::max(v, x) : std::min(v, x);
+        }
+      }
+      out[r * ncols + c] = v;
+    }
+  }
+  return out;
+}
+
+TEST(ImageKernelsTest, SeparableConvolution) {
+  const size_t nrows = 23, ncols = 37;
+  vector<float> data = randomImage(nrows * ncols, 42);
+  vector<float> f1 = {0.25f, -1.5f, 2.0f, 0.5f, -0.75f};
+  vector<float> f2 = {1.0f, -0.5f, 0.125f};
+
+  SeparableConvolution2D<float> conv;
+  conv.init(nrows, ncols, f1.size(), f2.size(), &f1[0], &f2[0]);
+
+  vector<float> convolved(nrows * ncols, -1);
+  conv.compute(&data[0], &convolved[0]);
+
+  for (size_t r = 0; r != nrows; ++r) {
+    for (size_t c = 0; c != ncols; ++c) {
+      float value = convolved[r * ncols + c];
+      if (r < 1 || r >= nrows - 1)
+        ASSERT_EQ(-1, value) << r << "," << c;
+      else if (c < 2 || c >= ncols - 2)
+        ASSERT_EQ(0, value) << r << "," << c;
+      else
+        ASSERT_FLOAT_EQ(naiveConvolved(data, ncols, f1, f2, r - 1, c - 2),
+                        value)
+            << r << "," << c;
+    }
+  }
+}
+
+TEST(ImageKernelsTest, SeparableConvolutionValidDownSampled) {
+  const size_t nrows = 30, ncols = 41;
+  vector<float> data = randomImage(nrows * ncols, 7);
+  vector<float> f1 = {0.5f, 1.0f, 0.5f};
+  vector<float> f2 = {-1.0f, 0.0f, 2.0f, 0.0f, -1.0f};
+
+  Workspace<float> workspace;
+  SeparableConvolution2D<float> conv;
+  conv.init(nrows, ncols, f1.size(), f2.size(), &f1[0], &f2[0], &workspace);
+
+  vector<float> full(nrows * ncols);
+  conv.compute(&data[0], &full[0]);
+
+  for (size_t rowStep = 1; rowStep != 8; ++rowStep) {
+    for (size_t colStep = 1; colStep != 5; ++colStep) {
+      const size_t nr = conv.validRows(rowStep), nc = conv.validCols(colStep);
+      ASSERT_EQ((nrows - 4 + rowStep - 1) / rowStep, nr);
+      ASSERT_EQ((ncols - 2 + colStep - 1) / colStep, nc);
+
+      // Write into a sub-block of a larger image, with padding on each row.
+      const size_t stride = nc + 3;
+      vector<float> out(nr * stride, -7);
+      conv.computeValid(&data[0], &out[0], stride, rowStep, colStep);
+
+      for (size_t i = 0; i != nr; ++i) {
+        for (size_t j = 0; j != nc; ++j)
+          ASSERT_EQ(full[(2 + i * rowStep) * ncols + 1 + j * colStep],
+                    out[i * stride + j]);
+        for (size_t j = nc; j != stride; ++j)
+          ASSERT_EQ(-7, out[i * stride + j]);
+      }
+    }
+  }
+  ASSERT_GE(workspace.capacity(), nrows * ncols);
+}
+
+TEST(ImageKernelsTest, SeparableConvolutionFilterLargerThanImage) {
+  const size_t nrows = 4, ncols = 6;
+  vector<float> data = randomImage(nrows * ncols, 11);
+  vector<float> small = {1.0f, 2.0f, 1.0f};
+  vector<float> large(9, 1.0f);
+
+  // Filters wider, taller, or both wider and taller than the image.
+  vector<float> *filters[][2] = {
+      {&large, &small}, {&small, &large}, {&large, &large}};
+  for (auto &f : filters) {
+    SeparableConvolution2D<float> conv;
+    conv.init(nrows, ncols, f[0]->size(), f[1]->size(), &(*f[0])[0],
+              &(*f[1])[0]);
+
+    const size_t nr = conv.validRows(), nc = conv.validCols();
+    ASSERT_EQ(f[1] == &large ? 0u : nrows - 2, nr);
+    ASSERT_EQ(f[0] == &large ? 0u : ncols - 2, nc);
+
+    vector<float> out(nrows * ncols, -7);
+    conv.computeValid(&data[0], &out[0], ncols);
+    ASSERT_EQ(vector<float>(nrows * ncols, -7), out);
+    conv.computeValid(&data[0], &out[0], ncols, 2, 3);
+    ASSERT_EQ(vector<float>(nrows * ncols, -7), out);
+
+    // Only the rows where the vertical filter fits are written, and they
+    // are all 0 since the horizontal filter fits nowhere.
+    vector<float> convolved(nrows * ncols, -7);
+    conv.compute(&data[0], &convolved[0]);
+    for (size_t r = 0; r != nrows; ++r)
+      for (size_t c = 0; c != ncols; ++c)
+        ASSERT_EQ(nr && r >= 1 && r < nrows - 1 ? 0 : -7,
+                  convolved[r * ncols + c])
+            << r << "," << c;
+  }
+}
+
+TEST(ImageKernelsTest, ErosionDilation) {
+  const size_t nrows = 19, ncols = 27;
+  vector<float> data = randomImage(nrows * ncols, 3);
+
+  Erosion<float> erosion;
+  erosion.init(nrows, ncols);
+
+  for (bool dilate : {false, true}) {
+    for (size_t iterations = 1; iterations != 4; ++iterations) {
+      vector<float> expected = data;
+      for (size_t i = 0; i != iterations; ++i)
+        expected = naiveErode(expected, nrows, ncols, dilate);
+
+      vector<float> eroded(nrows * ncols, -1);
+      erosion.compute(&data[0], &eroded[0], iterations, dilate);
+      ASSERT_EQ(expected, eroded) << dilate << " " << iterations;
+    }
+  }
+}
+
+TEST(ImageKernelsTest, SharedWorkspace) {
+  const size_t nrows = 16, ncols = 20;
+  vector<float> data = randomImage(nrows * ncols, 11);
+  vector<float> f = {1.0f, 2.0f, 1.0f};
+
+  Workspace<float> workspace;
+  SeparableConvolution2D<float> shared, owned;
+  Erosion<float> erosion;
+  shared.init(nrows, ncols, f.size(), f.size(), &f[0], &f[0], &workspace);
+  owned.init(nrows, ncols, f.size(), f.size(), &f[0], &f[0]);
+  erosion.init(nrows, ncols, &workspace);
+
+  vector<float> a(nrows * ncols), b(nrows * ncols), e(nrows * ncols);
+  shared.compute(&data[0], &a[0]);
+  erosion.compute(&a[0], &e[0], 1);
+  shared.compute(&e[0], &a[0]);
+  owned.compute(&e[0], &b[0]);
+
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(shared.buffer_, erosion.buffer_);
+}
+} // namespace
@@ -0,0 +1,285 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Checks of the NearestNeighbor distances and searches against dense
+ * reference computations.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/math/NearestNeighbor.hpp>
+#include <nupic/types/Types.hpp>
+
+using namespace nupic;
+
+namespace {
+
+typedef NearestNeighbor<SparseMatrix<UInt32, Real32, Int32, Real64>> NN;
+typedef std::pair<UInt32, Real32> Neighbor;
+
+// p < 0 stands for Lmax
+Real64 denseDist(const std::vector<Real32> &row,
+                 const std::vector<Real32> &x, Real64 p) {
+  Real64 d = 0;
+  for (size_t j = 0; j != x.size(); ++j) {
+    Real64 a = std::fabs((Real64)row[j] - (Real64)x[j]);
+    if (p < 0)
+      d = std::max(d, a);
+    else if (p == 0)
+      d += a > nupic::Epsilon;
+    else
+      d += std::pow(a, p);
+  }
+  return d;
+}
+
+std::vector<Real32> randomDense(UInt32 n, Real32 density, std::mt19937 &rng) {
+  std::uniform_real_distribution<Real32> u(0, 1);
+  std::vector<Real32> v(n, 0);
+  for (Real32 &a : v)
+    if (u(rng) < density)
+      a = u(rng) < 0.5 ? -0.1f - u(rng) : 0.1f + u(rng);
+  return v;
+}
+
+std::vector<Real32> row(const std::vector<Real32> &dense, UInt32 ncols,
+                        UInt32 i) {
+  return std::vector<Real32>(dense.begin() + i * ncols,
+                             dense.begin() + (i + 1) * ncols);
+}
+
+// The k nearest rows by (distance, row), from all the distances
+std::vector<Neighbor> sortedNearest(const std::vector<Real32> &dist,
+                                    UInt32 k) {
+  std::vector<Neighbor> all;
+  for (UInt32 i = 0; i != dist.size(); ++i)
+    all.push_back(Neighbor(i, dist[i]));
+  std::sort(all.begin(), all.end(),
+            [](const Neighbor &a, const Neighbor &b) {
+              return a.second < b.second ||
+                     (a.second == b.second && a.first < b.first);
+            });
+  all.resize(std::min<size_t>(k, all.size()));
+  return all;
+}
+
+void checkDistances(UInt32 nrows, UInt32 ncols, Real32 density) {
+  std::mt19937 rng(nrows + ncols);
+  std::vector<Real32> dense = randomDense(nrows * ncols, density, rng);
+  NN nn(nrows, ncols, dense.begin());
+  std::vector<Real32> x = randomDense(ncols, 0.5, rng), y(nrows);
+
+  const Real64 ps[] = {0, 1, 2, 3, 0.5, -1};
+  for (Real64 p : ps) {
+    if (p < 0)
+      nn.LMaxDist(x.begin(), y.begin());
+    else
+      nn.LpDist((Real32)p, x.begin(), y.begin());
+
+    for (UInt32 i = 0; i != nrows; ++i) {
+      Real64 expected = denseDist(row(dense, ncols, i), x, p);
+      ASSERT_NEAR(expected, y[i], 1e-4 * (1 + expected))
+          << "p = " << p << " row " << i;
+      if (p >= 0) {
+        ASSERT_NEAR(expected, nn.rowLpDist((Real32)p, i, x.begin()),
+                    1e-4 * (1 + expected));
+      }
+    }
+
+    if (p < 0)
+      continue;
+
+    // The nearest rows are the first rows by (distance, row)
+    const UInt32 k = 7;
+    std::vector<Neighbor> nearest(k), expected = sortedNearest(y, k);
+    nn.LpNearest((Real32)p, x.begin(), nearest.begin(), k);
+    ASSERT_EQ(expected, nearest) << "p = " << p;
+  }
+
+  nn.L2Dist(x.begin(), y.begin(), true);
+  for (UInt32 i = 0; i != nrows; ++i) {
+    Real64 expected = std::sqrt(denseDist(row(dense, ncols, i), x, 2));
+    ASSERT_NEAR(expected, y[i], 1e-4 * (1 + expected));
+  }
+}
+
+} // namespace
+
+TEST(NearestNeighborTest, DistancesMatchDense) {
+  checkDistances(40, 37, 0.4f);
+  checkDistances(13, 100, 0.9f);
+}
+
+// Enough non-zeros for the rows to be split between threads
+TEST(NearestNeighborTest, LargeMatrixDistancesMatchDense) {
+  checkDistances(3000, 64, 0.3f);
+}
+
+TEST(NearestNeighborTest, TiesGoToLowerRow) {
+  const UInt32 ncols = 10;
+  std::vector<Real32> dense(6 * ncols, 0);
+  for (UInt32 i = 0; i != 6; ++i)
+    dense[i * ncols + i % 2] = 1;
+  NN nn(6, ncols, dense.begin());
+  std::vector<Real32> x(ncols, 0);
+  x[1] = 1;
+
+  std::vector<Neighbor> nearest(6);
+  nn.LpNearest(2, x.begin(), nearest.begin(), 6);
+  const UInt32 order[] = {1, 3, 5, 0, 2, 4};
+  for (UInt32 i = 0; i != 6; ++i)
+    ASSERT_EQ(order[i], nearest[i].first);
+
+  // k is capped by the number of rows
+  std::vector<Neighbor> all(10, Neighbor(99, 99));
+  nn.LMaxNearest(x.begin(), all.begin(), 10);
+  ASSERT_EQ(1u, all[0].first);
+  ASSERT_EQ(4u, all[5].first);
+  ASSERT_EQ(99u, all[6].first);
+}
+
+TEST(NearestNeighborTest, BatchMatchesSingleQueries) {
+  const UInt32 nrows = 500, ncols = 50, nq = 9, k = 4;
+  std::mt19937 rng(42);
+  std::vector<Real32> dense = randomDense(nrows * ncols, 0.3f, rng);
+  NN nn(nrows, ncols, dense.begin());
+  std::vector<Real32> queries = randomDense(nq * ncols, 0.4f, rng);
+
+  const Real32 ps[] = {0, 1, 2, 1.5};
+  for (Real32 p : ps) {
+    std::vector<Neighbor> batch(nq * k);
+    nn.LpNearestBatch(p, nq, queries.begin(), batch.begin(), k, true);
+    for (UInt32 q = 0; q != nq; ++q) {
+      std::vector<Neighbor> single(k);
+      nn.LpNearest(p, queries.begin() + q * ncols, single.begin(), k, true);
+      ASSERT_TRUE(std::equal(single.begin(), single.end(),
+                             batch.begin() + q * k))
+          << "p = " << p << " query " << q;
+    }
+  }
+}
+
+TEST(NearestNeighborTest, ApproxMatchesExactOnSDRs) {
+  const UInt32 nrows = 1000, ncols = 512, w = 10, k = 5;
+  std::mt19937 rng(7);
+  std::vector<Real32> dense(nrows * ncols, 0);
+  for (UInt32 i = 0; i != nrows; ++i)
+    for (UInt32 b = 0; b != w;) {
+      Real32 &v = dense[i * ncols + rng() % ncols];
+      if (v == 0) {
+        v = 1;
+        ++b;
+      }
+    }
+  NN nn(nrows, ncols, dense.begin());
+
+  // A stored SDR with a few bits moved
+  std::vector<Real32> x = row(dense, ncols, 123);
+  for (UInt32 moved = 0; moved != 3;) {
+    UInt32 j = rng() % ncols;
+    if (x[j] == 0) {
+      *std::find(x.begin(), x.end(), 1.0f) = 0;
+      x[j] = 1;
+      ++moved;
+    }
+  }
+
+  std::vector<Neighbor> exact(k), approx(k);
+  EXPECT_THROW(nn.approxLpNearest(0, x.begin(), approx.begin(), k),
+               std::exception);
+
+  nn.enableColumnIndex();
+  nn.LpNearest(0, x.begin(), exact.begin(), k);
+  ASSERT_EQ(123u, exact[0].first);
+
+  // With rows of equal weight, the Hamming distance decreases with the
+  // overlap, so the best candidates are the exact nearest rows
+  nn.approxLpNearest(0, x.begin(), approx.begin(), k);
+  ASSERT_EQ(exact, approx);
+  nn.approxLpNearest(0, x.begin(), approx.begin(), k, false, k);
+  ASSERT_EQ(exact, approx);
+
+  nn.LpNearest(2, x.begin(), exact.begin(), k, true);
+  nn.approxLpNearest(2, x.begin(), approx.begin(), k, true, 50);
+  ASSERT_EQ(exact, approx);
+
+  // No overlap: falls back to the exact search
+  std::vector<Real32> none(ncols, 0);
+  nn.LpNearest(1, none.begin(), exact.begin(), k);
+  nn.approxLpNearest(1, none.begin(), approx.begin(), k);
+  ASSERT_EQ(exact, approx);
+}
+
+// The kernels combine their 8 lanes in the documented order, so the
+// vectorized version matches this scalar one bit for bit
+TEST(NearestNeighborTest, KernelsMatchLaneOrder) {
+  typedef NearestNeighborKernels<UInt32, Real32> K;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<Real32> u(-1, 1);
+  const UInt32 ncols = 300;
+  std::vector<Real32> x(ncols), px1(ncols), px2(ncols);
+  for (UInt32 j = 0; j != ncols; ++j) {
+    x[j] = u(rng);
+    px1[j] = std::fabs(x[j]);
+    px2[j] = x[j] * x[j];
+  }
+
+  for (UInt32 n = 0; n != 60; ++n) {
+    std::vector<UInt32> ind(n);
+    std::vector<Real32> nz(n);
+    for (UInt32 i = 0; i != n; ++i) {
+      ind[i] = (i * 7 + n) % ncols;
+      nz[i] = u(rng);
+    }
+
+    Real32 l1[8] = {0}, l2[8] = {0}, m = 0;
+    UInt32 i = 0;
+    for (; i + 8 <= n; i += 8)
+      for (UInt32 l = 0; l != 8; ++l) {
+        Real32 d = nz[i + l] - x[ind[i + l]];
+        l1[l] += std::fabs(d) - px1[ind[i + l]];
+        l2[l] += d * d - px2[ind[i + l]];
+      }
+    Real32 s1 = ((l1[0] + l1[4]) + (l1[2] + l1[6])) +
+                ((l1[1] + l1[5]) + (l1[3] + l1[7]));
+    Real32 s2 = ((l2[0] + l2[4]) + (l2[2] + l2[6])) +
+                ((l2[1] + l2[5]) + (l2[3] + l2[7]));
+    for (; i != n; ++i) {
+      Real32 d = nz[i] - x[ind[i]];
+      s1 += std::fabs(d) - px1[ind[i]];
+      s2 += d * d - px2[ind[i]];
+    }
+    for (i = 0; i != n; ++i)
+      m = std::max(m, std::fabs(nz[i] - x[ind[i]]));
+
+    ASSERT_EQ(s1, K::l1(ind.data(), nz.data(), n, x.data(), px1.data()));
+    ASSERT_EQ(s2, K::l2(ind.data(), nz.data(), n, x.data(), px2.data()));
+    ASSERT_EQ(m, K::lmax(ind.data(), nz.data(), n, x.data()));
+  }
+}
@@ -0,0 +1,235 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Tests of the runtime selection of the vectorized kernels: every
+ * instruction set the machine supports must return the bits of the scalar
+ * code.
+ */
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/math/ArrayAlgo.hpp>
+#include <nupic/math/Convolution.hpp>
+#include <nupic/math/Erosion.hpp>
+#include <nupic/math/Math.hpp>
+#include <nupic/math/NearestNeighbor.hpp>
+#include <nupic/math/Simd.hpp>
+#include <nupic/math/SparseMatrix.hpp>
+#include <nupic/types/Exception.hpp>
+
+using namespace nupic;
+using namespace nupic::simd;
+
+namespace {
+
+const Isa allIsas[] = {Isa::SCALAR, Isa::SSE42, Isa::AVX2, Isa::AVX512};
+
+// Restores the instruction set in use on destruction
+struct IsaGuard {
+  Isa saved;
+  IsaGuard() : saved(getIsa()) {}
+  ~IsaGuard() { setIsa(saved); }
+};
+
+// The results of every kernel on the same random data, with the kernels in
+// use
+struct Results {
+  std::vector<Real32> floats;
+  std::vector<size_t> counts;
+  std::vector<int> ints;
+};
+
+Results computeAll() {
+  Results results;
+  std::mt19937 rng(17);
+  std::uniform_real_distribution<Real32> u(-1, 1);
+
+  // Sparse rows of 0 to 70 non-zeros, a row of negative non-zeros, and a
+  // row of zero products of both signs, for vecMaxProd
+  const UInt32 ncols = 300;
+  SparseMatrix<UInt32, Real32, Int32, Real64> m(72, ncols);
+  for (UInt32 row = 0; row != 70; ++row)
+    for (UInt32 k = 0; k != row; ++k)
+      m.setNonZero(row, (k * 37 + row) % ncols, u(rng));
+  std::vector<Real32> x(ncols);
+  for (auto &v : x)
+    v = u(rng);
+  for (UInt32 k = 0; k != 20; ++k) {
+    m.setNonZero(70, 100 + k, -1.0f - k);
+    m.setNonZero(71, k, 1.0f);
+    x[k] = k % 2 ? 0.0f : -0.0f;
+  }
+  std::vector<Real32> y(m.nRows());
+  m.rightVecProd(x.data(), y.data());
+  results.floats.insert(results.floats.end(), y.begin(), y.end());
+  m.rightVecSumAtNZ(x.data(), y.data());
+  results.floats.insert(results.floats.end(), y.begin(), y.end());
+  m.vecMaxProd(x.data(), y.data());
+  results.floats.insert(results.floats.end(), y.begin(), y.end());
+
+  // Distances
+  typedef NearestNeighborKernels<UInt32, Real32> K;
+  std::vector<Real32> px1(ncols), px2(ncols);
+  for (UInt32 j = 0; j != ncols; ++j) {
+    px1[j] = std::fabs(x[j]);
+    px2[j] = x[j] * x[j];
+  }
+  for (UInt32 n = 0; n != 70; ++n) {
+    std::vector<UInt32> ind(n);
+    std::vector<Real32> nz(n);
+    for (UInt32 i = 0; i != n; ++i) {
+      ind[i] = (i * 7 + n) % ncols;
+      nz[i] = u(rng);
+    }
+    results.floats.push_back(K::l1(ind.data(), nz.data(), n, x.data(),
+                                   px1.data()));
+    results.floats.push_back(K::l2(ind.data(), nz.data(), n, x.data(),
+                                   px2.data()));
+    results.floats.push_back(K::lmax(ind.data(), nz.data(), n, x.data()));
+  }
+
+  // exp and log over arrays of all the lengths around the vector widths
+  for (size_t n = 0; n != 40; ++n) {
+    std::vector<float> a(n), b(n);
+    for (auto &v : a)
+      v = 100.0f * u(rng);
+    fast_exp(a.data(), a.data() + n, b.data());
+    results.floats.insert(results.floats.end(), b.begin(), b.end());
+    for (auto &v : a)
+      v = std::fabs(v) + 1e-3f;
+    fast_log(a.data(), a.data() + n, b.data());
+    results.floats.insert(results.floats.end(), b.begin(), b.end());
+  }
+
+  // Bit counts
+  std::vector<UInt64> wa(70), wb(70);
+  for (size_t i = 0; i != wa.size(); ++i) {
+    wa[i] = ((UInt64)rng() << 32) | rng();
+    wb[i] = ((UInt64)rng() << 32) | rng();
+  }
+  for (size_t n = 0; n != wa.size(); ++n) {
+    results.counts.push_back(packed_count(wa.data(), n));
+    results.counts.push_back(packed_overlap(wa.data(), wb.data(), n));
+    results.counts.push_back(packed_union_count(wa.data(), wb.data(), n));
+    results.counts.push_back(packed_hamming_distance(wa.data(), wb.data(), n));
+  }
+
+  // Convolution step
+  for (int n = 0; n != 40; ++n) {
+    std::vector<int> in(n), out(n);
+    for (int i = 0; i != n; ++i) {
+      in[i] = (int)(rng() % 2001) - 1000;
+      out[i] = (int)(rng() % 2001) - 1000;
+    }
+    const int a = (int)(rng() % 201) - 100;
+    if (const auto f = kernels().addScaled) {
+      f(out.data(), in.data(), a, n);
+    } else {
+      for (int i = 0; i != n; ++i)
+        out[i] += a * in[i];
+    }
+    results.ints.insert(results.ints.end(), out.begin(), out.end());
+  }
+
+  // Separable convolution and erosion, over rows of all the lengths around
+  // the vector widths
+  for (size_t ncols = 3; ncols != 40; ++ncols) {
+    const size_t nrows = 5;
+    std::vector<float> image(nrows * ncols), out(nrows * ncols);
+    for (auto &v : image)
+      v = u(rng);
+    float f1[3] = {u(rng), u(rng), u(rng)}, f2[3] = {u(rng), u(rng), u(rng)};
+    SeparableConvolution2D<float> convolution;
+    convolution.init(nrows, ncols, 3, 3, f1, f2);
+    convolution.compute(image.data(), out.data());
+    results.floats.insert(results.floats.end(), out.begin() + ncols,
+                          out.end() - ncols);
+    Erosion<float> erosion;
+    erosion.init(nrows, ncols);
+    for (bool dilate : {false, true}) {
+      erosion.compute(image.data(), out.data(), 2, dilate);
+      results.floats.insert(results.floats.end(), out.begin(), out.end());
+    }
+  }
+
+  return results;
+}
+
+} // namespace
+
+TEST(Simd, IsaNames) {
+  for (Isa isa : allIsas)
+    ASSERT_EQ(isa, parseIsa(getIsaName(isa)));
+  ASSERT_EQ(Isa::SSE42, parseIsa("sse4.2"));
+  ASSERT_THROW(parseIsa("neon"), nupic::Exception);
+}
+
+TEST(Simd, Selection) {
+  ASSERT_TRUE(isSupported(Isa::SCALAR));
+  ASSERT_TRUE(isSupported(getBestIsa()));
+  ASSERT_TRUE(isSupported(getIsa()));
+  ASSERT_EQ(getIsa(), kernels().isa);
+
+  IsaGuard guard;
+  for (Isa isa : allIsas) {
+    if (isSupported(isa)) {
+      setIsa(isa);
+      ASSERT_EQ(isa, getIsa());
+      ASSERT_EQ(isa, getKernels(isa).isa);
+    } else {
+      ASSERT_THROW(setIsa(isa), nupic::Exception);
+      ASSERT_THROW(getKernels(isa), nupic::Exception);
+    }
+  }
+
+  // The scalar version has no kernels
+  setIsa(Isa::SCALAR);
+  ASSERT_TRUE(kernels().sparseDot == nullptr);
+  ASSERT_TRUE(kernels().exp == nullptr);
+  ASSERT_FALSE((SparseRowKernels<UInt32, Real32>::enabled()));
+}
+
+TEST(Simd, AllVersionsMatchScalar) {
+  IsaGuard guard;
+  setIsa(Isa::SCALAR);
+  const Results expected = computeAll();
+
+  for (Isa isa : allIsas) {
+    if (!isSupported(isa))
+      continue;
+    setIsa(isa);
+    const Results actual = computeAll();
+    ASSERT_EQ(expected.floats.size(), actual.floats.size());
+    for (size_t i = 0; i != expected.floats.size(); ++i)
+      ASSERT_EQ(0, std::memcmp(&expected.floats[i], &actual.floats[i],
+                               sizeof(Real32)))
+          << getIsaName(isa) << " float " << i << ": "
+          << expected.floats[i] << " != " << actual.floats[i];
+    ASSERT_EQ(expected.counts, actual.counts) << getIsaName(isa);
+    ASSERT_EQ(expected.ints, actual.ints) << getIsaName(isa);
+  }
+}
@@ -20,6 +20,10 @@
  * ---------------------------------------------------------------------
  */
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -97,3 +101,224 @@ TEST(SparseBinaryMatrixReadWrite, Basic) {
   ASSERT_EQ(m1r1[0], 1) << "Invalid col index in original matrix";
   ASSERT_EQ(m1r1[0], m2r1[0]) << "Invalid col index in copied matrix";
 }
+
+TEST(PackedSDR, KernelsMatchIndexLists) {
+  std::mt19937 rng(11);
+  const UInt sizes[] = {1, 63, 64, 65, 300, 2048};
+  for (UInt n : sizes) {
+    std::vector<UInt> a, b;
+    for (UInt i = 0; i != n; ++i) {
+      if (rng() % 5 == 0)
+        a.push_back(i);
+      if (rng() % 3 == 0)
+        b.push_back(i);
+    }
+    PackedSDR pa(n, a.begin(), a.end()), pb(n, b.rbegin(), b.rend());
+
+    std::vector<UInt> both, either;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                          std::back_inserter(both));
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                   std::back_inserter(either));
+
+    ASSERT_EQ(a, pa.getIndices());
+    ASSERT_EQ(a.size(), pa.count());
+    ASSERT_EQ(both.size(), pa.overlap(pb));
+    ASSERT_EQ(either.size(), pa.unionCount(pb));
+    ASSERT_EQ(sparse_hamming_distance(a, b), pa.hammingDistance(pb));
+    ASSERT_EQ(both, (pa & pb).getIndices());
+    ASSERT_EQ(either, (pa | pb).getIndices());
+
+    PackedSDR shrunk = pb;
+    shrunk.resize(n / 2);
+    ASSERT_EQ(std::vector<UInt>(b.begin(), std::lower_bound(b.begin(), b.end(),
+                                                            n / 2)),
+              shrunk.getIndices());
+  }
+}
+
+TEST(PackedSDR, TopK) {
+  const Real scores[] = {0.5f, 2, 1, 2, 0, 1, 3};
+  PackedSDR sdr(7);
+  sdr.setTopK(4, scores);
+  ASSERT_EQ(std::vector<UInt>({1, 2, 3, 6}), sdr.getIndices());
+  sdr.setTopK(0, scores);
+  ASSERT_EQ(0u, sdr.count());
+}
+
+TEST(SparseBinaryMatrix, PackedInputMatchesDense) {
+  const UInt nrows = 50, ncols = 200;
+  std::mt19937 rng(5);
+  SparseBinaryMatrix<UInt32, UInt32> m(nrows, ncols);
+  for (UInt i = 0; i != nrows; ++i)
+    for (UInt j = 0; j != ncols; ++j)
+      if (rng() % 10 == 0)
+        m.set(i, j, 1);
+
+  std::vector<UInt32> x(ncols, 0);
+  std::vector<UInt> on;
+  for (UInt j = 0; j != ncols; ++j)
+    if (rng() % 4 == 0) {
+      x[j] = 1;
+      on.push_back(j);
+    }
+  PackedSDR px(ncols, on.begin(), on.end());
+
+  std::vector<UInt32> expected(nrows), y(nrows), z(nrows);
+  m.overlap(x.begin(), x.end(), expected.begin(), expected.end());
+  m.overlap(px, y.begin());
+  m.rightVecSumAtNZ(px, z.begin());
+  ASSERT_EQ(expected, y);
+  ASSERT_EQ(expected, z);
+
+  ASSERT_EQ(m.minHammingDistance(on.begin(), on.end()),
+            m.minHammingDistance(px));
+}
+
+namespace {
+typedef SparseBinaryMatrix<UInt32, UInt32> SBM;
+typedef std::vector<std::vector<UInt32>> Rows;
+
+void expectRows(const Rows &expected, const SBM &m) {
+  ASSERT_EQ(expected.size(), m.nRows());
+  for (UInt i = 0; i != m.nRows(); ++i) {
+    SBM::Row row = m.getSparseRow(i);
+    ASSERT_EQ(expected[i], row) << "row " << i;
+  }
+}
+
+std::vector<UInt32> randomRow(std::mt19937 &rng, UInt ncols, UInt density) {
+  std::vector<UInt32> row;
+  for (UInt j = 0; j != ncols; ++j)
+    if (rng() % density == 0)
+      row.push_back(j);
+  return row;
+}
+} // namespace
+
+TEST(SparseBinaryMatrix, RowEditsKeepContents) {
+  const UInt nrows = 40, ncols = 100;
+  std::mt19937 rng(17);
+  SBM m(nrows, ncols);
+  Rows expected(nrows);
+
+  for (UInt step = 0; step != 2000; ++step) {
+    UInt row = rng() % nrows;
+    if (step % 3 == 0) {
+      expected[row] = randomRow(rng, ncols, 2 + rng() % 20);
+      m.replaceSparseRow(row, expected[row].begin(), expected[row].end());
+    } else {
+      UInt32 col = rng() % ncols;
+      auto it = std::lower_bound(expected[row].begin(), expected[row].end(),
+                                 col);
+      bool on = rng() % 2 == 0;
+      if (on && (it == expected[row].end() || *it != col))
+        expected[row].insert(it, col);
+      else if (!on && it != expected[row].end() && *it == col)
+        expected[row].erase(it);
+      m.set(row, col, on ? 1 : 0);
+    }
+  }
+  expectRows(expected, m);
+
+  m.setRangeToZero(3, 20, 60);
+  auto first = std::lower_bound(expected[3].begin(), expected[3].end(), 20);
+  expected[3].erase(first,
+                    std::lower_bound(first, expected[3].end(), (UInt32)60));
+  expectRows(expected, m);
+
+  std::vector<UInt32> newCol = {1, 5, 39};
+  m.appendSparseCol(newCol.begin(), newCol.end());
+  for (UInt32 row : newCol)
+    expected[row].push_back(ncols);
+  expectRows(expected, m);
+
+  SBM copy(m);
+  m.compact();
+  ASSERT_EQ(m.nNonZeros(), m.capacity());
+  expectRows(expected, m);
+  ASSERT_TRUE(m.equals(copy));
+
+  m.transpose();
+  m.transpose();
+  ASSERT_TRUE(m.equals(copy));
+
+  m.logicalNot();
+  m.logicalNot();
+  ASSERT_TRUE(m.equals(copy));
+
+  m.logicalAnd(copy);
+  ASSERT_TRUE(m.equals(copy));
+  m.logicalOr(copy);
+  ASSERT_TRUE(m.equals(copy));
+}
+
+TEST(SparseBinaryMatrix, BulkBuildAndFlatRoundTrip) {
+  const UInt nrows = 30, ncols = 70;
+  std::mt19937 rng(3);
+  Rows expected(nrows);
+  std::vector<UInt64> offsets(1, 0);
+  std::vector<UInt32> indices;
+  SBM appended(ncols);
+  appended.reserve(nrows, nrows * ncols / 4);
+  for (UInt i = 0; i != nrows; ++i) {
+    expected[i] = randomRow(rng, ncols, 4);
+    indices.insert(indices.end(), expected[i].begin(), expected[i].end());
+    offsets.push_back(indices.size());
+    appended.appendSparseRow(expected[i].begin(), expected[i].end());
+  }
+  expectRows(expected, appended);
+
+  SBM m;
+  m.fromCSR(nrows, ncols, offsets.begin(), indices.begin());
+  expectRows(expected, m);
+  ASSERT_EQ(ncols, m.nCols());
+  ASSERT_EQ(indices.size(), m.capacity());
+
+  std::stringstream ss;
+  m.toFlat(ss);
+  std::string flat = ss.str();
+  ASSERT_EQ(m.flatSize(), flat.size());
+
+  SBM fromStream;
+  fromStream.fromFlat(ss);
+  ASSERT_TRUE(m.equals(fromStream));
+
+  std::vector<UInt64> aligned(flat.size() / sizeof(UInt64));
+  std::memcpy(aligned.data(), flat.data(), flat.size());
+  SBM fromBuffer;
+  fromBuffer.fromFlat((const char *)aligned.data(), flat.size());
+  ASSERT_TRUE(m.equals(fromBuffer));
+
+  flat[0] = 'x';
+  SBM bad;
+  ASSERT_ANY_THROW(bad.fromFlat(flat.data(), flat.size()));
+}
+
+TEST(SparseBinaryMatrix, ParallelSumsMatchSerial) {
+  const UInt nrows = 300, ncols = 500;
+  std::mt19937 rng(8);
+  SBM m(ncols);
+  for (UInt i = 0; i != nrows; ++i) {
+    std::vector<UInt32> row = randomRow(rng, ncols, 7);
+    m.appendSparseRow(row.begin(), row.end());
+  }
+
+  std::vector<Real32> x(ncols), xr(nrows);
+  for (auto &v : x)
+    v = (Real32)(rng() % 1000) / 7.0f;
+  for (auto &v : xr)
+    v = (Real32)(rng() % 1000) / 7.0f;
+
+  std::vector<Real32> y1(nrows), y2(nrows), z1(ncols), z2(ncols);
+  m.rightVecSumAtNZ(x.begin(), x.end(), y1.begin(), y1.end());
+  m.leftVecSumAtNZ(xr.begin(), xr.end(), z1.begin(), z1.end());
+  for (UInt nThreads : {1u, 2u, 4u, 0u}) {
+    m.rightVecSumAtNZ_parallel(x.begin(), x.end(), y2.begin(), y2.end(),
+                               nThreads);
+    m.leftVecSumAtNZ_parallel(xr.begin(), xr.end(), z2.begin(), z2.end(),
+                              nThreads);
+    ASSERT_EQ(y1, y2);
+    ASSERT_EQ(z1, z2);
+  }
+}
@@ -0,0 +1,235 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2013, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Unit tests for the log-domain methods of SparseMatrixAlgorithms and for
+ * the fast_exp and fast_log kernels they use.
+ */
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/math/Math.hpp>
+#include <nupic/math/SparseMatrix.hpp>
+#include <nupic/math/SparseMatrixAlgorithms.hpp>
+#include <nupic/types/Types.hpp>
+
+using namespace nupic;
+
+namespace {
+
+typedef SparseMatrix<UInt32, Real32> SM32;
+
+// Restores the default log/exp mode when a test ends.
+struct ExactLogExpGuard {
+  ~ExactLogExpGuard() { SparseMatrixAlgorithms::setExactLogExp(false); }
+};
+
+// A nrows x ncols matrix of log probabilities, with about a fifth of zeros
+SM32 randomLogMatrix(UInt32 nrows, UInt32 ncols, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> val(-12.0f, -0.01f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Real32> dense(nrows * ncols, 0);
+  for (auto &v : dense)
+    if (unit(rng) > 0.2f)
+      v = val(rng);
+  SM32 m;
+  m.fromDense(nrows, ncols, dense.begin());
+  return m;
+}
+
+// A matrix that has non-zeros on a subset of the non-zeros of a, with
+// values below those of a, some of them very close to them
+SM32 randomBelow(const SM32 &a, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Real32> dense(a.nRows() * a.nCols(), 0);
+  a.toDense(dense.begin());
+  for (auto &v : dense) {
+    if (v == 0)
+      continue;
+    float u = unit(rng);
+    if (u < 0.3f)
+      v = 0;
+    else if (u < 0.4f)
+      v = std::nextafter(v, -20.0f);
+    else
+      v -= 8.0f * unit(rng) + 1e-3f;
+  }
+  SM32 b;
+  b.fromDense(a.nRows(), a.nCols(), dense.begin());
+  return b;
+}
+
+void expectNear(const SM32 &a, const SM32 &b, double tol) {
+  ASSERT_EQ(a.nRows(), b.nRows());
+  ASSERT_EQ(a.nCols(), b.nCols());
+  for (UInt32 i = 0; i != a.nRows(); ++i)
+    for (UInt32 j = 0; j != a.nCols(); ++j) {
+      double x = a.get(i, j), y = b.get(i, j);
+      ASSERT_NEAR(x, y, tol * std::max(1.0, std::fabs(y)))
+          << "at " << i << ", " << j;
+    }
+}
+
+void expectEqual(const SM32 &a, const SM32 &b) {
+  ASSERT_EQ(a.nRows(), b.nRows());
+  for (UInt32 i = 0; i != a.nRows(); ++i)
+    for (UInt32 j = 0; j != a.nCols(); ++j)
+      ASSERT_EQ(a.get(i, j), b.get(i, j)) << "at " << i << ", " << j;
+}
+
+} // end namespace
+
+TEST(FastExpLogTest, ErrorBounds) {
+  const double eps = std::numeric_limits<float>::epsilon();
+
+  for (float x = -87.0f; x <= 88.0f; x += 0.0137f) {
+    double ref = std::exp((double)x);
+    ASSERT_NEAR(fast_exp(x), ref, eps * ref) << x;
+  }
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> expo(-125.0f, 127.0f);
+  for (int i = 0; i != 100000; ++i) {
+    float x = std::exp2(expo(rng));
+    double ref = std::log((double)x);
+    ASSERT_NEAR(fast_log(x), ref, eps * std::fabs(ref)) << x;
+  }
+  ASSERT_EQ(0.0f, fast_log(1.0f));
+
+  // Out of range arguments saturate instead of overflowing
+  ASSERT_TRUE(std::isfinite(fast_exp(1000.0f)));
+  ASSERT_LE(0.0f, fast_exp(-1000.0f));
+}
+
+TEST(FastExpLogTest, ArrayMatchesScalar) {
+  // The 8-lane kernels compute the same operations as the scalar ones
+  std::vector<float> x, y(1003), z(1003);
+  for (int i = 0; i != 1003; ++i)
+    x.push_back(-80.0f + 0.157f * i);
+  fast_exp(x.data(), x.data() + x.size(), y.data());
+  fast_log(y.data(), y.data() + y.size(), z.data());
+  for (size_t i = 0; i != x.size(); ++i) {
+    ASSERT_EQ(fast_exp(x[i]), y[i]) << i;
+    ASSERT_EQ(fast_log(y[i]), z[i]) << i;
+  }
+}
+
+TEST(SparseMatrixAlgorithmsLogTest, ExactModeMatchesScalarCode) {
+  ExactLogExpGuard guard;
+  SparseMatrixAlgorithms::setExactLogExp(true);
+  ASSERT_TRUE(SparseMatrixAlgorithms::getExactLogExp());
+
+  std::mt19937 rng(1);
+  SM32 a = randomLogMatrix(17, 29, rng);
+  SM32 b = randomBelow(a, rng);
+  SM32 expected(a);
+
+  const float minExp = std::log(std::numeric_limits<float>::epsilon());
+  for (UInt32 i = 0; i != a.nRows(); ++i)
+    for (UInt32 j = 0; j != a.nCols(); ++j) {
+      if (b.get(i, j) == 0)
+        continue;
+      float x = a.get(i, j), y = b.get(i, j);
+      if (x < y)
+        std::swap(x, y);
+      float d = y - x;
+      if (d >= minExp)
+        x += std::log1p(std::exp(d));
+      expected.set(i, j, x);
+    }
+
+  SparseMatrixAlgorithms::logSumNoAlloc(a, b);
+  expectEqual(a, expected);
+}
+
+TEST(SparseMatrixAlgorithmsLogTest, FastMatchesExact) {
+  ExactLogExpGuard guard;
+  std::mt19937 rng(7);
+  SM32 a = randomLogMatrix(31, 57, rng);
+  SM32 b = randomBelow(a, rng);
+
+  SM32 sum[2], add[2], diff[2];
+  std::vector<Real32> rows[2], cols[2];
+  for (int mode = 0; mode != 2; ++mode) {
+    SparseMatrixAlgorithms::setExactLogExp(mode == 1);
+    sum[mode] = a;
+    SparseMatrixAlgorithms::logSumNoAlloc(sum[mode], b, 1e-5f);
+    add[mode] = a;
+    SparseMatrixAlgorithms::logAddValNoAlloc(add[mode], -3.5f);
+    diff[mode] = a;
+    SparseMatrixAlgorithms::logDiffNoAlloc(diff[mode], b);
+
+    SM32 counts(a);
+    counts.negate();
+    rows[mode].resize(a.nRows());
+    cols[mode].resize(a.nCols());
+    SparseMatrixAlgorithms::matrix_entropy(
+        counts, rows[mode].begin(), rows[mode].end(), cols[mode].begin(),
+        cols[mode].end(), 0.5f);
+  }
+  expectNear(sum[0], sum[1], 1e-6);
+  expectNear(add[0], add[1], 1e-6);
+  expectNear(diff[0], diff[1], 1e-6);
+  for (UInt32 i = 0; i != a.nRows(); ++i)
+    ASSERT_NEAR(rows[0][i], rows[1][i], 1e-5 * std::fabs(rows[1][i]));
+  for (UInt32 j = 0; j != a.nCols(); ++j)
+    ASSERT_NEAR(cols[0][j], cols[1][j], 1e-5 * std::fabs(cols[1][j]));
+}
+
+TEST(SparseMatrixAlgorithmsLogTest, ThreadedMatchesSerial) {
+  ExactLogExpGuard guard;
+  std::mt19937 rng(3);
+  SM32 a = randomLogMatrix(200, 400, rng);
+  SM32 b = randomBelow(a, rng);
+
+  for (int exact = 0; exact != 2; ++exact) {
+    SCOPED_TRACE(exact);
+    SparseMatrixAlgorithms::setExactLogExp(exact == 1);
+    SM32 serial(a), threaded(a);
+    SparseMatrixAlgorithms::logSumNoAlloc(serial, b, 0.0f, 1);
+    SparseMatrixAlgorithms::logSumNoAlloc(threaded, b, 0.0f, 4);
+    expectEqual(serial, threaded);
+    SparseMatrixAlgorithms::logAddValNoAlloc(serial, -1.0f, 0.0f, 1);
+    SparseMatrixAlgorithms::logAddValNoAlloc(threaded, -1.0f, 0.0f, 0);
+    expectEqual(serial, threaded);
+    SparseMatrixAlgorithms::logDiffNoAlloc(serial, b, 0.0f, 1);
+    SparseMatrixAlgorithms::logDiffNoAlloc(threaded, b, 0.0f, 4);
+    expectEqual(serial, threaded);
+    SparseMatrixAlgorithms::LBP_piPrime(serial, -1e-4f, 1);
+    SparseMatrixAlgorithms::LBP_piPrime(threaded, -1e-4f, 4);
+    expectEqual(serial, threaded);
+  }
+
+  std::vector<Real32> x(a.nCols()), y1(a.nRows()), y2(a.nRows());
+  for (UInt32 j = 0; j != a.nCols(); ++j)
+    x[j] = 0.01f * (Real32)j;
+  SparseMatrixAlgorithms::smoothVecMaxProd(a, 0.5f, x.begin(), x.end(),
+                                           y1.begin(), y1.end(), 1);
+  SparseMatrixAlgorithms::smoothVecMaxProd(a, 0.5f, x.begin(), x.end(),
+                                           y2.begin(), y2.end(), 4);
+  ASSERT_EQ(y1, y2);
+}
@@ -20,7 +20,12 @@
  * ---------------------------------------------------------------------
  */
 
+#include <deque>
+#include <functional>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -32,6 +37,7 @@
 #include <nupic/math/SparseMatrix.hpp>
 #include <nupic/proto/SparseMatrixProto.capnp.h>
 #include <nupic/types/Types.h>
+#include <nupic/utils/Random.hpp>
 
 using namespace nupic;
 
@@ -100,3 +106,460 @@ TEST(SparseMatrixReadWrite, Basic) {
   ASSERT_EQ(m1r1[0].second, 3.0) << "Invalid value in original matrix";
   ASSERT_EQ(m1r1[0].second, m2r1[0].second) << "Invalid value in copied matrix";
 }
+
+namespace {
+
+// Random matrix with ~10% density and non-zeros in [0, 1)
+SparseMatrix<UInt32, Real32, Int32, Real64> randomMatrix(UInt32 nrows,
+                                                         UInt32 ncols,
+                                                         UInt32 seed) {
+  SparseMatrix<UInt32, Real32, Int32, Real64> m(nrows, ncols);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<Real32> value(0.0f, 1.0f);
+  for (UInt32 row = 0; row < nrows; ++row)
+    for (UInt32 col = 0; col < ncols; ++col)
+      if (rng() % 10 == 0)
+        m.setNonZero(row, col, value(rng));
+  return m;
+}
+
+} // namespace
+
+TEST(SparseMatrixParallel, VectorProductsMatchSerial) {
+  const UInt32 nrows = 3000, ncols = 700;
+  const auto m = randomMatrix(nrows, ncols, 42);
+
+  std::vector<Real32> xc(ncols), xr(nrows);
+  for (UInt32 i = 0; i < ncols; ++i)
+    xc[i] = (Real32)(i % 7) - 3.0f;
+  for (UInt32 i = 0; i < nrows; ++i)
+    xr[i] = (Real32)(i % 5) * 0.5f;
+
+  std::vector<Real32> serial(nrows), parallel(nrows);
+  m.rightVecProd(xc.begin(), serial.begin());
+  m.rightVecProd_parallel(xc.begin(), parallel.begin());
+  ASSERT_EQ(serial, parallel);
+
+  m.rightVecSumAtNZ(xc.begin(), serial.begin());
+  m.rightVecSumAtNZ_parallel(xc.begin(), parallel.begin());
+  ASSERT_EQ(serial, parallel);
+
+  m.rightVecSumAtNZGtThreshold(xc.begin(), serial.begin(), 0.5f);
+  m.rightVecSumAtNZGtThreshold_parallel(xc.begin(), parallel.begin(), 0.5f);
+  ASSERT_EQ(serial, parallel);
+
+  m.rightVecSumAtNZGteThreshold(xc.begin(), serial.begin(), 0.5f);
+  m.rightVecSumAtNZGteThreshold_parallel(xc.begin(), parallel.begin(), 0.5f);
+  ASSERT_EQ(serial, parallel);
+
+  std::vector<Real32> serialCols(ncols), parallelCols(ncols);
+  m.leftVecProd(xr.begin(), serialCols.begin());
+  m.leftVecProd_parallel(xr.begin(), parallelCols.begin());
+  ASSERT_EQ(serialCols, parallelCols);
+
+  std::vector<UInt32> active;
+  for (UInt32 col = 3; col < ncols; col += 17)
+    active.push_back(col);
+
+  std::vector<Int32> serialCounts(nrows), parallelCounts(nrows);
+  m.rightVecSumAtNZSparse(active.begin(), active.end(), serialCounts.begin());
+  m.rightVecSumAtNZSparse_parallel(active.begin(), active.end(),
+                                   parallelCounts.begin());
+  ASSERT_EQ(serialCounts, parallelCounts);
+
+  m.rightVecSumAtNZGteThresholdSparse(active.begin(), active.end(),
+                                      serialCounts.begin(), 0.5f);
+  m.rightVecSumAtNZGteThresholdSparse_parallel(
+      active.begin(), active.end(), parallelCounts.begin(), 0.5f);
+  ASSERT_EQ(serialCounts, parallelCounts);
+
+  // The dense version of the count, as a reference
+  std::vector<Real32> dense(ncols, 0.0f), sums(nrows);
+  for (UInt32 col : active)
+    dense[col] = 1.0f;
+  m.rightVecSumAtNZGtThreshold(dense.begin(), sums.begin(), 0.5f);
+  m.rightVecSumAtNZGtThresholdSparse_parallel(active.begin(), active.end(),
+                                              parallelCounts.begin(), 0.5f);
+  for (UInt32 row = 0; row < nrows; ++row)
+    ASSERT_EQ((Int32)sums[row], parallelCounts[row]);
+}
+
+TEST(SparseMatrixParallel, MutatorsMatchSerial) {
+  auto serial = randomMatrix(2000, 300, 7);
+  auto parallel = serial;
+
+  serial.threshold(0.25f);
+  parallel.threshold_parallel(0.25f);
+  ASSERT_TRUE(serial == parallel);
+
+  std::vector<UInt32> rows;
+  for (UInt32 row = 0; row < serial.nRows(); row += 3)
+    rows.push_back(row);
+
+  // Shrinks rows
+  auto cut = [](Real32 v) { return v < 0.6f ? 0.0f : v; };
+  for (UInt32 row : rows)
+    serial.elementRowApply(row, cut);
+  parallel.elementRowApply_parallel(rows.begin(), rows.end(), cut);
+  ASSERT_TRUE(serial == parallel);
+
+  // Grows rows: they take the serial path
+  auto fill = [](Real32 v) { return v + 1.0f; };
+  for (UInt32 row : rows)
+    serial.elementRowApply(row, fill);
+  parallel.elementRowApply_parallel(rows.begin(), rows.end(), fill);
+  ASSERT_TRUE(serial == parallel);
+}
+
+TEST(SparseMatrixParallel, ConcurrentConstReads) {
+  const UInt32 nrows = 500, ncols = 400;
+  const auto m = randomMatrix(nrows, ncols, 3);
+
+  std::vector<std::vector<UInt32>> inputs(8);
+  std::vector<std::vector<Int32>> expected(inputs.size());
+  for (size_t t = 0; t < inputs.size(); ++t) {
+    for (UInt32 col = (UInt32)t; col < ncols; col += 11 + (UInt32)t)
+      inputs[t].push_back(col);
+    expected[t].resize(nrows);
+    m.rightVecSumAtNZGteThresholdSparse(inputs[t].begin(), inputs[t].end(),
+                                        expected[t].begin(), 0.3f);
+  }
+
+  std::vector<std::vector<Int32>> results(inputs.size(),
+                                          std::vector<Int32>(nrows));
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < inputs.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (int round = 0; round < 50; ++round) {
+        m.rightVecSumAtNZGteThresholdSparse(inputs[t].begin(),
+                                            inputs[t].end(),
+                                            results[t].begin(), 0.3f);
+        if (results[t] != expected[t])
+          return;
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  for (size_t t = 0; t < inputs.size(); ++t)
+    ASSERT_EQ(expected[t], results[t]) << "thread " << t;
+}
+
+// A count that throws when it is written to, if full.
+struct Count {
+  Int32 value;
+  bool full;
+
+  Count() : value(0), full(false) {}
+  Count &operator=(Int32 count) {
+    if (full)
+      throw std::runtime_error("output full");
+    value = count;
+    return *this;
+  }
+  Count &operator++() { return *this = value + 1; }
+};
+
+TEST(SparseMatrixParallel, MaskIsResetWhenKernelThrows) {
+  const UInt32 nrows = 300, ncols = 200;
+  const auto m = randomMatrix(nrows, ncols, 5);
+
+  std::vector<UInt32> active, others;
+  for (UInt32 col = 0; col < ncols; ++col)
+    (col % 3 ? others : active).push_back(col);
+
+  std::vector<Int32> expected(nrows), actual(nrows);
+  std::vector<Count> out(nrows);
+  out[nrows / 2].full = true;
+
+  m.rightVecSumAtNZSparse(others.begin(), others.end(), expected.begin());
+  ASSERT_THROW(
+      m.rightVecSumAtNZSparse(active.begin(), active.end(), out.begin()),
+      std::runtime_error);
+  m.rightVecSumAtNZSparse(others.begin(), others.end(), actual.begin());
+  ASSERT_EQ(expected, actual);
+
+  ASSERT_THROW(m.rightVecSumAtNZSparse_parallel(active.begin(), active.end(),
+                                                out.begin(), 4),
+               std::runtime_error);
+  m.rightVecSumAtNZSparse_parallel(others.begin(), others.end(),
+                                   actual.begin(), 4);
+  ASSERT_EQ(expected, actual);
+
+  m.rightVecSumAtNZGteThresholdSparse(others.begin(), others.end(),
+                                      expected.begin(), 0.5f);
+  ASSERT_THROW(m.rightVecSumAtNZGteThresholdSparse(
+                   active.begin(), active.end(), out.begin(), 0.5f),
+               std::runtime_error);
+  m.rightVecSumAtNZGteThresholdSparse(others.begin(), others.end(),
+                                      actual.begin(), 0.5f);
+  ASSERT_EQ(expected, actual);
+}
+
+TEST(SparseMatrixColumnIndex, MatchesRowScanAfterMutations) {
+  typedef SparseMatrix<UInt32, Real32, Int32, Real64> SM;
+  SM plain = randomMatrix(300, 200, 11);
+  SM indexed = plain;
+  indexed.enableColumnIndex();
+  ASSERT_TRUE(indexed.hasColumnIndex());
+  ASSERT_FALSE(plain.hasColumnIndex());
+
+  std::vector<std::vector<UInt32>> inputs(3);
+  for (UInt32 col = 1; col < 200; col += 7)
+    inputs[0].push_back(col);
+  inputs[1] = {0, 5, 5, 17, 199}; // duplicates count once
+  for (UInt32 col = 0; col < 200; col += 2)
+    inputs[2].push_back(col);
+
+  auto check = [&](const char *step) {
+    ASSERT_TRUE(plain == indexed) << step;
+    const UInt32 nrows = plain.nRows(), ncols = plain.nCols();
+    for (const auto &input : inputs) {
+      std::vector<UInt32> active;
+      for (UInt32 col : input)
+        if (col < ncols)
+          active.push_back(col);
+      std::vector<Int32> expected(nrows), actual(nrows, -1);
+
+      plain.rightVecSumAtNZSparse(active.begin(), active.end(),
+                                  expected.begin());
+      indexed.rightVecSumAtNZSparse(active.begin(), active.end(),
+                                    actual.begin());
+      ASSERT_EQ(expected, actual) << step;
+      indexed.rightVecSumAtNZSparse_parallel(active.begin(), active.end(),
+                                             actual.begin(), 4);
+      ASSERT_EQ(expected, actual) << step;
+
+      plain.rightVecSumAtNZGteThresholdSparse(active.begin(), active.end(),
+                                              expected.begin(), 0.5f);
+      indexed.rightVecSumAtNZGteThresholdSparse(active.begin(), active.end(),
+                                                actual.begin(), 0.5f);
+      ASSERT_EQ(expected, actual) << step;
+      indexed.rightVecSumAtNZGteThresholdSparse_parallel(
+          active.begin(), active.end(), actual.begin(), 0.5f, 4);
+      ASSERT_EQ(expected, actual) << step;
+
+      plain.rightVecSumAtNZGtThresholdSparse(active.begin(), active.end(),
+                                             expected.begin(), 0.5f);
+      indexed.rightVecSumAtNZGtThresholdSparse_parallel(
+          active.begin(), active.end(), actual.begin(), 0.5f, 4);
+      ASSERT_EQ(expected, actual) << step;
+    }
+  };
+
+  auto both = [&](const std::function<void(SM &)> &mutate, const char *step) {
+    mutate(plain);
+    mutate(indexed);
+    check(step);
+  };
+
+  check("initial");
+
+  std::vector<UInt32> rows = {2, 3, 50, 51, 200};
+  std::vector<UInt32> cols = {0, 5, 17, 40, 41, 199};
+  both([&](SM &m) {
+    m.setZerosOnOuter(rows.begin(), rows.end(), cols.begin(), cols.end(),
+                      0.7f);
+  }, "setZerosOnOuter");
+
+  both([&](SM &m) {
+    Random rng(5);
+    m.setRandomZerosOnOuter(rows.begin(), rows.end(), cols.begin(),
+                            cols.end(), 2, 0.3f, rng);
+  }, "setRandomZerosOnOuter");
+
+  both([](SM &m) {
+    m.set(7, 17, 0.9f);
+    m.set(8, 17, 0.0f);
+    m.setNonZero(9, 5, 0.2f);
+    m.setRowToZero(50);
+  }, "set");
+
+  // Drops the non-zeros that fall to 0
+  both([&](SM &m) {
+    m.incrementNonZerosOnOuter(rows.begin(), rows.end(), cols.begin(),
+                               cols.end(), -0.5f);
+    m.clipRowsBelowAndAbove(rows.begin(), rows.end(), 0.0f, 1.0f);
+  }, "clip");
+
+  both([](SM &m) { m.threshold(0.2f); }, "threshold");
+  both([](SM &m) { m.threshold_parallel(0.25f, 4); }, "threshold_parallel");
+
+  both([](SM &m) {
+    std::vector<UInt32> ind = {3, 17, 150};
+    std::vector<Real32> nz = {0.6f, 0.4f, 0.8f};
+    m.setRowFromSparse(10, ind.begin(), ind.end(), nz.begin());
+    m.addRow(ind.begin(), ind.end(), nz.begin());
+  }, "setRowFromSparse");
+
+  both([](SM &m) { m.resize(m.nRows() + 3, m.nCols() + 2); }, "grow");
+  both([](SM &m) { m.set(m.nRows() - 1, m.nCols() - 1, 0.9f); }, "set new");
+  both([](SM &m) { m.resize(m.nRows() - 20, m.nCols() - 10); }, "shrink");
+
+  both([](SM &m) {
+    std::vector<UInt32> del = {0, 4, 100};
+    m.deleteRows(del.begin(), del.end());
+  }, "deleteRows");
+
+  both([](SM &m) {
+    std::vector<UInt32> which = {1, 2, 3, 60};
+    m.elementRowApply_parallel(which.begin(), which.end(),
+                               [](Real32 v) { return v > 0.5f ? 0.0f : v; },
+                               4);
+  }, "elementRowApply_parallel");
+
+  // Copying an indexed matrix keeps the index
+  SM copy = indexed;
+  ASSERT_TRUE(copy.hasColumnIndex());
+  std::vector<Int32> expected(copy.nRows()), actual(copy.nRows());
+  plain.rightVecSumAtNZSparse(inputs[0].begin(), inputs[0].end() - 1,
+                              expected.begin());
+  copy.rightVecSumAtNZSparse(inputs[0].begin(), inputs[0].end() - 1,
+                             actual.begin());
+  ASSERT_EQ(expected, actual);
+
+  indexed.disableColumnIndex();
+  ASSERT_FALSE(indexed.hasColumnIndex());
+  check("disabled");
+}
+
+TEST(SparseMatrixAlwaysCompact, MatchesDefaultModeAfterMutations) {
+  typedef SparseMatrix<UInt32, Real32, Int32, Real64> SM;
+  SM plain = randomMatrix(300, 200, 13);
+  SM compact = plain;
+  compact.setAlwaysCompact();
+  ASSERT_TRUE(compact.isAlwaysCompact());
+  ASSERT_FALSE(plain.isAlwaysCompact());
+
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<Real32> value(-1.0f, 1.0f);
+
+  auto check = [&](const char *step) {
+    ASSERT_TRUE(plain == compact) << step;
+    ASSERT_TRUE(compact.isCompact()) << step;
+
+    // The vector kernels take a faster path on contiguous input: a deque
+    // forces the scalar loops, which must give the same bits.
+    const UInt32 nrows = compact.nRows(), ncols = compact.nCols();
+    std::vector<Real32> x(ncols);
+    for (auto &v : x)
+      v = value(rng);
+    std::deque<Real32> xd(x.begin(), x.end());
+    std::vector<Real32> expected(nrows), actual(nrows);
+
+    compact.rightVecProd(xd.begin(), expected.begin());
+    compact.rightVecProd(x.begin(), actual.begin());
+    ASSERT_EQ(expected, actual) << step;
+    plain.rightVecProd(x.begin(), actual.begin());
+    ASSERT_EQ(expected, actual) << step;
+
+    compact.rightVecSumAtNZ(xd.begin(), expected.begin());
+    compact.rightVecSumAtNZ(x.data(), actual.begin());
+    ASSERT_EQ(expected, actual) << step;
+
+    compact.vecMaxProd(xd.begin(), expected.begin());
+    compact.vecMaxProd(x.begin(), actual.begin());
+    ASSERT_EQ(expected, actual) << step;
+  };
+
+  auto both = [&](const std::function<void(SM &)> &mutate, const char *step) {
+    mutate(plain);
+    mutate(compact);
+    check(step);
+  };
+
+  check("initial");
+
+  // Grows rows past their slack, many times over
+  std::vector<UInt32> rows = {2, 3, 50, 51, 200};
+  std::vector<UInt32> cols;
+  for (UInt32 col = 0; col < 200; col += 3)
+    cols.push_back(col);
+  both([&](SM &m) {
+    m.setZerosOnOuter(rows.begin(), rows.end(), cols.begin(), cols.end(),
+                      0.7f);
+  }, "setZerosOnOuter");
+
+  both([&](SM &m) {
+    Random r(5);
+    std::vector<UInt32> all(300);
+    for (UInt32 row = 0; row < 300; ++row)
+      all[row] = row;
+    m.setRandomZerosOnOuter(all.begin(), all.end(), cols.begin(), cols.end(),
+                            3, 0.3f, r);
+  }, "setRandomZerosOnOuter");
+
+  both([](SM &m) {
+    for (UInt32 col = 0; col < 200; ++col)
+      m.set(7, col, 0.5f);
+    m.set(8, 17, 0.0f);
+    m.setRowToZero(50);
+  }, "set");
+
+  both([](SM &m) {
+    std::vector<UInt32> ind = {3, 17, 150};
+    std::vector<Real32> nz = {0.6f, 0.4f, 0.8f};
+    m.setRowFromSparse(10, ind.begin(), ind.end(), nz.begin());
+    for (int i = 0; i < 20; ++i)
+      m.addRow(ind.begin(), ind.end(), nz.begin());
+  }, "addRow");
+
+  both([](SM &m) {
+    m.copyRow(11, 7, m);
+    m.addTwoRows(7, 12);
+    m.setBox(20, 30, 10, 60, 0.25f);
+  }, "copyRow");
+
+  both([](SM &m) {
+    std::vector<Real32> col(m.nRows(), 0.0f);
+    for (UInt32 row = 0; row < m.nRows(); row += 2)
+      col[row] = 0.3f;
+    m.addCol(col.begin());
+  }, "addCol");
+
+  both([](SM &m) { m.threshold(0.2f); }, "threshold");
+  both([](SM &m) { m.threshold_parallel(0.25f, 4); }, "threshold_parallel");
+  both([](SM &m) {
+    std::vector<UInt32> which = {1, 2, 3, 60};
+    m.elementRowApply_parallel(
+        which.begin(), which.end(),
+        [](Real32 v) { return v > 0.5f ? 0.0f : v + 0.1f; }, 4);
+  }, "elementRowApply_parallel");
+
+  both([](SM &m) { m.resize(m.nRows() + 3, m.nCols() + 2); }, "grow");
+  both([](SM &m) { m.set(m.nRows() - 1, m.nCols() - 1, 0.9f); }, "set new");
+  both([](SM &m) { m.resize(m.nRows() - 20, m.nCols() - 10); }, "shrink");
+
+  both([](SM &m) {
+    std::vector<UInt32> del = {0, 4, 100};
+    m.deleteRows(del.begin(), del.end());
+  }, "deleteRows");
+
+  both([](SM &m) {
+    SM other = m;
+    other.transpose();
+    other.transpose();
+    m.add(other);
+  }, "add");
+
+  both([](SM &m) {
+    std::stringstream ss;
+    m.toBinary(ss);
+    SM read;
+    read.fromBinary(ss);
+    ASSERT_TRUE(read == m);
+    m.reshape(m.nCols(), m.nRows());
+  }, "reshape");
+
+  both([](SM &m) { m.set(0, 0, 0.75f); }, "set after reshape");
+
+  // Back to the default mode: growing a row decompacts the matrix
+  compact.setAlwaysCompact(false);
+  ASSERT_FALSE(compact.isAlwaysCompact());
+  std::vector<Real32> dense(compact.nCols(), 0.5f);
+  for (SM *m : {&plain, &compact})
+    m->setRowFromDense(1, dense.begin());
+  ASSERT_TRUE(plain == compact);
+  ASSERT_FALSE(compact.isCompact());
+}
@@ -0,0 +1,266 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+
+/** @file
+ * Checks of the sorted-array storage of SparseTensor against dense
+ * reference computations.
+ */
+
+#include <functional>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <nupic/math/SparseTensor.hpp>
+#include <nupic/types/Types.hpp>
+
+using namespace nupic;
+
+namespace {
+
+typedef Index<UInt, 1> I1;
+typedef Index<UInt, 2> I2;
+typedef Index<UInt, 3> I3;
+typedef Index<UInt, 4> I4;
+
+template <typename I>
+void fillRandom(SparseTensor<I, Real> &t, Real density, std::mt19937 &rng) {
+  std::uniform_real_distribution<Real> u(0, 1);
+  I idx = t.getNewZeroIndex();
+  do {
+    if (u(rng) < density)
+      t.set(idx, Real(0.1) + u(rng));
+  } while (increment(t.getBounds(), idx));
+}
+
+// The storage is strictly sorted and holds no zero
+template <typename I> void checkInvariants(const SparseTensor<I, Real> &t) {
+  typename SparseTensor<I, Real>::const_iterator it = t.begin(), prev;
+  for (; it != t.end(); ++it) {
+    ASSERT_FALSE(nearlyZero(it->second));
+    if (it != t.begin()) {
+      prev = it - 1;
+      ASSERT_TRUE(prev->first < it->first);
+    }
+  }
+}
+
+template <typename I>
+void expectNear(const SparseTensor<I, Real> &a,
+                const SparseTensor<I, Real> &b) {
+  checkInvariants(a);
+  checkInvariants(b);
+  ASSERT_EQ(a.getBounds(), b.getBounds());
+  I idx = a.getNewZeroIndex();
+  do {
+    ASSERT_NEAR(a.get(idx), b.get(idx), 1e-4) << idx;
+  } while (increment(a.getBounds(), idx));
+}
+
+} // namespace
+
+TEST(SparseTensorTest, FromIdxValMatchesSequentialSet) {
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<UInt> coord(0, 5);
+  std::uniform_real_distribution<Real> u(0, 1);
+
+  // Unsorted, with duplicates and zeros
+  std::vector<std::pair<I3, Real>> iv;
+  for (UInt n = 0; n < 400; ++n) {
+    Real v = u(rng) < 0.3 ? Real(0) : u(rng) + Real(0.1);
+    iv.push_back(std::make_pair(I3(coord(rng), coord(rng), coord(rng)), v));
+  }
+
+  for (bool clearYesNo : {true, false}) {
+    SparseTensor<I3, Real> bulk(I3(6, 6, 6)), seq(I3(6, 6, 6));
+    fillRandom(bulk, Real(0.2), rng);
+    seq = bulk;
+
+    bulk.fromIdxVal((UInt)iv.size(), iv.begin(), clearYesNo);
+    if (clearYesNo)
+      seq.clear();
+    for (size_t n = 0; n < iv.size(); ++n)
+      seq.set(iv[n].first, iv[n].second);
+
+    checkInvariants(bulk);
+    ASSERT_EQ(seq.getNNonZeros(), bulk.getNNonZeros());
+    ASSERT_TRUE(seq == bulk);
+  }
+
+  // Large enough to be sorted in parallel chunks
+  std::uniform_int_distribution<UInt> wide(0, 399);
+  std::vector<std::pair<I2, Real>> big;
+  std::map<I2, Real> last;
+  for (UInt n = 0; n < 200000; ++n) {
+    I2 idx(wide(rng), wide(rng));
+    Real v = u(rng) + Real(0.1);
+    big.push_back(std::make_pair(idx, v));
+    last[idx] = v;
+  }
+
+  SparseTensor<I2, Real> bulk(I2(400, 400));
+  bulk.fromIdxVal((UInt)big.size(), big.begin());
+  checkInvariants(bulk);
+  ASSERT_EQ(last.size(), bulk.getNNonZeros());
+  std::map<I2, Real>::const_iterator it = last.begin();
+  for (SparseTensor<I2, Real>::const_iterator b = bulk.begin();
+       b != bulk.end(); ++b, ++it) {
+    ASSERT_EQ(it->first, b->first);
+    ASSERT_EQ(it->second, b->second);
+  }
+}
+
+TEST(SparseTensorTest, SparseKernelsMatchDenseKernels) {
+  std::mt19937 rng(7);
+
+  SparseTensor<I3, Real> A(I3(4, 5, 4));
+  fillRandom(A, Real(0.3), rng);
+
+  { // marginalization
+    SparseTensor<I2, Real> nz(I2(4, 4)), dense(I2(4, 4));
+    A.accumulate_nz(I1(1), nz, std::plus<Real>(), 0);
+    A.accumulate(I1(1), dense, std::plus<Real>(), 0);
+    expectNear(nz, dense);
+
+    SparseTensor<I1, Real> nz1(I1(5)), dense1(I1(5));
+    A.accumulate_nz(I2(0, 2), nz1, std::plus<Real>(), 0);
+    A.accumulate(I2(0, 2), dense1, std::plus<Real>(), 0);
+    expectNear(nz1, dense1);
+  }
+
+  { // contraction: product of the diagonal non-zeros, starting at init
+    SparseTensor<I1, Real> nz(I1(5)), ref(I1(5));
+    A.contract_nz(0, 2, nz, std::multiplies<Real>(), Real(2));
+    for (UInt j = 0; j < 4; ++j)
+      for (UInt k = 0; k < 5; ++k)
+        if (!A.isZero(I3(j, k, j)))
+          ref.set(I1(k), (ref.isZero(I1(k)) ? Real(2) : ref.get(I1(k))) *
+                             A.get(I3(j, k, j)));
+    expectNear(nz, ref);
+  }
+
+  { // inner products
+    SparseTensor<I2, Real> B(I2(5, 3));
+    fillRandom(B, Real(0.4), rng);
+    SparseTensor<I3, Real> nz(I3(4, 4, 3)), dense(I3(4, 4, 3));
+    A.inner_product_nz(1, 0, B, nz, std::multiplies<Real>(),
+                       std::plus<Real>());
+    A.inner_product(1, 0, B, dense, std::multiplies<Real>(),
+                    std::plus<Real>());
+    expectNear(nz, dense);
+
+    SparseTensor<I2, Real> M(I2(3, 4)), N(I2(6, 4));
+    fillRandom(M, Real(0.5), rng);
+    fillRandom(N, Real(0.5), rng);
+    SparseTensor<I2, Real> nz2(I2(3, 6)), dense2(I2(3, 6));
+    M.inner_product_nz(1, 1, N, nz2, std::multiplies<Real>(),
+                       std::plus<Real>());
+    M.inner_product(1, 1, N, dense2, std::multiplies<Real>(),
+                    std::plus<Real>());
+    expectNear(nz2, dense2);
+  }
+
+  { // outer product
+    SparseTensor<I2, Real> M(I2(3, 4)), N(I2(2, 3));
+    fillRandom(M, Real(0.5), rng);
+    fillRandom(N, Real(0.5), rng);
+    SparseTensor<I4, Real> nz(I4(3, 4, 2, 3)), dense(I4(3, 4, 2, 3));
+    M.outer_product_nz(N, nz, std::multiplies<Real>());
+    M.outer_product(N, dense, std::multiplies<Real>());
+    expectNear(nz, dense);
+  }
+
+  { // factor apply, on the union and on the intersection
+    SparseTensor<I2, Real> B(I2(4, 4));
+    fillRandom(B, Real(0.3), rng);
+    SparseTensor<I3, Real> nz(A.getBounds()), dense(A.getBounds());
+    A.factor_apply_nz(I2(0, 2), B, nz, std::plus<Real>());
+    A.factor_apply(I2(0, 2), B, dense, std::plus<Real>());
+    expectNear(nz, dense);
+
+    A.factor_apply_fast(I2(0, 2), B, nz, std::multiplies<Real>());
+    A.factor_apply(I2(0, 2), B, dense, std::multiplies<Real>());
+    expectNear(nz, dense);
+
+    SparseTensor<I3, Real> inPlace(A);
+    inPlace.factor_apply_nz(I2(0, 2), B, std::plus<Real>());
+    A.factor_apply(I2(0, 2), B, dense, std::plus<Real>());
+    expectNear(inPlace, dense);
+  }
+}
+
+TEST(SparseTensorTest, MutationsKeepStorageSorted) {
+  std::mt19937 rng(3);
+  SparseTensor<I3, Real> A(I3(5, 4, 6)), B(I3(5, 4, 6));
+  fillRandom(A, Real(0.4), rng);
+  fillRandom(B, Real(0.4), rng);
+
+  // add() writes into one of its inputs
+  SparseTensor<I3, Real> sum(A), ref(A.getBounds());
+  sum.add(B);
+  A.element_apply(B, ref, std::plus<Real>());
+  expectNear(sum, ref);
+
+  // setZero on a box
+  SparseTensor<I3, Real> boxed(A);
+  Domain<UInt> box(I3(1, 0, 2), I3(4, 3, 5));
+  boxed.setZero(box);
+  ref = A;
+  I3 idx = A.getNewZeroIndex();
+  do {
+    if (box.includes(idx))
+      ref.set(idx, 0);
+  } while (increment(A.getBounds(), idx));
+  expectNear(boxed, ref);
+
+  // functor that introduces zeros
+  SparseTensor<I3, Real> thresholded(A);
+  thresholded.element_apply_fast([](Real x) { return x > 0.6 ? x : 0; });
+  ref = A;
+  ref.element_apply([](Real x) { return x > 0.6 ? x : 0; });
+  expectNear(thresholded, ref);
+
+  // permute, then shrink
+  SparseTensor<I3, Real> permuted(A);
+  permuted.permute(I3(2, 0, 1));
+  ASSERT_EQ(I3(6, 5, 4), permuted.getBounds());
+  checkInvariants(permuted);
+  idx = A.getNewZeroIndex();
+  do {
+    ASSERT_EQ(A.get(idx), permuted.get(I3(idx[2], idx[0], idx[1])));
+  } while (increment(A.getBounds(), idx));
+
+  SparseTensor<I3, Real> shrunk(A);
+  shrunk.resize(I3(3, 4, 2));
+  checkInvariants(shrunk);
+  idx = shrunk.getNewZeroIndex();
+  UInt nnz = 0;
+  do {
+    ASSERT_EQ(A.get(idx), shrunk.get(idx));
+    nnz += A.isZero(idx) ? 0 : 1;
+  } while (increment(shrunk.getBounds(), idx));
+  ASSERT_EQ(nnz, shrunk.getNNonZeros());
+}
@@ -375,4 +375,51 @@ TEST(TopologyTest, WrappingNeighborhoodDimensionOne) {
       /*radius*/ 1,
       /*expected*/ {{4, 0, 0}, {5, 0, 0}, {6, 0, 0}});
 }
+
+template <UInt Dims, bool Wrap>
+void expectForEachNeighborMatchesIterators(const vector<UInt> &dimensions) {
+  UInt numPoints = 1;
+  for (UInt dimension : dimensions) {
+    numPoints *= dimension;
+  }
+
+  for (UInt radius = 0; radius <= 12; radius++) {
+    for (UInt center = 0; center < numPoints; center++) {
+      vector<UInt> expected;
+      if (Wrap) {
+        for (UInt neighbor : WrappingNeighborhood(center, radius, dimensions))
+          expected.push_back(neighbor);
+      } else {
+        for (UInt neighbor : Neighborhood(center, radius, dimensions))
+          expected.push_back(neighbor);
+      }
+
+      vector<UInt> actual;
+      forEachNeighbor<Dims, Wrap>(center, radius, dimensions,
+                                  [&](UInt neighbor) {
+                                    actual.push_back(neighbor);
+                                  });
+      ASSERT_EQ(expected, actual)
+          << "center " << center << ", radius " << radius;
+    }
+  }
+}
+
+TEST(TopologyTest, ForEachNeighbor) {
+  // Radii up to wider than the dimensions, and dimensions of size 1
+  for (UInt size : {1, 2, 5, 9}) {
+    expectForEachNeighborMatchesIterators<1, false>({size});
+    expectForEachNeighborMatchesIterators<1, true>({size});
+    expectForEachNeighborMatchesIterators<0, true>({size});
+  }
+
+  const vector<vector<UInt>> dimensions2D = {{1, 7}, {6, 1}, {4, 9}, {8, 3}};
+  for (const vector<UInt> &dimensions : dimensions2D) {
+    expectForEachNeighborMatchesIterators<2, false>(dimensions);
+    expectForEachNeighborMatchesIterators<2, true>(dimensions);
+  }
+
+  expectForEachNeighborMatchesIterators<0, false>({3, 4, 5});
+  expectForEachNeighborMatchesIterators<0, true>({3, 4, 5});
+}
 } // namespace
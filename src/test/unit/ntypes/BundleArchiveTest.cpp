@@ -0,0 +1,175 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of BundleArchive test
+ */
+
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <nupic/ntypes/BundleArchive.hpp>
+#include <nupic/os/Path.hpp>
+#include <nupic/types/Exception.hpp>
+
+using namespace nupic;
+
+namespace {
+
+const std::string archivePath = "BundleArchiveTest.ntz";
+
+// Compressible data: random runs of a few letters
+std::string makeData(size_t size, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::string data;
+  while (data.size() < size)
+    data.append(1 + rng() % 20, (char)('a' + rng() % 4));
+  data.resize(size);
+  return data;
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream f(path.c_str(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(f),
+                     std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &path, const std::string &data) {
+  std::ofstream f(path.c_str(), std::ios::binary);
+  f << data;
+}
+
+// Entries of sizes around the chunk size of 64 bytes, in a batch of chunks
+// and over several batches
+const size_t sizes[] = {0, 1, 63, 64, 65, 640, 10000};
+
+void writeArchive(UInt nThreads) {
+  BundleArchiveWriter writer(archivePath, -1, nThreads, 64);
+  for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    std::ostream out(&writer.beginEntry("entry" + std::to_string(i)));
+    out << makeData(sizes[i], (unsigned)i);
+    writer.endEntry();
+  }
+  writeFile("BundleArchiveTest.txt", makeData(1000, 99));
+  writer.addFile("file", "BundleArchiveTest.txt");
+  Path::remove("BundleArchiveTest.txt");
+  writer.close();
+}
+
+} // namespace
+
+TEST(BundleArchiveTest, RoundTrip) {
+  for (UInt nThreads : {1u, 0u}) {
+    writeArchive(nThreads);
+    ASSERT_TRUE(BundleArchiveReader::isArchive(archivePath));
+
+    BundleArchiveReader reader(archivePath, nThreads);
+    ASSERT_EQ(64u, reader.getChunkSize());
+    const size_t nEntries = sizeof(sizes) / sizeof(sizes[0]);
+    ASSERT_EQ(nEntries + 1, reader.getEntries().size());
+    for (size_t i = 0; i != nEntries; ++i) {
+      const std::string name = "entry" + std::to_string(i);
+      const BundleArchiveEntry &entry = reader.getEntries()[i];
+      ASSERT_EQ(name, entry.name);
+      ASSERT_EQ(sizes[i], entry.size);
+      ASSERT_EQ((sizes[i] + 63) / 64, entry.chunks.size());
+      ASSERT_EQ(makeData(sizes[i], (unsigned)i), reader.readEntry(name));
+    }
+    ASSERT_EQ(makeData(1000, 99), reader.readEntry("file"));
+    ASSERT_TRUE(reader.contains("file"));
+    ASSERT_FALSE(reader.contains("entry"));
+    ASSERT_THROW(reader.readEntry("entry"), nupic::Exception);
+  }
+  Path::remove(archivePath);
+}
+
+TEST(BundleArchiveTest, Streaming) {
+  writeArchive(0);
+  BundleArchiveReader reader(archivePath);
+
+  // Entries are read in any order, several at once
+  auto buffer6 = reader.openEntry("entry6");
+  auto buffer5 = reader.openEntry("entry5");
+  std::istream in6(buffer6.get()), in5(buffer5.get());
+  std::string word6, word5;
+  in6 >> word6;
+  in5 >> word5;
+  const std::string data6 = makeData(10000, 6);
+  ASSERT_EQ(data6, word6 + std::string(std::istreambuf_iterator<char>(in6),
+                                       std::istreambuf_iterator<char>()));
+  ASSERT_EQ(makeData(640, 5).substr(0, word5.size()), word5);
+
+  reader.extractEntry("entry6", "BundleArchiveTest.txt");
+  ASSERT_EQ(data6, readFile("BundleArchiveTest.txt"));
+  Path::remove("BundleArchiveTest.txt");
+  Path::remove(archivePath);
+}
+
+TEST(BundleArchiveTest, Errors) {
+  {
+    // An archive that is not closed is discarded
+    BundleArchiveWriter writer(archivePath);
+    writer.beginEntry("a");
+    ASSERT_THROW(writer.beginEntry("b"), nupic::Exception);
+    writer.endEntry();
+    ASSERT_THROW(writer.beginEntry("a"), nupic::Exception);
+  }
+  ASSERT_FALSE(Path::exists(archivePath));
+
+  writeFile(archivePath, "not an archive");
+  ASSERT_FALSE(BundleArchiveReader::isArchive(archivePath));
+  ASSERT_THROW(BundleArchiveReader reader(archivePath), nupic::Exception);
+
+  // Truncated archive
+  writeArchive(0);
+  const std::string data = readFile(archivePath);
+  writeFile(archivePath, data.substr(0, data.size() - 1));
+  ASSERT_THROW(BundleArchiveReader reader(archivePath), nupic::Exception);
+
+  // Chunk size beyond the bound of the writers
+  ASSERT_THROW(BundleArchiveWriter(archivePath, -1, 0,
+                                   BundleArchiveWriter::maxChunkSize + 1),
+               nupic::Exception);
+  std::string huge = data;
+  huge.replace(8, 4, 4, '\xff');
+  writeFile(archivePath, huge);
+  ASSERT_THROW(BundleArchiveReader reader(archivePath), nupic::Exception);
+
+  // Corrupted chunk
+  std::string corrupted = data;
+  BundleArchiveReader::Entry entry;
+  {
+    writeFile(archivePath, data);
+    BundleArchiveReader reader(archivePath);
+    entry = reader.getEntries()[6];
+  }
+  corrupted[entry.chunks[3].offset + 4] ^= 0x55;
+  writeFile(archivePath, corrupted);
+  BundleArchiveReader reader(archivePath);
+  ASSERT_EQ(makeData(640, 5), reader.readEntry("entry5"));
+  ASSERT_THROW(reader.readEntry("entry6"), nupic::Exception);
+  Path::remove(archivePath);
+}
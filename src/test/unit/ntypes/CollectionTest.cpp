@@ -189,3 +189,32 @@ TEST_F(CollectionTest, testCollectionAddRemove) {
   ASSERT_TRUE(c.getCount() == 0);
   ASSERT_TRUE(!c.contains("2"));
 }
+
+TEST_F(CollectionTest, testLookupAfterRemove) {
+  Collection<int> c;
+  for (int i = 0; i < 10; ++i) {
+    std::stringstream ss;
+    ss << i;
+    c.add(ss.str(), i);
+  }
+  ASSERT_ANY_THROW(c.getIndex("10"));
+
+  c.remove("3");
+  c.remove("0");
+  // c is now 1, 2, 4, 5, 6, 7, 8, 9
+  ASSERT_EQ(8u, c.getCount());
+  ASSERT_FALSE(c.contains("0"));
+  ASSERT_FALSE(c.contains("3"));
+  ASSERT_ANY_THROW(c.getIndex("3"));
+
+  for (size_t k = 0; k < c.getCount(); ++k) {
+    const std::string &name = c.getByIndex(k).first;
+    ASSERT_EQ(k, c.getIndex(name));
+    ASSERT_EQ(c.getByIndex(k).second, c.getByName(name));
+  }
+
+  // a removed name can be added again, at the end
+  c.add("3", 33);
+  ASSERT_EQ(8u, c.getIndex("3"));
+  ASSERT_EQ(33, c.getByName("3"));
+}
@@ -0,0 +1,114 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+/** @file
+ * Implementation of PyRegionRefs test
+ */
+
+#include <nupic/py_support/PyRegionRefs.hpp>
+
+#include <gtest/gtest.h>
+
+#include <nupic/engine/Network.hpp>
+#include <nupic/engine/Region.hpp>
+
+using namespace nupic;
+
+class PyRegionRefsTest : public ::testing::Test {
+public:
+  PyRegionRefsTest() { Py_Initialize(); }
+
+  ~PyRegionRefsTest() { Py_Finalize(); }
+};
+
+TEST_F(PyRegionRefsTest, Parameters) {
+  Network net;
+  Region *region = net.addRegion("level1", "TestNode", "");
+
+  PyParameterRef int32Ref(region->getParameterRef("int32Param"));
+  ASSERT_EQ("int32Param", int32Ref.getName());
+  ASSERT_EQ(NTA_BasicType_Int32, int32Ref.getType());
+  ASSERT_TRUE(int32Ref.isDirect());
+  ASSERT_TRUE(int32Ref.isWritable());
+  {
+    py::Int value(int32Ref.get());
+    ASSERT_EQ(32, (long)value);
+  }
+  {
+    py::Int value(-7);
+    int32Ref.set(value);
+    ASSERT_EQ(-7, region->getParameterInt32("int32Param"));
+  }
+  {
+    // Out of range, and not a number
+    py::LongLong big(1LL << 40);
+    EXPECT_THROW(int32Ref.set(big), std::exception);
+    py::String text("seven");
+    EXPECT_THROW(int32Ref.set(text), std::exception);
+    ASSERT_EQ(-7, region->getParameterInt32("int32Param"));
+  }
+
+  PyParameterRef uint64Ref(region->getParameterRef("uint64Param"));
+  {
+    py::UnsignedLongLong value(1ULL << 63);
+    uint64Ref.set(value);
+    ASSERT_EQ(1ULL << 63, region->getParameterUInt64("uint64Param"));
+    py::Int negative(-1);
+    EXPECT_THROW(uint64Ref.set(negative), std::exception);
+  }
+
+  PyParameterRef real64Ref(region->getParameterRef("real64Param"));
+  {
+    py::Float value(0.25);
+    real64Ref.set(value);
+    ASSERT_EQ(0.25, region->getParameterReal64("real64Param"));
+    py::Float result(real64Ref.get());
+    ASSERT_EQ(0.25, (double)result);
+  }
+
+  PyParameterRef boolRef(region->getParameterRef("boolParam"));
+  {
+    py::Bool value(true);
+    boolRef.set(value);
+    ASSERT_TRUE(region->getParameterBool("boolParam"));
+    py::Bool result(boolRef.get());
+    ASSERT_TRUE((bool)result);
+  }
+
+  // Parameters with side effects go through the name-based accessors
+  PyParameterRef cloneRef(region->getParameterRef("shouldCloneParam"));
+  ASSERT_FALSE(cloneRef.isDirect());
+  {
+    py::Int value(0L);
+    cloneRef.set(value);
+    ASSERT_EQ(0u, region->getParameterUInt32("shouldCloneParam"));
+  }
+
+  Region *sensor =
+      net.addRegion("sensor", "VectorFileSensor", "{activeOutputCount: 1}");
+  PyParameterRef countRef(sensor->getParameterRef("vectorCount"));
+  ASSERT_FALSE(countRef.isWritable());
+  {
+    py::Int value(3);
+    EXPECT_THROW(countRef.set(value), std::exception);
+  }
+}
@@ -79,6 +79,31 @@ TEST(MovingAverage, SlidingWindowInit) {
   MovingAverage m2{3};
   std::vector<Real32> emptyVector;
   ASSERT_EQ(m2.getSlidingWindow(), emptyVector);
+
+  // Only the last values are kept, and the window may start partly filled
+  MovingAverage m3{2, existingHistorical};
+  ASSERT_EQ(m3.getSlidingWindow(), std::vector<Real32>({4.0, 5.0}));
+  ASSERT_EQ(m3.getTotal(), 9.0);
+  MovingAverage m4{5, {0.5, 1.0}};
+  ASSERT_EQ(m4.getTotal(), 1.5);
+  ASSERT_EQ(m4.compute(1.5), 1.0);
+}
+
+TEST(MovingAverage, WrapAround) {
+  MovingAverage m{4};
+  for (UInt i = 1; i <= 103; ++i) {
+    m.compute(Real32(i));
+    std::vector<Real32> expectedWindow;
+    for (UInt j = i > 4 ? i - 3 : 1; j <= i; ++j)
+      expectedWindow.push_back(Real32(j));
+    ASSERT_EQ(m.getSlidingWindow(), expectedWindow);
+  }
+  ASSERT_EQ(m.getTotal(), 100.0 + 101.0 + 102.0 + 103.0);
+  ASSERT_EQ(m.getCurrentAvg(), 101.5);
+
+  // Equal windows compare equal, whatever the position of their oldest value
+  MovingAverage m2{4, {100.0, 101.0, 102.0, 103.0}};
+  ASSERT_EQ(m, m2);
 }
 
 TEST(MovingAverage, EqualsOperator) {
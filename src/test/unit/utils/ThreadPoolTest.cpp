@@ -0,0 +1,86 @@
+/* ---------------------------------------------------------------------
+ * Numenta Platform for Intelligent Computing (NuPIC)
+ * Copyright (C) 2018, Numenta, Inc.  Unless you have an agreement
+ * with Numenta, Inc., for a separate license for this software code, the
+ * following terms and conditions apply:
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ *
+ * http://numenta.org/licenses/
+ * ---------------------------------------------------------------------
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nupic/types/Types.hpp"
+#include "nupic/utils/ThreadPool.hpp"
+
+using namespace nupic;
+using namespace nupic::util;
+
+TEST(ThreadPoolTest, CoversRangeExactlyOnce) {
+  ThreadPool pool(3);
+  ASSERT_EQ(4, pool.size());
+
+  for (UInt n : {0, 1, 5, 17, 1000}) {
+    std::vector<UInt> hits(n, 0);
+    pool.parallelFor(0, n, [&](UInt lo, UInt hi) {
+      for (UInt i = lo; i < hi; ++i)
+        ++hits[i];
+    });
+    for (UInt i = 0; i < n; ++i)
+      ASSERT_EQ(1, hits[i]) << "n = " << n << ", i = " << i;
+  }
+}
+
+TEST(ThreadPoolTest, SerialWithoutWorkers) {
+  ThreadPool pool(0);
+  UInt calls = 0;
+  pool.parallelFor(3, 103, [&](UInt lo, UInt hi) {
+    ++calls;
+    ASSERT_EQ(3, lo);
+    ASSERT_EQ(103, hi);
+  });
+  ASSERT_EQ(1, calls);
+}
+
+TEST(ThreadPoolTest, Nested) {
+  ThreadPool pool(2);
+  std::vector<UInt> sums(8, 0);
+  pool.parallelFor(0, 8, [&](UInt lo, UInt hi) {
+    for (UInt i = lo; i < hi; ++i) {
+      std::vector<UInt> parts(100, 0);
+      pool.parallelFor(0, 100, [&](UInt a, UInt b) {
+        for (UInt j = a; j < b; ++j)
+          parts[j] = j;
+      });
+      for (UInt j = 0; j < 100; ++j)
+        sums[i] += parts[j];
+    }
+  });
+  for (UInt i = 0; i < 8; ++i)
+    ASSERT_EQ(4950, sums[i]);
+}
+
+TEST(ThreadPoolTest, PropagatesExceptions) {
+  ThreadPool pool(2);
+  ASSERT_THROW(pool.parallelFor(0, 30,
+                                [](UInt lo, UInt hi) {
+                                  if (lo > 0)
+                                    throw std::runtime_error("chunk");
+                                }),
+               std::runtime_error);
+}